@@ -0,0 +1,200 @@
+#include <string.h>
+#include <math.h>
+#include "adc_dsp.h"
+#if ADC_DSP_HAVE_ESP_DSP
+#include "dsps_biquad.h"
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+bool adc_dsp_init(adc_dsp_t *dsp, const adc_dsp_config_t *config){
+  const adc_dsp_config_t *c = config;
+  if (c->median_window > 1 && (c->median_window > ADC_DSP_MEDIAN_MAX || c->median_window % 2 == 0)) {
+    return false;
+  }
+  if (c->oversample < 0 || c->oversample_shift < 0 || c->oversample_shift > 16) {
+    return false;
+  }
+  if (c->cic_order < 0 || c->cic_order > ADC_DSP_CIC_ORDER_MAX || (c->cic_order > 0 && c->cic_decimation < 1)) {
+    return false;
+  }
+  uint64_t gain = 1;
+  for (int i = 0; i < c->cic_order; i++) {
+    gain *= (uint64_t)c->cic_decimation;
+  }
+  if (gain > (1u << 19)) {
+    return false;
+  }
+  memset(dsp, 0, sizeof(*dsp));
+  dsp->config = *c;
+  dsp->cic_gain = (uint32_t)gain;
+  // オーバーサンプリングの出力は 平均 * oversample / 2^shift
+  int os = c->oversample > 1 ? c->oversample : 1;
+  dsp->scale = (float)(1 << c->oversample_shift) / (float)os;
+  return true;
+}
+
+void adc_dsp_reset(adc_dsp_t *dsp){
+  adc_dsp_config_t config = dsp->config;
+  adc_dsp_init(dsp, &config);
+}
+
+int adc_dsp_decimation(const adc_dsp_config_t *config){
+  int d = config->oversample > 1 ? config->oversample : 1;
+  if (config->cic_order > 0) {
+    d *= config->cic_decimation;
+  }
+  return d;
+}
+
+//------------------------
+// 移動メディアン
+//------------------------
+// 窓は並べ替えたまま持っておき、1サンプル毎に一番古い値を抜いて新しい値を差し込む(窓の幅に比例)
+int adc_dsp_median(adc_dsp_t *dsp, int32_t *buf, int n){
+  int w = dsp->config.median_window;
+  if (w <= 1) {
+    return n;
+  }
+  for (int i = 0; i < n; i++) {
+    int32_t x = buf[i];
+    if (!dsp->median_primed) {
+      // 最初のサンプルで窓を埋める(立ち上がりで0に引っ張られないように)
+      for (int k = 0; k < w; k++) {
+        dsp->median_hist[k] = x;
+        dsp->median_sorted[k] = x;
+      }
+      dsp->median_primed = true;
+    }
+    int32_t old = dsp->median_hist[dsp->median_pos];
+    dsp->median_hist[dsp->median_pos] = x;
+    dsp->median_pos = dsp->median_pos + 1 < w ? dsp->median_pos + 1 : 0;
+
+    int32_t *s = dsp->median_sorted;
+    int j = 0;
+    while (s[j] != old) {
+      j++;
+    }
+    // oldの場所を詰めながら、xの入る場所まで動かす
+    while (j > 0 && s[j - 1] > x) {
+      s[j] = s[j - 1];
+      j--;
+    }
+    while (j < w - 1 && s[j + 1] < x) {
+      s[j] = s[j + 1];
+      j++;
+    }
+    s[j] = x;
+    buf[i] = s[w / 2];
+  }
+  return n;
+}
+
+//------------------------
+// オーバーサンプリング
+//------------------------
+int adc_dsp_oversample(adc_dsp_t *dsp, int32_t *buf, int n){
+  int os = dsp->config.oversample;
+  if (os <= 1) {
+    return n;
+  }
+  int m = 0;
+  for (int i = 0; i < n; i++) {
+    dsp->os_sum += buf[i];
+    if (++dsp->os_count == os) {
+      buf[m++] = dsp->os_sum >> dsp->config.oversample_shift;
+      dsp->os_sum = 0;
+      dsp->os_count = 0;
+    }
+  }
+  return m;
+}
+
+//------------------------
+// CIC
+//------------------------
+// order段の積分器 -> decimation毎に間引き -> order段の櫛形(差分遅延1)
+// 利得decimation^orderで割って、入力と同じ単位にする
+int adc_dsp_cic(adc_dsp_t *dsp, int32_t *buf, int n){
+  int order = dsp->config.cic_order;
+  if (order <= 0) {
+    return n;
+  }
+  int r = dsp->config.cic_decimation;
+  uint32_t *integ = dsp->cic_integ;
+  uint32_t *comb = dsp->cic_comb;
+  int m = 0;
+  for (int i = 0; i < n; i++) {
+    integ[0] += (uint32_t)buf[i];
+    for (int k = 1; k < order; k++) {
+      integ[k] += integ[k - 1];
+    }
+    if (++dsp->cic_phase < r) {
+      continue;
+    }
+    dsp->cic_phase = 0;
+    uint32_t v = integ[order - 1];
+    for (int k = 0; k < order; k++) {
+      uint32_t prev = comb[k];
+      comb[k] = v;
+      v -= prev;
+    }
+    buf[m++] = (int32_t)v / (int32_t)dsp->cic_gain;
+  }
+  return m;
+}
+
+//------------------------
+// biquad
+//------------------------
+void adc_dsp_biquad_lowpass(float coef[5], float fc, float q){
+  float w0 = 2 * (float)M_PI * fc;
+  float c = cosf(w0);
+  float alpha = sinf(w0) / (2 * q);
+  float a0 = 1 + alpha;
+  coef[0] = (1 - c) / 2 / a0;
+  coef[1] = (1 - c) / a0;
+  coef[2] = coef[0];
+  coef[3] = -2 * c / a0;
+  coef[4] = (1 - alpha) / a0;
+}
+
+void adc_dsp_biquad_c(const float *in, float *out, int n, const float coef[5], float w[2]){
+  for (int i = 0; i < n; i++) {
+    float d0 = in[i] - coef[3] * w[0] - coef[4] * w[1];
+    out[i] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+    w[1] = w[0];
+    w[0] = d0;
+  }
+}
+
+void adc_dsp_biquad(const float *in, float *out, int n, const float coef[5], float w[2]){
+#if ADC_DSP_HAVE_ESP_DSP
+  dsps_biquad_f32(in, out, n, (float *)coef, w);
+#else
+  adc_dsp_biquad_c(in, out, n, coef, w);
+#endif
+}
+
+//------------------------
+// パイプライン
+//------------------------
+int adc_dsp_process(adc_dsp_t *dsp, int32_t *buf, int n, float *out){
+  n = adc_dsp_median(dsp, buf, n);
+  n = adc_dsp_oversample(dsp, buf, n);
+  n = adc_dsp_cic(dsp, buf, n);
+  bool biquad = dsp->config.biquad[0] != 0;
+  for (int done = 0; done < n; done += ADC_DSP_BLOCK_MAX) {
+    int len = n - done < ADC_DSP_BLOCK_MAX ? n - done : ADC_DSP_BLOCK_MAX;
+    float *dst = biquad ? dsp->work : out + done;
+    for (int i = 0; i < len; i++) {
+      dst[i] = (float)buf[done + i] * dsp->scale;
+    }
+    if (biquad) {
+      adc_dsp_biquad(dsp->work, out + done, len, dsp->config.biquad, dsp->biquad_w);
+    }
+  }
+  return n;
+}
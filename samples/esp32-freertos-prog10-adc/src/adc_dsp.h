@@ -0,0 +1,83 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// ADCのサンプルのフィルタ(取得したサンプルと使う側の間に入れる)
+//
+//   raw(int32) -> 移動メディアン -> オーバーサンプリング(平均して間引く) -> CIC間引き
+//              -> float(生の値の単位) -> biquad IIR -> out(float)
+//
+// どの段も設定で外せる。ブロック単位で処理し、段の状態はブロックをまたいで引き継ぐ
+// (ブロックの区切り方で結果は変わらない)
+// 間引きの段があるので、出力の数は入力より少なくなる(adc_dsp_process()の戻り値)
+//
+// biquadはesp-dspがあればdsps_biquad_f32()(ESP32-S3はSIMD命令の実装)、なければCの実装を使う
+// (src/idf_component.ymlでesp-dspを入れる。ホストのビルドはCの実装)
+// biquad以外は整数演算でESP-IDFに依存しないので、ホストでも同じ結果になる
+
+#if defined(__has_include)
+#if __has_include("dsps_biquad.h")
+#define ADC_DSP_HAVE_ESP_DSP 1
+#endif
+#endif
+#ifndef ADC_DSP_HAVE_ESP_DSP
+#define ADC_DSP_HAVE_ESP_DSP 0
+#endif
+
+#define ADC_DSP_MEDIAN_MAX     15
+#define ADC_DSP_CIC_ORDER_MAX  4
+#define ADC_DSP_BLOCK_MAX      256     // 1回のbiquadで処理する数(作業領域の大きさ)
+
+typedef struct {
+  int median_window;       // 移動メディアンの幅(奇数、3～ADC_DSP_MEDIAN_MAX)、0か1で外す
+  int oversample;          // 平均するサンプル数(1か0で外す)
+  int oversample_shift;    // 合計を右シフトするビット数。4^k個の合計をkビットシフトするとkビット増える
+  int cic_order;           // CICの段数(1～ADC_DSP_CIC_ORDER_MAX)、0で外す
+  int cic_decimation;      // CICの間引き率
+  float biquad[5];         // b0, b1, b2, a1, a2(esp-dspと同じ並び、a0=1)、b0=0で外す
+} adc_dsp_config_t;
+
+typedef struct {
+  adc_dsp_config_t config;
+  // 移動メディアン: 古い順の履歴と、並べ替えた窓
+  int32_t median_hist[ADC_DSP_MEDIAN_MAX];
+  int32_t median_sorted[ADC_DSP_MEDIAN_MAX];
+  int median_pos;
+  bool median_primed;
+  // オーバーサンプリング
+  int32_t os_sum;
+  int os_count;
+  // CIC(積分器と櫛形は桁あふれしても最後に合うので、符号なしで計算する)
+  uint32_t cic_integ[ADC_DSP_CIC_ORDER_MAX];
+  uint32_t cic_comb[ADC_DSP_CIC_ORDER_MAX];
+  int cic_phase;
+  uint32_t cic_gain;       // decimation^order
+  // biquad
+  float scale;             // 間引いた後の値を生の値の単位にする係数
+  float biquad_w[2];
+  float work[ADC_DSP_BLOCK_MAX] __attribute__((aligned(16)));
+} adc_dsp_t;
+
+// 設定が範囲外ならfalse
+// CICの利得(decimation^order)と入力の最大値の積が32bitを超えないようにする(12bitのADCなら利得2^19まで)
+bool adc_dsp_init(adc_dsp_t *dsp, const adc_dsp_config_t *config);
+void adc_dsp_reset(adc_dsp_t *dsp);
+
+// n個のサンプルを処理してoutに書き、出力の数を返す
+// bufは作業に使う(中身は壊れる)。outはn個分用意する
+int adc_dsp_process(adc_dsp_t *dsp, int32_t *buf, int n, float *out);
+
+// 出力1つあたりの入力サンプル数
+int adc_dsp_decimation(const adc_dsp_config_t *config);
+
+// 2次のローパス(RBJ)の係数、fcは出力のサンプリング周波数に対する比(0～0.5)
+void adc_dsp_biquad_lowpass(float coef[5], float fc, float q);
+
+// 各段を単独で呼ぶ(ベンチマーク用)。戻り値は出力の数
+int adc_dsp_median(adc_dsp_t *dsp, int32_t *buf, int n);
+int adc_dsp_oversample(adc_dsp_t *dsp, int32_t *buf, int n);
+int adc_dsp_cic(adc_dsp_t *dsp, int32_t *buf, int n);
+// biquadのCの実装(esp-dspのdsps_biquad_f32_ansi()と同じ直接形II)
+void adc_dsp_biquad_c(const float *in, float *out, int n, const float coef[5], float w[2]);
+// esp-dspがあればそちら、なければCの実装
+void adc_dsp_biquad(const float *in, float *out, int n, const float coef[5], float w[2]);
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "adc_dsp_ref.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static int cmp_int32(const void *a, const void *b){
+  int32_t x = *(const int32_t *)a;
+  int32_t y = *(const int32_t *)b;
+  return (x > y) - (x < y);
+}
+
+int adc_dsp_ref_run(const adc_dsp_config_t *config, const int32_t *in, int n, double *out){
+  int64_t *x = malloc(sizeof(int64_t) * (n > 0 ? n : 1));
+  int64_t *tmp = malloc(sizeof(int64_t) * (n > 0 ? n : 1));
+  if (x == NULL || tmp == NULL) {
+    free(x);
+    free(tmp);
+    return -1;
+  }
+  for (int i = 0; i < n; i++) {
+    x[i] = in[i];
+  }
+
+  // メディアン: 直近w個(最初のサンプルより前は最初のサンプル)を並べ替えて真ん中
+  int w = config->median_window;
+  if (w > 1) {
+    int32_t win[ADC_DSP_MEDIAN_MAX];
+    for (int i = 0; i < n; i++) {
+      for (int k = 0; k < w; k++) {
+        int j = i - (w - 1) + k;
+        win[k] = in[j < 0 ? 0 : j];
+      }
+      qsort(win, w, sizeof(int32_t), cmp_int32);
+      tmp[i] = win[w / 2];
+    }
+    memcpy(x, tmp, sizeof(int64_t) * n);
+  }
+
+  // オーバーサンプリング: os個の合計をシフト
+  int os = config->oversample;
+  if (os > 1) {
+    int m = n / os;
+    for (int i = 0; i < m; i++) {
+      int64_t sum = 0;
+      for (int k = 0; k < os; k++) {
+        sum += x[i * os + k];
+      }
+      x[i] = sum >> config->oversample_shift;
+    }
+    n = m;
+  }
+
+  // CIC: 長さRの移動和をorder回たたみ込んで(入力の前は0)、R個毎に取り出し、R^orderで割る
+  if (config->cic_order > 0) {
+    int r = config->cic_decimation;
+    int64_t gain = 1;
+    for (int s = 0; s < config->cic_order; s++) {
+      for (int i = 0; i < n; i++) {
+        int64_t sum = 0;
+        for (int k = 0; k < r && i - k >= 0; k++) {
+          sum += x[i - k];
+        }
+        tmp[i] = sum;
+      }
+      memcpy(x, tmp, sizeof(int64_t) * n);
+      gain *= r;
+    }
+    int m = n / r;
+    for (int i = 0; i < m; i++) {
+      x[i] = (int32_t)x[(i + 1) * r - 1] / (int32_t)gain;
+    }
+    n = m;
+  }
+
+  // biquad(直接形I、double)
+  int dec = os > 1 ? os : 1;
+  double scale = (double)(1 << config->oversample_shift) / dec;
+  const float *c = config->biquad;
+  double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+  for (int i = 0; i < n; i++) {
+    double v = (double)x[i] * scale;
+    if (c[0] != 0) {
+      double y = c[0] * v + c[1] * x1 + c[2] * x2 - c[3] * y1 - c[4] * y2;
+      x2 = x1;
+      x1 = v;
+      y2 = y1;
+      y1 = y;
+      v = y;
+    }
+    out[i] = v;
+  }
+  free(x);
+  free(tmp);
+  return n;
+}
+
+double adc_dsp_ref_compare(const adc_dsp_config_t *config, const int32_t *in, int n, int chunk){
+  adc_dsp_t *dsp = malloc(sizeof(adc_dsp_t));
+  int32_t *buf = malloc(sizeof(int32_t) * chunk);
+  float *out = malloc(sizeof(float) * n);
+  double *ref = malloc(sizeof(double) * n);
+  double err = -1;
+  if (dsp && buf && out && ref && adc_dsp_init(dsp, config)) {
+    int num = 0;
+    for (int i = 0; i < n; i += chunk) {
+      int len = n - i < chunk ? n - i : chunk;
+      memcpy(buf, &in[i], sizeof(int32_t) * len);
+      num += adc_dsp_process(dsp, buf, len, &out[num]);
+    }
+    int num_ref = adc_dsp_ref_run(config, in, n, ref);
+    if (num == num_ref) {
+      err = 0;
+      for (int i = 0; i < num; i++) {
+        double d = fabs(out[i] - ref[i]);
+        if (d > err) {
+          err = d;
+        }
+      }
+    }
+  }
+  free(dsp);
+  free(buf);
+  free(out);
+  free(ref);
+  return err;
+}
+
+void adc_dsp_ref_signal(int32_t *buf, int n, int32_t center, int32_t amp, int period, int32_t noise, int spike_interval, uint32_t seed){
+  uint32_t r = seed;
+  for (int i = 0; i < n; i++) {
+    r = r * 1664525u + 1013904223u;
+    int32_t v = center + (int32_t)lround(amp * sin(2 * M_PI * i / period));
+    v += (int32_t)((r >> 16) % (uint32_t)(2 * noise + 1)) - noise;
+    if (spike_interval > 0 && i % spike_interval == spike_interval - 1) {
+      v += 4 * amp;
+    }
+    buf[i] = v < 0 ? 0 : v > 4095 ? 4095 : v;
+  }
+}
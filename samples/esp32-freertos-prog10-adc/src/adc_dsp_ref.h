@@ -0,0 +1,16 @@
+#pragma once
+#include "adc_dsp.h"
+
+// adc_dsp の確認用の参照実装
+// 速さは考えず、定義どおりに配列全体を1度に計算する(メディアンは毎回並べ替え、CICは移動和のたたみ込み、biquadはdouble)
+// adc_dsp_ref_compare()で、ブロックに分けてadc_dsp_process()に通した結果と比べる
+
+// inのn個を処理してoutに書き、出力の数を返す
+int adc_dsp_ref_run(const adc_dsp_config_t *config, const int32_t *in, int n, double *out);
+
+// inをchunk個ずつadc_dsp_process()に通した結果と参照実装の差の最大値(生の値の単位)
+// 出力の数が合わない、メモリが足りないときは負の値
+double adc_dsp_ref_compare(const adc_dsp_config_t *config, const int32_t *in, int n, int chunk);
+
+// 確認用の入力: 中心center、振幅ampの正弦波(周期period) + 一様ノイズ±noise + spike_interval毎のスパイク
+void adc_dsp_ref_signal(int32_t *buf, int n, int32_t center, int32_t amp, int period, int32_t noise, int spike_interval, uint32_t seed);
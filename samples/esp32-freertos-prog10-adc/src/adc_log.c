@@ -0,0 +1,144 @@
+#include <string.h>
+#include "adc_log.h"
+
+void adc_log_init(adc_log_t *log, uint16_t channel, uint32_t period_us){
+  memset(log, 0, sizeof(*log));
+  log->filling = -1;
+  log->channel = channel;
+  log->period_us = period_us;
+  log->restart = true;
+}
+
+static adc_log_state_t get_state(const adc_log_t *log, int buf){
+  return (adc_log_state_t)__atomic_load_n(&log->state[buf], __ATOMIC_ACQUIRE);
+}
+
+static void set_state(adc_log_t *log, int buf, adc_log_state_t state){
+  __atomic_store_n(&log->state[buf], (uint8_t)state, __ATOMIC_RELEASE);
+}
+
+// 埋めているブロックを書き込み側に渡す
+static int close_block(adc_log_t *log){
+  int full = log->filling;
+  log->filling = -1;
+  set_state(log, full, ADC_LOG_FULL);
+  return full;
+}
+
+int adc_log_put(adc_log_t *log, uint16_t sample, int64_t timestamp_us){
+  uint64_t index = log->index++;
+  int full = -1;
+  if (log->filling >= 0) {
+    int64_t dt = timestamp_us - log->last_timestamp_us;
+    if (dt < 0 || dt > ADC_LOG_MAX_DT_US) {
+      // 差分を残せないので、ここでブロックを閉じて次のブロックのヘッダに時刻を書く
+      full = close_block(log);
+    }
+  }
+  if (log->filling < 0) {
+    int buf = get_state(log, 0) == ADC_LOG_FREE ? 0 : get_state(log, 1) == ADC_LOG_FREE ? 1 : -1;
+    if (buf < 0) {
+      log->dropped++;
+      log->gap = true;
+      return full;
+    }
+    adc_log_header_t *h = &log->blocks[buf].header;
+    memset(h, 0, sizeof(*h));
+    h->magic = ADC_LOG_MAGIC;
+    h->version = ADC_LOG_VERSION;
+    h->header_size = sizeof(adc_log_header_t);
+    h->seq = log->seq++;
+    h->first_index = index;
+    h->timestamp_us = timestamp_us;
+    h->period_us = log->period_us;
+    h->channel = log->channel;
+    h->flags = (log->gap ? ADC_LOG_FLAG_GAP : 0) | (log->restart ? ADC_LOG_FLAG_RESTART : 0);
+    h->dropped = log->dropped;
+    log->gap = false;
+    log->restart = false;
+    log->filling = buf;
+    log->last_timestamp_us = timestamp_us;
+    set_state(log, buf, ADC_LOG_FILLING);
+  }
+  adc_log_block_t *b = &log->blocks[log->filling];
+  adc_log_sample_t *s = &b->samples[b->header.count++];
+  s->value = sample;
+  s->dt_us = (uint16_t)(timestamp_us - log->last_timestamp_us);
+  log->last_timestamp_us = timestamp_us;
+  if (b->header.count < ADC_LOG_SAMPLES_PER_BLOCK) {
+    return full;
+  }
+  // 閉じたばかりなら新しいブロックは1サンプルなので、ここで2つ目を返すことはない
+  return close_block(log);
+}
+
+// crc欄を0としたブロック全体のCRC(crcはヘッダの最後)
+static uint32_t block_crc(const adc_log_block_t *b){
+  static const uint8_t zero[sizeof(b->header.crc)];
+  uint32_t crc = adc_log_crc32(0, &b->header, offsetof(adc_log_header_t, crc));
+  crc = adc_log_crc32(crc, zero, sizeof(zero));
+  return adc_log_crc32(crc, b->samples, sizeof(b->samples));
+}
+
+adc_log_block_t *adc_log_take(adc_log_t *log, int buf){
+  if (buf < 0 || buf > 1 || get_state(log, buf) != ADC_LOG_FULL) {
+    return NULL;
+  }
+  adc_log_block_t *b = &log->blocks[buf];
+  b->header.crc = block_crc(b);
+  return b;
+}
+
+void adc_log_release(adc_log_t *log, int buf){
+  set_state(log, buf, ADC_LOG_FREE);
+}
+
+// 4bitずつのテーブル(64バイト)で計算する
+uint32_t adc_log_crc32(uint32_t crc, const void *data, size_t len){
+  static const uint32_t table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+  };
+  const uint8_t *p = (const uint8_t *)data;
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= p[i];
+    crc = (crc >> 4) ^ table[crc & 0xf];
+    crc = (crc >> 4) ^ table[crc & 0xf];
+  }
+  return ~crc;
+}
+
+bool adc_log_block_valid(const adc_log_block_t *block){
+  const adc_log_header_t *h = &block->header;
+  if (h->magic != ADC_LOG_MAGIC || h->version != ADC_LOG_VERSION || h->header_size != sizeof(adc_log_header_t) ||
+      h->count > ADC_LOG_SAMPLES_PER_BLOCK) {
+    return false;
+  }
+  return block_crc(block) == h->crc;
+}
+
+void adc_log_scan_init(adc_log_scan_t *scan){
+  memset(scan, 0, sizeof(*scan));
+}
+
+void adc_log_scan_block(adc_log_scan_t *scan, uint32_t block_no, const adc_log_block_t *block){
+  if (!adc_log_block_valid(block)) {
+    return;
+  }
+  const adc_log_header_t *h = &block->header;
+  if (scan->found && (int32_t)(h->seq - scan->seq) <= 0) {
+    return;
+  }
+  scan->found = true;
+  scan->block_no = block_no;
+  scan->seq = h->seq;
+  scan->next_index = h->first_index + h->count;
+}
+
+void adc_log_resume(adc_log_t *log, const adc_log_scan_t *scan){
+  if (scan->found) {
+    log->seq = scan->seq + 1;
+    log->index = scan->next_index;
+  }
+}
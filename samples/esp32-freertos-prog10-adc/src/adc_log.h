@@ -0,0 +1,107 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// ADCのサンプルを長時間記録するためのブロック形式とダブルバッファ（ロジック部分）
+//
+// 記録は4KB(フラッシュの消去単位)のブロックの並び。ブロックはヘッダと(値, 前のサンプルからの時間)の組
+//   ヘッダ: magic "ADCL", 版, ブロックの通し番号, サンプル数, 最初のサンプルの通し番号と時刻,
+//           サンプリング周期, チャンネル, 捨てたサンプル数, CRC-32(ブロック全体、crc欄は0として)
+//   読み出しは tools/adc_log_read.py
+// フラッシュの消去/書き込みの間はキャッシュが止まり、フラッシュにあるサンプリングのタスクも止まる
+// 戻ってから遅れた分をまとめて読むので、サンプルの間隔は周期どおりではない。サンプル毎に実際の時刻(差分)を残す
+// 差分がuint16に収まらないとき(65ms以上止まった)は、そこでブロックを閉じて次のブロックのヘッダに時刻を書く
+//
+// サンプリング側(adc_log_put)と書き込み側(adc_log_take/release)は別のタスクから呼ぶ
+// バッファは2つで、サンプリング側が片方を埋めている間にもう片方を書き込む
+// 書き込みが間に合わず空きがないときは、待たずにサンプルを捨てて数える(サンプリングは止めない)
+// ESP-IDFに依存しないので、ホストでも確認できる
+
+#define ADC_LOG_BLOCK_SIZE   4096
+#define ADC_LOG_MAGIC        0x4C434441u   // "ADCL"
+#define ADC_LOG_VERSION      2
+#define ADC_LOG_MAX_DT_US    UINT16_MAX
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size;
+  uint32_t seq;              // ブロックの通し番号(0から)
+  uint32_t count;            // サンプル数
+  uint64_t first_index;      // 最初のサンプルの通し番号(捨てたサンプルも数える)
+  int64_t timestamp_us;      // 最初のサンプルの時刻
+  uint32_t period_us;        // サンプリング周期
+  uint16_t channel;
+  uint16_t flags;            // ADC_LOG_FLAG_*
+  uint32_t dropped;          // それまでに捨てたサンプル数(累計)
+  uint32_t crc;
+} adc_log_header_t;
+
+#define ADC_LOG_FLAG_GAP     0x0001   // 直前のブロックとの間にサンプルを捨てた
+#define ADC_LOG_FLAG_RESTART 0x0002   // 起動して最初のブロック(時刻は起動からなので、前のブロックと続かない)
+
+typedef struct __attribute__((packed)) {
+  uint16_t value;
+  uint16_t dt_us;            // 前のサンプルからの時間(ブロックの最初は0)
+} adc_log_sample_t;
+
+#define ADC_LOG_SAMPLES_PER_BLOCK ((ADC_LOG_BLOCK_SIZE - sizeof(adc_log_header_t)) / sizeof(adc_log_sample_t))
+
+typedef struct {
+  adc_log_header_t header;
+  adc_log_sample_t samples[ADC_LOG_SAMPLES_PER_BLOCK];
+} adc_log_block_t;
+
+_Static_assert(sizeof(adc_log_block_t) == ADC_LOG_BLOCK_SIZE, "block must be one flash sector");
+_Static_assert(offsetof(adc_log_header_t, crc) + sizeof(uint32_t) == sizeof(adc_log_header_t), "crc must be the last header field");
+
+typedef enum {
+  ADC_LOG_FREE,
+  ADC_LOG_FILLING,
+  ADC_LOG_FULL,
+} adc_log_state_t;
+
+typedef struct {
+  adc_log_block_t blocks[2] __attribute__((aligned(4)));
+  uint8_t state[2];          // adc_log_state_t、2つのタスクから読み書きするので__atomicで触る
+  int filling;               // サンプリング側が埋めているバッファ、-1ならなし
+  uint32_t seq;
+  uint64_t index;            // 次のサンプルの通し番号
+  int64_t last_timestamp_us; // 最後に追加したサンプルの時刻
+  uint32_t dropped;
+  bool gap;
+  bool restart;
+  uint16_t channel;
+  uint32_t period_us;
+} adc_log_t;
+
+void adc_log_init(adc_log_t *log, uint16_t channel, uint32_t period_us);
+
+// サンプリング側: 1サンプル追加する。timestamp_usはそのサンプルを読んだ時刻
+// ブロックが埋まった(または前のサンプルから時間が空きすぎて閉じた)らそのバッファ番号(0/1)を返す(書き込み側に渡す)
+// 埋まっていなければ-1。空きバッファがなければ捨ててdroppedを増やす
+int adc_log_put(adc_log_t *log, uint16_t sample, int64_t timestamp_us);
+// 書き込み側: 埋まったバッファのCRCを計算して返す。書き終わったらadc_log_release()
+adc_log_block_t *adc_log_take(adc_log_t *log, int buf);
+void adc_log_release(adc_log_t *log, int buf);
+
+// CRC-32(IEEE 802.3、zlibのcrc32と同じ)
+uint32_t adc_log_crc32(uint32_t crc, const void *data, size_t len);
+// ブロックの確認(magic、版、サンプル数、CRC)
+bool adc_log_block_valid(const adc_log_block_t *block);
+
+// 前回の記録の続きから書くための走査
+// 記録先のブロックを順にadc_log_scan_block()に渡すと、正しいブロックのうち通し番号が最大のものの位置を覚える
+// (消去したままのブロックや、書き込み中に電源が切れたブロックはCRCで除く)
+typedef struct {
+  bool found;
+  uint32_t block_no;         // 一番新しいブロックの位置(次はその次の位置に書く)
+  uint32_t seq;
+  uint64_t next_index;       // 一番新しいブロックの次のサンプルの通し番号
+} adc_log_scan_t;
+
+void adc_log_scan_init(adc_log_scan_t *scan);
+void adc_log_scan_block(adc_log_scan_t *scan, uint32_t block_no, const adc_log_block_t *block);
+// 走査の結果から、ブロックとサンプルの通し番号を続ける(adc_log_init()の後、最初のサンプルの前に呼ぶ)
+void adc_log_resume(adc_log_t *log, const adc_log_scan_t *scan);
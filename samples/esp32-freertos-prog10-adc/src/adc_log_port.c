@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#if !CONFIG_SIM_HOST
+#include "esp_partition.h"
+#endif
+#include "adc_log_port.h"
+
+static const char *TAG = "adc_log";
+
+typedef struct {
+  adc_log_storage_type_t type;
+#if !CONFIG_SIM_HOST
+  const esp_partition_t *part;
+#endif
+  FILE *fp;
+  uint32_t offset;
+} storage_t;
+
+static storage_t storage;
+// 走査と書き込み速度の測定で使う(4KBなのでスタックに置かない)
+static adc_log_block_t work_block;
+static adc_log_t *logger;
+static QueueHandle_t full_queue;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static adc_log_stats_t stats;
+
+//------------------------
+// 記録先
+//------------------------
+// scanがNULLでなければ、前回の記録を走査して一番新しいブロックの次から書く(上書きするのは一番古いブロック)
+// NULLなら先頭から書く(ファイルは作り直す)
+static esp_err_t storage_open(storage_t *s, const adc_log_storage_config_t *config, adc_log_scan_t *scan){
+  memset(s, 0, sizeof(*s));
+  s->type = config->type;
+  if (scan) {
+    adc_log_scan_init(scan);
+  }
+  if (config->type == ADC_LOG_STORAGE_PARTITION) {
+#if CONFIG_SIM_HOST
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    s->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, config->name);
+    if (s->part == NULL) {
+      ESP_LOGE(TAG, "partition %s not found", config->name);
+      return ESP_ERR_NOT_FOUND;
+    }
+    uint32_t num_blocks = s->part->size / ADC_LOG_BLOCK_SIZE;
+    ESP_LOGI(TAG, "partition %s: %lu blocks", config->name, (unsigned long)num_blocks);
+    if (scan) {
+      for (uint32_t i = 0; i < num_blocks; i++) {
+        if (esp_partition_read(s->part, i * ADC_LOG_BLOCK_SIZE, &work_block, ADC_LOG_BLOCK_SIZE) == ESP_OK) {
+          adc_log_scan_block(scan, i, &work_block);
+        }
+      }
+      if (scan->found) {
+        s->offset = (scan->block_no + 1) % num_blocks * ADC_LOG_BLOCK_SIZE;
+      }
+    }
+    return ESP_OK;
+#endif
+  }
+  if (scan) {
+    // 既存のファイルは残して、一番新しいブロックの次から書く
+    s->fp = fopen(config->name, "r+b");
+    if (s->fp) {
+      for (uint32_t i = 0; fread(&work_block, ADC_LOG_BLOCK_SIZE, 1, s->fp) == 1; i++) {
+        adc_log_scan_block(scan, i, &work_block);
+      }
+      if (scan->found) {
+        s->offset = (scan->block_no + 1) * ADC_LOG_BLOCK_SIZE;
+      }
+      fseek(s->fp, s->offset, SEEK_SET);
+    }
+  }
+  if (s->fp == NULL) {
+    s->fp = fopen(config->name, "w+b");
+  }
+  if (s->fp == NULL) {
+    ESP_LOGE(TAG, "failed to open %s", config->name);
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+// 1ブロック(4KB)書く。パーティションはセクタと同じ大きさなので、そのセクタだけ消して書く
+static esp_err_t storage_write(storage_t *s, const void *block){
+#if !CONFIG_SIM_HOST
+  if (s->type == ADC_LOG_STORAGE_PARTITION) {
+    if (s->offset + ADC_LOG_BLOCK_SIZE > s->part->size) {
+      s->offset = 0;
+    }
+    esp_err_t ret = esp_partition_erase_range(s->part, s->offset, ADC_LOG_BLOCK_SIZE);
+    if (ret == ESP_OK) {
+      ret = esp_partition_write(s->part, s->offset, block, ADC_LOG_BLOCK_SIZE);
+    }
+    s->offset += ADC_LOG_BLOCK_SIZE;
+    return ret;
+  }
+#endif
+  if (fwrite(block, ADC_LOG_BLOCK_SIZE, 1, s->fp) != 1 || fflush(s->fp) != 0) {
+    return ESP_FAIL;
+  }
+  s->offset += ADC_LOG_BLOCK_SIZE;
+  return ESP_OK;
+}
+
+static void storage_close(storage_t *s){
+  if (s->fp) {
+    fclose(s->fp);
+    s->fp = NULL;
+  }
+}
+
+//------------------------
+// 書き込みタスク
+//------------------------
+static void writer_task(void *pvParameters){
+  int buf;
+  while (1) {
+    xQueueReceive(full_queue, &buf, portMAX_DELAY);
+    adc_log_block_t *block = adc_log_take(logger, buf);
+    if (block == NULL) {
+      continue;
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = storage_write(&storage, block);
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    uint32_t dropped = block->header.dropped;
+    adc_log_release(logger, buf);
+
+    taskENTER_CRITICAL(&stats_lock);
+    if (ret == ESP_OK) {
+      stats.blocks++;
+    } else {
+      stats.errors++;
+    }
+    stats.dropped = dropped;
+    stats.write_us_total += elapsed;
+    if (elapsed > stats.write_us_max) {
+      stats.write_us_max = elapsed;
+    }
+    taskEXIT_CRITICAL(&stats_lock);
+  }
+}
+
+esp_err_t adc_log_port_start(adc_log_t *log, const adc_log_storage_config_t *config, UBaseType_t priority, BaseType_t core){
+  adc_log_scan_t scan;
+  esp_err_t ret = storage_open(&storage, config, &scan);
+  if (ret != ESP_OK) {
+    return ret;
+  }
+  adc_log_resume(log, &scan);
+  if (scan.found) {
+    ESP_LOGI(TAG, "resume after seq %lu (block %lu)", (unsigned long)scan.seq, (unsigned long)scan.block_no);
+  }
+  logger = log;
+  // バッファは2つなので、キューも2つあれば足りる
+  full_queue = xQueueCreate(2, sizeof(int));
+  if (full_queue == NULL || xTaskCreatePinnedToCore(writer_task, "adc_log_writer", 4096, NULL, priority, NULL, core) != pdPASS) {
+    storage_close(&storage);
+    return ESP_ERR_NO_MEM;
+  }
+  ESP_LOGI(TAG, "logging to %s (%u samples/block)", config->name, (unsigned)ADC_LOG_SAMPLES_PER_BLOCK);
+  return ESP_OK;
+}
+
+void adc_log_port_submit(int buf){
+  if (buf >= 0) {
+    // 空きがないことはない(FULLのバッファは高々2つ)が、念のため待たない
+    xQueueSend(full_queue, &buf, 0);
+  }
+}
+
+void adc_log_port_get_stats(adc_log_stats_t *out){
+  taskENTER_CRITICAL(&stats_lock);
+  *out = stats;
+  taskEXIT_CRITICAL(&stats_lock);
+}
+
+esp_err_t adc_log_port_bench(const adc_log_storage_config_t *config, int blocks, uint32_t *kbytes_per_s){
+  storage_t s;
+  esp_err_t ret = storage_open(&s, config, NULL);
+  if (ret != ESP_OK) {
+    return ret;
+  }
+  memset(&work_block, 0xa5, sizeof(work_block));
+  int64_t total_us = 0;
+  for (int i = 0; i < blocks && ret == ESP_OK; i++) {
+    int64_t start = esp_timer_get_time();
+    ret = storage_write(&s, &work_block);
+    total_us += esp_timer_get_time() - start;
+  }
+  storage_close(&s);
+  *kbytes_per_s = total_us > 0 ? (uint32_t)((uint64_t)blocks * ADC_LOG_BLOCK_SIZE * 1000000 / 1024 / total_us) : 0;
+  return ret;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include "esp_err.h"
+#include "adc_log.h"
+
+// ADCの記録(ESP-IDF部分)
+// 書き込みタスクが、埋まったブロックをキューで受け取ってCRCを付けて記録先に書く
+// サンプリング側はadc_log_put()が返したバッファ番号をadc_log_port_submit()で渡すだけで待たない
+//
+// 記録先
+//   パーティション: partitions.csvのadclog。4KBのセクタ毎に消去して書き、最後まで行ったら先頭に戻る
+//                   読み出しは parttool.py read_partition --partition-name adclog --output adclog.bin
+//   ファイル      : SDカード(VFSでマウントしたパス)やホストのファイルに追記する
+// 起動時に記録先を走査して、前回の一番新しいブロック(通し番号が最大)の次から続ける
+// ホスト(CONFIG_SIM_HOST)ではパーティションは使えないのでファイルにする
+
+typedef enum {
+  ADC_LOG_STORAGE_PARTITION,
+  ADC_LOG_STORAGE_FILE,
+} adc_log_storage_type_t;
+
+typedef struct {
+  adc_log_storage_type_t type;
+  const char *name;          // パーティションのラベル、またはファイルのパス
+} adc_log_storage_config_t;
+
+typedef struct {
+  uint32_t blocks;           // 書いたブロック数
+  uint32_t errors;           // 書き込みに失敗したブロック数
+  uint32_t dropped;          // サンプリング側で捨てたサンプル数
+  uint32_t write_us_max;     // 1ブロックの書き込み時間(消去を含む)
+  uint64_t write_us_total;
+} adc_log_stats_t;
+
+// 記録先を開いて書き込みタスクを作る
+esp_err_t adc_log_port_start(adc_log_t *log, const adc_log_storage_config_t *storage, UBaseType_t priority, BaseType_t core);
+// サンプリング側から呼ぶ。buf < 0 なら何もしない
+void adc_log_port_submit(int buf);
+void adc_log_port_get_stats(adc_log_stats_t *stats);
+
+// 書き込み速度の測定: ダミーのブロックをblocks個、先頭から続けて書いて[KB/s]を返す(記録を始める前に呼ぶ)
+// 記録を壊さないように、記録とは別の記録先(パーティション/ファイル)を渡す
+esp_err_t adc_log_port_bench(const adc_log_storage_config_t *storage, int blocks, uint32_t *kbytes_per_s);
@@ -11,6 +11,11 @@
 #include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 #include <math.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "adc_dsp.h"
+#include "adc_dsp_ref.h"
+#include "adc_log_port.h"
 
 #define TWDT_TIMEOUT_MS 2000
 
@@ -97,8 +102,146 @@ void delay_ms(uint32_t ms){
 // 1034.0 	1028.0 	6.0 	3.6 
 // 1756.0 	1748.0 	8.0 	4.5 
 
+//------------------------
+// フィルタ(adc_dsp.c)
+//------------------------
+// メディアン5でスパイクを消して、4個平均(+1bit) -> 3段CICで1/4 -> 2次ローパス
+// 入力16サンプルで出力1つ
+#define DSP_BLOCK      256
+#define DSP_TEST_LEN   4096
+#define DSP_BENCH_ITER 20
+
+static adc_dsp_config_t dsp_config = {
+  .median_window = 5,
+  .oversample = 4,
+  .oversample_shift = 1,
+  .cic_order = 3,
+  .cic_decimation = 4,
+};
+static adc_dsp_t dsp;
+static int32_t dsp_test_in[DSP_TEST_LEN];
+static int32_t dsp_buf[DSP_TEST_LEN];
+static float dsp_out[DSP_TEST_LEN] __attribute__((aligned(16)));
+
+// 参照実装(adc_dsp_ref.c)と比べる。ブロックの区切り方を変えても同じ結果になること
+static void dsp_selftest(void){
+  static const int chunks[] = {1, 37, DSP_BLOCK, DSP_TEST_LEN};
+  for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+    double err = adc_dsp_ref_compare(&dsp_config, dsp_test_in, DSP_TEST_LEN, chunks[i]);
+    ESP_LOGI(TAG, "dsp selftest chunk=%d max_err=%.6f", chunks[i], err);
+    // biquadはfloatとdoubleの差だけ(生の値で0.01未満)
+    if (err < 0 || err > 0.01) {
+      ESP_LOGE(TAG, "dsp selftest failed");
+      abort();
+    }
+  }
+}
+
+// 段毎の処理速度[samples/s](入力のサンプル数で数える)
+// ホストの値は sim_prog10 --clock real で見る(--clock tickだと処理中に時間が進まないので0になる)
+static void dsp_bench_one(const char *name, int stage){
+  int64_t total_us = 0;
+  for (int iter = 0; iter < DSP_BENCH_ITER; iter++) {
+    memcpy(dsp_buf, dsp_test_in, sizeof(dsp_buf));
+    for (int i = 0; i < DSP_TEST_LEN; i++) {
+      dsp_out[i] = (float)dsp_test_in[i];
+    }
+    adc_dsp_reset(&dsp);
+    int64_t start = esp_timer_get_time();
+    switch (stage) {
+    case 0: adc_dsp_median(&dsp, dsp_buf, DSP_TEST_LEN); break;
+    case 1: adc_dsp_oversample(&dsp, dsp_buf, DSP_TEST_LEN); break;
+    case 2: adc_dsp_cic(&dsp, dsp_buf, DSP_TEST_LEN); break;
+    case 3: adc_dsp_biquad_c(dsp_out, dsp_out, DSP_TEST_LEN, dsp_config.biquad, dsp.biquad_w); break;
+    case 4: adc_dsp_biquad(dsp_out, dsp_out, DSP_TEST_LEN, dsp_config.biquad, dsp.biquad_w); break;
+    default:
+      for (int i = 0; i < DSP_TEST_LEN; i += DSP_BLOCK) {
+        adc_dsp_process(&dsp, &dsp_buf[i], DSP_BLOCK, &dsp_out[i]);
+      }
+      break;
+    }
+    total_us += esp_timer_get_time() - start;
+  }
+  uint64_t samples = (uint64_t)DSP_TEST_LEN * DSP_BENCH_ITER;
+  ESP_LOGI(TAG, "dsp bench %-12s %10llu samples/s", name,
+    (unsigned long long)(total_us > 0 ? samples * 1000000 / total_us : 0));
+}
+
+static void dsp_bench(void){
+  ESP_LOGI(TAG, "dsp bench esp-dsp=%s", ADC_DSP_HAVE_ESP_DSP ? "yes" : "no (portable C)");
+  dsp_bench_one("median5", 0);
+  dsp_bench_one("oversample4", 1);
+  dsp_bench_one("cic3x4", 2);
+  dsp_bench_one("biquad_c", 3);
+  dsp_bench_one("biquad", 4);
+  dsp_bench_one("pipeline", 5);
+}
+
+static void dsp_setup(void){
+  // ローパスは出力のサンプリング周波数の1/20
+  adc_dsp_biquad_lowpass(dsp_config.biquad, 0.05f, 0.707f);
+  if (!adc_dsp_init(&dsp, &dsp_config)) {
+    ESP_LOGE(TAG, "invalid dsp config");
+    abort();
+  }
+  // 2000を中心に振幅300、ノイズ±20、97サンプル毎にスパイク
+  adc_dsp_ref_signal(dsp_test_in, DSP_TEST_LEN, 2000, 300, 200, 20, 97, 1);
+  dsp_selftest();
+  dsp_bench();
+  adc_dsp_reset(&dsp);
+}
+
+//------------------------
+// 記録(adc_log.c)
+//------------------------
+// 1kHzで全サンプルを4KBブロックにまとめて書く(1ブロック約1秒)
+// 実機はフラッシュのadclogパーティション(partitions.csv)、ホストはカレントディレクトリのadc_log.bin
+// 再起動しても前回の記録の続きから書く。読み出しは tools/adc_log_read.py
+#define LOG_PERIOD_MS      1
+#define ADC_TASK_PRIORITY  5
+// 1: 記録を始める前に書き込み速度を測る。記録とは別の領域(adcbenchパーティション/adc_log_bench.bin)に書く
+#define LOG_BENCH          0
+#define LOG_BENCH_BLOCKS   16
+#if CONFIG_SIM_HOST
+static const adc_log_storage_config_t log_storage = {ADC_LOG_STORAGE_FILE, "adc_log.bin"};
+static const adc_log_storage_config_t bench_storage = {ADC_LOG_STORAGE_FILE, "adc_log_bench.bin"};
+#else
+static const adc_log_storage_config_t log_storage = {ADC_LOG_STORAGE_PARTITION, "adclog"};
+static const adc_log_storage_config_t bench_storage = {ADC_LOG_STORAGE_PARTITION, "adcbench"};
+#endif
+static adc_log_t adc_logger;
+
+static void log_setup(void){
+#if LOG_BENCH
+  uint32_t kbps = 0;
+  ESP_ERROR_CHECK(adc_log_port_bench(&bench_storage, LOG_BENCH_BLOCKS, &kbps));
+  ESP_LOGI(TAG, "log bench %s: %d blocks %lu KB/s", bench_storage.name, LOG_BENCH_BLOCKS, (unsigned long)kbps);
+#else
+  (void)bench_storage;
+#endif
+  adc_log_init(&adc_logger, EXAMPLE_ADC_CHANNEL, LOG_PERIOD_MS * 1000);
+  // 書き込みはサンプリング(ADC_TASK_PRIORITY)より低い優先度にして、サンプリングを邪魔しない
+  // ただし消去と書き込みの間はフラッシュのキャッシュが止まるので、フラッシュにあるサンプリングのコードも止まる
+  // (vTaskDelayUntilなので、戻ったら遅れた分をまとめて読む。間隔は周期どおりにならないので、サンプル毎に読んだ時刻を記録する)
+  ESP_ERROR_CHECK(adc_log_port_start(&adc_logger, &log_storage, ADC_TASK_PRIORITY - 1, APP_CPU_NUM));
+}
+
+static void calc_stats(const float *v, int n, float *mean, float *std){
+  double sum = 0, sumsq = 0;
+  for (int i = 0; i < n; i++) {
+    sum += v[i];
+    sumsq += (double)v[i] * v[i];
+  }
+  *mean = n ? sum / n : 0;
+  *std = n ? sqrt(fabs(sumsq / n - (double)*mean * *mean)) : 0;
+}
+
 void adc1_oneshot_task(void *pvParameters){
   esp_err_t ret = ESP_FAIL;
+  // フィルタの確認とベンチマーク(TWDTで見ていないAPP_CPUで行う)
+  dsp_setup();
+  log_setup();
+
   //------------------------
   // ADC1 initialize
   //------------------------
@@ -175,8 +318,44 @@ void adc1_oneshot_task(void *pvParameters){
   float mean = sum/100.0;
   float stdnum = sqrt(fabs(sumsq/100.0 - mean * mean));
   ESP_LOGI(TAG, "mean = %.3f, std = %.3f", mean, stdnum);
+
+  // ここからは1kHzで読み続けて、全サンプルを記録(adc_log)に流す
+  // 記録の書き込みは別タスクなので、ここはストレージを待たない
+  // DSP_BLOCK個毎にフィルタにも通して、約1秒毎にフィルタの前後のばらつきと記録の状況を出す
+  static int32_t block[DSP_BLOCK];
+  static float raw[DSP_BLOCK];
+  static float filtered[DSP_BLOCK] __attribute__((aligned(16)));
+  int filled = 0;
+  int blocks = 0;
+  TickType_t last_wake = xTaskGetTickCount();
   while (1) {
-    delay_ms(1000);
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(LOG_PERIOD_MS));
+    ESP_ERROR_CHECK(adc_oneshot_read(adc1_handle, EXAMPLE_ADC_CHANNEL, &adc_raw));
+    adc_log_port_submit(adc_log_put(&adc_logger, (uint16_t)adc_raw, esp_timer_get_time()));
+    block[filled] = adc_raw;
+    raw[filled] = adc_raw;
+    if (++filled < DSP_BLOCK) {
+      continue;
+    }
+    filled = 0;
+    int n = adc_dsp_process(&dsp, block, DSP_BLOCK, filtered);
+    if (++blocks % (1000 / LOG_PERIOD_MS / DSP_BLOCK) != 0) {
+      continue;
+    }
+    float raw_mean, raw_std, f_mean, f_std;
+    calc_stats(raw, DSP_BLOCK, &raw_mean, &raw_std);
+    calc_stats(filtered, n, &f_mean, &f_std);
+    voltage = 0;
+    if (calibrated && n > 0) {
+      ESP_ERROR_CHECK(adc_cali_raw_to_voltage(adc1_calibration_handle, (int)lroundf(filtered[n - 1]), &voltage));
+    }
+    ESP_LOGI(TAG, "raw mean=%.1f std=%.2f / filtered(%d) mean=%.1f std=%.2f last=%d [mV]",
+      raw_mean, raw_std, n, f_mean, f_std, voltage);
+    adc_log_stats_t st;
+    adc_log_port_get_stats(&st);
+    ESP_LOGI(TAG, "log blocks=%lu errors=%lu dropped=%lu write avg=%lu max=%lu [us/block]",
+      (unsigned long)st.blocks, (unsigned long)st.errors, (unsigned long)st.dropped,
+      (unsigned long)(st.blocks ? st.write_us_total / st.blocks : 0), (unsigned long)st.write_us_max);
   }
 }
 
@@ -192,7 +371,7 @@ void app_main(){
   };
   ESP_ERROR_CHECK(esp_task_wdt_init(&twdt_config));
 
-  xTaskCreatePinnedToCore(adc1_oneshot_task, "adc1_oneshot_task", 8192, NULL, 1, &taskHandle, APP_CPU_NUM);
+  xTaskCreatePinnedToCore(adc1_oneshot_task, "adc1_oneshot_task", 8192, NULL, ADC_TASK_PRIORITY, &taskHandle, APP_CPU_NUM);
 
   ESP_LOGI(TAG, "<=== app_main end");
 }
@@ -0,0 +1,162 @@
+import struct
+import sys
+import zlib
+
+# prog10の記録(src/adc_log.h の4KBブロックの並び)を読んで確認する
+#
+# > python -m esptool --chip esp32s3 read_flash 0x110000 0xF0000 adclog.bin   (実機のadclogパーティション)
+# > python tools/adc_log_read.py adclog.bin
+# > python tools/adc_log_read.py adc_log.bin --csv samples.csv --strict    (host-simの出力)
+#
+# 全部0xFFのブロックは未使用として飛ばす。パーティションは先頭に戻って上書きするので、通し番号(seq)で並べ直す
+# 版2はサンプル毎に前のサンプルからの時間を持つので、時刻はそれを足していく(版1は周期どおりとみなす)
+# 時刻は起動からなので、再起動したブロック(FLAG_RESTART)で戻る
+# --csv   : index,time_us,value を書き出す(捨てたサンプルは行がない)
+# --strict: CRCやヘッダの不正、seqの抜け、サンプルの抜けがあれば終了コード1にする
+
+BLOCK_SIZE = 4096
+MAGIC = 0x4C434441
+VERSIONS = (1, 2)
+HEADER = struct.Struct("<IHHIIQqIHHII")
+CRC_OFFSET = 44
+FLAG_GAP = 0x0001
+FLAG_RESTART = 0x0002
+
+
+def parse_args(argv):
+    args = {"input": None, "csv": None, "strict": False}
+    i = 0
+    while i < len(argv):
+        a = argv[i]
+        if a == "--csv" and i + 1 < len(argv):
+            args["csv"] = argv[i + 1]
+            i += 2
+        elif a == "--strict":
+            args["strict"] = True
+            i += 1
+        else:
+            args["input"] = a
+            i += 1
+    return args
+
+
+def parse_block(data):
+    (magic, version, header_size, seq, count, first_index, timestamp_us,
+     period_us, channel, flags, dropped, crc) = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        return None, "bad magic"
+    if version not in VERSIONS or header_size != HEADER.size:
+        return None, "unknown version %d (header %d)" % (version, header_size)
+    sample_size = 2 if version == 1 else 4
+    if count > (BLOCK_SIZE - header_size) // sample_size:
+        return None, "bad count %d" % count
+    # crc欄を0にしてブロック全体を計算する
+    if zlib.crc32(data[:CRC_OFFSET] + b"\0\0\0\0" + data[CRC_OFFSET + 4:]) != crc:
+        return None, "crc mismatch"
+    if version == 1:
+        samples = struct.unpack_from("<%dH" % count, data, header_size)
+        times = [timestamp_us + i * period_us for i in range(count)]
+    else:
+        pairs = struct.unpack_from("<%dH" % (count * 2), data, header_size)
+        samples = pairs[0::2]
+        times = []
+        t = timestamp_us
+        for dt in pairs[1::2]:
+            t += dt
+            times.append(t)
+    return {
+        "seq": seq, "first_index": first_index, "timestamp_us": timestamp_us,
+        "period_us": period_us, "channel": channel, "flags": flags,
+        "dropped": dropped, "samples": samples, "times": times,
+    }, None
+
+
+def read_blocks(path):
+    blocks = []
+    errors = []
+    with open(path, "rb") as f:
+        data = f.read()
+    for offset in range(0, len(data) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        chunk = data[offset:offset + BLOCK_SIZE]
+        if chunk.count(b"\xff") == BLOCK_SIZE:
+            continue
+        block, error = parse_block(chunk)
+        if error:
+            errors.append("offset 0x%x: %s" % (offset, error))
+        else:
+            blocks.append(block)
+    if len(data) % BLOCK_SIZE:
+        errors.append("trailing %d bytes (incomplete block)" % (len(data) % BLOCK_SIZE))
+    blocks.sort(key=lambda b: b["seq"])
+    return blocks, errors
+
+
+def check_continuity(blocks):
+    errors = []
+    for prev, b in zip(blocks, blocks[1:]):
+        if b["seq"] != prev["seq"] + 1:
+            errors.append("seq %d -> %d: %d blocks missing" % (prev["seq"], b["seq"], b["seq"] - prev["seq"] - 1))
+            continue
+        expected = prev["first_index"] + len(prev["samples"])
+        if b["first_index"] != expected:
+            lost = b["first_index"] - expected
+            kind = "dropped by logger" if b["flags"] & FLAG_GAP else "unexpected"
+            errors.append("seq %d: %d samples missing (%s)" % (b["seq"], lost, kind))
+    return errors
+
+
+def write_csv(path, blocks):
+    with open(path, "w") as f:
+        f.write("index,time_us,value\n")
+        for b in blocks:
+            for i, (t, v) in enumerate(zip(b["times"], b["samples"])):
+                f.write("%d,%d,%d\n" % (b["first_index"] + i, t, v))
+
+
+def interval_stats(blocks):
+    """サンプルの間隔の最大と、周期の1.5倍を超えた回数(フラッシュの書き込みなどで遅れた)"""
+    max_us = 0
+    late = 0
+    prev = None
+    for b in blocks:
+        if b["flags"] & (FLAG_GAP | FLAG_RESTART):
+            prev = None
+        for t in b["times"]:
+            if prev is not None:
+                dt = t - prev
+                max_us = max(max_us, dt)
+                late += dt * 2 > b["period_us"] * 3
+            prev = t
+    return max_us, late
+
+
+def main():
+    args = parse_args(sys.argv[1:])
+    if not args["input"]:
+        print("usage: adc_log_read.py <log.bin> [--csv out.csv] [--strict]")
+        return 2
+    blocks, errors = read_blocks(args["input"])
+    errors += check_continuity(blocks)
+    for e in errors:
+        print("ERROR " + e)
+    if not blocks:
+        print("no valid blocks")
+        return 1
+    values = [v for b in blocks for v in b["samples"]]
+    first, last = blocks[0], blocks[-1]
+    # 再起動で時刻が戻るので、ブロック毎の長さを足す
+    duration_us = sum(b["times"][-1] - b["times"][0] + b["period_us"] for b in blocks if b["times"])
+    restarts = sum(1 for b in blocks if b["flags"] & FLAG_RESTART)
+    max_interval, late = interval_stats(blocks)
+    print("blocks=%d (seq %d..%d) errors=%d channel=%d period=%dus restarts=%d" % (
+        len(blocks), first["seq"], last["seq"], len(errors), first["channel"], first["period_us"], restarts))
+    print("samples=%d duration=%.3fs dropped=%d" % (len(values), duration_us / 1e6, last["dropped"]))
+    print("interval max=%dus late=%d" % (max_interval, late))
+    print("min=%d max=%d mean=%.1f" % (min(values), max(values), sum(values) / len(values)))
+    if args["csv"]:
+        write_csv(args["csv"], blocks)
+    return 1 if args["strict"] and errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
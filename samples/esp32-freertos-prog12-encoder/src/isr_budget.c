@@ -0,0 +1,41 @@
+#include <string.h>
+#include "isr_budget.h"
+
+#define RATE_PERIOD_US   1000000
+
+void isr_budget_init(isr_budget_t *b, const char *name, const isr_budget_config_t *config, uint32_t cycles_per_us, int64_t now_us){
+  memset(b, 0, sizeof(*b));
+  b->name = name;
+  b->config = *config;
+  b->cycles_per_us = cycles_per_us;
+  b->period_start_us = now_us;
+  b->rate_start_us = now_us;
+  b->backoff_us = config->mask_us;
+  b->unmask_us = now_us - ISR_BUDGET_BACKOFF_RESET_US;
+}
+
+bool isr_budget_poll(isr_budget_t *b, int64_t now_us){
+  int64_t elapsed = now_us - b->rate_start_us;
+  if (elapsed >= RATE_PERIOD_US) {
+    b->stats.rate_hz = (uint32_t)((uint64_t)b->rate_count * RATE_PERIOD_US / elapsed);
+    b->stats.cpu_permille = (uint32_t)(b->rate_cycles * 1000 / ((uint64_t)elapsed * b->cycles_per_us));
+    b->rate_start_us = now_us;
+    b->rate_count = 0;
+    b->rate_cycles = 0;
+  }
+  return b->masked && now_us >= b->unmask_us;
+}
+
+void isr_budget_unmasked(isr_budget_t *b, int64_t now_us){
+  b->masked = false;
+  b->stats.masked_us += (uint32_t)(now_us - b->masked_since_us);
+  b->unmask_us = now_us;
+  b->period_start_us = now_us;
+  b->period_count = 0;
+  b->period_cycles = 0;
+}
+
+void isr_budget_get_stats(const isr_budget_t *b, isr_budget_stats_t *stats){
+  *stats = b->stats;
+  stats->masked = b->masked;
+}
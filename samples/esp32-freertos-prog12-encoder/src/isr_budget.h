@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// 割込みの発生源毎の予算(ロジック部分)
+//
+// ハンドラ1回毎に、かかったCPUサイクル数をisr_budget_account()に渡す
+// period_usの間の回数かサイクル数が上限を超えたら、その発生源を止める(呼ぶ側で割込みを無効にする)
+// 止める時間はmask_usから始めて、戻してから1秒以内にまた超えたら倍にする(mask_max_usまで)
+// 制御ループの割込みやタスクの時間を、暴走した入力(ノイズ、断線、想定外の回転数)に取られないようにする
+//
+// 統計は1秒毎に締める(回数/秒、CPU使用率)。止めている間の割込みは数えない
+// ESP-IDFに依存しないので、ホストでも確認できる
+
+#define ISR_BUDGET_BACKOFF_RESET_US 1000000    // 戻してからこれだけ超えなければ、止める時間を戻す
+
+typedef struct {
+  uint32_t period_us;        // 予算の期間
+  uint32_t max_count;        // 期間あたりの回数の上限(0なら見ない)
+  uint32_t max_cycles;       // 期間あたりのサイクル数の上限(0なら見ない)
+  uint32_t mask_us;
+  uint32_t mask_max_us;
+} isr_budget_config_t;
+
+typedef struct {
+  uint32_t count;            // 累計の回数
+  uint64_t cycles_total;
+  uint32_t cycles_max;       // 1回の最大
+  uint32_t rate_hz;          // 直近1秒の回数
+  uint32_t cpu_permille;     // 直近1秒のCPU使用率[‰]
+  uint32_t masks;            // 止めた回数
+  uint32_t masked_us;        // 止めていた時間の累計
+  bool masked;
+} isr_budget_stats_t;
+
+typedef struct {
+  const char *name;
+  isr_budget_config_t config;
+  uint32_t cycles_per_us;
+  // 予算の期間
+  int64_t period_start_us;
+  uint32_t period_count;
+  uint32_t period_cycles;
+  // 止める
+  bool masked;
+  int64_t masked_since_us;
+  int64_t unmask_us;         // 戻す時刻(戻した後は戻した時刻)
+  uint32_t backoff_us;
+  // 1秒毎の統計
+  int64_t rate_start_us;
+  uint32_t rate_count;
+  uint64_t rate_cycles;
+  isr_budget_stats_t stats;
+} isr_budget_t;
+
+void isr_budget_init(isr_budget_t *b, const char *name, const isr_budget_config_t *config, uint32_t cycles_per_us, int64_t now_us);
+
+// 割込みから呼ぶ。予算を超えたらtrue(呼ぶ側でその割込みを無効にする)
+// IRAMのラッパーから呼ぶので、フラッシュに置かれないようにヘッダに置く
+static inline bool isr_budget_account(isr_budget_t *b, int64_t t_us, uint32_t cycles){
+  // 無効にする前に入っていた分。止めている間は数えない
+  if (b->masked) {
+    return true;
+  }
+  b->stats.count++;
+  b->stats.cycles_total += cycles;
+  if (cycles > b->stats.cycles_max) {
+    b->stats.cycles_max = cycles;
+  }
+  b->rate_count++;
+  b->rate_cycles += cycles;
+
+  if (t_us - b->period_start_us >= b->config.period_us) {
+    b->period_start_us = t_us;
+    b->period_count = 0;
+    b->period_cycles = 0;
+  }
+  b->period_count++;
+  b->period_cycles += cycles;
+  bool over = (b->config.max_count > 0 && b->period_count > b->config.max_count)
+    || (b->config.max_cycles > 0 && b->period_cycles > b->config.max_cycles);
+  if (!over) {
+    return false;
+  }
+  // 戻してすぐにまた超えたら、止める時間を倍にする
+  if (t_us - b->unmask_us < ISR_BUDGET_BACKOFF_RESET_US) {
+    b->backoff_us = b->backoff_us * 2 < b->config.mask_max_us ? b->backoff_us * 2 : b->config.mask_max_us;
+  } else {
+    b->backoff_us = b->config.mask_us;
+  }
+  b->masked = true;
+  b->masked_since_us = t_us;
+  b->unmask_us = t_us + b->backoff_us;
+  b->stats.masks++;
+  return true;
+}
+
+// タスクから定期的に呼ぶ(1秒毎の統計を締める)。戻す時刻になったらtrue
+// trueなら割込みを有効にしてisr_budget_unmasked()を呼ぶ
+bool isr_budget_poll(isr_budget_t *b, int64_t now_us);
+void isr_budget_unmasked(isr_budget_t *b, int64_t now_us);
+
+void isr_budget_get_stats(const isr_budget_t *b, isr_budget_stats_t *stats);
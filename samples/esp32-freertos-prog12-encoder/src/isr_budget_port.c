@@ -0,0 +1,164 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "isr_budget_port.h"
+
+#define TAG "isr_budget"
+
+typedef enum {
+  SOURCE_GPIO,
+  SOURCE_TIMER,
+} source_type_t;
+
+typedef struct {
+  source_type_t type;
+  gpio_num_t gpio;
+  timer_group_t group;
+  timer_idx_t timer;
+  gpio_isr_t gpio_handler;
+  timer_isr_t timer_handler;
+  void *arg;
+  isr_budget_t budget;
+} source_t;
+
+static source_t sources[ISR_BUDGET_MAX_SOURCES];
+static int num_sources = 0;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void enable_intr(source_t *s){
+  if (s->type == SOURCE_GPIO) {
+    gpio_intr_enable(s->gpio);
+  } else {
+    timer_enable_intr(s->group, s->timer);
+  }
+}
+
+static bool IRAM_ATTR account(source_t *s, uint32_t cycles){
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL_ISR(&lock);
+  bool over = isr_budget_account(&s->budget, now, cycles);
+  portEXIT_CRITICAL_ISR(&lock);
+  return over;
+}
+
+static void IRAM_ATTR gpio_wrapper(void *arg){
+  source_t *s = (source_t *)arg;
+  uint32_t start = esp_cpu_get_cycle_count();
+  s->gpio_handler(s->arg);
+  if (account(s, esp_cpu_get_cycle_count() - start)) {
+    gpio_intr_disable(s->gpio);
+  }
+}
+
+static bool IRAM_ATTR timer_wrapper(void *arg){
+  source_t *s = (source_t *)arg;
+  uint32_t start = esp_cpu_get_cycle_count();
+  bool yield = s->timer_handler(s->arg);
+  if (account(s, esp_cpu_get_cycle_count() - start)) {
+    timer_disable_intr(s->group, s->timer);
+  }
+  return yield;
+}
+
+static source_t *new_source(const char *name, const isr_budget_config_t *config){
+  if (num_sources >= ISR_BUDGET_MAX_SOURCES || config->period_us == 0
+    || (config->max_count == 0 && config->max_cycles == 0) || config->mask_us == 0 || config->mask_us > config->mask_max_us) {
+    ESP_LOGE(TAG, "invalid budget %s", name);
+    return NULL;
+  }
+  source_t *s = &sources[num_sources];
+  isr_budget_init(&s->budget, name, config, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, esp_timer_get_time());
+  return s;
+}
+
+esp_err_t isr_budget_add_gpio(gpio_num_t gpio, gpio_isr_t handler, void *arg, const char *name, const isr_budget_config_t *config){
+  source_t *s = new_source(name, config);
+  if (s == NULL || handler == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  s->type = SOURCE_GPIO;
+  s->gpio = gpio;
+  s->gpio_handler = handler;
+  s->arg = arg;
+  esp_err_t ret = gpio_isr_handler_add(gpio, gpio_wrapper, s);
+  if (ret == ESP_OK) {
+    num_sources++;
+  }
+  return ret;
+}
+
+esp_err_t isr_budget_add_timer(timer_group_t group, timer_idx_t timer, timer_isr_t handler, void *arg, const char *name, const isr_budget_config_t *config){
+  source_t *s = new_source(name, config);
+  if (s == NULL || handler == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  s->type = SOURCE_TIMER;
+  s->group = group;
+  s->timer = timer;
+  s->timer_handler = handler;
+  s->arg = arg;
+  esp_err_t ret = timer_isr_callback_add(group, timer, timer_wrapper, s, 0);
+  if (ret == ESP_OK) {
+    num_sources++;
+  }
+  return ret;
+}
+
+// 戻す時刻はmask_us(10ms以上)の単位なので、決まった間隔で見れば足りる
+static void budget_task(void *pvParameters){
+  TickType_t last_wake = xTaskGetTickCount();
+  while (1) {
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(ISR_BUDGET_POLL_MS));
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < num_sources; i++) {
+      source_t *s = &sources[i];
+      taskENTER_CRITICAL(&lock);
+      bool unmask = isr_budget_poll(&s->budget, now);
+      if (unmask) {
+        isr_budget_unmasked(&s->budget, now);
+      }
+      taskEXIT_CRITICAL(&lock);
+      if (unmask) {
+        enable_intr(s);
+      }
+    }
+  }
+}
+
+esp_err_t isr_budget_start(UBaseType_t priority, BaseType_t core){
+  if (xTaskCreatePinnedToCore(budget_task, "isr_budget", 4096, NULL, priority, NULL, core) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+int isr_budget_num_sources(void){
+  return num_sources;
+}
+
+esp_err_t isr_budget_get(int index, const char **name, isr_budget_stats_t *stats){
+  if (index < 0 || index >= num_sources) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  taskENTER_CRITICAL(&lock);
+  isr_budget_get_stats(&sources[index].budget, stats);
+  taskEXIT_CRITICAL(&lock);
+  *name = sources[index].budget.name;
+  return ESP_OK;
+}
+
+void isr_budget_log_stats(void){
+  for (int i = 0; i < num_sources; i++) {
+    const char *name;
+    isr_budget_stats_t s;
+    isr_budget_get(i, &name, &s);
+    ESP_LOGI(TAG, "%-10s %lu/s cpu=%lu.%lu%% max=%lu cycles avg=%lu cycles count=%lu masks=%lu masked=%lums%s",
+      name, (unsigned long)s.rate_hz, (unsigned long)(s.cpu_permille / 10), (unsigned long)(s.cpu_permille % 10),
+      (unsigned long)s.cycles_max, (unsigned long)(s.count ? s.cycles_total / s.count : 0), (unsigned long)s.count,
+      (unsigned long)s.masks, (unsigned long)(s.masked_us / 1000), s.masked ? "(now)" : "");
+  }
+}
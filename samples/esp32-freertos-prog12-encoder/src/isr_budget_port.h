@@ -0,0 +1,31 @@
+#pragma once
+#include <freertos/FreeRTOS.h>
+#include "driver/gpio.h"
+#include "driver/timer.h"
+#include "esp_err.h"
+#include "isr_budget.h"
+
+// 割込みの予算(ESP-IDF部分)
+// ハンドラを包んで登録し、前後のesp_cpu_get_cycle_count()の差を発生源毎に数える
+// 予算を超えたらその場で割込みを無効にし(GPIOはgpio_intr_disable、タイマーはtimer_disable_intr)、
+// 見張りのタスクが時間になったら戻す
+//
+// サイクル数はハンドラ本体だけで、割込みの入口と出口(ISRサービスの分)は含まない
+// ホスト(host-sim)のTickモードでは割込みの中で時間が進まないのでサイクル数は0、回数の予算だけが効く
+// (--clock realなら実時間で測る)
+
+#define ISR_BUDGET_MAX_SOURCES 8
+#define ISR_BUDGET_POLL_MS     10
+
+// gpio_isr_handler_add()の代わり(gpio_install_isr_service()は呼ぶ側で済ませておく)
+esp_err_t isr_budget_add_gpio(gpio_num_t gpio, gpio_isr_t handler, void *arg, const char *name, const isr_budget_config_t *config);
+// timer_isr_callback_add()の代わり
+esp_err_t isr_budget_add_timer(timer_group_t group, timer_idx_t timer, timer_isr_t handler, void *arg, const char *name, const isr_budget_config_t *config);
+
+// 見張りのタスクを作る(止めた割込みを戻す、1秒毎の統計を締める)
+esp_err_t isr_budget_start(UBaseType_t priority, BaseType_t core);
+
+int isr_budget_num_sources(void);
+// index番目の発生源の統計(nameは登録した名前)
+esp_err_t isr_budget_get(int index, const char **name, isr_budget_stats_t *stats);
+void isr_budget_log_stats(void);
@@ -9,13 +9,15 @@
 #include "freertos/queue.h"
 #include "driver/timer.h"
 #include <freertos/task.h>
+#include "esp_adc/adc_oneshot.h"
+#include "timebase_port.h"
+#include "isr_budget_port.h"
+#include "periodic_port.h"
 
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #define TAG "test1"
 #define TWDT_TIMEOUT_MS 2000
 
-TaskHandle_t taskHandle;
-
 void delay_ms(uint32_t ms){
   vTaskDelay(ms / portTICK_PERIOD_MS);
 }
@@ -28,20 +30,90 @@ void delay_ms(uint32_t ms){
 
 #define REDUCTION_RATIO (100)
 #define PULSE_PER_ROTATION (7)
+#define ENCODER_ISR_DEBUG 0
 volatile uint16_t edge_counter = 0;
 volatile uint8_t direction_forward = 0;
+volatile int32_t position = 0;
+
+//------------------------
+// 割込みの予算(isr_budget.c)
+//------------------------
+// エンコーダは150RPMで1750回/秒。10msで100回(10000回/秒)か、CPUの5%(160MHzで10msに80000サイクル)を
+// 超えたらノイズか断線とみなして50ms止める(続けば倍々で最大2秒)。止めている間のエッジは数えない
+// 1秒タイマーは10msに2回を超えたら止める(設定の誤りで周期が短くなったとき)
+static const isr_budget_config_t encoder_budget = {
+  .period_us = 10000,
+  .max_count = 100,
+  .max_cycles = 80000,
+  .mask_us = 50000,
+  .mask_max_us = 2000000,
+};
+static const isr_budget_config_t timer_budget = {
+  .period_us = 10000,
+  .max_count = 2,
+  .max_cycles = 0,
+  .mask_us = 100000,
+  .mask_max_us = 2000000,
+};
+
+//------------------------
+// 時刻付きのストリーム(timebase.c)
+//------------------------
+// pos_stream   : A相の立ち上がり毎の位置(割込みで時刻を付ける)。エッジの間は直線補間
+// window_stream: 1秒タイマーの割込みで、その1秒のカウント。次の値が来るまでホールド
+// adc_stream   : 別のペリフェラル(ADC1)で10ms毎に読むモーターの電流センスの値。エンコーダとは関係なく来るので直線補間
+// この3つを10ms格子に揃えて、位置の差から回転数を出し、同じ時刻の電流と並べる
+// 揃え方はhost-simのcheck_prog12_timebaseで、ずれが分かっている合成ストリームと比べて確かめている
+// (エッジが来た時刻、ADCを読んだ時刻で計算するので、通知や読むタスクの遅れに影響されない)
+#define ALIGN_GRID_MS      10
+#define ALIGN_TASK_MS      100
+#define POS_TIMEOUT_MS     50     // 止まっていてエッジが来なければ、最後の位置のまま
+#define WINDOW_TIMEOUT_MS  1500
+#define VELOCITY_ROWS      10     // 回転数は100ms(10行)の位置の差から
+#define REPORT_ROWS        100
+
+// 電流センス: GPIO7 = ADC1_CH6(シャント抵抗のアンプの出力)
+#define CURRENT_ADC_CHANNEL   ADC_CHANNEL_6
+// sdkconfigのCONFIG_FREERTOS_HZ=100では1Tickが10msなので、それより短くはできない(0TickのvTaskDelayUntilはassertで止まる)
+#define CURRENT_PERIOD_MS     10
+#define CURRENT_TIMEOUT_MS    50
+
+static tb_sample_t pos_buf[256];
+static tb_sample_t window_buf[4];
+static tb_sample_t adc_buf[32];
+static tb_stream_t pos_stream;
+static tb_stream_t window_stream;
+static tb_stream_t adc_stream;
+static tb_align_t align;
+
+//------------------------
+// 周期タスク(periodic.c)
+//------------------------
+// 1秒タイマーの割込みでcalc_velocity_taskを起こす
+// 遅れて周期が溜まったら1回にまとめ(PT_SKIP)、実際にかかった時間で回転数を出す
+// 方針毎の動きはhost-simのcheck_prog12_periodicで、仮想時間で負荷をかけて確かめている
+#define VELOCITY_PERIOD_S     1
+#define VELOCITY_DEADLINE_MS  100
+static const pt_config_t velocity_config = {
+  .period_us = VELOCITY_PERIOD_S * 1000000LL,
+  .deadline_us = VELOCITY_DEADLINE_MS * 1000,
+  .policy = PT_SKIP,
+};
+static pt_port_t velocity_periodic;
 
 void IRAM_ATTR gpio_isr_edge_handler(void *arg){
   uint32_t gpio_num = (uint32_t) arg;
   // パルスカウント
   edge_counter+=1;
-  
+
   // もう片方のC2パルスのLevel
   // どうもC1の立ち上がりエッジのときにC2は、
   // 正回転：C1=HIGH, C2=LOW
   // 逆回転：C1=HIGH, C2=HIGH
   // https://edn.itmedia.co.jp/edn/articles/1203/16/news012_2.html
   direction_forward = gpio_get_level(GPIO_NUM_6);
+  position += direction_forward ? 1 : -1;
+  tb_stamp(&pos_stream, position);
 
   // 高頻度で割込みを発生させると、コンソール出力でエラーになる
   // 割込み処理内でのコンソール出力が負荷高い（割込み自体優先度が高いのでWDT発動）
@@ -50,13 +122,16 @@ void IRAM_ATTR gpio_isr_edge_handler(void *arg){
   // 出力軸が1回転毎にコンソール出力される
 
   // 手でエンコーダーを回転させて1周あたりのパルス数をカウントする場合は
-  // % 1で毎回出力させる
+  // ENCODER_ISR_DEBUGを1にして % 1で毎回出力させる
+  // (普段は割込みの中で余分な処理をしない。かかったサイクル数はisr_budgetの統計で見る)
+#if ENCODER_ISR_DEBUG
   if(edge_counter % (PULSE_PER_ROTATION*REDUCTION_RATIO) == 0){ // 7pulse x 100:1
   //if(edge_counter % 1 == 0){
   //if(edge_counter % 210 == 0){ // 7pulse x 30:1
   //if(edge_counter % (12*90) == 0){ // 12 pulse x 90:1
-    //esp_rom_printf("gpio=%d, level=%d, edge_counter=%d\n", gpio_num, gpio_get_level(gpio_num), edge_counter);
+    esp_rom_printf("gpio=%d, level=%d, edge_counter=%d\n", gpio_num, gpio_get_level(gpio_num), edge_counter);
   }
+#endif
 }
 // 割込み設定
 void setup_interrupt(){
@@ -76,7 +151,7 @@ void setup_interrupt(){
   ESP_ERROR_CHECK(gpio_set_intr_type(GPIO_NUM_5, GPIO_INTR_POSEDGE));
   ESP_ERROR_CHECK(gpio_set_intr_type(GPIO_NUM_6, GPIO_INTR_POSEDGE));
   ESP_ERROR_CHECK(gpio_install_isr_service(0));
-  ESP_ERROR_CHECK(gpio_isr_handler_add(GPIO_NUM_5, gpio_isr_edge_handler, (void *)GPIO_NUM_5));
+  ESP_ERROR_CHECK(isr_budget_add_gpio(GPIO_NUM_5, gpio_isr_edge_handler, (void *)GPIO_NUM_5, "encoder_a", &encoder_budget));
   //ESP_ERROR_CHECK(gpio_isr_handler_add(GPIO_NUM_6, gpio_isr_edge_handler, (void *)GPIO_NUM_6));
 
   ESP_LOGI(TAG, "<=== setup_interrupt end");
@@ -92,13 +167,15 @@ void calc_velocity_task(void *pvParameters) {
   uint16_t pulse_per_rotation = PULSE_PER_ROTATION*REDUCTION_RATIO;
   
   while (1) {
-    uint32_t ulNotifiedValue;
-    xTaskNotifyWait(0, 0, &ulNotifiedValue, portMAX_DELAY);
+    pt_tick_t tick;
+    pt_port_wait(&velocity_periodic, &tick, portMAX_DELAY);
     uint16_t cnt = edge_counter;
     // reset counter
     edge_counter = 0;
+    // カウントは前回からの分なので、窓は1秒と決めずに実際の時間を使う(最初は周期の分)
+    int64_t window_us = tick.elapsed_us > 0 ? tick.elapsed_us : tick.periods * velocity_config.period_us;
     // 1回転あたりのカウント数がpulse_per_rotation、ここから1minsあたりの回転数[rpm]を求める
-    float rpm = (float)(cnt * 60 / pulse_per_rotation);
+    float rpm = cnt * 60.0f * 1000000.0f / window_us / pulse_per_rotation;
     // rpm_to_radians=0.104に回転数をかけると角速度[rad/s]になる
     float velocity_rad = rpm * rpm_to_radians;
     // rad => degreeで[degree/s]を求める
@@ -106,14 +183,81 @@ void calc_velocity_task(void *pvParameters) {
 
     // 5Vでおおよそ
     // 1 [direction] 124 [RPM], 12.99 [rad/s], 744.00 [deg/s], 1448 [encoder]
-    ESP_LOGW(TAG, "%d [direction] %.0f [RPM], %.2f [rad/s], %.2f [deg/s], %d [encoder]", direction_forward, rpm, velocity_rad, velocity_deg, cnt);
+    ESP_LOGW(TAG, "%d [direction] %.0f [RPM], %.2f [rad/s], %.2f [deg/s], %d [encoder] window=%lldms periods=%lu late=%lldus",
+      direction_forward, rpm, velocity_rad, velocity_deg, cnt, (long long)(window_us / 1000), (unsigned long)tick.periods,
+      (long long)tick.lateness_us);
+    isr_budget_log_stats();
+    pt_port_log_stats(&velocity_periodic);
+    pt_port_done(&velocity_periodic);
+  }
+}
+// 揃えた行(tb_align_next)を受け取る
+static void aligned_row(int64_t t_us, const float *values, int num_values, void *arg){
+  static float pos_hist[VELOCITY_ROWS + 1];
+  static uint32_t rows = 0;
+  pos_hist[rows % (VELOCITY_ROWS + 1)] = values[0];
+  rows++;
+  if (rows <= VELOCITY_ROWS || rows % REPORT_ROWS != 0) {
+    return;
+  }
+  float dpos = values[0] - pos_hist[rows % (VELOCITY_ROWS + 1)];
+  float rpm = dpos * 60.0f * 1000.0f / (VELOCITY_ROWS * ALIGN_GRID_MS) / (PULSE_PER_ROTATION * REDUCTION_RATIO);
+  ESP_LOGI(TAG, "aligned t=%lld [ms] position=%.1f %.1f [RPM] window=%.0f current=%.0f (rows=%lu stale=%lu skipped=%lu dropped=%lu)",
+    (long long)(t_us / 1000), values[0], rpm, values[1], values[2],
+    (unsigned long)align.rows, (unsigned long)align.stale, (unsigned long)align.skipped,
+    (unsigned long)(pos_stream.dropped + window_stream.dropped + adc_stream.dropped));
+}
+
+// 電流センスのADCを読むタスク
+// ワンショットの変換は読み出しの中で行うので、前後の時刻の中点をサンプルの時刻にする
+static void current_sample_task(void *pvParameters){
+  _Static_assert(CURRENT_PERIOD_MS * configTICK_RATE_HZ / 1000 >= 1, "CURRENT_PERIOD_MS is shorter than a tick");
+  adc_oneshot_unit_handle_t adc = (adc_oneshot_unit_handle_t)pvParameters;
+  TickType_t last_wake = xTaskGetTickCount();
+  while (1) {
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CURRENT_PERIOD_MS));
+    int raw;
+    int64_t before = tb_now_us();
+    if (adc_oneshot_read(adc, CURRENT_ADC_CHANNEL, &raw) != ESP_OK) {
+      continue;
+    }
+    int64_t after = tb_now_us();
+    tb_stream_push(&adc_stream, before + (after - before) / 2, raw);
   }
 }
+
+static void setup_current_sense(void){
+  adc_oneshot_unit_handle_t adc;
+  adc_oneshot_unit_init_cfg_t unit_config = {
+    .unit_id = ADC_UNIT_1,
+  };
+  ESP_ERROR_CHECK(adc_oneshot_new_unit(&unit_config, &adc));
+  adc_oneshot_chan_cfg_t chan_config = {
+    .atten = ADC_ATTEN_DB_11,
+    .bitwidth = ADC_BITWIDTH_DEFAULT,
+  };
+  ESP_ERROR_CHECK(adc_oneshot_config_channel(adc, CURRENT_ADC_CHANNEL, &chan_config));
+  // 揃えるタスク(優先度1)より上にして、読む時刻が遅れないようにする
+  xTaskCreatePinnedToCore(current_sample_task, "current_sample", 4096, adc, 2, NULL, APP_CPU_NUM);
+}
+
+static void setup_timebase(void){
+  tb_stream_init(&pos_stream, pos_buf, 256, TB_INTERP_LINEAR, 0, POS_TIMEOUT_MS * 1000);
+  tb_stream_init(&window_stream, window_buf, 4, TB_INTERP_HOLD, 0, WINDOW_TIMEOUT_MS * 1000);
+  tb_stream_init(&adc_stream, adc_buf, 32, TB_INTERP_LINEAR, 0, CURRENT_TIMEOUT_MS * 1000);
+  // 格子は今から始める(それより前のサンプルはない)
+  tb_align_init(&align, tb_now_us(), ALIGN_GRID_MS * 1000);
+  tb_align_add(&align, &pos_stream);
+  tb_align_add(&align, &window_stream);
+  tb_align_add(&align, &adc_stream);
+}
+
 // Timer割込み
-void IRAM_ATTR timer_isr_handler(void *arg){
-  BaseType_t taskWoken = pdFALSE;
-  // 実際の計算や処理はcalc_velocity_taskでやる為通知
-  xTaskNotifyFromISR(taskHandle, 0, eIncrement, &taskWoken);
+// 戻り値はタスクの切り替えが必要か(timer_isr_callback_addのハンドラの形)
+bool IRAM_ATTR timer_isr_handler(void *arg){
+  tb_stamp(&window_stream, edge_counter);
+  // 実際の計算や処理はcalc_velocity_taskでやる為通知(周期の数と時刻も記録する)
+  return pt_port_release_from_isr(&velocity_periodic);
 }
 // Timerセットアップ
 #define TIMER_DIVIDER (80)  // 分周比 80にすると以下の計算が成り立つ
@@ -136,8 +280,8 @@ static void setup_timer(int group, int timer, bool auto_reload, int timer_interv
   timer_set_alarm_value(group, timer, timer_interval_sec * TIMER_SCALE);
   // 割込み有効
   timer_enable_intr(group, timer);
-  // 割込み追加
-  timer_isr_callback_add(group, timer, timer_isr_handler, NULL, 0);
+  // 割込み追加(予算を付けて登録する)
+  ESP_ERROR_CHECK(isr_budget_add_timer(group, timer, timer_isr_handler, NULL, "timer0", &timer_budget));
   // timer開始
   timer_start(group, timer);
 }
@@ -152,13 +296,20 @@ void app_main()
     .trigger_panic = false,
   };
   ESP_ERROR_CHECK(esp_task_wdt_init(&twdt_config));
+  setup_timebase();
+  pt_port_init(&velocity_periodic, "calc_velocity", &velocity_config);
   //パルス割込み設定
   setup_interrupt();
 
-  xTaskCreatePinnedToCore(calc_velocity_task, "calc_velocity_task", 8192, NULL, 1, &taskHandle, APP_CPU_NUM);
+  xTaskCreatePinnedToCore(calc_velocity_task, "calc_velocity_task", 8192, NULL, 1, NULL, APP_CPU_NUM);
 
   // 1secタイマー設定
-  setup_timer(TIMER_GROUP_0, TIMER_0, true, 1);
+  setup_timer(TIMER_GROUP_0, TIMER_0, true, VELOCITY_PERIOD_S);
+  setup_current_sense();
+
+  ESP_ERROR_CHECK(tb_port_start_align(&align, ALIGN_TASK_MS, aligned_row, NULL, 1, APP_CPU_NUM));
+  // 止めた割込みを戻すのが遅れないように、計算のタスクより上にする
+  ESP_ERROR_CHECK(isr_budget_start(5, APP_CPU_NUM));
 
   ESP_LOGI(TAG, "<=== app_main end");
 }
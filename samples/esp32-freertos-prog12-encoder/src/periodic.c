@@ -0,0 +1,79 @@
+#include <string.h>
+#include "periodic.h"
+
+void pt_init(pt_t *pt, const pt_config_t *config){
+  memset(pt, 0, sizeof(*pt));
+  pt->config = *config;
+  if (pt->config.deadline_us <= 0) {
+    pt->config.deadline_us = pt->config.period_us;
+  }
+}
+
+void pt_released(pt_t *pt, uint32_t count, int64_t last_release_us){
+  if (count == 0) {
+    return;
+  }
+  pt->pending += count;
+  pt->last_release_us = last_release_us;
+  pt->stats.periods += count;
+}
+
+bool pt_next(pt_t *pt, int64_t now_us, pt_tick_t *tick){
+  if (pt->pending == 0) {
+    pt->in_backlog = false;
+    return false;
+  }
+  // 処理を始める時点で2つ以上溜まっていたら、前の処理か起床が周期に間に合わなかった
+  if (pt->pending > 1 && !pt->in_backlog) {
+    pt->stats.overruns++;
+  }
+  uint32_t skip = 0;
+  if (pt->config.policy == PT_SKIP) {
+    skip = pt->pending - 1;
+  } else if (pt->config.max_catch_up > 0 && pt->pending > pt->config.max_catch_up && !pt->in_backlog) {
+    skip = pt->pending - pt->config.max_catch_up;
+  }
+  pt->pending -= skip;
+  pt->stats.skipped += skip;
+
+  pt_tick_t *t = &pt->current;
+  t->periods = pt->config.policy == PT_SKIP ? skip + 1 : 1;
+  t->skipped = pt->config.policy == PT_SKIP ? 0 : skip;
+  t->seq = pt->seq + skip;
+  t->release_us = pt->last_release_us - (int64_t)(pt->pending - 1) * pt->config.period_us;
+  t->now_us = now_us;
+  t->lateness_us = now_us - t->release_us;
+  t->elapsed_us = pt->started ? now_us - pt->prev_now_us : 0;
+  pt->pending--;
+  t->backlog = pt->pending;
+  if (pt->in_backlog) {
+    pt->stats.caught_up++;
+  }
+  pt->in_backlog = pt->pending > 0;
+  pt->seq += skip + 1;
+  pt->prev_now_us = now_us;
+  pt->started = true;
+
+  if (t->lateness_us > pt->stats.max_lateness_us) {
+    pt->stats.max_lateness_us = t->lateness_us;
+  }
+  *tick = *t;
+  return true;
+}
+
+void pt_end(pt_t *pt, int64_t now_us){
+  pt_stats_t *s = &pt->stats;
+  int64_t exec = now_us - pt->current.now_us;
+  s->iterations++;
+  s->total_exec_us += exec;
+  if (exec > s->max_exec_us) {
+    s->max_exec_us = exec;
+  }
+  if (now_us - pt->current.release_us > pt->config.deadline_us) {
+    s->deadline_misses++;
+  }
+}
+
+void pt_get_stats(const pt_t *pt, pt_stats_t *stats){
+  *stats = pt->stats;
+}
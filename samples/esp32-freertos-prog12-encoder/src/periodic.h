@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// 周期タスク（ロジック部分）
+// タイマーの割込みが周期の始まり(リリース)を知らせ、タスクは1回の処理(イテレーション)毎にpt_next/pt_endを呼ぶ
+// タスクが遅れて、次の周期が始まるまでに前の処理が終わらなかったらオーバーラン
+// 溜まった周期は方針に従って処理する
+//   PT_CATCH_UP: 1周期ずつ続けて処理する(制御の積分など、回数が大事なもの)。max_catch_upを超えた分は捨てる
+//   PT_SKIP    : 1回にまとめる(最新の値だけが大事なもの)。tick.periodsにまとめた周期の数が入る
+// リリースから deadline_us までに処理が終わらなければデッドライン違反(0なら周期と同じ)
+// ESP-IDFに依存しないので、ホストでも確認できる(割込みとタスクの部分はperiodic_port.h)
+
+typedef enum {
+  PT_CATCH_UP,
+  PT_SKIP,
+} pt_policy_t;
+
+typedef struct {
+  int64_t period_us;
+  int64_t deadline_us;
+  pt_policy_t policy;
+  uint32_t max_catch_up;     // PT_CATCH_UPで続けて処理する周期の上限(0なら上限なし)
+} pt_config_t;
+
+// 1回の処理に渡す情報
+typedef struct {
+  uint32_t seq;              // 処理した周期の通し番号(まとめた分も数える)
+  uint32_t periods;          // この処理が受け持つ周期の数(通常1、PT_SKIPでまとめたら2以上)
+  uint32_t skipped;          // 処理せずに捨てた周期の数
+  uint32_t backlog;          // この後に続けて処理する周期の数
+  int64_t release_us;        // この周期の始まり(予定の時刻)
+  int64_t now_us;            // 実際に処理を始めた時刻
+  int64_t lateness_us;       // now_us - release_us
+  int64_t elapsed_us;        // 前の処理の開始からの実際の時間(最初は0)
+} pt_tick_t;
+
+typedef struct {
+  uint32_t iterations;
+  uint32_t periods;          // リリースされた周期の数
+  uint32_t overruns;         // 前の処理が終わる前に次の周期が始まった回数
+  uint32_t deadline_misses;
+  uint32_t caught_up;        // PT_CATCH_UPで遅れて続けて処理した周期
+  uint32_t skipped;          // 捨てた周期(PT_SKIPではまとめた周期)
+  int64_t max_lateness_us;
+  int64_t max_exec_us;
+  int64_t total_exec_us;
+} pt_stats_t;
+
+typedef struct {
+  pt_config_t config;
+  uint32_t pending;          // リリースされてまだ処理していない周期
+  int64_t last_release_us;   // 最後にリリースされた周期の始まり
+  uint32_t seq;
+  int64_t prev_now_us;
+  bool started;
+  bool in_backlog;           // 溜まった周期を処理している途中
+  pt_tick_t current;
+  pt_stats_t stats;
+} pt_t;
+
+void pt_init(pt_t *pt, const pt_config_t *config);
+
+// count個の周期がリリースされた。last_release_usは最後の周期の始まり(それより前は周期ずつ戻った時刻とみなす)
+void pt_released(pt_t *pt, uint32_t count, int64_t last_release_us);
+
+// 次に処理する周期をtickに入れる。溜まっていなければfalse
+bool pt_next(pt_t *pt, int64_t now_us, pt_tick_t *tick);
+// pt_nextで受け取った周期の処理が終わった
+void pt_end(pt_t *pt, int64_t now_us);
+
+void pt_get_stats(const pt_t *pt, pt_stats_t *stats);
@@ -0,0 +1,61 @@
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "periodic_port.h"
+
+#define TAG "periodic"
+
+void pt_port_init(pt_port_t *p, const char *name, const pt_config_t *config){
+  memset(p, 0, sizeof(*p));
+  pt_init(&p->pt, config);
+  p->name = name;
+  portMUX_INITIALIZE(&p->mux);
+}
+
+bool IRAM_ATTR pt_port_release_from_isr(pt_port_t *p){
+  int64_t now = esp_timer_get_time();
+  TaskHandle_t task = p->task;
+  if (task == NULL) {
+    return false;
+  }
+  portENTER_CRITICAL_ISR(&p->mux);
+  p->released++;
+  p->last_release_us = now;
+  portEXIT_CRITICAL_ISR(&p->mux);
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(task, &woken);
+  return woken == pdTRUE;
+}
+
+bool pt_port_wait(pt_port_t *p, pt_tick_t *tick, TickType_t timeout){
+  if (p->task == NULL) {
+    p->task = xTaskGetCurrentTaskHandle();
+  }
+  while (!pt_next(&p->pt, esp_timer_get_time(), tick)) {
+    if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+      return false;
+    }
+    portENTER_CRITICAL(&p->mux);
+    uint32_t released = p->released;
+    int64_t last = p->last_release_us;
+    portEXIT_CRITICAL(&p->mux);
+    pt_released(&p->pt, released - p->seen, last);
+    p->seen = released;
+  }
+  return true;
+}
+
+void pt_port_done(pt_port_t *p){
+  pt_end(&p->pt, esp_timer_get_time());
+}
+
+void pt_port_log_stats(const pt_port_t *p){
+  pt_stats_t s;
+  pt_get_stats(&p->pt, &s);
+  ESP_LOGI(TAG, "%s: periods=%lu iterations=%lu overruns=%lu deadline_misses=%lu caught_up=%lu skipped=%lu"
+    " lateness max=%lldus exec max=%lldus avg=%lldus", p->name,
+    (unsigned long)s.periods, (unsigned long)s.iterations, (unsigned long)s.overruns, (unsigned long)s.deadline_misses,
+    (unsigned long)s.caught_up, (unsigned long)s.skipped, (long long)s.max_lateness_us, (long long)s.max_exec_us,
+    (long long)(s.iterations ? s.total_exec_us / s.iterations : 0));
+}
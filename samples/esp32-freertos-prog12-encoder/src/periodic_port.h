@@ -0,0 +1,38 @@
+#pragma once
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "periodic.h"
+
+// 周期タスク(ESP-IDF部分)
+// タイマーの割込みでpt_port_release_from_isr()を呼び、タスクはpt_port_wait()とpt_port_done()で1回ずつ処理する
+// 割込みは周期の数と最後の時刻(esp_timer_get_time())を記録して、タスクに通知(インデックス0)するだけ
+// 通知の値は起こすためだけに使い、周期の数は記録した数との差から求める(通知がまとまっても数え落とさない)
+// 受け取るタスクは最初にpt_port_wait()を呼んだタスク。それより前の周期は数えない
+//
+//   while (1) {
+//     pt_tick_t tick;
+//     pt_port_wait(&p, &tick, portMAX_DELAY);
+//     ... tick.periods、tick.elapsed_usを使って処理 ...
+//     pt_port_done(&p);
+//   }
+
+typedef struct {
+  pt_t pt;
+  const char *name;
+  TaskHandle_t task;
+  portMUX_TYPE mux;
+  uint32_t released;         // 割込みが書く
+  int64_t last_release_us;   // 割込みが書く
+  uint32_t seen;
+} pt_port_t;
+
+void pt_port_init(pt_port_t *p, const char *name, const pt_config_t *config);
+
+// 割込みから呼ぶ。戻り値はタスクの切り替えが必要か(timer_isr_callback_addのハンドラの戻り値にそのまま使える)
+bool pt_port_release_from_isr(pt_port_t *p);
+
+// 次の周期が来るまで待つ。timeoutまでに来なければfalse
+bool pt_port_wait(pt_port_t *p, pt_tick_t *tick, TickType_t timeout);
+void pt_port_done(pt_port_t *p);
+
+void pt_port_log_stats(const pt_port_t *p);
@@ -0,0 +1,101 @@
+#include <string.h>
+#include "timebase.h"
+
+void tb_stream_init(tb_stream_t *s, tb_sample_t *buf, uint32_t capacity, tb_interp_t interp, int32_t offset_us, int64_t timeout_us){
+  memset(s, 0, sizeof(*s));
+  s->buf = buf;
+  s->mask = capacity - 1;
+  s->interp = interp;
+  s->offset_us = offset_us;
+  s->timeout_us = timeout_us;
+}
+
+static bool pop(tb_stream_t *s, tb_sample_t *out){
+  uint32_t tail = s->tail;
+  if (tail == __atomic_load_n(&s->head, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  *out = s->buf[tail & s->mask];
+  __atomic_store_n(&s->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+static float interpolate(const tb_stream_t *s, int64_t t_us){
+  const tb_sample_t *a = &s->prev;
+  const tb_sample_t *b = &s->next;
+  if (t_us >= b->t_us) {
+    return b->value;
+  }
+  if (s->interp == TB_INTERP_HOLD || b->t_us <= a->t_us) {
+    return a->value;
+  }
+  return (float)(a->value + (double)(b->value - a->value) * (t_us - a->t_us) / (b->t_us - a->t_us));
+}
+
+tb_value_t tb_stream_value_at(tb_stream_t *s, int64_t t_us, int64_t now_us, float *value){
+  // nextがt_us以降になるまで進める(prevはt_usより前の最後のサンプル)
+  tb_sample_t x;
+  while ((s->have == 0 || s->next.t_us < t_us) && pop(s, &x)) {
+    s->prev = s->next;
+    s->next = x;
+    if (s->have < 2) {
+      s->have++;
+    }
+  }
+  if (s->have == 0) {
+    return now_us - t_us >= s->timeout_us ? TB_VALUE_BEFORE : TB_VALUE_WAIT;
+  }
+  if (s->next.t_us >= t_us) {
+    if (s->next.t_us == t_us || s->have == 2) {
+      *value = interpolate(s, t_us);
+      return TB_VALUE_OK;
+    }
+    return TB_VALUE_BEFORE;
+  }
+  // t_usより後のサンプルがない
+  if (now_us - t_us < s->timeout_us) {
+    return TB_VALUE_WAIT;
+  }
+  *value = s->next.value;
+  return TB_VALUE_STALE;
+}
+
+void tb_align_init(tb_align_t *a, int64_t start_us, int64_t period_us){
+  memset(a, 0, sizeof(*a));
+  a->next_us = start_us;
+  a->period_us = period_us;
+}
+
+int tb_align_add(tb_align_t *a, tb_stream_t *s){
+  if (a->num_streams >= TB_ALIGN_MAX) {
+    return -1;
+  }
+  a->streams[a->num_streams] = s;
+  return a->num_streams++;
+}
+
+bool tb_align_next(tb_align_t *a, int64_t now_us, int64_t *t_us, float *values){
+  while (a->next_us <= now_us) {
+    bool before = false;
+    bool stale = false;
+    for (int i = 0; i < a->num_streams; i++) {
+      tb_value_t r = tb_stream_value_at(a->streams[i], a->next_us, now_us, &values[i]);
+      if (r == TB_VALUE_WAIT) {
+        return false;
+      }
+      before = before || r == TB_VALUE_BEFORE;
+      stale = stale || r == TB_VALUE_STALE;
+    }
+    int64_t t = a->next_us;
+    a->next_us += a->period_us;
+    if (before) {
+      a->skipped++;
+      continue;
+    }
+    a->rows++;
+    a->stale += stale ? 1 : 0;
+    *t_us = t;
+    return true;
+  }
+  return false;
+}
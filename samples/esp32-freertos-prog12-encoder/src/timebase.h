@@ -0,0 +1,89 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// 共通の時間軸(64bit、µs)でサンプルに時刻を付けて、複数のストリームを同じ格子に揃える（ロジック部分）
+//
+// ストリーム: 割込み(またはDMAの完了、ペリフェラルを読むタスク)で tb_stream_push(時刻, 値) し、揃えるタスクが読み出す
+//   リングバッファは書く側1つ(割込み)、読む側1つ(タスク)で、ロックを使わない(コアが違っても良い)
+//   満杯なら捨ててdroppedを数える(割込みは待たない)
+//   offset_us: 時刻の補正。記録する時刻 = 渡した時刻 + offset_us
+//              (ADCの変換時間、割込みの遅れ、別のクロックとの差など、分かっているずれを打ち消す)
+//
+// 揃え方(tb_align_next): period_us毎の格子の時刻tで、各ストリームの前後のサンプルから値を求める
+//   TB_INTERP_LINEAR: 前後のサンプルの直線補間(位置やADCのように連続している値)
+//   TB_INTERP_HOLD  : t以前の最後のサンプルの値(カウントや状態のように変化した時点で記録する値)
+//   全部のストリームにtより後のサンプルが来るまで待つ
+//   ただし止まっているストリーム(エンコーダが回っていないなど)は、timeout_us経っても来なければ最後の値を使う(stale)
+//   最初のサンプルより前の格子は、そのストリームの値がないので行ごと飛ばす(skipped)
+// ESP-IDFに依存しないので、ホストでも確認できる(時刻の取得はtimebase_port.h)
+
+#define TB_ALIGN_MAX   4
+
+typedef struct {
+  int64_t t_us;
+  int32_t value;
+} tb_sample_t;
+
+typedef enum {
+  TB_INTERP_LINEAR,
+  TB_INTERP_HOLD,
+} tb_interp_t;
+
+typedef struct {
+  // 書く側
+  tb_sample_t *buf;
+  uint32_t mask;             // 容量 - 1(容量は2のべき乗)
+  uint32_t head;
+  uint32_t dropped;
+  int32_t offset_us;
+  // 読む側
+  uint32_t tail;
+  tb_interp_t interp;
+  int64_t timeout_us;
+  tb_sample_t prev, next;    // 格子の時刻を挟む2つ
+  int have;                  // prev/nextのうち有効な数(0～2)
+} tb_stream_t;
+
+typedef enum {
+  TB_VALUE_OK,
+  TB_VALUE_STALE,            // 新しいサンプルが来ないので最後の値を使った
+  TB_VALUE_WAIT,             // tより後のサンプルがまだ来ていない
+  TB_VALUE_BEFORE,           // tは最初のサンプルより前
+} tb_value_t;
+
+typedef struct {
+  tb_stream_t *streams[TB_ALIGN_MAX];
+  int num_streams;
+  int64_t period_us;
+  int64_t next_us;           // 次の格子の時刻
+  uint32_t rows;
+  uint32_t stale;            // staleの値を含んだ行
+  uint32_t skipped;
+} tb_align_t;
+
+// bufの容量capacityは2のべき乗
+void tb_stream_init(tb_stream_t *s, tb_sample_t *buf, uint32_t capacity, tb_interp_t interp, int32_t offset_us, int64_t timeout_us);
+
+// 書く側(割込みから呼べる)
+static inline bool tb_stream_push(tb_stream_t *s, int64_t t_us, int32_t value){
+  uint32_t head = s->head;
+  if (head - __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE) > s->mask) {
+    s->dropped++;
+    return false;
+  }
+  tb_sample_t *p = &s->buf[head & s->mask];
+  p->t_us = t_us + s->offset_us;
+  p->value = value;
+  __atomic_store_n(&s->head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+// 読む側: 時刻t_usの値。t_usは呼ぶ毎に増えていくこと(t_usより前のサンプルは捨てる)
+tb_value_t tb_stream_value_at(tb_stream_t *s, int64_t t_us, int64_t now_us, float *value);
+
+void tb_align_init(tb_align_t *a, int64_t start_us, int64_t period_us);
+// ストリームを追加して、行の中の位置を返す(いっぱいなら-1)
+int tb_align_add(tb_align_t *a, tb_stream_t *s);
+// now_usの時点で揃っている次の行を出す。出せたらtrueで、*t_usとvalues[num_streams]に書く
+bool tb_align_next(tb_align_t *a, int64_t now_us, int64_t *t_us, float *values);
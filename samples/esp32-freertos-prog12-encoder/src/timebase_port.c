@@ -0,0 +1,41 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "esp_log.h"
+#include "timebase_port.h"
+
+#define TAG "timebase"
+
+typedef struct {
+  tb_align_t *align;
+  uint32_t period_ms;
+  tb_row_cb_t callback;
+  void *arg;
+} align_task_t;
+
+static align_task_t align_task_arg;
+
+static void align_task(void *pvParameters){
+  align_task_t *p = (align_task_t *)pvParameters;
+  float values[TB_ALIGN_MAX];
+  int64_t t_us;
+  TickType_t last_wake = xTaskGetTickCount();
+  while (1) {
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(p->period_ms));
+    int64_t now = tb_now_us();
+    while (tb_align_next(p->align, now, &t_us, values)) {
+      p->callback(t_us, values, p->align->num_streams, p->arg);
+    }
+  }
+}
+
+esp_err_t tb_port_start_align(tb_align_t *align, uint32_t period_ms, tb_row_cb_t callback, void *arg, UBaseType_t priority, BaseType_t core){
+  if (align->num_streams == 0 || period_ms == 0 || callback == NULL) {
+    ESP_LOGE(TAG, "invalid align config");
+    return ESP_ERR_INVALID_ARG;
+  }
+  align_task_arg = (align_task_t){align, period_ms, callback, arg};
+  if (xTaskCreatePinnedToCore(align_task, "tb_align", 4096, &align_task_arg, priority, NULL, core) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "timebase.h"
+
+// 共通の時間軸(ESP-IDF部分)
+// 時刻はesp_timer_get_time()(起動からのµs、64bit)。どのコアでも同じ値で、割込みからも呼べる
+// gptimerでサンプルを取る場合も、コールバックの中でこの時刻を付ければ同じ時間軸になる
+//
+// 揃える側はタスク(tb_port_start_align)で、period_ms毎にその時点までに揃った行をコールバックに渡す
+
+static inline int64_t IRAM_ATTR tb_now_us(void){
+  return esp_timer_get_time();
+}
+
+// 割込みの中で、今の時刻を付けて記録する
+static inline bool IRAM_ATTR tb_stamp(tb_stream_t *s, int32_t value){
+  return tb_stream_push(s, esp_timer_get_time(), value);
+}
+
+typedef void (*tb_row_cb_t)(int64_t t_us, const float *values, int num_values, void *arg);
+
+// alignはtb_align_init、tb_align_addを済ませておく
+esp_err_t tb_port_start_align(tb_align_t *align, uint32_t period_ms, tb_row_cb_t callback, void *arg, UBaseType_t priority, BaseType_t core);
@@ -22,7 +22,8 @@ void delay_ms(uint32_t ms){
 // https://github.com/espressif/esp-idf/blob/master/examples/system/sysview_tracing/main/sysview_tracing.c
 
 // gptimerのコールバック
-static bool timer_alarm_callback(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx){
+// CONFIG_GPTIMER_ISR_IRAM_SAFE=yなのでフラッシュのキャッシュが止まっている間も呼ばれる。IRAMに置く
+static bool IRAM_ATTR timer_alarm_callback(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx){
   bool need_yield = false;
   BaseType_t xHigherPriorityTaskWoken = pdFALSE;
   // タスクに通知する
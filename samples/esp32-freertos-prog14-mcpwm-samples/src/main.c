@@ -15,6 +15,7 @@
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
 #include "driver/mcpwm_prelude.h"
+#include "pwm_sequence_port.h"
 #define TWDT_TIMEOUT_MS 2000
 
 #define TAG "mcpwm"
@@ -26,6 +27,20 @@ void delay_ms(uint32_t ms){
   vTaskDelay(ms / portTICK_PERIOD_MS);
 }
 
+// シーケンスの長さはPWM周期(20ms)単位
+// 階段: 以前のwhileループと同じく2秒毎に0→25→50→75→100%
+static const pwm_seq_step_t stairs_steps[] = {
+  {0, 100, false}, {5000, 100, false}, {10000, 100, false}, {15000, 100, false}, {20000, 100, false},
+};
+static const pwm_seq_t stairs = {stairs_steps, sizeof(stairs_steps) / sizeof(stairs_steps[0]), 0};
+// 呼吸: 1秒かけて100%まで上げて、1秒かけて0%まで下げる
+static const pwm_seq_step_t breathe_steps[] = {
+  {20000, 50, true}, {0, 50, true},
+};
+static const pwm_seq_t breathe = {breathe_steps, sizeof(breathe_steps) / sizeof(breathe_steps[0]), 0};
+
+static pwm_seq_port_t sequencer;
+
 void app_main(void){
   int groupid = 0;
   int gpio_num1 = 5;
@@ -79,22 +94,21 @@ void app_main(void){
   compare_event.action = MCPWM_GEN_ACTION_LOW;
   ret = mcpwm_generator_set_action_on_compare_event( generator, compare_event );
 
+  // 値の更新はタイマのTEZ割込みでシーケンスから行う(タスクは切り替えを指示するだけ)
+  pwm_seq_port_init(&sequencer, timer, comparator, 0);
+
   // enable & start timer
   ret = mcpwm_timer_enable(timer);
   ret = mcpwm_timer_start_stop(timer, MCPWM_TIMER_START_NO_STOP);
 
+  // コンパレータの入力範囲は0～period_ticksまで
+  // period_ticks/2だとduty比=0.5の矩形波になる
+  // 10秒毎に階段と呼吸を切り替える。切り替えは1秒(50周期)かけてブレンドする
+  pwm_seq_port_play(&sequencer, &stairs, 0);
   while (1) {
-    // コンパレータの入力範囲は0～period_ticksまで
-    // period_ticks/2だとduty比=0.5の矩形波になる
-    ret = mcpwm_comparator_set_compare_value(comparator, 0);
-    delay_ms(2000);
-    ret = mcpwm_comparator_set_compare_value(comparator, 5000);
-    delay_ms(2000);
-    ret = mcpwm_comparator_set_compare_value(comparator, 10000);
-    delay_ms(2000);
-    ret = mcpwm_comparator_set_compare_value(comparator, 15000);
-    delay_ms(2000);
-    ret = mcpwm_comparator_set_compare_value(comparator, 20000);
-    delay_ms(2000);
+    delay_ms(10000);
+    pwm_seq_port_play(&sequencer, &breathe, 50);
+    delay_ms(10000);
+    pwm_seq_port_play(&sequencer, &stairs, 50);
   }
 }
@@ -0,0 +1,86 @@
+#include <stddef.h>
+#include "pwm_sequence.h"
+
+static void cursor_start(pwm_seq_cursor_t *c, const pwm_seq_t *seq, uint32_t from){
+  c->seq = seq;
+  c->step = 0;
+  c->elapsed = 0;
+  c->loop = 0;
+  c->from = from;
+  c->value = from;
+  c->done = seq == NULL || seq->num_steps <= 0;
+}
+
+static uint32_t cursor_next(pwm_seq_cursor_t *c){
+  if (c->done) {
+    return c->value;
+  }
+  const pwm_seq_step_t *s = &c->seq->steps[c->step];
+  uint32_t periods = s->periods ? s->periods : 1;
+  c->elapsed++;
+  if (s->ramp) {
+    // 最後の周期でちょうどcmpになる
+    c->value = c->from + (int32_t)((int64_t)((int32_t)s->cmp - (int32_t)c->from) * (int32_t)c->elapsed / (int32_t)periods);
+  } else {
+    c->value = s->cmp;
+  }
+  if (c->elapsed >= periods) {
+    c->from = s->cmp;
+    c->elapsed = 0;
+    if (++c->step >= c->seq->num_steps) {
+      c->step = 0;
+      c->loop++;
+      if (c->seq->loops > 0 && c->loop >= c->seq->loops) {
+        c->done = true;
+      }
+    }
+  }
+  return c->value;
+}
+
+void pwm_seq_player_init(pwm_seq_player_t *p, uint32_t cmp){
+  cursor_start(&p->cur, NULL, cmp);
+  cursor_start(&p->next, NULL, cmp);
+  p->blend_periods = 0;
+  p->blend_elapsed = 0;
+  p->blending = false;
+  p->value = cmp;
+  p->periods = 0;
+}
+
+void pwm_seq_play(pwm_seq_player_t *p, const pwm_seq_t *seq, uint32_t blend_periods){
+  if (blend_periods == 0) {
+    cursor_start(&p->cur, seq, p->value);
+    p->blending = false;
+    return;
+  }
+  if (p->blending) {
+    // 2つを混ぜている途中なので、今の値で止めたものから移る
+    cursor_start(&p->cur, NULL, p->value);
+  }
+  cursor_start(&p->next, seq, p->value);
+  p->blend_periods = blend_periods;
+  p->blend_elapsed = 0;
+  p->blending = true;
+}
+
+uint32_t pwm_seq_next(pwm_seq_player_t *p){
+  uint32_t a = cursor_next(&p->cur);
+  uint32_t out = a;
+  if (p->blending) {
+    uint32_t b = cursor_next(&p->next);
+    p->blend_elapsed++;
+    out = a + (int32_t)((int64_t)((int32_t)b - (int32_t)a) * (int32_t)p->blend_elapsed / (int32_t)p->blend_periods);
+    if (p->blend_elapsed >= p->blend_periods) {
+      p->cur = p->next;
+      p->blending = false;
+    }
+  }
+  p->value = out;
+  p->periods++;
+  return out;
+}
+
+bool pwm_seq_done(const pwm_seq_player_t *p){
+  return !p->blending && p->cur.done;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// MCPWMのコンパレータ値のシーケンス再生（ロジック部分）
+// ステップ(コンパレータ値と、PWM周期を単位にした長さ)の配列を用意しておき、
+// タイマのTEZ(カウンタ0)の割込みから毎周期pwm_seq_next()を呼んで次の周期の値を得る
+//   - ループ: 回数を指定するか、0なら無限に繰り返す
+//   - ramp: 直前の値からそのステップの値まで、1周期ずつ直線で変化させる
+//   - ブレンド: pwm_seq_play()で次のシーケンスを指定すると、blend_periodsかけて
+//               両方を進めながら今のシーケンスから次のシーケンスへ重みを移す
+// 時間はPWM周期で数えるので、値が変わるのは必ず周期の境目になる(タスクのdelayのようなぶれがない)
+// 1周期の計算は加減算と乗除算が数回だけ
+// ESP-IDFに依存しないので、ホストでも確認できる
+
+typedef struct {
+  uint32_t cmp;          // コンパレータ値
+  uint16_t periods;      // 長さ(PWM周期の数、0は1とみなす)
+  bool ramp;             // 直前の値からcmpまで直線で変化させる
+} pwm_seq_step_t;
+
+typedef struct {
+  const pwm_seq_step_t *steps;
+  int num_steps;
+  int loops;             // 繰り返す回数、0なら無限
+} pwm_seq_t;
+
+// 1つのシーケンスの再生位置(seqがNULLならvalueを出し続ける)
+typedef struct {
+  const pwm_seq_t *seq;
+  int step;
+  uint32_t elapsed;      // ステップの中の経過周期
+  int loop;              // 終わった回数
+  uint32_t from;         // rampの始点(直前のステップの値)
+  uint32_t value;        // 最後に出した値
+  bool done;
+} pwm_seq_cursor_t;
+
+typedef struct {
+  pwm_seq_cursor_t cur;
+  pwm_seq_cursor_t next;      // ブレンド中の移り先
+  uint32_t blend_periods;
+  uint32_t blend_elapsed;
+  bool blending;
+  uint32_t value;             // 最後に出した値
+  uint32_t periods;           // 再生した周期の数
+} pwm_seq_player_t;
+
+// cmp: 再生を始めるまで出す値
+void pwm_seq_player_init(pwm_seq_player_t *p, uint32_t cmp);
+// シーケンスを切り替える。blend_periodsが0なら次の周期から切り替える
+// ブレンド中に呼んだら、その時点の値から新しいシーケンスへブレンドし直す
+// 割込みのpwm_seq_next()と同時に呼ばないこと(呼び出し側でロックする)
+void pwm_seq_play(pwm_seq_player_t *p, const pwm_seq_t *seq, uint32_t blend_periods);
+// 次の周期のコンパレータ値、TEZの割込みから毎周期呼ぶ
+uint32_t pwm_seq_next(pwm_seq_player_t *p);
+// 最後まで再生したらtrue(無限ループなら終わらない)、その後は最後の値を出し続ける
+bool pwm_seq_done(const pwm_seq_player_t *p);
@@ -0,0 +1,36 @@
+#include "pwm_sequence_port.h"
+
+// CONFIG_MCPWM_ISR_IRAM_SAFEは無効なので、コールバックはフラッシュに置く(IRAM_ATTRを付けない)
+// フラッシュの書き込み中は割込みが待たされるが、遅れが1周期より短ければ値は次のTEZで反映され、切り替わりは周期の境目のまま
+static bool on_timer_empty(mcpwm_timer_handle_t timer, const mcpwm_timer_event_data_t *edata, void *user_ctx){
+  pwm_seq_port_t *port = (pwm_seq_port_t *)user_ctx;
+  portENTER_CRITICAL_ISR(&port->lock);
+  uint32_t cmp = pwm_seq_next(&port->player);
+  portEXIT_CRITICAL_ISR(&port->lock);
+  mcpwm_comparator_set_compare_value(port->cmpr, cmp);
+  return false;
+}
+
+void pwm_seq_port_init(pwm_seq_port_t *port, mcpwm_timer_handle_t timer, mcpwm_cmpr_handle_t cmpr, uint32_t initial_cmp){
+  port->cmpr = cmpr;
+  portMUX_INITIALIZE(&port->lock);
+  pwm_seq_player_init(&port->player, initial_cmp);
+  ESP_ERROR_CHECK(mcpwm_comparator_set_compare_value(cmpr, initial_cmp));
+  mcpwm_timer_event_callbacks_t callbacks = {
+    .on_empty = on_timer_empty,
+  };
+  ESP_ERROR_CHECK(mcpwm_timer_register_event_callbacks(timer, &callbacks, port));
+}
+
+void pwm_seq_port_play(pwm_seq_port_t *port, const pwm_seq_t *seq, uint32_t blend_periods){
+  portENTER_CRITICAL(&port->lock);
+  pwm_seq_play(&port->player, seq, blend_periods);
+  portEXIT_CRITICAL(&port->lock);
+}
+
+bool pwm_seq_port_done(pwm_seq_port_t *port){
+  portENTER_CRITICAL(&port->lock);
+  bool done = pwm_seq_done(&port->player);
+  portEXIT_CRITICAL(&port->lock);
+  return done;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <freertos/FreeRTOS.h>
+#include "driver/mcpwm_prelude.h"
+#include "pwm_sequence.h"
+
+// コンパレータ値のシーケンス再生(ESP-IDF部分)
+// タイマのon_empty(TEZ)のコールバックでpwm_seq_next()を呼び、コンパレータに書く
+// コンパレータはupdate_cmp_on_tezで作っておくこと。TEZで書いた値は次のTEZで反映されるので、
+// 割込みの遅れ(キャッシュミスなど)があっても出力が切り替わるのは周期の境目ちょうどになる
+// 再生中にタスクは使わない。タスクはpwm_seq_port_play()で次のシーケンスを渡すだけ
+
+typedef struct {
+  mcpwm_cmpr_handle_t cmpr;
+  pwm_seq_player_t player;
+  portMUX_TYPE lock;
+} pwm_seq_port_t;
+
+// タイマをenableする前に呼ぶ(コールバックの登録はタイマが止まっている間しかできない)
+void pwm_seq_port_init(pwm_seq_port_t *port, mcpwm_timer_handle_t timer, mcpwm_cmpr_handle_t cmpr, uint32_t initial_cmp);
+// blend_periods: 今のシーケンスから移るまでのPWM周期の数(0ならすぐ)
+void pwm_seq_port_play(pwm_seq_port_t *port, const pwm_seq_t *seq, uint32_t blend_periods);
+bool pwm_seq_port_done(pwm_seq_port_t *port);
@@ -0,0 +1,96 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// 入力(ボタン、エンコーダなど)のチャタリングとノイズの処理（ロジック部分）
+//
+// 割込みで全部のエッジ(ANYEDGE)をic_edge()に渡し、タスクがic_poll()で確定した変化を受け取る
+//
+// デバウンス: 最後のエッジからwindow_us変化がなければ、そのレベルを確定する
+//   window_usより短いパルス(チャタリング、ひげ)は確定しない。確定はwindow_usだけ遅れる
+// 自動調整: エッジの間隔(パルス幅)を2のべき乗の区間毎に数えておき(ヒストグラム)、
+//   短い山(チャタリング、ノイズ)と長い山(本当の操作)の間の一番広い谷の中央をwindow_usにする
+//   谷が見つからなければ(山が1つ)変えない。learn_pulses個毎に調べ直す
+//   短い山がPCNTのグリッチフィルタ(最大IC_PCNT_GLITCH_MAX_NS)に収まるなら、その値もglitch_nsに出す
+// 割込みの嵐: storm_period_usの間のエッジがstorm_edgesを超えたら、ic_edge()がIC_ACTION_MASKを返す
+//   呼ぶ側は割込みを止め、ic_unmask_due()になったら割込みを戻してic_resync()で今のレベルを渡す
+//   止める時間はmask_usから始めて、続けて嵐になると倍にする(mask_max_usまで)。1秒静かなら戻す
+// ESP-IDFに依存しないので、ホストでも確認できる
+
+#define IC_HIST_BINS          24       // 1us ～ 2^23us(約8秒)
+#define IC_PCNT_GLITCH_MAX_NS 12787    // PCNTのグリッチフィルタの上限(APB 80MHzで1023クロック)
+
+typedef struct {
+  uint32_t window_us;        // 最初のデバウンス時間(自動調整するまで)
+  uint32_t window_min_us;    // 自動調整の範囲
+  uint32_t window_max_us;
+  uint32_t learn_pulses;     // この数のパルス幅が集まる毎に調整する(0なら調整しない)
+  uint32_t storm_period_us;
+  uint32_t storm_edges;      // storm_period_usの間にこれを超えたら嵐とみなす(0なら見ない)
+  uint32_t mask_us;
+  uint32_t mask_max_us;
+} ic_config_t;
+
+typedef enum {
+  IC_ACTION_NONE,
+  IC_ACTION_MASK,            // 割込みを止める
+} ic_action_t;
+
+typedef struct {
+  uint32_t irq_per_s;        // 直近1秒の割込み(エッジ)数
+  uint32_t edges;            // 累計のエッジ数
+  uint32_t changes;          // 確定した変化の数
+  uint32_t rejected;         // 確定しなかったパルスの数(チャタリング、ひげ)
+  uint32_t storms;
+  uint32_t masked_us;        // 割込みを止めていた時間の累計
+  uint32_t window_us;        // 今のデバウンス時間
+  uint32_t glitch_ns;        // PCNTのグリッチフィルタで足りるならその値、足りなければ0
+  bool masked;
+} ic_stats_t;
+
+typedef struct {
+  ic_config_t config;
+  uint32_t window_us;
+  uint32_t glitch_ns;
+  // デバウンス
+  int raw_level;
+  int stable_level;
+  int64_t last_edge_us;
+  bool pending;
+  bool width_valid;          // last_edge_usがエッジの時刻(割込みを戻した直後はそうではない)
+  uint32_t pulses_in_burst;  // 確定するまでのエッジ数
+  // パルス幅のヒストグラム
+  uint32_t hist[IC_HIST_BINS];
+  uint32_t hist_total;
+  uint32_t learned;
+  // 嵐
+  int64_t storm_start_us;
+  uint32_t storm_count;
+  bool masked;
+  int64_t masked_since_us;
+  int64_t unmask_us;         // 割込みを戻す時刻(戻した後は戻した時刻)
+  uint32_t backoff_us;
+  // 統計
+  int64_t rate_start_us;
+  uint32_t rate_count;
+  ic_stats_t stats;
+} ic_input_t;
+
+void ic_init(ic_input_t *in, const ic_config_t *config, int level, int64_t now_us);
+
+// 割込みから呼ぶ(levelはエッジの後のレベル)
+ic_action_t ic_edge(ic_input_t *in, int64_t t_us, int level);
+
+// タスクから呼ぶ。変化が確定したらtrueで*levelに書く
+bool ic_poll(ic_input_t *in, int64_t now_us, int *level);
+// 次にic_pollかic_unmask_dueを呼ぶべき時刻(何も待っていなければINT64_MAX)
+int64_t ic_next_deadline(const ic_input_t *in);
+
+bool ic_unmask_due(const ic_input_t *in, int64_t now_us);
+// 割込みを戻したときに今のレベルを渡す(止めていた間の変化はここからデバウンスする)
+void ic_resync(ic_input_t *in, int64_t now_us, int level);
+
+// ヒストグラムからwindow_usとglitch_nsを決め直す。変わったらtrue
+bool ic_tune(ic_input_t *in);
+
+void ic_get_stats(const ic_input_t *in, ic_stats_t *stats);
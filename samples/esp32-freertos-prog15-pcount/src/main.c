@@ -18,6 +18,10 @@
 
 #include "esp_sleep.h"
 #include "driver/pulse_cnt.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "pm_policy_port.h"
+#include "input_cond.h"
 
 #define TWDT_TIMEOUT_MS 2000
 
@@ -73,8 +77,134 @@ B         +-----+     +-----+     +-----+
 #define EXAMPLE_EC11_GPIO_A 5
 #define EXAMPLE_EC11_GPIO_B 6
 
+//------------------------
+// 省電力
+//------------------------
+// 状態毎の復帰時間(実測して合わせる)。ライトスリープはCPUの電源を落とすのでRAMの復帰も含む
+static const pm_config_t pm_config = {
+  .exit_latency_us = {
+    [PM_STATE_ACTIVE] = 0,
+    [PM_STATE_IDLE] = 50,
+    [PM_STATE_LIGHT_SLEEP] = 1500,
+  },
+};
+#define PM_MAX_FREQ_MHZ 160
+#define PM_MIN_FREQ_MHZ 40        // XTAL
+
+// 回している間はPCNTを動かしておく(ライトスリープ中はAPBクロックが止まって数えない)
+#define ENCODER_LATENCY_US 500
+#define ENCODER_IDLE_MS    1000   // 最後に動いてからこれだけ経ったらライトスリープを許す
+#define REPORT_PERIOD_MS   100
+#define STATS_PERIOD_MS    5000
+
+// ウェイクアップレイテンシのプローブの周期。プローブもCPUを起こすので、眠れる状態では間隔を空ける
+static const uint32_t probe_period_ms[PM_STATE_COUNT] = {
+  [PM_STATE_ACTIVE] = 20,
+  [PM_STATE_IDLE] = 100,
+  [PM_STATE_LIGHT_SLEEP] = 1000,
+};
+
+// グリッチフィルタの調整(input_cond.c、prog9と同じファイル)
+// 回している間はA相のエッジの時刻を割込みで記録し、タスクでパルス幅のヒストグラムにする
+// チャタリングの山がPCNTのグリッチフィルタに収まれば、その幅を次にPCNTを止めたとき(スリープの前)に入れる
+// (pcnt_unit_set_glitch_filterは止めた状態でしか呼べない)。収まらなければ今の値のまま
+#define ENCODER_GLITCH_NS  1000   // 学習するまでの値
+#define EDGE_RING_SIZE     256    // 100ms毎に取り出すので、2kHzのエッジまで落とさない
+static const ic_config_t encoder_learn_config = {
+  .window_us = 1000,
+  .window_min_us = 1,
+  .window_max_us = 1000000,
+  .learn_pulses = 64,
+  .storm_edges = 0,               // 割込みは止めない(数えるのはPCNT)
+};
+
+// ウェイクアップ割込みからキューに送る値(ウォッチポイントの値と区別する)
+#define ENCODER_WAKE_EVENT INT32_MIN
+
+// A相のエッジの時刻(割込みはフラッシュに触らないように、記録だけしてタスクで集計する)
+static int64_t edge_times[EDGE_RING_SIZE];
+static volatile uint32_t edge_head = 0;
+static uint32_t edge_tail = 0;
+static volatile uint32_t edge_dropped = 0;
+static volatile bool encoder_asleep = false;
+static ic_input_t encoder_input;
+static int encoder_level = 0;
+static uint32_t glitch_ns = ENCODER_GLITCH_NS;
+
+// 回している間: エッジの時刻を記録する
+// ライトスリープ中: A相が変わったら起こす(レベルのウェイクアップなので、今と逆のレベルにする)
+// レベルの割込みは続けて入るので、1回目で止めてタスクに知らせる(gpio_intr_disableはCONFIG_GPIO_CTRL_FUNC_IN_IRAMでIRAM)
+static void IRAM_ATTR encoder_a_isr(void *arg){
+  if (!encoder_asleep) {
+    uint32_t head = edge_head;
+    if (head - edge_tail < EDGE_RING_SIZE) {
+      edge_times[head % EDGE_RING_SIZE] = esp_timer_get_time();
+      edge_head = head + 1;
+    } else {
+      edge_dropped++;
+    }
+    return;
+  }
+  QueueHandle_t queue = (QueueHandle_t)arg;
+  BaseType_t high_task_wakeup = pdFALSE;
+  int event = ENCODER_WAKE_EVENT;
+  gpio_intr_disable(EXAMPLE_EC11_GPIO_A);
+  xQueueSendFromISR(queue, &event, &high_task_wakeup);
+  portYIELD_FROM_ISR(high_task_wakeup);
+}
+
+// 記録したエッジをパルス幅にする。ANYEDGEなのでレベルは交互(読む前に戻った細いパルスも短い幅になる)
+static void encoder_learn(int64_t now){
+  while (edge_tail != edge_head) {
+    encoder_level ^= 1;
+    ic_edge(&encoder_input, edge_times[edge_tail % EDGE_RING_SIZE], encoder_level);
+    edge_tail++;
+  }
+  int level;
+  ic_poll(&encoder_input, now, &level);
+}
+
+// PCNTを止めている間にグリッチフィルタを学習した値にする
+static void encoder_apply_glitch(pcnt_unit_handle_t unit){
+  ic_stats_t s;
+  ic_get_stats(&encoder_input, &s);
+  if (s.glitch_ns == 0 || s.glitch_ns == glitch_ns) {
+    return;
+  }
+  pcnt_glitch_filter_config_t filter_config = {
+    .max_glitch_ns = s.glitch_ns,
+  };
+  ESP_ERROR_CHECK(pcnt_unit_set_glitch_filter(unit, &filter_config));
+  ESP_LOGI(TAG, "glitch filter %luns -> %luns", (unsigned long)glitch_ns, (unsigned long)s.glitch_ns);
+  glitch_ns = s.glitch_ns;
+}
+
+// 止める: PCNTはグリッチフィルタのためにESP_PM_APB_FREQ_MAXのロックを持つので、disableしないとスリープしない
+static void encoder_sleep(pcnt_unit_handle_t unit){
+  ESP_ERROR_CHECK(pcnt_unit_stop(unit));
+  ESP_ERROR_CHECK(pcnt_unit_disable(unit));
+  encoder_apply_glitch(unit);
+  ESP_ERROR_CHECK(gpio_intr_disable(EXAMPLE_EC11_GPIO_A));
+  encoder_asleep = true;
+  int level = gpio_get_level(EXAMPLE_EC11_GPIO_A);
+  ESP_ERROR_CHECK(gpio_wakeup_enable(EXAMPLE_EC11_GPIO_A, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL));
+  ESP_ERROR_CHECK(gpio_intr_enable(EXAMPLE_EC11_GPIO_A));
+}
+
+static void encoder_wake(pcnt_unit_handle_t unit){
+  ESP_ERROR_CHECK(gpio_wakeup_disable(EXAMPLE_EC11_GPIO_A));
+  // 眠っていた時間はパルス幅に数えない
+  encoder_level = gpio_get_level(EXAMPLE_EC11_GPIO_A);
+  ic_resync(&encoder_input, esp_timer_get_time(), encoder_level);
+  encoder_asleep = false;
+  ESP_ERROR_CHECK(gpio_set_intr_type(EXAMPLE_EC11_GPIO_A, GPIO_INTR_ANYEDGE));
+  ESP_ERROR_CHECK(gpio_intr_enable(EXAMPLE_EC11_GPIO_A));
+  ESP_ERROR_CHECK(pcnt_unit_enable(unit));
+  ESP_ERROR_CHECK(pcnt_unit_start(unit));
+}
+
 bool IRAM_ATTR example_pcnt_on_reach(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx){
-  BaseType_t high_task_wakeup;
+  BaseType_t high_task_wakeup = pdFALSE;
   QueueHandle_t queue = (QueueHandle_t)user_ctx;
   /*
   typedef enum {
@@ -90,13 +220,18 @@ bool IRAM_ATTR example_pcnt_on_reach(pcnt_unit_handle_t unit, const pcnt_watch_e
   } pcnt_watch_event_data_t;
   */
   // send event data to queue, from this interrupt callback
-  esp_rom_printf("event = %d, mode = %d\n",edata->watch_point_value, edata->zero_cross_mode);
+  // CONFIG_PCNT_ISR_IRAM_SAFE=yなので、書式の文字列もフラッシュではなくDRAMに置く
+  esp_rom_printf(DRAM_STR("event = %d, mode = %d\n"),edata->watch_point_value, edata->zero_cross_mode);
   xQueueSendFromISR(queue, &(edata->watch_point_value), &high_task_wakeup);
   //xQueueSendFromISR(queue, &(edata), &high_task_wakeup);
   return (high_task_wakeup == pdTRUE);
 }
 
 void app_main(void){
+  ESP_ERROR_CHECK(pm_port_init(&pm_config, PM_MAX_FREQ_MHZ, PM_MIN_FREQ_MHZ));
+  int encoder_client = pm_port_add_client("encoder", ENCODER_LATENCY_US);
+  ESP_ERROR_CHECK(pm_port_start_probe(probe_period_ms, 2, tskNO_AFFINITY));
+
   ESP_LOGI(TAG, "install pcnt unit");
   pcnt_unit_config_t unit_config = {
       .high_limit = EXAMPLE_PCNT_HIGH_LIMIT,
@@ -107,7 +242,7 @@ void app_main(void){
 
   ESP_LOGI(TAG, "set glitch filter");
   pcnt_glitch_filter_config_t filter_config = {
-    .max_glitch_ns = 1000,
+    .max_glitch_ns = ENCODER_GLITCH_NS,
   };
   pcnt_unit_set_glitch_filter(pcnt_unit, &filter_config);
 
@@ -189,20 +324,57 @@ void app_main(void){
   ESP_LOGI(TAG, "start pcnt unit");
   pcnt_unit_start(pcnt_unit);
 
-  // Report counter value
+  // A相のエッジを記録し、ライトスリープ中の変化で起こす
+  encoder_level = gpio_get_level(EXAMPLE_EC11_GPIO_A);
+  ic_init(&encoder_input, &encoder_learn_config, encoder_level, esp_timer_get_time());
+  ESP_ERROR_CHECK(gpio_install_isr_service(0));
+  ESP_ERROR_CHECK(gpio_set_intr_type(EXAMPLE_EC11_GPIO_A, GPIO_INTR_ANYEDGE));
+  ESP_ERROR_CHECK(gpio_isr_handler_add(EXAMPLE_EC11_GPIO_A, encoder_a_isr, queue));
+  ESP_ERROR_CHECK(gpio_intr_enable(EXAMPLE_EC11_GPIO_A));
+  ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+
+  // カウントが変わったら報告する。1msのポーリングはやめて、キューで待つ(待っている間はティックレスで眠る)
   int pulse_count = 0;
-  int event_count = 0;
-  pcnt_watch_event_data_t edata = {0};
+  int last_count = 0;
+  int event_value = 0;
+  bool sleeping = false;
+  int64_t last_activity_us = esp_timer_get_time();
+  int64_t last_stats_us = last_activity_us;
   while (1) {
-    event_count = -1;
-    if (xQueueReceive(queue, &edata, pdMS_TO_TICKS(0))) {
+    bool received = xQueueReceive(queue, &event_value, pdMS_TO_TICKS(REPORT_PERIOD_MS)) == pdTRUE;
+    int64_t now = esp_timer_get_time();
+    encoder_learn(now);
+    if (received && event_value == ENCODER_WAKE_EVENT) {
+      // 先に要求を戻してからPCNTを動かす(ライトスリープに入り直さないように)
+      ESP_LOGI(TAG, "wake up by encoder");
+      pm_port_set_latency(encoder_client, ENCODER_LATENCY_US);
+      encoder_wake(pcnt_unit);
+      sleeping = false;
+      last_activity_us = now;
+    } else if (sleeping) {
+      // 起こされるまで数えない
+    } else if (pcnt_unit_get_count(pcnt_unit, &pulse_count) == ESP_OK && (received || pulse_count != last_count)) {
       // 割込み関数から送信された値
-      pcnt_unit_get_count(pcnt_unit, &pulse_count);
-      ESP_LOGI(TAG, "[pulse count] %d, [event count] %d", pulse_count, event_count);
-    }else{
-      pcnt_unit_get_count(pcnt_unit, &pulse_count);
-      ESP_LOGI(TAG, "[pulse count] %d", pulse_count);
+      if (received) {
+        ESP_LOGI(TAG, "[pulse count] %d, [watch point] %d", pulse_count, event_value);
+      } else {
+        ESP_LOGI(TAG, "[pulse count] %d", pulse_count);
+      }
+      last_count = pulse_count;
+      last_activity_us = now;
+    } else if (now - last_activity_us >= ENCODER_IDLE_MS * 1000) {
+      ESP_LOGI(TAG, "encoder idle, allow light sleep");
+      encoder_sleep(pcnt_unit);
+      pm_port_set_latency(encoder_client, PM_LATENCY_ANY);
+      sleeping = true;
+    }
+    if (now - last_stats_us >= STATS_PERIOD_MS * 1000) {
+      pm_port_log_stats();
+      ic_stats_t s;
+      ic_get_stats(&encoder_input, &s);
+      ESP_LOGI(TAG, "encoder edges=%lu dropped=%lu glitch=%luns (learned %luns)", (unsigned long)s.edges,
+        (unsigned long)edge_dropped, (unsigned long)glitch_ns, (unsigned long)s.glitch_ns);
+      last_stats_us = now;
     }
-    delay_ms(1);
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,100 @@
+#include <string.h>
+#include "pm_policy.h"
+
+static uint32_t min_latency(const pm_policy_t *p){
+  uint32_t latency = PM_LATENCY_ANY;
+  for (int i = 0; i < p->num_clients; i++) {
+    if (p->latency_us[i] < latency) {
+      latency = p->latency_us[i];
+    }
+  }
+  return latency;
+}
+
+pm_state_t pm_policy_select(const pm_config_t *config, uint32_t latency_us){
+  for (int s = PM_STATE_COUNT - 1; s > PM_STATE_ACTIVE; s--) {
+    if (config->exit_latency_us[s] <= latency_us) {
+      return (pm_state_t)s;
+    }
+  }
+  return PM_STATE_ACTIVE;
+}
+
+// 要求を計算し直して、状態が変わったら選んでいた時間を締める
+static bool update(pm_policy_t *p, int64_t now_us){
+  uint32_t latency = min_latency(p);
+  pm_state_t next = pm_policy_select(&p->config, latency);
+  p->stats.latency_us = latency;
+  if (next == p->state) {
+    return false;
+  }
+  p->stats.selected_us[p->state] += (uint64_t)(now_us - p->since_us);
+  p->state = next;
+  p->since_us = now_us;
+  p->stats.entries[next]++;
+  return true;
+}
+
+void pm_policy_init(pm_policy_t *p, const pm_config_t *config, int64_t now_us){
+  memset(p, 0, sizeof(*p));
+  p->config = *config;
+  p->config.exit_latency_us[PM_STATE_ACTIVE] = 0;
+  p->state = pm_policy_select(&p->config, PM_LATENCY_ANY);
+  p->since_us = now_us;
+  p->stats.entries[p->state] = 1;
+  p->stats.latency_us = PM_LATENCY_ANY;
+}
+
+int pm_policy_add_client(pm_policy_t *p, const char *name, uint32_t latency_us, int64_t now_us){
+  if (p->num_clients >= PM_MAX_CLIENTS) {
+    return -1;
+  }
+  int id = p->num_clients++;
+  p->names[id] = name;
+  p->latency_us[id] = latency_us;
+  update(p, now_us);
+  return id;
+}
+
+bool pm_policy_set_latency(pm_policy_t *p, int client, uint32_t latency_us, int64_t now_us){
+  if (client < 0 || client >= p->num_clients) {
+    return false;
+  }
+  p->latency_us[client] = latency_us;
+  return update(p, now_us);
+}
+
+pm_state_t pm_policy_state(const pm_policy_t *p){
+  return p->state;
+}
+
+void pm_policy_wake(pm_policy_t *p, uint32_t latency_us){
+  pm_stats_t *s = &p->stats;
+  s->wakes++;
+  s->wake_total_us += latency_us;
+  if (latency_us > s->wake_max_us) {
+    s->wake_max_us = latency_us;
+  }
+  if (latency_us > s->wake_max_us_by_state[p->state]) {
+    s->wake_max_us_by_state[p->state] = latency_us;
+  }
+  if (latency_us > s->latency_us) {
+    s->violations++;
+  }
+}
+
+void pm_policy_slept(pm_policy_t *p, uint32_t sleeps, uint64_t slept_us){
+  p->stats.sleeps += sleeps;
+  p->stats.slept_us += slept_us;
+}
+
+void pm_policy_get_stats(const pm_policy_t *p, int64_t now_us, pm_stats_t *stats){
+  *stats = p->stats;
+  stats->state = p->state;
+  stats->selected_us[p->state] += (uint64_t)(now_us - p->since_us);
+}
+
+const char *pm_state_name(pm_state_t state){
+  static const char *names[] = {"active", "idle", "light_sleep"};
+  return state < PM_STATE_COUNT ? names[state] : "?";
+}
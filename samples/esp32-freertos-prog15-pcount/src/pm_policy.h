@@ -0,0 +1,76 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// 省電力の状態の選択（ロジック部分）
+//
+// タスク(クライアント)毎に「起こされてから動き出すまでに待てる時間」(最大ウェイクアップレイテンシ)を宣言し、
+// 全クライアントの最小値を満たす一番深い状態を選ぶ
+//   ACTIVE      : CPU最高周波数に固定、スリープしない(レイテンシ0)
+//   IDLE        : 周波数を下げてティックレスのWAITI、ライトスリープはしない(周波数を戻す時間)
+//   LIGHT_SLEEP : 自動ライトスリープ(CPUの電源を落とすとRAMの復帰も含めて1ms程度)
+// 各状態の復帰時間(exit_latency_us)は実測で決める。pm_policy_wake()に渡した実測値が要求を超えた回数も数える
+//
+// 状態毎に選んでいた時間と入った回数、実際にライトスリープしていた時間、実測したウェイクアップレイテンシを統計に出す
+// LIGHT_SLEEPを選んでいても、タスクが動いている間やドライバがロックを持つ間は眠らないので、
+// 選んでいた時間(selected_us)と眠った時間(slept_us)は別に数える
+// ESP-IDFに依存しないので、ホストでも確認できる
+
+#define PM_MAX_CLIENTS 8
+#define PM_LATENCY_ANY UINT32_MAX  // 要求なし(どの状態でもよい)
+
+typedef enum {
+  PM_STATE_ACTIVE,
+  PM_STATE_IDLE,
+  PM_STATE_LIGHT_SLEEP,
+  PM_STATE_COUNT,
+} pm_state_t;
+
+typedef struct {
+  uint32_t exit_latency_us[PM_STATE_COUNT];  // ACTIVEは0
+} pm_config_t;
+
+typedef struct {
+  pm_state_t state;
+  uint32_t latency_us;                     // 今の要求(全クライアントの最小値)
+  uint64_t selected_us[PM_STATE_COUNT];    // 状態を選んでいた時間の累計(実際に眠った時間ではない)
+  uint32_t entries[PM_STATE_COUNT];        // 状態に入った回数
+  uint64_t slept_us;                       // 実際にライトスリープしていた時間の累計(pm_policy_slept)
+  uint32_t sleeps;                         // ライトスリープした回数
+  uint32_t wakes;                          // 実測したウェイクアップの回数
+  uint32_t wake_max_us;
+  uint64_t wake_total_us;
+  uint32_t wake_max_us_by_state[PM_STATE_COUNT];
+  uint32_t violations;                     // 実測値がそのときの要求を超えた回数
+} pm_stats_t;
+
+typedef struct {
+  pm_config_t config;
+  int num_clients;
+  const char *names[PM_MAX_CLIENTS];
+  uint32_t latency_us[PM_MAX_CLIENTS];
+  pm_state_t state;
+  int64_t since_us;                        // 今の状態に入った時刻
+  pm_stats_t stats;
+} pm_policy_t;
+
+// 最初はクライアントがいないのでLIGHT_SLEEP
+void pm_policy_init(pm_policy_t *p, const pm_config_t *config, int64_t now_us);
+// クライアントを追加してidを返す。いっぱいなら-1
+int pm_policy_add_client(pm_policy_t *p, const char *name, uint32_t latency_us, int64_t now_us);
+// 要求を変える。状態が変わったらtrue(呼ぶ側で状態を反映する)
+bool pm_policy_set_latency(pm_policy_t *p, int client, uint32_t latency_us, int64_t now_us);
+pm_state_t pm_policy_state(const pm_policy_t *p);
+// 要求を満たす一番深い状態
+pm_state_t pm_policy_select(const pm_config_t *config, uint32_t latency_us);
+
+// 実測したウェイクアップレイテンシ(起きるはずの時刻から実際に動き出すまで)を記録する
+void pm_policy_wake(pm_policy_t *p, uint32_t latency_us);
+
+// 実際にライトスリープした回数と時間を足す(スリープのコールバックで測ったもの)
+void pm_policy_slept(pm_policy_t *p, uint32_t sleeps, uint64_t slept_us);
+
+// 今の状態を選んでいた時間をnow_usまで足した統計
+void pm_policy_get_stats(const pm_policy_t *p, int64_t now_us, pm_stats_t *stats);
+
+const char *pm_state_name(pm_state_t state);
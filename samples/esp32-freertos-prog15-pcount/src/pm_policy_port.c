@@ -0,0 +1,210 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#include "pm_policy_port.h"
+
+static const char *TAG = "pm_policy";
+
+static pm_policy_t policy;
+static SemaphoreHandle_t mutex;
+static esp_pm_lock_handle_t cpu_max_lock;
+static esp_pm_lock_handle_t no_sleep_lock;
+static bool cpu_max_held = false;
+static bool no_sleep_held = false;
+static bool locks_enabled = false;
+static uint32_t probe_period_ms[PM_STATE_COUNT];
+
+// ライトスリープの前後のコールバックで測った時間(アイドルタスクから呼ばれるので、統計を取るときにまとめて足す)
+static portMUX_TYPE sleep_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t sleep_start_us;
+static uint32_t pending_sleeps;
+static uint64_t pending_slept_us;
+static bool sleep_measured = false;
+
+static void hold(esp_pm_lock_handle_t lock, bool *held, bool want){
+  if (*held == want) {
+    return;
+  }
+  ESP_ERROR_CHECK(want ? esp_pm_lock_acquire(lock) : esp_pm_lock_release(lock));
+  *held = want;
+}
+
+// 深い状態へ移るときは後で離し、浅い状態へ移るときは先に取る(途中でより深い状態にならないように)
+static void apply(pm_state_t state){
+  if (!locks_enabled) {
+    return;
+  }
+  if (state == PM_STATE_ACTIVE) {
+    hold(no_sleep_lock, &no_sleep_held, true);
+    hold(cpu_max_lock, &cpu_max_held, true);
+  } else if (state == PM_STATE_IDLE) {
+    hold(no_sleep_lock, &no_sleep_held, true);
+    hold(cpu_max_lock, &cpu_max_held, false);
+  } else {
+    hold(cpu_max_lock, &cpu_max_held, false);
+    hold(no_sleep_lock, &no_sleep_held, false);
+  }
+}
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+static esp_err_t IRAM_ATTR on_sleep_enter(int64_t sleep_time_us, void *arg){
+  sleep_start_us = esp_timer_get_time();
+  return ESP_OK;
+}
+
+// esp_timerはライトスリープの間も進む(RTCのタイマで補正される)
+static esp_err_t IRAM_ATTR on_sleep_exit(int64_t sleep_time_us, void *arg){
+  int64_t slept = esp_timer_get_time() - sleep_start_us;
+  portENTER_CRITICAL_SAFE(&sleep_lock);
+  pending_sleeps++;
+  pending_slept_us += slept > 0 ? (uint64_t)slept : 0;
+  portEXIT_CRITICAL_SAFE(&sleep_lock);
+  return ESP_OK;
+}
+#endif
+
+static void register_sleep_callbacks(void){
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+  esp_pm_sleep_cbs_register_config_t cbs = {
+    .enter_cb = on_sleep_enter,
+    .exit_cb = on_sleep_exit,
+  };
+  esp_err_t err = esp_pm_light_sleep_register_cbs(&cbs);
+  sleep_measured = err == ESP_OK;
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "esp_pm_light_sleep_register_cbs failed (%s)", esp_err_to_name(err));
+  }
+#else
+  ESP_LOGW(TAG, "CONFIG_PM_LIGHT_SLEEP_CALLBACKS is not set, light sleep time is not measured");
+#endif
+}
+
+esp_err_t pm_port_init(const pm_config_t *config, int max_freq_mhz, int min_freq_mhz){
+  mutex = xSemaphoreCreateMutex();
+  if (mutex == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  pm_policy_init(&policy, config, esp_timer_get_time());
+
+  esp_pm_config_esp32s3_t pm_config = {
+    .max_freq_mhz = max_freq_mhz,
+    .min_freq_mhz = min_freq_mhz,
+    .light_sleep_enable = true,
+  };
+  esp_err_t err = esp_pm_configure(&pm_config);
+  if (err == ESP_ERR_NOT_SUPPORTED) {
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is not set, collecting statistics only");
+    return ESP_OK;
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_pm_configure failed (%s)", esp_err_to_name(err));
+    return err;
+  }
+  ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "pm_active", &cpu_max_lock));
+  ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "pm_idle", &no_sleep_lock));
+  locks_enabled = true;
+  apply(pm_policy_state(&policy));
+  register_sleep_callbacks();
+  ESP_LOGI(TAG, "dfs %d-%dMHz, exit latency idle=%luus light_sleep=%luus", min_freq_mhz, max_freq_mhz,
+    config->exit_latency_us[PM_STATE_IDLE], config->exit_latency_us[PM_STATE_LIGHT_SLEEP]);
+  return ESP_OK;
+}
+
+int pm_port_add_client(const char *name, uint32_t latency_us){
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  int id = pm_policy_add_client(&policy, name, latency_us, esp_timer_get_time());
+  apply(pm_policy_state(&policy));
+  xSemaphoreGive(mutex);
+  return id;
+}
+
+void pm_port_set_latency(int client, uint32_t latency_us){
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (pm_policy_set_latency(&policy, client, latency_us, esp_timer_get_time())) {
+    apply(pm_policy_state(&policy));
+  }
+  xSemaphoreGive(mutex);
+}
+
+// 周期的に起きて、起きるはずの時刻からの遅れを記録する。周期は今の状態で決める
+// 基準の時刻(最初に起きた時刻)からの遅れなので、Tickの境界からタスクが動き出すまでの一定の遅れは含まない
+// 周期が変わったら、次に起きた時刻を新しい基準にする(変わるのは今の周期で待ち終わってから)
+static void probe_task(void *arg){
+  TickType_t last = xTaskGetTickCount();
+  TickType_t period = 0;
+  int64_t expected = 0;
+  bool based = false;
+  while (1) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    TickType_t next = pdMS_TO_TICKS(probe_period_ms[pm_policy_state(&policy)]);
+    xSemaphoreGive(mutex);
+    if (next != period) {
+      period = next;
+      based = false;
+    }
+    vTaskDelayUntil(&last, period);
+    int64_t now = esp_timer_get_time();
+    if (!based) {
+      expected = now;
+      based = true;
+      continue;
+    }
+    expected += (int64_t)period * portTICK_PERIOD_MS * 1000;
+    int64_t late = now - expected;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    pm_policy_wake(&policy, late > 0 ? (uint32_t)late : 0);
+    xSemaphoreGive(mutex);
+  }
+}
+
+esp_err_t pm_port_start_probe(const uint32_t period_ms[PM_STATE_COUNT], UBaseType_t priority, BaseType_t core){
+  for (int i = 0; i < PM_STATE_COUNT; i++) {
+    if (pdMS_TO_TICKS(period_ms[i]) == 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    probe_period_ms[i] = period_ms[i];
+  }
+  if (xTaskCreatePinnedToCore(probe_task, "pm_probe", 2048, NULL, priority, NULL, core) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+void pm_port_get_stats(pm_stats_t *stats){
+  taskENTER_CRITICAL(&sleep_lock);
+  uint32_t sleeps = pending_sleeps;
+  uint64_t slept_us = pending_slept_us;
+  pending_sleeps = 0;
+  pending_slept_us = 0;
+  taskEXIT_CRITICAL(&sleep_lock);
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  pm_policy_slept(&policy, sleeps, slept_us);
+  pm_policy_get_stats(&policy, esp_timer_get_time(), stats);
+  xSemaphoreGive(mutex);
+}
+
+void pm_port_log_stats(void){
+  pm_stats_t s;
+  pm_port_get_stats(&s);
+  uint64_t total = 0;
+  for (int i = 0; i < PM_STATE_COUNT; i++) {
+    total += s.selected_us[i];
+  }
+  for (int i = 0; i < PM_STATE_COUNT; i++) {
+    ESP_LOGI(TAG, "%-11s selected=%3lu%% (%llums) entries=%lu wake max=%luus", pm_state_name((pm_state_t)i),
+      total ? (uint32_t)(s.selected_us[i] * 100 / total) : 0, s.selected_us[i] / 1000, s.entries[i],
+      s.wake_max_us_by_state[i]);
+  }
+  if (sleep_measured) {
+    ESP_LOGI(TAG, "light sleep slept=%3lu%% (%llums) sleeps=%lu", total ? (uint32_t)(s.slept_us * 100 / total) : 0,
+      s.slept_us / 1000, s.sleeps);
+  }
+  ESP_LOGI(TAG, "state=%s latency=%ldus wakes=%lu avg=%luus max=%luus violations=%lu", pm_state_name(s.state),
+    s.latency_us == PM_LATENCY_ANY ? -1L : (long)s.latency_us, s.wakes,
+    s.wakes ? (uint32_t)(s.wake_total_us / s.wakes) : 0, s.wake_max_us, s.violations);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <freertos/FreeRTOS.h>
+#include "esp_err.h"
+#include "pm_policy.h"
+
+// pm_policyのESP-IDF側
+// esp_pmでDFS(max_freq_mhz～min_freq_mhz)と自動ライトスリープを設定し、選んだ状態をロックで反映する
+//   ACTIVE      : ESP_PM_CPU_FREQ_MAX + ESP_PM_NO_LIGHT_SLEEP
+//   IDLE        : ESP_PM_NO_LIGHT_SLEEP(ティックレスのWAITIで最低周波数)
+//   LIGHT_SLEEP : ロックなし
+// ドライバが自分でロックを持つこともある(グリッチフィルタを使うPCNTはenableの間ESP_PM_APB_FREQ_MAX)
+// その間はLIGHT_SLEEPを選んでもスリープしないので、止めるときはドライバもdisableにする
+//
+// プローブのタスクが周期的に起き、起きるはずの時刻と実際に動いた時刻の差をウェイクアップレイテンシとして記録する
+// プローブ自身がCPUを起こすので、周期は状態毎に決める(LIGHT_SLEEPでは長くする)
+// 実際に眠った時間はライトスリープの前後のコールバック(CONFIG_PM_LIGHT_SLEEP_CALLBACKS)で測る
+// CONFIG_PM_ENABLE、CONFIG_FREERTOS_USE_TICKLESS_IDLEが必要(なければロックを使わずに状態の統計だけ取る)
+
+esp_err_t pm_port_init(const pm_config_t *config, int max_freq_mhz, int min_freq_mhz);
+
+// クライアントを追加してidを返す。いっぱいなら-1
+int pm_port_add_client(const char *name, uint32_t latency_us);
+// タスクから呼ぶ。状態が変わればロックを付け替える
+void pm_port_set_latency(int client, uint32_t latency_us);
+
+// period_ms[状態]: その状態を選んでいる間のプローブの周期
+esp_err_t pm_port_start_probe(const uint32_t period_ms[PM_STATE_COUNT], UBaseType_t priority, BaseType_t core);
+
+void pm_port_get_stats(pm_stats_t *stats);
+void pm_port_log_stats(void);
@@ -1,11 +1,28 @@
-from fastapi import FastAPI
+from fastapi import FastAPI, Request
+from fastapi.responses import PlainTextResponse
 import time
 
 # uvicorn app:app --host 0.0.0.0 --port 8000 --reload
 
 app = FastAPI()
 
+# ESP32が定期的に取りに来る設定("key=value"の行)。空ならESP32は今の値のまま
+config_text = ""
+
 
 @app.get("/")
 def read_root():
     return "%s" % (int(time.time()))
+
+
+@app.get("/config", response_class=PlainTextResponse)
+def read_config():
+    return config_text
+
+
+# curl -X PUT --data-binary $'poll_ms=1000\nhttp_timeout=5000\n' http://localhost:8000/config
+@app.put("/config", response_class=PlainTextResponse)
+async def write_config(request: Request):
+    global config_text
+    config_text = (await request.body()).decode()
+    return config_text
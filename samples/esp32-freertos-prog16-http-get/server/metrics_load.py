@@ -0,0 +1,145 @@
+"""prog16の/metricsに負荷をかける(スクレイプが制御のタスクに影響しないかを見る)
+
+  python metrics_load.py --url http://ESP32_IP/metrics --concurrency 4 --duration 30
+  python metrics_load.py --spawn "../../host-sim/build/check_prog16_metrics --serve 0" --duration 2 --check
+
+並列にGETを繰り返して、1秒あたりのリクエスト数、遅延(p50/p90/p99/最大)、エラーを表示する。
+終わった後に/metricsを1回読み、CPUを使っているタスクとページの書き直し(metrics_render_us, metrics_busy)を表示する。
+--spawnはホストのサーバー(host-simのcheck_prog16_metrics)を起動して、表示したポートに負荷をかける。
+--checkはエラーがある、ページがPrometheusの書式でないときに1で終わる(ctestで使う)。
+"""
+import argparse
+import re
+import shlex
+import subprocess
+import sys
+import threading
+import time
+import urllib.request
+
+LINE = re.compile(r'^[a-zA-Z_:][a-zA-Z0-9_:]*(\{[^}]*\})? [-0-9.e+Inf]+$')
+
+
+def parse_metrics(text):
+    """Prometheusのテキストを{(名前, ラベル): 値}にする。書式が違う行があればValueError"""
+    values = {}
+    for line in text.splitlines():
+        if not line or line.startswith("#"):
+            continue
+        if not LINE.match(line):
+            raise ValueError("invalid line: %r" % line)
+        name_labels, value = line.rsplit(" ", 1)
+        name, _, labels = name_labels.partition("{")
+        values[(name, labels.rstrip("}"))] = float(value)
+    return values
+
+
+class Worker(threading.Thread):
+    def __init__(self, url, end, timeout):
+        super().__init__(daemon=True)
+        self.url = url
+        self.end = end
+        self.timeout = timeout
+        self.latencies = []
+        self.bytes = 0
+        self.errors = 0
+
+    def run(self):
+        while time.monotonic() < self.end:
+            start = time.monotonic()
+            try:
+                with urllib.request.urlopen(self.url, timeout=self.timeout) as r:
+                    self.bytes += len(r.read())
+                self.latencies.append(time.monotonic() - start)
+            except Exception:
+                self.errors += 1
+                time.sleep(0.05)
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    return sorted_values[min(len(sorted_values) - 1, int(len(sorted_values) * p / 100))]
+
+
+def spawn(cmd):
+    proc = subprocess.Popen(shlex.split(cmd), stdout=subprocess.PIPE, text=True)
+    for line in proc.stdout:
+        print("[spawn] " + line.rstrip())
+        m = re.search(r"listening on port (\d+)", line)
+        if m:
+            return proc, int(m.group(1))
+    proc.wait()
+    raise RuntimeError("server exited before listening")
+
+
+def show_device(url):
+    """負荷をかけた後のページから、CPUを使っているタスクとレンダリングの値を出す"""
+    with urllib.request.urlopen(url, timeout=5) as r:
+        values = parse_metrics(r.read().decode())
+    tasks = sorted(((v, labels) for (name, labels), v in values.items() if name.endswith("task_cpu_ratio")),
+                   reverse=True)
+    for v, labels in tasks[:6]:
+        print("  cpu %5.1f%% %s" % (v * 100, labels))
+    for (name, labels), v in sorted(values.items()):
+        if re.search(r"(metrics_render_us|metrics_busy_total|http_scrapes_total|heap_free_bytes)$", name):
+            print("  %s %g" % (name, v))
+    return values
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--url", default="http://127.0.0.1/metrics")
+    parser.add_argument("--spawn", help="start a host server and use the port it prints")
+    parser.add_argument("--concurrency", type=int, default=4)
+    parser.add_argument("--duration", type=float, default=10.0)
+    parser.add_argument("--timeout", type=float, default=5.0)
+    parser.add_argument("--check", action="store_true", help="exit 1 on errors or a malformed page")
+    args = parser.parse_args()
+
+    proc = None
+    url = args.url
+    if args.spawn:
+        proc, port = spawn(args.spawn)
+        url = "http://127.0.0.1:%d/metrics" % port
+    try:
+        # 最初のページが書かれるまで待つ
+        deadline = time.monotonic() + 5
+        while True:
+            try:
+                with urllib.request.urlopen(url, timeout=args.timeout) as r:
+                    parse_metrics(r.read().decode())
+                break
+            except Exception:
+                if time.monotonic() > deadline:
+                    raise
+                time.sleep(0.2)
+
+        end = time.monotonic() + args.duration
+        workers = [Worker(url, end, args.timeout) for _ in range(args.concurrency)]
+        for w in workers:
+            w.start()
+        for w in workers:
+            w.join()
+
+        latencies = sorted(l for w in workers for l in w.latencies)
+        errors = sum(w.errors for w in workers)
+        total_bytes = sum(w.bytes for w in workers)
+        print("%s: %d requests, %d errors in %.1fs (concurrency %d)" % (
+            url, len(latencies), errors, args.duration, args.concurrency))
+        print("  %.1f req/s, %.1f KB/s" % (len(latencies) / args.duration, total_bytes / 1024 / args.duration))
+        print("  latency ms: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f" % tuple(
+            percentile(latencies, p) * 1000 for p in (50, 90, 99, 100)))
+        values = show_device(url)
+        if args.check and (errors or not latencies or not values):
+            print("CHECK FAILED", file=sys.stderr)
+            return 1
+        return 0
+    finally:
+        if proc is not None:
+            proc.terminate()
+            proc.wait()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,264 @@
+"""prog16のテレメトリ(src/telemetry.hのバイナリフレーム)を受け取って表示する
+
+  python telemetry_collector.py listen [--port 9000] [--interval 5]
+  python telemetry_collector.py replay frames.bin [--expect values.txt]
+
+replayは長さ(u16 LE)+フレームを並べたファイルを読む(host-simのcheck_prog16_telemetryが書く)。
+--expectがあれば最後の値を比べ、違えば1で終わる。
+"""
+import argparse
+import socket
+import struct
+import sys
+import time
+
+MAGIC = b"TM"
+VERSION = 1
+FRAME_DATA, FRAME_KEY, FRAME_DESC, FRAME_KEY_PART = 0, 1, 2, 3
+COUNTER, GAUGE, HISTOGRAM = 0, 1, 2
+TYPE_NAMES = {COUNTER: "counter", GAUGE: "gauge", HISTOGRAM: "histogram"}
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def more(self):
+        return self.pos < len(self.data)
+
+    def u8(self):
+        if self.pos >= len(self.data):
+            raise ValueError("truncated frame")
+        v = self.data[self.pos]
+        self.pos += 1
+        return v
+
+    def i8(self):
+        v = self.u8()
+        return v - 256 if v >= 128 else v
+
+    def varint(self):
+        v = 0
+        for shift in range(0, 35, 7):
+            b = self.u8()
+            v |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return v & 0xFFFFFFFF
+        raise ValueError("varint too long")
+
+    def zigzag(self):
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+
+def u32(v):
+    return v & 0xFFFFFFFF
+
+
+def i32(v):
+    v &= 0xFFFFFFFF
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+class Metric:
+    def __init__(self, mid, mtype, exp, name, bounds):
+        self.id = mid
+        self.type = mtype
+        self.exp = exp
+        self.name = name
+        self.bounds = bounds
+        self.value = 0
+        self.buckets = [0] * (len(bounds) + 1)
+        self.sum = 0
+
+    def apply(self, r, key):
+        if self.type == COUNTER:
+            self.value = u32((0 if key else self.value) + r.varint())
+        elif self.type == GAUGE:
+            self.value = u32((0 if key else self.value) + r.zigzag())
+        else:
+            mask = r.varint()
+            for b in range(len(self.buckets)):
+                n = r.varint() if mask & (1 << b) else 0
+                self.buckets[b] = u32((0 if key else self.buckets[b]) + n)
+            self.sum = u32((0 if key else self.sum) + r.zigzag())
+
+    def raw(self):
+        """check_prog16_telemetryの--expectと同じ書式"""
+        if self.type == COUNTER:
+            return "%s=%d" % (self.name, self.value)
+        if self.type == GAUGE:
+            return "%s=%d" % (self.name, i32(self.value))
+        return "%s=%s,sum=%d" % (self.name, ",".join(str(b) for b in self.buckets), i32(self.sum))
+
+    def display(self):
+        if self.type == COUNTER:
+            return str(self.value)
+        if self.type == GAUGE:
+            return "%g" % (i32(self.value) * 10.0 ** self.exp)
+        count = sum(self.buckets)
+        mean = i32(self.sum) * 10.0 ** self.exp / count if count else 0.0
+        labels = ["<=%g" % (b * 10.0 ** self.exp) for b in self.bounds] + [">"]
+        dist = " ".join("%s:%d" % (l, n) for l, n in zip(labels, self.buckets) if n)
+        return "count=%d mean=%.3g %s" % (count, mean, dist)
+
+
+class Collector:
+    def __init__(self):
+        self.metrics = {}
+        self.num = None
+        self.synced = False
+        self.expect_seq = None
+        self.frames = 0
+        self.bytes = 0
+        self.records = 0
+        self.lost = 0
+        self.skipped = 0
+        self.errors = 0
+        self.time_ms = 0
+
+    def described(self):
+        return self.num is not None and len(self.metrics) >= self.num
+
+    def feed(self, data):
+        self.frames += 1
+        self.bytes += len(data)
+        try:
+            self._decode(data)
+        except (ValueError, KeyError) as e:
+            self.errors += 1
+            self.synced = False
+            print("bad frame: %s" % e, file=sys.stderr)
+
+    def _decode(self, data):
+        if data[:2] != MAGIC or len(data) < 5:
+            raise ValueError("not a telemetry frame")
+        vt = data[2]
+        if vt >> 4 != VERSION:
+            raise ValueError("unknown version %d" % (vt >> 4))
+        ftype = vt & 0x0F
+        seq = struct.unpack_from("<H", data, 3)[0]
+        r = Reader(data)
+        r.pos = 5
+        self.time_ms = r.varint()
+
+        if ftype == FRAME_DESC:
+            num = r.varint()
+            if num != self.num:
+                self.metrics = {}
+                self.num = num
+                self.synced = False
+            while r.more():
+                mid = r.varint()
+                mtype = r.u8()
+                exp = r.i8()
+                name = bytes(r.u8() for _ in range(r.u8())).decode()
+                bounds = []
+                if mtype == HISTOGRAM:
+                    bounds = [r.zigzag() for _ in range(r.u8())]
+                old = self.metrics.get(mid)
+                if old is None or (old.type, old.name, old.bounds) != (mtype, name, bounds):
+                    self.metrics[mid] = Metric(mid, mtype, exp, name, bounds)
+            return
+        if ftype not in (FRAME_DATA, FRAME_KEY, FRAME_KEY_PART):
+            raise ValueError("unknown frame type %d" % ftype)
+
+        if self.synced and seq != self.expect_seq:
+            self.lost += (seq - self.expect_seq) & 0xFFFF
+            self.synced = False
+        self.expect_seq = (seq + 1) & 0xFFFF
+        key = ftype in (FRAME_KEY, FRAME_KEY_PART)
+        # 名前が分かって、今の値を受け取るまでは差分を適用できない
+        # FRAME_KEY_PARTは書ききれなかったメトリクスがあるので、同期していなければ使わない
+        if not self.described() or (not self.synced and ftype != FRAME_KEY):
+            self.skipped += 1
+            return
+        self.synced = True
+        while r.more():
+            self.metrics[r.varint()].apply(r, key)
+            self.records += 1
+
+    def lines(self):
+        return [self.metrics[i].raw() for i in sorted(self.metrics)]
+
+    def print_table(self, elapsed=None):
+        print("--- t=%.1fs frames=%d bytes=%d records=%d lost=%d skipped=%d errors=%d" % (
+            self.time_ms / 1000.0, self.frames, self.bytes, self.records, self.lost, self.skipped, self.errors))
+        if elapsed:
+            print("    %.1f frames/s, %.1f bytes/s" % (self.frames / elapsed, self.bytes / elapsed))
+        for i in sorted(self.metrics):
+            m = self.metrics[i]
+            print("  %-20s %-9s %s" % (m.name, TYPE_NAMES.get(m.type, "?"), m.display()))
+
+
+def listen(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    sock.settimeout(1.0)
+    print("listening on %s:%d" % (args.bind, args.port))
+    c = Collector()
+    start = time.monotonic()
+    last = start
+    while True:
+        try:
+            data, _ = sock.recvfrom(2048)
+            c.feed(data)
+        except socket.timeout:
+            pass
+        now = time.monotonic()
+        if now - last >= args.interval:
+            c.print_table(now - start)
+            last = now
+
+
+def read_frames(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    pos = 0
+    while pos + 2 <= len(data):
+        n = struct.unpack_from("<H", data, pos)[0]
+        yield data[pos + 2:pos + 2 + n]
+        pos += 2 + n
+
+
+def replay(args):
+    c = Collector()
+    for frame in read_frames(args.frames):
+        c.feed(frame)
+    c.print_table()
+    if args.expect is None:
+        return 0
+    with open(args.expect) as f:
+        expect = [line.strip() for line in f if line.strip()]
+    got = c.lines()
+    if got != expect or c.errors:
+        print("MISMATCH", file=sys.stderr)
+        for e, g in zip(expect, got):
+            if e != g:
+                print("  expect %s\n  got    %s" % (e, g), file=sys.stderr)
+        if len(expect) != len(got):
+            print("  expect %d metrics, got %d" % (len(expect), len(got)), file=sys.stderr)
+        return 1
+    print("OK: %d metrics match" % len(got))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("listen")
+    p.add_argument("--bind", default="0.0.0.0")
+    p.add_argument("--port", type=int, default=9000)
+    p.add_argument("--interval", type=float, default=5.0, help="seconds between tables")
+    p.set_defaults(func=listen)
+    p = sub.add_parser("replay")
+    p.add_argument("frames")
+    p.add_argument("--expect")
+    p.set_defaults(func=replay)
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "config_store.h"
+
+static uint32_t float_bits(float f){
+  union { float f; uint32_t u; } v = {.f = f};
+  return v.u;
+}
+
+static float bits_float(uint32_t u){
+  union { uint32_t u; float f; } v = {.u = u};
+  return v.f;
+}
+
+cfg_status_t cfg_check_value(const cfg_def_t *def, double value, uint32_t *bits){
+  if (isnan(value) || value < def->min || value > def->max) {
+    return CFG_ERR_RANGE;
+  }
+  switch (def->type) {
+  case CFG_INT:
+    if (value != floor(value)) {
+      return CFG_ERR_TYPE;
+    }
+    *bits = (uint32_t)(int32_t)value;
+    break;
+  case CFG_FLOAT:
+    *bits = float_bits((float)value);
+    break;
+  default:
+    *bits = value != 0;
+    break;
+  }
+  return CFG_OK;
+}
+
+int cfg_init(cfg_store_t *s, const cfg_def_t *defs, int num){
+  memset(s, 0, sizeof(*s));
+  if (num < 0 || num > CFG_MAX_ENTRIES) {
+    return -1;
+  }
+  s->defs = defs;
+  s->num = num;
+  for (int i = 0; i < num; i++) {
+    if (strlen(defs[i].key) > CFG_KEY_MAX || cfg_check_value(&defs[i], defs[i].def, &s->values[i]) != CFG_OK) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int cfg_find(const cfg_store_t *s, const char *key){
+  for (int i = 0; i < s->num; i++) {
+    if (strcmp(s->defs[i].key, key) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// seqlock: 書いている途中(奇数)か、読んでいる間にseqが変わったら読み直す
+uint32_t cfg_read(const cfg_store_t *s, uint32_t *values){
+  uint32_t before, after;
+  do {
+    before = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < s->num; i++) {
+      values[i] = __atomic_load_n(&s->values[i], __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+  } while ((before & 1) || before != after);
+  return before / 2;
+}
+
+cfg_status_t cfg_parse_value(const cfg_def_t *def, const char *text, uint32_t *bits){
+  if (def->type == CFG_BOOL) {
+    static const char *on[] = {"1", "true", "on"};
+    static const char *off[] = {"0", "false", "off"};
+    for (int i = 0; i < 3; i++) {
+      if (strcmp(text, on[i]) == 0) {
+        return cfg_check_value(def, 1, bits);
+      }
+      if (strcmp(text, off[i]) == 0) {
+        return cfg_check_value(def, 0, bits);
+      }
+    }
+    return CFG_ERR_TYPE;
+  }
+  char *end;
+  double value = strtod(text, &end);
+  if (end == text || *end != '\0') {
+    return CFG_ERR_TYPE;
+  }
+  return cfg_check_value(def, value, bits);
+}
+
+// 前後の空白を除いてdstに写す
+static void trim_copy(char *dst, size_t size, const char *begin, const char *end){
+  while (begin < end && isspace((unsigned char)*begin)) {
+    begin++;
+  }
+  while (end > begin && isspace((unsigned char)end[-1])) {
+    end--;
+  }
+  size_t len = (size_t)(end - begin);
+  if (len >= size) {
+    len = size - 1;
+  }
+  memcpy(dst, begin, len);
+  dst[len] = '\0';
+}
+
+int cfg_parse_text(const cfg_store_t *s, const char *text, cfg_change_t *changes, int max_changes,
+  cfg_status_t *status, int *error_line){
+  int num = 0;
+  int line_no = 0;
+  const char *line = text;
+  while (*line != '\0') {
+    const char *eol = strchr(line, '\n');
+    if (eol == NULL) {
+      eol = line + strlen(line);
+    }
+    line_no++;
+    char key[32], value[32];
+    const char *eq = memchr(line, '=', (size_t)(eol - line));
+    trim_copy(key, sizeof(key), line, eq ? eq : eol);
+    if (key[0] != '\0' && key[0] != '#') {
+      cfg_status_t st = CFG_OK;
+      int id = eq ? cfg_find(s, key) : -1;
+      if (id < 0) {
+        st = CFG_ERR_KEY;
+      } else if (num >= max_changes) {
+        st = CFG_ERR_FULL;
+      } else {
+        trim_copy(value, sizeof(value), eq + 1, eol);
+        st = cfg_parse_value(&s->defs[id], value, &changes[num].bits);
+        changes[num].id = id;
+      }
+      if (st != CFG_OK) {
+        *status = st;
+        *error_line = line_no;
+        return -1;
+      }
+      num++;
+    }
+    line = *eol ? eol + 1 : eol;
+  }
+  *status = CFG_OK;
+  *error_line = 0;
+  return num;
+}
+
+uint32_t cfg_apply(cfg_store_t *s, const cfg_change_t *changes, int num){
+  uint32_t changed = 0;
+  for (int i = 0; i < num; i++) {
+    if (s->values[changes[i].id] != changes[i].bits) {
+      changed |= 1u << changes[i].id;
+    }
+  }
+  if (changed == 0) {
+    return 0;
+  }
+  uint32_t seq = s->seq;
+  __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  for (int i = 0; i < num; i++) {
+    __atomic_store_n(&s->values[changes[i].id], changes[i].bits, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+  return changed;
+}
+
+int cfg_subscribe(cfg_store_t *s, uint32_t mask, cfg_notify_cb_t cb, void *arg){
+  if (s->num_subs >= CFG_MAX_SUBSCRIBERS) {
+    return -1;
+  }
+  int id = s->num_subs++;
+  s->subs[id].mask = mask;
+  s->subs[id].cb = cb;
+  s->subs[id].arg = arg;
+  return id;
+}
+
+void cfg_notify(const cfg_store_t *s, uint32_t changed){
+  for (int i = 0; i < s->num_subs; i++) {
+    if (s->subs[i].mask & changed) {
+      s->subs[i].cb(s, s->subs[i].mask & changed, s->subs[i].arg);
+    }
+  }
+}
+
+size_t cfg_format(const cfg_store_t *s, char *buf, size_t size){
+  uint32_t values[CFG_MAX_ENTRIES];
+  cfg_read(s, values);
+  size_t len = 0;
+  if (size > 0) {
+    buf[0] = '\0';
+  }
+  for (int i = 0; i < s->num && len + 1 < size; i++) {
+    const cfg_def_t *d = &s->defs[i];
+    int n;
+    if (d->type == CFG_FLOAT) {
+      n = snprintf(buf + len, size - len, "%s=%g\n", d->key, (double)bits_float(values[i]));
+    } else if (d->type == CFG_BOOL) {
+      n = snprintf(buf + len, size - len, "%s=%s\n", d->key, values[i] ? "true" : "false");
+    } else {
+      n = snprintf(buf + len, size - len, "%s=%ld\n", d->key, (long)(int32_t)values[i]);
+    }
+    if (n < 0) {
+      break;
+    }
+    len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+  }
+  return len;
+}
+
+const char *cfg_status_name(cfg_status_t status){
+  static const char *names[] = {"ok", "unknown key", "bad value", "out of range", "too many changes"};
+  return status <= CFG_ERR_FULL ? names[status] : "?";
+}
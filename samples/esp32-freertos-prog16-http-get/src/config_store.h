@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 実行中に変えられる設定（ロジック部分）
+// 設定は型(整数、小数、真偽)、既定値、範囲を決めた表で登録し、idで読む
+//
+// 読む側はロックを使わない
+//   1つだけ読む: cfg_get_int/cfg_get_float/cfg_get_bool(32bitの値を1回読むだけ)
+//   まとめて読む: cfg_read()で全部をコピーする(書いている途中なら読み直すので、組み合わせが揃う)
+//   変わったか:   cfg_version()を覚えておき、変わったときだけ読み直す
+// 書く側は1つずつ(cfg_apply、排他はport側)。書いている間はseqが奇数になる
+//
+// 変更はテキスト "key=value" の行で受け取る(HTTP、シリアルなど経路によらない)
+// 1行でも誤り(知らないキー、型、範囲外)があれば、まとめて適用しない。値が同じならバージョンは変わらない
+// 変わった設定のビット(1 << id)を、購読しているコールバックに知らせる
+// ESP-IDFに依存しないので、ホストでも確認できる(NVSへの保存はconfig_store_port.h)
+
+#define CFG_MAX_ENTRIES     32
+#define CFG_MAX_SUBSCRIBERS 8
+#define CFG_KEY_MAX         15      // NVSのキーの長さ
+
+typedef enum {
+  CFG_INT,
+  CFG_FLOAT,
+  CFG_BOOL,
+} cfg_type_t;
+
+typedef struct {
+  const char *key;
+  cfg_type_t type;
+  double def;
+  double min;
+  double max;
+} cfg_def_t;
+
+typedef struct {
+  int id;
+  uint32_t bits;             // 整数と真偽はint32_t、小数はfloatのビット
+} cfg_change_t;
+
+typedef struct cfg_store cfg_store_t;
+typedef void (*cfg_notify_cb_t)(const cfg_store_t *store, uint32_t changed, void *arg);
+
+struct cfg_store {
+  const cfg_def_t *defs;
+  int num;
+  uint32_t values[CFG_MAX_ENTRIES];
+  uint32_t seq;              // 偶数なら安定、バージョンはseq/2
+  struct {
+    uint32_t mask;
+    cfg_notify_cb_t cb;
+    void *arg;
+  } subs[CFG_MAX_SUBSCRIBERS];
+  int num_subs;
+};
+
+typedef enum {
+  CFG_OK,
+  CFG_ERR_KEY,               // 知らないキー
+  CFG_ERR_TYPE,              // 数値、真偽として読めない
+  CFG_ERR_RANGE,
+  CFG_ERR_FULL,              // 1回に変えられる数を超えた
+} cfg_status_t;
+
+// 既定値で初期化する。表が多すぎる、キーが長すぎる、既定値が範囲外なら-1
+int cfg_init(cfg_store_t *s, const cfg_def_t *defs, int num);
+int cfg_find(const cfg_store_t *s, const char *key);
+
+static inline uint32_t cfg_version(const cfg_store_t *s){
+  return __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) / 2;
+}
+static inline int32_t cfg_get_int(const cfg_store_t *s, int id){
+  return (int32_t)__atomic_load_n(&s->values[id], __ATOMIC_RELAXED);
+}
+static inline float cfg_get_float(const cfg_store_t *s, int id){
+  union { uint32_t u; float f; } v = {.u = __atomic_load_n(&s->values[id], __ATOMIC_RELAXED)};
+  return v.f;
+}
+static inline bool cfg_get_bool(const cfg_store_t *s, int id){
+  return __atomic_load_n(&s->values[id], __ATOMIC_RELAXED) != 0;
+}
+
+// 全部の値をvalues[s->num]にコピーして、そのバージョンを返す
+uint32_t cfg_read(const cfg_store_t *s, uint32_t *values);
+
+// 値を確かめてビットにする
+cfg_status_t cfg_parse_value(const cfg_def_t *def, const char *text, uint32_t *bits);
+cfg_status_t cfg_check_value(const cfg_def_t *def, double value, uint32_t *bits);
+// "key=value"の行(空行と#の行は飛ばす)をchangesにする。変更の数を返す
+// 誤りがあれば-1で、*statusと*error_line(1から)に入れる
+int cfg_parse_text(const cfg_store_t *s, const char *text, cfg_change_t *changes, int max_changes,
+  cfg_status_t *status, int *error_line);
+
+// 書く(1つずつ呼ぶこと)。実際に変わった設定のビットを返す。0でなければバージョンが1つ進む
+uint32_t cfg_apply(cfg_store_t *s, const cfg_change_t *changes, int num);
+
+// 購読(変わった設定のビットとmaskが重なったら呼ぶ)。いっぱいなら-1
+int cfg_subscribe(cfg_store_t *s, uint32_t mask, cfg_notify_cb_t cb, void *arg);
+void cfg_notify(const cfg_store_t *s, uint32_t changed);
+
+// 今の値を "key=value\n" の行で書く。書いた長さを返す(足りなければ途中まで)
+size_t cfg_format(const cfg_store_t *s, char *buf, size_t size);
+const char *cfg_status_name(cfg_status_t status);
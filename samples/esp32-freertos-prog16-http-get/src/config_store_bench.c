@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include "config_store.h"
+#include "config_store_bench.h"
+
+#define BENCH_ENTRIES 16
+
+// ストアが毎回変わったかもしれないとコンパイラに思わせる(読み出しをループの外に出したり、まとめたりさせない)
+#define BENCH_BARRIER(p) __asm__ __volatile__("" : : "r"(p) : "memory")
+
+static uint32_t per_iteration_x100(uint32_t total, uint32_t iterations){
+  return (uint32_t)((uint64_t)total * 100 / iterations);
+}
+
+void cfg_bench_reads(uint32_t iterations, uint32_t (*clock)(void), cfg_bench_result_t *result){
+  static cfg_def_t defs[BENCH_ENTRIES];
+  static char keys[BENCH_ENTRIES][8];
+  static cfg_store_t s;
+  uint32_t values[BENCH_ENTRIES];
+  for (int i = 0; i < BENCH_ENTRIES; i++) {
+    snprintf(keys[i], sizeof(keys[i]), "k%d", i);
+    defs[i] = (cfg_def_t){keys[i], CFG_INT, i, 0, 1000};
+  }
+  cfg_init(&s, defs, BENCH_ENTRIES);
+  if (iterations == 0) {
+    iterations = 1;
+  }
+
+  result->iterations = iterations;
+
+  // 結果を使わないと消されるので足しておく
+  volatile int32_t sink = 0;
+  uint32_t start = clock();
+  for (uint32_t i = 0; i < iterations; i++) {
+    BENCH_BARRIER(&s);
+    sink += cfg_get_int(&s, (int)(i % BENCH_ENTRIES));
+  }
+  result->get_int_total = clock() - start;
+
+  start = clock();
+  for (uint32_t i = 0; i < iterations; i++) {
+    BENCH_BARRIER(&s);
+    sink += (int32_t)cfg_version(&s);
+  }
+  result->version_total = clock() - start;
+
+  start = clock();
+  for (uint32_t i = 0; i < iterations; i++) {
+    BENCH_BARRIER(&s);
+    sink += (int32_t)cfg_read(&s, values) + (int32_t)values[i % BENCH_ENTRIES];
+  }
+  result->read_all_total = clock() - start;
+  (void)sink;
+
+  result->get_int_x100 = per_iteration_x100(result->get_int_total, iterations);
+  result->version_x100 = per_iteration_x100(result->version_total, iterations);
+  result->read_all_x100 = per_iteration_x100(result->read_all_total, iterations);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+
+// 読む側の速さ。clockは増えていく時計(実機はCPUサイクル、ホストはns)
+// 1回は数サイクル(ホストでは1ns前後)なので、整数の平均では0か1になる。ループ全体の時間と、1回あたりの100倍を返す
+typedef struct {
+  uint32_t iterations;
+  uint32_t get_int_total;    // cfg_get_int
+  uint32_t version_total;    // cfg_version(変わったかを見るだけ)
+  uint32_t read_all_total;   // cfg_read(設定16個を全部コピー)
+  uint32_t get_int_x100;     // 1回あたり×100
+  uint32_t version_x100;
+  uint32_t read_all_x100;
+} cfg_bench_result_t;
+
+void cfg_bench_reads(uint32_t iterations, uint32_t (*clock)(void), cfg_bench_result_t *result);
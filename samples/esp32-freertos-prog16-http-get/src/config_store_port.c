@@ -0,0 +1,138 @@
+#include <string.h>
+#include "esp_log.h"
+#include "config_store_port.h"
+
+#define TAG "config"
+
+// 読み込み、適用の1回で変えられる数
+#define CFG_PORT_MAX_CHANGES CFG_MAX_ENTRIES
+
+// NVSの値をビットにする。値がない、範囲外ならfalse
+static bool load_value(cfg_port_t *p, const cfg_def_t *def, uint32_t *bits){
+  esp_err_t ret;
+  double value;
+  if (def->type == CFG_FLOAT) {
+    uint32_t u;
+    ret = nvs_get_u32(p->nvs, def->key, &u);
+    union { uint32_t u; float f; } v = {.u = u};
+    value = v.f;
+  } else {
+    int32_t i;
+    ret = nvs_get_i32(p->nvs, def->key, &i);
+    value = i;
+  }
+  if (ret == ESP_ERR_NVS_NOT_FOUND) {
+    return false;
+  }
+  if (ret != ESP_OK) {
+    ESP_LOGW(TAG, "%s: nvs_get failed: %s", def->key, esp_err_to_name(ret));
+    return false;
+  }
+  if (cfg_check_value(def, value, bits) != CFG_OK) {
+    ESP_LOGW(TAG, "%s: stored value %g is out of range, use default", def->key, value);
+    return false;
+  }
+  return true;
+}
+
+static esp_err_t save_changed(cfg_port_t *p, uint32_t changed){
+  const cfg_store_t *s = &p->store;
+  for (int i = 0; i < s->num; i++) {
+    if (!(changed & (1u << i))) {
+      continue;
+    }
+    uint32_t bits = __atomic_load_n(&s->values[i], __ATOMIC_RELAXED);
+    esp_err_t ret = s->defs[i].type == CFG_FLOAT
+      ? nvs_set_u32(p->nvs, s->defs[i].key, bits)
+      : nvs_set_i32(p->nvs, s->defs[i].key, (int32_t)bits);
+    if (ret != ESP_OK) {
+      ESP_LOGE(TAG, "%s: nvs_set failed: %s", s->defs[i].key, esp_err_to_name(ret));
+      return ret;
+    }
+  }
+  return nvs_commit(p->nvs);
+}
+
+esp_err_t cfg_port_init(cfg_port_t *p, const char *ns, const cfg_def_t *defs, int num){
+  memset(p, 0, sizeof(*p));
+  if (cfg_init(&p->store, defs, num) != 0) {
+    ESP_LOGE(TAG, "invalid config table");
+    return ESP_ERR_INVALID_ARG;
+  }
+  p->ns = ns;
+  p->lock = xSemaphoreCreateMutex();
+  if (p->lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  esp_err_t ret = nvs_open(ns, NVS_READWRITE, &p->nvs);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "nvs_open(%s) failed: %s", ns, esp_err_to_name(ret));
+    return ret;
+  }
+
+  cfg_change_t changes[CFG_PORT_MAX_CHANGES];
+  int n = 0;
+  for (int i = 0; i < num; i++) {
+    if (load_value(p, &defs[i], &changes[n].bits)) {
+      changes[n++].id = i;
+    }
+  }
+  uint32_t changed = cfg_apply(&p->store, changes, n);
+  ESP_LOGI(TAG, "%s: %d stored, %d differ from default", ns, n, __builtin_popcount(changed));
+  return ESP_OK;
+}
+
+esp_err_t cfg_port_apply_text(cfg_port_t *p, const char *text, const char *source, uint32_t *changed){
+  cfg_change_t changes[CFG_PORT_MAX_CHANGES];
+  cfg_status_t status;
+  int line;
+  if (changed != NULL) {
+    *changed = 0;
+  }
+
+  xSemaphoreTake(p->lock, portMAX_DELAY);
+  int n = cfg_parse_text(&p->store, text, changes, CFG_PORT_MAX_CHANGES, &status, &line);
+  if (n < 0) {
+    xSemaphoreGive(p->lock);
+    ESP_LOGW(TAG, "%s: rejected at line %d: %s", source, line, cfg_status_name(status));
+    return ESP_ERR_INVALID_ARG;
+  }
+  uint32_t bits = cfg_apply(&p->store, changes, n);
+  esp_err_t ret = ESP_OK;
+  if (bits != 0) {
+    ret = save_changed(p, bits);
+    ESP_LOGI(TAG, "%s: version %lu, changed 0x%08lx", source,
+      (unsigned long)cfg_version(&p->store), (unsigned long)bits);
+    cfg_notify(&p->store, bits);
+  }
+  xSemaphoreGive(p->lock);
+
+  if (changed != NULL) {
+    *changed = bits;
+  }
+  return ret;
+}
+
+esp_err_t cfg_port_reset(cfg_port_t *p){
+  cfg_change_t changes[CFG_PORT_MAX_CHANGES];
+  const cfg_store_t *s = &p->store;
+  xSemaphoreTake(p->lock, portMAX_DELAY);
+  esp_err_t ret = nvs_erase_all(p->nvs);
+  if (ret == ESP_OK) {
+    ret = nvs_commit(p->nvs);
+  }
+  for (int i = 0; i < s->num; i++) {
+    changes[i].id = i;
+    cfg_check_value(&s->defs[i], s->defs[i].def, &changes[i].bits);
+  }
+  uint32_t bits = cfg_apply(&p->store, changes, s->num);
+  cfg_notify(&p->store, bits);
+  xSemaphoreGive(p->lock);
+  return ret;
+}
+
+void cfg_port_log(const cfg_port_t *p){
+  char text[512];
+  cfg_format(&p->store, text, sizeof(text));
+  ESP_LOGI(TAG, "%s version %lu\n%s", p->ns, (unsigned long)cfg_version(&p->store), text);
+}
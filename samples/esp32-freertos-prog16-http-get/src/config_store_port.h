@@ -0,0 +1,34 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "nvs.h"
+#include "config_store.h"
+
+// 実行中に変えられる設定(ESP-IDF部分)
+// 起動時にNVSの名前空間から値を読み、変更はNVSに書いてから購読者に知らせる(再起動しても残る)
+// NVSには整数と真偽をi32、小数をu32(floatのビット)で、設定のキーのまま書く
+// NVSの値が範囲外(表の範囲を狭めた後など)なら既定値を使う
+//
+// 読む側はcfg_get_int(&port.store, id)などを直接使う(ロックなし)
+// 変更はcfg_port_apply_text()だけが書き、ミューテックスで1つずつにする
+// 購読者のコールバックは変更したタスクで呼ぶ。コールバックの中から変更しないこと
+// nvs_flash_init()の後で呼ぶ
+
+typedef struct {
+  cfg_store_t store;
+  const char *ns;
+  nvs_handle_t nvs;
+  SemaphoreHandle_t lock;
+} cfg_port_t;
+
+esp_err_t cfg_port_init(cfg_port_t *p, const char *ns, const cfg_def_t *defs, int num);
+
+// "key=value"の行を適用する(HTTP、シリアルなど、どこから来たかはsourceでログに出す)
+// 1行でも誤りがあれば何も変えずにESP_ERR_INVALID_ARG。*changedに変わった設定のビットを入れる(NULL可)
+esp_err_t cfg_port_apply_text(cfg_port_t *p, const char *text, const char *source, uint32_t *changed);
+
+// NVSの値を消して既定値に戻す
+esp_err_t cfg_port_reset(cfg_port_t *p);
+
+void cfg_port_log(const cfg_port_t *p);
@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heap_prof.h"
+
+static const char *const region_names[HP_REGION_NUM] = {"internal", "psram"};
+
+void hp_init(hp_t *hp){
+  memset(hp, 0, sizeof(*hp));
+}
+
+// 呼び出し元を探す。なければ作る。いっぱいなら最後の1つ(PCが全部0)にまとめる
+static int find_site(hp_t *hp, const uint32_t *pc){
+  for (int i = 0; i < hp->num_sites; i++) {
+    if (memcmp(hp->sites[i].pc, pc, sizeof(hp->sites[i].pc)) == 0) {
+      return i;
+    }
+  }
+  int i = hp->num_sites;
+  if (i >= HP_MAX_SITES - 1) {
+    hp->site_overflow++;
+    i = HP_MAX_SITES - 1;
+    if (hp->num_sites < HP_MAX_SITES) {
+      hp->num_sites = HP_MAX_SITES;
+      memset(&hp->sites[i], 0, sizeof(hp->sites[i]));
+    }
+    return i;
+  }
+  memset(&hp->sites[i], 0, sizeof(hp->sites[i]));
+  memcpy(hp->sites[i].pc, pc, sizeof(hp->sites[i].pc));
+  hp->num_sites++;
+  return i;
+}
+
+// 追いかけている割り当ての表(開番地法、削除は後ろを詰める)
+static int live_home(uint32_t ptr){
+  return (int)(((ptr >> 2) * 2654435761u) >> 7) & (HP_MAX_LIVE - 1);
+}
+
+static int live_find(const hp_t *hp, uint32_t ptr){
+  for (int i = live_home(ptr), n = 0; n < HP_MAX_LIVE; i = (i + 1) & (HP_MAX_LIVE - 1), n++) {
+    if (!hp->live[i].used) {
+      return -1;
+    }
+    if (hp->live[i].ptr == ptr) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void live_remove(hp_t *hp, int i){
+  hp->live[i].used = false;
+  hp->num_live--;
+  for (int j = (i + 1) & (HP_MAX_LIVE - 1); hp->live[j].used; j = (j + 1) & (HP_MAX_LIVE - 1)) {
+    // jが本来の位置からiを越えずに来られるならiに詰める
+    int home = live_home(hp->live[j].ptr);
+    bool between = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+    if (!between) {
+      hp->live[i] = hp->live[j];
+      hp->live[j].used = false;
+      i = j;
+    }
+  }
+}
+
+// 割り当てを表から外して、呼び出し元と領域の値を戻す
+static void release(hp_t *hp, int i){
+  hp_live_t *l = &hp->live[i];
+  hp_site_t *site = &hp->sites[l->site];
+  site->frees++;
+  site->live_count--;
+  site->live_bytes -= l->size;
+  hp->live_bytes[l->region] -= l->size;
+  hp->frees++;
+  live_remove(hp, i);
+}
+
+void hp_alloc(hp_t *hp, const hp_event_t *e){
+  int region = (e->flags & HP_FLAG_PSRAM) ? HP_REGION_PSRAM : HP_REGION_INTERNAL;
+  // 同じポインタが残っていたら、解放のイベントを取りこぼしている
+  int old = live_find(hp, e->ptr);
+  if (old >= 0) {
+    hp->unknown_frees++;
+    release(hp, old);
+  }
+
+  int s = find_site(hp, e->pc);
+  hp_site_t *site = &hp->sites[s];
+  if (site->allocs == 0 || e->size < site->min_size) {
+    site->min_size = e->size;
+  }
+  if (e->size > site->max_size) {
+    site->max_size = e->size;
+  }
+  site->allocs++;
+  site->total_bytes += e->size;
+  site->region_allocs[region]++;
+  site->caps |= e->caps;
+  hp->allocs++;
+  if (e->flags & (HP_FLAG_HOT | HP_FLAG_ISR)) {
+    site->hot_allocs++;
+    hp->hot_allocs++;
+    if (region == HP_REGION_PSRAM) {
+      hp->hot_psram_allocs++;
+    }
+  }
+
+  // 表は3/4まで使う(それ以上は探すのが遅くなる)
+  if (hp->num_live >= HP_MAX_LIVE * 3 / 4) {
+    hp->live_overflow++;
+    return;
+  }
+  int i = live_home(e->ptr);
+  while (hp->live[i].used) {
+    i = (i + 1) & (HP_MAX_LIVE - 1);
+  }
+  hp->live[i] = (hp_live_t){.ptr = e->ptr, .size = e->size, .site = (uint8_t)s, .region = (uint8_t)region,
+    .used = true};
+  hp->num_live++;
+  site->live_count++;
+  site->live_bytes += e->size;
+  if (site->live_bytes > site->peak_bytes) {
+    site->peak_bytes = site->live_bytes;
+  }
+  hp->live_bytes[region] += e->size;
+  if (hp->live_bytes[region] > hp->peak_live_bytes[region]) {
+    hp->peak_live_bytes[region] = hp->live_bytes[region];
+  }
+}
+
+void hp_free(hp_t *hp, uint32_t ptr){
+  if (ptr == 0) {
+    return;
+  }
+  int i = live_find(hp, ptr);
+  if (i < 0) {
+    hp->unknown_frees++;
+    return;
+  }
+  release(hp, i);
+}
+
+void hp_sample(hp_t *hp, hp_region_t region, const hp_sample_t *s){
+  hp_sample_t *d = &hp->series[region][hp->num_samples[region] % HP_SERIES];
+  *d = *s;
+  if (d->largest_sum == 0) {
+    d->largest_sum = d->largest;
+  }
+  d->frag_pm = s->free > 0 && d->largest_sum <= s->free ? (uint16_t)(1000 - (uint64_t)d->largest_sum * 1000 / s->free) : 0;
+  hp->num_samples[region]++;
+}
+
+int hp_series_len(const hp_t *hp, hp_region_t region){
+  return hp->num_samples[region] < HP_SERIES ? (int)hp->num_samples[region] : HP_SERIES;
+}
+
+const hp_sample_t *hp_series_at(const hp_t *hp, hp_region_t region, int i){
+  uint32_t first = hp->num_samples[region] - (uint32_t)hp_series_len(hp, region);
+  return &hp->series[region][(first + (uint32_t)i) % HP_SERIES];
+}
+
+uint16_t hp_frag_max(const hp_t *hp, hp_region_t region){
+  uint16_t max = 0;
+  for (int i = 0; i < hp_series_len(hp, region); i++) {
+    uint16_t v = hp_series_at(hp, region, i)->frag_pm;
+    max = v > max ? v : max;
+  }
+  return max;
+}
+
+uint32_t hp_largest_min(const hp_t *hp, hp_region_t region){
+  uint32_t min = 0;
+  for (int i = 0; i < hp_series_len(hp, region); i++) {
+    uint32_t v = hp_series_at(hp, region, i)->largest;
+    min = i == 0 || v < min ? v : min;
+  }
+  return min;
+}
+
+bool hp_is_leak_suspect(const hp_site_t *site){
+  return site->live_count >= HP_LEAK_MIN_LIVE && site->live_count * 2 > site->allocs;
+}
+
+int hp_top_sites(const hp_t *hp, int *order, int max){
+  int n = 0;
+  for (int i = 0; i < hp->num_sites; i++) {
+    if (hp->sites[i].allocs == 0) {
+      continue;
+    }
+    // 挿入ソート(呼び出し元は多くないので)
+    int j = n < max ? n++ : max;
+    while (j > 0 && hp->sites[order[j - 1]].live_bytes < hp->sites[i].live_bytes) {
+      if (j < max) {
+        order[j] = order[j - 1];
+      }
+      j--;
+    }
+    if (j < max) {
+      order[j] = i;
+    }
+  }
+  return n;
+}
+
+// 数値を読んで、後ろの空白を飛ばす。読めなければfalse
+static bool read_num(const char **p, int base, uint32_t *v){
+  char *end;
+  unsigned long n = strtoul(*p, &end, base);
+  if (end == *p) {
+    return false;
+  }
+  *v = (uint32_t)n;
+  *p = end;
+  while (**p == ' ') {
+    (*p)++;
+  }
+  return true;
+}
+
+int hp_parse_line(hp_t *hp, const char *line){
+  if (strncmp(line, "HP ", 3) != 0) {
+    return 0;
+  }
+  char type = line[3];
+  const char *p = line + 4;
+  if (line[3] == '\0' || *p != ' ') {
+    return -1;
+  }
+  p++;
+  uint32_t time_ms, ptr;
+  if (!read_num(&p, 10, &time_ms)) {
+    return -1;
+  }
+  switch (type) {
+  case 'a': {
+    hp_event_t e = {.type = 'a', .time_ms = time_ms};
+    uint32_t flags;
+    if (!read_num(&p, 16, &e.ptr) || !read_num(&p, 10, &e.size) || !read_num(&p, 16, &e.caps)
+      || !read_num(&p, 16, &flags)) {
+      return -1;
+    }
+    e.flags = (uint8_t)flags;
+    for (int i = 0; i < HP_DEPTH; i++) {
+      if (!read_num(&p, 16, &e.pc[i])) {
+        return -1;
+      }
+      if (*p != ',') {
+        break;
+      }
+      p++;
+    }
+    hp_alloc(hp, &e);
+    return 1;
+  }
+  case 'f':
+    if (!read_num(&p, 16, &ptr)) {
+      return -1;
+    }
+    hp_free(hp, ptr);
+    return 1;
+  case 's': {
+    hp_sample_t s = {.time_ms = time_ms};
+    uint32_t region;
+    if (!read_num(&p, 10, &region) || region >= HP_REGION_NUM || !read_num(&p, 10, &s.total)
+      || !read_num(&p, 10, &s.free) || !read_num(&p, 10, &s.largest) || !read_num(&p, 10, &s.min_free)) {
+      return -1;
+    }
+    // largest_sumのない古いトレースはヒープ1つとして読む
+    read_num(&p, 10, &s.largest_sum);
+    hp_sample(hp, (hp_region_t)region, &s);
+    return 1;
+  }
+  default:
+    return -1;
+  }
+}
+
+size_t hp_format_event(const hp_event_t *e, char *buf, size_t size){
+  int n;
+  if (e->type == 'f') {
+    n = snprintf(buf, size, "HP f %lu %lx", (unsigned long)e->time_ms, (unsigned long)e->ptr);
+  } else {
+    n = snprintf(buf, size, "HP a %lu %lx %lu %lx %x %lx,%lx,%lx,%lx", (unsigned long)e->time_ms,
+      (unsigned long)e->ptr, (unsigned long)e->size, (unsigned long)e->caps, e->flags,
+      (unsigned long)e->pc[0], (unsigned long)e->pc[1], (unsigned long)e->pc[2], (unsigned long)e->pc[3]);
+  }
+  return n > 0 && (size_t)n < size ? (size_t)n : 0;
+}
+
+size_t hp_format_sample(hp_region_t region, const hp_sample_t *s, char *buf, size_t size){
+  int n = snprintf(buf, size, "HP s %lu %d %lu %lu %lu %lu %lu", (unsigned long)s->time_ms, (int)region,
+    (unsigned long)s->total, (unsigned long)s->free, (unsigned long)s->largest, (unsigned long)s->min_free,
+    (unsigned long)(s->largest_sum ? s->largest_sum : s->largest));
+  return n > 0 && (size_t)n < size ? (size_t)n : 0;
+}
+
+// 書き込み先。足りなくなったらokをfalseにして、それ以降は書かない
+typedef struct {
+  char *p;
+  size_t left;
+  bool ok;
+} text_t;
+
+static void put(text_t *t, const char *fmt, ...){
+  if (!t->ok) {
+    return;
+  }
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(t->p, t->left, fmt, ap);
+  va_end(ap);
+  if (n < 0 || (size_t)n >= t->left) {
+    t->ok = false;
+    return;
+  }
+  t->p += n;
+  t->left -= (size_t)n;
+}
+
+static void put_site(text_t *t, const hp_site_t *site){
+  put(t, "  live %6lu B (%lu) peak %6lu B  allocs %lu frees %lu  size %lu..%lu  int %lu psram %lu hot %lu"
+    "  caps 0x%lx  pc", (unsigned long)site->live_bytes, (unsigned long)site->live_count,
+    (unsigned long)site->peak_bytes, (unsigned long)site->allocs, (unsigned long)site->frees,
+    (unsigned long)site->min_size, (unsigned long)site->max_size,
+    (unsigned long)site->region_allocs[HP_REGION_INTERNAL], (unsigned long)site->region_allocs[HP_REGION_PSRAM],
+    (unsigned long)site->hot_allocs, (unsigned long)site->caps);
+  for (int i = 0; i < HP_DEPTH && site->pc[i] != 0; i++) {
+    put(t, "%s0x%08lx", i == 0 ? " " : ",", (unsigned long)site->pc[i]);
+  }
+  if (site->pc[0] == 0) {
+    put(t, " (other)");
+  }
+  put(t, "%s\n", hp_is_leak_suspect(site) ? "  LEAK?" : "");
+}
+
+size_t hp_report(const hp_t *hp, char *buf, size_t size){
+  text_t t = {buf, size, size > 0};
+  put(&t, "heap: allocs %lu frees %lu unknown-frees %lu untracked %lu site-overflow %lu\n",
+    (unsigned long)hp->allocs, (unsigned long)hp->frees, (unsigned long)hp->unknown_frees,
+    (unsigned long)hp->live_overflow, (unsigned long)hp->site_overflow);
+  put(&t, "hot path: %lu allocs (%lu in psram)\n", (unsigned long)hp->hot_allocs,
+    (unsigned long)hp->hot_psram_allocs);
+  for (int r = 0; r < HP_REGION_NUM; r++) {
+    int len = hp_series_len(hp, (hp_region_t)r);
+    put(&t, "%s: live %lu B (peak %lu B)", region_names[r], (unsigned long)hp->live_bytes[r],
+      (unsigned long)hp->peak_live_bytes[r]);
+    if (len == 0) {
+      put(&t, ", no samples\n");
+      continue;
+    }
+    const hp_sample_t *first = hp_series_at(hp, (hp_region_t)r, 0);
+    const hp_sample_t *last = hp_series_at(hp, (hp_region_t)r, len - 1);
+    uint16_t frag_max = hp_frag_max(hp, (hp_region_t)r);
+    put(&t, ", free %lu/%lu B (min %lu), largest %lu B (min %lu, first %lu), frag %u.%u%% (max %u.%u%%, first %u.%u%%)"
+      " over %d samples\n", (unsigned long)last->free, (unsigned long)last->total, (unsigned long)last->min_free,
+      (unsigned long)last->largest, (unsigned long)hp_largest_min(hp, (hp_region_t)r), (unsigned long)first->largest,
+      last->frag_pm / 10, last->frag_pm % 10, frag_max / 10, frag_max % 10, first->frag_pm / 10, first->frag_pm % 10,
+      len);
+  }
+
+  int order[8];
+  int n = hp_top_sites(hp, order, 8);
+  put(&t, "top sites by live bytes:\n");
+  for (int i = 0; i < n && i < 8; i++) {
+    put_site(&t, &hp->sites[order[i]]);
+  }
+  bool header = false;
+  for (int i = 0; i < hp->num_sites; i++) {
+    if (hp->sites[i].hot_allocs == 0) {
+      continue;
+    }
+    if (!header) {
+      put(&t, "hot path sites:\n");
+      header = true;
+    }
+    put_site(&t, &hp->sites[i]);
+  }
+  return t.ok ? size - t.left : 0;
+}
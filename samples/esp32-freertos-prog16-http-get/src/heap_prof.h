@@ -0,0 +1,124 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// ヒープの割り当てプロファイラ（ロジック部分）
+// 割り当てと解放のイベント(heap_capsのフックから取る)を呼び出し元(スタックのPC数個)毎に集計する
+//   呼び出し元毎: 回数、解放、今残っているバイト、その最大、内部RAMとPSRAMの数、要求したcaps
+//   ホットパス: 制御など遅れてはいけないタスク(登録したもの)と割込みの中の割り当て。PSRAMに取ったものは特に数える
+//   リーク候補: 解放されずに残っている数がHP_LEAK_MIN_LIVE以上で、割り当てた数の半分を超える呼び出し元
+// ヒープの状態を周期的に受け取り、領域毎に空き、最大の連続ブロック、断片化の時系列を残す
+// 内部RAMは離れた複数のヒープ(DRAMの区間、RTCのメモリ)なので、断片化はヒープ毎の最大ブロックの合計から出す
+// (1 - Σ最大ブロック/Σ空き。全体の最大ブロック1つで割ると、割り当てる前から他のヒープの空きの分が断片化に見える)
+//
+// イベントはテキストの行でも受け取れる(実機のトレースを取ってホストで読み直す)
+//   HP a <time_ms> <ptr> <size> <caps> <flags> <pc>,<pc>,...     割り当て(数値は16進、time_msとsizeは10進)
+//   HP f <time_ms> <ptr>                                         解放
+//   HP s <time_ms> <region> <total> <free> <largest> <min_free> [<largest_sum>]
+//                                                                ヒープの状態(regionは0:内部RAM 1:PSRAM、largest_sumがなければlargest)
+// ESP-IDFに依存しないので、ホストでも確認できる(フックとタスクはheap_prof_port.h)
+
+#define HP_DEPTH           4       // 呼び出し元として残すPCの数
+#define HP_MAX_SITES       64
+#define HP_MAX_LIVE        512     // 追いかける割り当ての数(超えた分は数えるだけ)
+#define HP_SERIES          64      // 時系列の長さ(領域毎)
+#define HP_LEAK_MIN_LIVE   4
+
+#define HP_FLAG_HOT        0x01    // 登録したタスクで割り当てた
+#define HP_FLAG_ISR        0x02    // 割込みの中で割り当てた
+#define HP_FLAG_PSRAM      0x04    // PSRAMに取れた
+
+typedef enum {
+  HP_REGION_INTERNAL,
+  HP_REGION_PSRAM,
+  HP_REGION_NUM,
+} hp_region_t;
+
+typedef struct {
+  char type;                 // 'a' 'f'
+  uint8_t flags;
+  uint32_t time_ms;
+  uint32_t ptr;
+  uint32_t size;
+  uint32_t caps;
+  uint32_t pc[HP_DEPTH];
+} hp_event_t;
+
+typedef struct {
+  uint32_t pc[HP_DEPTH];
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t live_count;
+  uint32_t live_bytes;
+  uint32_t peak_bytes;
+  uint64_t total_bytes;
+  uint32_t hot_allocs;       // HP_FLAG_HOT|HP_FLAG_ISR
+  uint32_t region_allocs[HP_REGION_NUM];
+  uint32_t caps;             // 要求したcapsのOR
+  uint32_t min_size;
+  uint32_t max_size;
+} hp_site_t;
+
+typedef struct {
+  uint32_t time_ms;
+  uint32_t total;
+  uint32_t free;
+  uint32_t largest;
+  uint32_t min_free;
+  uint32_t largest_sum;      // ヒープ毎の最大ブロックの合計(0ならlargestと同じ、ヒープが1つ)
+  uint16_t frag_pm;          // 1000 - largest_sum * 1000 / free
+} hp_sample_t;
+
+typedef struct {
+  uint32_t ptr;
+  uint32_t size;
+  uint8_t site;
+  uint8_t region;
+  bool used;
+} hp_live_t;
+
+typedef struct {
+  hp_site_t sites[HP_MAX_SITES];
+  int num_sites;
+  hp_live_t live[HP_MAX_LIVE];
+  int num_live;
+  hp_sample_t series[HP_REGION_NUM][HP_SERIES];
+  uint32_t num_samples[HP_REGION_NUM];
+  // 全体
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t unknown_frees;    // 追いかけていない(始める前、溢れた)ポインタの解放
+  uint32_t live_overflow;    // HP_MAX_LIVEを超えて追いかけられなかった割り当て
+  uint32_t site_overflow;    // HP_MAX_SITESを超えた呼び出し元(最後の呼び出し元にまとめる)
+  uint32_t hot_allocs;
+  uint32_t hot_psram_allocs;
+  uint32_t live_bytes[HP_REGION_NUM];
+  uint32_t peak_live_bytes[HP_REGION_NUM];
+} hp_t;
+
+void hp_init(hp_t *hp);
+
+void hp_alloc(hp_t *hp, const hp_event_t *e);
+void hp_free(hp_t *hp, uint32_t ptr);
+void hp_sample(hp_t *hp, hp_region_t region, const hp_sample_t *s);
+
+// トレースの1行を読む。"HP "で始まらない行は無視して0、読めた行は1、壊れた行は-1
+int hp_parse_line(hp_t *hp, const char *line);
+// イベント、ヒープの状態をトレースの1行にする(改行なし)。書いた長さを返す
+size_t hp_format_event(const hp_event_t *e, char *buf, size_t size);
+size_t hp_format_sample(hp_region_t region, const hp_sample_t *s, char *buf, size_t size);
+
+// 時系列の値。iは古い方から(0 <= i < hp_series_len)
+int hp_series_len(const hp_t *hp, hp_region_t region);
+const hp_sample_t *hp_series_at(const hp_t *hp, hp_region_t region, int i);
+// 時系列の中の断片化の最大、最大ブロックの最小
+uint16_t hp_frag_max(const hp_t *hp, hp_region_t region);
+uint32_t hp_largest_min(const hp_t *hp, hp_region_t region);
+
+bool hp_is_leak_suspect(const hp_site_t *site);
+// 残っているバイトの多い順に呼び出し元のindexをorderに入れる。入れた数を返す
+int hp_top_sites(const hp_t *hp, int *order, int max);
+
+// レポート(全体、領域毎の時系列のまとめ、上位の呼び出し元、ホットパスの呼び出し元)。書いた長さを返す
+size_t hp_report(const hp_t *hp, char *buf, size_t size);
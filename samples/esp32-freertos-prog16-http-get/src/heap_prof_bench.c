@@ -0,0 +1,38 @@
+#include <string.h>
+#include "heap_prof.h"
+#include "heap_prof_bench.h"
+
+static hp_event_t alloc_event(uint32_t ptr, uint32_t size, const uint32_t *pc, uint8_t flags){
+  hp_event_t e = {.type = 'a', .ptr = ptr, .size = size, .caps = 0x1800, .flags = flags};
+  memcpy(e.pc, pc, sizeof(e.pc));
+  return e;
+}
+
+void hp_bench_events(uint32_t iterations, uint32_t (*clock)(void), hp_bench_result_t *result){
+  static hp_t hp;
+  static const uint32_t pcs[8][HP_DEPTH] = {
+    {0x42010000, 0x42020000}, {0x42010010, 0x42020000}, {0x42010020, 0x42020000}, {0x42010030, 0x42020000},
+    {0x42010040, 0x42020010}, {0x42010050, 0x42020010}, {0x42010060, 0x42020010}, {0x42010070, 0x42020010},
+  };
+  uint32_t alloc_time = 0, free_time = 0;
+  hp_init(&hp);
+  if (iterations == 0) {
+    iterations = 1;
+  }
+  // 64個残した状態で、割り当てと一番古いものの解放を繰り返す
+  for (uint32_t i = 0; i < iterations + 64; i++) {
+    hp_event_t e = alloc_event(0x3fc80000 + (i % 4096) * 48, 32 + i % 200, pcs[i % 8], 0);
+    uint32_t start = clock();
+    hp_alloc(&hp, &e);
+    uint32_t end = clock();
+    if (i < 64) {
+      continue;
+    }
+    alloc_time += end - start;
+    start = clock();
+    hp_free(&hp, 0x3fc80000 + ((i - 64) % 4096) * 48);
+    free_time += clock() - start;
+  }
+  result->alloc = alloc_time / iterations;
+  result->free = free_time / iterations;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+#include "heap_prof.h"
+
+// 割り当て1回と解放1回の集計にかかる時間。clockは増えていく時計(実機はCPUサイクル、ホストはns)
+typedef struct {
+  uint32_t alloc;
+  uint32_t free;
+} hp_bench_result_t;
+
+void hp_bench_events(uint32_t iterations, uint32_t (*clock)(void), hp_bench_result_t *result);
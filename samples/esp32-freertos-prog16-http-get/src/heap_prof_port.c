@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_idf_version.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#include "heap_prof_port.h"
+
+#define TAG "heapprof"
+
+#if !CONFIG_HEAP_USE_HOOKS
+#error "heap_prof_port needs CONFIG_HEAP_USE_HOOKS"
+#endif
+#if CONFIG_HEAP_PLACE_FUNCTION_INTO_FLASH
+#error "heap_prof_port finds the caller by skipping the heap functions in IRAM"
+#endif
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 3, 0)
+#error "heap_prof_port needs heap_caps_walk (ESP-IDF 5.3)"
+#endif
+
+// フックからタスクへ(フックはどのコア、割込みからも来るので、スピンロックで守る)
+// フックとここから呼ぶものは、キャッシュが止まっている間(NVSの書き込み中など)にも動くのでIRAMとDRAMに置く
+static DRAM_ATTR portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+static DRAM_ATTR hp_event_t ring[HP_PORT_RING];
+static DRAM_ATTR uint32_t ring_head;       // 書いた数
+static DRAM_ATTR uint32_t ring_tail;       // 読んだ数
+static DRAM_ATTR uint32_t ring_dropped;
+static DRAM_ATTR volatile bool enabled;
+static DRAM_ATTR TaskHandle_t hot_tasks[HP_PORT_MAX_HOT];
+static DRAM_ATTR int num_hot_tasks;
+
+// Xtensaの戻りアドレスは上2bitがウィンドウの大きさなので、アドレスに戻して呼び出し命令(3バイト前)を指す
+// (esp_cpu_process_stack_pcと同じ)
+#define CALL_PC(ra) ((((ra) & 0x3fffffffu) | 0x40000000u) - 3)
+
+// 呼び出し元のPCを取る。実行できる場所でなくなったら(スタックの終わり)止める
+// フックを呼ぶのはheap_caps_malloc_baseで、アプリまでのフレームの数は入口で違う
+// (malloc→heap_caps_malloc_default→heap_caps_malloc_baseは3つ、heap_caps_mallocからは2つ、callocやreallocはまた違う)
+// ヒープの関数とnewlibのmallocはIRAMにあるので、先頭のIRAMのフレームをHP_PORT_SKIP_MAXまで飛ばす
+// (IRAMに置いたアプリの関数から割り当てると、その呼び出し元が記録される)
+// __builtin_return_addressの引数は定数なので、フレーム毎に書く
+#define GET_PC(n) do {                                                              \
+    uint32_t call = CALL_PC((uint32_t)(uintptr_t)__builtin_return_address(n));      \
+    if (!esp_ptr_executable((void *)(uintptr_t)call)) {                             \
+      return;                                                                       \
+    }                                                                               \
+    if (got == 0 && skipped < HP_PORT_SKIP_MAX && esp_ptr_in_iram((void *)(uintptr_t)call)) { \
+      skipped++;                                                                    \
+    } else {                                                                        \
+      pc[got++] = call;                                                             \
+      if (got == HP_DEPTH) {                                                        \
+        return;                                                                     \
+      }                                                                             \
+    }                                                                               \
+  } while (0)
+
+static void IRAM_ATTR __attribute__((noinline)) get_pcs(uint32_t *pc){
+  _Static_assert(HP_PORT_SKIP_MAX + HP_DEPTH <= 8, "add GET_PC lines");
+  int skipped = 0, got = 0;
+  // 0はフックの中(get_pcsを呼んだところ)なので1から
+  GET_PC(1); GET_PC(2); GET_PC(3); GET_PC(4); GET_PC(5); GET_PC(6); GET_PC(7); GET_PC(8);
+}
+
+static bool IRAM_ATTR is_hot(void){
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  int n = __atomic_load_n(&num_hot_tasks, __ATOMIC_ACQUIRE);
+  for (int i = 0; i < n; i++) {
+    if (hot_tasks[i] == self) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void IRAM_ATTR push(const hp_event_t *e){
+  portENTER_CRITICAL_SAFE(&ring_lock);
+  if (ring_head - ring_tail >= HP_PORT_RING) {
+    ring_dropped++;
+  } else {
+    ring[ring_head & (HP_PORT_RING - 1)] = *e;
+    ring_head++;
+  }
+  portEXIT_CRITICAL_SAFE(&ring_lock);
+}
+
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps){
+  if (!enabled || ptr == NULL) {
+    return;
+  }
+  hp_event_t e = {.type = 'a', .ptr = (uint32_t)(uintptr_t)ptr, .size = (uint32_t)size, .caps = caps,
+    .time_ms = (uint32_t)(esp_timer_get_time() / 1000)};
+  bool isr = xPortInIsrContext();
+  e.flags = (isr ? HP_FLAG_ISR : is_hot() ? HP_FLAG_HOT : 0) | (esp_ptr_external_ram(ptr) ? HP_FLAG_PSRAM : 0);
+  get_pcs(e.pc);
+  push(&e);
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr){
+  if (!enabled || ptr == NULL) {
+    return;
+  }
+  hp_event_t e = {.type = 'f', .ptr = (uint32_t)(uintptr_t)ptr, .time_ms = (uint32_t)(esp_timer_get_time() / 1000)};
+  push(&e);
+}
+
+esp_err_t hp_port_mark_hot(TaskHandle_t task){
+  if (num_hot_tasks >= HP_PORT_MAX_HOT) {
+    return ESP_ERR_NO_MEM;
+  }
+  // 先に入れてから数を増やす(フックは数までしか見ない)
+  hot_tasks[num_hot_tasks] = task;
+  __atomic_store_n(&num_hot_tasks, num_hot_tasks + 1, __ATOMIC_RELEASE);
+  return ESP_OK;
+}
+
+static bool has_psram(void){
+  return heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+}
+
+void hp_port_register_metrics(hp_port_t *p, tm_t *tm){
+  static const char *const names[HP_REGION_NUM][3] = {
+    {"heap_internal_free", "heap_internal_largest", "heap_internal_frag"},
+    {"heap_psram_free", "heap_psram_largest", "heap_psram_frag"},
+  };
+  p->tm = tm;
+  for (int r = 0; r < HP_REGION_NUM; r++) {
+    bool on = r == HP_REGION_INTERNAL || has_psram();
+    p->free_id[r] = on ? tm_register(tm, names[r][0], TM_GAUGE, 0, NULL, 0) : -1;
+    p->largest_id[r] = on ? tm_register(tm, names[r][1], TM_GAUGE, 0, NULL, 0) : -1;
+    // 断片化は0〜1(‰で持つ)
+    p->frag_id[r] = on ? tm_register(tm, names[r][2], TM_GAUGE, -3, NULL, 0) : -1;
+  }
+  p->hot_id = tm_register(tm, "heap_hot_allocs", TM_COUNTER, 0, NULL, 0);
+  p->dropped_id = tm_register(tm, "heap_events_dropped", TM_COUNTER, 0, NULL, 0);
+  p->leaks_id = tm_register(tm, "heap_leak_sites", TM_GAUGE, 0, NULL, 0);
+}
+
+// tm_registerが失敗していれば(-1)何もしない
+static void set_metric(tm_t *tm, int id, int32_t value){
+  if (tm != NULL && id >= 0) {
+    tm_set(tm, id, value);
+  }
+}
+
+static void count_metric(tm_t *tm, int id, uint32_t delta){
+  if (tm != NULL && id >= 0 && delta > 0) {
+    tm_count(tm, id, delta);
+  }
+}
+
+// heap_caps_walkのブロック毎に、ヒープ(登録した領域)毎の最大の空きブロックを足していく
+// ヒープのロックを持ったまま呼ばれるので、割り当てもログもしない
+typedef struct {
+  intptr_t heap;             // 今のヒープの先頭
+  uint32_t heap_largest;
+  hp_sample_t *s;
+} walk_t;
+
+static void walk_end_heap(walk_t *w){
+  w->s->largest_sum += w->heap_largest;
+  if (w->heap_largest > w->s->largest) {
+    w->s->largest = w->heap_largest;
+  }
+  w->heap_largest = 0;
+}
+
+static bool walk_block(walker_heap_into_t heap, walker_block_info_t block, void *arg){
+  walk_t *w = (walk_t *)arg;
+  if (heap.start != w->heap) {
+    walk_end_heap(w);
+    w->heap = heap.start;
+  }
+  if (!block.used) {
+    w->s->free += (uint32_t)block.size;
+    if (block.size > w->heap_largest) {
+      w->heap_largest = (uint32_t)block.size;
+    }
+  }
+  return true;
+}
+
+// heap_caps_get_infoの空きと最大ブロックは全部のヒープを合わせたもので、離れたヒープの空きが断片化に見えるので、
+// ヒープ毎に歩く(heap_caps_get_infoも中でヒープ毎に全部のブロックを歩くので、掛かる時間は同じくらい)
+static void take_sample(hp_port_t *p, hp_region_t region, uint32_t caps, uint32_t now_ms, bool trace){
+  hp_sample_t s = {
+    .time_ms = now_ms,
+    .total = (uint32_t)heap_caps_get_total_size(caps),
+    .min_free = (uint32_t)heap_caps_get_minimum_free_size(caps),
+  };
+  walk_t w = {.heap = 0, .heap_largest = 0, .s = &s};
+  heap_caps_walk(caps, walk_block, &w);
+  walk_end_heap(&w);
+  hp_sample(&p->prof, region, &s);
+  const hp_sample_t *last = hp_series_at(&p->prof, region, hp_series_len(&p->prof, region) - 1);
+  set_metric(p->tm, p->free_id[region], (int32_t)last->free);
+  set_metric(p->tm, p->largest_id[region], (int32_t)last->largest);
+  set_metric(p->tm, p->frag_id[region], last->frag_pm);
+  if (trace) {
+    char line[96];
+    if (hp_format_sample(region, &s, line, sizeof(line)) > 0) {
+      printf("%s\n", line);
+    }
+  }
+}
+
+// リングから取り出して集計する。トレースならprintfする(その中の割り当てもリングに入るが、ロックは持っていない)
+static void drain(hp_port_t *p, bool trace){
+  static hp_event_t batch[32];
+  char line[96];
+  while (true) {
+    int n = 0;
+    portENTER_CRITICAL(&ring_lock);
+    while (n < 32 && ring_tail != ring_head) {
+      batch[n++] = ring[ring_tail & (HP_PORT_RING - 1)];
+      ring_tail++;
+    }
+    portEXIT_CRITICAL(&ring_lock);
+    if (n == 0) {
+      return;
+    }
+    for (int i = 0; i < n; i++) {
+      if (batch[i].type == 'a') {
+        hp_alloc(&p->prof, &batch[i]);
+      } else {
+        hp_free(&p->prof, batch[i].ptr);
+      }
+      if (trace && hp_format_event(&batch[i], line, sizeof(line)) > 0) {
+        printf("%s\n", line);
+      }
+    }
+  }
+}
+
+static void hp_port_task(void *arg){
+  hp_port_t *p = (hp_port_t *)arg;
+  static char report[2048];
+  bool psram = has_psram();
+  uint32_t last_sample = 0, last_report = 0, hot = 0, dropped = 0;
+  TickType_t last = xTaskGetTickCount();
+  while (true) {
+    vTaskDelayUntil(&last, pdMS_TO_TICKS(HP_PORT_DRAIN_MS));
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool trace = cfg_get_bool(p->cfg, p->trace_id);
+    drain(p, trace);
+
+    if (now_ms - last_sample >= (uint32_t)cfg_get_int(p->cfg, p->sample_id)) {
+      last_sample = now_ms;
+      take_sample(p, HP_REGION_INTERNAL, MALLOC_CAP_INTERNAL, now_ms, trace);
+      if (psram) {
+        take_sample(p, HP_REGION_PSRAM, MALLOC_CAP_SPIRAM, now_ms, trace);
+      }
+      int leaks = 0;
+      for (int i = 0; i < p->prof.num_sites; i++) {
+        leaks += hp_is_leak_suspect(&p->prof.sites[i]);
+      }
+      set_metric(p->tm, p->leaks_id, leaks);
+      count_metric(p->tm, p->hot_id, p->prof.hot_allocs - hot);
+      hot = p->prof.hot_allocs;
+      uint32_t d = __atomic_load_n(&ring_dropped, __ATOMIC_RELAXED);
+      count_metric(p->tm, p->dropped_id, d - dropped);
+      dropped = d;
+    }
+
+    uint32_t report_s = (uint32_t)cfg_get_int(p->cfg, p->report_id);
+    if (report_s > 0 && now_ms - last_report >= report_s * 1000) {
+      last_report = now_ms;
+      size_t len = hp_report(&p->prof, report, sizeof(report));
+      if (len == 0) {
+        ESP_LOGW(TAG, "report truncated");
+      } else {
+        printf("%s(events dropped: %lu)\n", report, (unsigned long)dropped);
+      }
+    }
+  }
+}
+
+esp_err_t hp_port_start(hp_port_t *p, const cfg_store_t *cfg, int sample_id, int report_id, int trace_id,
+  UBaseType_t priority){
+  hp_init(&p->prof);
+  p->cfg = cfg;
+  p->sample_id = sample_id;
+  p->report_id = report_id;
+  p->trace_id = trace_id;
+  enabled = true;
+  if (xTaskCreate(hp_port_task, "heapprof", 4096, p, priority, &p->task) != pdPASS) {
+    enabled = false;
+    return ESP_ERR_NO_MEM;
+  }
+  ESP_LOGI(TAG, "heap hooks enabled (psram %s)", has_psram() ? "present" : "absent");
+  return ESP_OK;
+}
+
+void hp_port_bench_hook(uint32_t iterations, uint32_t *off_cycles, uint32_t *on_cycles){
+  uint32_t total[2] = {0, 0};
+  if (iterations == 0) {
+    iterations = 1;
+  }
+  for (int on = 0; on < 2; on++) {
+    enabled = on;
+    for (uint32_t i = 0; i < iterations; i++) {
+      uint32_t start = esp_cpu_get_cycle_count();
+      void *ptr = malloc(64);
+      free(ptr);
+      total[on] += esp_cpu_get_cycle_count() - start;
+      // 集計するタスクはまだないので捨てる
+      portENTER_CRITICAL(&ring_lock);
+      ring_tail = ring_head;
+      portEXIT_CRITICAL(&ring_lock);
+    }
+  }
+  enabled = false;
+  *off_cycles = total[0] / iterations;
+  *on_cycles = total[1] / iterations;
+}
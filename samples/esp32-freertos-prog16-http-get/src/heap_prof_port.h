@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "heap_prof.h"
+#include "telemetry.h"
+#include "config_store.h"
+
+// ヒープの割り当てプロファイラ(ESP-IDF部分)
+// heap_capsのフック(esp_heap_trace_alloc_hook/esp_heap_trace_free_hook)で割り当てと解放を取り、
+// リングに入れてheapprofタスクがまとめて集計する(フックの中では集計しない、ロックは短いスピンロックだけ)
+//   呼び出し元は__builtin_return_addressのPC(先頭のIRAMのフレーム=ヒープの関数を飛ばしてHP_DEPTH個)。addr2line -pfiaC -e firmware.elf で読む
+//   ホットパス: hp_port_mark_hot()で登録したタスクと割込みの中の割り当て
+//   ヒープの状態: 設定ストアの間隔毎に内部RAMとPSRAM(あれば)をheap_caps_walkでヒープ毎に歩く
+// 時系列の最新の値と、ホットパスの割り当て、取りこぼしはテレメトリのメトリクスにする(/metricsにも出る)
+// 設定ストアのレポートの間隔(s)毎にhp_reportをシリアルに出す。トレース(bool)がtrueならイベントを"HP ..."の行で出す
+// (pio device monitorの出力をhost-simのcheck_prog16_heapで読み直せる)
+// hp_port_start()より前の割り当ては見えない(その解放はunknown-freesに数える)
+// CONFIG_HEAP_USE_HOOKSが必要
+
+#define HP_PORT_RING      256      // フックからタスクに渡すイベント(2の累乗)
+#define HP_PORT_SKIP_MAX  4        // 呼び出し元から外すIRAMのフレームの最大(heap_caps_*、newlibのmalloc)
+#define HP_PORT_MAX_HOT   8
+#define HP_PORT_DRAIN_MS  100
+
+typedef struct {
+  hp_t prof;
+  const cfg_store_t *cfg;
+  int sample_id;             // 設定ストアのヒープの状態を取る間隔(ms)のid
+  int report_id;             // レポートの間隔(s、0なら出さない)のid
+  int trace_id;              // トレースを出す(bool)のid
+  tm_t *tm;
+  int free_id[HP_REGION_NUM];
+  int largest_id[HP_REGION_NUM];
+  int frag_id[HP_REGION_NUM];
+  int hot_id;
+  int dropped_id;
+  int leaks_id;
+  TaskHandle_t task;
+} hp_port_t;
+
+// テレメトリにメトリクスを登録する。tm_port_start()の前に呼ぶ(PSRAMがなければPSRAMの分は登録しない)
+void hp_port_register_metrics(hp_port_t *p, tm_t *tm);
+
+// ホットパスのタスクを登録する。いっぱいならESP_ERR_NO_MEM
+esp_err_t hp_port_mark_hot(TaskHandle_t task);
+
+// フックを有効にして、heapprofタスクを作る
+esp_err_t hp_port_start(hp_port_t *p, const cfg_store_t *cfg, int sample_id, int report_id, int trace_id,
+  UBaseType_t priority);
+
+// malloc(64)とfreeの1組にかかるCPUサイクル(フックが無効、有効)。hp_port_start()の前に呼ぶ
+void hp_port_bench_hook(uint32_t iterations, uint32_t *off_cycles, uint32_t *on_cycles);
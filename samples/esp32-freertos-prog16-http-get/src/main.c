@@ -8,10 +8,64 @@
 #include "esp_system.h"
 #include "esp_netif.h"
 #include "esp_http_client.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
 #include "secret.h"
+#include "config_store_port.h"
+#include "config_store_bench.h"
+#include "telemetry_port.h"
+#include "telemetry_bench.h"
+#include "metrics_server.h"
+#include "metrics_bench.h"
+#include "heap_prof_port.h"
+#include "heap_prof_bench.h"
+
+// テレメトリの送り先はAPI_SERVERのホストのこのポート(secret.hで変えられる)
+#ifndef TELEMETRY_PORT
+#define TELEMETRY_PORT 9000
+#endif
+// メトリクスと設定のHTTPサーバーのポート
+#ifndef METRICS_HTTP_PORT
+#define METRICS_HTTP_PORT 80
+#endif
 
 static const char *TAG = "httpget";
 
+// 実行中に変えられる設定(NVSの名前空間"httpget"に残る)
+// API_SERVER + "config" から "key=value" の行で取得して適用する
+enum {
+    CFG_HTTP_TIMEOUT,       // HTTPのタイムアウト(ms)
+    CFG_POLL_MS,            // GETの間隔(ms)
+    CFG_CONFIG_POLL_MS,     // 設定を取りに行く間隔(ms)
+    CFG_TM_PERIOD_MS,       // テレメトリを送る間隔(ms)
+    CFG_METRICS_MS,         // /metricsのページを書き直す間隔(ms)
+    CFG_HEAP_SAMPLE_MS,     // ヒープの状態を取る間隔(ms)
+    CFG_HEAP_REPORT_S,      // ヒープのレポートを出す間隔(s、0なら出さない)
+    CFG_HEAP_TRACE,         // 割り当てのトレースをシリアルに出す
+    CFG_NUM,
+};
+static const cfg_def_t config_defs[CFG_NUM] = {
+    [CFG_HTTP_TIMEOUT] = {"http_timeout", CFG_INT, 10000, 1000, 60000},
+    [CFG_POLL_MS] = {"poll_ms", CFG_INT, 300, 100, 60000},
+    [CFG_CONFIG_POLL_MS] = {"cfg_poll_ms", CFG_INT, 5000, 1000, 600000},
+    [CFG_TM_PERIOD_MS] = {"tm_period_ms", CFG_INT, 1000, 100, 60000},
+    [CFG_METRICS_MS] = {"metrics_ms", CFG_INT, 1000, 200, 60000},
+    [CFG_HEAP_SAMPLE_MS] = {"heap_sample_ms", CFG_INT, 1000, 100, 60000},
+    [CFG_HEAP_REPORT_S] = {"heap_report_s", CFG_INT, 60, 0, 3600},
+    [CFG_HEAP_TRACE] = {"heap_trace", CFG_BOOL, 0, 0, 1},
+};
+static cfg_port_t config;
+static TaskHandle_t http_task_handle;
+
+// テレメトリ(10フレーム毎に今の値を全部送る)
+static const int32_t latency_bounds_ms[] = {10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+static tm_t telemetry;
+static tm_port_t telemetry_port;
+static int tm_requests, tm_errors, tm_latency, tm_status, tm_free_heap, tm_config_version;
+
+// ヒープの割り当てプロファイラ(http_get_taskとテレメトリのタスクをホットパスとして見る)
+static hp_port_t heap_prof;
+
 void wifi_init() {
     printf("WIFI_SSID = %s, WIFI_PASSWORD = %s, API_SERVER = %s\n", WIFI_SSID, WIFI_PASSWORD, API_SERVER);
 
@@ -75,57 +129,198 @@ void get_wifi_infos() {
     ESP_LOGE(TAG, "=========================");
 }
 
+// URLからGETして、本文をbufに読む(NUL終端)。読んだ長さを返す、失敗したら-1
+static int http_get(const char *url, char *buf, int size)
+{
+    int timeout_ms = cfg_get_int(&config.store, CFG_HTTP_TIMEOUT);
+    esp_http_client_config_t http_config = {
+        .url = url,
+        .method = HTTP_METHOD_GET,
+        .timeout_ms = timeout_ms,
+        .event_handler = NULL,
+    };
+    int64_t start = esp_timer_get_time();
+    tm_count(&telemetry, tm_requests, 1);
+    esp_http_client_handle_t client = esp_http_client_init(&http_config);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "*** Failed to initialize HTTP connection ***");
+        tm_count(&telemetry, tm_errors, 1);
+        return -1;
+    }
+    int read_len = -1;
+    esp_err_t ret = esp_http_client_open(client, 0);
+    if( ret < 0 ){
+        ESP_LOGE(TAG, "*** HTTP CONNECTION ERROR. *** ret=%d", ret);
+        goto cleanup;
+    }
+    int header_status = esp_http_client_fetch_headers(client);
+    if (header_status < 0) {
+        ESP_LOGE(TAG, "*** Failed to fetch headers *** status=%d", header_status);
+        goto close;
+    }
+    int status = esp_http_client_get_status_code(client);
+    tm_set(&telemetry, tm_status, status);
+    int content_length = esp_http_client_get_content_length(client);
+    ESP_LOGI(TAG, "%s: http status = %d, content length = %d", url, status, content_length);
+    if (status == 200) {
+        read_len = esp_http_client_read(client, buf, size - 1);
+        buf[read_len > 0 ? read_len : 0] = '\0';
+    }
+close:
+    esp_http_client_close(client);
+cleanup:
+    esp_http_client_cleanup(client);
+    if (read_len < 0) {
+        tm_count(&telemetry, tm_errors, 1);
+    } else {
+        tm_observe(&telemetry, tm_latency, (int32_t)((esp_timer_get_time() - start) / 1000));
+    }
+    return read_len;
+}
+
 // HTTP GETリクエストを行い、レスポンスを出力する
 // esp_http_client_perform()を使ったハンドラ処理ではなく、
 // open => read => closeを行うシンプルな通信処理
+// タイムアウトと間隔は毎回設定から読む。間隔が変わったら待ちを切り上げて、新しい間隔で待ち直す
 void http_get_task(void *pvParameters)
 {
     char response_buffer[512] = {0};
-    // APIの設定
-    // 事前にHTTPサーバーを起動しておく
-    esp_http_client_config_t config = {
-        .url = API_SERVER,
-        .method = HTTP_METHOD_GET,
-        .timeout_ms = 10000,
-        .event_handler = NULL,
-    };
 
     while(true){
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        if (client == NULL) {
-            ESP_LOGE(TAG, "*** Failed to initialize HTTP connection ***");
-            vTaskDelete(NULL);
-            return;
-        }
-        esp_err_t ret = esp_http_client_open(client, 10000);
-        if( ret < 0 ){
-            ESP_LOGE(TAG, "*** HTTP CONNECTION ERROR. *** ret=%d", ret);
-            vTaskDelete(NULL);
-            return;
+        // APIの設定
+        // 事前にHTTPサーバーを起動しておく
+        int read_len = http_get(API_SERVER, response_buffer, sizeof(response_buffer));
+        if (read_len >= 0) {
+            ESP_LOGI(TAG, "read_len=%d, received data: %s", read_len, response_buffer);
         }
-        int header_status = esp_http_client_fetch_headers(client);
-        if (header_status < 0) {
-            ESP_LOGE(TAG, "*** Failed to fetch headers *** status=%d", header_status);
-            vTaskDelete(NULL);
-            return;
+        tm_set(&telemetry, tm_free_heap, (int32_t)esp_get_free_heap_size());
+        tm_set(&telemetry, tm_config_version, (int32_t)cfg_version(&config.store));
+
+        // wait time
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(cfg_get_int(&config.store, CFG_POLL_MS)));
+    }
+}
+
+// 設定を取りに行き、変わっていれば適用する(NVSに残り、購読者に知らせる)
+void config_poll_task(void *pvParameters)
+{
+    static char text[512];
+    while (true) {
+        if (http_get(API_SERVER "config", text, sizeof(text)) >= 0) {
+            cfg_port_apply_text(&config, text, "http", NULL);
         }
-        int status = esp_http_client_get_status_code(client);
-        int content_length = esp_http_client_get_content_length(client);
-        ESP_LOGI(TAG, "http status = %d, content length = %d", status, content_length);
-        int read_len = esp_http_client_read(client, response_buffer, sizeof(response_buffer)-1);
-        ESP_LOGI(TAG, "read_len=%d, received data: %s", read_len, response_buffer);
+        vTaskDelay(pdMS_TO_TICKS(cfg_get_int(&config.store, CFG_CONFIG_POLL_MS)));
+    }
+}
 
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
+// GETの間隔が変わったら、待っているhttp_get_taskを起こす
+static void on_poll_changed(const cfg_store_t *store, uint32_t changed, void *arg)
+{
+    ESP_LOGI(TAG, "poll_ms -> %ld", (long)cfg_get_int(store, CFG_POLL_MS));
+    if (http_task_handle != NULL) {
+        xTaskNotifyGive(http_task_handle);
+    }
+}
 
-        // wait time
-        vTaskDelay(pdMS_TO_TICKS(300));
+static uint32_t cycle_count(void)
+{
+    return esp_cpu_get_cycle_count();
+}
+
+// API_SERVER("http://host:port/")のhostを取り出す
+static void api_server_host(char *host, size_t size)
+{
+    const char *p = strstr(API_SERVER, "//");
+    p = p != NULL ? p + 2 : API_SERVER;
+    size_t len = strcspn(p, ":/");
+    if (len >= size) {
+        len = size - 1;
     }
+    memcpy(host, p, len);
+    host[len] = '\0';
+}
+
+static void telemetry_init(void)
+{
+    tm_init(&telemetry, 10);
+    tm_requests = tm_register(&telemetry, "http_requests", TM_COUNTER, 0, NULL, 0);
+    tm_errors = tm_register(&telemetry, "http_errors", TM_COUNTER, 0, NULL, 0);
+    tm_latency = tm_register(&telemetry, "http_latency_ms", TM_HISTOGRAM, 0, latency_bounds_ms,
+        sizeof(latency_bounds_ms) / sizeof(latency_bounds_ms[0]));
+    tm_status = tm_register(&telemetry, "http_status", TM_GAUGE, 0, NULL, 0);
+    tm_free_heap = tm_register(&telemetry, "free_heap", TM_GAUGE, 0, NULL, 0);
+    tm_config_version = tm_register(&telemetry, "config_version", TM_GAUGE, 0, NULL, 0);
+    ms_register_metrics(&telemetry);
+    hp_port_register_metrics(&heap_prof, &telemetry);
+
+    char host[64];
+    api_server_host(host, sizeof(host));
+    ESP_ERROR_CHECK(tm_port_start(&telemetry_port, &telemetry, host, TELEMETRY_PORT,
+        &config.store, CFG_TM_PERIOD_MS, 3));
+    ESP_ERROR_CHECK(ms_start(METRICS_HTTP_PORT, &telemetry, &config, CFG_METRICS_MS, 2));
+    ESP_ERROR_CHECK(hp_port_start(&heap_prof, &config.store, CFG_HEAP_SAMPLE_MS, CFG_HEAP_REPORT_S,
+        CFG_HEAP_TRACE, 1));
+    ESP_ERROR_CHECK(hp_port_mark_hot(telemetry_port.task));
+}
+
+// 設定ストアの確認はhost-simのcheck_prog16で動かす。実機では読む側の速さだけを測る
+static void config_bench(void)
+{
+    cfg_bench_result_t bench;
+    cfg_bench_reads(10000, cycle_count, &bench);
+    ESP_LOGI(TAG, "config read cost (cycles per read, total for %lu iterations): get_int=%lu.%02lu (%lu) version=%lu.%02lu (%lu) read_all=%lu.%02lu (%lu)",
+        (unsigned long)bench.iterations,
+        (unsigned long)(bench.get_int_x100 / 100), (unsigned long)(bench.get_int_x100 % 100), (unsigned long)bench.get_int_total,
+        (unsigned long)(bench.version_x100 / 100), (unsigned long)(bench.version_x100 % 100), (unsigned long)bench.version_total,
+        (unsigned long)(bench.read_all_x100 / 100), (unsigned long)(bench.read_all_x100 % 100), (unsigned long)bench.read_all_total);
+}
+
+// テレメトリの確認はhost-simのcheck_prog16_telemetryで動かす。実機ではエンコードの重さだけを測る
+static void telemetry_bench(void)
+{
+    tm_bench_result_t bench;
+    tm_bench_encode(200, cycle_count, &bench);
+    ESP_LOGI(TAG, "telemetry per record (cycles, bytes): binary=%lu, %lu.%02lu text=%lu, %lu.%02lu",
+        (unsigned long)bench.encode_per_record,
+        (unsigned long)(bench.bytes_per_record_x100 / 100), (unsigned long)(bench.bytes_per_record_x100 % 100),
+        (unsigned long)bench.text_per_record,
+        (unsigned long)(bench.text_bytes_per_record_x100 / 100), (unsigned long)(bench.text_bytes_per_record_x100 % 100));
+}
+
+// ページの確認はhost-simのcheck_prog16_metricsで動かす。実機ではページを書く重さだけを測る
+static void metrics_bench(void)
+{
+    mp_bench_result_t bench;
+    mp_bench_render(20, cycle_count, &bench);
+    ESP_LOGI(TAG, "metrics render (cycles, bytes): text=%lu, %lu binary=%lu, %lu",
+        (unsigned long)bench.render_text, (unsigned long)bench.text_bytes,
+        (unsigned long)bench.render_binary, (unsigned long)bench.binary_bytes);
+}
+
+// プロファイラの確認はhost-simのcheck_prog16_heapで動かす。実機では集計とフックの重さだけを測る
+static void heap_bench(void)
+{
+    hp_bench_result_t bench;
+    hp_bench_events(1000, cycle_count, &bench);
+    uint32_t off, on;
+    hp_port_bench_hook(1000, &off, &on);
+    ESP_LOGI(TAG, "heap profiler (cycles): alloc=%lu free=%lu, malloc+free hooks off=%lu on=%lu",
+        (unsigned long)bench.alloc, (unsigned long)bench.free, (unsigned long)off, (unsigned long)on);
 }
 
 void app_main() {
+    config_bench();
+    telemetry_bench();
+    metrics_bench();
+    heap_bench();
     wifi_init();
+    ESP_ERROR_CHECK(cfg_port_init(&config, "httpget", config_defs, CFG_NUM));
+    cfg_subscribe(&config.store, 1u << CFG_POLL_MS, on_poll_changed, NULL);
+    cfg_port_log(&config);
+    telemetry_init();
     vTaskDelay(pdMS_TO_TICKS(3000));
     get_wifi_infos();
-    xTaskCreate(http_get_task, "http_get_task", 4096, NULL, 5, NULL);
+    xTaskCreate(http_get_task, "http_get_task", 4096, NULL, 5, &http_task_handle);
+    ESP_ERROR_CHECK(hp_port_mark_hot(http_task_handle));
+    xTaskCreate(config_poll_task, "config_poll_task", 4096, NULL, 4, NULL);
 }
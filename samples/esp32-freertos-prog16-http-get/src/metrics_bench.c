@@ -0,0 +1,68 @@
+#include <string.h>
+#include "metrics_page.h"
+#include "metrics_bench.h"
+#include "telemetry_bench.h"
+
+void mp_bench_snapshot(mp_snapshot_t *snap, uint32_t step){
+  static const struct {
+    const char *name;
+    uint8_t priority;
+    int8_t core;
+    char state;
+    uint32_t per_step;       // 1stepあたりの実行時間(µs)
+  } tasks[] = {
+    {"IDLE0", 0, 0, 'R', 600000},
+    {"IDLE1", 0, 1, 'r', 900000},
+    {"http_get_task", 5, -1, 'B', 300000},
+    {"telemetry", 3, -1, 'B', 50000},
+    {"metrics", 2, -1, 'B', 50000},
+    {"ipc0", 24, 0, 'S', 0},
+  };
+  memset(snap, 0, sizeof(*snap));
+  snap->uptime_ms = step * 1000;
+  snap->num_cores = 2;
+  snap->total_run_time = step * 1000000;
+  snap->num_tasks = sizeof(tasks) / sizeof(tasks[0]);
+  for (int i = 0; i < snap->num_tasks; i++) {
+    mp_task_t *t = &snap->tasks[i];
+    strcpy(t->name, tasks[i].name);
+    t->number = (uint32_t)i + 1;
+    t->run_time = tasks[i].per_step * step;
+    t->stack_free = 1000 + (uint32_t)i * 100;
+    t->priority = tasks[i].priority;
+    t->core = tasks[i].core;
+    t->state = tasks[i].state;
+  }
+  snap->num_queues = 1;
+  snap->queues[0] = (mp_queue_t){"events", step % 8, 8};
+  snap->heap = (mp_heap_t){200000 - step % 1000, 150000, 110000};
+}
+
+void mp_bench_render(uint32_t iterations, uint32_t (*clock)(void), mp_bench_result_t *result){
+  static char text[8192];
+  static uint8_t bin[2048];
+  static tm_t tm;
+  static mp_snapshot_t snap;
+  mp_cpu_t cpu = {0};
+  uint32_t seed = 3;
+  uint32_t text_time = 0, binary_time = 0;
+  size_t text_len = 0, binary_len = 0;
+  tm_bench_setup(&tm, 10);
+  if (iterations == 0) {
+    iterations = 1;
+  }
+  for (uint32_t i = 0; i < iterations; i++) {
+    tm_bench_update(&tm, &seed);
+    mp_bench_snapshot(&snap, i + 1);
+    uint32_t start = clock();
+    text_len = mp_render_text(&snap, &cpu, &tm, "esp32_", text, sizeof(text));
+    text_time += clock() - start;
+    start = clock();
+    binary_len = mp_render_binary(&tm, i * 1000, bin, sizeof(bin));
+    binary_time += clock() - start;
+  }
+  result->render_text = text_time / iterations;
+  result->render_binary = binary_time / iterations;
+  result->text_bytes = (uint32_t)text_len;
+  result->binary_bytes = (uint32_t)binary_len;
+}
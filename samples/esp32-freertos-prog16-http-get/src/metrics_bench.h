@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+#include "metrics_page.h"
+
+// ベンチマークとホストのサーバーで使うスナップショット。stepで実行時間とヒープを進める
+void mp_bench_snapshot(mp_snapshot_t *snap, uint32_t step);
+
+// 1回のレンダリングの重さ。clockは増えていく時計(実機はCPUサイクル、ホストはns)
+typedef struct {
+  uint32_t render_text;
+  uint32_t render_binary;
+  uint32_t text_bytes;
+  uint32_t binary_bytes;
+} mp_bench_result_t;
+
+void mp_bench_render(uint32_t iterations, uint32_t (*clock)(void), mp_bench_result_t *result);
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "metrics_page.h"
+
+// 書き込み先。足りなくなったらokをfalseにして、それ以降は書かない
+typedef struct {
+  char *p;
+  size_t left;
+  bool ok;
+} text_t;
+
+static void put(text_t *t, const char *fmt, ...){
+  if (!t->ok) {
+    return;
+  }
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(t->p, t->left, fmt, ap);
+  va_end(ap);
+  if (n < 0 || (size_t)n >= t->left) {
+    t->ok = false;
+    return;
+  }
+  t->p += n;
+  t->left -= (size_t)n;
+}
+
+// value * 10^exp を書く(小数点以下はexpの桁だけ)
+static void put_scaled(text_t *t, int32_t value, int8_t exp){
+  if (exp >= 0) {
+    int64_t v = value;
+    for (int i = 0; i < exp; i++) {
+      v *= 10;
+    }
+    put(t, "%lld", (long long)v);
+    return;
+  }
+  uint32_t div = 1;
+  for (int i = 0; i < -exp && i < 9; i++) {
+    div *= 10;
+  }
+  uint32_t mag = value < 0 ? -(uint32_t)value : (uint32_t)value;
+  put(t, "%s%lu.%0*lu", value < 0 ? "-" : "", (unsigned long)(mag / div), -exp, (unsigned long)(mag % div));
+}
+
+static void put_help(text_t *t, const char *prefix, const char *name, const char *type, const char *help){
+  put(t, "# HELP %s%s %s\n# TYPE %s%s %s\n", prefix, name, help, prefix, name, type);
+}
+
+// 前回からのCPU使用率[‰]。前回にいなかったタスクは-1
+static int task_permille(const mp_cpu_t *cpu, const mp_snapshot_t *snap, const mp_task_t *task){
+  if (!cpu->valid) {
+    return -1;
+  }
+  uint32_t total = snap->total_run_time - cpu->total_run_time;
+  for (int i = 0; i < cpu->num; i++) {
+    if (cpu->number[i] == task->number) {
+      // 1コアあたりの時間に対する割合(2コアなら合計で2000‰まで)
+      uint64_t run = task->run_time - cpu->run_time[i];
+      return total ? (int)(run * 1000 / total) : 0;
+    }
+  }
+  return -1;
+}
+
+// 固定されていないタスクのコアは"any"
+static const char *core_label(const mp_task_t *task, char *buf, size_t size){
+  if (task->core < 0) {
+    return "any";
+  }
+  snprintf(buf, size, "%d", task->core);
+  return buf;
+}
+
+static void render_tasks(text_t *t, const mp_snapshot_t *snap, const mp_cpu_t *cpu, const char *prefix){
+  char core[8];
+  put_help(t, prefix, "task_runtime_seconds_total", "counter", "CPU time used by the task");
+  for (int i = 0; i < snap->num_tasks; i++) {
+    const mp_task_t *task = &snap->tasks[i];
+    put(t, "%stask_runtime_seconds_total{task=\"%s\",core=\"%s\"} %lu.%06lu\n", prefix, task->name,
+      core_label(task, core, sizeof(core)),
+      (unsigned long)(task->run_time / 1000000), (unsigned long)(task->run_time % 1000000));
+  }
+  put_help(t, prefix, "task_cpu_ratio", "gauge", "CPU usage since the previous render (1 = one core)");
+  for (int i = 0; i < snap->num_tasks; i++) {
+    const mp_task_t *task = &snap->tasks[i];
+    int permille = task_permille(cpu, snap, task);
+    if (permille >= 0) {
+      put(t, "%stask_cpu_ratio{task=\"%s\",core=\"%s\"} %d.%03d\n", prefix, task->name,
+        core_label(task, core, sizeof(core)), permille / 1000, permille % 1000);
+    }
+  }
+  put_help(t, prefix, "task_stack_free_bytes", "gauge", "Stack high water mark");
+  for (int i = 0; i < snap->num_tasks; i++) {
+    const mp_task_t *task = &snap->tasks[i];
+    put(t, "%stask_stack_free_bytes{task=\"%s\"} %lu\n", prefix, task->name, (unsigned long)task->stack_free);
+  }
+  put_help(t, prefix, "task_info", "gauge", "Task priority and state (R:running r:ready B:blocked S:suspended)");
+  for (int i = 0; i < snap->num_tasks; i++) {
+    const mp_task_t *task = &snap->tasks[i];
+    put(t, "%stask_info{task=\"%s\",priority=\"%u\",state=\"%c\"} 1\n", prefix, task->name,
+      task->priority, task->state);
+  }
+}
+
+static void render_telemetry(text_t *t, tm_t *tm, const char *prefix){
+  for (int id = 0; id < tm->num; id++) {
+    const tm_metric_t *m = &tm->metrics[id];
+    switch (m->type) {
+    case TM_COUNTER:
+      put(t, "# TYPE %s%s_total counter\n%s%s_total %lu\n", prefix, m->name, prefix, m->name,
+        (unsigned long)__atomic_load_n(&m->value, __ATOMIC_RELAXED));
+      break;
+    case TM_GAUGE:
+      put(t, "# TYPE %s%s gauge\n%s%s ", prefix, m->name, prefix, m->name);
+      put_scaled(t, (int32_t)__atomic_load_n(&m->value, __ATOMIC_RELAXED), m->exp);
+      put(t, "\n");
+      break;
+    case TM_HISTOGRAM: {
+      // Prometheusのバケツは累積
+      uint32_t cumulative = 0;
+      put(t, "# TYPE %s%s histogram\n", prefix, m->name);
+      for (int b = 0; b <= m->num_bounds; b++) {
+        cumulative += __atomic_load_n(&m->buckets[b], __ATOMIC_RELAXED);
+        put(t, "%s%s_bucket{le=\"", prefix, m->name);
+        if (b < m->num_bounds) {
+          put_scaled(t, m->bounds[b], m->exp);
+        } else {
+          put(t, "+Inf");
+        }
+        put(t, "\"} %lu\n", (unsigned long)cumulative);
+      }
+      put(t, "%s%s_sum ", prefix, m->name);
+      put_scaled(t, (int32_t)__atomic_load_n(&m->sum, __ATOMIC_RELAXED), m->exp);
+      put(t, "\n%s%s_count %lu\n", prefix, m->name, (unsigned long)cumulative);
+      break;
+    }
+    }
+  }
+}
+
+size_t mp_render_text(const mp_snapshot_t *snap, mp_cpu_t *cpu, tm_t *tm, const char *prefix, char *buf, size_t size){
+  text_t t = {buf, size, size > 0};
+  put_help(&t, prefix, "uptime_seconds", "gauge", "Time since boot");
+  put(&t, "%suptime_seconds %lu.%03lu\n", prefix,
+    (unsigned long)(snap->uptime_ms / 1000), (unsigned long)(snap->uptime_ms % 1000));
+  put_help(&t, prefix, "heap_free_bytes", "gauge", "Free heap");
+  put(&t, "%sheap_free_bytes %lu\n", prefix, (unsigned long)snap->heap.free);
+  put_help(&t, prefix, "heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+  put(&t, "%sheap_min_free_bytes %lu\n", prefix, (unsigned long)snap->heap.min_free);
+  put_help(&t, prefix, "heap_largest_block_bytes", "gauge", "Largest allocatable block");
+  put(&t, "%sheap_largest_block_bytes %lu\n", prefix, (unsigned long)snap->heap.largest_block);
+  if (snap->num_queues > 0) {
+    put_help(&t, prefix, "queue_waiting", "gauge", "Items waiting in the queue");
+    for (int i = 0; i < snap->num_queues; i++) {
+      put(&t, "%squeue_waiting{queue=\"%s\",length=\"%lu\"} %lu\n", prefix, snap->queues[i].name,
+        (unsigned long)snap->queues[i].length, (unsigned long)snap->queues[i].waiting);
+    }
+  }
+  render_tasks(&t, snap, cpu, prefix);
+  if (tm != NULL) {
+    render_telemetry(&t, tm, prefix);
+  }
+
+  // 次の差分のために今回の実行時間を覚える(書ききれなくても)
+  cpu->num = snap->num_tasks;
+  for (int i = 0; i < snap->num_tasks; i++) {
+    cpu->number[i] = snap->tasks[i].number;
+    cpu->run_time[i] = snap->tasks[i].run_time;
+  }
+  cpu->total_run_time = snap->total_run_time;
+  cpu->valid = true;
+  return t.ok ? size - t.left : 0;
+}
+
+// 長さ(u16 LE)を前に付けて1フレーム書く
+static size_t put_frame(uint8_t *buf, size_t size, size_t len){
+  buf[0] = (uint8_t)len;
+  buf[1] = (uint8_t)(len >> 8);
+  return len > 0 && len + 2 <= size ? len + 2 : 0;
+}
+
+size_t mp_render_binary(tm_t *tm, uint32_t time_ms, uint8_t *buf, size_t size){
+  size_t pos = 0;
+  int next = 0;
+  while (next < tm->num) {
+    if (size - pos <= 2) {
+      return 0;
+    }
+    size_t len = tm_encode_desc(tm, time_ms, next, buf + pos + 2, size - pos - 2, &next);
+    size_t n = put_frame(buf + pos, size - pos, len);
+    if (n == 0) {
+      return 0;
+    }
+    pos += n;
+  }
+  if (size - pos <= 2) {
+    return 0;
+  }
+  size_t n = put_frame(buf + pos, size - pos, tm_encode_snapshot(tm, time_ms, buf + pos + 2, size - pos - 2));
+  return n ? pos + n : 0;
+}
+
+void mp_pub_init(mp_pub_t *pub, uint8_t *buf0, uint8_t *buf1, size_t size){
+  memset(pub, 0, sizeof(*pub));
+  pub->buf[0] = buf0;
+  pub->buf[1] = buf1;
+  pub->size = size;
+  pub->current = -1;
+}
+
+// 書く側が使うのは公開していない方(最初は0)
+static int back_index(const mp_pub_t *pub){
+  return __atomic_load_n(&pub->current, __ATOMIC_ACQUIRE) == 0 ? 1 : 0;
+}
+
+uint8_t *mp_pub_begin(mp_pub_t *pub){
+  int back = back_index(pub);
+  if (__atomic_load_n(&pub->readers[back], __ATOMIC_ACQUIRE) != 0) {
+    pub->busy++;
+    return NULL;
+  }
+  return pub->buf[back];
+}
+
+void mp_pub_commit(mp_pub_t *pub, size_t len){
+  if (len == 0) {
+    return;
+  }
+  int back = back_index(pub);
+  pub->len[back] = len;
+  __atomic_store_n(&pub->current, back, __ATOMIC_RELEASE);
+  pub->published++;
+}
+
+int mp_pub_acquire(mp_pub_t *pub, const uint8_t **buf, size_t *len){
+  while (true) {
+    int index = __atomic_load_n(&pub->current, __ATOMIC_ACQUIRE);
+    if (index < 0) {
+      return -1;
+    }
+    __atomic_fetch_add(&pub->readers[index], 1, __ATOMIC_SEQ_CST);
+    // 増やす前に切り替わっていたら、書く側がもう書き始めているかもしれないのでやり直す
+    if (__atomic_load_n(&pub->current, __ATOMIC_SEQ_CST) == index) {
+      *buf = pub->buf[index];
+      *len = pub->len[index];
+      return index;
+    }
+    __atomic_fetch_sub(&pub->readers[index], 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+void mp_pub_release(mp_pub_t *pub, int index){
+  __atomic_fetch_sub(&pub->readers[index], 1, __ATOMIC_RELEASE);
+}
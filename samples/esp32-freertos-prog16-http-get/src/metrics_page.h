@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "telemetry.h"
+
+// HTTPで返すメトリクスのページ（ロジック部分）
+// タスクのCPU時間、キューの深さ、ヒープ、テレメトリのメトリクスを
+// Prometheusのテキスト形式で書く。レンダリングはタスクが周期的に行い、HTTPのハンドラは書き終わったバッファをそのまま返す
+//
+// バッファは2つ(mp_pub_t)。書く側は今公開していない方に書いて、書き終わったら公開を切り替える
+// 返す側は公開中のバッファの読者数を増やしてから送り、送り終わったら減らす(コピーしない、ロックしない)
+// 書こうとしたバッファをまだ送っている途中なら、その回は書かずに飛ばす(busy)
+// ESP-IDFに依存しないので、ホストでも確認できる(HTTPサーバーとスナップショットはmetrics_server.h)
+
+#define MP_NAME_LEN      16
+#define MP_MAX_TASKS     24
+#define MP_MAX_QUEUES    8
+
+typedef struct {
+  char name[MP_NAME_LEN];
+  uint32_t number;           // TaskStatus_t.xTaskNumber(前回と対応させる)
+  uint32_t run_time;         // TaskStatus_t.ulRunTimeCounter(µs)
+  uint32_t stack_free;       // スタックの残りの最小(バイト)
+  uint8_t priority;
+  int8_t core;               // 固定されていなければ-1
+  char state;                // 'R'unning 'r'eady 'B'locked 'S'uspended 'D'eleted
+} mp_task_t;
+
+typedef struct {
+  const char *name;
+  uint32_t waiting;
+  uint32_t length;
+} mp_queue_t;
+
+typedef struct {
+  uint32_t free;
+  uint32_t min_free;
+  uint32_t largest_block;
+} mp_heap_t;
+
+// 1回のレンダリングに使う値
+typedef struct {
+  uint32_t uptime_ms;
+  uint32_t total_run_time;   // uxTaskGetSystemState()の合計(µs)
+  int num_cores;
+  mp_task_t tasks[MP_MAX_TASKS];
+  int num_tasks;
+  mp_queue_t queues[MP_MAX_QUEUES];
+  int num_queues;
+  mp_heap_t heap;
+} mp_snapshot_t;
+
+// 前回のタスクの実行時間(CPU使用率を前回からの差で求める)
+typedef struct {
+  uint32_t number[MP_MAX_TASKS];
+  uint32_t run_time[MP_MAX_TASKS];
+  int num;
+  uint32_t total_run_time;
+  bool valid;
+} mp_cpu_t;
+
+// snapとtmの値をPrometheusのテキスト形式で書く。書いた長さを返す、足りなければ0
+// tmはNULL可。prefixはメトリクス名の前に付ける("esp32_"など)
+size_t mp_render_text(const mp_snapshot_t *snap, mp_cpu_t *cpu, tm_t *tm, const char *prefix, char *buf, size_t size);
+// telemetry_collector.py replayと同じ形式(長さ(u16 LE)+フレーム)で、説明とスナップショットを書く。足りなければ0
+size_t mp_render_binary(tm_t *tm, uint32_t time_ms, uint8_t *buf, size_t size);
+
+// 公開するバッファ
+typedef struct {
+  uint8_t *buf[2];
+  size_t size;
+  size_t len[2];
+  uint32_t readers[2];
+  int current;               // 公開中のバッファ(-1ならまだない)
+  uint32_t published;
+  uint32_t busy;             // 送っている途中で書けなかった回数
+} mp_pub_t;
+
+void mp_pub_init(mp_pub_t *pub, uint8_t *buf0, uint8_t *buf1, size_t size);
+// 書く側: 書いてよいバッファを返す。送っている途中ならNULL
+uint8_t *mp_pub_begin(mp_pub_t *pub);
+// 書く側: mp_pub_beginのバッファをlenで公開する(0なら公開しない)
+void mp_pub_commit(mp_pub_t *pub, size_t len);
+// 返す側: 公開中のバッファを借りる(まだなければ-1)。送り終わったらmp_pub_releaseで返す
+int mp_pub_acquire(mp_pub_t *pub, const uint8_t **buf, size_t *len);
+void mp_pub_release(mp_pub_t *pub, int index);
@@ -0,0 +1,213 @@
+#include <string.h>
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "metrics_server.h"
+
+#define TAG "metrics"
+
+#if !CONFIG_FREERTOS_USE_TRACE_FACILITY || !CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#error "metrics_server needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS"
+#endif
+
+static struct {
+  tm_t *tm;
+  cfg_port_t *config;
+  int period_id;
+  httpd_handle_t server;
+  const char *queue_names[MP_MAX_QUEUES];
+  QueueHandle_t queues[MP_MAX_QUEUES];
+  int num_queues;
+  mp_pub_t text;
+  mp_pub_t binary;
+  mp_cpu_t cpu;
+  int scrapes_id;
+  int busy_id;
+  int render_us_id;
+} ms = {.scrapes_id = -1};
+
+static uint8_t text_buf[2][MS_TEXT_SIZE];
+static uint8_t binary_buf[2][MS_BINARY_SIZE];
+// サンプリングとレンダリングの途中でmallocしないように静的に確保しておく
+static TaskStatus_t task_status[MP_MAX_TASKS];
+static mp_snapshot_t snap;
+
+esp_err_t ms_add_queue(const char *name, QueueHandle_t queue){
+  if (ms.num_queues >= MP_MAX_QUEUES) {
+    return ESP_ERR_NO_MEM;
+  }
+  ms.queue_names[ms.num_queues] = name;
+  ms.queues[ms.num_queues] = queue;
+  ms.num_queues++;
+  return ESP_OK;
+}
+
+void ms_register_metrics(tm_t *tm){
+  ms.scrapes_id = tm_register(tm, "http_scrapes", TM_COUNTER, 0, NULL, 0);
+  ms.busy_id = tm_register(tm, "metrics_busy", TM_COUNTER, 0, NULL, 0);
+  ms.render_us_id = tm_register(tm, "metrics_render_us", TM_GAUGE, 0, NULL, 0);
+}
+
+static char task_state(eTaskState state){
+  switch (state) {
+  case eRunning:   return 'R';
+  case eReady:     return 'r';
+  case eBlocked:   return 'B';
+  case eSuspended: return 'S';
+  default:         return 'D';
+  }
+}
+
+static void take_snapshot(mp_snapshot_t *s){
+  uint32_t total = 0;
+  UBaseType_t n = uxTaskGetSystemState(task_status, MP_MAX_TASKS, &total);
+  // タスク数が配列より多いと0が返る(そのときはタスクを書かない)
+  s->uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+  s->total_run_time = total;
+  s->num_cores = portNUM_PROCESSORS;
+  s->num_tasks = (int)n;
+  for (UBaseType_t i = 0; i < n; i++) {
+    const TaskStatus_t *st = &task_status[i];
+    mp_task_t *t = &s->tasks[i];
+    strlcpy(t->name, st->pcTaskName, sizeof(t->name));
+    t->number = st->xTaskNumber;
+    t->run_time = st->ulRunTimeCounter;
+    t->stack_free = st->usStackHighWaterMark;   // ESP-IDFではバイト
+    t->priority = (uint8_t)st->uxCurrentPriority;
+    BaseType_t affinity = xTaskGetAffinity(st->xHandle);
+    t->core = affinity == tskNO_AFFINITY ? -1 : (int8_t)affinity;
+    t->state = task_state(st->eCurrentState);
+  }
+  s->num_queues = ms.num_queues;
+  for (int i = 0; i < ms.num_queues; i++) {
+    s->queues[i].name = ms.queue_names[i];
+    s->queues[i].waiting = uxQueueMessagesWaiting(ms.queues[i]);
+    s->queues[i].length = s->queues[i].waiting + uxQueueSpacesAvailable(ms.queues[i]);
+  }
+  s->heap.free = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+  s->heap.min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+  s->heap.largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+}
+
+static void metrics_task(void *arg){
+  TickType_t last = xTaskGetTickCount();
+  while (true) {
+    int64_t start = esp_timer_get_time();
+    take_snapshot(&snap);
+
+    // 送っている途中なら書かずに次の周期を待つ
+    uint8_t *buf = mp_pub_begin(&ms.text);
+    if (buf != NULL) {
+      mp_pub_commit(&ms.text, mp_render_text(&snap, &ms.cpu, ms.tm, "esp32_", (char *)buf, MS_TEXT_SIZE));
+    } else {
+      tm_count(ms.tm, ms.busy_id, 1);
+    }
+    buf = mp_pub_begin(&ms.binary);
+    if (buf != NULL) {
+      mp_pub_commit(&ms.binary, mp_render_binary(ms.tm, snap.uptime_ms, buf, MS_BINARY_SIZE));
+    } else {
+      tm_count(ms.tm, ms.busy_id, 1);
+    }
+    tm_set(ms.tm, ms.render_us_id, (int32_t)(esp_timer_get_time() - start));
+
+    vTaskDelayUntil(&last, pdMS_TO_TICKS(cfg_get_int(&ms.config->store, ms.period_id)));
+  }
+}
+
+// 公開中のバッファをそのまま送る(コピーしない)
+static esp_err_t send_published(httpd_req_t *req, mp_pub_t *pub, const char *type){
+  const uint8_t *buf;
+  size_t len;
+  int index = mp_pub_acquire(pub, &buf, &len);
+  if (index < 0) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    return httpd_resp_send(req, "not ready\n", HTTPD_RESP_USE_STRLEN);
+  }
+  tm_count(ms.tm, ms.scrapes_id, 1);
+  httpd_resp_set_type(req, type);
+  esp_err_t ret = httpd_resp_send(req, (const char *)buf, (ssize_t)len);
+  mp_pub_release(pub, index);
+  return ret;
+}
+
+static esp_err_t metrics_get(httpd_req_t *req){
+  return send_published(req, &ms.text, "text/plain; version=0.0.4");
+}
+
+static esp_err_t metrics_bin_get(httpd_req_t *req){
+  return send_published(req, &ms.binary, "application/octet-stream");
+}
+
+static esp_err_t config_get(httpd_req_t *req){
+  static char text[512];
+  size_t len = cfg_format(&ms.config->store, text, sizeof(text));
+  httpd_resp_set_type(req, "text/plain");
+  return httpd_resp_send(req, text, (ssize_t)len);
+}
+
+static esp_err_t config_put(httpd_req_t *req){
+  char body[512];
+  if (req->content_len >= sizeof(body)) {
+    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "too long");
+  }
+  size_t len = 0;
+  while (len < req->content_len) {
+    int n = httpd_req_recv(req, body + len, req->content_len - len);
+    if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+      continue;
+    }
+    if (n <= 0) {
+      return ESP_FAIL;
+    }
+    len += (size_t)n;
+  }
+  body[len] = '\0';
+  uint32_t changed;
+  esp_err_t ret = cfg_port_apply_text(ms.config, body, "httpd", &changed);
+  if (ret == ESP_ERR_INVALID_ARG) {
+    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "invalid config");
+  }
+  if (ret != ESP_OK) {
+    return httpd_resp_send_500(req);
+  }
+  return config_get(req);
+}
+
+esp_err_t ms_start(uint16_t port, tm_t *tm, cfg_port_t *config, int period_id, UBaseType_t priority){
+  if (ms.scrapes_id < 0) {
+    ESP_LOGE(TAG, "call ms_register_metrics() first");
+    return ESP_ERR_INVALID_STATE;
+  }
+  ms.tm = tm;
+  ms.config = config;
+  ms.period_id = period_id;
+  mp_pub_init(&ms.text, text_buf[0], text_buf[1], MS_TEXT_SIZE);
+  mp_pub_init(&ms.binary, binary_buf[0], binary_buf[1], MS_BINARY_SIZE);
+
+  // サーバーより先にタスクを作って最初のページを書く(書くまでは503)
+  if (xTaskCreate(metrics_task, "metrics", 4096, NULL, priority, NULL) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  httpd_config_t http_config = HTTPD_DEFAULT_CONFIG();
+  http_config.server_port = port;
+  // LWIPのソケット(CONFIG_LWIP_MAX_SOCKETS)はHTTPクライアントとテレメトリのUDPも使うので、同時接続を減らす
+  http_config.max_open_sockets = 4;
+  esp_err_t ret = httpd_start(&ms.server, &http_config);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "httpd_start failed: %s", esp_err_to_name(ret));
+    return ret;
+  }
+  static const httpd_uri_t uris[] = {
+    {.uri = "/metrics", .method = HTTP_GET, .handler = metrics_get},
+    {.uri = "/metrics.bin", .method = HTTP_GET, .handler = metrics_bin_get},
+    {.uri = "/config", .method = HTTP_GET, .handler = config_get},
+    {.uri = "/config", .method = HTTP_PUT, .handler = config_put},
+  };
+  for (int i = 0; i < (int)(sizeof(uris) / sizeof(uris[0])); i++) {
+    httpd_register_uri_handler(ms.server, &uris[i]);
+  }
+  ESP_LOGI(TAG, "listening on port %u", port);
+  return ESP_OK;
+}
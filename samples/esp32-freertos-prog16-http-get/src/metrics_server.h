@@ -0,0 +1,31 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "config_store_port.h"
+#include "metrics_page.h"
+
+// メトリクスと設定のHTTPサーバー(ESP-IDF部分)
+//   GET /metrics      Prometheusのテキスト(タスクのCPU時間、ヒープ、テレメトリのメトリクス。ms_add_queueで登録したキューの深さ)
+//   GET /metrics.bin  テレメトリのメトリクスの説明とスナップショット(telemetry_collector.py replayで読める)
+//   GET /config       今の設定("key=value"の行)
+//   PUT /config       設定を変える(cfg_port_apply_textと同じ。誤りがあれば400で何も変えない)
+//
+// metricsタスクが設定ストアの間隔(ms)毎にスナップショットを取って両方のページを書き、ハンドラはそのバッファを送るだけ
+// スクレイプが多くても、レンダリングはその間隔に1回で、制御のタスクに掛かる負荷は増えない
+// 自分のメトリクス(スクレイプの数、レンダリングの時間、書けずに飛ばした回数)もテレメトリに登録する
+// CONFIG_FREERTOS_USE_TRACE_FACILITY、CONFIG_FREERTOS_GENERATE_RUN_TIME_STATSが必要
+
+#define MS_TEXT_SIZE   8192      // タスク16個、メトリクス24個ほど
+#define MS_BINARY_SIZE 1024
+
+// 深さを見るキューを登録する(ms_startの前)。いっぱいならESP_ERR_NO_MEM
+// prog16のタスクはキューを使わないので、main.cは何も登録しない(queue_waitingの行は出ない)
+esp_err_t ms_add_queue(const char *name, QueueHandle_t queue);
+
+// テレメトリに自分のメトリクスを登録する。tm_port_start()の前に呼ぶ
+void ms_register_metrics(tm_t *tm);
+
+// HTTPサーバー(port)とmetricsタスクを始める
+esp_err_t ms_start(uint16_t port, tm_t *tm, cfg_port_t *config, int period_id, UBaseType_t priority);
@@ -0,0 +1,334 @@
+#include <string.h>
+#include "telemetry.h"
+
+// 書き込み先。足りなくなったらokをfalseにして、それ以降は書かない
+typedef struct {
+  uint8_t *p;
+  uint8_t *end;
+  bool ok;
+} writer_t;
+
+static void put_u8(writer_t *w, uint8_t v){
+  if (w->p >= w->end) {
+    w->ok = false;
+    return;
+  }
+  *w->p++ = v;
+}
+
+static void put_varint(writer_t *w, uint32_t v){
+  while (v >= 0x80) {
+    put_u8(w, (uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  put_u8(w, (uint8_t)v);
+}
+
+static uint32_t zigzag(int32_t v){
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v){
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+void tm_init(tm_t *tm, uint32_t key_interval){
+  memset(tm, 0, sizeof(*tm));
+  tm->key_interval = key_interval;
+}
+
+int tm_register(tm_t *tm, const char *name, tm_type_t type, int8_t exp, const int32_t *bounds, int num_bounds){
+  if (tm->num >= TM_MAX_METRICS || strlen(name) > TM_NAME_MAX) {
+    return -1;
+  }
+  if (type == TM_HISTOGRAM ? (num_bounds < 1 || num_bounds > TM_MAX_BOUNDS) : num_bounds != 0) {
+    return -1;
+  }
+  int id = tm->num++;
+  tm_metric_t *m = &tm->metrics[id];
+  memset(m, 0, sizeof(*m));
+  m->name = name;
+  m->type = type;
+  m->exp = exp;
+  m->bounds = bounds;
+  m->num_bounds = (uint8_t)num_bounds;
+  return id;
+}
+
+void tm_observe(tm_t *tm, int id, int32_t value){
+  tm_metric_t *m = &tm->metrics[id];
+  int b = 0;
+  while (b < m->num_bounds && value > m->bounds[b]) {
+    b++;
+  }
+  __atomic_fetch_add(&m->buckets[b], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&m->sum, (uint32_t)value, __ATOMIC_RELAXED);
+}
+
+static void put_header(writer_t *w, tm_t *tm, tm_frame_type_t type, uint32_t time_ms){
+  put_u8(w, TM_MAGIC0);
+  put_u8(w, TM_MAGIC1);
+  put_u8(w, (uint8_t)(TM_VERSION << 4 | type));
+  put_u8(w, (uint8_t)tm->seq);
+  put_u8(w, (uint8_t)(tm->seq >> 8));
+  put_varint(w, time_ms);
+}
+
+// 1つのメトリクスのレコードを書く。変わっていなければ(keyでなければ)書かずにfalse
+// 書ききれなければw->okがfalseになり、sent_*は変えない。commitがfalseなら(スナップショット)いつも変えない
+static bool put_record(writer_t *w, tm_metric_t *m, int id, bool key, bool commit){
+  uint32_t value = __atomic_load_n(&m->value, __ATOMIC_RELAXED);
+  uint32_t buckets[TM_MAX_BOUNDS + 1];
+  uint32_t sum = 0;
+  uint32_t mask = 0;
+  int num_buckets = m->num_bounds + 1;
+  if (m->type == TM_HISTOGRAM) {
+    for (int b = 0; b < num_buckets; b++) {
+      buckets[b] = __atomic_load_n(&m->buckets[b], __ATOMIC_RELAXED);
+      if (key ? buckets[b] != 0 : buckets[b] != m->sent_buckets[b]) {
+        mask |= 1u << b;
+      }
+    }
+    sum = __atomic_load_n(&m->sum, __ATOMIC_RELAXED);
+    if (!key && mask == 0 && sum == m->sent_sum) {
+      return false;
+    }
+  } else if (!key && value == m->sent_value) {
+    return false;
+  }
+
+  uint8_t *start = w->p;
+  put_varint(w, (uint32_t)id);
+  switch (m->type) {
+  case TM_COUNTER:
+    put_varint(w, key ? value : value - m->sent_value);
+    break;
+  case TM_GAUGE:
+    put_varint(w, zigzag((int32_t)(key ? value : value - m->sent_value)));
+    break;
+  case TM_HISTOGRAM:
+    put_varint(w, mask);
+    for (int b = 0; b < num_buckets; b++) {
+      if (mask & (1u << b)) {
+        put_varint(w, key ? buckets[b] : buckets[b] - m->sent_buckets[b]);
+      }
+    }
+    put_varint(w, zigzag((int32_t)(key ? sum : sum - m->sent_sum)));
+    break;
+  }
+  if (!w->ok) {
+    w->p = start;
+    return false;
+  }
+  if (!commit) {
+    return true;
+  }
+  m->sent_value = value;
+  if (m->type == TM_HISTOGRAM) {
+    memcpy(m->sent_buckets, buckets, sizeof(uint32_t) * (size_t)num_buckets);
+    m->sent_sum = sum;
+  }
+  return true;
+}
+
+size_t tm_encode(tm_t *tm, uint32_t time_ms, uint8_t *buf, size_t size, bool *key){
+  if (size < TM_HEADER_MAX) {
+    return 0;
+  }
+  bool is_key = !tm->started || (tm->key_interval > 0 && tm->since_key + 1 >= tm->key_interval);
+  writer_t w = {buf, buf + size, true};
+  put_header(&w, tm, is_key ? TM_FRAME_KEY : TM_FRAME_DATA, time_ms);
+
+  uint32_t deferred = 0;
+  for (int id = 0; id < tm->num; id++) {
+    if (put_record(&w, &tm->metrics[id], id, is_key, true)) {
+      tm->stats.records++;
+    } else if (!w.ok) {
+      // 書ききれなかった分は数えて次に回す(後ろのメトリクスが小さければ入ることもある)
+      deferred++;
+      w.ok = true;
+    }
+  }
+  tm->stats.deferred += deferred;
+
+  // 書ききれなかったTM_FRAME_KEYは同期の起点にしない(種類を書き換え、次のフレームもTM_FRAME_KEYにする)
+  // 書いたメトリクスのsent_*は進めたが、今の値なので同期している受信側とはずれない
+  bool partial = is_key && deferred > 0;
+  if (partial) {
+    buf[2] = (uint8_t)(TM_VERSION << 4 | TM_FRAME_KEY_PART);
+  }
+  if (is_key) {
+    tm->started = !partial;
+  }
+  tm->since_key = is_key && !partial ? 0 : tm->since_key + 1;
+  tm->seq++;
+  tm->stats.frames++;
+  tm->stats.key_frames += is_key && !partial;
+  tm->stats.partial_keys += partial;
+  size_t len = (size_t)(w.p - buf);
+  tm->stats.bytes += (uint32_t)len;
+  if (key != NULL) {
+    *key = is_key && !partial;
+  }
+  return len;
+}
+
+size_t tm_encode_snapshot(tm_t *tm, uint32_t time_ms, uint8_t *buf, size_t size){
+  if (size < TM_HEADER_MAX) {
+    return 0;
+  }
+  writer_t w = {buf, buf + size, true};
+  put_header(&w, tm, TM_FRAME_KEY, time_ms);
+  for (int id = 0; id < tm->num; id++) {
+    put_record(&w, &tm->metrics[id], id, true, false);
+    if (!w.ok) {
+      return 0;
+    }
+  }
+  return (size_t)(w.p - buf);
+}
+
+size_t tm_encode_desc(tm_t *tm, uint32_t time_ms, int first, uint8_t *buf, size_t size, int *next){
+  writer_t w = {buf, buf + size, true};
+  // 説明はデータのseqを進めない(次のデータフレームと同じseq)
+  put_header(&w, tm, TM_FRAME_DESC, time_ms);
+  put_varint(&w, (uint32_t)tm->num);
+  if (!w.ok) {
+    *next = first;
+    return 0;
+  }
+  int id = first;
+  for (; id < tm->num; id++) {
+    const tm_metric_t *m = &tm->metrics[id];
+    uint8_t *start = w.p;
+    size_t name_len = strlen(m->name);
+    put_varint(&w, (uint32_t)id);
+    put_u8(&w, (uint8_t)m->type);
+    put_u8(&w, (uint8_t)m->exp);
+    put_u8(&w, (uint8_t)name_len);
+    for (size_t i = 0; i < name_len; i++) {
+      put_u8(&w, (uint8_t)m->name[i]);
+    }
+    if (m->type == TM_HISTOGRAM) {
+      put_u8(&w, m->num_bounds);
+      for (int b = 0; b < m->num_bounds; b++) {
+        put_varint(&w, zigzag(m->bounds[b]));
+      }
+    }
+    if (!w.ok) {
+      w.p = start;
+      break;
+    }
+  }
+  *next = id;
+  return id > first ? (size_t)(w.p - buf) : 0;
+}
+
+// 読み出し元。足りなければokをfalseにする
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+  bool ok;
+} reader_t;
+
+static uint8_t get_u8(reader_t *r){
+  if (r->p >= r->end) {
+    r->ok = false;
+    return 0;
+  }
+  return *r->p++;
+}
+
+static uint32_t get_varint(reader_t *r){
+  uint32_t v = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    uint8_t b = get_u8(r);
+    v |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return v;
+    }
+  }
+  r->ok = false;
+  return 0;
+}
+
+int tm_decode(tm_t *tm, const uint8_t *buf, size_t len){
+  reader_t r = {buf, buf + len, true};
+  if (get_u8(&r) != TM_MAGIC0 || get_u8(&r) != TM_MAGIC1) {
+    return -1;
+  }
+  uint8_t vt = get_u8(&r);
+  uint16_t seq = get_u8(&r);
+  seq |= (uint16_t)(get_u8(&r) << 8);
+  get_varint(&r);
+  if (!r.ok || vt >> 4 != TM_VERSION) {
+    return -1;
+  }
+  tm_frame_type_t type = (tm_frame_type_t)(vt & 0x0f);
+  if (type == TM_FRAME_DESC) {
+    return 0;
+  }
+  if (type != TM_FRAME_DATA && type != TM_FRAME_KEY && type != TM_FRAME_KEY_PART) {
+    return -1;
+  }
+  if (tm->synced && seq != tm->expect_seq) {
+    tm->lost += (uint16_t)(seq - tm->expect_seq);
+    tm->synced = false;
+  }
+  tm->expect_seq = (uint16_t)(seq + 1);
+  bool key = type == TM_FRAME_KEY || type == TM_FRAME_KEY_PART;
+  if (!tm->synced && type != TM_FRAME_KEY) {
+    return 0;
+  }
+  tm->synced = true;
+
+  int records = 0;
+  while (r.p < r.end) {
+    uint32_t id = get_varint(&r);
+    if (!r.ok || id >= (uint32_t)tm->num) {
+      return -1;
+    }
+    tm_metric_t *m = &tm->metrics[id];
+    switch (m->type) {
+    case TM_COUNTER:
+      m->value = (key ? 0 : m->value) + get_varint(&r);
+      break;
+    case TM_GAUGE:
+      m->value = (key ? 0 : m->value) + (uint32_t)unzigzag(get_varint(&r));
+      break;
+    case TM_HISTOGRAM: {
+      uint32_t mask = get_varint(&r);
+      for (int b = 0; b <= m->num_bounds; b++) {
+        uint32_t n = mask & (1u << b) ? get_varint(&r) : 0;
+        m->buckets[b] = (key ? 0 : m->buckets[b]) + n;
+      }
+      m->sum = (key ? 0 : m->sum) + (uint32_t)unzigzag(get_varint(&r));
+      break;
+    }
+    }
+    if (!r.ok) {
+      return -1;
+    }
+    records++;
+  }
+  return records;
+}
+
+bool tm_equal(const tm_t *a, const tm_t *b){
+  if (a->num != b->num) {
+    return false;
+  }
+  for (int i = 0; i < a->num; i++) {
+    const tm_metric_t *x = &a->metrics[i], *y = &b->metrics[i];
+    if (x->type != TM_HISTOGRAM) {
+      if (x->value != y->value) {
+        return false;
+      }
+      continue;
+    }
+    if (x->sum != y->sum || memcmp(x->buckets, y->buckets, sizeof(uint32_t) * (x->num_bounds + 1u)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
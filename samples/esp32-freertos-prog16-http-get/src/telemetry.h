@@ -0,0 +1,113 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// バイナリのテレメトリ（ロジック部分）
+// 型を決めたメトリクス(カウンタ、ゲージ、ヒストグラム)を登録し、前のフレームからの差分だけを小さなフレームにする
+// 値を変える側(tm_count/tm_set/tm_observe)はロックを使わない(32bitのアトミック操作だけ)。どのタスク、割込みからでもよい
+// フレームにする側(tm_encode)は1つのタスクだけ
+//
+// フレーム(リトルエンディアン、varintはLEB128、zigzagは符号付きの差分)
+//   'T' 'M' | バージョン<<4 | 種類 | seq(u16) | time_ms(varint) | レコード...
+//   種類 TM_FRAME_DATA: レコード = id(varint) + 値。値は前のフレームからの差分
+//        TM_FRAME_KEY : TM_FRAME_DATAと同じだが、値は差分ではなく今の値(取りこぼした後はここから読み直す)
+//        TM_FRAME_KEY_PART: 書ききれないメトリクスがあったTM_FRAME_KEY。同期している受信側は今の値として使うが、
+//                           同期の起点にはしない(書かなかったメトリクスの値がない)。次のフレームはまたTM_FRAME_KEYにする
+//          カウンタ    : varint(増えた数)
+//          ゲージ      : zigzag(差)
+//          ヒストグラム: varint(変わったバケツのビット) + varint(バケツ毎の増えた数)... + zigzag(合計の差)
+//        TM_FRAME_DESC: メトリクスの説明。数(varint)の後に id(varint) 型(u8) 指数(i8) 名前の長さ(u8) 名前
+//                       ヒストグラムは境界の数(u8) + zigzag(境界)...(値 <= 境界[i] ならバケツi、最後は超えた分)
+// 変わらないメトリクスは書かない(何も変わらなければレコードのないフレーム)。key_interval毎に今の値を全部書く
+// 書ききれないメトリクスは次のフレームに回す(差分は溜まったまま)
+// 今の値が全部1つのフレームに入らないと受信側が揃わないので、バッファはtm_encode_snapshotが入る大きさにする
+// ESP-IDFに依存しないので、ホストでも確認できる(UDPで送る部分はtelemetry_port.h)
+
+#define TM_MAGIC0         'T'
+#define TM_MAGIC1         'M'
+#define TM_VERSION        1
+#define TM_HEADER_MAX     10     // magic(2) + 種類(1) + seq(2) + time_ms(最大5)
+#define TM_MAX_METRICS    32
+#define TM_MAX_BOUNDS     15     // バケツは境界+1個
+#define TM_NAME_MAX       31
+
+typedef enum {
+  TM_FRAME_DATA,
+  TM_FRAME_KEY,
+  TM_FRAME_DESC,
+  TM_FRAME_KEY_PART,
+} tm_frame_type_t;
+
+typedef enum {
+  TM_COUNTER,                // 増えるだけ(ラップアラウンドは差分で吸収する)
+  TM_GAUGE,                  // 今の値(int32_t)。実際の値は value * 10^exp
+  TM_HISTOGRAM,              // 値の分布(int32_t)。バケツ毎の数と合計
+} tm_type_t;
+
+typedef struct {
+  const char *name;
+  tm_type_t type;
+  int8_t exp;
+  uint8_t num_bounds;
+  const int32_t *bounds;     // 昇順
+  // ここから下はtm_count/tm_set/tm_observeが書く
+  uint32_t value;
+  uint32_t buckets[TM_MAX_BOUNDS + 1];
+  uint32_t sum;
+  // ここから下はエンコーダ(デコーダ)だけが使う
+  uint32_t sent_value;
+  uint32_t sent_buckets[TM_MAX_BOUNDS + 1];
+  uint32_t sent_sum;
+} tm_metric_t;
+
+typedef struct {
+  uint32_t frames;
+  uint32_t key_frames;       // 全部書けたTM_FRAME_KEY
+  uint32_t partial_keys;     // TM_FRAME_KEY_PART
+  uint32_t records;
+  uint32_t bytes;
+  uint32_t deferred;         // 書ききれずに次に回したレコード
+} tm_encode_stats_t;
+
+typedef struct {
+  tm_metric_t metrics[TM_MAX_METRICS];
+  int num;
+  uint32_t key_interval;     // この数のフレーム毎にTM_FRAME_KEY(0なら最初だけ)
+  uint16_t seq;
+  uint32_t since_key;
+  bool started;              // 全部書けたTM_FRAME_KEYを送った(falseなら次はTM_FRAME_KEY)
+  tm_encode_stats_t stats;
+  // デコーダ
+  bool synced;               // TM_FRAME_KEYを受け取ってから、seqが続いている
+  uint16_t expect_seq;
+  uint32_t lost;             // 取りこぼしたフレーム(seqの飛び)
+} tm_t;
+
+void tm_init(tm_t *tm, uint32_t key_interval);
+
+// 登録してidを返す。表がいっぱい、名前が長い、境界が多すぎるときは-1
+int tm_register(tm_t *tm, const char *name, tm_type_t type, int8_t exp, const int32_t *bounds, int num_bounds);
+
+static inline void tm_count(tm_t *tm, int id, uint32_t n){
+  __atomic_fetch_add(&tm->metrics[id].value, n, __ATOMIC_RELAXED);
+}
+static inline void tm_set(tm_t *tm, int id, int32_t value){
+  __atomic_store_n(&tm->metrics[id].value, (uint32_t)value, __ATOMIC_RELAXED);
+}
+void tm_observe(tm_t *tm, int id, int32_t value);
+
+// 次のフレームを書いて長さを返す(sizeがTM_HEADER_MAXより小さければ0)
+// *keyに同期の起点になるTM_FRAME_KEYだったかを入れる(NULL可。TM_FRAME_KEY_PARTはfalse)
+size_t tm_encode(tm_t *tm, uint32_t time_ms, uint8_t *buf, size_t size, bool *key);
+// 今の値を全部TM_FRAME_KEYで書く(HTTPで返すスナップショット用)。tm_encodeの差分とseqは変えない
+// tm_encodeと別のタスクから呼んでよい。入りきらなければ0
+size_t tm_encode_snapshot(tm_t *tm, uint32_t time_ms, uint8_t *buf, size_t size);
+// id first からのメトリクスの説明を書いて長さを返す。*nextに次に書くidを入れる(num以上なら全部書いた)
+size_t tm_encode_desc(tm_t *tm, uint32_t time_ms, int first, uint8_t *buf, size_t size, int *next);
+
+// 同じ表を登録したtm_tにフレームを適用する(ホストの確認用。Pythonの受信側はserver/telemetry_collector.py)
+// 適用したレコードの数を返す。壊れたフレームは-1。取りこぼした後はTM_FRAME_KEYまで読み飛ばして0(TM_FRAME_KEY_PARTも読み飛ばす)
+int tm_decode(tm_t *tm, const uint8_t *buf, size_t len);
+// 2つの表の値(カウンタ、ゲージ、バケツ、合計)が同じならtrue(デコードした側と送った側を比べる)
+bool tm_equal(const tm_t *a, const tm_t *b);
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+#include "telemetry.h"
+#include "telemetry_bench.h"
+
+#define BENCH_COUNTERS 8
+#define BENCH_GAUGES   6
+
+static const char *bench_names[] = {
+  "http_requests", "http_errors", "http_bytes", "udp_frames", "udp_errors", "cfg_updates", "wdt_resets", "isr_count",
+  "free_heap", "min_free_heap", "rssi", "temp", "rpm", "duty",
+  "http_latency", "loop_time",
+};
+static const int32_t bench_bounds[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+
+void tm_bench_setup(tm_t *tm, uint32_t key_interval){
+  tm_init(tm, key_interval);
+  for (int i = 0; i < BENCH_COUNTERS; i++) {
+    tm_register(tm, bench_names[i], TM_COUNTER, 0, NULL, 0);
+  }
+  for (int i = 0; i < BENCH_GAUGES; i++) {
+    tm_register(tm, bench_names[BENCH_COUNTERS + i], TM_GAUGE, -2, NULL, 0);
+  }
+  for (int i = 0; i < 2; i++) {
+    tm_register(tm, bench_names[BENCH_COUNTERS + BENCH_GAUGES + i], TM_HISTOGRAM, 0, bench_bounds, 10);
+  }
+}
+
+static uint32_t next_rand(uint32_t *seed){
+  *seed = *seed * 1664525u + 1013904223u;
+  return *seed >> 8;
+}
+
+// カウンタの半分、ゲージの半分が小さく変わり、ヒストグラムに数個入る(センサーとHTTPの1秒くらい)
+void tm_bench_update(tm_t *tm, uint32_t *seed){
+  for (int i = 0; i < BENCH_COUNTERS + BENCH_GAUGES; i++) {
+    uint32_t r = next_rand(seed);
+    if (r & 1) {
+      continue;
+    }
+    if (i < BENCH_COUNTERS) {
+      tm_count(tm, i, r % 20);
+    } else {
+      tm_set(tm, i, (int32_t)(tm->metrics[i].value + (r % 200) - 100));
+    }
+  }
+  for (int i = BENCH_COUNTERS + BENCH_GAUGES; i < tm->num; i++) {
+    for (int n = next_rand(seed) % 4; n > 0; n--) {
+      tm_observe(tm, i, (int32_t)(next_rand(seed) % 600));
+    }
+  }
+}
+
+void tm_bench_encode(uint32_t frames, uint32_t (*clock)(void), tm_bench_result_t *result){
+  static tm_t tm;
+  static uint8_t buf[512];
+  static char text[1024];
+  uint32_t seed = 1;
+  uint32_t encode_time = 0, text_time = 0, text_bytes = 0, text_records = 0;
+  tm_bench_setup(&tm, 10);
+
+  for (uint32_t f = 0; f < frames; f++) {
+    tm_bench_update(&tm, &seed);
+    uint32_t start = clock();
+    tm_encode(&tm, f * 1000, buf, sizeof(buf), NULL);
+    encode_time += clock() - start;
+
+    // 比べるためのテキスト(全部のメトリクスを毎回書く。ログと同じ)
+    start = clock();
+    int len = 0;
+    for (int i = 0; i < tm.num; i++) {
+      const tm_metric_t *m = &tm.metrics[i];
+      double value = m->type == TM_COUNTER ? m->value : m->type == TM_GAUGE ? (int32_t)m->value / 100.0 : (int32_t)m->sum;
+      len += snprintf(text + len, sizeof(text) - (size_t)len, "%s=%f\n", m->name, value);
+    }
+    text_time += clock() - start;
+    text_bytes += (uint32_t)len;
+    text_records += (uint32_t)tm.num;
+  }
+
+  memset(result, 0, sizeof(*result));
+  result->frames = tm.stats.frames;
+  result->records = tm.stats.records;
+  if (tm.stats.records > 0) {
+    result->encode_per_record = encode_time / tm.stats.records;
+    result->bytes_per_record_x100 = (uint32_t)((uint64_t)tm.stats.bytes * 100 / tm.stats.records);
+  }
+  if (text_records > 0) {
+    result->text_per_record = text_time / text_records;
+    result->text_bytes_per_record_x100 = (uint32_t)((uint64_t)text_bytes * 100 / text_records);
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+#include "telemetry.h"
+
+// ベンチマーク用の表(カウンタ8、ゲージ6、ヒストグラム2)を登録する
+void tm_bench_setup(tm_t *tm, uint32_t key_interval);
+// 毎フレームの前にいくつかのメトリクスを変える(seedで決まる)
+void tm_bench_update(tm_t *tm, uint32_t *seed);
+
+// レコード1つあたりの重さ。clockは増えていく時計(実機はCPUサイクル、ホストはns)
+typedef struct {
+  uint32_t frames;
+  uint32_t records;
+  uint32_t encode_per_record;    // tm_encodeの時間 / レコード
+  uint32_t bytes_per_record_x100;
+  uint32_t text_per_record;      // 同じ値をsnprintf("%s=%f")で書いたときの時間 / メトリクス
+  uint32_t text_bytes_per_record_x100;
+} tm_bench_result_t;
+
+void tm_bench_encode(uint32_t frames, uint32_t (*clock)(void), tm_bench_result_t *result);
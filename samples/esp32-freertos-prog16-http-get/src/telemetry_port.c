@@ -0,0 +1,81 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "telemetry_port.h"
+
+#define TAG "telemetry"
+
+static bool send_frame(tm_port_t *p, const uint8_t *buf, size_t len){
+  int ret = sendto(p->sock, buf, len, 0, (const struct sockaddr *)&p->addr, sizeof(p->addr));
+  if (ret < 0) {
+    tm_count(p->tm, p->errors_id, 1);
+    return false;
+  }
+  tm_count(p->tm, p->frames_id, 1);
+  tm_count(p->tm, p->bytes_id, (uint32_t)len);
+  return true;
+}
+
+static void tm_port_task(void *arg){
+  tm_port_t *p = (tm_port_t *)arg;
+  static uint8_t buf[TM_PORT_FRAME_SIZE];
+  TickType_t last = xTaskGetTickCount();
+  while (true) {
+    uint32_t period_ms = (uint32_t)cfg_get_int(p->cfg, p->period_id);
+    vTaskDelayUntil(&last, pdMS_TO_TICKS(period_ms));
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    bool key;
+    size_t len = tm_encode(p->tm, now_ms, buf, sizeof(buf), &key);
+    tm_set(p->tm, p->encode_cycles_id, (int32_t)(esp_cpu_get_cycle_count() - start));
+
+    if (key) {
+      // 受け取る側が途中から聞き始めても名前が分かるように、TM_FRAME_KEYの前に説明を送る
+      static uint8_t desc[TM_PORT_FRAME_SIZE];
+      int next = 0;
+      while (next < p->tm->num) {
+        size_t n = tm_encode_desc(p->tm, now_ms, next, desc, sizeof(desc), &next);
+        if (n == 0 || !send_frame(p, desc, n)) {
+          break;
+        }
+      }
+    }
+    send_frame(p, buf, len);
+  }
+}
+
+esp_err_t tm_port_start(tm_port_t *p, tm_t *tm, const char *host, uint16_t port,
+  const cfg_store_t *cfg, int period_id, UBaseType_t priority){
+  memset(p, 0, sizeof(*p));
+  p->tm = tm;
+  p->cfg = cfg;
+  p->period_id = period_id;
+  p->frames_id = tm_register(tm, "tm_frames", TM_COUNTER, 0, NULL, 0);
+  p->bytes_id = tm_register(tm, "tm_bytes", TM_COUNTER, 0, NULL, 0);
+  p->errors_id = tm_register(tm, "tm_errors", TM_COUNTER, 0, NULL, 0);
+  p->encode_cycles_id = tm_register(tm, "tm_encode_cycles", TM_GAUGE, 0, NULL, 0);
+  if (p->frames_id < 0 || p->bytes_id < 0 || p->errors_id < 0 || p->encode_cycles_id < 0) {
+    ESP_LOGE(TAG, "too many metrics");
+    return ESP_ERR_NO_MEM;
+  }
+
+  p->addr.sin_family = AF_INET;
+  p->addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &p->addr.sin_addr) != 1) {
+    ESP_LOGE(TAG, "invalid address: %s", host);
+    return ESP_ERR_INVALID_ARG;
+  }
+  p->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (p->sock < 0) {
+    ESP_LOGE(TAG, "socket failed: errno %d", errno);
+    return ESP_FAIL;
+  }
+  if (xTaskCreate(tm_port_task, "telemetry", 4096, p, priority, &p->task) != pdPASS) {
+    close(p->sock);
+    return ESP_ERR_NO_MEM;
+  }
+  ESP_LOGI(TAG, "sending to %s:%u", host, port);
+  return ESP_OK;
+}
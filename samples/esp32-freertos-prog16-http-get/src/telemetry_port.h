@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "lwip/sockets.h"
+#include "telemetry.h"
+#include "config_store.h"
+
+// テレメトリをUDPで送る(ESP-IDF部分)
+// 送る間隔は設定ストアから毎回読む(実行中に変えられる)。TM_FRAME_KEYの前には説明のフレームも送る
+// 送った数、バイト数、tm_encodeにかかったCPUサイクルも自分のメトリクスとして送る
+// 受け取る側はserver/telemetry_collector.py
+// メトリクスはtm_port_start()の前に全部登録しておく(tm_registerはタスクが動いている間は呼ばない)
+// Wi-Fiに繋がる前に始めてもよい(送れなかった分はudp_errorsに数え、差分は次のフレームに溜まる)
+
+#define TM_PORT_FRAME_SIZE 512     // 1つのUDPデータグラム(MTUより小さく)
+
+typedef struct {
+  tm_t *tm;
+  const cfg_store_t *cfg;
+  int period_id;             // 設定ストアの送る間隔(ms)のid
+  int sock;
+  struct sockaddr_in addr;
+  TaskHandle_t task;
+  int frames_id;
+  int bytes_id;
+  int errors_id;
+  int encode_cycles_id;
+} tm_port_t;
+
+// host(IPv4のアドレス)のportに送るタスクを作る
+esp_err_t tm_port_start(tm_port_t *p, tm_t *tm, const char *host, uint16_t port,
+  const cfg_store_t *cfg, int period_id, UBaseType_t priority);
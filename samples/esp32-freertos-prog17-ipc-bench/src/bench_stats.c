@@ -0,0 +1,58 @@
+#include "bench_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int compare_u32(const void *a, const void *b){
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// 最近傍順位法、p=0-100
+static uint32_t percentile(const uint32_t *sorted, uint32_t n, uint32_t p){
+  uint32_t rank = (n * p + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void bench_stats_calc(uint32_t *samples, uint32_t n, bench_stats_t *stats){
+  memset(stats, 0, sizeof(*stats));
+  if (n == 0) {
+    return;
+  }
+  qsort(samples, n, sizeof(uint32_t), compare_u32);
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    sum += samples[i];
+  }
+  stats->n = n;
+  stats->min_ns = samples[0];
+  stats->max_ns = samples[n - 1];
+  stats->avg_ns = (uint32_t)(sum / n);
+  stats->p50_ns = percentile(samples, n, 50);
+  stats->p99_ns = percentile(samples, n, 99);
+}
+
+void bench_stats_from_total(uint64_t total_ns, uint32_t n, bench_stats_t *stats){
+  memset(stats, 0, sizeof(*stats));
+  if (n == 0) {
+    return;
+  }
+  stats->n = n;
+  stats->avg_ns = (uint32_t)(total_ns / n);
+  stats->min_ns = stats->avg_ns;
+  stats->p50_ns = stats->avg_ns;
+  stats->p99_ns = stats->avg_ns;
+  stats->max_ns = stats->avg_ns;
+}
+
+int bench_format(char *buf, size_t len, const bench_result_t *r){
+  const bench_stats_t *s = &r->stats;
+  int n = snprintf(buf, len,
+    BENCH_LINE_PREFIX "{\"primitive\":\"%s\",\"path\":\"%s\",\"cores\":\"%s\",\"metric\":\"%s\",\"n\":%u,"
+    "\"min_ns\":%u,\"avg_ns\":%u,\"p50_ns\":%u,\"p99_ns\":%u,\"max_ns\":%u,\"ops_per_s\":%u}",
+    r->primitive, r->path, r->cores, r->metric, (unsigned)s->n,
+    (unsigned)s->min_ns, (unsigned)s->avg_ns, (unsigned)s->p50_ns, (unsigned)s->p99_ns, (unsigned)s->max_ns,
+    (unsigned)r->ops_per_s);
+  return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ベンチマーク結果の集計と出力（ロジック部分）
+// 1回毎の計測値(ns)を渡すと最小/平均/中央値/99%点/最大を計算し、1行のJSONにする
+// ESP-IDFに依存しないので、ホストでも同じ形式のレポートが作れる
+//
+// 出力形式(シリアルに1結果1行、tools/bench_report.pyで集める)
+//   BENCH {"primitive":"queue","path":"task-task","cores":"cross","metric":"round_trip","n":1000,
+//          "min_ns":..,"avg_ns":..,"p50_ns":..,"p99_ns":..,"max_ns":..,"ops_per_s":..}
+
+#define BENCH_LINE_PREFIX "BENCH "
+
+typedef struct {
+  uint32_t n;
+  uint32_t min_ns;
+  uint32_t avg_ns;
+  uint32_t p50_ns;
+  uint32_t p99_ns;
+  uint32_t max_ns;
+} bench_stats_t;
+
+typedef struct {
+  const char *primitive; // notify, queue, semaphore, event_group, critical, mutex
+  const char *path;      // task-task, isr-task
+  const char *cores;     // same, cross
+  const char *metric;    // round_trip, throughput, latency, lock
+  bench_stats_t stats;
+  uint32_t ops_per_s;    // スループット、計算しない項目は0
+} bench_result_t;
+
+// samplesを昇順に並べ替えて集計する
+void bench_stats_calc(uint32_t *samples, uint32_t n, bench_stats_t *stats);
+// 全体の時間だけわかる場合(1回毎に計れないスループットなど)
+void bench_stats_from_total(uint64_t total_ns, uint32_t n, bench_stats_t *stats);
+
+// 1行分(プレフィックス付き、改行なし)をbufに書く。書いた文字数、バッファ不足なら-1
+int bench_format(char *buf, size_t len, const bench_result_t *result);
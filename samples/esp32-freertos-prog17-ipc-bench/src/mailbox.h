@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// タスク通知のメールボックス
+// 1つのタスクに通知の配列(xTaskNotifyIndexed)を使って独立したチャネルを持たせる。チャネル毎に種類を決めておく
+//   MAILBOX_COUNT : 回数(eIncrement)。受け取る毎に1減らすので、続けて送っても数は失われない。valueは残りの回数(今回の分を含む)
+//   MAILBOX_VALUE : 最新の値(eSetValueWithOverwrite)。受け取る前に送られたら上書き
+//   MAILBOX_BITS  : ビット(eSetBits)。受け取るとまとめて返して0にする
+//
+// インデックス0は使わない(ulTaskNotifyTake/xTaskNotifyGive、ストリームバッファ、ドライバが使う)
+// チャネルcはインデックスc+1。CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES-1個まで
+//
+// メールボックスは静的な表から取る(mallocしない)。グローバルのTaskHandle_tの代わりに名前で探す
+//   受け取るタスク: mb = mailbox_register("app", kinds, n); mailbox_bind(mb, NULL); mailbox_wait(mb, ch, &v, timeout);
+//   送るタスク、割込み: mailbox_post(mailbox_find("app"), ch, v);
+// bindする前に送ったものは捨てて数える(作ったタスクのハンドルを待つ必要はない)
+// 1つのタスクが同時に待てるのは1チャネルだけ。いくつかの要因をまとめて待つならMAILBOX_BITSを使う
+//
+// prog5とprog17(キュー、インデックス0の通知とのベンチマーク)に同じファイルがある。変えるときは両方
+
+#define MAILBOX_FIRST_INDEX  1
+#define MAILBOX_MAX_CHANNELS (configTASK_NOTIFICATION_ARRAY_ENTRIES - MAILBOX_FIRST_INDEX)
+#define MAILBOX_MAX          8
+
+#if MAILBOX_MAX_CHANNELS < 1
+#error "CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES must be 2 or more"
+#endif
+
+typedef enum {
+  MAILBOX_COUNT,
+  MAILBOX_VALUE,
+  MAILBOX_BITS,
+} mailbox_kind_t;
+
+typedef struct {
+  const char *name;                           // NULLなら空き
+  TaskHandle_t owner;                         // bindするまでNULL
+  int num_channels;
+  mailbox_kind_t kinds[MAILBOX_MAX_CHANNELS];
+  uint32_t posted;                            // 複数のタスクと割込みから送るので、アトミックに数える
+  uint32_t dropped;                           // bind前、範囲外のチャネルに送った数
+} mailbox_t;
+
+// 表から取る。同じ名前がある、表がいっぱい、チャネルが多すぎるときはNULL
+mailbox_t *mailbox_register(const char *name, const mailbox_kind_t *kinds, int num_channels);
+// 表に戻す。受け取るタスクを消す前に呼ぶ
+void mailbox_unregister(mailbox_t *mb);
+// 受け取るタスクを決めて、そのタスクのチャネルを空にする(taskがNULLなら呼んだタスク)
+void mailbox_bind(mailbox_t *mb, TaskHandle_t task);
+mailbox_t *mailbox_find(const char *name);
+
+// 送る。bindされていない、チャネルが範囲外ならfalse
+bool mailbox_post(mailbox_t *mb, int channel, uint32_t value);
+bool mailbox_post_from_isr(mailbox_t *mb, int channel, uint32_t value, BaseType_t *woken);
+
+// 受け取るタスクから呼ぶ。届いていればtrueでvalueに入れる(COUNTは残りの回数、VALUEは値、BITSはビット)
+bool mailbox_wait(mailbox_t *mb, int channel, uint32_t *value, TickType_t timeout);
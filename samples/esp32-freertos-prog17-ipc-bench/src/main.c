@@ -0,0 +1,494 @@
+#include <stdio.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include "sdkconfig.h"
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#include "esp_log.h"
+#include "driver/gptimer.h"
+#include "bench_stats.h"
+#include "mailbox.h"
+
+// FreeRTOSのIPC(タスク通知、キュー、セマフォ、イベントグループ、クリティカルセクション、ミューテックス)のベンチマーク
+// mailbox(通知の配列のインデックス1、mailbox.h)も比べる。mailboxは回数、mailbox_valueは最新の値(キューの代わり)
+// サンプルで使っている経路毎に、どれが速いか比べるためのもの
+//
+//   round_trip : タスクA→タスクB→タスクAの往復時間(送信側のCPUサイクルで計る)
+//   throughput : タスクA→タスクBに一方的に送り続けたときの件数/秒
+//   latency    : gptimerの割込み→タスクが起きるまで(gptimerのカウント値で計るのでコアをまたいでも計れる)
+//   lock       : 2タスクで共有カウンタを排他して増やしたときの1回あたりの時間
+//
+// コアは same(両方PRO_CPU) と cross(相手がAPP_CPU) の2通り
+// 結果はBENCHで始まる1行JSONでシリアルに出す
+// > pio device monitor | python tools/bench_report.py --out report.json
+// ホストでは
+// > sim_prog17 --clock real --duration 20000 | python tools/bench_report.py --out report.json
+// (ホストは1コアなのでcrossも実際には同じコア、値は傾向を見る程度)
+
+#define TAG "ipc_bench"
+
+#define BENCH_ROUNDS         1000    // round_trip, latencyの計測回数
+#define BENCH_WARMUP         10      // 最初の数回は捨てる(キャッシュ、初回のスタック確保など)
+#define BENCH_STREAM_OPS     10000   // throughputの件数
+#define BENCH_LOCK_OPS       20000   // lockの1タスクあたりの回数
+#define BENCH_ISR_ROUNDS     500
+#define BENCH_ISR_PERIOD_US  1000
+#define BENCH_TIMER_HZ       10000000 // gptimerの分解能 10MHz = 100ns
+#define BENCH_QUEUE_DEPTH    8
+#define BENCH_PRIORITY       (configMAX_PRIORITIES - 3)
+#define BENCH_STACK_SIZE     4096
+
+typedef enum {
+  PRIM_NOTIFY,
+  PRIM_QUEUE,
+  PRIM_SEMAPHORE,
+  PRIM_EVENT_GROUP,
+  PRIM_MAILBOX,
+  PRIM_MAILBOX_VALUE,
+  PRIM_NUM,
+} prim_t;
+
+static const char *prim_names[PRIM_NUM] = {
+  [PRIM_NOTIFY] = "notify",
+  [PRIM_QUEUE] = "queue",
+  [PRIM_SEMAPHORE] = "semaphore",
+  [PRIM_EVENT_GROUP] = "event_group",
+  [PRIM_MAILBOX] = "mailbox",
+  [PRIM_MAILBOX_VALUE] = "mailbox_value",
+};
+
+#define CHANNEL_BIT (1 << 0)
+
+// 1方向の通信路
+// どのプリミティブも「1件送る」「1件受け取る(来るまで待つ)」として扱う
+// notifyとsemaphoreはカウントとして使う(受け取り毎に1減らす)
+// event_groupはビットなので、受け取る前に2回送ると1件になる(throughputは計らない)
+// mailbox_valueも上書きなので同じ
+typedef struct {
+  prim_t prim;
+  TaskHandle_t receiver;
+  QueueHandle_t queue;
+  SemaphoreHandle_t sem;
+  EventGroupHandle_t group;
+  mailbox_t *mailbox;
+} channel_t;
+
+// 1つの計測で使う通信路は2つまで
+static const char *mailbox_names[] = {"bench0", "bench1"};
+
+static bool has_throughput(prim_t prim){
+  return prim != PRIM_EVENT_GROUP && prim != PRIM_MAILBOX_VALUE;
+}
+
+static void channel_create(channel_t *ch, prim_t prim){
+  memset(ch, 0, sizeof(*ch));
+  ch->prim = prim;
+  switch (prim) {
+  case PRIM_QUEUE:
+    ch->queue = xQueueCreate(BENCH_QUEUE_DEPTH, sizeof(uint32_t));
+    break;
+  case PRIM_SEMAPHORE:
+    ch->sem = xSemaphoreCreateCounting(BENCH_STREAM_OPS, 0);
+    break;
+  case PRIM_EVENT_GROUP:
+    ch->group = xEventGroupCreate();
+    break;
+  case PRIM_MAILBOX:
+  case PRIM_MAILBOX_VALUE: {
+    mailbox_kind_t kind = prim == PRIM_MAILBOX ? MAILBOX_COUNT : MAILBOX_VALUE;
+    for (int i = 0; i < 2 && ch->mailbox == NULL; i++) {
+      ch->mailbox = mailbox_register(mailbox_names[i], &kind, 1);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// 受け取るタスクが決まってから送り始める(mailboxはbindする前に送ると捨てる)
+static void channel_set_receiver(channel_t *ch, TaskHandle_t receiver){
+  ch->receiver = receiver;
+  if (ch->mailbox) {
+    mailbox_bind(ch->mailbox, receiver);
+  }
+}
+
+static void channel_delete(channel_t *ch){
+  if (ch->queue) {
+    vQueueDelete(ch->queue);
+  }
+  if (ch->sem) {
+    vSemaphoreDelete(ch->sem);
+  }
+  if (ch->group) {
+    vEventGroupDelete(ch->group);
+  }
+  if (ch->mailbox) {
+    mailbox_unregister(ch->mailbox);
+  }
+  memset(ch, 0, sizeof(*ch));
+}
+
+static void channel_send(channel_t *ch, uint32_t value){
+  switch (ch->prim) {
+  case PRIM_NOTIFY:
+    xTaskNotifyGive(ch->receiver);
+    break;
+  case PRIM_QUEUE:
+    xQueueSend(ch->queue, &value, portMAX_DELAY);
+    break;
+  case PRIM_SEMAPHORE:
+    xSemaphoreGive(ch->sem);
+    break;
+  case PRIM_EVENT_GROUP:
+    xEventGroupSetBits(ch->group, CHANNEL_BIT);
+    break;
+  case PRIM_MAILBOX:
+  case PRIM_MAILBOX_VALUE:
+    mailbox_post(ch->mailbox, 0, value);
+    break;
+  default:
+    break;
+  }
+}
+
+static void channel_receive(channel_t *ch){
+  uint32_t value;
+  switch (ch->prim) {
+  case PRIM_NOTIFY:
+    ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    break;
+  case PRIM_QUEUE:
+    xQueueReceive(ch->queue, &value, portMAX_DELAY);
+    break;
+  case PRIM_SEMAPHORE:
+    xSemaphoreTake(ch->sem, portMAX_DELAY);
+    break;
+  case PRIM_EVENT_GROUP:
+    xEventGroupWaitBits(ch->group, CHANNEL_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+    break;
+  case PRIM_MAILBOX:
+  case PRIM_MAILBOX_VALUE:
+    mailbox_wait(ch->mailbox, 0, &value, portMAX_DELAY);
+    break;
+  default:
+    break;
+  }
+}
+
+// event_groupのFromISRはタイマータスク経由(xTimerPendFunctionCallFromISR)になる
+static bool IRAM_ATTR channel_send_from_isr(channel_t *ch){
+  BaseType_t woken = pdFALSE;
+  uint32_t value = 0;
+  switch (ch->prim) {
+  case PRIM_NOTIFY:
+    vTaskNotifyGiveFromISR(ch->receiver, &woken);
+    break;
+  case PRIM_QUEUE:
+    xQueueSendFromISR(ch->queue, &value, &woken);
+    break;
+  case PRIM_SEMAPHORE:
+    xSemaphoreGiveFromISR(ch->sem, &woken);
+    break;
+  case PRIM_EVENT_GROUP:
+    xEventGroupSetBitsFromISR(ch->group, CHANNEL_BIT, &woken);
+    break;
+  case PRIM_MAILBOX:
+  case PRIM_MAILBOX_VALUE:
+    mailbox_post_from_isr(ch->mailbox, 0, value, &woken);
+    break;
+  default:
+    break;
+  }
+  return woken == pdTRUE;
+}
+
+//------------------------
+// 計測の共通部分
+//------------------------
+static uint32_t samples[BENCH_ROUNDS];
+static SemaphoreHandle_t done_sem;
+static char line[256];
+
+static inline uint32_t cycles_to_ns(uint32_t cycles){
+  return (uint32_t)((uint64_t)cycles * 1000 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+}
+
+static void report(const char *primitive, const char *path, int core, const char *metric,
+  const bench_stats_t *stats, uint32_t ops_per_s){
+  bench_result_t result = {
+    .primitive = primitive,
+    .path = path,
+    .cores = core == PRO_CPU_NUM ? "same" : "cross",
+    .metric = metric,
+    .stats = *stats,
+    .ops_per_s = ops_per_s,
+  };
+  if (bench_format(line, sizeof(line), &result) > 0) {
+    printf("%s\n", line);
+  }
+}
+
+// 相手のタスクを作る。計測するのは常にPRO_CPUのbench_task
+static TaskHandle_t start_peer(TaskFunction_t fn, const char *name, void *arg, UBaseType_t priority, int core){
+  TaskHandle_t handle = NULL;
+  xTaskCreatePinnedToCore(fn, name, BENCH_STACK_SIZE, arg, priority, &handle, core);
+  return handle;
+}
+
+//------------------------
+// round_trip
+//------------------------
+typedef struct {
+  channel_t to_peer;
+  channel_t to_bench;
+  uint32_t rounds;
+} round_trip_ctx_t;
+
+static void round_trip_peer(void *pvParameters){
+  round_trip_ctx_t *ctx = (round_trip_ctx_t *)pvParameters;
+  for (uint32_t i = 0; i < ctx->rounds; i++) {
+    channel_receive(&ctx->to_peer);
+    channel_send(&ctx->to_bench, i);
+  }
+  xSemaphoreGive(done_sem);
+  vTaskDelete(NULL);
+}
+
+static void bench_round_trip(prim_t prim, int core){
+  round_trip_ctx_t ctx;
+  channel_create(&ctx.to_peer, prim);
+  channel_create(&ctx.to_bench, prim);
+  ctx.rounds = BENCH_WARMUP + BENCH_ROUNDS;
+  channel_set_receiver(&ctx.to_bench, xTaskGetCurrentTaskHandle());
+  channel_set_receiver(&ctx.to_peer, start_peer(round_trip_peer, "rt_peer", &ctx, BENCH_PRIORITY, core));
+
+  for (uint32_t i = 0; i < ctx.rounds; i++) {
+    uint32_t start = esp_cpu_get_cycle_count();
+    channel_send(&ctx.to_peer, i);
+    channel_receive(&ctx.to_bench);
+    uint32_t end = esp_cpu_get_cycle_count();
+    if (i >= BENCH_WARMUP) {
+      samples[i - BENCH_WARMUP] = cycles_to_ns(end - start);
+    }
+  }
+  xSemaphoreTake(done_sem, portMAX_DELAY);
+
+  bench_stats_t stats;
+  bench_stats_calc(samples, BENCH_ROUNDS, &stats);
+  report(prim_names[prim], "task-task", core, "round_trip", &stats, 0);
+  channel_delete(&ctx.to_peer);
+  channel_delete(&ctx.to_bench);
+}
+
+//------------------------
+// throughput
+//------------------------
+static void stream_peer(void *pvParameters){
+  channel_t *ch = (channel_t *)pvParameters;
+  for (uint32_t i = 0; i < BENCH_STREAM_OPS; i++) {
+    channel_receive(ch);
+  }
+  xSemaphoreGive(done_sem);
+  vTaskDelete(NULL);
+}
+
+static void bench_throughput(prim_t prim, int core){
+  channel_t ch;
+  channel_create(&ch, prim);
+  // 受信側を1つ低い優先度にして、送信側が詰まるまで送れるようにする(キュー以外は詰まらない)
+  channel_set_receiver(&ch, start_peer(stream_peer, "tp_peer", &ch, BENCH_PRIORITY - 1, core));
+
+  int64_t start = esp_timer_get_time();
+  for (uint32_t i = 0; i < BENCH_STREAM_OPS; i++) {
+    channel_send(&ch, i);
+  }
+  xSemaphoreTake(done_sem, portMAX_DELAY);
+  int64_t elapsed_us = esp_timer_get_time() - start;
+
+  bench_stats_t stats;
+  bench_stats_from_total((uint64_t)elapsed_us * 1000, BENCH_STREAM_OPS, &stats);
+  uint32_t ops_per_s = elapsed_us > 0 ? (uint32_t)((uint64_t)BENCH_STREAM_OPS * 1000000 / elapsed_us) : 0;
+  report(prim_names[prim], "task-task", core, "throughput", &stats, ops_per_s);
+  channel_delete(&ch);
+}
+
+//------------------------
+// latency (ISR→タスク)
+//------------------------
+// gptimerを周期BENCH_ISR_PERIOD_USの自動リロードで動かし、アラームの割込みで送る
+// リロードでカウントが0に戻るので、タスクが起きたときのカウント値がそのまま割込みからの経過時間になる
+typedef struct {
+  channel_t ch;
+  gptimer_handle_t timer;
+} isr_ctx_t;
+
+static bool IRAM_ATTR latency_alarm_callback(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx){
+  isr_ctx_t *ctx = (isr_ctx_t *)user_ctx;
+  return channel_send_from_isr(&ctx->ch);
+}
+
+static void latency_peer(void *pvParameters){
+  isr_ctx_t *ctx = (isr_ctx_t *)pvParameters;
+  for (uint32_t i = 0; i < BENCH_WARMUP + BENCH_ISR_ROUNDS; i++) {
+    channel_receive(&ctx->ch);
+    uint64_t count = 0;
+    gptimer_get_raw_count(ctx->timer, &count);
+    if (i >= BENCH_WARMUP) {
+      samples[i - BENCH_WARMUP] = (uint32_t)(count * (1000000000 / BENCH_TIMER_HZ));
+    }
+  }
+  xSemaphoreGive(done_sem);
+  vTaskDelete(NULL);
+}
+
+static void bench_isr_latency(prim_t prim, int core){
+  isr_ctx_t ctx = {0};
+  channel_create(&ctx.ch, prim);
+
+  // 割込みはコールバックを登録したコア(PRO_CPU)に割り当てられる
+  gptimer_config_t timer_config = {
+    .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+    .direction = GPTIMER_COUNT_UP,
+    .resolution_hz = BENCH_TIMER_HZ,
+  };
+  ESP_ERROR_CHECK(gptimer_new_timer(&timer_config, &ctx.timer));
+  gptimer_alarm_config_t alarm_config = {
+    .reload_count = 0,
+    .alarm_count = (uint64_t)BENCH_TIMER_HZ / 1000000 * BENCH_ISR_PERIOD_US,
+    .flags.auto_reload_on_alarm = true,
+  };
+  gptimer_event_callbacks_t callback = {
+    .on_alarm = latency_alarm_callback,
+  };
+  ESP_ERROR_CHECK(gptimer_register_event_callbacks(ctx.timer, &callback, &ctx));
+  ESP_ERROR_CHECK(gptimer_set_alarm_action(ctx.timer, &alarm_config));
+  ESP_ERROR_CHECK(gptimer_enable(ctx.timer));
+
+  // 待つタスクはbench_taskより高い優先度にする(同じコアでもすぐ切り替わるように)
+  channel_set_receiver(&ctx.ch, start_peer(latency_peer, "lat_peer", &ctx, BENCH_PRIORITY + 1, core));
+  ESP_ERROR_CHECK(gptimer_start(ctx.timer));
+  xSemaphoreTake(done_sem, portMAX_DELAY);
+  ESP_ERROR_CHECK(gptimer_stop(ctx.timer));
+  ESP_ERROR_CHECK(gptimer_disable(ctx.timer));
+  ESP_ERROR_CHECK(gptimer_del_timer(ctx.timer));
+
+  bench_stats_t stats;
+  bench_stats_calc(samples, BENCH_ISR_ROUNDS, &stats);
+  report(prim_names[prim], "isr-task", core, "latency", &stats, 0);
+  channel_delete(&ctx.ch);
+}
+
+//------------------------
+// lock (クリティカルセクション、ミューテックス)
+//------------------------
+typedef enum {
+  LOCK_CRITICAL,
+  LOCK_MUTEX,
+} lock_kind_t;
+
+typedef struct {
+  lock_kind_t kind;
+  portMUX_TYPE mux;
+  SemaphoreHandle_t mutex;
+  EventGroupHandle_t start;
+  volatile uint32_t counter;
+} lock_ctx_t;
+
+static void lock_worker(void *pvParameters){
+  lock_ctx_t *ctx = (lock_ctx_t *)pvParameters;
+  xEventGroupWaitBits(ctx->start, CHANNEL_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+  for (uint32_t i = 0; i < BENCH_LOCK_OPS; i++) {
+    if (ctx->kind == LOCK_CRITICAL) {
+      taskENTER_CRITICAL(&ctx->mux);
+      ctx->counter++;
+      taskEXIT_CRITICAL(&ctx->mux);
+    } else {
+      xSemaphoreTake(ctx->mutex, portMAX_DELAY);
+      ctx->counter++;
+      xSemaphoreGive(ctx->mutex);
+    }
+  }
+  xSemaphoreGive(done_sem);
+  vTaskDelete(NULL);
+}
+
+static void bench_lock(lock_kind_t kind, int core){
+  lock_ctx_t ctx = {
+    .kind = kind,
+    .mutex = xSemaphoreCreateMutex(),
+    .start = xEventGroupCreate(),
+    .counter = 0,
+  };
+  portMUX_INITIALIZE(&ctx.mux);
+  // 2つとも同じ優先度、sameならPRO_CPUで時分割、crossなら両コアで取り合う
+  start_peer(lock_worker, "lock_a", &ctx, BENCH_PRIORITY - 1, PRO_CPU_NUM);
+  start_peer(lock_worker, "lock_b", &ctx, BENCH_PRIORITY - 1, core);
+
+  int64_t start = esp_timer_get_time();
+  xEventGroupSetBits(ctx.start, CHANNEL_BIT);
+  xSemaphoreTake(done_sem, portMAX_DELAY);
+  xSemaphoreTake(done_sem, portMAX_DELAY);
+  int64_t elapsed_us = esp_timer_get_time() - start;
+
+  if (ctx.counter != BENCH_LOCK_OPS * 2) {
+    ESP_LOGE(TAG, "lock counter mismatch %lu", (unsigned long)ctx.counter);
+  }
+  bench_stats_t stats;
+  bench_stats_from_total((uint64_t)elapsed_us * 1000, BENCH_LOCK_OPS * 2, &stats);
+  uint32_t ops_per_s = elapsed_us > 0 ? (uint32_t)((uint64_t)BENCH_LOCK_OPS * 2 * 1000000 / elapsed_us) : 0;
+  report(kind == LOCK_CRITICAL ? "critical" : "mutex", "task-task", core, "lock", &stats, ops_per_s);
+  vSemaphoreDelete(ctx.mutex);
+  vEventGroupDelete(ctx.start);
+}
+
+//------------------------
+// 実行
+//------------------------
+static void bench_task(void *pvParameters){
+  static const int cores[] = {PRO_CPU_NUM, APP_CPU_NUM};
+  done_sem = xSemaphoreCreateCounting(2, 0);
+
+#if CONFIG_SIM_HOST
+  const char *target = "host";
+#else
+  const char *target = CONFIG_IDF_TARGET;
+#endif
+  printf("BENCH_BEGIN {\"target\":\"%s\",\"cpu_mhz\":%d,\"tick_hz\":%d}\n", target, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, CONFIG_FREERTOS_HZ);
+
+  for (int c = 0; c < 2; c++) {
+    int core = cores[c];
+    for (int prim = 0; prim < PRIM_NUM; prim++) {
+      bench_round_trip(prim, core);
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    for (int prim = 0; prim < PRIM_NUM; prim++) {
+      if (!has_throughput(prim)) {
+        continue;
+      }
+      bench_throughput(prim, core);
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    for (int prim = 0; prim < PRIM_NUM; prim++) {
+      bench_isr_latency(prim, core);
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    bench_lock(LOCK_CRITICAL, core);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    bench_lock(LOCK_MUTEX, core);
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  printf("BENCH_END\n");
+  vTaskDelete(NULL);
+}
+
+void app_main(){
+  ESP_LOGI(TAG, "app_main start ===>");
+  xTaskCreatePinnedToCore(bench_task, "bench_task", BENCH_STACK_SIZE, NULL, BENCH_PRIORITY, NULL, PRO_CPU_NUM);
+  ESP_LOGI(TAG, "<=== app_main end");
+}
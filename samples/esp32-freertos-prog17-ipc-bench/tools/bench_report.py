@@ -0,0 +1,109 @@
+import json
+import sys
+
+# prog17のシリアル出力(BENCHで始まる行)を集めて、レポート(JSON)と比較表を作る
+#
+# > pio device monitor | python tools/bench_report.py --out report.json
+# > python tools/bench_report.py log.txt --out report.json
+# > python tools/bench_report.py log.txt --baseline baseline.json --tolerance 20
+#
+# BENCH_ENDを受け取ったら終了する
+# --baselineを指定すると、同じ項目のavg_nsとp99_nsが tolerance[%] 以上悪化していたら終了コード1にする
+# (throughputとlockはops_per_sの低下で判定する)
+
+PREFIX = "BENCH "
+BEGIN = "BENCH_BEGIN "
+END = "BENCH_END"
+
+
+def parse_args(argv):
+    args = {"input": None, "out": None, "baseline": None, "tolerance": 20.0}
+    i = 0
+    while i < len(argv):
+        a = argv[i]
+        if a in ("--out", "--baseline", "--tolerance") and i + 1 < len(argv):
+            args[a[2:]] = float(argv[i + 1]) if a == "--tolerance" else argv[i + 1]
+            i += 2
+        else:
+            args["input"] = a
+            i += 1
+    return args
+
+
+def read_report(stream):
+    report = {"meta": {}, "results": []}
+    for line in stream:
+        # モニタの出力にはログの色やタイムスタンプが付くことがあるので、行の途中から探す
+        line = line.strip()
+        if BEGIN in line:
+            report["meta"] = json.loads(line[line.index(BEGIN) + len(BEGIN):])
+        elif PREFIX in line:
+            report["results"].append(json.loads(line[line.index(PREFIX) + len(PREFIX):]))
+        elif END in line:
+            break
+    return report
+
+
+def key_of(r):
+    return (r["path"], r["cores"], r["metric"], r["primitive"])
+
+
+def print_table(report):
+    groups = {}
+    for r in report["results"]:
+        groups.setdefault((r["path"], r["cores"], r["metric"]), []).append(r)
+    meta = report["meta"]
+    print("target=%s cpu=%sMHz tick=%sHz" % (meta.get("target", "?"), meta.get("cpu_mhz", "?"), meta.get("tick_hz", "?")))
+    print("%-10s %-6s %-11s %-12s %10s %10s %10s %10s %12s" % ("path", "cores", "metric", "primitive", "min_ns", "p50_ns", "p99_ns", "max_ns", "ops_per_s"))
+    for group, results in sorted(groups.items()):
+        best = min(results, key=lambda r: r["avg_ns"])
+        for r in sorted(results, key=lambda r: r["avg_ns"]):
+            print("%-10s %-6s %-11s %-12s %10d %10d %10d %10d %12d %s" % (
+                group[0], group[1], group[2], r["primitive"],
+                r["min_ns"], r["p50_ns"], r["p99_ns"], r["max_ns"], r["ops_per_s"],
+                "*" if r is best else ""))
+
+
+def compare(report, baseline, tolerance):
+    base = {key_of(r): r for r in baseline["results"]}
+    ok = True
+    for r in report["results"]:
+        b = base.get(key_of(r))
+        if b is None:
+            continue
+        if r["metric"] in ("throughput", "lock"):
+            checks = [("ops_per_s", b["ops_per_s"], r["ops_per_s"], b["ops_per_s"] * (1 - tolerance / 100))]
+            worse = [c for c in checks if c[2] < c[3]]
+        else:
+            checks = [(m, b[m], r[m], b[m] * (1 + tolerance / 100)) for m in ("avg_ns", "p99_ns")]
+            worse = [c for c in checks if c[2] > c[3]]
+        for metric, before, after, _ in worse:
+            ok = False
+            print("REGRESSION %s %s %s %s %s: %d -> %d" % (r["path"], r["cores"], r["metric"], r["primitive"], metric, before, after))
+    return ok
+
+
+def main():
+    args = parse_args(sys.argv[1:])
+    if args["input"]:
+        with open(args["input"], errors="replace") as f:
+            report = read_report(f)
+    else:
+        report = read_report(sys.stdin)
+    if not report["results"]:
+        print("no BENCH lines")
+        return 2
+    if args["out"]:
+        with open(args["out"], "w") as f:
+            json.dump(report, f, indent=2)
+    print_table(report)
+    if args["baseline"]:
+        with open(args["baseline"]) as f:
+            baseline = json.load(f)
+        if not compare(report, baseline, args["tolerance"]):
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,81 @@
+#include "loop_stats.h"
+#include <string.h>
+
+static void value_reset(loop_stats_value_t *v){
+  v->count = 0;
+  v->min_ns = UINT32_MAX;
+  v->max_ns = 0;
+  v->sum_ns = 0;
+}
+
+static void value_add(loop_stats_value_t *v, uint32_t ns){
+  v->count++;
+  v->sum_ns += ns;
+  if (ns < v->min_ns) {
+    v->min_ns = ns;
+  }
+  if (ns > v->max_ns) {
+    v->max_ns = ns;
+  }
+}
+
+void loop_stats_init(loop_stats_t *stats, uint32_t period_ns, uint32_t budget_ns){
+  stats->period_ns = period_ns;
+  stats->budget_ns = budget_ns;
+  loop_stats_reset(stats);
+}
+
+void loop_stats_reset(loop_stats_t *stats){
+  value_reset(&stats->jitter);
+  value_reset(&stats->latency);
+  value_reset(&stats->exec);
+  stats->overruns = 0;
+  stats->missed = 0;
+  memset(stats->jitter_hist, 0, sizeof(stats->jitter_hist));
+}
+
+void loop_stats_add(loop_stats_t *stats, uint32_t interval_ns, uint32_t latency_ns, uint32_t exec_ns){
+  if (interval_ns != 0) {
+    uint32_t jitter = interval_ns > stats->period_ns ? interval_ns - stats->period_ns : stats->period_ns - interval_ns;
+    value_add(&stats->jitter, jitter);
+    uint32_t bin = jitter / 1000;
+    if (bin >= LOOP_STATS_HIST_BINS) {
+      bin = LOOP_STATS_HIST_BINS - 1;
+    }
+    if (stats->jitter_hist[bin] < UINT16_MAX) {
+      stats->jitter_hist[bin]++;
+    }
+  }
+  value_add(&stats->latency, latency_ns);
+  value_add(&stats->exec, exec_ns);
+  if (exec_ns > stats->budget_ns) {
+    stats->overruns++;
+  }
+}
+
+void loop_stats_add_missed(loop_stats_t *stats, uint32_t missed){
+  stats->missed += missed;
+}
+
+uint32_t loop_stats_avg_ns(const loop_stats_value_t *value){
+  return value->count ? (uint32_t)(value->sum_ns / value->count) : 0;
+}
+
+uint32_t loop_stats_jitter_p99_ns(const loop_stats_t *stats){
+  uint32_t total = 0;
+  for (int i = 0; i < LOOP_STATS_HIST_BINS; i++) {
+    total += stats->jitter_hist[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint32_t rank = (total * 99 + 99) / 100;
+  uint32_t seen = 0;
+  for (int i = 0; i < LOOP_STATS_HIST_BINS; i++) {
+    seen += stats->jitter_hist[i];
+    if (seen >= rank) {
+      return (uint32_t)(i + 1) * 1000;
+    }
+  }
+  return LOOP_STATS_HIST_BINS * 1000;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+
+// 制御ループの周期ジッタと実行時間の集計（ロジック部分）
+// 1周期毎にloop_stats_add()で
+//   interval : 前回の起床からの間隔
+//   latency  : タイマー割込みからタスクが起きるまで
+//   exec     : 制御計算の実行時間
+// を渡すと、最小/平均/最大と、ジッタの99%点(1us刻みのヒストグラム)、予算超過の回数を数える
+// ESP-IDFに依存しないので、ホストでも確認できる
+// スレッドセーフではないので、呼び出し側で排他すること
+
+#define LOOP_STATS_HIST_BINS 100   // ジッタのヒストグラム 0-99us、それ以上は最後のビン
+
+typedef struct {
+  uint32_t count;
+  uint32_t min_ns;
+  uint32_t max_ns;
+  uint64_t sum_ns;
+} loop_stats_value_t;
+
+typedef struct {
+  uint32_t period_ns;      // 設計上の周期
+  uint32_t budget_ns;      // 実行時間の予算
+  loop_stats_value_t jitter;   // |interval - period|
+  loop_stats_value_t latency;
+  loop_stats_value_t exec;
+  uint32_t overruns;       // execが予算を超えた回数
+  uint32_t missed;         // 起床が1周期以上遅れて通知をまとめて受け取った回数
+  uint16_t jitter_hist[LOOP_STATS_HIST_BINS];
+} loop_stats_t;
+
+void loop_stats_init(loop_stats_t *stats, uint32_t period_ns, uint32_t budget_ns);
+// 集計をクリアする(周期と予算はそのまま)
+void loop_stats_reset(loop_stats_t *stats);
+// interval_nsが0なら(最初の1回)ジッタは記録しない
+void loop_stats_add(loop_stats_t *stats, uint32_t interval_ns, uint32_t latency_ns, uint32_t exec_ns);
+void loop_stats_add_missed(loop_stats_t *stats, uint32_t missed);
+
+uint32_t loop_stats_avg_ns(const loop_stats_value_t *value);
+// ジッタの99%点[ns]、1us単位
+uint32_t loop_stats_jitter_p99_ns(const loop_stats_t *stats);
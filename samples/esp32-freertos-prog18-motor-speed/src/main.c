@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "sdkconfig.h"
+#include <esp_cpu.h>
+#include "esp_log.h"
+#include "driver/gptimer.h"
+#include "driver/pulse_cnt.h"
+#include "motor_ctrl.h"
+#include "motor_pwm_port.h"
+#include "loop_stats.h"
+
+// モーターの速度制御
+// prog15(PCNTでエンコーダを読む)とprog14(MCPWMでデューティを出す)をつないだもの
+//
+//   gptimer(CONTROL_HZ) --割込み--> control_task(APP_CPU)
+//     PCNTのカウント -> 回転数 -> FF + PID -> Hブリッジの相補PWM(motor_pwm_port.c)
+//
+// 制御周期は1～10kHz(CONTROL_HZ)、周期ジッタ、割込みからの遅れ、実行時間を1秒毎に出す
+// ホストでは stimulus/prog18.stim のDCモーターモデルで確認する
+// > sim_prog18 --duration 10000 --stimulus stimulus/prog18.stim --trace trace.csv
+
+#define TAG "motor"
+
+#define CONTROL_HZ          1000
+#define CONTROL_BUDGET_PCT  20         // 実行時間の予算(周期に対する%)
+#define TIMER_RESOLUTION_HZ 10000000   // gptimer 10MHz = 100ns、遅れの計測にも使う
+
+// Hブリッジ: レッグA(ハイサイド/ローサイド)、レッグB
+#define PWM_GPIO_A_HIGH     4
+#define PWM_GPIO_A_LOW      7
+#define PWM_GPIO_B_HIGH     15
+#define PWM_GPIO_B_LOW      16
+#define PWM_RESOLUTION_HZ   80000000   // 12.5ns、20kHzで片道2000tick(デューティの分解能0.05%)
+#define PWM_FREQ_HZ         20000      // 可聴域外
+#define PWM_DEAD_TIME_NS    200        // ゲートドライバとFETのターンオフ時間に合わせる
+
+#define ENCODER_GPIO_A      5
+#define ENCODER_GPIO_B      6
+#define ENCODER_CPR         400        // 100パルス/回転 x 4逓倍
+#define PCNT_LIMIT          30000
+
+#define SPEED_WINDOW        (CONTROL_HZ / 100)   // 10msの移動窓
+#define MAX_RPM             3000       // デューティ100%の無負荷回転数(フィードフォワード用)
+#define DUTY_PER_PERMILLE   ((double)MOTOR_PWM_DUTY_MAX / 1000)
+
+static TaskHandle_t control_task_handle;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static loop_stats_t loop_stats;
+
+static volatile int32_t setpoint_rpm = 0;
+static volatile int32_t measured_rpm = 0;
+static volatile int32_t output_duty = 0;
+
+static gptimer_handle_t control_timer;
+static pcnt_unit_handle_t pcnt_unit;
+static motor_pwm_t motor_pwm;
+
+//------------------------
+// 入出力の設定
+//------------------------
+static void setup_encoder(void){
+  pcnt_unit_config_t unit_config = {
+    .high_limit = PCNT_LIMIT,
+    .low_limit = -PCNT_LIMIT,
+  };
+  ESP_ERROR_CHECK(pcnt_new_unit(&unit_config, &pcnt_unit));
+  pcnt_glitch_filter_config_t filter_config = {
+    .max_glitch_ns = 1000,
+  };
+  ESP_ERROR_CHECK(pcnt_unit_set_glitch_filter(pcnt_unit, &filter_config));
+
+  // 4逓倍の直交デコード(prog15と同じ設定)
+  pcnt_chan_config_t chan_a_config = {
+    .edge_gpio_num = ENCODER_GPIO_A,
+    .level_gpio_num = ENCODER_GPIO_B,
+  };
+  pcnt_channel_handle_t pcnt_chan_a = NULL;
+  ESP_ERROR_CHECK(pcnt_new_channel(pcnt_unit, &chan_a_config, &pcnt_chan_a));
+  pcnt_chan_config_t chan_b_config = {
+    .edge_gpio_num = ENCODER_GPIO_B,
+    .level_gpio_num = ENCODER_GPIO_A,
+  };
+  pcnt_channel_handle_t pcnt_chan_b = NULL;
+  ESP_ERROR_CHECK(pcnt_new_channel(pcnt_unit, &chan_b_config, &pcnt_chan_b));
+  ESP_ERROR_CHECK(pcnt_channel_set_edge_action(pcnt_chan_a, PCNT_CHANNEL_EDGE_ACTION_DECREASE, PCNT_CHANNEL_EDGE_ACTION_INCREASE));
+  ESP_ERROR_CHECK(pcnt_channel_set_level_action(pcnt_chan_a, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
+  ESP_ERROR_CHECK(pcnt_channel_set_edge_action(pcnt_chan_b, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE));
+  ESP_ERROR_CHECK(pcnt_channel_set_level_action(pcnt_chan_b, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
+
+  ESP_ERROR_CHECK(pcnt_unit_enable(pcnt_unit));
+  ESP_ERROR_CHECK(pcnt_unit_clear_count(pcnt_unit));
+  ESP_ERROR_CHECK(pcnt_unit_start(pcnt_unit));
+}
+
+static void setup_pwm(void){
+  motor_pwm_config_t config = {
+    .group_id = 0,
+    .resolution_hz = PWM_RESOLUTION_HZ,
+    .freq_hz = PWM_FREQ_HZ,
+    .dead_time_ns = PWM_DEAD_TIME_NS,
+    .num_legs = 2,
+    .legs = {
+      {PWM_GPIO_A_HIGH, PWM_GPIO_A_LOW},
+      {PWM_GPIO_B_HIGH, PWM_GPIO_B_LOW},
+    },
+  };
+  ESP_ERROR_CHECK(motor_pwm_init(&motor_pwm, &config));
+  motor_pwm_start(&motor_pwm);
+}
+
+// 周期の割込みで制御タスクを起こすだけ
+static bool IRAM_ATTR control_timer_callback(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx){
+  BaseType_t high_task_wakeup = pdFALSE;
+  vTaskNotifyGiveFromISR(control_task_handle, &high_task_wakeup);
+  return high_task_wakeup == pdTRUE;
+}
+
+static void setup_control_timer(void){
+  gptimer_config_t timer_config = {
+    .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+    .direction = GPTIMER_COUNT_UP,
+    .resolution_hz = TIMER_RESOLUTION_HZ,
+  };
+  ESP_ERROR_CHECK(gptimer_new_timer(&timer_config, &control_timer));
+  gptimer_alarm_config_t alarm_config = {
+    .reload_count = 0,
+    .alarm_count = TIMER_RESOLUTION_HZ / CONTROL_HZ,
+    .flags.auto_reload_on_alarm = true,
+  };
+  gptimer_event_callbacks_t callback = {
+    .on_alarm = control_timer_callback,
+  };
+  // 割込みはコールバックを登録したコアに割り当てられるので、制御タスクから呼ぶ
+  ESP_ERROR_CHECK(gptimer_register_event_callbacks(control_timer, &callback, NULL));
+  ESP_ERROR_CHECK(gptimer_set_alarm_action(control_timer, &alarm_config));
+  ESP_ERROR_CHECK(gptimer_enable(control_timer));
+  ESP_ERROR_CHECK(gptimer_start(control_timer));
+}
+
+//------------------------
+// 制御
+//------------------------
+static inline uint32_t cycles_to_ns(uint32_t cycles){
+  return (uint32_t)((uint64_t)cycles * 1000 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+}
+
+static void control_task(void *pvParameters){
+  static const speed_pid_config_t pid_config = {
+    .kff = MOTOR_CTRL_GAIN((double)MOTOR_PWM_DUTY_MAX / MAX_RPM),
+    .kp = MOTOR_CTRL_GAIN(0.5 * DUTY_PER_PERMILLE),
+    .ki = MOTOR_CTRL_GAIN(0.5 * DUTY_PER_PERMILLE * 20 / CONTROL_HZ),   // 積分時間 50ms
+    .kd = 0,
+    .out_min = -MOTOR_PWM_DUTY_MAX,                  // Hブリッジなので負は逆転
+    .out_max = MOTOR_PWM_DUTY_MAX,
+  };
+  speed_est_t est;
+  speed_pid_t pid;
+  speed_est_init(&est, SPEED_WINDOW, CONTROL_HZ, ENCODER_CPR, PCNT_LIMIT);
+  speed_pid_init(&pid, &pid_config);
+
+  setup_control_timer();
+  uint32_t last_wake = 0;
+  while (1) {
+    uint32_t notified = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint32_t start = esp_cpu_get_cycle_count();
+    // 自動リロードで0に戻るので、カウント値が割込みからの経過時間
+    uint64_t timer_count = 0;
+    gptimer_get_raw_count(control_timer, &timer_count);
+
+    int count = 0;
+    pcnt_unit_get_count(pcnt_unit, &count);
+    int32_t rpm = speed_est_update(&est, count);
+    int32_t duty = speed_pid_update(&pid, setpoint_rpm, rpm);
+    motor_pwm_set_bridge(&motor_pwm, duty);
+    measured_rpm = rpm;
+    output_duty = duty;
+
+    uint32_t end = esp_cpu_get_cycle_count();
+    uint32_t interval_ns = last_wake ? cycles_to_ns(start - last_wake) : 0;
+    last_wake = start;
+    taskENTER_CRITICAL(&stats_lock);
+    loop_stats_add(&loop_stats, interval_ns, (uint32_t)(timer_count * (1000000000 / TIMER_RESOLUTION_HZ)), cycles_to_ns(end - start));
+    if (notified > 1) {
+      loop_stats_add_missed(&loop_stats, notified - 1);
+    }
+    taskEXIT_CRITICAL(&stats_lock);
+  }
+}
+
+// 1秒毎に集計を出してクリアする
+static void report_task(void *pvParameters){
+  loop_stats_t s;
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    taskENTER_CRITICAL(&stats_lock);
+    s = loop_stats;
+    loop_stats_reset(&loop_stats);
+    taskEXIT_CRITICAL(&stats_lock);
+    ESP_LOGI(TAG, "sp=%ld rpm=%ld duty=%ld permille", (long)setpoint_rpm, (long)measured_rpm,
+      (long)(output_duty * 1000 / MOTOR_PWM_DUTY_MAX));
+    ESP_LOGI(TAG, "  jitter avg=%lu p99<=%lu max=%lu ns, latency avg=%lu max=%lu ns",
+      (unsigned long)loop_stats_avg_ns(&s.jitter), (unsigned long)loop_stats_jitter_p99_ns(&s), (unsigned long)s.jitter.max_ns,
+      (unsigned long)loop_stats_avg_ns(&s.latency), (unsigned long)s.latency.max_ns);
+    ESP_LOGI(TAG, "  exec avg=%lu max=%lu ns (budget %lu ns, %lu%%) overruns=%lu missed=%lu",
+      (unsigned long)loop_stats_avg_ns(&s.exec), (unsigned long)s.exec.max_ns, (unsigned long)s.budget_ns,
+      (unsigned long)(s.budget_ns ? (uint64_t)s.exec.max_ns * 100 / s.budget_ns : 0),
+      (unsigned long)s.overruns, (unsigned long)s.missed);
+  }
+}
+
+void app_main(void){
+  ESP_LOGI(TAG, "app_main start ===>");
+  loop_stats_init(&loop_stats, 1000000000 / CONTROL_HZ, 1000000000 / CONTROL_HZ * CONTROL_BUDGET_PCT / 100);
+  setup_encoder();
+  setup_pwm();
+
+  // 制御はAPP_CPU、それ以外(ログ、Wi-Fiなど)はPRO_CPU
+  xTaskCreatePinnedToCore(control_task, "control", 4096, NULL, configMAX_PRIORITIES - 2, &control_task_handle, APP_CPU_NUM);
+  xTaskCreatePinnedToCore(report_task, "report", 4096, NULL, 2, NULL, PRO_CPU_NUM);
+
+  // prog14と同じく2秒毎に目標値を変える(負は逆転)
+  static const int32_t profile[] = {1000, 2000, 2500, 1500, 0, -1500, 0};
+  while (1) {
+    for (size_t i = 0; i < sizeof(profile) / sizeof(profile[0]); i++) {
+      setpoint_rpm = profile[i];
+      vTaskDelay(pdMS_TO_TICKS(2000));
+    }
+  }
+}
@@ -0,0 +1,88 @@
+#include "motor_ctrl.h"
+#include <string.h>
+
+//------------------------
+// 回転数の推定
+//------------------------
+void speed_est_init(speed_est_t *est, int window, uint32_t control_hz, uint32_t cpr, int count_range){
+  memset(est, 0, sizeof(*est));
+  if (window < 1) {
+    window = 1;
+  }
+  if (window > SPEED_EST_WINDOW_MAX) {
+    window = SPEED_EST_WINDOW_MAX;
+  }
+  est->window = window;
+  est->count_range = count_range;
+  est->rpm_num = 60LL * control_hz;
+  est->rpm_den = (int64_t)cpr * window;
+}
+
+int32_t speed_est_update(speed_est_t *est, int count){
+  int delta = count - est->last_count;
+  est->last_count = count;
+  // 上限/下限で0に戻った分を戻す(1周期でcount_rangeの半分以上は動かない前提)
+  if (est->count_range > 0) {
+    if (delta > est->count_range / 2) {
+      delta -= est->count_range;
+    } else if (delta < -est->count_range / 2) {
+      delta += est->count_range;
+    }
+  }
+  if (delta > INT16_MAX) {
+    delta = INT16_MAX;
+  } else if (delta < INT16_MIN) {
+    delta = INT16_MIN;
+  }
+  est->sum -= est->deltas[est->pos];
+  est->deltas[est->pos] = (int16_t)delta;
+  est->sum += delta;
+  est->pos = (est->pos + 1) % est->window;
+  if (est->filled < est->window) {
+    est->filled++;
+  }
+  // 窓が埋まるまでは埋まった分で計算する
+  int64_t den = est->rpm_den * est->filled / est->window;
+  return den ? (int32_t)(est->sum * est->rpm_num / den) : 0;
+}
+
+//------------------------
+// PID
+//------------------------
+void speed_pid_init(speed_pid_t *pid, const speed_pid_config_t *config){
+  memset(pid, 0, sizeof(*pid));
+  pid->config = *config;
+}
+
+void speed_pid_reset(speed_pid_t *pid, int32_t measured_rpm){
+  pid->integ = 0;
+  pid->prev_meas = measured_rpm;
+  pid->saturated = false;
+}
+
+static int64_t clamp64(int64_t v, int64_t lo, int64_t hi){
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+int32_t speed_pid_update(speed_pid_t *pid, int32_t setpoint_rpm, int32_t measured_rpm){
+  const speed_pid_config_t *c = &pid->config;
+  int32_t err = setpoint_rpm - measured_rpm;
+  int64_t ff = (int64_t)c->kff * setpoint_rpm;
+  int64_t p = (int64_t)c->kp * err;
+  int64_t d = -(int64_t)c->kd * (measured_rpm - pid->prev_meas);
+  pid->prev_meas = measured_rpm;
+
+  // アンチワインドアップ(条件付き積分)
+  // 出力が上限に張り付いているときにさらに上げる方向、下限で下げる方向には積分しない
+  int64_t integ = pid->integ + (int64_t)c->ki * err;
+  int64_t out = (ff + p + d + integ) >> MOTOR_CTRL_Q;
+  if ((out > c->out_max && err > 0) || (out < c->out_min && err < 0)) {
+    integ = pid->integ;
+  }
+  // 積分項だけで出力範囲を超えないようにする(目標値が急に下がったときの戻りを速くする)
+  pid->integ = clamp64(integ, (int64_t)c->out_min << MOTOR_CTRL_Q, (int64_t)c->out_max << MOTOR_CTRL_Q);
+
+  out = (ff + p + d + pid->integ) >> MOTOR_CTRL_Q;
+  pid->saturated = out > c->out_max || out < c->out_min;
+  return (int32_t)clamp64(out, c->out_min, c->out_max);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// モーターの速度制御（ロジック部分）
+//   speed_est : エンコーダのカウントから回転数[rpm]を求める(移動窓)
+//   speed_pid : フィードフォワード + PID、出力はデューティ(単位はゲインとout_min/out_maxで決まる。prog18はQ15)
+// 制御周期毎に割込み起点のタスクから呼ぶので、浮動小数点は使わず固定小数点(Q16.16)で計算する
+// (ESP32-S3はFPUがあるが、タスクがFPUを使うとコンテキスト切り替えでFPUレジスタの退避が増える)
+// ESP-IDFに依存しないので、ホストでも同じ計算を確認できる
+
+#define MOTOR_CTRL_Q 16
+// 実数のゲインをQ16.16にする(定数式で使う)
+#define MOTOR_CTRL_GAIN(x) ((int32_t)((x) * (1 << MOTOR_CTRL_Q) + ((x) >= 0 ? 0.5 : -0.5)))
+
+#define SPEED_EST_WINDOW_MAX 64
+
+//------------------------
+// 回転数の推定
+//------------------------
+// 1周期の差分だけだと分解能が粗い(1kHz、400CPRで150rpm)ので、直近window周期の合計から求める
+typedef struct {
+  int16_t deltas[SPEED_EST_WINDOW_MAX];
+  int window;
+  int pos;
+  int filled;
+  int32_t sum;
+  int last_count;
+  int count_range;      // カウンタが0に戻る値(PCNTのhigh_limit)、差分の折り返しに使う
+  int64_t rpm_num;      // rpm = sum * rpm_num / rpm_den
+  int64_t rpm_den;
+} speed_est_t;
+
+// control_hz: 制御周期、cpr: 1回転あたりのカウント(4逓倍後)
+void speed_est_init(speed_est_t *est, int window, uint32_t control_hz, uint32_t cpr, int count_range);
+// カウンタの現在値を渡して回転数[rpm]を返す
+int32_t speed_est_update(speed_est_t *est, int count);
+
+//------------------------
+// PID
+//------------------------
+typedef struct {
+  int32_t kff;          // フィードフォワード 出力/rpm (Q16.16)
+  int32_t kp;           // 出力/rpm (Q16.16)
+  int32_t ki;           // 1周期あたり 出力/rpm (Q16.16)
+  int32_t kd;           // 1周期あたり 出力/rpm (Q16.16)、微分は測定値に対して取る(目標値の段差で跳ねない)
+  int32_t out_min;      // 出力の範囲
+  int32_t out_max;
+} speed_pid_config_t;
+
+typedef struct {
+  speed_pid_config_t config;
+  int64_t integ;        // 積分項(Q16.16の出力)
+  int32_t prev_meas;
+  bool saturated;       // 直前の出力が飽和していた
+} speed_pid_t;
+
+void speed_pid_init(speed_pid_t *pid, const speed_pid_config_t *config);
+void speed_pid_reset(speed_pid_t *pid, int32_t measured_rpm);
+// 1周期分計算して出力を返す
+int32_t speed_pid_update(speed_pid_t *pid, int32_t setpoint_rpm, int32_t measured_rpm);
@@ -0,0 +1,11 @@
+#include "motor_pwm.h"
+
+void motor_pwm_calc_init(motor_pwm_calc_t *calc, uint32_t period_ticks, uint32_t dead_ticks){
+  calc->period_ticks = period_ticks;
+  // HIGHの幅は2*cmp、立ち上がりがdead_ticks遅れるので、2*cmp <= dead_ticksだと消える
+  // 余裕を持ってパルス幅がデッドタイムの2倍以上になるようにする
+  calc->min_cmp = dead_ticks;
+  if (calc->min_cmp * 2 > period_ticks) {
+    calc->min_cmp = period_ticks / 2;
+  }
+}
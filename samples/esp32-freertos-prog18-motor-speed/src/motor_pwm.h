@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+
+// モーター駆動用PWMのデューティ計算（ロジック部分）
+// MCPWMのタイマをアップダウン(センターアライン)で使い、コンパレータの値でデューティを決める
+//   ハイサイド: カウントアップでcmpに達したらLOW、カウントダウンでcmpに達したらHIGH
+//   → HIGHの時間は 2*cmp / (2*period) = cmp / period
+// ローサイドはハイサイドの反転で、デッドタイムはMCPWMのデッドタイムジェネレータで入れる
+//
+// デューティはQ15(MOTOR_PWM_DUTY_MAX = 1.0)、制御ループから毎周期呼ぶので乗算とシフトだけで計算する
+// ESP-IDFに依存しないので、ホストでも確認できる
+
+#define MOTOR_PWM_DUTY_SHIFT 15
+#define MOTOR_PWM_DUTY_MAX   (1 << MOTOR_PWM_DUTY_SHIFT)
+
+typedef struct {
+  uint32_t period_ticks;     // アップダウンの片道(タイマのperiod_ticks/2、コンパレータの範囲 0～period_ticks)
+  uint32_t min_cmp;          // これより短いパルスはデッドタイムで潰れるので出さない
+} motor_pwm_calc_t;
+
+// dead_ticks: デッドタイム(タイマのtick)
+void motor_pwm_calc_init(motor_pwm_calc_t *calc, uint32_t period_ticks, uint32_t dead_ticks);
+
+// デューティ(0～MOTOR_PWM_DUTY_MAX)をコンパレータの値にする
+// デッドタイムより短いパルス、短い休止は0%/100%に丸める(中途半端な幅のパルスで電流が乱れないように)
+static inline uint32_t motor_pwm_calc_compare(const motor_pwm_calc_t *calc, int32_t duty){
+  if (duty <= 0) {
+    return 0;
+  }
+  if (duty >= MOTOR_PWM_DUTY_MAX) {
+    return calc->period_ticks;
+  }
+  uint32_t cmp = (uint32_t)(((uint64_t)duty * calc->period_ticks) >> MOTOR_PWM_DUTY_SHIFT);
+  if (cmp < calc->min_cmp) {
+    return 0;
+  }
+  if (cmp > calc->period_ticks - calc->min_cmp) {
+    return calc->period_ticks;
+  }
+  return cmp;
+}
+
+// Hブリッジ(2レッグ)の符号付きデューティ(-MOTOR_PWM_DUTY_MAX～MOTOR_PWM_DUTY_MAX)
+// 片側だけスイッチングして、もう片側はローサイドをONにしておく(スイッチング損失が半分)
+static inline void motor_pwm_calc_bridge(const motor_pwm_calc_t *calc, int32_t duty, uint32_t *cmp_a, uint32_t *cmp_b){
+  if (duty >= 0) {
+    *cmp_a = motor_pwm_calc_compare(calc, duty);
+    *cmp_b = 0;
+  } else {
+    *cmp_a = 0;
+    *cmp_b = motor_pwm_calc_compare(calc, -duty);
+  }
+}
@@ -0,0 +1,122 @@
+#include <string.h>
+#include "esp_log.h"
+#include "motor_pwm_port.h"
+
+static const char *TAG = "motor_pwm";
+
+static void setup_leg(motor_pwm_t *pwm, int leg, const motor_pwm_config_t *config, uint32_t dead_ticks){
+  mcpwm_operator_config_t operator_config = {
+    .group_id = config->group_id,
+  };
+  ESP_ERROR_CHECK(mcpwm_new_operator(&operator_config, &pwm->opers[leg]));
+  ESP_ERROR_CHECK(mcpwm_operator_connect_timer(pwm->opers[leg], pwm->timer));
+
+  mcpwm_comparator_config_t comparator_config = {
+    .flags.update_cmp_on_tez = true,
+  };
+  ESP_ERROR_CHECK(mcpwm_new_comparator(pwm->opers[leg], &comparator_config, &pwm->cmprs[leg]));
+  ESP_ERROR_CHECK(mcpwm_comparator_set_compare_value(pwm->cmprs[leg], 0));
+
+  const int gpios[2] = {config->legs[leg].gpio_high, config->legs[leg].gpio_low};
+  for (int i = 0; i < 2; i++) {
+    mcpwm_generator_config_t generator_config = {
+      .gen_gpio_num = gpios[i],
+    };
+    ESP_ERROR_CHECK(mcpwm_new_generator(pwm->opers[leg], &generator_config, &pwm->gens[leg][i]));
+  }
+
+  // ハイサイド: センターアライン、cmpまでHIGH
+  mcpwm_gen_handle_t high = pwm->gens[leg][0];
+  mcpwm_gen_handle_t low = pwm->gens[leg][1];
+  ESP_ERROR_CHECK(mcpwm_generator_set_action_on_compare_event(high,
+    MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, pwm->cmprs[leg], MCPWM_GEN_ACTION_LOW)));
+  ESP_ERROR_CHECK(mcpwm_generator_set_action_on_compare_event(high,
+    MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_DOWN, pwm->cmprs[leg], MCPWM_GEN_ACTION_HIGH)));
+
+  // デッドタイム: ハイサイドは立ち上がりを遅らせ、ローサイドはハイサイドの立ち下がりを遅らせて反転する
+  // → ハイサイドがOFFになってからdead_ticks後にローサイドがON、ローサイドがOFFになってからdead_ticks後にハイサイドがON
+  mcpwm_dead_time_config_t dead_time_config = {
+    .posedge_delay_ticks = dead_ticks,
+  };
+  ESP_ERROR_CHECK(mcpwm_generator_set_dead_time(high, high, &dead_time_config));
+  dead_time_config = (mcpwm_dead_time_config_t){
+    .negedge_delay_ticks = dead_ticks,
+    .flags.invert_output = true,
+  };
+  ESP_ERROR_CHECK(mcpwm_generator_set_dead_time(high, low, &dead_time_config));
+
+  // 開始までは全レッグのハイサイドOFF(ローサイドON)にしておく
+  ESP_ERROR_CHECK(mcpwm_generator_set_force_level(high, 0, true));
+}
+
+esp_err_t motor_pwm_init(motor_pwm_t *pwm, const motor_pwm_config_t *config){
+  if (config->num_legs < 1 || config->num_legs > MOTOR_PWM_MAX_LEGS || config->freq_hz == 0) {
+    ESP_LOGE(TAG, "invalid config");
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(pwm, 0, sizeof(*pwm));
+  pwm->num_legs = config->num_legs;
+
+  // ESP-IDF v5のperiod_ticksはアップダウンでも1周期(往復)の長さで、カウンタはperiod_ticks/2で折り返す
+  // コンパレータの範囲は片道の0～period_ticks/2
+  uint32_t period_ticks = config->resolution_hz / config->freq_hz;
+  uint32_t peak_ticks = period_ticks / 2;
+  uint32_t dead_ticks = (uint32_t)((uint64_t)config->dead_time_ns * config->resolution_hz / 1000000000);
+  motor_pwm_calc_init(&pwm->calc, peak_ticks, dead_ticks);
+
+  mcpwm_timer_config_t timer_config = {
+    .group_id = config->group_id,
+    .clk_src = MCPWM_TIMER_CLK_SRC_DEFAULT,
+    .resolution_hz = config->resolution_hz,
+    .period_ticks = period_ticks,
+    .count_mode = MCPWM_TIMER_COUNT_MODE_UP_DOWN,
+  };
+  if (peak_ticks < 2 || dead_ticks >= peak_ticks) {
+    ESP_LOGE(TAG, "period %lu ticks is too short (dead time %lu ticks)", (unsigned long)period_ticks, (unsigned long)dead_ticks);
+    return ESP_ERR_INVALID_ARG;
+  }
+  ESP_ERROR_CHECK(mcpwm_new_timer(&timer_config, &pwm->timer));
+  for (int leg = 0; leg < config->num_legs; leg++) {
+    setup_leg(pwm, leg, config, dead_ticks);
+  }
+  ESP_ERROR_CHECK(mcpwm_timer_enable(pwm->timer));
+  ESP_LOGI(TAG, "%lu Hz, period %lu ticks, dead time %lu ticks, %d legs",
+    (unsigned long)config->freq_hz, (unsigned long)period_ticks, (unsigned long)dead_ticks, config->num_legs);
+  return ESP_OK;
+}
+
+void motor_pwm_start(motor_pwm_t *pwm){
+  for (int leg = 0; leg < pwm->num_legs; leg++) {
+    pwm->cmp[leg] = 0;
+    ESP_ERROR_CHECK(mcpwm_comparator_set_compare_value(pwm->cmprs[leg], 0));
+    ESP_ERROR_CHECK(mcpwm_generator_set_force_level(pwm->gens[leg][0], -1, true));
+  }
+  ESP_ERROR_CHECK(mcpwm_timer_start_stop(pwm->timer, MCPWM_TIMER_START_NO_STOP));
+}
+
+void motor_pwm_stop(motor_pwm_t *pwm){
+  // ハイサイドを0に固定すると、デッドタイムの後ろでローサイドがONになる(両レッグのローサイドON = ブレーキ)
+  for (int leg = 0; leg < pwm->num_legs; leg++) {
+    ESP_ERROR_CHECK(mcpwm_generator_set_force_level(pwm->gens[leg][0], 0, true));
+  }
+  ESP_ERROR_CHECK(mcpwm_timer_start_stop(pwm->timer, MCPWM_TIMER_STOP_EMPTY));
+}
+
+void motor_pwm_set_leg(motor_pwm_t *pwm, int leg, int32_t duty){
+  uint32_t cmp = motor_pwm_calc_compare(&pwm->calc, duty);
+  if (cmp != pwm->cmp[leg]) {
+    pwm->cmp[leg] = cmp;
+    mcpwm_comparator_set_compare_value(pwm->cmprs[leg], cmp);
+  }
+}
+
+void motor_pwm_set_bridge(motor_pwm_t *pwm, int32_t duty){
+  uint32_t cmp[2];
+  motor_pwm_calc_bridge(&pwm->calc, duty, &cmp[0], &cmp[1]);
+  for (int leg = 0; leg < 2; leg++) {
+    if (cmp[leg] != pwm->cmp[leg]) {
+      pwm->cmp[leg] = cmp[leg];
+      mcpwm_comparator_set_compare_value(pwm->cmprs[leg], cmp[leg]);
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/mcpwm_prelude.h"
+#include "motor_pwm.h"
+
+// モーター駆動用の相補PWM(ESP-IDF部分)
+// 1つのタイマにレッグ毎のオペレータをつなぐので、全レッグの周期は同期する
+// レッグ毎にコンパレータ1つ、ジェネレータ2つ(ハイサイド/ローサイド)、デッドタイムで相補出力にする
+// コンパレータはTEZ(カウンタ0)で更新するので、周期の途中で値を変えても波形が崩れない
+//
+// 制御ループから呼ぶmotor_pwm_set_*()は、値が変わったときだけコンパレータに書く
+// sdkconfigのCONFIG_MCPWM_CTRL_FUNC_IN_IRAMでmcpwm_comparator_set_compare_value()をIRAMに置くと
+// フラッシュキャッシュのミスで実行時間がぶれない
+
+#define MOTOR_PWM_MAX_LEGS 3   // 1グループのオペレータ数
+
+typedef struct {
+  int gpio_high;
+  int gpio_low;
+} motor_pwm_leg_config_t;
+
+typedef struct {
+  int group_id;
+  uint32_t resolution_hz;    // タイマの分解能(グループクロック160MHzを割り切れる値)
+  uint32_t freq_hz;          // PWM周波数 20～40kHz
+  uint32_t dead_time_ns;
+  int num_legs;
+  motor_pwm_leg_config_t legs[MOTOR_PWM_MAX_LEGS];
+} motor_pwm_config_t;
+
+typedef struct {
+  mcpwm_timer_handle_t timer;
+  mcpwm_oper_handle_t opers[MOTOR_PWM_MAX_LEGS];
+  mcpwm_cmpr_handle_t cmprs[MOTOR_PWM_MAX_LEGS];
+  mcpwm_gen_handle_t gens[MOTOR_PWM_MAX_LEGS][2];
+  uint32_t cmp[MOTOR_PWM_MAX_LEGS];
+  motor_pwm_calc_t calc;
+  int num_legs;
+} motor_pwm_t;
+
+// 設定が範囲外ならESP_ERR_INVALID_ARG、ドライバのエラーはESP_ERROR_CHECKで止める
+// 初期化後はハイサイドOFF/ローサイドONで、タイマは止まっている
+esp_err_t motor_pwm_init(motor_pwm_t *pwm, const motor_pwm_config_t *config);
+// デューティ0から開始する
+void motor_pwm_start(motor_pwm_t *pwm);
+// タイマを止めて全レッグのローサイドをONにする(ブレーキ)
+void motor_pwm_stop(motor_pwm_t *pwm);
+
+// レッグのデューティ(Q15、0～MOTOR_PWM_DUTY_MAX)
+void motor_pwm_set_leg(motor_pwm_t *pwm, int leg, int32_t duty);
+// レッグ0/1をHブリッジとして符号付きデューティ(Q15)を出す
+void motor_pwm_set_bridge(motor_pwm_t *pwm, int32_t duty);
@@ -5,6 +5,7 @@
 #include "sdkconfig.h"
 #include <esp_task_wdt.h>
 #include <Arduino.h>
+#include "rt_stats_port.h"
 
 //https://github.com/espressif/esp-idf/blob/master/examples/system/task_watchdog/main/task_watchdog_example_main.c
 
@@ -32,6 +33,29 @@ void task2(void *pvParameters) {
   }
 }
 
+// WDTの発動がアイドルタスクの飢餓によるものか、CPU負荷を計測して確認する
+// task2がAPP_CPUでwhile(1){}しているので、core1の負荷が100%(1000‰)、IDLE1が0になるはず
+void report_task(void *pvParameters) {
+  static uint8_t dump[512];
+  while (1) {
+    delay_ms(1000);
+    printf("core0 %4d/%4d, core1 %4d/%4d [1s/10s permille]\n",
+      rt_stats_read_core_load(0, RT_STATS_WINDOW_1S), rt_stats_read_core_load(0, RT_STATS_WINDOW_10S),
+      rt_stats_read_core_load(1, RT_STATS_WINDOW_1S), rt_stats_read_core_load(1, RT_STATS_WINDOW_10S));
+    for (int slot = 0; slot < RT_STATS_MAX_TASKS; slot++) {
+      rt_stats_task_t info;
+      int load_1s = rt_stats_read_task_load(slot, RT_STATS_WINDOW_1S, &info);
+      if (!info.in_use) {
+        continue;
+      }
+      printf("  %-16s core=%2d %4d [1s permille]\n", info.name, info.core, load_1s);
+    }
+    // バイナリダンプ、外部に送る場合はこちらを使う
+    size_t len = rt_stats_read_dump(dump, sizeof(dump));
+    printf("  dump %u bytes\n", (unsigned)len);
+  }
+}
+
 void app_main()
 {
   //デフォルトでCore0 => ON, Core1 => OFF
@@ -41,5 +65,7 @@ void app_main()
 
   xTaskCreatePinnedToCore(task1, "task1", 8192, NULL, 1, NULL, PRO_CPU_NUM);
   xTaskCreatePinnedToCore(task2, "task2", 8192, NULL, 1, NULL, APP_CPU_NUM);
-    
+
+  rt_stats_start();
+  xTaskCreatePinnedToCore(report_task, "report_task", 4096, NULL, 1, NULL, PRO_CPU_NUM);
 }
@@ -0,0 +1,184 @@
+#include "rt_stats.h"
+#include <string.h>
+
+static rt_stats_task_t tasks[RT_STATS_MAX_TASKS];
+// 実行時間カウンタの履歴（リングバッファ）
+// 差分を取れば任意の窓の実行時間になるので、窓毎に合計を持つ必要がない
+static uint32_t task_run_time[RT_STATS_HISTORY][RT_STATS_MAX_TASKS];
+static uint32_t total_run_time[RT_STATS_HISTORY];
+static uint32_t seq = 0;
+
+static const uint32_t window_samples[RT_STATS_WINDOW_NUM] = {
+  1000 / RT_STATS_SAMPLE_PERIOD_MS,
+  10000 / RT_STATS_SAMPLE_PERIOD_MS,
+};
+
+void rt_stats_init(void){
+  memset(tasks, 0, sizeof(tasks));
+  memset(task_run_time, 0, sizeof(task_run_time));
+  memset(total_run_time, 0, sizeof(total_run_time));
+  seq = 0;
+}
+
+static int find_slot(uint32_t task_number){
+  for (int i = 0; i < RT_STATS_MAX_TASKS; i++) {
+    if (tasks[i].in_use && tasks[i].task_number == task_number) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int alloc_slot(const rt_stats_sample_t *sample){
+  for (int i = 0; i < RT_STATS_MAX_TASKS; i++) {
+    rt_stats_task_t *t = &tasks[i];
+    if (t->in_use) {
+      continue;
+    }
+    t->in_use = true;
+    t->task_number = sample->task_number;
+    strncpy(t->name, sample->name ? sample->name : "", RT_STATS_NAME_LEN - 1);
+    t->name[RT_STATS_NAME_LEN - 1] = '\0';
+    t->core = sample->core;
+    t->idle_core = sample->idle_core;
+    t->since_seq = seq;
+    return i;
+  }
+  return -1;
+}
+
+void rt_stats_update(uint32_t total, const rt_stats_sample_t *samples, int num_samples){
+  uint32_t pos = seq % RT_STATS_HISTORY;
+  bool seen[RT_STATS_MAX_TASKS] = {0};
+
+  for (int i = 0; i < num_samples; i++) {
+    int slot = find_slot(samples[i].task_number);
+    if (slot < 0) {
+      slot = alloc_slot(&samples[i]);
+      if (slot < 0) {
+        // スロット不足、記録しない
+        continue;
+      }
+    }
+    task_run_time[pos][slot] = samples[i].run_time;
+    seen[slot] = true;
+  }
+  // 今回のサンプルにないタスクは削除されたとみなす
+  for (int i = 0; i < RT_STATS_MAX_TASKS; i++) {
+    if (tasks[i].in_use && !seen[i]) {
+      tasks[i].in_use = false;
+    }
+  }
+  total_run_time[pos] = total;
+  seq++;
+}
+
+// 窓の開始サンプル番号を返す、計算できなければ-1
+static int64_t window_start(uint32_t since, rt_stats_window_t window){
+  if (seq == 0) {
+    return -1;
+  }
+  int64_t latest = (int64_t)seq - 1;
+  int64_t start = latest - window_samples[window];
+  // 記録開始が窓より新しい場合は、記録開始からの部分的な窓で計算する
+  if (start < (int64_t)since) {
+    start = since;
+  }
+  return (start < latest) ? start : -1;
+}
+
+static int load_permille(int slot, int64_t start){
+  uint32_t latest = (seq - 1) % RT_STATS_HISTORY;
+  uint32_t first = (uint32_t)(start % RT_STATS_HISTORY);
+  // カウンタは32bitなので符号なしの差分でラップアラウンドを吸収する
+  uint32_t elapsed = total_run_time[latest] - total_run_time[first];
+  uint32_t delta = task_run_time[latest][slot] - task_run_time[first][slot];
+  if (elapsed == 0) {
+    return -1;
+  }
+  uint64_t load = (uint64_t)delta * 1000 / elapsed;
+  return load > 1000 ? 1000 : (int)load;
+}
+
+int rt_stats_task_load(int slot, rt_stats_window_t window){
+  if (slot < 0 || slot >= RT_STATS_MAX_TASKS || !tasks[slot].in_use || window >= RT_STATS_WINDOW_NUM) {
+    return -1;
+  }
+  int64_t start = window_start(tasks[slot].since_seq, window);
+  if (start < 0) {
+    return -1;
+  }
+  return load_permille(slot, start);
+}
+
+// コアの負荷 = 1000 - そのコアのアイドルタスクの負荷
+int rt_stats_core_load(int core, rt_stats_window_t window){
+  for (int i = 0; i < RT_STATS_MAX_TASKS; i++) {
+    if (tasks[i].in_use && tasks[i].idle_core == core) {
+      int idle = rt_stats_task_load(i, window);
+      return idle < 0 ? -1 : 1000 - idle;
+    }
+  }
+  return -1;
+}
+
+const rt_stats_task_t *rt_stats_get_task(int slot){
+  if (slot < 0 || slot >= RT_STATS_MAX_TASKS || !tasks[slot].in_use) {
+    return NULL;
+  }
+  return &tasks[slot];
+}
+
+uint32_t rt_stats_sample_count(void){
+  return seq;
+}
+
+static uint8_t *put_u16(uint8_t *p, int value){
+  uint16_t v = value < 0 ? 0xFFFF : (uint16_t)value;
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+  return p + 2;
+}
+
+size_t rt_stats_dump(uint8_t *buf, size_t len){
+  int num_tasks = 0;
+  size_t need = 9 + RT_STATS_NUM_CORES * 4;
+  for (int i = 0; i < RT_STATS_MAX_TASKS; i++) {
+    if (tasks[i].in_use) {
+      num_tasks++;
+      need += 8 + strlen(tasks[i].name);
+    }
+  }
+  if (need > len) {
+    return 0;
+  }
+
+  uint8_t *p = buf;
+  *p++ = 'R';
+  *p++ = 'T';
+  *p++ = 1;
+  *p++ = RT_STATS_NUM_CORES;
+  *p++ = (uint8_t)num_tasks;
+  for (int i = 0; i < 4; i++) {
+    *p++ = (seq >> (8 * i)) & 0xFF;
+  }
+  for (int core = 0; core < RT_STATS_NUM_CORES; core++) {
+    p = put_u16(p, rt_stats_core_load(core, RT_STATS_WINDOW_1S));
+    p = put_u16(p, rt_stats_core_load(core, RT_STATS_WINDOW_10S));
+  }
+  for (int i = 0; i < RT_STATS_MAX_TASKS; i++) {
+    const rt_stats_task_t *t = &tasks[i];
+    if (!t->in_use) {
+      continue;
+    }
+    size_t name_len = strlen(t->name);
+    p = put_u16(p, (int)(t->task_number & 0xFFFF));
+    *p++ = (uint8_t)t->core;
+    p = put_u16(p, rt_stats_task_load(i, RT_STATS_WINDOW_1S));
+    p = put_u16(p, rt_stats_task_load(i, RT_STATS_WINDOW_10S));
+    *p++ = (uint8_t)name_len;
+    memcpy(p, t->name, name_len);
+    p += name_len;
+  }
+  return (size_t)(p - buf);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// タスク/コア毎のCPU負荷の集計（ロジック部分）
+// uxTaskGetSystemState()の実行時間カウンタを一定周期でrt_stats_update()に渡すと
+// 直近1秒、10秒の移動窓でCPU負荷を計算する
+// ESP-IDFに依存しないので、サンプルを作って渡せばホストでも計算を確認できる
+// 負荷はすべてパーミル(0-1000)で返す。タスクの負荷は1コアに対する割合
+// スレッドセーフではないので、呼び出し側で排他すること(rt_stats_port.cで排他している)
+
+#define RT_STATS_NUM_CORES       2
+#define RT_STATS_MAX_TASKS       24
+#define RT_STATS_NAME_LEN        16
+#define RT_STATS_SAMPLE_PERIOD_MS 100
+// 10秒窓 + 1サンプル分の履歴
+#define RT_STATS_HISTORY         (10000 / RT_STATS_SAMPLE_PERIOD_MS + 1)
+
+typedef enum {
+  RT_STATS_WINDOW_1S,
+  RT_STATS_WINDOW_10S,
+  RT_STATS_WINDOW_NUM,
+} rt_stats_window_t;
+
+// 1タスク分のサンプル
+typedef struct {
+  uint32_t task_number;  // TaskStatus_t.xTaskNumber
+  const char *name;
+  uint32_t run_time;     // TaskStatus_t.ulRunTimeCounter
+  int8_t core;           // 固定されていないタスクは-1
+  int8_t idle_core;      // アイドルタスクならそのコア番号、それ以外は-1
+} rt_stats_sample_t;
+
+typedef struct {
+  bool in_use;
+  uint32_t task_number;
+  char name[RT_STATS_NAME_LEN];
+  int8_t core;
+  int8_t idle_core;
+  uint32_t since_seq;    // このスロットで記録を始めたサンプル番号
+} rt_stats_task_t;
+
+void rt_stats_init(void);
+// 1周期分のサンプルを追加する。total_run_timeは実行時間カウンタの現在値
+void rt_stats_update(uint32_t total_run_time, const rt_stats_sample_t *samples, int num_samples);
+
+// コアの負荷[‰]、サンプルが足りなければ-1
+int rt_stats_core_load(int core, rt_stats_window_t window);
+// タスクの負荷[‰]、slotはrt_stats_get_task()のindex
+int rt_stats_task_load(int slot, rt_stats_window_t window);
+const rt_stats_task_t *rt_stats_get_task(int slot);
+uint32_t rt_stats_sample_count(void);
+
+// バイナリダンプ(リトルエンディアン)、書き込んだバイト数を返す。バッファ不足なら0
+// header : 'R' 'T' version(1) num_cores(1) num_tasks(1) seq(4)
+// core   : load_1s(2) load_10s(2)                           x num_cores
+// task   : task_number(2) core(1) load_1s(2) load_10s(2) name_len(1) name(name_len) x num_tasks
+// 負荷が計算できない場合は0xFFFF
+size_t rt_stats_dump(uint8_t *buf, size_t len);
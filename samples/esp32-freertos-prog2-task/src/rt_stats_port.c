@@ -0,0 +1,80 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "rt_stats_port.h"
+
+static portMUX_TYPE rt_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// サンプリング経路でmallocしないように静的に確保しておく
+static TaskStatus_t task_status[RT_STATS_MAX_TASKS];
+static rt_stats_sample_t samples[RT_STATS_MAX_TASKS];
+
+static void rt_stats_sampling_task(void *pvParameters){
+  TaskHandle_t idle[RT_STATS_NUM_CORES];
+  for (int core = 0; core < RT_STATS_NUM_CORES; core++) {
+    idle[core] = xTaskGetIdleTaskHandleForCPU(core);
+  }
+
+  TickType_t last_wake = xTaskGetTickCount();
+  while (1) {
+    // 処理時間に関係なく一定周期でサンプリングする
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(RT_STATS_SAMPLE_PERIOD_MS));
+
+    uint32_t total_run_time = 0;
+    UBaseType_t n = uxTaskGetSystemState(task_status, RT_STATS_MAX_TASKS, &total_run_time);
+    // タスク数が配列より多いと0が返る
+    if (n == 0) {
+      continue;
+    }
+    for (UBaseType_t i = 0; i < n; i++) {
+      TaskStatus_t *st = &task_status[i];
+      rt_stats_sample_t *s = &samples[i];
+      BaseType_t affinity = xTaskGetAffinity(st->xHandle);
+      s->task_number = st->xTaskNumber;
+      s->name = st->pcTaskName;
+      s->run_time = st->ulRunTimeCounter;
+      s->core = (affinity == tskNO_AFFINITY) ? -1 : (int8_t)affinity;
+      s->idle_core = -1;
+      for (int core = 0; core < RT_STATS_NUM_CORES; core++) {
+        if (st->xHandle == idle[core]) {
+          s->idle_core = core;
+        }
+      }
+    }
+    taskENTER_CRITICAL(&rt_stats_lock);
+    rt_stats_update(total_run_time, samples, n);
+    taskEXIT_CRITICAL(&rt_stats_lock);
+  }
+}
+
+void rt_stats_start(void){
+  rt_stats_init();
+  // 負荷の高いタスクがいても周期がずれないように高い優先度で動かす
+  xTaskCreatePinnedToCore(rt_stats_sampling_task, "rt_stats", 4096, NULL, configMAX_PRIORITIES - 3, NULL, PRO_CPU_NUM);
+}
+
+int rt_stats_read_core_load(int core, rt_stats_window_t window){
+  taskENTER_CRITICAL(&rt_stats_lock);
+  int load = rt_stats_core_load(core, window);
+  taskEXIT_CRITICAL(&rt_stats_lock);
+  return load;
+}
+
+int rt_stats_read_task_load(int slot, rt_stats_window_t window, rt_stats_task_t *info){
+  info->in_use = false;
+  taskENTER_CRITICAL(&rt_stats_lock);
+  const rt_stats_task_t *t = rt_stats_get_task(slot);
+  int load = -1;
+  if (t != NULL) {
+    *info = *t;
+    load = rt_stats_task_load(slot, window);
+  }
+  taskEXIT_CRITICAL(&rt_stats_lock);
+  return t != NULL ? load : -1;
+}
+
+size_t rt_stats_read_dump(uint8_t *buf, size_t len){
+  taskENTER_CRITICAL(&rt_stats_lock);
+  size_t written = rt_stats_dump(buf, len);
+  taskEXIT_CRITICAL(&rt_stats_lock);
+  return written;
+}
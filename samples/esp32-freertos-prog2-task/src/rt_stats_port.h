@@ -0,0 +1,14 @@
+#pragma once
+#include "rt_stats.h"
+
+// rt_statsのESP-IDF側
+// サンプリングタスクがRT_STATS_SAMPLE_PERIOD_MS毎にuxTaskGetSystemState()を呼んで集計する
+// サンプリング経路ではprintf/ESP_LOG*を使わない
+// CONFIG_FREERTOS_USE_TRACE_FACILITY、CONFIG_FREERTOS_GENERATE_RUN_TIME_STATSが必要
+
+void rt_stats_start(void);
+// 排他して読み出す
+int rt_stats_read_core_load(int core, rt_stats_window_t window);
+// slotのタスク情報をコピーして負荷を返す、空きスロットなら-1
+int rt_stats_read_task_load(int slot, rt_stats_window_t window, rt_stats_task_t *info);
+size_t rt_stats_read_dump(uint8_t *buf, size_t len);
@@ -7,11 +7,13 @@
 
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
+#include "wdt_supervisor_port.h"
 static const char *TAG = "test1";
 
 #define TWDT_TIMEOUT_MS 2000
 
-static esp_task_wdt_user_handle_t func_a_twdt_user_hdl;
+// wdt_supervisorの登録ID
+static int func_a_twdt_user_id = -1;
 
 static void func_a(void)
 {
@@ -21,7 +23,7 @@ static void func_a(void)
   //E (5299) task_wdt: Task watchdog got triggered. The following tasks/users did not reset the watchdog in time:
   //E (5299) task_wdt:  - func_a
 
-  esp_task_wdt_reset_user(func_a_twdt_user_hdl);
+  wdt_supervisor_reset(func_a_twdt_user_id);
 }
 
 void delay_ms(uint32_t ms)
@@ -34,23 +36,24 @@ void task1(void *pvParameters) {
   // WDTがONの場合、タスク内でWDTリセット(esp_task_wdt_reset)を制限時間内でする必要がある
   // リセットするためにはタスクの先頭で自身を追加(esp_task_wdt_add)しないと
   // リセット時に「登録されてない」と言われる。
-  esp_task_wdt_add(NULL);
+  // wdt_supervisor_add_task()の中でesp_task_wdt_add(NULL)している
+  int id = wdt_supervisor_add_task();
 
   // 別途WDTに追加登録することができる
-  esp_task_wdt_add_user("func_a", &func_a_twdt_user_hdl);
+  func_a_twdt_user_id = wdt_supervisor_add_user("func_a");
 
   while (1) {
     ESP_LOGI(TAG,"11111");
-    esp_task_wdt_reset();
+    wdt_supervisor_reset(id);
     func_a();
     delay_ms(100);
   }
 }
 void task2(void *pvParameters) {
-  esp_task_wdt_add(NULL);
+  int id = wdt_supervisor_add_task();
   while (1) {
     ESP_LOGI(TAG, "22222");
-    esp_task_wdt_reset();
+    wdt_supervisor_reset(id);
     delay_ms(1000);
   }
 }
@@ -73,9 +76,9 @@ void task2(void *pvParameters) {
 // https://rt-net.jp/mobility/archives/10112
 
 void task3(void *pvParameters) {
-  ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
+  int id = wdt_supervisor_add_task();
   while (1) {
-    ESP_ERROR_CHECK(esp_task_wdt_reset());
+    wdt_supervisor_reset(id);
     delay_ms(1);
   }
 }
@@ -85,6 +88,15 @@ void task4(void *pvParameters) {
   }
 }
 
+// WDTのリセット間隔と、WDT発動前に記録したストール(各コアの実行中タスクとスタック残量)を定期的に出力する
+// ストールした時点で実行中だったタスクが、飢餓状態を起こしている原因のタスク
+void report_task(void *pvParameters) {
+  while (1) {
+    delay_ms(5000);
+    wdt_supervisor_dump();
+  }
+}
+
 void app_main()
 {
   // 本プログラムはArduino core for ESP32使用してないプログラムになる
@@ -113,25 +125,19 @@ void app_main()
   //esp_task_wdt_delete(idle_0);
   //esp_task_wdt_delete(idle_1);
 
-  // 既にinitされているので一旦解除しないとエラーになる
-  ESP_ERROR_CHECK(esp_task_wdt_deinit());
-
   // WDTを再度定義する
+  // wdt_supervisor_start()の中で一旦解除(esp_task_wdt_deinit)してからinitしている
   // idle_core_maskでコア毎に有効・無効をビットで設定する
   // idle_core_mask=0 :(0b00) コア0無効、コア1無効
   // idle_core_mask=1 :(0b01) コア0有効、コア1無効
   // idle_core_mask=2 :(0b10) コア0無効、コア1有効
   // idle_core_mask=3 :(0b11) コア0有効、コア1有効
-  esp_task_wdt_config_t twdt_config = {
-    .timeout_ms = TWDT_TIMEOUT_MS,
-    .idle_core_mask = 3,
-    .trigger_panic = false,
-  };
-  ESP_ERROR_CHECK(esp_task_wdt_init(&twdt_config));
+  wdt_supervisor_start(TWDT_TIMEOUT_MS, 3);
 
   //xTaskCreatePinnedToCore(task1, "task1", 8192, NULL, 1, NULL, PRO_CPU_NUM);
   //xTaskCreatePinnedToCore(task2, "task2", 8192, NULL, 1, NULL, APP_CPU_NUM);
 
   xTaskCreatePinnedToCore(task3, "task3", 8192, NULL, 1, NULL, PRO_CPU_NUM);
   xTaskCreatePinnedToCore(task4, "task4", 8192, NULL, 1, NULL, APP_CPU_NUM);
+  xTaskCreatePinnedToCore(report_task, "report_task", 4096, NULL, 1, NULL, APP_CPU_NUM);
 }
@@ -0,0 +1,154 @@
+#include "wdt_supervisor.h"
+#include <stdio.h>
+#include <string.h>
+
+static wdt_sup_config_t sup_config;
+static wdt_sup_entry_t entries[WDT_SUP_MAX_ENTRIES];
+// ストール記録はリングバッファ、古いものから上書き
+static wdt_sup_stall_t stalls[WDT_SUP_MAX_STALLS];
+static int stall_head = 0;
+static int stall_total = 0;
+
+void wdt_sup_init(const wdt_sup_config_t *config){
+  sup_config = *config;
+  if (sup_config.warn_percent == 0 || sup_config.warn_percent > 100) {
+    sup_config.warn_percent = 75;
+  }
+  memset(entries, 0, sizeof(entries));
+  memset(stalls, 0, sizeof(stalls));
+  stall_head = 0;
+  stall_total = 0;
+}
+
+int wdt_sup_register(const char *name, wdt_sup_kind_t kind, void *handle){
+  for (int i = 0; i < WDT_SUP_MAX_ENTRIES; i++) {
+    wdt_sup_entry_t *e = &entries[i];
+    if (e->in_use) {
+      continue;
+    }
+    memset(e, 0, sizeof(*e));
+    strncpy(e->name, name, WDT_SUP_NAME_LEN - 1);
+    e->kind = kind;
+    e->handle = handle;
+    e->core = -1;
+    e->in_use = true;
+    e->last_reset_us = sup_config.clock();
+    return i;
+  }
+  return -1;
+}
+
+int wdt_sup_register_idle(int core){
+  char name[WDT_SUP_NAME_LEN];
+  snprintf(name, sizeof(name), "IDLE%d", core);
+  int id = wdt_sup_register(name, WDT_SUP_KIND_IDLE, NULL);
+  if (id >= 0) {
+    entries[id].core = core;
+  }
+  return id;
+}
+
+void wdt_sup_unregister(int id){
+  if (id >= 0 && id < WDT_SUP_MAX_ENTRIES) {
+    entries[id].in_use = false;
+  }
+}
+
+int wdt_sup_find(wdt_sup_kind_t kind, void *handle){
+  for (int i = 0; i < WDT_SUP_MAX_ENTRIES; i++) {
+    if (entries[i].in_use && entries[i].kind == kind && entries[i].handle == handle) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int64_t wdt_sup_feed(int id){
+  if (id < 0 || id >= WDT_SUP_MAX_ENTRIES || !entries[id].in_use) {
+    return -1;
+  }
+  wdt_sup_entry_t *e = &entries[id];
+  int64_t now = sup_config.clock();
+  int64_t interval = now - e->last_reset_us;
+  e->last_reset_us = now;
+  e->total_interval_us += interval;
+  e->reset_count++;
+  if (interval > e->max_interval_us) {
+    e->max_interval_us = interval;
+  }
+  e->stalled = 0;
+  return interval;
+}
+
+int wdt_sup_check(void){
+  int64_t now = sup_config.clock();
+  int64_t timeout_us = (int64_t)sup_config.timeout_ms * 1000;
+  int64_t warn_us = timeout_us * sup_config.warn_percent / 100;
+  int found = 0;
+
+  for (int i = 0; i < WDT_SUP_MAX_ENTRIES; i++) {
+    wdt_sup_entry_t *e = &entries[i];
+    if (!e->in_use) {
+      continue;
+    }
+    int64_t elapsed = now - e->last_reset_us;
+    int level = elapsed >= timeout_us ? 2 : elapsed >= warn_us ? 1 : 0;
+    // 次にfeedされるまでは同じ段階を重複して記録しない
+    if (level <= e->stalled) {
+      continue;
+    }
+    e->stalled = level;
+    e->stall_count++;
+
+    wdt_sup_stall_t *s = &stalls[stall_head];
+    memset(s, 0, sizeof(*s));
+    s->time_us = now;
+    s->entry_id = i;
+    memcpy(s->name, e->name, sizeof(s->name));
+    s->diag = level == 2 ? WDT_SUP_DIAG_TIMEOUT : WDT_SUP_DIAG_WARN;
+    s->starved_core = e->kind == WDT_SUP_KIND_IDLE ? e->core : -1;
+    s->elapsed_us = elapsed;
+    if (sup_config.snapshot != NULL) {
+      sup_config.snapshot(s);
+    }
+    stall_head = (stall_head + 1) % WDT_SUP_MAX_STALLS;
+    stall_total++;
+    found++;
+  }
+  return found;
+}
+
+const wdt_sup_entry_t *wdt_sup_get_entry(int id){
+  if (id < 0 || id >= WDT_SUP_MAX_ENTRIES || !entries[id].in_use) {
+    return NULL;
+  }
+  return &entries[id];
+}
+
+int wdt_sup_stall_count(void){
+  return stall_total < WDT_SUP_MAX_STALLS ? stall_total : WDT_SUP_MAX_STALLS;
+}
+
+const wdt_sup_stall_t *wdt_sup_get_stall(int index){
+  if (index < 0 || index >= wdt_sup_stall_count()) {
+    return NULL;
+  }
+  int pos = (stall_head - 1 - index + WDT_SUP_MAX_STALLS) % WDT_SUP_MAX_STALLS;
+  return &stalls[pos];
+}
+
+// 例: "timeout: task3 not reset for 2100 ms"
+//     "warn: IDLE0 not run for 1500 ms, core0 starved by task3 (prio 5)"
+int wdt_sup_format_stall(const wdt_sup_stall_t *stall, char *buf, int size){
+  const char *diag = stall->diag == WDT_SUP_DIAG_TIMEOUT ? "timeout" : "warn";
+  long long ms = stall->elapsed_us / 1000;
+  if (stall->starved_core < 0 || stall->starved_core >= WDT_SUP_NUM_CORES) {
+    return snprintf(buf, size, "%s: %s not reset for %lld ms", diag, stall->name, ms);
+  }
+  const wdt_sup_core_snapshot_t *snap = &stall->cores[stall->starved_core];
+  if (snap->task_name[0] == '\0') {
+    return snprintf(buf, size, "%s: %s not run for %lld ms, core%d starved", diag, stall->name, ms, stall->starved_core);
+  }
+  return snprintf(buf, size, "%s: %s not run for %lld ms, core%d starved by %s (prio %lu)", diag, stall->name, ms,
+    stall->starved_core, snap->task_name, (unsigned long)snap->priority);
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// タスクWDTのスーパーバイザ（ロジック部分）
+// タスク/ユーザー毎にハートビート(リセット)の間隔を記録して、
+// WDTが発動する前(警告閾値)とタイムアウトを過ぎたときに、各コアで実行中のタスクとスタック残量を記録する
+// アイドルタスク(TWDTのidle_core_maskと同じ)も登録でき、アイドルが動けないときはそのコアの飢餓状態として診断する
+// ESP-IDFに依存しないので、時計(clock)とスナップショット関数を差し替えればホストでも動く
+// スレッドセーフではないので、呼び出し側で排他すること(wdt_supervisor_port.cで排他している)
+
+#define WDT_SUP_MAX_ENTRIES 16
+#define WDT_SUP_MAX_STALLS  8
+#define WDT_SUP_NAME_LEN    16
+#define WDT_SUP_NUM_CORES   2
+
+typedef enum {
+  WDT_SUP_KIND_TASK, // esp_task_wdt_add()で登録したタスク
+  WDT_SUP_KIND_USER, // esp_task_wdt_add_user()で登録した論理ユーザー
+  WDT_SUP_KIND_IDLE, // アイドルタスク(アイドルフックからfeedする)
+} wdt_sup_kind_t;
+
+typedef enum {
+  WDT_SUP_DIAG_WARN,    // 警告閾値を超えた(まだTWDTは発動していない)
+  WDT_SUP_DIAG_TIMEOUT, // タイムアウトを超えた(TWDTが発動している)
+} wdt_sup_diag_t;
+
+typedef struct {
+  char name[WDT_SUP_NAME_LEN];
+  wdt_sup_kind_t kind;
+  void *handle;             // TaskHandle_t or esp_task_wdt_user_handle_t (IDLEはNULL)
+  int core;                 // IDLEのコア、それ以外は-1
+  bool in_use;
+  int stalled;              // 現在の周期で記録済みの段階(0:なし 1:警告 2:タイムアウト)
+  int64_t last_reset_us;
+  int64_t max_interval_us;  // リセット間隔の最大値
+  int64_t total_interval_us;
+  uint32_t reset_count;
+  uint32_t stall_count;
+} wdt_sup_entry_t;
+
+// 警告時点で各コアで実行中だったタスク
+typedef struct {
+  char task_name[WDT_SUP_NAME_LEN];
+  uint32_t stack_high_water_mark; // [bytes]
+  uint32_t priority;
+} wdt_sup_core_snapshot_t;
+
+typedef struct {
+  int64_t time_us;
+  int entry_id;
+  char name[WDT_SUP_NAME_LEN]; // 記録したときのエントリーの名前
+  wdt_sup_diag_t diag;
+  int starved_core;         // アイドルタスクが動けなかったコア、それ以外は-1
+  int64_t elapsed_us;       // 最後のリセットからの経過時間
+  wdt_sup_core_snapshot_t cores[WDT_SUP_NUM_CORES];
+} wdt_sup_stall_t;
+
+typedef int64_t (*wdt_sup_clock_fn)(void);
+typedef void (*wdt_sup_snapshot_fn)(wdt_sup_stall_t *stall);
+
+typedef struct {
+  uint32_t timeout_ms;      // TWDTのタイムアウト
+  uint32_t warn_percent;    // タイムアウトの何%経過で警告するか
+  wdt_sup_clock_fn clock;
+  wdt_sup_snapshot_fn snapshot; // NULLならコア情報を記録しない
+} wdt_sup_config_t;
+
+void wdt_sup_init(const wdt_sup_config_t *config);
+// 登録、エントリーIDを返す。空きがなければ-1
+int wdt_sup_register(const char *name, wdt_sup_kind_t kind, void *handle);
+// アイドルタスクを登録する(名前はIDLE<core>)
+int wdt_sup_register_idle(int core);
+void wdt_sup_unregister(int id);
+int wdt_sup_find(wdt_sup_kind_t kind, void *handle);
+// ハートビート、前回からの間隔[us]を返す
+int64_t wdt_sup_feed(int id);
+// 警告閾値、タイムアウトを超えたエントリーを調べて記録する、新たに記録した件数を返す
+// 1回のリセット間隔で警告とタイムアウトをそれぞれ1回ずつ記録する
+int wdt_sup_check(void);
+
+const wdt_sup_entry_t *wdt_sup_get_entry(int id);
+// 記録したストール、新しい順にindex=0,1,...
+const wdt_sup_stall_t *wdt_sup_get_stall(int index);
+int wdt_sup_stall_count(void);
+// 診断を1行の文字列にする(コア情報が埋まっていれば原因のタスクも書く)。書いた長さを返す
+int wdt_sup_format_stall(const wdt_sup_stall_t *stall, char *buf, int size);
@@ -0,0 +1,208 @@
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_task_wdt.h>
+#include <esp_timer.h>
+#include <esp_freertos_hooks.h>
+#include "esp_log.h"
+#include "wdt_supervisor_port.h"
+
+static const char *TAG = "wdt_sup";
+
+static portMUX_TYPE sup_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t supervisor_task_handle = NULL;
+static uint32_t supervisor_period_ms = 100;
+
+// 各コアで最後に実行されていたタスク(監視タスク自身は除く)
+// Tickフックで記録するので、監視タスクが動いている側のコアでも
+// 直前まで実行されていたタスクがわかる
+static volatile TaskHandle_t last_running[WDT_SUP_NUM_CORES];
+// アイドルタスクのエントリーID(登録していないコアは-1)
+static int idle_ids[WDT_SUP_NUM_CORES] = {-1, -1};
+
+static void IRAM_ATTR tick_hook_core0(void){
+  TaskHandle_t cur = xTaskGetCurrentTaskHandle();
+  if (cur != supervisor_task_handle) {
+    last_running[0] = cur;
+  }
+}
+static void IRAM_ATTR tick_hook_core1(void){
+  TaskHandle_t cur = xTaskGetCurrentTaskHandle();
+  if (cur != supervisor_task_handle) {
+    last_running[1] = cur;
+  }
+}
+
+// アイドルタスクが動いたらfeedする(TWDTがidle_core_maskで見ているのと同じ)
+// 高い優先度のタスクがコアを占有していると呼ばれなくなり、飢餓状態として記録される
+static bool idle_hook(int core){
+  taskENTER_CRITICAL(&sup_lock);
+  wdt_sup_feed(idle_ids[core]);
+  taskEXIT_CRITICAL(&sup_lock);
+  return true;
+}
+static bool idle_hook_core0(void){
+  return idle_hook(0);
+}
+static bool idle_hook_core1(void){
+  return idle_hook(1);
+}
+
+static int64_t sup_clock(void){
+  return esp_timer_get_time();
+}
+
+// ※記録対象のタスクがvTaskDelete()された直後だとハンドルが無効になるので、
+//   タスクを削除するプログラムではwdt_supervisorを使わないこと
+static void sup_snapshot(wdt_sup_core_snapshot_t *cores){
+  memset(cores, 0, sizeof(wdt_sup_core_snapshot_t) * WDT_SUP_NUM_CORES);
+  for (int core = 0; core < WDT_SUP_NUM_CORES; core++) {
+    TaskHandle_t task = last_running[core];
+    wdt_sup_core_snapshot_t *snap = &cores[core];
+    if (task == NULL) {
+      continue;
+    }
+    strncpy(snap->task_name, pcTaskGetName(task), WDT_SUP_NAME_LEN - 1);
+    snap->stack_high_water_mark = uxTaskGetStackHighWaterMark(task);
+    snap->priority = uxTaskPriorityGet(task);
+  }
+}
+
+static void log_stall(const wdt_sup_stall_t *stall){
+  char line[128];
+  wdt_sup_format_stall(stall, line, sizeof(line));
+  ESP_LOGE(TAG, "%s", line);
+  for (int core = 0; core < WDT_SUP_NUM_CORES; core++) {
+    const wdt_sup_core_snapshot_t *snap = &stall->cores[core];
+    ESP_LOGE(TAG, "  core%d: running=%s prio=%lu stack_hwm=%lu", core,
+      snap->task_name[0] ? snap->task_name : "-", snap->priority, snap->stack_high_water_mark);
+  }
+}
+
+static void supervisor_task(void *pvParameters){
+  static wdt_sup_stall_t found_stalls[WDT_SUP_MAX_STALLS];
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(supervisor_period_ms));
+    // スナップショットはロック外で取る(uxTaskGetStackHighWaterMarkがクリティカルセクション内で呼べないため)
+    // checkで警告対象を確定してコピーし、コア情報はロックを取り直して記録済みのストールに書き戻す
+    // (ストールを書くのはこのタスクのwdt_sup_check()だけなので、その間にリングの位置は変わらない)
+    taskENTER_CRITICAL(&sup_lock);
+    int found = wdt_sup_check();
+    if (found > WDT_SUP_MAX_STALLS) {
+      found = WDT_SUP_MAX_STALLS;
+    }
+    for (int i = 0; i < found; i++) {
+      found_stalls[i] = *wdt_sup_get_stall(i);
+    }
+    taskEXIT_CRITICAL(&sup_lock);
+    for (int i = found - 1; i >= 0; i--) {
+      wdt_sup_core_snapshot_t cores[WDT_SUP_NUM_CORES];
+      sup_snapshot(cores);
+      taskENTER_CRITICAL(&sup_lock);
+      wdt_sup_stall_t *stall = (wdt_sup_stall_t *)wdt_sup_get_stall(i);
+      memcpy(stall->cores, cores, sizeof(cores));
+      taskEXIT_CRITICAL(&sup_lock);
+      memcpy(found_stalls[i].cores, cores, sizeof(cores));
+      log_stall(&found_stalls[i]);
+    }
+  }
+}
+
+void wdt_supervisor_start(uint32_t timeout_ms, uint32_t idle_core_mask){
+  // app_main毎にinitし直さず、ここで1回だけ(再)初期化する
+  // 既にinitされているので一旦解除しないとエラーになる
+  ESP_ERROR_CHECK(esp_task_wdt_deinit());
+  esp_task_wdt_config_t twdt_config = {
+    .timeout_ms = timeout_ms,
+    .idle_core_mask = idle_core_mask,
+    .trigger_panic = false,
+  };
+  ESP_ERROR_CHECK(esp_task_wdt_init(&twdt_config));
+
+  wdt_sup_config_t config = {
+    .timeout_ms = timeout_ms,
+    .warn_percent = 75,
+    .clock = sup_clock,
+    .snapshot = NULL, // 監視タスク側で取る
+  };
+  wdt_sup_init(&config);
+  // タイムアウトの1/10毎にチェックする
+  supervisor_period_ms = timeout_ms / 10 > 0 ? timeout_ms / 10 : 1;
+
+  ESP_ERROR_CHECK(esp_register_freertos_tick_hook_for_cpu(tick_hook_core0, 0));
+  ESP_ERROR_CHECK(esp_register_freertos_tick_hook_for_cpu(tick_hook_core1, 1));
+  // TWDTが見ているコアのアイドルタスクを登録する
+  static const esp_freertos_idle_cb_t idle_hooks[WDT_SUP_NUM_CORES] = {idle_hook_core0, idle_hook_core1};
+  for (int core = 0; core < WDT_SUP_NUM_CORES; core++) {
+    if ((idle_core_mask & (1 << core)) == 0) {
+      continue;
+    }
+    taskENTER_CRITICAL(&sup_lock);
+    idle_ids[core] = wdt_sup_register_idle(core);
+    taskEXIT_CRITICAL(&sup_lock);
+    ESP_ERROR_CHECK(esp_register_freertos_idle_hook_for_cpu(idle_hooks[core], core));
+  }
+  // 飢餓状態のタスクより先に動けるように高い優先度にする
+  xTaskCreatePinnedToCore(supervisor_task, "wdt_sup", 4096, NULL, configMAX_PRIORITIES - 2, &supervisor_task_handle, PRO_CPU_NUM);
+}
+
+int wdt_supervisor_add_task(void){
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  ESP_ERROR_CHECK(esp_task_wdt_add(task));
+  taskENTER_CRITICAL(&sup_lock);
+  int id = wdt_sup_register(pcTaskGetName(task), WDT_SUP_KIND_TASK, task);
+  taskEXIT_CRITICAL(&sup_lock);
+  return id;
+}
+
+int wdt_supervisor_add_user(const char *name){
+  esp_task_wdt_user_handle_t user = NULL;
+  ESP_ERROR_CHECK(esp_task_wdt_add_user(name, &user));
+  taskENTER_CRITICAL(&sup_lock);
+  int id = wdt_sup_register(name, WDT_SUP_KIND_USER, user);
+  taskEXIT_CRITICAL(&sup_lock);
+  return id;
+}
+
+void wdt_supervisor_reset(int id){
+  const wdt_sup_entry_t *e = wdt_sup_get_entry(id);
+  if (e == NULL) {
+    return;
+  }
+  if (e->kind == WDT_SUP_KIND_USER) {
+    esp_task_wdt_reset_user((esp_task_wdt_user_handle_t)e->handle);
+  } else {
+    esp_task_wdt_reset();
+  }
+  taskENTER_CRITICAL(&sup_lock);
+  wdt_sup_feed(id);
+  taskEXIT_CRITICAL(&sup_lock);
+}
+
+// 書き込む側(feed、check、スナップショットの書き戻し)と同じロックの中でコピーしてからログに出す
+void wdt_supervisor_dump(void){
+  static wdt_sup_stall_t stall_copy[WDT_SUP_MAX_STALLS];
+  for (int i = 0; i < WDT_SUP_MAX_ENTRIES; i++) {
+    taskENTER_CRITICAL(&sup_lock);
+    const wdt_sup_entry_t *p = wdt_sup_get_entry(i);
+    wdt_sup_entry_t e;
+    if (p != NULL) {
+      e = *p;
+    }
+    taskEXIT_CRITICAL(&sup_lock);
+    if (p == NULL) {
+      continue;
+    }
+    ESP_LOGI(TAG, "%-16s resets=%lu avg=%lld ms max=%lld ms stalls=%lu", e.name, e.reset_count,
+      e.reset_count ? e.total_interval_us / e.reset_count / 1000 : 0, e.max_interval_us / 1000, e.stall_count);
+  }
+  taskENTER_CRITICAL(&sup_lock);
+  int count = wdt_sup_stall_count();
+  for (int i = 0; i < count; i++) {
+    stall_copy[i] = *wdt_sup_get_stall(i);
+  }
+  taskEXIT_CRITICAL(&sup_lock);
+  for (int i = 0; i < count; i++) {
+    log_stall(&stall_copy[i]);
+  }
+}
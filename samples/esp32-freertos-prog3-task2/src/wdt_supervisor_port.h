@@ -0,0 +1,19 @@
+#pragma once
+#include <esp_task_wdt.h>
+#include "wdt_supervisor.h"
+
+// wdt_supervisorのESP-IDF側
+// TWDTの初期化、タスク/ユーザーの登録とリセットをまとめて行い、
+// 監視タスクで警告閾値、タイムアウトを超えたものをログに出す
+// idle_core_maskのコアのアイドルタスクもアイドルフックで監視して、動けなければ飢餓状態として原因のタスクを出す
+
+// TWDTを(再)初期化して監視タスクを開始する
+void wdt_supervisor_start(uint32_t timeout_ms, uint32_t idle_core_mask);
+// 呼び出し元タスクをTWDTに登録する
+int wdt_supervisor_add_task(void);
+// 論理ユーザーをTWDTに登録する
+int wdt_supervisor_add_user(const char *name);
+// TWDTをリセットして、ハートビートを記録する
+void wdt_supervisor_reset(int id);
+// 各エントリーのリセット間隔と、記録したストールをログに出す
+void wdt_supervisor_dump(void);
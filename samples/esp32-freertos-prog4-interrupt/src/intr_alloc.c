@@ -0,0 +1,107 @@
+#include "intr_alloc.h"
+#include <string.h>
+
+// 負荷の大きい順に並べる、挿入ソート
+static void sort_by_load(const ia_request_t *requests, int *order, int n){
+  for (int i = 1; i < n; i++) {
+    int key = order[i];
+    int j = i - 1;
+    while (j >= 0 && requests[order[j]].load_permille < requests[key].load_permille) {
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = key;
+  }
+}
+
+int ia_plan(const ia_request_t *requests, int num, const ia_config_t *config, ia_plan_t *plans, ia_summary_t *summary){
+  if (requests == NULL || config == NULL || plans == NULL || summary == NULL || num < 0 || num > IA_MAX_SOURCES) {
+    return -1;
+  }
+  memset(summary, 0, sizeof(*summary));
+
+  // コア指定のあるものを先に置く
+  int order[IA_MAX_SOURCES];
+  int num_any = 0;
+  for (int i = 0; i < num; i++) {
+    const ia_request_t *r = &requests[i];
+    ia_plan_t *p = &plans[i];
+    p->core = r->core;
+    p->status = IA_OK;
+    if (r->level > IA_LEVEL_MAX) {
+      p->status = IA_ERR_LEVEL;
+    } else if (r->core == IA_CORE_ANY) {
+      order[num_any++] = i;
+      continue;
+    } else if (r->core < 0 || r->core >= IA_NUM_CORES) {
+      p->status = IA_ERR_CORE;
+    } else if (config->avoid_core_mask & (1u << r->core)) {
+      p->status = IA_ERR_AVOIDED;
+    }
+    if (p->status == IA_OK) {
+      summary->load_permille[r->core] += r->load_permille;
+    } else {
+      p->core = IA_CORE_ANY;
+    }
+  }
+
+  // 残りは負荷の大きい順に、空いているコアへ
+  sort_by_load(requests, order, num_any);
+  for (int k = 0; k < num_any; k++) {
+    int i = order[k];
+    int best = -1;
+    for (int c = 0; c < IA_NUM_CORES; c++) {
+      if (config->avoid_core_mask & (1u << c)) {
+        continue;
+      }
+      if (best < 0 || summary->load_permille[c] < summary->load_permille[best]) {
+        best = c;
+      }
+    }
+    if (best < 0) {
+      plans[i].status = IA_ERR_NO_CORE;
+      continue;
+    }
+    plans[i].core = (int8_t)best;
+    summary->load_permille[best] += requests[i].load_permille;
+  }
+
+  for (int i = 0; i < num; i++) {
+    if (plans[i].status != IA_OK) {
+      summary->errors++;
+    }
+  }
+  for (int c = 0; c < IA_NUM_CORES; c++) {
+    if (config->capacity_permille > 0 && summary->load_permille[c] > config->capacity_permille) {
+      summary->overloaded = true;
+    }
+  }
+  return 0;
+}
+
+void ia_map_init(ia_map_t *map, const ia_plan_t *plans, int num){
+  memset(map, 0, sizeof(*map));
+  map->num = num;
+  for (int i = 0; i < num; i++) {
+    ia_entry_t *e = &map->entries[i];
+    e->planned_core = plans[i].core;
+    e->registered_core = -1;
+    e->observed_core = -1;
+  }
+}
+
+void ia_map_registered(ia_map_t *map, int index, int core, int err){
+  map->entries[index].registered_core = (int8_t)core;
+  map->entries[index].registered_err = err;
+}
+
+int ia_map_mismatches(const ia_map_t *map){
+  int n = 0;
+  for (int i = 0; i < map->num; i++) {
+    const ia_entry_t *e = &map->entries[i];
+    if (e->registered_err != 0 || e->registered_core != e->planned_core || e->moved) {
+      n++;
+    }
+  }
+  return n;
+}
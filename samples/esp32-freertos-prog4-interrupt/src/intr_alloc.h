@@ -0,0 +1,82 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// 割込みのコアとレベルの割り当て（ロジック部分）
+//
+// ESP32の割込みは、登録(gpio_install_isr_service、timer_isr_callback_add、gptimer_register_event_callbacksなど)を
+// 呼んだタスクのコアに割り当てられる。どこで動くかは、たまたまどのコアのタスクが登録したか次第になる
+// 割込み表(コア指定、レベル、負荷の見積もり)から
+//   1. コア指定のないものを、避けるコア(Wi-Fi、micro-ROSなどを動かすコア)以外で負荷が均等になるように割り当てる
+//   2. レベルがCのハンドラで使える範囲(1～3)か、コアの負荷が上限を超えないかを確認する
+// 実際の登録は、割り当てたコアに固定したタスクから行う(intr_alloc_port.c)
+// 登録したコアと割込みが動いたコアはマップに記録して、計画と違えば報告する
+// ESP-IDFに依存しないので、ホストでも確認できる
+
+#define IA_NUM_CORES   2
+#define IA_MAX_SOURCES 16
+#define IA_CORE_ANY    (-1)
+#define IA_LEVEL_MAX   3        // Cで書いたハンドラを使えるレベルの上限(4以上はアセンブラ)
+
+typedef struct {
+  const char *name;
+  int8_t core;               // PRO_CPU_NUM, APP_CPU_NUM, IA_CORE_ANY
+  uint8_t level;             // 1～IA_LEVEL_MAX、0ならドライバの既定
+  uint16_t load_permille;    // 見積もった割込みの負荷(頻度×処理時間)[‰]
+} ia_request_t;
+
+typedef struct {
+  uint8_t avoid_core_mask;   // コア指定のない割込みを置かないコア(bit0=コア0)
+  uint16_t capacity_permille;// コア毎の割込み負荷の上限(0なら見ない)
+} ia_config_t;
+
+typedef enum {
+  IA_OK,
+  IA_ERR_LEVEL,              // レベルが範囲外
+  IA_ERR_CORE,               // コア番号が範囲外
+  IA_ERR_AVOIDED,            // 避けるコアを指定している
+  IA_ERR_NO_CORE,            // 置けるコアがない(すべて避けるコア)
+} ia_status_t;
+
+typedef struct {
+  int8_t core;
+  ia_status_t status;
+} ia_plan_t;
+
+typedef struct {
+  uint32_t load_permille[IA_NUM_CORES];
+  int errors;                // IA_OK以外の数
+  bool overloaded;           // どれかのコアがcapacity_permilleを超える
+} ia_summary_t;
+
+// 計画を立てる。引数が不正なら-1、それ以外は0を返す(問題があるかはsummaryで確認する)
+int ia_plan(const ia_request_t *requests, int num, const ia_config_t *config, ia_plan_t *plans, ia_summary_t *summary);
+
+// 実行時のマップ
+typedef struct {
+  int8_t planned_core;
+  int8_t registered_core;    // 登録したタスクのコア(-1なら未登録)
+  int registered_err;        // 登録の結果(esp_err_t)
+  volatile int8_t observed_core; // 割込みが動いたコア(-1ならまだ動いていない)
+  volatile uint32_t count;
+  volatile bool moved;       // 割込みが計画と違うコアで動いたことがある
+} ia_entry_t;
+
+typedef struct {
+  int num;
+  ia_entry_t entries[IA_MAX_SOURCES];
+} ia_map_t;
+
+void ia_map_init(ia_map_t *map, const ia_plan_t *plans, int num);
+void ia_map_registered(ia_map_t *map, int index, int core, int err);
+// 割込みから呼ぶ(IRAMのハンドラに展開されるようにインラインにしている)
+static inline void ia_map_fired(ia_map_t *map, int index, int core){
+  ia_entry_t *e = &map->entries[index];
+  e->observed_core = (int8_t)core;
+  e->count++;
+  if (core != e->planned_core) {
+    e->moved = true;
+  }
+}
+// 計画と違うもの(登録失敗、違うコアで登録、違うコアで動いた)の数
+int ia_map_mismatches(const ia_map_t *map);
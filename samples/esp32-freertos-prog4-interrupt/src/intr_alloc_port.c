@@ -0,0 +1,126 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_attr.h"
+#include "esp_intr_alloc.h"
+#include "intr_alloc_port.h"
+
+#define REGISTER_TASK_STACK    4096
+#define REGISTER_TASK_PRIORITY 10
+
+static const char *TAG = "intr_alloc";
+
+static const ia_source_t *table;
+static DRAM_ATTR ia_map_t map;
+
+typedef struct {
+  int core;
+  TaskHandle_t caller;
+  esp_err_t err;
+} register_job_t;
+
+static int intr_flags_of(const ia_source_t *s){
+  int flags = 0;
+  if (s->request.level > 0) {
+    flags |= ESP_INTR_FLAG_LEVEL1 << (s->request.level - 1);
+  }
+  if (s->iram) {
+    flags |= ESP_INTR_FLAG_IRAM;
+  }
+  return flags;
+}
+
+// 割り当てたコアに固定して動く。割込みはこのタスクのコアに割り当てられる
+static void register_task(void *arg){
+  register_job_t *job = (register_job_t *)arg;
+  int core = esp_cpu_get_core_id();
+  for (int i = 0; i < map.num; i++) {
+    if (map.entries[i].planned_core != job->core) {
+      continue;
+    }
+    const ia_source_t *s = &table[i];
+    esp_err_t err = s->setup(intr_flags_of(s), s->arg);
+    ia_map_registered(&map, i, core, err);
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "%s: setup failed on core %d (%s)", s->request.name, core, esp_err_to_name(err));
+      if (job->err == ESP_OK) {
+        job->err = err;
+      }
+    }
+  }
+  xTaskNotifyGive(job->caller);
+  vTaskDelete(NULL);
+}
+
+esp_err_t ia_port_start(const ia_source_t *sources, int num, const ia_config_t *config){
+  ia_request_t requests[IA_MAX_SOURCES];
+  ia_plan_t plans[IA_MAX_SOURCES];
+  ia_summary_t summary;
+
+  if (num > IA_MAX_SOURCES) {
+    ESP_LOGE(TAG, "too many sources");
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < num; i++) {
+    requests[i] = sources[i].request;
+  }
+  if (ia_plan(requests, num, config, plans, &summary) != 0) {
+    ESP_LOGE(TAG, "invalid interrupt table");
+    return ESP_ERR_INVALID_ARG;
+  }
+  static const char *status_names[] = {"", " BAD_LEVEL", " BAD_CORE", " AVOIDED_CORE", " NO_CORE"};
+  ESP_LOGI(TAG, "%-20s %4s %5s %8s %4s", "name", "want", "level", "load[‰]", "core");
+  for (int i = 0; i < num; i++) {
+    const ia_request_t *r = &requests[i];
+    ESP_LOGI(TAG, "%-20s %4d %5u %8u %4d%s", r->name, r->core, r->level, r->load_permille, plans[i].core,
+      status_names[plans[i].status]);
+  }
+  ESP_LOGI(TAG, "load core0=%lu core1=%lu [permille], avoid mask=0x%x", summary.load_permille[0], summary.load_permille[1],
+    config->avoid_core_mask);
+  if (summary.errors > 0 || summary.overloaded) {
+    ESP_LOGE(TAG, "interrupt table is not allocatable (errors=%d overloaded=%d)", summary.errors, summary.overloaded);
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  table = sources;
+  ia_map_init(&map, plans, num);
+  esp_err_t result = ESP_OK;
+  // コア毎に順番に登録する(呼んだタスクは登録が終わるまで待つ)
+  for (int core = 0; core < IA_NUM_CORES; core++) {
+    bool used = false;
+    for (int i = 0; i < num; i++) {
+      used |= plans[i].core == core;
+    }
+    if (!used) {
+      continue;
+    }
+    register_job_t job = {.core = core, .caller = xTaskGetCurrentTaskHandle(), .err = ESP_OK};
+    if (xTaskCreatePinnedToCore(register_task, "ia_register", REGISTER_TASK_STACK, &job,
+        REGISTER_TASK_PRIORITY, NULL, core) != pdPASS) {
+      ESP_LOGE(TAG, "failed to create register task on core %d", core);
+      return ESP_ERR_NO_MEM;
+    }
+    // jobはこのスタックにあるので、終わるまで待つ
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (result == ESP_OK) {
+      result = job.err;
+    }
+  }
+  return result;
+}
+
+void IRAM_ATTR ia_port_fired(int index){
+  ia_map_fired(&map, index, esp_cpu_get_core_id());
+}
+
+int ia_port_log_map(void){
+  ESP_LOGI(TAG, "%-20s %7s %10s %8s %8s", "name", "planned", "registered", "observed", "count");
+  for (int i = 0; i < map.num; i++) {
+    const ia_entry_t *e = &map.entries[i];
+    bool bad = e->registered_err != ESP_OK || e->registered_core != e->planned_core || e->moved;
+    ESP_LOGI(TAG, "%-20s %7d %10d %8d %8lu%s", table[i].request.name, e->planned_core, e->registered_core,
+      e->observed_core, e->count, bad ? " MISMATCH" : "");
+  }
+  return ia_map_mismatches(&map);
+}
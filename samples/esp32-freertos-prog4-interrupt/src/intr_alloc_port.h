@@ -0,0 +1,29 @@
+#pragma once
+#include "esp_err.h"
+#include "intr_alloc.h"
+
+// intr_allocのESP-IDF側
+// 割込み表の計画をログに出し、問題がなければコア毎に固定したタスクを作って、その中で各割込みの登録関数を呼ぶ
+// 登録関数にはレベルとIRAMのESP_INTR_FLAG_*を渡すので、gpio_install_isr_service()や
+// timer_isr_callback_add()のintr_alloc_flagsにそのまま使う
+// (gptimer、pcntなどの新しいドライバはレベルを指定できないので、コアだけが効く)
+// ハンドラの先頭でia_port_fired()を呼ぶと、実際に動いたコアがマップに記録される
+
+typedef esp_err_t (*ia_setup_fn)(int intr_flags, void *arg);
+
+typedef struct {
+  ia_request_t request;
+  ia_setup_fn setup;         // 割り当てたコアのタスクから呼ぶ
+  void *arg;
+  bool iram;                 // ESP_INTR_FLAG_IRAMを付ける(ハンドラと使うデータがIRAM/DRAMにある)
+} ia_source_t;
+
+// 計画に問題があれば登録せずにESP_ERR_INVALID_STATEを返す
+// 登録関数が失敗したら、最初のエラーを返す(他のコアの登録は行う)
+esp_err_t ia_port_start(const ia_source_t *sources, int num, const ia_config_t *config);
+
+// 割込みハンドラから呼ぶ(indexは表の順番)
+void ia_port_fired(int index);
+
+// 表、計画したコア、登録したコア、動いたコア、回数をログに出す。計画と違うものの数を返す
+int ia_port_log_map(void);
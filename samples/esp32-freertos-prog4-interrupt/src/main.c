@@ -7,29 +7,64 @@
 
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
+#include "task_planner_port.h"
+#include "driver/gptimer.h"
+#include "intr_alloc_port.h"
 static const char *TAG = "test1";
 
 #define TWDT_TIMEOUT_MS 2000
 
+// 割込み表の順番(ia_port_fired()に渡す)
+enum {
+  IA_GPIO_SERVICE,
+  IA_CONTROL_TICK,
+};
+
+#define CONTROL_TICK_US 1000
+
+// タスク表の順番
+enum {
+  TASK_CONTROL,
+  TASK_PRO,
+  TASK_APP,
+  TASK_PLAN_REPORT,
+  TASK_ONESHOT_INTERRUPT,
+  TASK_ONESHOT_BLINK,
+};
+
+static uint32_t task_period_ms(int index);
+
 void delay_ms(uint32_t ms)
 {
   vTaskDelay(ms / portTICK_PERIOD_MS);
 }
 
-void pro_task(void *pvParameters) {
+// 周期タスク
+// 周期とWCETはタスク表(task_table)にある。処理の中身の代わりにesp_rom_delay_usで決まった時間だけCPUを使う
+// 処理時間はplan_job_begin/plan_job_endで測って、表のWCETを超えたらログに出る
+typedef struct {
+  int index;          // タスク表の位置
+  uint32_t work_us;   // 1回分の処理時間
+} periodic_job_t;
+
+void periodic_task(void *pvParameters) {
+  const periodic_job_t *job = (const periodic_job_t *)pvParameters;
   ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
+  TickType_t last_wake = xTaskGetTickCount();
   while (1) {
-    ESP_LOGI(TAG, "pro_task");
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(task_period_ms(job->index)));
+    int64_t begin = plan_job_begin();
+    esp_rom_delay_us(job->work_us);
+    plan_job_end(job->index, begin);
     ESP_ERROR_CHECK(esp_task_wdt_reset());
-    delay_ms(5);
   }
 }
-void app_task(void *pvParameters) {
-  ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
+
+// 周期タスクの処理時間を5秒毎に出す(非周期タスクなので最低優先度)
+void plan_report_task(void *pvParameters) {
   while (1) {
-    ESP_LOGI(TAG, "app_task");
-    ESP_ERROR_CHECK(esp_task_wdt_reset());
-    delay_ms(5);
+    delay_ms(5000);
+    plan_log_wcet();
   }
 }
 
@@ -45,6 +80,7 @@ void app_task(void *pvParameters) {
 void IRAM_ATTR gpio_isr_edge_handler(void *arg)
 {
   uint32_t gpio_num = (uint32_t) arg;
+  ia_port_fired(IA_GPIO_SERVICE);
   // ESP_LOG*は割込み内では？使えない。エラーになる。
   esp_rom_printf("[interrupt!] GPIO=%lu, intr on core=%d, val=%d\n", gpio_num, esp_cpu_get_core_id(), gpio_get_level(gpio_num));
 }
@@ -69,8 +105,8 @@ void oneshot_interrupt_task(void *pvParameters){
   ESP_LOGI(TAG, "gpio_set_level end.");
   ESP_ERROR_CHECK(gpio_set_intr_type(num, GPIO_INTR_POSEDGE));
   ESP_LOGI(TAG, "gpio_set_intr_type end.");
-  ESP_ERROR_CHECK(gpio_install_isr_service(0));
-  ESP_LOGI(TAG, "gpio_install_isr_service end.");
+  // ISRサービスは割込み表(intr_table)でAPP_CPUにインストール済み
+  // ハンドラはどのコアから追加しても、サービスをインストールしたコアで動く
   ESP_ERROR_CHECK(gpio_isr_handler_add(num, gpio_isr_edge_handler, (void *)num));
   ESP_LOGI(TAG, "gpio_isr_handler_add end.");
   ESP_ERROR_CHECK(gpio_set_level(num, 1));
@@ -79,8 +115,10 @@ void oneshot_interrupt_task(void *pvParameters){
 
   ESP_ERROR_CHECK(gpio_isr_handler_remove(num));
   ESP_LOGI(TAG, "gpio_isr_handler_remove end.");
-  gpio_uninstall_isr_service();
-  ESP_LOGI(TAG, "gpio_uninstall_isr_service end.");
+  // 割込みが計画したコアで動いたか
+  if (ia_port_log_map() != 0) {
+    ESP_LOGE(TAG, "interrupt map differs from the plan");
+  }
   ESP_LOGI(TAG, "<=== oneshot_interrupt_task end");
   vTaskDelete(NULL);  
 }
@@ -125,6 +163,82 @@ void oneshot_blink(void *pvParameters){
 }
 
 
+//------------------------
+// 割込み表
+//------------------------
+static bool IRAM_ATTR control_tick_callback(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx){
+  // 制御ループの処理はここ。回数はマップに記録される
+  ia_port_fired(IA_CONTROL_TICK);
+  return false;
+}
+
+static esp_err_t gpio_service_setup(int intr_flags, void *arg){
+  return gpio_install_isr_service(intr_flags);
+}
+
+// gptimerの割込みはコールバックを登録したコアに割り当てられる(レベルはドライバが決める)
+static esp_err_t control_tick_setup(int intr_flags, void *arg){
+  gptimer_handle_t timer = NULL;
+  gptimer_config_t config = {
+    .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+    .direction = GPTIMER_COUNT_UP,
+    .resolution_hz = 1000000,
+  };
+  esp_err_t err = gptimer_new_timer(&config, &timer);
+  if (err != ESP_OK) {
+    return err;
+  }
+  gptimer_event_callbacks_t callbacks = {
+    .on_alarm = control_tick_callback,
+  };
+  gptimer_alarm_config_t alarm = {
+    .reload_count = 0,
+    .alarm_count = CONTROL_TICK_US,
+    .flags.auto_reload_on_alarm = true,
+  };
+  ESP_ERROR_CHECK(gptimer_register_event_callbacks(timer, &callbacks, NULL));
+  ESP_ERROR_CHECK(gptimer_set_alarm_action(timer, &alarm));
+  ESP_ERROR_CHECK(gptimer_enable(timer));
+  return gptimer_start(timer);
+}
+
+// 割込みのコアとレベル。コア指定なしはintr_configの避けるコア以外で負荷が均等になるように置く
+// load_permilleは頻度×処理時間の見積もり。gpio_isr_edge_handlerはフラッシュの関数を呼ぶのでIRAMにしない
+static const ia_source_t intr_table[] = {
+  [IA_GPIO_SERVICE] = {{"gpio_isr_service", APP_CPU_NUM, 1, 5}, gpio_service_setup, NULL, false},
+  [IA_CONTROL_TICK] = {{"control_tick", IA_CORE_ANY, 0, 20}, control_tick_setup, NULL, false},
+};
+
+// PRO_CPUはWi-Fi、micro-ROSなどを動かすコアとして空けておく
+// host-simのcheck_prog4_intrで同じ表を計画している
+static const ia_config_t intr_config = {
+  .avoid_core_mask = 1u << PRO_CPU_NUM,
+  .capacity_permille = 300,
+};
+
+// タスク表
+// 優先度とコアはplan_start()で決める(affinityはヒント、指定した場合はそのコアに固定)
+// wcet_usは処理時間(work_us)に割込みとログの分の余裕を足したもの。実機のplan_log_wcet()の値を見て更新する
+// 周期0は非周期タスクで最低優先度になる
+// 利用率は50 + 50 + 70 = 170‰、host-simのcheck_prog4_planで同じ解析を確かめている
+static const periodic_job_t control_job = {TASK_CONTROL, 30};
+static const periodic_job_t pro_job = {TASK_PRO, 200};
+static const periodic_job_t app_job = {TASK_APP, 600};
+
+static const plan_task_t task_table[] = {
+  // name, fn, arg, stack, period_us, deadline_us, wcet_us, affinity
+  [TASK_CONTROL] = {"control_task", periodic_task, (void *)&control_job, 4096, 1000, 0, 50, PLAN_AFFINITY_ANY},
+  [TASK_PRO] = {"pro_task", periodic_task, (void *)&pro_job, 4096, 5000, 0, 250, PLAN_AFFINITY_ANY},
+  [TASK_APP] = {"app_task", periodic_task, (void *)&app_job, 4096, 10000, 0, 700, PLAN_AFFINITY_ANY},
+  [TASK_PLAN_REPORT] = {"plan_report", plan_report_task, NULL, 4096, 0, 0, 0, PLAN_AFFINITY_ANY},
+  [TASK_ONESHOT_INTERRUPT] = {"oneshot_interrupt_task", oneshot_interrupt_task, NULL, 8192, 0, 0, 0, APP_CPU_NUM},
+  [TASK_ONESHOT_BLINK] = {"oneshot_blink", oneshot_blink, NULL, 8192, 0, 0, 0, PRO_CPU_NUM},
+};
+
+static uint32_t task_period_ms(int index){
+  return task_table[index].period_us / 1000;
+}
+
 void app_main()
 {
   ESP_LOGI(TAG, "app_main start ===>");
@@ -142,11 +256,10 @@ void app_main()
     .trigger_panic = false,
   };
   ESP_ERROR_CHECK(esp_task_wdt_init(&twdt_config));
-  //xTaskCreatePinnedToCore(pro_task, "pro_task", 8192, NULL, 1, NULL, PRO_CPU_NUM);
-  //xTaskCreatePinnedToCore(app_task, "app_task", 8192, NULL, 1, NULL, APP_CPU_NUM);
-  xTaskCreatePinnedToCore(oneshot_interrupt_task, "oneshot_interrupt_task", 8192, NULL, 1, NULL, APP_CPU_NUM);
-
-  xTaskCreatePinnedToCore(oneshot_blink, "oneshot_blink", 8192, NULL, 1, NULL, PRO_CPU_NUM);
+  // 割込みはタスクより先に、割り当てたコアで登録する
+  ESP_ERROR_CHECK(ia_port_start(intr_table, sizeof(intr_table) / sizeof(intr_table[0]), &intr_config));
+  // 起動時にスケジュール可能か確認してからタスクを作成する
+  ESP_ERROR_CHECK(plan_start(task_table, sizeof(task_table) / sizeof(task_table[0])));
   ESP_LOGI(TAG, "<=== app_main end");
 }
 
@@ -0,0 +1,185 @@
+#include "task_planner.h"
+#include <string.h>
+
+static uint32_t deadline_of(const plan_task_t *t){
+  return t->deadline_us ? t->deadline_us : t->period_us;
+}
+
+static uint32_t utilization_of(const plan_task_t *t){
+  return t->period_us ? (uint32_t)((uint64_t)t->wcet_us * 1000 / t->period_us) : 0;
+}
+
+// 優先度順(周期の短い順)に並べる、挿入ソート
+static void sort_by_period(const plan_task_t *tasks, int *order, int n){
+  for (int i = 1; i < n; i++) {
+    int key = order[i];
+    int j = i - 1;
+    while (j >= 0) {
+      const plan_task_t *a = &tasks[order[j]];
+      const plan_task_t *b = &tasks[key];
+      if (a->period_us < b->period_us || (a->period_us == b->period_us && deadline_of(a) <= deadline_of(b))) {
+        break;
+      }
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = key;
+  }
+}
+
+// 利用率の大きい順に並べる、コア指定ありのタスクを先にする
+static void sort_by_utilization(const plan_task_t *tasks, int *order, int n){
+  for (int i = 1; i < n; i++) {
+    int key = order[i];
+    int j = i - 1;
+    while (j >= 0) {
+      const plan_task_t *a = &tasks[order[j]];
+      const plan_task_t *b = &tasks[key];
+      bool a_pinned = a->affinity != PLAN_AFFINITY_ANY;
+      bool b_pinned = b->affinity != PLAN_AFFINITY_ANY;
+      if ((a_pinned && !b_pinned) || (a_pinned == b_pinned && utilization_of(a) >= utilization_of(b))) {
+        break;
+      }
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = key;
+  }
+}
+
+// 応答時間解析
+// R = C + Σ ceil(R / Tj) * Cj (同じコアで優先度が同じか高い周期タスクj)
+// 同じ優先度のタスクはラウンドロビンになるので、干渉するものとして扱う
+static bool response_time(const plan_task_t *tasks, const plan_result_t *results, const bool *assigned, int n, int i, uint32_t *response){
+  const plan_task_t *t = &tasks[i];
+  uint64_t deadline = deadline_of(t);
+  uint64_t r = t->wcet_us;
+  while (1) {
+    uint64_t next = t->wcet_us;
+    for (int j = 0; j < n; j++) {
+      if (j == i || !assigned[j] || tasks[j].period_us == 0) {
+        continue;
+      }
+      if (results[j].core != results[i].core || results[j].priority < results[i].priority) {
+        continue;
+      }
+      next += (r + tasks[j].period_us - 1) / tasks[j].period_us * tasks[j].wcet_us;
+    }
+    if (next > deadline) {
+      *response = next > UINT32_MAX ? UINT32_MAX : (uint32_t)next;
+      return false;
+    }
+    if (next == r) {
+      *response = (uint32_t)r;
+      return true;
+    }
+    r = next;
+  }
+}
+
+// coreに割り当て済みの周期タスクがすべてデッドラインを守れるか
+static bool core_schedulable(const plan_task_t *tasks, plan_result_t *results, const bool *assigned, int n, int core){
+  bool ok = true;
+  for (int i = 0; i < n; i++) {
+    if (!assigned[i] || tasks[i].period_us == 0 || results[i].core != core) {
+      continue;
+    }
+    results[i].schedulable = response_time(tasks, results, assigned, n, i, &results[i].response_us);
+    ok = ok && results[i].schedulable;
+  }
+  return ok;
+}
+
+int plan_tasks(const plan_task_t *tasks, int num_tasks, uint8_t base_priority, uint8_t max_priority,
+  plan_result_t *results, plan_summary_t *summary){
+  if (num_tasks <= 0 || num_tasks > PLAN_MAX_TASKS || max_priority <= base_priority) {
+    return -1;
+  }
+  int order[PLAN_MAX_TASKS];
+  bool assigned[PLAN_MAX_TASKS] = {0};
+  uint32_t util[PLAN_NUM_CORES] = {0};
+  int periodic = 0;
+
+  memset(results, 0, sizeof(plan_result_t) * num_tasks);
+  memset(summary, 0, sizeof(*summary));
+
+  //------------------------
+  // 1. 優先度(レートモノトニック)
+  //------------------------
+  for (int i = 0; i < num_tasks; i++) {
+    if (tasks[i].affinity < PLAN_AFFINITY_ANY || tasks[i].affinity >= PLAN_NUM_CORES) {
+      return -1;
+    }
+    if (tasks[i].period_us != 0) {
+      if (tasks[i].wcet_us == 0 || tasks[i].wcet_us > deadline_of(&tasks[i])) {
+        return -1;
+      }
+      order[periodic++] = i;
+    }
+    results[i].priority = base_priority;
+  }
+  sort_by_period(tasks, order, periodic);
+  // 周期の短い順にmax_priorityから下げていく、同じ周期は同じ優先度
+  // 段数が足りなければbase_priority + 1で打ち止め
+  int level = max_priority;
+  for (int k = 0; k < periodic; k++) {
+    if (k > 0 && tasks[order[k]].period_us != tasks[order[k - 1]].period_us && level > base_priority + 1) {
+      level--;
+    }
+    results[order[k]].priority = (uint8_t)level;
+  }
+
+  //------------------------
+  // 2. コア割り当て
+  //------------------------
+  sort_by_utilization(tasks, order, periodic);
+  for (int k = 0; k < periodic; k++) {
+    int i = order[k];
+    const plan_task_t *t = &tasks[i];
+    int best = -1;
+    if (t->affinity != PLAN_AFFINITY_ANY) {
+      best = t->affinity;
+    } else {
+      // 解析が通るコアのうち利用率の低い方、どちらも通らなければ利用率の低い方
+      bool best_ok = false;
+      for (int core = 0; core < PLAN_NUM_CORES; core++) {
+        results[i].core = core;
+        assigned[i] = true;
+        bool ok = core_schedulable(tasks, results, assigned, num_tasks, core);
+        assigned[i] = false;
+        if (best < 0 || (ok && !best_ok) || (ok == best_ok && util[core] < util[best])) {
+          best = core;
+          best_ok = ok;
+        }
+      }
+    }
+    results[i].core = best;
+    assigned[i] = true;
+    util[best] += utilization_of(t);
+  }
+  // 非周期タスクは負荷の低いコアへ
+  for (int i = 0; i < num_tasks; i++) {
+    if (tasks[i].period_us != 0) {
+      continue;
+    }
+    if (tasks[i].affinity != PLAN_AFFINITY_ANY) {
+      results[i].core = tasks[i].affinity;
+    } else {
+      results[i].core = util[0] <= util[1] ? 0 : 1;
+    }
+    results[i].schedulable = true;
+    assigned[i] = true;
+  }
+
+  //------------------------
+  // 3. スケジューラビリティ確認
+  //------------------------
+  summary->schedulable = true;
+  for (int core = 0; core < PLAN_NUM_CORES; core++) {
+    summary->utilization_permille[core] = util[core];
+    if (!core_schedulable(tasks, results, assigned, num_tasks, core)) {
+      summary->schedulable = false;
+    }
+  }
+  return 0;
+}
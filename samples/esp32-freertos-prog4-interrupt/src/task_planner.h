@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// タスクのコア配置と優先度の自動決定（ロジック部分）
+// タスク表(周期、デッドライン、実測WCET、コア指定)から
+//   1. 優先度をレートモノトニック(周期が短いほど高優先度)で割り当てる
+//   2. 2コアの負荷(利用率)が均等になるようにコアを割り当てる
+//   3. コア毎に応答時間解析をして、デッドラインを守れるか確認する
+// ESP-IDFに依存しないので、記録したWCETを入れてホストでも計画を確認できる
+
+#define PLAN_NUM_CORES 2
+#define PLAN_MAX_TASKS 16
+
+#define PLAN_AFFINITY_ANY (-1)
+
+typedef void (*plan_task_fn)(void *arg);
+
+typedef struct {
+  const char *name;
+  plan_task_fn fn;
+  void *arg;
+  uint32_t stack_size;
+  uint32_t period_us;    // 0なら非周期(バックグラウンド)、最低優先度で解析の対象外
+  uint32_t deadline_us;  // 0ならperiod_usと同じ
+  uint32_t wcet_us;      // 実測した最悪実行時間
+  int8_t affinity;       // PRO_CPU_NUM, APP_CPU_NUM, PLAN_AFFINITY_ANY
+} plan_task_t;
+
+typedef struct {
+  uint8_t priority;
+  int8_t core;
+  uint32_t response_us;  // 最悪応答時間、非周期タスクは0
+  bool schedulable;
+} plan_result_t;
+
+typedef struct {
+  uint32_t utilization_permille[PLAN_NUM_CORES];
+  bool schedulable;      // すべての周期タスクがデッドラインを守れる
+} plan_summary_t;
+
+// 計画を立てる。優先度はbase_priority(非周期)～max_priorityの範囲で割り当てる
+// 引数が不正なら-1、それ以外は0を返す(スケジュール可能かはsummaryで確認する)
+int plan_tasks(const plan_task_t *tasks, int num_tasks, uint8_t base_priority, uint8_t max_priority,
+  plan_result_t *results, plan_summary_t *summary);
@@ -0,0 +1,75 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "task_planner_port.h"
+
+static const char *TAG = "planner";
+
+static const plan_task_t *plan_table = NULL;
+static int plan_num_tasks = 0;
+// タスク毎の処理時間の最大値[us](そのタスクだけが書く)
+static volatile uint32_t measured_wcet_us[PLAN_MAX_TASKS];
+
+esp_err_t plan_start(const plan_task_t *tasks, int num_tasks){
+  plan_result_t results[PLAN_MAX_TASKS];
+  plan_summary_t summary;
+
+  if (plan_tasks(tasks, num_tasks, 1, PLAN_MAX_PRIORITY, results, &summary) != 0) {
+    ESP_LOGE(TAG, "invalid task table");
+    return ESP_ERR_INVALID_ARG;
+  }
+  ESP_LOGI(TAG, "%-24s %8s %8s %8s %4s %4s %8s", "name", "T[us]", "D[us]", "C[us]", "prio", "core", "R[us]");
+  for (int i = 0; i < num_tasks; i++) {
+    const plan_task_t *t = &tasks[i];
+    const plan_result_t *r = &results[i];
+    ESP_LOGI(TAG, "%-24s %8lu %8lu %8lu %4u %4d %8lu%s", t->name, t->period_us,
+      t->deadline_us ? t->deadline_us : t->period_us, t->wcet_us, r->priority, r->core, r->response_us,
+      r->schedulable ? "" : " MISS");
+  }
+  ESP_LOGI(TAG, "utilization core0=%lu core1=%lu [permille]", summary.utilization_permille[0], summary.utilization_permille[1]);
+  if (!summary.schedulable) {
+    ESP_LOGE(TAG, "task table is not schedulable");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  plan_table = tasks;
+  plan_num_tasks = num_tasks;
+  for (int i = 0; i < num_tasks; i++) {
+    if (xTaskCreatePinnedToCore(tasks[i].fn, tasks[i].name, tasks[i].stack_size, tasks[i].arg,
+        results[i].priority, NULL, results[i].core) != pdPASS) {
+      ESP_LOGE(TAG, "failed to create %s", tasks[i].name);
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  return ESP_OK;
+}
+
+int64_t plan_job_begin(void){
+  return esp_timer_get_time();
+}
+
+void plan_job_end(int index, int64_t begin_us){
+  if (index < 0 || index >= plan_num_tasks) {
+    return;
+  }
+  uint32_t elapsed = (uint32_t)(esp_timer_get_time() - begin_us);
+  if (elapsed <= measured_wcet_us[index]) {
+    return;
+  }
+  measured_wcet_us[index] = elapsed;
+  // 最大値が更新されたときだけなので、ログは最初の数回で落ち着く
+  if (elapsed > plan_table[index].wcet_us) {
+    ESP_LOGW(TAG, "%s: execution time %lu us exceeds wcet %lu us", plan_table[index].name, elapsed,
+      plan_table[index].wcet_us);
+  }
+}
+
+void plan_log_wcet(void){
+  for (int i = 0; i < plan_num_tasks; i++) {
+    if (plan_table[i].period_us == 0) {
+      continue;
+    }
+    ESP_LOGI(TAG, "%-24s measured=%lu us wcet=%lu us", plan_table[i].name, measured_wcet_us[i], plan_table[i].wcet_us);
+  }
+}
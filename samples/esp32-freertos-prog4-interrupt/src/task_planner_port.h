@@ -0,0 +1,20 @@
+#pragma once
+#include "esp_err.h"
+#include "task_planner.h"
+
+// task_plannerのESP-IDF側
+// 起動時に計画を立ててログに出し、スケジュール可能ならタスク表のとおりに
+// xTaskCreatePinnedToCore()でタスクを作成する
+// 周期タスクに割り当てる優先度の上限、これより上はWi-Fi、esp_timer、ipcなどのシステムタスク
+#define PLAN_MAX_PRIORITY 15
+
+// スケジュール不可ならタスクを作らずにESP_ERR_INVALID_STATEを返す
+// tasksは作成したタスクが動いている間残しておく(plan_job_end()が表のWCETと比べる)
+esp_err_t plan_start(const plan_task_t *tasks, int num_tasks);
+
+// 周期タスクの1回分の処理の開始と終了。indexはタスク表の位置
+// 処理時間の最大値を記録して、表のwcet_usを超えたらログに出す(表のWCETは実機のこの値で更新する)
+int64_t plan_job_begin(void);
+void plan_job_end(int index, int64_t begin_us);
+// 周期タスクの処理時間の最大値を表のWCETと並べてログに出す
+void plan_log_wcet(void);
@@ -0,0 +1,119 @@
+#include <string.h>
+#include "esp_attr.h"
+#include "mailbox.h"
+
+static mailbox_t table[MAILBOX_MAX];
+static portMUX_TYPE table_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const eNotifyAction actions[] = {
+  [MAILBOX_COUNT] = eIncrement,
+  [MAILBOX_VALUE] = eSetValueWithOverwrite,
+  [MAILBOX_BITS] = eSetBits,
+};
+
+mailbox_t *mailbox_register(const char *name, const mailbox_kind_t *kinds, int num_channels){
+  if (name == NULL || num_channels < 1 || num_channels > MAILBOX_MAX_CHANNELS) {
+    return NULL;
+  }
+  mailbox_t *found = NULL;
+  bool duplicate = false;
+  taskENTER_CRITICAL(&table_mux);
+  for (int i = 0; i < MAILBOX_MAX; i++) {
+    if (table[i].name == NULL) {
+      found = found ? found : &table[i];
+    } else if (strcmp(table[i].name, name) == 0) {
+      duplicate = true;
+    }
+  }
+  if (duplicate) {
+    found = NULL;
+  }
+  if (found != NULL) {
+    memset(found, 0, sizeof(*found));
+    found->name = name;
+    found->num_channels = num_channels;
+    memcpy(found->kinds, kinds, sizeof(kinds[0]) * num_channels);
+  }
+  taskEXIT_CRITICAL(&table_mux);
+  return found;
+}
+
+void mailbox_unregister(mailbox_t *mb){
+  taskENTER_CRITICAL(&table_mux);
+  mb->owner = NULL;
+  mb->name = NULL;
+  taskEXIT_CRITICAL(&table_mux);
+}
+
+void mailbox_bind(mailbox_t *mb, TaskHandle_t task){
+  if (task == NULL) {
+    task = xTaskGetCurrentTaskHandle();
+  }
+  for (int c = 0; c < mb->num_channels; c++) {
+    xTaskNotifyStateClearIndexed(task, MAILBOX_FIRST_INDEX + c);
+    ulTaskNotifyValueClearIndexed(task, MAILBOX_FIRST_INDEX + c, UINT32_MAX);
+  }
+  taskENTER_CRITICAL(&table_mux);
+  mb->owner = task;
+  taskEXIT_CRITICAL(&table_mux);
+}
+
+mailbox_t *mailbox_find(const char *name){
+  mailbox_t *found = NULL;
+  taskENTER_CRITICAL(&table_mux);
+  for (int i = 0; i < MAILBOX_MAX; i++) {
+    if (table[i].name != NULL && strcmp(table[i].name, name) == 0) {
+      found = &table[i];
+      break;
+    }
+  }
+  taskEXIT_CRITICAL(&table_mux);
+  return found;
+}
+
+bool mailbox_post(mailbox_t *mb, int channel, uint32_t value){
+  TaskHandle_t owner = mb->owner;
+  if (owner == NULL || channel < 0 || channel >= mb->num_channels) {
+    __atomic_fetch_add(&mb->dropped, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+  __atomic_fetch_add(&mb->posted, 1, __ATOMIC_RELAXED);
+  xTaskNotifyIndexed(owner, MAILBOX_FIRST_INDEX + channel, value, actions[mb->kinds[channel]]);
+  return true;
+}
+
+bool IRAM_ATTR mailbox_post_from_isr(mailbox_t *mb, int channel, uint32_t value, BaseType_t *woken){
+  TaskHandle_t owner = mb->owner;
+  if (owner == NULL || channel < 0 || channel >= mb->num_channels) {
+    __atomic_fetch_add(&mb->dropped, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+  __atomic_fetch_add(&mb->posted, 1, __ATOMIC_RELAXED);
+  xTaskNotifyIndexedFromISR(owner, MAILBOX_FIRST_INDEX + channel, value, actions[mb->kinds[channel]], woken);
+  return true;
+}
+
+bool mailbox_wait(mailbox_t *mb, int channel, uint32_t *value, TickType_t timeout){
+  if (channel < 0 || channel >= mb->num_channels) {
+    return false;
+  }
+  UBaseType_t index = MAILBOX_FIRST_INDEX + channel;
+  uint32_t v = 0;
+  bool received;
+  switch (mb->kinds[channel]) {
+  case MAILBOX_COUNT:
+    v = ulTaskNotifyTakeIndexed(index, pdFALSE, timeout);
+    received = v > 0;
+    break;
+  case MAILBOX_VALUE:
+    received = xTaskNotifyWaitIndexed(index, 0, 0, &v, timeout) == pdTRUE;
+    break;
+  default:
+    received = xTaskNotifyWaitIndexed(index, 0, UINT32_MAX, &v, timeout) == pdTRUE;
+    break;
+  }
+  if (received && value != NULL) {
+    *value = v;
+  }
+  return received;
+}
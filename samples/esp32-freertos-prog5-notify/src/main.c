@@ -1,9 +1,11 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <driver/gpio.h>
 #include "sdkconfig.h"
 #include <esp_task_wdt.h>
+#include "mailbox.h"
 
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
@@ -24,6 +26,21 @@ void delay_ms(uint32_t ms)
 // xTaskNotifyWait => ulTaskNotifyTake
 // ※ulTaskNotifyTakeはシンプルだが柔軟性DOWN
 
+// ここではmailbox(mailbox.h)で通知の配列を使い、app_taskに3つのチャネルを持たせる
+// 受け取るタスクのハンドルはグローバルに置かず、送る側は名前で探す
+#define APP_MAILBOX "app_task"
+enum {
+  CH_EDGE,   // 割込みの回数(MAILBOX_COUNT)
+  CH_LEVEL,  // 割込みの時のレベル(MAILBOX_VALUE、最新だけ)
+  CH_CMD,    // app_mainからの指示(MAILBOX_BITS)
+  CH_NUM,
+};
+static const mailbox_kind_t app_channels[CH_NUM] = {
+  [CH_EDGE] = MAILBOX_COUNT,
+  [CH_LEVEL] = MAILBOX_VALUE,
+  [CH_CMD] = MAILBOX_BITS,
+};
+#define CMD_TRIGGER_DONE (1 << 0)
 
 void pro_task(void *pvParameters) {
   ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
@@ -35,30 +52,51 @@ void pro_task(void *pvParameters) {
 }
 void app_task(void *pvParameters) {
   ESP_LOGW(TAG, "==== app_task start ====");
+  // 自分で受け取り側になる(それまでに送られたものは捨てられる)
+  mailbox_t *mb = mailbox_find(APP_MAILBOX);
+  mailbox_bind(mb, NULL);
   while (1) {
     ESP_LOGW(TAG, "notify wait....");
-    uint32_t ulNotifiedValue;
-    xTaskNotifyWait(0, 0, &ulNotifiedValue, portMAX_DELAY);
-    ESP_LOGW(TAG, "notify received.");
+    uint32_t count = 0;
+    uint32_t level = 0;
+    uint32_t cmd = 0;
+    // 同時に待てるのは1チャネルなので、回数で待って、ほかは待たずに見る
+    if (!mailbox_wait(mb, CH_EDGE, &count, pdMS_TO_TICKS(5000))) {
+      ESP_LOGW(TAG, "notify timeout. posted=%lu dropped=%lu", mb->posted, mb->dropped);
+      continue;
+    }
+    // 回数のチャネルは1回ずつ受け取るので、続けて割込みが入っても取りこぼさない(countは今回を含む残り)
+    ESP_LOGW(TAG, "notify received. remaining=%lu", count);
+    if (mailbox_wait(mb, CH_LEVEL, &level, 0)) {
+      ESP_LOGW(TAG, "  level=%lu (latest only)", level);
+    }
+    if (mailbox_wait(mb, CH_CMD, &cmd, 0) && (cmd & CMD_TRIGGER_DONE)) {
+      ESP_LOGW(TAG, "  trigger done.");
+    }
     delay_ms(1000);
   }
 }
 
-TaskHandle_t taskHandle;
+typedef struct {
+  gpio_num_t num;
+  mailbox_t *mb;
+} gpio_isr_ctx_t;
 
 // GPIO割込み
 void IRAM_ATTR gpio_isr_handler(void *arg){
-  uint32_t gpio_num = (uint32_t) arg;
+  gpio_isr_ctx_t *ctx = (gpio_isr_ctx_t *)arg;
+  uint32_t gpio_num = ctx->num;
+  int level = gpio_get_level(gpio_num);
   // ESP_LOG*は割込み内では？使えない。エラーになる。
-  esp_rom_printf("[interrupt!] GPIO=%lu, intr on core=%d, val=%d\n", gpio_num, esp_cpu_get_core_id(), gpio_get_level(gpio_num));
+  esp_rom_printf("[interrupt!] GPIO=%lu, intr on core=%d, val=%d\n", gpio_num, esp_cpu_get_core_id(), level);
 
   // Notify送信(ISR版)
   // https://qiita.com/azuki_bar/items/7f3aecc8bb1928f6a823#xtasknotify-xtasknotifyfromisr-api-functions
   BaseType_t taskWoken = pdFALSE;
   
-  xTaskNotifyFromISR(taskHandle, 0, eIncrement, &taskWoken);
-  //xTaskNotifyFromISR(taskHandle, 0, eSetValueWithoutOverwrite, &taskWoken);
-  esp_rom_printf("[interrupt!] xTaskNotifyFromISR\n");
+  mailbox_post_from_isr(ctx->mb, CH_EDGE, 0, &taskWoken);
+  mailbox_post_from_isr(ctx->mb, CH_LEVEL, level, &taskWoken);
+  esp_rom_printf("[interrupt!] mailbox_post_from_isr\n");
   //portYIELD_FROM_ISR( taskWoken );
   //esp_rom_printf("[interrupt!] portYIELD_FROM_ISR\n");
 }
@@ -67,6 +105,9 @@ void IRAM_ATTR gpio_isr_handler(void *arg){
 void gpio_trriger(){
 
   gpio_num_t num = GPIO_NUM_1;
+  static gpio_isr_ctx_t ctx;
+  ctx.num = num;
+  ctx.mb = mailbox_find(APP_MAILBOX);
 
   gpio_config_t io_conf = {
     .intr_type = GPIO_INTR_DISABLE,
@@ -87,7 +128,7 @@ void gpio_trriger(){
   ESP_LOGI(TAG, "gpio_set_intr_type end.");
   gpio_install_isr_service(0);
   ESP_LOGI(TAG, "gpio_install_isr_service end.");
-  gpio_isr_handler_add(num, gpio_isr_handler, (void *)num);
+  gpio_isr_handler_add(num, gpio_isr_handler, &ctx);
   ESP_LOGI(TAG, "gpio_isr_handler_add end.");
 
   delay_ms(2000);
@@ -105,6 +146,8 @@ void gpio_trriger(){
     //delay_ms(100);
   }
 
+  mailbox_post(ctx.mb, CH_CMD, CMD_TRIGGER_DONE);
+
   gpio_isr_handler_remove(num);
   ESP_LOGI(TAG, "gpio_isr_handler_remove end.");
   gpio_uninstall_isr_service();
@@ -114,6 +157,10 @@ void gpio_trriger(){
 void app_main()
 {
   ESP_LOGI(TAG, "app_main start ===>");
+  if (mailbox_register(APP_MAILBOX, app_channels, CH_NUM) == NULL) {
+    ESP_LOGE(TAG, "mailbox register failed");
+    abort();
+  }
   ESP_ERROR_CHECK(esp_task_wdt_deinit());
   esp_task_wdt_config_t twdt_config = {
     .timeout_ms = TWDT_TIMEOUT_MS,
@@ -122,7 +169,7 @@ void app_main()
   };
   ESP_ERROR_CHECK(esp_task_wdt_init(&twdt_config));
   //xTaskCreatePinnedToCore(pro_task, "pro_task", 8192, NULL, 1, NULL, PRO_CPU_NUM);
-  xTaskCreatePinnedToCore(app_task, "app_task", 8192, NULL, 1, &taskHandle, APP_CPU_NUM);
+  xTaskCreatePinnedToCore(app_task, "app_task", 8192, NULL, 1, NULL, APP_CPU_NUM);
 
   // 1回だけGPIO発火させる
   gpio_trriger();
@@ -0,0 +1,55 @@
+#pragma once
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+// カーネルオブジェクトの確保方法
+// 1: 静的確保モード。タスクスタック、TCB、セマフォなどをすべて静的に宣言する
+//    ヒープを使わないので断片化せず、起動時のmallocも不要になる
+//    配置はリンク時に決まるので tools/memmap_report.py で確認できる
+// 0: 動的確保(xTaskCreatePinnedToCore, xSemaphoreCreateCounting...)
+#define USE_STATIC_ALLOCATION 1
+
+// 配置先
+// ALLOC_INTERNAL: 内部RAM(.dram0.bss)。タスクスタック、TCB、カーネルオブジェクトは必ずこちら
+// ALLOC_PSRAM: PSRAM(.ext_ram.bss)。ISRから触らない大きなバッファ向け
+//   CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORYが無効ならEXT_RAM_BSS_ATTRは空になり内部RAMに置かれる
+#define ALLOC_INTERNAL
+#define ALLOC_PSRAM EXT_RAM_BSS_ATTR
+
+// タスク作成、失敗したら*handle=NULL
+// 静的確保モードではfn毎に<fn>_stack、<fn>_tcbが.bssに確保される
+#if USE_STATIC_ALLOCATION
+#define CREATE_PINNED_TASK(fn, name, stack_size, arg, prio, handle, core) \
+  do { \
+    static ALLOC_INTERNAL StackType_t fn##_stack[stack_size]; \
+    static ALLOC_INTERNAL StaticTask_t fn##_tcb; \
+    *(handle) = xTaskCreateStaticPinnedToCore(fn, name, stack_size, arg, prio, fn##_stack, &fn##_tcb, core); \
+  } while (0)
+#else
+#define CREATE_PINNED_TASK(fn, name, stack_size, arg, prio, handle, core) \
+  do { \
+    if (xTaskCreatePinnedToCore(fn, name, stack_size, arg, prio, handle, core) != pdPASS) { \
+      *(handle) = NULL; \
+    } \
+  } while (0)
+#endif
+
+// セマフォ、ミューテックスの作成。失敗したらvar=NULL
+// 静的確保モードではvar毎に<var>_bufferが.bssに確保される
+#if USE_STATIC_ALLOCATION
+#define CREATE_COUNTING_SEMAPHORE(var, max, initial) \
+  do { \
+    static ALLOC_INTERNAL StaticSemaphore_t var##_buffer; \
+    (var) = xSemaphoreCreateCountingStatic(max, initial, &var##_buffer); \
+  } while (0)
+#define CREATE_MUTEX(var) \
+  do { \
+    static ALLOC_INTERNAL StaticSemaphore_t var##_buffer; \
+    (var) = xSemaphoreCreateMutexStatic(&var##_buffer); \
+  } while (0)
+#else
+#define CREATE_COUNTING_SEMAPHORE(var, max, initial) ((var) = xSemaphoreCreateCounting(max, initial))
+#define CREATE_MUTEX(var) ((var) = xSemaphoreCreateMutex())
+#endif
@@ -9,15 +9,31 @@
 #include "esp_log.h"
 #include "esp_random.h"
 #include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "alloc_mode.h"
+#include "stack_profile.h"
+#include "stack_sizes.h"
 
 #define TWDT_TIMEOUT_MS 2000
 
+// スタックサイズのプロファイルモード
+// 1: 全タスク8192で動かしてハイウォーターマークを計測、10秒後にstack_sizes.hの内容を出力する
+// 0: stack_sizes.hのサイズで動かして、残りが少なくなったら警告する
+#define STACK_PROFILE_MODE 0
+#define STACK_PROFILE_DURATION_MS 10000
+#if STACK_PROFILE_MODE
+#define STACK_SIZE(name) 8192
+#else
+#define STACK_SIZE(name) STACK_SIZE_##name
+#endif
+
 static const char *TAG = "test1";
 
 TaskHandle_t taskHandle;
 TaskHandle_t taskHandle2;
 volatile SemaphoreHandle_t semaphore;
-portMUX_TYPE mutex = portMUX_INITIALIZER_UNLOCKED;
+SemaphoreHandle_t mutex;
 
 volatile uint8_t test_value = 0;
 
@@ -48,10 +64,10 @@ void task3(void *pvParameters) {
   ESP_LOGW(TAG, "==== task3 start ====");
   while (1) {
     ESP_LOGW(TAG, "test_value=%u, task3 wait...", test_value);
-    portENTER_CRITICAL(&mutex);
+    xSemaphoreTake(mutex, portMAX_DELAY);
     test_value = rand()%10;
     delay_ms(500);
-    portEXIT_CRITICAL(&mutex);
+    xSemaphoreGive(mutex);
   }
 }
 
@@ -59,10 +75,10 @@ void task4(void *pvParameters) {
   ESP_LOGI(TAG, "==== task4 start ====");
   while (1) {
     ESP_LOGI(TAG, "task4 wait...");
-    portENTER_CRITICAL(&mutex);
+    xSemaphoreTake(mutex, portMAX_DELAY);
     test_value = 0;
     delay_ms(1000);
-    portEXIT_CRITICAL(&mutex);
+    xSemaphoreGive(mutex);
   }
 }
 
@@ -83,6 +99,19 @@ void task4(void *pvParameters) {
 
 // pio run -e esp32s3box -t upload
 
+// 起動時間とヒープを出力して、静的確保/動的確保で比較する
+// 静的確保ではスタックなどが.bssに移ってヒープの合計が減るので、
+// 両モードのログを tools/memmap_report.py --log に渡すとmapの静的オブジェクトの合計と比べられる
+static void log_startup(int64_t start_us){
+  int64_t now = esp_timer_get_time();
+  ESP_LOGI(TAG, "[%s] boot->ready %lld us, create objects %lld us", USE_STATIC_ALLOCATION ? "static" : "dynamic", now, now - start_us);
+  ESP_LOGI(TAG, "[%s] heap internal total %u free %u (largest %u), psram total %u free %u",
+    USE_STATIC_ALLOCATION ? "static" : "dynamic",
+    heap_caps_get_total_size(MALLOC_CAP_INTERNAL), heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+    heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+    heap_caps_get_total_size(MALLOC_CAP_SPIRAM), heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+}
+
 void app_main(){
   ESP_LOGI(TAG, "app_main start ===>");
   ESP_ERROR_CHECK(esp_task_wdt_deinit());
@@ -92,22 +121,37 @@ void app_main(){
     .trigger_panic = false,
   };
   ESP_ERROR_CHECK(esp_task_wdt_init(&twdt_config));
+  int64_t start_us = esp_timer_get_time();
 
 #if false
   // バイナリセマフォ
   //semaphore = xSemaphoreCreateBinary();
   // カウンティングセマフォ、初期値を10とすると、10Give分詰まった状態でスタートできる。
-  semaphore = xSemaphoreCreateCounting(10,10);// 最大個数、初期値
-  xTaskCreatePinnedToCore(task1, "task1", 8192, NULL, 1, &taskHandle, APP_CPU_NUM);
-  xTaskCreatePinnedToCore(task2, "task2", 8192, NULL, 1, &taskHandle2, APP_CPU_NUM);
+  CREATE_COUNTING_SEMAPHORE(semaphore, 10, 10);// 最大個数、初期値
+  CREATE_PINNED_TASK(task1, "task1", STACK_SIZE(TASK1), NULL, 1, &taskHandle, APP_CPU_NUM);
+  CREATE_PINNED_TASK(task2, "task2", STACK_SIZE(TASK2), NULL, 1, &taskHandle2, APP_CPU_NUM);
+  stack_profile_register(taskHandle, "task1", STACK_SIZE(TASK1));
+  stack_profile_register(taskHandle2, "task2", STACK_SIZE(TASK2));
 #else
   // ミューテックス
   // task3、task4内でお互いに同じ値を編集する
   // 編集する際にロック/ロック解除して、自分が編集するときに排他制御する
   // タスク内で同じ値(test_value)を編集する場合はvolatile宣言する
-  xTaskCreatePinnedToCore(task3, "task3", 8192, NULL, 1, &taskHandle, APP_CPU_NUM);
-  xTaskCreatePinnedToCore(task4, "task4", 8192, NULL, 1, &taskHandle2, APP_CPU_NUM);
+  // ロックしたまま待つ(delay_ms)ので、スピンロック(portMUX)ではなくミューテックスを使う
+  CREATE_MUTEX(mutex);
+  CREATE_PINNED_TASK(task3, "task3", STACK_SIZE(TASK3), NULL, 1, &taskHandle, APP_CPU_NUM);
+  CREATE_PINNED_TASK(task4, "task4", STACK_SIZE(TASK4), NULL, 1, &taskHandle2, APP_CPU_NUM);
+  stack_profile_register(taskHandle, "task3", STACK_SIZE(TASK3));
+  stack_profile_register(taskHandle2, "task4", STACK_SIZE(TASK4));
+#endif
+
+  // 1秒毎にハイウォーターマークを確認
+#if STACK_PROFILE_MODE
+  stack_profile_start(1000, STACK_PROFILE_DURATION_MS);
+#else
+  stack_profile_start(1000, 0);
 #endif
+  log_startup(start_us);
 
   ESP_LOGI(TAG, "<=== app_main end");
 }
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <ctype.h>
+#include "esp_log.h"
+#include "stack_profile.h"
+#include "alloc_mode.h"
+
+static const char *TAG = "stack";
+
+static stack_profile_entry_t entries[STACK_PROFILE_MAX_TASKS];
+static int num_entries = 0;
+static uint32_t monitor_period_ms = 1000;
+static uint32_t profile_duration_ms = 0;
+
+uint32_t stack_profile_recommend(uint32_t stack_size, uint32_t min_free){
+  uint32_t used = min_free < stack_size ? stack_size - min_free : stack_size;
+  uint32_t size = used * (100 + STACK_MARGIN_PERCENT) / 100 + STACK_MARGIN_BYTES;
+  size = (size + 63) & ~63u;
+  return size < STACK_MIN_SIZE ? STACK_MIN_SIZE : size;
+}
+
+void stack_profile_register(TaskHandle_t handle, const char *name, uint32_t stack_size){
+  if (handle == NULL || num_entries >= STACK_PROFILE_MAX_TASKS) {
+    return;
+  }
+  stack_profile_entry_t *e = &entries[num_entries++];
+  e->handle = handle;
+  e->name = name;
+  e->stack_size = stack_size;
+  e->min_free = stack_size;
+  e->alerted = false;
+}
+
+static void stack_profile_sample(void){
+  for (int i = 0; i < num_entries; i++) {
+    stack_profile_entry_t *e = &entries[i];
+    uint32_t free_bytes = uxTaskGetStackHighWaterMark(e->handle);
+    if (free_bytes < e->min_free) {
+      e->min_free = free_bytes;
+    }
+    uint32_t threshold = e->stack_size * STACK_ALERT_PERCENT / 100;
+    if (threshold < STACK_ALERT_BYTES) {
+      threshold = STACK_ALERT_BYTES;
+    }
+    // 閾値を下回ったら1回だけ警告する
+    if (e->min_free < threshold && !e->alerted) {
+      e->alerted = true;
+      ESP_LOGW(TAG, "%s: stack nearly exhausted, %lu/%lu bytes free", e->name, e->min_free, e->stack_size);
+    }
+  }
+}
+
+void stack_profile_emit_header(void){
+  // tools/gen_stack_sizes.pyがbegin/endの間を取り出す
+  printf("// ---- stack_sizes.h begin ----\n");
+  printf("#pragma once\n");
+  printf("// generated by stack_profile (margin %d%% + %d bytes)\n", STACK_MARGIN_PERCENT, STACK_MARGIN_BYTES);
+  for (int i = 0; i < num_entries; i++) {
+    const stack_profile_entry_t *e = &entries[i];
+    printf("#define STACK_SIZE_");
+    for (const char *p = e->name; *p; p++) {
+      putchar(isalnum((unsigned char)*p) ? toupper((unsigned char)*p) : '_');
+    }
+    printf(" %lu // used %lu / %lu\n", stack_profile_recommend(e->stack_size, e->min_free),
+      e->stack_size - e->min_free, e->stack_size);
+  }
+  printf("// ---- stack_sizes.h end ----\n");
+}
+
+static void stack_profile_task(void *pvParameters){
+  TickType_t start = xTaskGetTickCount();
+  bool emitted = false;
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(monitor_period_ms));
+    stack_profile_sample();
+    if (profile_duration_ms > 0 && !emitted && (xTaskGetTickCount() - start) >= pdMS_TO_TICKS(profile_duration_ms)) {
+      stack_profile_emit_header();
+      emitted = true;
+    }
+  }
+}
+
+void stack_profile_start(uint32_t period_ms, uint32_t profile_ms){
+  monitor_period_ms = period_ms;
+  profile_duration_ms = profile_ms;
+  TaskHandle_t handle;
+  CREATE_PINNED_TASK(stack_profile_task, "stack_profile", 3072, NULL, 1, &handle, PRO_CPU_NUM);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// スタックサイズの自動調整
+// 登録したタスクのuxTaskGetStackHighWaterMark()(ESP-IDFではbyte単位)を定期的に記録して
+//   ・プロファイルモード: ワークロード実行後に、使用量+マージンで適正サイズを計算して
+//     stack_sizes.hの内容をログに出す(tools/gen_stack_sizes.pyでファイルにする)
+//   ・通常時: 残りスタックが閾値を下回ったら警告する
+
+#define STACK_PROFILE_MAX_TASKS  16
+// 適正サイズ = 使用量 x (100 + STACK_MARGIN_PERCENT)% + STACK_MARGIN_BYTES を64byte単位に切り上げ
+#define STACK_MARGIN_PERCENT     25
+#define STACK_MARGIN_BYTES       512
+#define STACK_MIN_SIZE           1536
+// 残りがスタックサイズのSTACK_ALERT_PERCENT%未満、またはSTACK_ALERT_BYTES未満で警告
+#define STACK_ALERT_PERCENT      10
+#define STACK_ALERT_BYTES        256
+
+typedef struct {
+  TaskHandle_t handle;
+  const char *name;          // stack_sizes.hのマクロ名に使う
+  uint32_t stack_size;       // [bytes]
+  uint32_t min_free;         // 計測中の最小のハイウォーターマーク[bytes]
+  bool alerted;
+} stack_profile_entry_t;
+
+// 使用量から適正サイズを計算する
+uint32_t stack_profile_recommend(uint32_t stack_size, uint32_t min_free);
+
+void stack_profile_register(TaskHandle_t handle, const char *name, uint32_t stack_size);
+// 監視タスクを開始する
+// profile_ms > 0ならプロファイルモード、profile_ms経過後にstack_sizes.hを出力する
+void stack_profile_start(uint32_t period_ms, uint32_t profile_ms);
+// stack_sizes.hの内容をログに出す
+void stack_profile_emit_header(void);
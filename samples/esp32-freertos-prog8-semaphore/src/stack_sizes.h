@@ -0,0 +1,7 @@
+#pragma once
+// 初期値(計測値ではない)。STACK_PROFILE_MODE=1で確保する8192と同じ
+// STACK_PROFILE_MODE=1で実行したログから tools/gen_stack_sizes.py で再生成する(ログにないタスクは前の値を残す)
+#define STACK_SIZE_TASK1 8192
+#define STACK_SIZE_TASK2 8192
+#define STACK_SIZE_TASK3 8192
+#define STACK_SIZE_TASK4 8192
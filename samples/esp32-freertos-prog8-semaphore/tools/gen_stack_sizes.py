@@ -0,0 +1,89 @@
+import os
+import re
+import sys
+
+# stack_profileが出力したstack_sizes.hをシリアルログから取り出してsrc/stack_sizes.hに書き込む
+#
+# > pio device monitor | tee stack.log
+# > python tools/gen_stack_sizes.py stack.log
+# > python tools/gen_stack_sizes.py stack.log src/stack_sizes.h
+#
+# begin/endの間でも、他のタスクのログが混ざるので#define/コメント/#pragmaの行だけを使う
+# 計測したのはmain.cの#ifで有効な側のタスクだけなので、既存のファイルの#defineとマージする
+# (ログにないタスクは前の値を残し、ログにあるタスクは計測した値で置き換える)
+
+BEGIN = "// ---- stack_sizes.h begin ----"
+END = "// ---- stack_sizes.h end ----"
+
+DEFINE = re.compile(r"^#define (STACK_SIZE_\w+) (\d+)(\s*//.*)?$")
+COMMENT = re.compile(r"^//.*$")
+PRAGMA = re.compile(r"^#pragma once$")
+
+HEADER_NOTE = "// STACK_PROFILE_MODE=1で実行したログから tools/gen_stack_sizes.py で再生成する(ログにないタスクは前の値を残す)"
+
+
+def extract(lines):
+    block = None
+    result = None
+    for line in lines:
+        line = line.rstrip("\r\n")
+        if BEGIN in line:
+            block = []
+        elif END in line and block is not None:
+            # 複数回出力されていたら最後のものを使う
+            result = block
+            block = None
+        elif block is not None:
+            block.append(line)
+    return result
+
+
+def parse(lines):
+    """#defineを{名前: 行}、コメントを[行]で返す。それ以外の行(混ざったログ)は捨てる"""
+    defines = {}
+    comments = []
+    for line in lines:
+        line = line.strip()
+        m = DEFINE.match(line)
+        if m:
+            defines[m.group(1)] = line
+        elif COMMENT.match(line):
+            comments.append(line)
+        elif line and not PRAGMA.match(line):
+            print("skip: %s" % line)
+    return defines, comments
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: gen_stack_sizes.py <serial log> [output]")
+        sys.exit(1)
+    output = sys.argv[2] if len(sys.argv) > 2 else "src/stack_sizes.h"
+    with open(sys.argv[1], encoding="utf-8", errors="replace") as f:
+        block = extract(f)
+    if block is None:
+        print("stack_sizes.h block not found")
+        sys.exit(1)
+    measured, comments = parse(block)
+    if not measured:
+        print("no STACK_SIZE_ defines in the block")
+        sys.exit(1)
+
+    merged = {}
+    if os.path.exists(output):
+        with open(output, encoding="utf-8") as f:
+            merged, _ = parse(line for line in f if not COMMENT.match(line.strip()))
+    kept = [name for name in merged if name not in measured]
+    merged.update(measured)
+
+    lines = ["#pragma once"]
+    lines += [c for c in comments if c != HEADER_NOTE]
+    lines.append(HEADER_NOTE)
+    lines += [merged[name] for name in sorted(merged)]
+    with open(output, "w", encoding="utf-8") as f:
+        f.write("\n".join(lines) + "\n")
+    print("wrote %s (%d measured, %d kept: %s)" % (output, len(measured), len(kept), " ".join(kept) or "-"))
+
+
+if __name__ == "__main__":
+    main()
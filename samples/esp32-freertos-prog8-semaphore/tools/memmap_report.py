@@ -0,0 +1,192 @@
+import os
+import re
+import sys
+
+# リンカのmapファイルから、src/で定義した静的オブジェクトの配置先(内部RAM/PSRAM)を一覧にする
+# USE_STATIC_ALLOCATION=1でタスクスタック、TCB、セマフォが意図した領域に置かれているか確認する
+#
+# > python tools/memmap_report.py .pio/build/esp32s3box/firmware.map
+# > python tools/memmap_report.py .pio/build/esp32s3box/firmware.map main.c
+# > python tools/memmap_report.py .pio/build/esp32s3box/firmware.map --log startup.log
+#
+# platformio.iniの extra_scripts = post:tools/memmap_report.py でビルド後に自動で出力する
+#
+# --log: 静的確保モード(USE_STATIC_ALLOCATION=1)のmapと、両モードで起動したシリアルログを渡すと、
+#        起動時に出力したヒープの合計の差が、mapの静的確保したオブジェクトの合計と合っているかを確かめる
+
+# 配置先は出力セクションで決める
+# S3ではフラッシュのDROM(.flash.rodata)とPSRAMが同じ0x3C000000台にマップされるので、アドレスでは区別できない
+OUTPUT_REGIONS = [
+    ((".ext_ram",), "PSRAM"),
+    ((".flash",), "FLASH"),
+    ((".dram0", ".dram1", ".noinit"), "DRAM"),
+    ((".iram0", ".iram1"), "IRAM"),
+    ((".rtc",), "RTC"),
+]
+
+# 静的確保モードだけにあるオブジェクト(alloc_mode.hのCREATE_PINNED_TASKの<fn>_stack/<fn>_tcbと、
+# CREATE_COUNTING_SEMAPHORE/CREATE_MUTEXの<var>_buffer)
+# 動的確保モードではヒープから確保されるので、ヒープの合計の差はこれらの合計になる
+STATIC_ONLY_RE = re.compile(r"(_stack|_tcb|_buffer)$")
+# ヒープ領域の先頭のアラインメントなど、mapからはわからない分
+TOLERANCE = 256
+
+# main.cのlog_startupの出力
+STARTUP_RE = re.compile(r"\[(static|dynamic)\] heap internal total (\d+) free (\d+) \(largest (\d+)\), psram total (\d+) free (\d+)")
+
+# .bss.task3_stack.0 / .dram0.bss.xxx など
+SECTION_RE = re.compile(r"^ (\.(?:ext_ram\.bss|dram1?\.bss|dram0\.bss|bss|data|dram0\.data|dram1?\.data|rodata)[^\s]*)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S+))?$")
+ADDR_RE = re.compile(r"^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S+)$")
+# 出力セクションは行頭から始まる
+OUTPUT_RE = re.compile(r"^(\.[^\s]+)")
+
+
+def region_of(output):
+    for prefixes, name in OUTPUT_REGIONS:
+        if output.startswith(prefixes):
+            return name
+    return "?"
+
+
+def symbol_of(section):
+    # .bss.task3_stack.0 -> task3_stack (関数内staticは.0などが付く)
+    name = section.split(".")
+    name = [n for n in name if n and n not in ("bss", "data", "rodata", "dram0", "dram1", "ext_ram")]
+    if name and name[-1].isdigit():
+        name = name[:-1]
+    return ".".join(name) if name else section
+
+
+def parse(lines, obj_filter):
+    entries = []
+    pending = None
+    output = ""
+    in_map = False
+    for line in lines:
+        line = line.rstrip("\r\n")
+        if line.startswith("Linker script and memory map"):
+            in_map = True
+            continue
+        if not in_map:
+            continue
+        m = OUTPUT_RE.match(line)
+        if m:
+            output = m.group(1)
+            pending = None
+            continue
+        m = SECTION_RE.match(line)
+        if m:
+            if m.group(2):
+                entries.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16), m.group(4), output))
+                pending = None
+            else:
+                # セクション名が長いとアドレスが次の行になる
+                pending = m.group(1)
+            continue
+        if pending:
+            m = ADDR_RE.match(line)
+            if m:
+                entries.append((pending, int(m.group(1), 16), int(m.group(2), 16), m.group(3), output))
+            pending = None
+    result = []
+    for section, addr, size, obj, output in entries:
+        if size == 0 or addr == 0:
+            continue
+        if obj_filter not in obj.replace("\\", "/"):
+            continue
+        result.append((symbol_of(section), region_of(output), addr, size, os.path.basename(obj)))
+    return result
+
+
+def parse_startup(lines):
+    """{"static"/"dynamic": (internal total, internal free, largest, psram total, psram free)} 最後の起動の値を使う"""
+    startup = {}
+    for line in lines:
+        m = STARTUP_RE.search(line)
+        if m:
+            startup[m.group(1)] = tuple(int(v) for v in m.groups()[1:])
+    return startup
+
+
+def compare(entries, startup):
+    """起動時のヒープの合計の差を、mapの静的確保したオブジェクトの合計と比べる。合わなければ1を返す"""
+    print("---- startup heap vs map ----")
+    missing = [mode for mode in ("static", "dynamic") if mode not in startup]
+    if missing:
+        print("NG  no startup line for %s mode in the log" % " / ".join(missing))
+        return 1
+    static_only = [e for e in entries if STATIC_ONLY_RE.search(e[0])]
+    if not static_only:
+        print("NG  no statically allocated task objects in the map (build with USE_STATIC_ALLOCATION=1)")
+        return 1
+    st, dy = startup["static"], startup["dynamic"]
+    failed = 0
+    for region, total_index, label in (("DRAM", 0, "internal"), ("PSRAM", 3, "psram")):
+        in_map = sum(e[3] for e in static_only if e[1] == region)
+        delta = dy[total_index] - st[total_index]
+        ok = abs(delta - in_map) <= TOLERANCE
+        failed += not ok
+        print("%s %-8s heap total dynamic-static %8d bytes, map %8d bytes (%d objects)" % (
+            "ok " if ok else "NG ", label, delta, in_map, len([e for e in static_only if e[1] == region])))
+    # 動的確保ではブロック毎のヘッダの分だけ空きが減る
+    overhead = st[1] - dy[1]
+    ok = overhead >= 0
+    failed += not ok
+    print("%s internal free static-dynamic %8d bytes (heap overhead of %d objects)" % (
+        "ok " if ok else "NG ", overhead, len(static_only)))
+    leftover = [e for e in static_only if e[1] not in ("DRAM", "PSRAM")]
+    for symbol, region, addr, size, obj in leftover:
+        print("NG  %s is in %s, not in a heap region" % (symbol, region))
+    return 1 if failed or leftover else 0
+
+
+def report(path, obj_filter, log=None):
+    with open(path, encoding="utf-8", errors="replace") as f:
+        entries = parse(f, obj_filter)
+    entries.sort(key=lambda e: (e[1], -e[3]))
+    print("---- memmap: %s (%s) ----" % (os.path.basename(path), obj_filter))
+    print("%-24s %-6s %-10s %8s  %s" % ("symbol", "region", "address", "size", "object"))
+    totals = {}
+    for symbol, region, addr, size, obj in entries:
+        print("%-24s %-6s 0x%08x %8d  %s" % (symbol, region, addr, size, obj))
+        totals[region] = totals.get(region, 0) + size
+    for region, size in sorted(totals.items()):
+        print("total %-6s %8d bytes" % (region, size))
+    if log is None:
+        return 0
+    with open(log, encoding="utf-8", errors="replace") as f:
+        startup = parse_startup(f)
+    return compare(entries, startup)
+
+
+def main():
+    args = sys.argv[1:]
+    log = None
+    if "--log" in args:
+        i = args.index("--log")
+        if i + 1 >= len(args):
+            args = []
+        else:
+            log = args[i + 1]
+            del args[i:i + 2]
+    if not args:
+        print("usage: memmap_report.py <firmware.map> [object filter] [--log serial.log]")
+        sys.exit(1)
+    sys.exit(report(args[0], args[1] if len(args) > 1 else "src/", log))
+
+
+# PlatformIOから呼ばれた場合はビルド後に出力する
+try:
+    Import("env")  # noqa: F821
+
+    def post_build(source, target, env):
+        path = os.path.join(env.subst("$BUILD_DIR"), env.subst("${PROGNAME}.map"))
+        if os.path.exists(path):
+            report(path, "src/")
+        else:
+            print("memmap_report: %s not found" % path)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", post_build)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        main()
@@ -0,0 +1,172 @@
+#include "cond_wait.h"
+#include <esp_attr.h>
+#include <esp_timer.h>
+
+void cond_group_init(cond_group_t *group){
+  portMUX_INITIALIZE(&group->lock);
+  group->level = 0;
+  group->waiters = NULL;
+  group->num_waiters = 0;
+}
+
+void cond_waiter_init(cond_waiter_t *waiter, cond_bits_t mask, cond_wait_mode_t mode, cond_trigger_t trigger, bool clear_on_exit){
+  waiter->mask = mask;
+  waiter->mode = mode;
+  waiter->trigger = trigger;
+  waiter->clear_on_exit = clear_on_exit;
+  waiter->task = NULL;
+  waiter->edges = 0;
+  waiter->result = 0;
+  waiter->signal_time_us = 0;
+  waiter->next = NULL;
+}
+
+// 待ちタスクはリストに登録しておく
+// 登録している間は待っていなくても立ち上がりエッジがラッチされる
+void cond_group_add_waiter(cond_group_t *group, cond_waiter_t *waiter){
+  taskENTER_CRITICAL(&group->lock);
+  configASSERT(group->num_waiters < COND_MAX_WAITERS);
+  waiter->next = group->waiters;
+  group->waiters = waiter;
+  group->num_waiters++;
+  taskEXIT_CRITICAL(&group->lock);
+}
+
+void cond_group_remove_waiter(cond_group_t *group, cond_waiter_t *waiter){
+  taskENTER_CRITICAL(&group->lock);
+  for (cond_waiter_t **p = &group->waiters; *p != NULL; p = &(*p)->next) {
+    if (*p == waiter) {
+      *p = waiter->next;
+      group->num_waiters--;
+      break;
+    }
+  }
+  waiter->next = NULL;
+  taskEXIT_CRITICAL(&group->lock);
+}
+
+// 条件を満たしたビットを返す、満たしていなければ0
+static inline cond_bits_t IRAM_ATTR cond_eval(const cond_waiter_t *waiter, cond_bits_t level){
+  cond_bits_t bits = (waiter->trigger == COND_TRIGGER_EDGE ? waiter->edges : level) & waiter->mask;
+  if (waiter->mode == COND_WAIT_ALL) {
+    return (bits == waiter->mask) ? bits : 0;
+  }
+  return bits;
+}
+
+// 成立したビットを消費して、クリアすべきレベルビットを返す
+static inline cond_bits_t IRAM_ATTR cond_consume(cond_waiter_t *waiter, cond_bits_t bits){
+  waiter->result = bits;
+  if (waiter->trigger == COND_TRIGGER_EDGE) {
+    waiter->edges &= ~bits;
+    return 0;
+  }
+  return waiter->clear_on_exit ? waiter->mask : 0;
+}
+
+// ロック中に呼ぶ
+// 全待ちタスクを評価してから、まとめてclear_on_exitのビットをクリアする
+// (1回のセットで複数の待ちタスクが起床できるようにイベントグループと同じ順序にしている)
+// 起床させるタスクをwakeに入れて数を返す。通知はロックを外してから呼び出し側が行う
+// (待ちタスクはresultを見たら戻ってしまうので、ロックの外ではcond_waiter_tに触らない)
+static int IRAM_ATTR cond_update_locked(cond_group_t *group, cond_bits_t level, TaskHandle_t *wake){
+  cond_bits_t rising = level & ~group->level;
+  cond_bits_t to_clear = 0;
+  int64_t now = 0;
+  int num_wake = 0;
+
+  group->level = level;
+  for (cond_waiter_t *w = group->waiters; w != NULL; w = w->next) {
+    w->edges |= rising & w->mask;
+    if (w->task == NULL || w->result != 0) {
+      continue;
+    }
+    cond_bits_t bits = cond_eval(w, level);
+    if (bits == 0) {
+      continue;
+    }
+    if (now == 0) {
+      now = esp_timer_get_time();
+    }
+    to_clear |= cond_consume(w, bits);
+    w->signal_time_us = now;
+    wake[num_wake++] = w->task;
+  }
+  group->level &= ~to_clear;
+  return num_wake;
+}
+
+cond_bits_t cond_wait(cond_group_t *group, cond_waiter_t *waiter, TickType_t ticks_to_wait){
+  TimeOut_t timeout;
+  vTaskSetTimeOutState(&timeout);
+
+  taskENTER_CRITICAL(&group->lock);
+  cond_bits_t bits = cond_eval(waiter, group->level);
+  if (bits != 0) {
+    // 既に成立している場合は待たずに返す
+    group->level &= ~cond_consume(waiter, bits);
+    waiter->result = 0;
+    waiter->signal_time_us = esp_timer_get_time();
+    taskEXIT_CRITICAL(&group->lock);
+    return bits;
+  }
+  waiter->result = 0;
+  waiter->task = xTaskGetCurrentTaskHandle();
+  taskEXIT_CRITICAL(&group->lock);
+
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+    // タイムアウト直後にISRが成立させた場合の古い通知は、resultが0なら読み捨てて待ち直す
+    bool timed_out = (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) != pdFALSE);
+    taskENTER_CRITICAL(&group->lock);
+    bits = waiter->result;
+    if (bits != 0 || timed_out) {
+      waiter->task = NULL;
+      waiter->result = 0;
+      taskEXIT_CRITICAL(&group->lock);
+      return bits;
+    }
+    taskEXIT_CRITICAL(&group->lock);
+  }
+}
+
+void cond_set_bits(cond_group_t *group, cond_bits_t bits){
+  TaskHandle_t wake[COND_MAX_WAITERS];
+  taskENTER_CRITICAL(&group->lock);
+  int num_wake = cond_update_locked(group, group->level | bits, wake);
+  taskEXIT_CRITICAL(&group->lock);
+  // タスクからなので通常版(優先度が高いタスクを起こしたらその場で切り替わる)
+  for (int i = 0; i < num_wake; i++) {
+    xTaskNotifyGive(wake[i]);
+  }
+}
+
+void cond_clear_bits(cond_group_t *group, cond_bits_t bits){
+  taskENTER_CRITICAL(&group->lock);
+  group->level &= ~bits;
+  taskEXIT_CRITICAL(&group->lock);
+}
+
+cond_bits_t cond_get_bits(cond_group_t *group){
+  taskENTER_CRITICAL(&group->lock);
+  cond_bits_t level = group->level;
+  taskEXIT_CRITICAL(&group->lock);
+  return level;
+}
+
+void IRAM_ATTR cond_set_bits_from_isr(cond_group_t *group, cond_bits_t bits, BaseType_t *higher_priority_task_woken){
+  TaskHandle_t wake[COND_MAX_WAITERS];
+  taskENTER_CRITICAL_ISR(&group->lock);
+  int num_wake = cond_update_locked(group, group->level | bits, wake);
+  taskEXIT_CRITICAL_ISR(&group->lock);
+  // タイマーデーモンを経由せず、ここで直接起床させる
+  for (int i = 0; i < num_wake; i++) {
+    vTaskNotifyGiveFromISR(wake[i], higher_priority_task_woken);
+  }
+}
+
+void IRAM_ATTR cond_clear_bits_from_isr(cond_group_t *group, cond_bits_t bits){
+  taskENTER_CRITICAL_ISR(&group->lock);
+  group->level &= ~bits;
+  taskEXIT_CRITICAL_ISR(&group->lock);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// 条件待ち（イベントグループの代替）
+// xEventGroupSetBitsFromISR()はタイマーデーモンタスク経由でビットをセットするので
+// ISR => タスク起床までにデーモンタスク分の遅延が入る
+// cond_waitはISR内で条件を評価して、成立した待ちタスクをタスク通知で直接起床させる
+// ・信号は64本(uint64_t)まで、イベントグループの24bit制限なし
+// ・AND/OR条件、レベル/エッジのトリガーを待ちタスクごとに指定できる
+// ・1回のISRで条件成立した待ちタスクをまとめて起床させる（バッチ起床）
+// 待ちタスクのタスク通知(index 0)はcond_waitが使うので、他の用途と併用しないこと
+// 起床させるタスクはロック中に集めて、ロックを外してから通知する(タスクからはxTaskNotifyGive、ISRからはFromISR版)
+
+// 1つのグループに登録できる待ちタスクの数(起床させるタスクをスタックに集めるため)
+#define COND_MAX_WAITERS 8
+
+typedef uint64_t cond_bits_t;
+
+#define COND_BIT(n) ((cond_bits_t)1 << (n))
+
+typedef enum {
+  COND_WAIT_ANY, // いずれかのビットが成立 (OR)
+  COND_WAIT_ALL, // すべてのビットが成立 (AND)
+} cond_wait_mode_t;
+
+typedef enum {
+  COND_TRIGGER_LEVEL, // 現在のビット状態で判定
+  COND_TRIGGER_EDGE,  // 前回の起床以降に0=>1に変化したビットで判定
+} cond_trigger_t;
+
+typedef struct cond_waiter {
+  cond_bits_t mask;
+  cond_wait_mode_t mode;
+  cond_trigger_t trigger;
+  bool clear_on_exit;       // LEVEL時、起床後にmaskのビットをクリアする(xClearOnExit相当)
+  // 以下は内部状態
+  TaskHandle_t task;        // 待ち中のタスク、待っていなければNULL
+  cond_bits_t edges;        // ラッチされた立ち上がりエッジ
+  cond_bits_t result;       // 起床時に成立していたビット
+  int64_t signal_time_us;   // 条件成立時刻[us]、起床レイテンシの計測用
+  struct cond_waiter *next;
+} cond_waiter_t;
+
+typedef struct {
+  portMUX_TYPE lock;
+  cond_bits_t level;
+  cond_waiter_t *waiters;
+  int num_waiters;
+} cond_group_t;
+
+void cond_group_init(cond_group_t *group);
+void cond_waiter_init(cond_waiter_t *waiter, cond_bits_t mask, cond_wait_mode_t mode, cond_trigger_t trigger, bool clear_on_exit);
+// COND_MAX_WAITERSを超えて登録するとconfigASSERTで止まる
+void cond_group_add_waiter(cond_group_t *group, cond_waiter_t *waiter);
+void cond_group_remove_waiter(cond_group_t *group, cond_waiter_t *waiter);
+
+// 条件成立まで待つ。成立したビットを返す、タイムアウト時は0
+cond_bits_t cond_wait(cond_group_t *group, cond_waiter_t *waiter, TickType_t ticks_to_wait);
+
+// タスクから
+void cond_set_bits(cond_group_t *group, cond_bits_t bits);
+void cond_clear_bits(cond_group_t *group, cond_bits_t bits);
+cond_bits_t cond_get_bits(cond_group_t *group);
+
+// ISRから
+void cond_set_bits_from_isr(cond_group_t *group, cond_bits_t bits, BaseType_t *higher_priority_task_woken);
+void cond_clear_bits_from_isr(cond_group_t *group, cond_bits_t bits);
@@ -0,0 +1,167 @@
+#include <string.h>
+#include "input_cond.h"
+
+#define RATE_PERIOD_US   1000000
+#define BACKOFF_RESET_US 1000000    // 割込みを戻してからこれだけ嵐がなければ、止める時間を戻す
+
+void ic_init(ic_input_t *in, const ic_config_t *config, int level, int64_t now_us){
+  memset(in, 0, sizeof(*in));
+  in->config = *config;
+  in->window_us = config->window_us;
+  in->raw_level = level;
+  in->stable_level = level;
+  in->last_edge_us = now_us;
+  in->storm_start_us = now_us;
+  in->rate_start_us = now_us;
+  in->backoff_us = config->mask_us;
+  in->unmask_us = now_us - BACKOFF_RESET_US;
+}
+
+static int bin_of(int64_t width_us){
+  if (width_us < 2) {
+    return 0;
+  }
+  int bin = 63 - __builtin_clzll((uint64_t)width_us);
+  return bin < IC_HIST_BINS ? bin : IC_HIST_BINS - 1;
+}
+
+// 1秒毎に数を締める(エッジが来なくても0にするためにic_pollからも呼ぶ)
+static void update_rate(ic_input_t *in, int64_t now_us){
+  int64_t elapsed = now_us - in->rate_start_us;
+  if (elapsed < RATE_PERIOD_US) {
+    return;
+  }
+  in->stats.irq_per_s = elapsed < 2 * RATE_PERIOD_US ? in->rate_count : 0;
+  in->rate_start_us = now_us - elapsed % RATE_PERIOD_US;
+  in->rate_count = 0;
+}
+
+ic_action_t ic_edge(ic_input_t *in, int64_t t_us, int level){
+  in->stats.edges++;
+  update_rate(in, t_us);
+  in->rate_count++;
+  if (in->masked) {
+    return IC_ACTION_MASK;
+  }
+
+  // 前のエッジからの時間がパルス幅(レベルが同じなら、読む前に戻った細いパルス)
+  if (in->width_valid) {
+    int64_t width = level == in->raw_level ? 0 : t_us - in->last_edge_us;
+    in->hist[bin_of(width)]++;
+    in->hist_total++;
+  }
+  in->width_valid = true;
+  in->raw_level = level;
+  in->last_edge_us = t_us;
+  in->pending = true;
+  in->pulses_in_burst++;
+
+  if (in->config.storm_edges == 0) {
+    return IC_ACTION_NONE;
+  }
+  if (t_us - in->storm_start_us >= in->config.storm_period_us) {
+    in->storm_start_us = t_us;
+    in->storm_count = 0;
+  }
+  if (++in->storm_count <= in->config.storm_edges) {
+    return IC_ACTION_NONE;
+  }
+  // 戻してすぐにまた嵐なら、止める時間を倍にする
+  if (t_us - in->unmask_us < BACKOFF_RESET_US) {
+    in->backoff_us = in->backoff_us * 2 < in->config.mask_max_us ? in->backoff_us * 2 : in->config.mask_max_us;
+  } else {
+    in->backoff_us = in->config.mask_us;
+  }
+  in->masked = true;
+  in->masked_since_us = t_us;
+  in->unmask_us = t_us + in->backoff_us;
+  in->pending = false;
+  in->stats.storms++;
+  return IC_ACTION_MASK;
+}
+
+bool ic_poll(ic_input_t *in, int64_t now_us, int *level){
+  update_rate(in, now_us);
+  if (in->config.learn_pulses > 0 && in->hist_total - in->learned >= in->config.learn_pulses) {
+    in->learned = in->hist_total;
+    ic_tune(in);
+  }
+  if (in->masked || !in->pending || now_us - in->last_edge_us < in->window_us) {
+    return false;
+  }
+  in->pending = false;
+  bool changed = in->raw_level != in->stable_level;
+  // n回のエッジで確定した変化は0か1回、残りは往復したパルス
+  in->stats.rejected += (in->pulses_in_burst - (changed ? 1 : 0)) / 2;
+  in->pulses_in_burst = 0;
+  if (!changed) {
+    return false;
+  }
+  in->stable_level = in->raw_level;
+  in->stats.changes++;
+  *level = in->stable_level;
+  return true;
+}
+
+int64_t ic_next_deadline(const ic_input_t *in){
+  if (in->masked) {
+    return in->unmask_us;
+  }
+  return in->pending ? in->last_edge_us + in->window_us : INT64_MAX;
+}
+
+bool ic_unmask_due(const ic_input_t *in, int64_t now_us){
+  return in->masked && now_us >= in->unmask_us;
+}
+
+void ic_resync(ic_input_t *in, int64_t now_us, int level){
+  in->masked = false;
+  in->stats.masked_us += (uint32_t)(now_us - in->masked_since_us);
+  in->unmask_us = now_us;
+  in->raw_level = level;
+  in->last_edge_us = now_us;
+  in->pending = true;
+  in->width_valid = false;
+  in->pulses_in_burst = 0;
+  in->storm_start_us = now_us;
+  in->storm_count = 0;
+}
+
+bool ic_tune(ic_input_t *in){
+  // 山の間の空の区間(2区間以上)で一番広いもの
+  int gap_lo = -1, gap_hi = -1;
+  int prev = -1;
+  for (int i = 0; i < IC_HIST_BINS; i++) {
+    if (in->hist[i] == 0) {
+      continue;
+    }
+    if (prev >= 0 && i - prev - 1 >= 2 && (gap_lo < 0 || i - prev > gap_hi - gap_lo)) {
+      gap_lo = prev + 1;
+      gap_hi = i;
+    }
+    prev = i;
+  }
+  if (gap_lo < 0) {
+    return false;
+  }
+  // 短い山は2^gap_lo未満、長い山は2^gap_hi以上。その幾何平均
+  uint32_t window = 1u << ((gap_lo + gap_hi) / 2);
+  if (window < in->config.window_min_us) {
+    window = in->config.window_min_us;
+  }
+  if (window > in->config.window_max_us) {
+    window = in->config.window_max_us;
+  }
+  uint32_t short_max_ns = (1u << gap_lo) * 1000u;
+  in->glitch_ns = short_max_ns <= IC_PCNT_GLITCH_MAX_NS ? short_max_ns : 0;
+  bool changed = window != in->window_us;
+  in->window_us = window;
+  return changed;
+}
+
+void ic_get_stats(const ic_input_t *in, ic_stats_t *stats){
+  *stats = in->stats;
+  stats->window_us = in->window_us;
+  stats->glitch_ns = in->glitch_ns;
+  stats->masked = in->masked;
+}
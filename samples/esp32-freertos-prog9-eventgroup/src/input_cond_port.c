@@ -0,0 +1,118 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "input_cond_port.h"
+
+#define TAG "input_cond"
+#define IDLE_WAIT_MS 1000    // 何も待っていないときも、1秒毎に割込み数を締める
+
+typedef struct {
+  gpio_num_t gpio;
+  ic_input_t input;
+  ic_change_cb_t callback;
+  void *arg;
+} ic_pin_t;
+
+static ic_pin_t pins[IC_PORT_MAX_PINS];
+static int num_pins = 0;
+static TaskHandle_t cond_task = NULL;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void IRAM_ATTR pin_isr_handler(void *arg){
+  ic_pin_t *p = (ic_pin_t *)arg;
+  int64_t now = esp_timer_get_time();
+  int level = gpio_get_level(p->gpio);
+  portENTER_CRITICAL_ISR(&lock);
+  ic_action_t action = ic_edge(&p->input, now, level);
+  // チャタリング中は最初のエッジだけ起こせばよい(確定の期限はタスクが計算する)
+  bool notify = action == IC_ACTION_MASK || p->input.pulses_in_burst == 1;
+  portEXIT_CRITICAL_ISR(&lock);
+  if (action == IC_ACTION_MASK) {
+    gpio_intr_disable(p->gpio);
+  }
+  BaseType_t taskWoken = pdFALSE;
+  if (notify && cond_task != NULL) {
+    vTaskNotifyGiveFromISR(cond_task, &taskWoken);
+  }
+  if (taskWoken == pdTRUE) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+static void input_cond_task(void *pvParameters){
+  while (1) {
+    int64_t now = esp_timer_get_time();
+    int64_t deadline = INT64_MAX;
+    for (int i = 0; i < num_pins; i++) {
+      ic_pin_t *p = &pins[i];
+      int level = 0;
+      taskENTER_CRITICAL(&lock);
+      bool unmask = ic_unmask_due(&p->input, now);
+      if (unmask) {
+        ic_resync(&p->input, now, gpio_get_level(p->gpio));
+      }
+      bool changed = ic_poll(&p->input, now, &level);
+      int64_t d = ic_next_deadline(&p->input);
+      taskEXIT_CRITICAL(&lock);
+      if (unmask) {
+        gpio_intr_enable(p->gpio);
+      }
+      if (changed) {
+        p->callback(p->gpio, level, p->arg);
+      }
+      deadline = d < deadline ? d : deadline;
+    }
+    int64_t wait_ms = deadline == INT64_MAX ? IDLE_WAIT_MS : (deadline - now + 999) / 1000;
+    wait_ms = wait_ms < 1 ? 1 : wait_ms > IDLE_WAIT_MS ? IDLE_WAIT_MS : wait_ms;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+  }
+}
+
+esp_err_t ic_port_add(gpio_num_t gpio, const ic_config_t *config, ic_change_cb_t callback, void *arg){
+  if (num_pins >= IC_PORT_MAX_PINS || callback == NULL || config->window_us == 0
+    || config->window_min_us > config->window_max_us || (config->storm_edges > 0 && config->mask_us == 0)) {
+    ESP_LOGE(TAG, "invalid input config gpio=%d", gpio);
+    return ESP_ERR_INVALID_ARG;
+  }
+  ic_pin_t *p = &pins[num_pins];
+  p->gpio = gpio;
+  p->callback = callback;
+  p->arg = arg;
+  ic_init(&p->input, config, gpio_get_level(gpio), esp_timer_get_time());
+  ESP_ERROR_CHECK(gpio_set_intr_type(gpio, GPIO_INTR_ANYEDGE));
+  ESP_ERROR_CHECK(gpio_isr_handler_add(gpio, pin_isr_handler, p));
+  num_pins++;
+  return ESP_OK;
+}
+
+esp_err_t ic_port_start(UBaseType_t priority, BaseType_t core){
+  if (xTaskCreatePinnedToCore(input_cond_task, "input_cond", 4096, NULL, priority, &cond_task, core) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+esp_err_t ic_port_get_stats(gpio_num_t gpio, ic_stats_t *stats){
+  for (int i = 0; i < num_pins; i++) {
+    if (pins[i].gpio == gpio) {
+      taskENTER_CRITICAL(&lock);
+      ic_get_stats(&pins[i].input, stats);
+      taskEXIT_CRITICAL(&lock);
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+void ic_port_log_stats(void){
+  for (int i = 0; i < num_pins; i++) {
+    ic_stats_t s;
+    ic_port_get_stats(pins[i].gpio, &s);
+    ESP_LOGI(TAG, "gpio%d irq=%lu/s edges=%lu changes=%lu rejected=%lu storms=%lu masked=%lums%s window=%luus pcnt_glitch=%luns",
+      pins[i].gpio, (unsigned long)s.irq_per_s, (unsigned long)s.edges, (unsigned long)s.changes,
+      (unsigned long)s.rejected, (unsigned long)s.storms, (unsigned long)(s.masked_us / 1000), s.masked ? "(now)" : "",
+      (unsigned long)s.window_us, (unsigned long)s.glitch_ns);
+  }
+}
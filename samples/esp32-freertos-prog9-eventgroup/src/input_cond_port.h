@@ -0,0 +1,24 @@
+#pragma once
+#include <freertos/FreeRTOS.h>
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "input_cond.h"
+
+// 入力の処理(ESP-IDF部分)
+// ピン毎にANYEDGEの割込みを付けて、エッジの時刻とレベルをic_edge()に渡す
+// 嵐ならその場でgpio_intr_disable()し、処理タスクが時間が来たら戻す
+// 処理タスクは割込みの通知か、一番近い期限(デバウンスの確定、割込みを戻す時刻)で起きて、
+// 確定した変化をコールバックに渡す(コールバックはタスクの中なので、割込みから呼べないAPIも使える)
+//
+// gpio_config()とgpio_install_isr_service()は呼ぶ側で済ませておく
+
+#define IC_PORT_MAX_PINS  4
+
+typedef void (*ic_change_cb_t)(gpio_num_t gpio, int level, void *arg);
+
+esp_err_t ic_port_add(gpio_num_t gpio, const ic_config_t *config, ic_change_cb_t callback, void *arg);
+// 処理タスクを作る(ic_port_addの後)
+esp_err_t ic_port_start(UBaseType_t priority, BaseType_t core);
+esp_err_t ic_port_get_stats(gpio_num_t gpio, ic_stats_t *stats);
+// 全部のピンの統計(割込み数/秒など)をログに出す
+void ic_port_log_stats(void);
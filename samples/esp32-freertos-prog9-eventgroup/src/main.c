@@ -10,9 +10,24 @@
 #include "esp_random.h"
 #include "freertos/semphr.h"
 #include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "cond_wait.h"
+#include "input_cond_port.h"
 
 #define TWDT_TIMEOUT_MS 2000
 
+// 1: イベントグループ(xEventGroupSetBitsFromISR、タイマーデーモン経由)
+// 0: cond_wait(ISRから直接起床)
+// 両方で起床レイテンシを計測して比較する(ホストではhost-simのcheck_prog9_condで同じ比較をしている)
+#define USE_EVENT_GROUP 0
+
+// 1: ボタンの入力をinput_cond(デバウンス、割込みの嵐の抑制)に通す
+// 0: エッジ毎にgpio_isr_handlerでビットを変える(チャタリングの分だけ割込みとビットの変化が起きる)
+#define USE_INPUT_COND 1
+// デバウンスした結果をこのピンに出す(LEDやロジックアナライザで元の波形と比べる)
+#define INDICATOR_A GPIO_NUM_15
+#define INDICATOR_B GPIO_NUM_16
+
 static const char *TAG = "test1";
 
 TaskHandle_t taskHandle;
@@ -22,15 +37,38 @@ EventGroupHandle_t event_group = NULL;
 #define EVENT_GPIO_A (1<<0)
 #define EVENT_GPIO_B (1<<1)
 
+cond_group_t cond_group;
+cond_waiter_t cond_waiter;
+// イベントグループ版のレイテンシ計測用、ISRでビットをセットした時刻
+volatile int64_t event_set_time_us = 0;
+
+// 起床レイテンシ[us]の統計
+typedef struct {
+  uint32_t count;
+  int64_t min;
+  int64_t max;
+  int64_t sum;
+} latency_stats_t;
+
+static void latency_stats_add(latency_stats_t *stats, int64_t latency){
+  if (stats->count == 0 || latency < stats->min) stats->min = latency;
+  if (stats->count == 0 || latency > stats->max) stats->max = latency;
+  stats->sum += latency;
+  stats->count++;
+}
+
 void delay_ms(uint32_t ms){
   vTaskDelay(ms / portTICK_PERIOD_MS);
 }
 
 void task1(void *pvParameters) {
   ESP_LOGW(TAG, "==== task1 start ====");
+  latency_stats_t stats = {0};
   while (1) {
     ESP_LOGW(TAG, "wait event ...");
+    int64_t signal_time_us;
 
+#if USE_EVENT_GROUP
     // イベント発火後にクリアするかしないか？
     // pdFALSE: 2つボタン同時押し操作などの場合、押している間、ずっと何度も発火する
     // pdTRUE: 2つボタン同時押しの最初だけ発火する。もう一度発火させる場合は、両方とも離して再度押す
@@ -41,7 +79,16 @@ void task1(void *pvParameters) {
       pdTRUE,                      // 指定したイベントビットがすべて揃うまで待つか
       portMAX_DELAY                // 待ち時間
     );
-    ESP_LOGW(TAG, "** event task **");
+    signal_time_us = event_set_time_us;
+#else
+    // xEventGroupWaitBits(pdTRUE, pdTRUE)と同じ条件
+    // cond_waiter_init()でAND条件、レベルトリガー、起床後クリアを指定している
+    cond_bits_t eBits = cond_wait(&cond_group, &cond_waiter, portMAX_DELAY);
+    signal_time_us = cond_waiter.signal_time_us;
+#endif
+    latency_stats_add(&stats, esp_timer_get_time() - signal_time_us);
+    ESP_LOGW(TAG, "** event task ** bits=0x%llx, latency min=%lld avg=%lld max=%lld [us] (n=%lu)",
+      (unsigned long long)eBits, stats.min, stats.sum / stats.count, stats.max, stats.count);
     delay_ms(1);
   }
 }
@@ -51,6 +98,10 @@ void task2(void *pvParameters) {
   while (1) {
     //ESP_LOGI(TAG, "task4 wait...");
     delay_ms(1000);
+#if USE_INPUT_COND
+    // ピン毎の割込み数/秒、確定した変化、捨てたパルス、嵐で止めた時間
+    ic_port_log_stats();
+#endif
   }
 }
 
@@ -76,10 +127,28 @@ void IRAM_ATTR gpio_isr_handler(void *arg){
   int level = gpio_get_level(gpio_num);
   esp_rom_printf("[interrupt!] GPIO=%lu, val=%d\n", gpio_num, level);
   
+  uint32_t bit = gpio_num==GPIO_NUM_5 ? EVENT_GPIO_A:EVENT_GPIO_B;
+  BaseType_t taskWoken = pdFALSE;
+
+#if USE_EVENT_GROUP
+  // xEventGroupSetBits/ClearBitsはISRから呼べないのでFromISR版を使う
+  // FromISR版はタイマーデーモンタスクに処理を依頼するので、その分起床が遅れる
   if(level == 0){
-    xEventGroupClearBits(event_group, gpio_num==GPIO_NUM_5 ? EVENT_GPIO_A:EVENT_GPIO_B);
+    xEventGroupClearBitsFromISR(event_group, bit);
   }else{
-    xEventGroupSetBits(event_group, gpio_num==GPIO_NUM_5 ? EVENT_GPIO_A:EVENT_GPIO_B);
+    event_set_time_us = esp_timer_get_time();
+    xEventGroupSetBitsFromISR(event_group, bit, &taskWoken);
+  }
+#else
+  // cond_waitはISR内で条件を評価して待ちタスクを直接起床させる
+  if(level == 0){
+    cond_clear_bits_from_isr(&cond_group, bit);
+  }else{
+    cond_set_bits_from_isr(&cond_group, bit, &taskWoken);
+  }
+#endif
+  if (taskWoken == pdTRUE) {
+    portYIELD_FROM_ISR();
   }
 }
 
@@ -119,11 +188,65 @@ void gpio_trriger(){
   gpio_uninstall_isr_service();
   gpio_install_isr_service(0);
 
+#if !USE_INPUT_COND
   gpio_isr_handler_add(GPIO_NUM_5, gpio_isr_handler, (void *)GPIO_NUM_5);
   gpio_isr_handler_add(GPIO_NUM_7, gpio_isr_handler, (void *)GPIO_NUM_7);
-  
+#endif
+}
+
+#if USE_INPUT_COND
+// 入力の処理(input_cond.c)
+// デバウンスは10msから始めて、パルス幅の分布を見て1～50msの間で調整する
+// 10msに40エッジを超えたら割込みの嵐として、20ms(続けば倍々で最大1秒)割込みを止める
+static const ic_config_t button_config = {
+  .window_us = 10000,
+  .window_min_us = 1000,
+  .window_max_us = 50000,
+  .learn_pulses = 32,
+  .storm_period_us = 10000,
+  .storm_edges = 40,
+  .mask_us = 20000,
+  .mask_max_us = 1000000,
+};
+
+// 確定した変化(input_condのタスクから呼ばれる)
+static void input_changed(gpio_num_t gpio, int level, void *arg){
+  uint32_t bit = gpio==GPIO_NUM_5 ? EVENT_GPIO_A:EVENT_GPIO_B;
+  gpio_set_level(gpio==GPIO_NUM_5 ? INDICATOR_A:INDICATOR_B, level);
+#if USE_EVENT_GROUP
+  if(level == 0){
+    xEventGroupClearBits(event_group, bit);
+  }else{
+    event_set_time_us = esp_timer_get_time();
+    xEventGroupSetBits(event_group, bit);
+  }
+#else
+  if(level == 0){
+    cond_clear_bits(&cond_group, bit);
+  }else{
+    cond_set_bits(&cond_group, bit);
+  }
+#endif
 }
 
+static void setup_input_cond(void){
+  gpio_config_t io_conf = {
+    .intr_type = GPIO_INTR_DISABLE,
+    .mode = GPIO_MODE_OUTPUT,
+    .pin_bit_mask = (1ULL << INDICATOR_A) | (1ULL << INDICATOR_B),
+    .pull_down_en = 0,
+    .pull_up_en = 0,
+  };
+  ESP_ERROR_CHECK(gpio_config(&io_conf));
+  ESP_ERROR_CHECK(gpio_set_level(INDICATOR_A, 0));
+  ESP_ERROR_CHECK(gpio_set_level(INDICATOR_B, 0));
+  ESP_ERROR_CHECK(ic_port_add(GPIO_NUM_5, &button_config, input_changed, NULL));
+  ESP_ERROR_CHECK(ic_port_add(GPIO_NUM_7, &button_config, input_changed, NULL));
+  // 確定はtask1より先に行う
+  ESP_ERROR_CHECK(ic_port_start(2, APP_CPU_NUM));
+}
+#endif
+
 // pio run -e esp32s3box -t upload
 
 void app_main(){
@@ -140,11 +263,24 @@ void app_main(){
   event_group = xEventGroupCreate();
   xEventGroupClearBits(event_group, 0xFFFFFF);
 
+  // create & initialize cond group
+  // ボタン2つ同時押し(AND)、レベルトリガー、起床後クリア
+  cond_group_init(&cond_group);
+  cond_waiter_init(&cond_waiter, EVENT_GPIO_A | EVENT_GPIO_B, COND_WAIT_ALL, COND_TRIGGER_LEVEL, true);
+  cond_group_add_waiter(&cond_group, &cond_waiter);
+
   gpio_trriger(GPIO_NUM_5);
   gpio_trriger(GPIO_NUM_7);
+#if USE_INPUT_COND
+  setup_input_cond();
+#endif
 
   xTaskCreatePinnedToCore(task1, "task1", 8192, NULL, 1, &taskHandle, APP_CPU_NUM);
+#if USE_INPUT_COND
+  xTaskCreatePinnedToCore(task2, "task2", 8192, NULL, 1, &taskHandle2, APP_CPU_NUM);
+#else
   //xTaskCreatePinnedToCore(task2, "task2", 8192, NULL, 1, &taskHandle2, APP_CPU_NUM);
+#endif
 
   ESP_LOGI(TAG, "<=== app_main end");
 }
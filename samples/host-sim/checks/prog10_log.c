@@ -0,0 +1,185 @@
+// prog10のADCの記録(adc_log.c)をホストで確認する
+// 1kHzのサンプルの途中で、フラッシュの書き込みでサンプリングのタスクが止まって遅れた分をまとめて読んだときに、
+// サンプル毎の時刻が読んだ時刻どおりに残るか、65ms以上止まったときにブロックを分けるか、
+// 書き込みが間に合わないときに捨てて数えるか、再起動したときに前回の一番新しいブロックの続きから始めるかを確かめる
+#include <stdio.h>
+#include <string.h>
+#include "adc_log.h"
+
+#define PERIOD_US 1000
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+// ブロックの先頭の時刻にdt_usを足していき、index番目のサンプルの時刻を返す
+static int64_t sample_time(const adc_log_block_t *b, uint32_t index){
+  int64_t t = b->header.timestamp_us;
+  for (uint32_t i = 0; i <= index; i++) {
+    t += b->samples[i].dt_us;
+  }
+  return t;
+}
+
+// 埋まったブロックを書き込み側と同じ手順で受け取る(CRCを付けてコピーし、解放する)
+static int take(adc_log_t *log, int buf, adc_log_block_t *out){
+  adc_log_block_t *b = adc_log_take(log, buf);
+  if (b == NULL) {
+    return 0;
+  }
+  memcpy(out, b, sizeof(*out));
+  adc_log_release(log, buf);
+  return 1;
+}
+
+static adc_log_t logger;
+static adc_log_block_t blocks[4];
+
+// 500サンプル目から40ms止まり、戻ってから遅れた40サンプルを10us間隔で読む
+static void check_stall(void){
+  printf("-- sampling task stalled by a flash write\n");
+  adc_log_init(&logger, 4, PERIOD_US);
+  int64_t t = 1000000;
+  int64_t times[ADC_LOG_SAMPLES_PER_BLOCK];
+  int full = -1;
+  for (uint32_t i = 0; i < ADC_LOG_SAMPLES_PER_BLOCK; i++) {
+    if (i == 500) {
+      t += 40 * PERIOD_US;
+    } else if (i > 500 && i <= 540) {
+      t += 10;
+    } else if (i > 0) {
+      t += PERIOD_US;
+    }
+    times[i] = t;
+    int ret = adc_log_put(&logger, (uint16_t)(i & 0xfff), t);
+    if (ret >= 0) {
+      full = ret;
+    }
+  }
+  expect(full == 0 && take(&logger, full, &blocks[0]), "block is full after one block of samples");
+  const adc_log_block_t *b = &blocks[0];
+  expect(adc_log_block_valid(b), "block is valid");
+  expect(b->header.count == ADC_LOG_SAMPLES_PER_BLOCK && b->header.timestamp_us == times[0], "header keeps the first sample time");
+  expect(b->header.flags == ADC_LOG_FLAG_RESTART, "first block after init is marked as a restart");
+  int same = 1;
+  for (uint32_t i = 0; i < ADC_LOG_SAMPLES_PER_BLOCK; i++) {
+    same &= sample_time(b, i) == times[i] && b->samples[i].value == (i & 0xfff);
+  }
+  expect(same, "every sample keeps the time it was read");
+  expect(b->samples[500].dt_us == 40 * PERIOD_US && b->samples[501].dt_us == 10, "stall and catch-up intervals are recorded");
+
+  // 2つ目のブロックは再起動の印がない
+  adc_log_put(&logger, 0, t + PERIOD_US);
+  expect(logger.blocks[logger.filling].header.flags == 0 && logger.blocks[logger.filling].header.seq == 1, "next block continues");
+}
+
+// 65535usを超えて止まったら、ブロックを閉じて次のブロックのヘッダに時刻を書く
+static void check_long_stall(void){
+  printf("-- stall longer than the sample interval field\n");
+  adc_log_init(&logger, 4, PERIOD_US);
+  int64_t t = 0;
+  for (int i = 0; i < 10; i++) {
+    if (adc_log_put(&logger, 100, t) >= 0) {
+      expect(0, "block closed too early");
+    }
+    t += PERIOD_US;
+  }
+  t += 200000;
+  int full = adc_log_put(&logger, 200, t);
+  expect(full == 0 && take(&logger, full, &blocks[0]), "block is closed at the long stall");
+  expect(blocks[0].header.count == 10 && adc_log_block_valid(&blocks[0]), "closed block keeps the samples before the stall");
+  const adc_log_block_t *next = &logger.blocks[logger.filling];
+  expect(next->header.timestamp_us == t && next->header.count == 1 && next->samples[0].dt_us == 0,
+    "next block starts at the late sample");
+  expect(next->header.first_index == 10 && next->header.seq == 1, "no sample is lost");
+  expect(adc_log_put(&logger, 200, t - 1) == 1, "time going backwards also closes the block");
+}
+
+// 書き込み側が2つのバッファを返さないと、サンプルを捨てて次のブロックに印を付ける
+static void check_drop(void){
+  printf("-- writer falls behind\n");
+  adc_log_init(&logger, 4, PERIOD_US);
+  int64_t t = 0;
+  int full[2] = {-1, -1};
+  int n = 0;
+  for (uint32_t i = 0; i < ADC_LOG_SAMPLES_PER_BLOCK * 2; i++, t += PERIOD_US) {
+    int ret = adc_log_put(&logger, 1, t);
+    if (ret >= 0 && n < 2) {
+      full[n++] = ret;
+    }
+  }
+  int returned = 0;
+  for (int i = 0; i < 5; i++, t += PERIOD_US) {
+    returned += adc_log_put(&logger, 1, t) >= 0;
+  }
+  expect(n == 2 && returned == 0, "no buffer while the writer is busy");
+  expect(logger.dropped == 5, "dropped samples are counted");
+  take(&logger, full[0], &blocks[0]);
+  adc_log_put(&logger, 1, t);
+  const adc_log_header_t *h = &logger.blocks[logger.filling].header;
+  expect((h->flags & ADC_LOG_FLAG_GAP) && h->dropped == 5, "next block is marked with the gap");
+  expect(h->first_index == ADC_LOG_SAMPLES_PER_BLOCK * 2 + 5, "sample index counts the dropped samples");
+}
+
+// パーティションを一周した後の記録: 位置0..3にseq 8, 5, 6, 7。位置0の次に書く
+static void check_resume(void){
+  printf("-- resume after a restart\n");
+  adc_log_init(&logger, 4, PERIOD_US);
+  adc_log_block_t stored[5];
+  memset(stored, 0xff, sizeof(stored));
+  static const uint32_t seqs[4] = {8, 5, 6, 7};
+  int64_t t = 0;
+  for (uint32_t seq = 0; seq <= 9; seq++) {
+    for (uint32_t i = 0; i < ADC_LOG_SAMPLES_PER_BLOCK; i++, t += PERIOD_US) {
+      int full = adc_log_put(&logger, (uint16_t)seq, t);
+      if (full < 0) {
+        continue;
+      }
+      adc_log_block_t b;
+      take(&logger, full, &b);
+      for (int pos = 0; pos < 4; pos++) {
+        if (seqs[pos] == b.header.seq) {
+          stored[pos] = b;
+        }
+      }
+      if (b.header.seq == 9) {
+        // 書き込み中に電源が切れたブロック(CRCが合わない)
+        stored[4] = b;
+        stored[4].samples[0].value ^= 1;
+      }
+    }
+  }
+  adc_log_scan_t scan;
+  adc_log_scan_init(&scan);
+  for (uint32_t pos = 0; pos < 5; pos++) {
+    adc_log_scan_block(&scan, pos, &stored[pos]);
+  }
+  expect(scan.found && scan.seq == 8 && scan.block_no == 0, "newest valid block is seq 8 at block 0");
+  expect(scan.next_index == (uint64_t)ADC_LOG_SAMPLES_PER_BLOCK * 9, "next sample index follows seq 8");
+
+  adc_log_init(&logger, 4, PERIOD_US);
+  adc_log_resume(&logger, &scan);
+  adc_log_put(&logger, 1, 5);
+  const adc_log_header_t *h = &logger.blocks[logger.filling].header;
+  expect(h->seq == 9 && h->first_index == scan.next_index, "seq and sample index continue");
+  expect(h->flags == ADC_LOG_FLAG_RESTART, "first block after the restart is marked");
+
+  adc_log_scan_t empty;
+  adc_log_scan_init(&empty);
+  adc_log_block_t erased;
+  memset(&erased, 0xff, sizeof(erased));
+  adc_log_scan_block(&empty, 0, &erased);
+  expect(!empty.found, "erased storage starts from block 0");
+}
+
+int main(void){
+  check_stall();
+  check_long_stall();
+  check_drop();
+  check_resume();
+  printf("adc log: %d cases failed\n", failed);
+  return failed != 0;
+}
@@ -0,0 +1,90 @@
+// prog12の割込みの予算(isr_budget.c)をホストで確認する
+// 期間10ms、1期間に5回まで、止める時間は20msから始めて80msまで(cycles_per_usは1)
+//
+//   0ms    10ms毎の期間に5回     -> 止めない
+//   20ms   6回目                 -> 止める(20ms)。止めている間の割込みは数えない
+//   40ms   戻す -> すぐにまた超える -> 40ms、その次は80ms(上限)
+//   2s後   超える                -> 20msに戻る
+//
+// 1秒毎の統計(回数/秒、CPU使用率)と、サイクル数の上限も確かめる
+#include <stdio.h>
+#include "isr_budget.h"
+
+#define MS 1000
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+static const isr_budget_config_t config = {
+  .period_us = 10 * MS,
+  .max_count = 5,
+  .mask_us = 20 * MS,
+  .mask_max_us = 80 * MS,
+};
+
+// t_usから1ms毎にn回入れて、超えたらその時刻を返す(超えなければ-1)
+static int64_t burst(isr_budget_t *b, int64_t t_us, int n, uint32_t cycles){
+  for (int i = 0; i < n; i++) {
+    if (isr_budget_account(b, t_us + i * MS, cycles)) {
+      return t_us + i * MS;
+    }
+  }
+  return -1;
+}
+
+static void check_mask(void){
+  printf("-- count limit and backoff\n");
+  isr_budget_t b;
+  isr_budget_stats_t s;
+  isr_budget_init(&b, "check", &config, 1, 0);
+  expect(burst(&b, 0, 5, 10) == -1 && burst(&b, 10 * MS, 5, 10) == -1, "5 per period is within the budget");
+  expect(burst(&b, 20 * MS, 6, 10) == 25 * MS, "6th in a period masks");
+  isr_budget_get_stats(&b, &s);
+  expect(s.masked && s.masks == 1 && s.count == 16, "masked once, 16 counted");
+
+  // 無効にする前に入っていた分は、trueを返すだけで数えない
+  expect(isr_budget_account(&b, 26 * MS, 1000), "still masked");
+  isr_budget_get_stats(&b, &s);
+  expect(s.count == 16 && s.cycles_total == 160 && s.cycles_max == 10, "interrupt while masked is not counted");
+
+  expect(!isr_budget_poll(&b, 44 * MS) && isr_budget_poll(&b, 45 * MS), "unmask after 20 ms");
+  isr_budget_unmasked(&b, 45 * MS);
+  expect(burst(&b, 45 * MS, 6, 10) == 50 * MS && b.unmask_us == 90 * MS, "masked again soon: 40 ms");
+  isr_budget_unmasked(&b, 90 * MS);
+  expect(burst(&b, 90 * MS, 6, 10) == 95 * MS && b.unmask_us == 175 * MS, "then 80 ms");
+  isr_budget_unmasked(&b, 175 * MS);
+  expect(burst(&b, 175 * MS, 6, 10) == 180 * MS && b.unmask_us == 260 * MS, "80 ms is the limit");
+  isr_budget_unmasked(&b, 260 * MS);
+  expect(burst(&b, 2260 * MS, 6, 10) == 2265 * MS && b.unmask_us == 2285 * MS, "back to 20 ms after a quiet second");
+  isr_budget_get_stats(&b, &s);
+  expect(s.masks == 5 && s.masked_us == 20 * MS + 40 * MS + 80 * MS + 80 * MS, "masks and masked time");
+}
+
+static void check_cycles(void){
+  printf("-- cycle limit and rates\n");
+  const isr_budget_config_t by_cycles = {.period_us = 10 * MS, .max_cycles = 1000, .mask_us = 20 * MS, .mask_max_us = 20 * MS};
+  isr_budget_t b;
+  isr_budget_stats_t s;
+  isr_budget_init(&b, "cycles", &by_cycles, 240, 0);
+  expect(burst(&b, 0, 4, 250) == -1 && burst(&b, 4 * MS, 1, 1) == 4 * MS, "over 1000 cycles in a period masks");
+
+  // 1秒に100回、1回24000サイクル(100µs)なら1%
+  isr_budget_init(&b, "rate", &config, 240, 0);
+  for (int i = 0; i < 100; i++) {
+    isr_budget_account(&b, i * 10 * MS, 24000);
+  }
+  expect(!isr_budget_poll(&b, 1000 * MS), "poll");
+  isr_budget_get_stats(&b, &s);
+  expect(s.rate_hz == 100 && s.cpu_permille == 10, "100 Hz, 10 permille");
+}
+
+int main(void){
+  check_mask();
+  check_cycles();
+  printf("isr budget: %d cases failed\n", failed);
+  return failed != 0;
+}
@@ -0,0 +1,113 @@
+// prog12の周期タスク(periodic.c)をホストで確認する
+// 仮想時間で、周期10ms、デッドライン5ms、処理2msのタスクを300ms動かす
+// 100msの周期だけ負荷で35msかかり、110、120、130msの周期が溜まる
+//
+//   PT_CATCH_UP(上限なし): 135msから110、120、130msの周期を続けて処理   -> オーバーラン1、違反4、caught_up 2
+//   PT_CATCH_UP(上限2)   : 110msの周期を捨てて120、130msを処理          -> オーバーラン1、違反3、skipped 1
+//   PT_SKIP              : 3周期を1回にまとめる(periods=3、elapsed 35ms) -> オーバーラン1、違反2、skipped 2
+//
+// どの方針でも、処理した周期、まとめた周期、捨てた周期の合計はリリースした周期の数になる
+#include <stdio.h>
+#include "periodic.h"
+
+#define MS 1000
+#define CHECK_STEP_US     100
+#define CHECK_DURATION_US (300 * MS)
+#define CHECK_PERIOD_US   (10 * MS)
+#define CHECK_DEADLINE_US (5 * MS)
+#define CHECK_EXEC_US     (2 * MS)
+#define CHECK_LOAD_AT_US  (100 * MS)
+#define CHECK_LOAD_US     (35 * MS)
+
+typedef struct {
+  pt_stats_t stats;
+  uint32_t releases;
+  uint32_t accounted;        // periods + skippedの合計
+  uint32_t max_periods;
+  int64_t max_elapsed_us;
+  uint32_t last_seq;
+} load_result_t;
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+static void print_stats(const load_result_t *r){
+  printf("  iterations %u overruns %u misses %u caught_up %u skipped %u max_lateness %lld us\n",
+    r->stats.iterations, r->stats.overruns, r->stats.deadline_misses, r->stats.caught_up, r->stats.skipped,
+    (long long)r->stats.max_lateness_us);
+}
+
+// 1ステップ毎に、リリース -> 処理の終わり -> 次の処理の始まり の順に進める
+static void run_load(pt_policy_t policy, uint32_t max_catch_up, load_result_t *r){
+  pt_config_t config = {
+    .period_us = CHECK_PERIOD_US,
+    .deadline_us = CHECK_DEADLINE_US,
+    .policy = policy,
+    .max_catch_up = max_catch_up,
+  };
+  pt_t pt;
+  pt_tick_t tick;
+  pt_init(&pt, &config);
+  *r = (load_result_t){0};
+  int64_t next_release = CHECK_PERIOD_US;
+  int64_t busy_until = -1;
+  for (int64_t t = 0; t < CHECK_DURATION_US; t += CHECK_STEP_US) {
+    if (t >= next_release) {
+      pt_released(&pt, 1, next_release);
+      next_release += CHECK_PERIOD_US;
+      r->releases++;
+    }
+    if (busy_until >= 0 && t >= busy_until) {
+      pt_end(&pt, busy_until);
+      busy_until = -1;
+    }
+    if (busy_until < 0 && pt_next(&pt, t, &tick)) {
+      busy_until = t + (tick.release_us == CHECK_LOAD_AT_US ? CHECK_LOAD_US : CHECK_EXEC_US);
+      r->accounted += tick.periods + tick.skipped;
+      r->last_seq = tick.seq;
+      if (tick.periods > r->max_periods) {
+        r->max_periods = tick.periods;
+      }
+      if (tick.elapsed_us > r->max_elapsed_us) {
+        r->max_elapsed_us = tick.elapsed_us;
+      }
+    }
+  }
+  if (busy_until >= 0) {
+    pt_end(&pt, busy_until);
+  }
+  pt_get_stats(&pt, &r->stats);
+  print_stats(r);
+}
+
+int main(void){
+  load_result_t r;
+
+  printf("-- PT_CATCH_UP without a limit\n");
+  run_load(PT_CATCH_UP, 0, &r);
+  expect(r.releases == 29 && r.stats.periods == 29 && r.accounted == 29 && r.last_seq == 28, "every period is accounted");
+  expect(r.stats.iterations == 29 && r.stats.overruns == 1 && r.stats.deadline_misses == 4, "one overrun, four misses");
+  expect(r.stats.caught_up == 2 && r.stats.skipped == 0, "two periods caught up");
+  expect(r.stats.max_lateness_us == 25 * MS && r.stats.max_exec_us == CHECK_LOAD_US, "lateness 25 ms, exec 35 ms");
+
+  printf("-- PT_CATCH_UP up to 2\n");
+  run_load(PT_CATCH_UP, 2, &r);
+  expect(r.accounted == 29 && r.last_seq == 28, "every period is accounted");
+  expect(r.stats.iterations == 28 && r.stats.overruns == 1 && r.stats.deadline_misses == 3, "one overrun, three misses");
+  expect(r.stats.caught_up == 1 && r.stats.skipped == 1 && r.stats.max_lateness_us == 15 * MS,
+    "oldest period dropped, lateness 15 ms");
+
+  printf("-- PT_SKIP\n");
+  run_load(PT_SKIP, 0, &r);
+  expect(r.accounted == 29 && r.last_seq == 28, "every period is accounted");
+  expect(r.stats.iterations == 27 && r.stats.overruns == 1 && r.stats.deadline_misses == 2, "one overrun, two misses");
+  expect(r.stats.caught_up == 0 && r.stats.skipped == 2 && r.stats.max_lateness_us == 5 * MS, "two periods merged");
+  expect(r.max_periods == 3 && r.max_elapsed_us == 35 * MS, "merged tick covers 3 periods and 35 ms");
+
+  printf("periodic: %d cases failed\n", failed);
+  return failed != 0;
+}
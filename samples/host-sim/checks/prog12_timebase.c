@@ -0,0 +1,124 @@
+// prog12の時刻付きのストリーム(timebase.c)をホストで確認する
+// ずれが分かっている合成ストリームを1ms格子に揃えて、真の値と比べる
+//
+//   A: 正弦波(振幅1000、周期200ms)を1kHzでサンプル、時刻は150µs遅れて付く      -> offset -150、直線補間
+//   B: 同じ正弦波を400Hzでサンプル、別のクロックで2ms進んでいる                 -> offset -2000、直線補間
+//   C: 2～4ms毎(LCGでばらつかせる)のイベントの回数、時刻は300µs早く付く、600ms以降は止まる -> offset +300、ホールド
+//
+// 仮想時間を100µsずつ進めながらpushとtb_align_nextを交互に呼び、1ms格子の各行を真の値と比べる
+// (C の真の値は格子の時刻までのイベント数なので、ホールドの誤差は0になる)。補正しない場合の誤差も比べて出す
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include "timebase.h"
+
+#define CHECK_DURATION_US   1000000
+#define CHECK_STEP_US       100
+#define CHECK_GRID_US       1000
+#define CHECK_START_US      10000
+#define CHECK_TIMEOUT_US    20000
+#define CHECK_C_STOP_US     600000
+
+#define A_PERIOD_US   1000
+#define A_DELAY_US    150
+#define B_PERIOD_US   2500
+#define B_CLOCK_US    2000
+#define C_EARLY_US    300
+
+typedef struct {
+  uint32_t rows;
+  uint32_t stale;            // Cが止まった後の行
+  uint32_t dropped;
+  double max_err_linear;     // A、Bの誤差の最大値
+  double max_err_hold;       // Cの誤差の最大値
+} result_t;
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+static double truth(int64_t t_us){
+  return 1000.0 * sin(2 * M_PI * (double)t_us / 200000.0);
+}
+
+static uint32_t lcg(uint32_t *state){
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 16;
+}
+
+// correct_offsetが0ならoffsetを入れずに揃える(補正しないとどれだけずれるかの比較用)
+static void run_synthetic(int correct_offset, result_t *result){
+  static tb_sample_t buf_a[64], buf_b[64], buf_c[64];
+  static int64_t events[512];
+  tb_stream_t a, b, c;
+  tb_stream_init(&a, buf_a, 64, TB_INTERP_LINEAR, correct_offset ? -A_DELAY_US : 0, CHECK_TIMEOUT_US);
+  tb_stream_init(&b, buf_b, 64, TB_INTERP_LINEAR, correct_offset ? -B_CLOCK_US : 0, CHECK_TIMEOUT_US);
+  tb_stream_init(&c, buf_c, 64, TB_INTERP_HOLD, correct_offset ? C_EARLY_US : 0, CHECK_TIMEOUT_US);
+  tb_align_t al;
+  tb_align_init(&al, CHECK_START_US, CHECK_GRID_US);
+  tb_align_add(&al, &a);
+  tb_align_add(&al, &b);
+  tb_align_add(&al, &c);
+
+  // Cのイベント時刻(真の時刻)
+  uint32_t seed = 12345;
+  int num_events = 0;
+  for (int64_t t = 2000; t < CHECK_C_STOP_US && num_events < 512; t += 2000 + lcg(&seed) % 2000) {
+    events[num_events++] = t;
+  }
+
+  memset(result, 0, sizeof(*result));
+  int64_t next_a = 0, next_b = 0;
+  int next_c = 0;
+  for (int64_t now = 0; now <= CHECK_DURATION_US; now += CHECK_STEP_US) {
+    // 真の時刻nowにサンプルしたものを、それぞれのずれを付けて記録する
+    if (now >= next_a) {
+      tb_stream_push(&a, next_a + A_DELAY_US, (int32_t)lround(truth(next_a)));
+      next_a += A_PERIOD_US;
+    }
+    if (now >= next_b) {
+      tb_stream_push(&b, next_b + B_CLOCK_US, (int32_t)lround(truth(next_b)));
+      next_b += B_PERIOD_US;
+    }
+    while (next_c < num_events && events[next_c] <= now) {
+      tb_stream_push(&c, events[next_c] - C_EARLY_US, next_c + 1);
+      next_c++;
+    }
+
+    int64_t t;
+    float v[3];
+    while (tb_align_next(&al, now, &t, v)) {
+      int count = 0;
+      while (count < num_events && events[count] <= t) {
+        count++;
+      }
+      double ea = fabs(v[0] - truth(t));
+      double eb = fabs(v[1] - truth(t));
+      double ec = fabs(v[2] - count);
+      result->max_err_linear = fmax(result->max_err_linear, fmax(ea, eb));
+      result->max_err_hold = fmax(result->max_err_hold, ec);
+    }
+  }
+  result->rows = al.rows;
+  result->stale = al.stale;
+  result->dropped = a.dropped + b.dropped + c.dropped;
+}
+
+int main(void){
+  result_t r, raw;
+  run_synthetic(1, &r);
+  run_synthetic(0, &raw);
+  printf("rows=%u stale=%u linear err=%.3f (uncorrected %.3f) hold err=%.0f (uncorrected %.0f)\n",
+    r.rows, r.stale, r.max_err_linear, raw.max_err_linear, r.max_err_hold, raw.max_err_hold);
+  expect(r.rows > 0 && r.dropped == 0, "every grid row is produced without dropping samples");
+  expect(r.stale > 0, "rows after C stops are counted as stale");
+  // 直線補間の誤差は、値の丸め(0.5) + 400Hzでの補間誤差(約0.8)の範囲
+  expect(r.max_err_linear <= 1.5, "linear streams match the truth after the offset correction");
+  expect(r.max_err_hold == 0, "held event count matches the truth");
+  expect(raw.max_err_linear > r.max_err_linear && raw.max_err_hold > 0, "without the correction the error is larger");
+  printf("timebase: %d cases failed\n", failed);
+  return failed != 0;
+}
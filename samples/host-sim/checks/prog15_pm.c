@@ -0,0 +1,90 @@
+// prog15の電力の方針(pm_policy.c)をホストで確認する
+// 復帰時間 IDLE=50us、LIGHT_SLEEP=1000us で、2つのクライアントの要求を順に変える
+//
+//   0ms    enc=ANY ctl=ANY  -> LIGHT_SLEEP
+//   100ms  enc=200us        -> IDLE
+//   150ms  ctl=20us         -> ACTIVE
+//   160ms  ctl=500us        -> IDLE(encの200usが残る)
+//   300ms  enc=ANY          -> IDLE のまま(ctlの500usではライトスリープできない)
+//   400ms  ctl=ANY          -> LIGHT_SLEEP  実測800usは違反ではない
+//   1000ms enc=300us        -> IDLE         実測400usは違反
+//
+// 1000msまでの滞在時間 ACTIVE=10ms IDLE=290ms LIGHT_SLEEP=700ms、状態の境界値、クライアントの上限も確かめる
+#include <stdio.h>
+#include "pm_policy.h"
+
+#define MS 1000
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+static const pm_config_t config = {.exit_latency_us = {0, 50, 1000}};
+
+// 要求と復帰時間が同じなら入れる
+static void check_select(void){
+  printf("-- state boundaries\n");
+  expect(pm_policy_select(&config, 49) == PM_STATE_ACTIVE, "49 us stays active");
+  expect(pm_policy_select(&config, 50) == PM_STATE_IDLE, "50 us allows idle");
+  expect(pm_policy_select(&config, 999) == PM_STATE_IDLE, "999 us stays idle");
+  expect(pm_policy_select(&config, 1000) == PM_STATE_LIGHT_SLEEP, "1000 us allows light sleep");
+  expect(pm_policy_select(&config, PM_LATENCY_ANY) == PM_STATE_LIGHT_SLEEP, "no requirement allows light sleep");
+}
+
+static void check_scenario(void){
+  printf("-- two clients\n");
+  pm_policy_t p;
+  pm_stats_t s;
+  pm_policy_init(&p, &config, 0);
+  int enc = pm_policy_add_client(&p, "enc", PM_LATENCY_ANY, 0);
+  int ctl = pm_policy_add_client(&p, "ctl", PM_LATENCY_ANY, 0);
+  expect(enc == 0 && ctl == 1 && pm_policy_state(&p) == PM_STATE_LIGHT_SLEEP, "0 ms: light sleep");
+
+  expect(pm_policy_set_latency(&p, enc, 200, 100 * MS) && pm_policy_state(&p) == PM_STATE_IDLE, "100 ms: idle");
+  expect(pm_policy_set_latency(&p, ctl, 20, 150 * MS) && pm_policy_state(&p) == PM_STATE_ACTIVE, "150 ms: active");
+  expect(pm_policy_set_latency(&p, ctl, 500, 160 * MS) && pm_policy_state(&p) == PM_STATE_IDLE,
+    "160 ms: idle for the 200 us of enc");
+  expect(!pm_policy_set_latency(&p, enc, PM_LATENCY_ANY, 300 * MS) && pm_policy_state(&p) == PM_STATE_IDLE,
+    "300 ms: still idle for the 500 us of ctl");
+  expect(pm_policy_set_latency(&p, ctl, PM_LATENCY_ANY, 400 * MS) && pm_policy_state(&p) == PM_STATE_LIGHT_SLEEP,
+    "400 ms: light sleep");
+  pm_policy_wake(&p, 800);
+  // LIGHT_SLEEPを選んでいた700msのうち、実際に眠ったのは3回で450ms
+  pm_policy_slept(&p, 2, 300 * MS);
+  pm_policy_slept(&p, 1, 150 * MS);
+  expect(pm_policy_set_latency(&p, enc, 300, 1000 * MS) && pm_policy_state(&p) == PM_STATE_IDLE, "1000 ms: idle");
+  pm_policy_wake(&p, 400);
+
+  pm_policy_get_stats(&p, 1000 * MS, &s);
+  printf("  selected active %llu idle %llu light %llu [us], slept %llu us in %lu sleeps\n",
+    (unsigned long long)s.selected_us[PM_STATE_ACTIVE], (unsigned long long)s.selected_us[PM_STATE_IDLE],
+    (unsigned long long)s.selected_us[PM_STATE_LIGHT_SLEEP], (unsigned long long)s.slept_us, (unsigned long)s.sleeps);
+  expect(s.selected_us[PM_STATE_ACTIVE] == 10 * MS && s.selected_us[PM_STATE_IDLE] == 290 * MS
+    && s.selected_us[PM_STATE_LIGHT_SLEEP] == 700 * MS, "selected time 10, 290, 700 ms");
+  expect(s.sleeps == 3 && s.slept_us == 450 * MS, "3 sleeps, 450 ms asleep");
+  expect(s.entries[PM_STATE_ACTIVE] == 1 && s.entries[PM_STATE_IDLE] == 3 && s.entries[PM_STATE_LIGHT_SLEEP] == 2,
+    "state entries");
+  expect(s.wakes == 2 && s.wake_max_us == 800 && s.violations == 1, "800 us wake is fine, 400 us in idle is a violation");
+  expect(s.wake_max_us_by_state[PM_STATE_LIGHT_SLEEP] == 800 && s.wake_max_us_by_state[PM_STATE_IDLE] == 400,
+    "wake latency by state");
+  expect(s.latency_us == 300, "current requirement");
+
+  printf("-- client limit\n");
+  int added = 1;
+  for (int i = p.num_clients; i < PM_MAX_CLIENTS; i++) {
+    added &= pm_policy_add_client(&p, "extra", PM_LATENCY_ANY, 1000 * MS) >= 0;
+  }
+  expect(added, "clients up to PM_MAX_CLIENTS");
+  expect(pm_policy_add_client(&p, "over", PM_LATENCY_ANY, 1000 * MS) == -1, "client over the limit");
+  expect(!pm_policy_set_latency(&p, PM_MAX_CLIENTS, 0, 1000 * MS), "id out of range is ignored");
+}
+
+int main(void){
+  check_select();
+  check_scenario();
+  printf("pm policy: %d cases failed\n", failed);
+  return failed != 0;
+}
@@ -0,0 +1,122 @@
+// prog16の設定ストア(config_store.c)をホストで確認する
+// prog16はWi-Fiを使うのでシミュレーションしないが、ESP-IDFに依存しないロジックはここで動かす
+// 整数、小数、真偽の3つの設定で
+//   既定値、テキストでの変更(バージョンが1つ進み、購読者には自分の分だけ知らせる)、
+//   同じ値ならバージョンが変わらない、誤り(知らないキー、型、範囲外)があればまとめて適用しない、
+//   cfg_formatで書いたテキストを読み直すと同じ値になる、を確かめる
+// 失敗があれば1で終わる。読む側の速さはnsで表示する(実機は起動時にCPUサイクルで表示する)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "config_store.h"
+#include "config_store_bench.h"
+
+enum { C_RATE, C_GAIN, C_ENABLE, C_NUM };
+static const cfg_def_t check_defs[C_NUM] = {
+  [C_RATE] = {"rate_ms", CFG_INT, 100, 10, 1000},
+  [C_GAIN] = {"gain", CFG_FLOAT, 0.5, 0, 2},
+  [C_ENABLE] = {"enable", CFG_BOOL, 1, 0, 1},
+};
+
+typedef struct {
+  int calls;
+  uint32_t changed;
+} notified_t;
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+static void on_change(const cfg_store_t *s, uint32_t changed, void *arg){
+  notified_t *n = (notified_t *)arg;
+  (void)s;
+  n->calls++;
+  n->changed |= changed;
+}
+
+// テキストを解釈して適用し、購読者に知らせる(portと同じ流れ)。誤りなら-1
+static int apply_text(cfg_store_t *s, const char *text, int *error_line){
+  cfg_change_t changes[C_NUM * 2];
+  cfg_status_t status;
+  int n = cfg_parse_text(s, text, changes, C_NUM * 2, &status, error_line);
+  if (n < 0) {
+    return -1;
+  }
+  uint32_t changed = cfg_apply(s, changes, n);
+  cfg_notify(s, changed);
+  return (int)changed;
+}
+
+static void check_cases(void){
+  cfg_store_t s;
+  notified_t rate_sub = {0}, all_sub = {0};
+  int line;
+
+  printf("-- defaults\n");
+  expect(cfg_init(&s, check_defs, C_NUM) == 0, "init");
+  expect(cfg_get_int(&s, C_RATE) == 100 && cfg_get_float(&s, C_GAIN) == 0.5f && cfg_get_bool(&s, C_ENABLE),
+    "default values");
+  expect(cfg_version(&s) == 0 && cfg_find(&s, "gain") == C_GAIN && cfg_find(&s, "none") == -1, "version 0, find");
+  cfg_subscribe(&s, 1u << C_RATE, on_change, &rate_sub);
+  cfg_subscribe(&s, UINT32_MAX, on_change, &all_sub);
+
+  printf("-- changes from text\n");
+  // 2つ変える。空行、コメント、空白は飛ばす
+  expect(apply_text(&s, "# tune\n rate_ms = 250\n\ngain=1.25\n", &line) == ((1 << C_RATE) | (1 << C_GAIN)),
+    "two keys changed, comments and blank lines skipped");
+  expect(cfg_get_int(&s, C_RATE) == 250 && cfg_get_float(&s, C_GAIN) == 1.25f && cfg_version(&s) == 1,
+    "new values, version 1");
+  expect(rate_sub.calls == 1 && rate_sub.changed == (1u << C_RATE), "subscriber of rate_ms sees only its key");
+  expect(all_sub.calls == 1 && all_sub.changed == ((1u << C_RATE) | (1u << C_GAIN)), "subscriber of all keys");
+  expect(apply_text(&s, "rate_ms=250", &line) == 0 && cfg_version(&s) == 1 && all_sub.calls == 1,
+    "same value changes nothing");
+
+  printf("-- errors apply nothing\n");
+  // 1つでも誤りがあれば、前の行も適用しない
+  expect(apply_text(&s, "enable=false\nrate_ms=5000\n", &line) == -1 && line == 2, "out of range on line 2");
+  expect(apply_text(&s, "enable=false\nspeed=1\n", &line) == -1 && line == 2, "unknown key on line 2");
+  expect(apply_text(&s, "rate_ms=12.5", &line) == -1 && apply_text(&s, "enable=maybe", &line) == -1, "wrong type");
+  expect(apply_text(&s, "gain", &line) == -1, "missing value");
+  expect(cfg_get_bool(&s, C_ENABLE) && cfg_version(&s) == 1, "earlier lines are not applied");
+  expect(apply_text(&s, "enable=off", &line) == (1 << C_ENABLE) && !cfg_get_bool(&s, C_ENABLE), "enable=off");
+  expect(rate_sub.calls == 1 && all_sub.calls == 2, "only the subscriber of all keys is notified");
+
+  printf("-- format and read back\n");
+  // 書き出したテキストを既定値のストアに読み直すと同じ値になる
+  char text[128];
+  uint32_t a[C_NUM], b[C_NUM];
+  cfg_format(&s, text, sizeof(text));
+  cfg_store_t copy;
+  cfg_init(&copy, check_defs, C_NUM);
+  expect(apply_text(&copy, text, &line) >= 0, "formatted text is accepted");
+  expect(cfg_read(&s, a) == 2 && cfg_read(&copy, b) == 1 && memcmp(a, b, sizeof(a)) == 0, "same values");
+
+  // 範囲外の既定値、長すぎるキーは登録できない
+  static const cfg_def_t bad_def[] = {{"x", CFG_INT, 5, 0, 1}};
+  static const cfg_def_t long_key[] = {{"much_too_long_key", CFG_INT, 0, 0, 1}};
+  expect(cfg_init(&copy, bad_def, 1) == -1 && cfg_init(&copy, long_key, 1) == -1, "bad definitions are rejected");
+}
+
+static uint32_t clock_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+int main(int argc, char **argv){
+  uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1000000;
+  check_cases();
+  printf("config store: %d cases failed\n", failed);
+
+  cfg_bench_result_t bench;
+  cfg_bench_reads(iterations, clock_ns, &bench);
+  printf("config read cost (ns per read, total ns for %u iterations): get_int=%u.%02u (%u) version=%u.%02u (%u) read_all=%u.%02u (%u)\n",
+    bench.iterations, bench.get_int_x100 / 100, bench.get_int_x100 % 100, bench.get_int_total,
+    bench.version_x100 / 100, bench.version_x100 % 100, bench.version_total,
+    bench.read_all_x100 / 100, bench.read_all_x100 % 100, bench.read_all_total);
+  return failed != 0;
+}
@@ -0,0 +1,392 @@
+// prog16のヒープの割り当てプロファイラ(heap_prof.c)をホストで確認する
+// 呼び出し元毎の回数と残りのバイト、知らないポインタの解放、ホットパスとPSRAMの数、リーク候補、
+// 表から外した後も同じ位置に来る割り当てが見つかる、表と呼び出し元が溢れたとき、断片化の時系列、
+// トレースの行を書いて読むと同じ集計、壊れた行、レポートの中身、を確かめる
+// 確認の後、割り当てと解放1回の集計にかかる時間を表示する
+//
+//   check_prog16_heap [--trace file] [--expect file]
+// --traceは割り当てのトレース("HP ..."の行。実機でheap_traceをtrueにしたシリアルの出力をそのまま使える)を読み直して、レポートを表示する
+// --expectは1行1条件(#以降はコメント)
+//   <metric> <op> <value>    allocs == 1000、internal_frag_max_pm <= 300 など(opは== != < <= > >=)
+//   leak <pc>                そのPCを含む呼び出し元がリーク候補になっている
+//   hot <pc>                 そのPCを含む呼び出し元にホットパスの割り当てがある
+// metric: allocs frees unknown_frees untracked sites hot_allocs hot_psram_allocs leak_sites
+//         <region>_live <region>_peak <region>_samples <region>_frag_max_pm <region>_largest_min(regionはinternalかpsram)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "heap_prof.h"
+#include "heap_prof_bench.h"
+
+static uint32_t clock_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+static const uint32_t site_a[HP_DEPTH] = {0x42001000, 0x42002000, 0x42003000, 0};
+static const uint32_t site_b[HP_DEPTH] = {0x42001000, 0x42002000, 0x42004000, 0};
+
+static hp_event_t alloc_event(uint32_t ptr, uint32_t size, const uint32_t *pc, uint8_t flags){
+  hp_event_t e = {.type = 'a', .ptr = ptr, .size = size, .caps = 0x1800, .flags = flags};
+  memcpy(e.pc, pc, sizeof(e.pc));
+  return e;
+}
+
+static void alloc(hp_t *prof, uint32_t ptr, uint32_t size, const uint32_t *pc, uint8_t flags){
+  hp_event_t e = alloc_event(ptr, size, pc, flags);
+  hp_alloc(prof, &e);
+}
+
+static const hp_site_t *site_of(const hp_t *prof, const uint32_t *pc){
+  for (int i = 0; i < prof->num_sites; i++) {
+    if (memcmp(prof->sites[i].pc, pc, sizeof(prof->sites[i].pc)) == 0) {
+      return &prof->sites[i];
+    }
+  }
+  return NULL;
+}
+
+static bool same_totals(const hp_t *a, const hp_t *b){
+  if (a->allocs != b->allocs || a->frees != b->frees || a->unknown_frees != b->unknown_frees
+    || a->hot_allocs != b->hot_allocs || a->hot_psram_allocs != b->hot_psram_allocs || a->num_sites != b->num_sites
+    || a->num_live != b->num_live) {
+    return false;
+  }
+  for (int r = 0; r < HP_REGION_NUM; r++) {
+    if (a->live_bytes[r] != b->live_bytes[r] || a->peak_live_bytes[r] != b->peak_live_bytes[r]
+      || hp_series_len(a, (hp_region_t)r) != hp_series_len(b, (hp_region_t)r)) {
+      return false;
+    }
+  }
+  for (int i = 0; i < a->num_sites; i++) {
+    const hp_site_t *x = &a->sites[i], *y = &b->sites[i];
+    if (memcmp(x->pc, y->pc, sizeof(x->pc)) != 0 || x->allocs != y->allocs || x->live_bytes != y->live_bytes
+      || x->caps != y->caps || x->hot_allocs != y->hot_allocs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int check_cases(void){
+  static hp_t prof, rx;
+  static char text[2048];
+  int failed = 0;
+
+  // 呼び出し元毎の回数と残り
+  hp_init(&prof);
+  alloc(&prof, 0x3fc90000, 100, site_a, 0);
+  alloc(&prof, 0x3fc90100, 200, site_a, 0);
+  alloc(&prof, 0x3fc90200, 50, site_b, 0);
+  hp_free(&prof, 0x3fc90000);
+  hp_free(&prof, 0x3fc99999);                                    // 知らないポインタ
+  hp_free(&prof, 0);                                             // free(NULL)は数えない
+  const hp_site_t *a = site_of(&prof, site_a), *b = site_of(&prof, site_b);
+  failed += prof.num_sites != 2 || a == NULL || b == NULL;
+  if (a != NULL && b != NULL) {
+    failed += a->allocs != 2 || a->frees != 1 || a->live_count != 1 || a->live_bytes != 200 || a->peak_bytes != 300;
+    failed += a->min_size != 100 || a->max_size != 200 || a->total_bytes != 300 || a->caps != 0x1800;
+    failed += b->live_bytes != 50 || b->frees != 0;
+  }
+  failed += prof.allocs != 3 || prof.frees != 1 || prof.unknown_frees != 1;
+  failed += prof.live_bytes[HP_REGION_INTERNAL] != 250 || prof.peak_live_bytes[HP_REGION_INTERNAL] != 350;
+
+  // 解放を取りこぼして同じポインタがまた来たら、前のは解放したことにする
+  alloc(&prof, 0x3fc90200, 60, site_b, 0);
+  failed += prof.unknown_frees != 2 || prof.num_live != 2 || (b != NULL && (b->live_bytes != 60 || b->live_count != 1));
+
+  // ホットパスとPSRAM
+  alloc(&prof, 0x3c000000, 1000, site_b, HP_FLAG_HOT | HP_FLAG_PSRAM);
+  alloc(&prof, 0x3fc90300, 10, site_b, HP_FLAG_ISR);
+  failed += prof.hot_allocs != 2 || prof.hot_psram_allocs != 1 || (b != NULL && b->hot_allocs != 2);
+  failed += prof.live_bytes[HP_REGION_PSRAM] != 1000 || (b != NULL && b->region_allocs[HP_REGION_PSRAM] != 1);
+  hp_free(&prof, 0x3c000000);
+  failed += prof.live_bytes[HP_REGION_PSRAM] != 0 || prof.peak_live_bytes[HP_REGION_PSRAM] != 1000;
+
+  // リーク候補: 残っている数が4以上で、割り当てた数の半分を超える
+  hp_init(&prof);
+  for (uint32_t i = 0; i < 8; i++) {
+    alloc(&prof, 0x3fc80000 + i * 16, 16, site_a, 0);
+    if (i < 5) {
+      hp_free(&prof, 0x3fc80000 + i * 16);
+    }
+  }
+  failed += hp_is_leak_suspect(&prof.sites[0]);                  // 残り3
+  alloc(&prof, 0x3fc81000, 16, site_a, 0);
+  failed += hp_is_leak_suspect(&prof.sites[0]);                  // 残り4、割り当て9
+  for (uint32_t i = 0; i < 4; i++) {
+    alloc(&prof, 0x3fc82000 + i * 16, 16, site_b, 0);
+  }
+  failed += !hp_is_leak_suspect(&prof.sites[1]);
+
+  // 同じ位置に来る割り当て(16KB毎のポインタはほとんど同じ位置になる)を外しても、残りが見つかる
+  hp_init(&prof);
+  for (uint32_t i = 0; i < 300; i++) {
+    alloc(&prof, 0x3fc00000 + (i % 100) * 0x4000 + (i / 100) * 8, 4, site_a, 0);
+  }
+  for (uint32_t i = 0; i < 300; i += 3) {
+    hp_free(&prof, 0x3fc00000 + (i % 100) * 0x4000 + (i / 100) * 8);
+  }
+  failed += prof.num_live != 200 || prof.unknown_frees != 0;
+  for (uint32_t i = 0; i < 300; i++) {
+    if (i % 3 != 0) {
+      hp_free(&prof, 0x3fc00000 + (i % 100) * 0x4000 + (i / 100) * 8);
+    }
+  }
+  failed += prof.num_live != 0 || prof.unknown_frees != 0 || prof.sites[0].live_bytes != 0 || prof.live_bytes[0] != 0;
+
+  // 表が溢れたら数えるだけ(解放は知らないポインタになる)
+  hp_init(&prof);
+  for (uint32_t i = 0; i < HP_MAX_LIVE; i++) {
+    alloc(&prof, 0x3fc00000 + i * 32, 8, site_a, 0);
+  }
+  failed += prof.num_live != HP_MAX_LIVE * 3 / 4 || prof.live_overflow != HP_MAX_LIVE / 4;
+  hp_free(&prof, 0x3fc00000 + (HP_MAX_LIVE - 1) * 32);
+  failed += prof.unknown_frees != 1 || prof.sites[0].allocs != HP_MAX_LIVE;
+
+  // 呼び出し元が溢れたら最後の1つにまとめる
+  hp_init(&prof);
+  for (uint32_t i = 0; i < HP_MAX_SITES + 10; i++) {
+    uint32_t pc[HP_DEPTH] = {0x42000000 + i * 4, 0x42100000};
+    alloc(&prof, 0x3fc00000 + i * 32, 8, pc, 0);
+  }
+  failed += prof.num_sites != HP_MAX_SITES || prof.site_overflow != 11;
+  failed += prof.sites[HP_MAX_SITES - 1].allocs != 11 || prof.sites[HP_MAX_SITES - 1].pc[0] != 0;
+
+  // 断片化の時系列
+  hp_init(&prof);
+  for (uint32_t i = 0; i < HP_SERIES + 6; i++) {
+    hp_sample_t s = {.time_ms = i * 1000, .total = 300000, .free = 200000 - i * 100, .largest = 100000 - i * 1000,
+      .min_free = 150000};
+    hp_sample(&prof, HP_REGION_INTERNAL, &s);
+  }
+  failed += hp_series_len(&prof, HP_REGION_INTERNAL) != HP_SERIES || hp_series_len(&prof, HP_REGION_PSRAM) != 0;
+  failed += hp_series_at(&prof, HP_REGION_INTERNAL, 0)->time_ms != 6000;
+  failed += hp_series_at(&prof, HP_REGION_INTERNAL, HP_SERIES - 1)->time_ms != (HP_SERIES + 5) * 1000;
+  failed += hp_series_at(&prof, HP_REGION_INTERNAL, 0)->frag_pm != 1000 - 94000ull * 1000 / 199400;
+  failed += hp_largest_min(&prof, HP_REGION_INTERNAL) != 100000 - (HP_SERIES + 5) * 1000;
+  failed += hp_frag_max(&prof, HP_REGION_INTERNAL) != hp_series_at(&prof, HP_REGION_INTERNAL, HP_SERIES - 1)->frag_pm;
+  hp_sample_t empty = {.time_ms = 1};
+  hp_sample(&prof, HP_REGION_PSRAM, &empty);
+  failed += hp_series_at(&prof, HP_REGION_PSRAM, 0)->frag_pm != 0;
+  // 離れた2つのヒープ(100000Bと20000B、どちらも1ブロック)は断片化していない
+  hp_sample_t two = {.time_ms = 2, .total = 130000, .free = 120000, .largest = 100000, .min_free = 120000,
+    .largest_sum = 120000};
+  hp_sample(&prof, HP_REGION_PSRAM, &two);
+  failed += hp_series_at(&prof, HP_REGION_PSRAM, 1)->frag_pm != 0;
+
+  // トレースの行を書いて読むと同じ集計
+  hp_init(&prof);
+  hp_init(&rx);
+  char line[128];
+  for (uint32_t i = 0; i < 40; i++) {
+    hp_event_t e = alloc_event(0x3fc90000 + i * 64, 10 + i, i % 3 ? site_a : site_b,
+      i % 5 == 0 ? HP_FLAG_HOT | HP_FLAG_PSRAM : 0);
+    e.time_ms = i;
+    hp_alloc(&prof, &e);
+    failed += hp_format_event(&e, line, sizeof(line)) == 0 || hp_parse_line(&rx, line) != 1;
+    if (i % 4 == 1) {
+      hp_event_t f = {.type = 'f', .time_ms = i, .ptr = e.ptr - 64};
+      hp_free(&prof, f.ptr);
+      failed += hp_format_event(&f, line, sizeof(line)) == 0 || hp_parse_line(&rx, line) != 1;
+    }
+  }
+  hp_sample_t s = {.time_ms = 40, .total = 300000, .free = 120000, .largest = 30000, .min_free = 90000};
+  hp_sample(&prof, HP_REGION_INTERNAL, &s);
+  failed += hp_format_sample(HP_REGION_INTERNAL, &s, line, sizeof(line)) == 0 || hp_parse_line(&rx, line) != 1;
+  failed += !same_totals(&prof, &rx) || rx.series[0][0].frag_pm != 750;
+  s.largest_sum = 60000;
+  failed += hp_format_sample(HP_REGION_INTERNAL, &s, line, sizeof(line)) == 0 || hp_parse_line(&rx, line) != 1;
+  failed += rx.series[0][1].largest_sum != 60000 || rx.series[0][1].frag_pm != 500;
+  failed += hp_format_event(&(hp_event_t){.type = 'f', .ptr = 1}, line, 8) != 0;
+
+  // 壊れた行、関係ない行
+  failed += hp_parse_line(&rx, "I (123) http: hello") != 0;
+  failed += hp_parse_line(&rx, "HP") != 0;
+  failed += hp_parse_line(&rx, "HP x 1 2") != -1;
+  failed += hp_parse_line(&rx, "HP a 1 3fc90000 10") != -1;
+  failed += hp_parse_line(&rx, "HP f 1") != -1;
+  failed += hp_parse_line(&rx, "HP s 1 2 100 50 10 5") != -1;   // 領域は0と1だけ
+  failed += hp_parse_line(&rx, "HP f 1 0x3fc99990") != 1;       // 0xも読める
+  failed += rx.unknown_frees != prof.unknown_frees + 1;
+
+  // レポート
+  size_t len = hp_report(&prof, text, sizeof(text));
+  failed += len == 0 || len != strlen(text);
+  failed += strstr(text, "heap: allocs 40 frees 10 unknown-frees 0") == NULL;
+  failed += strstr(text, "hot path: 8 allocs (8 in psram)\n") == NULL;
+  failed += strstr(text, "internal: live ") == NULL || strstr(text, "frag 75.0% (max 75.0%") == NULL;
+  failed += strstr(text, "psram: live ") == NULL || strstr(text, "no samples\n") == NULL;
+  failed += strstr(text, "pc 0x42001000,0x42002000,0x42003000") == NULL || strstr(text, "LEAK?") == NULL;
+  failed += strstr(text, "hot path sites:\n") == NULL;
+  failed += hp_report(&prof, text, 100) != 0;
+  return failed;
+}
+
+static hp_t hp;
+static char report[8192];
+
+static int replay(const char *path){
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  char line[256];
+  int events = 0, bad = 0, lineno = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    line[strcspn(line, "\r\n")] = '\0';
+    int ret = hp_parse_line(&hp, line);
+    if (ret < 0) {
+      printf("%s:%d: bad line: %s\n", path, lineno, line);
+      bad++;
+    }
+    events += ret > 0;
+  }
+  fclose(f);
+  printf("%s: %d events, %d bad lines\n", path, events, bad);
+  return bad;
+}
+
+static bool has_pc(const hp_site_t *site, uint32_t pc){
+  for (int i = 0; i < HP_DEPTH; i++) {
+    if (site->pc[i] == pc) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool find_region(const char *name, const char *suffix, hp_region_t *region){
+  static const char *const names[HP_REGION_NUM] = {"internal", "psram"};
+  for (int r = 0; r < HP_REGION_NUM; r++) {
+    size_t len = strlen(names[r]);
+    if (strncmp(name, names[r], len) == 0 && name[len] == '_' && strcmp(name + len + 1, suffix) == 0) {
+      *region = (hp_region_t)r;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool metric_value(const char *name, long long *v){
+  hp_region_t r;
+  if (strcmp(name, "allocs") == 0) {
+    *v = hp.allocs;
+  } else if (strcmp(name, "frees") == 0) {
+    *v = hp.frees;
+  } else if (strcmp(name, "unknown_frees") == 0) {
+    *v = hp.unknown_frees;
+  } else if (strcmp(name, "untracked") == 0) {
+    *v = hp.live_overflow;
+  } else if (strcmp(name, "sites") == 0) {
+    *v = hp.num_sites;
+  } else if (strcmp(name, "hot_allocs") == 0) {
+    *v = hp.hot_allocs;
+  } else if (strcmp(name, "hot_psram_allocs") == 0) {
+    *v = hp.hot_psram_allocs;
+  } else if (strcmp(name, "leak_sites") == 0) {
+    *v = 0;
+    for (int i = 0; i < hp.num_sites; i++) {
+      *v += hp_is_leak_suspect(&hp.sites[i]);
+    }
+  } else if (find_region(name, "live", &r)) {
+    *v = hp.live_bytes[r];
+  } else if (find_region(name, "peak", &r)) {
+    *v = hp.peak_live_bytes[r];
+  } else if (find_region(name, "samples", &r)) {
+    *v = hp_series_len(&hp, r);
+  } else if (find_region(name, "frag_max_pm", &r)) {
+    *v = hp_frag_max(&hp, r);
+  } else if (find_region(name, "largest_min", &r)) {
+    *v = hp_largest_min(&hp, r);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool compare(long long a, const char *op, long long b){
+  if (strcmp(op, "==") == 0) return a == b;
+  if (strcmp(op, "!=") == 0) return a != b;
+  if (strcmp(op, "<") == 0) return a < b;
+  if (strcmp(op, "<=") == 0) return a <= b;
+  if (strcmp(op, ">") == 0) return a > b;
+  if (strcmp(op, ">=") == 0) return a >= b;
+  return false;
+}
+
+// 条件を満たさなかった(読めなかった)行の数を返す
+static int check_expect(const char *path){
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return 1;
+  }
+  char line[256];
+  int failed = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    line[strcspn(line, "#\r\n")] = '\0';
+    char name[64], op[4];
+    long long expected, actual;
+    unsigned long pc;
+    bool ok;
+    if (sscanf(line, " %63s", name) != 1) {
+      continue;
+    }
+    if ((strcmp(name, "leak") == 0 || strcmp(name, "hot") == 0) && sscanf(line, " %*s %lx", &pc) == 1) {
+      ok = false;
+      for (int i = 0; i < hp.num_sites; i++) {
+        const hp_site_t *site = &hp.sites[i];
+        if (has_pc(site, (uint32_t)pc)
+          && (name[0] == 'l' ? hp_is_leak_suspect(site) : site->hot_allocs > 0)) {
+          ok = true;
+        }
+      }
+      printf("%s %s 0x%lx\n", ok ? "ok  " : "FAIL", name, pc);
+    } else if (sscanf(line, " %63s %3s %lld", name, op, &expected) == 3 && metric_value(name, &actual)) {
+      ok = compare(actual, op, expected);
+      printf("%s %s %s %lld (actual %lld)\n", ok ? "ok  " : "FAIL", name, op, expected, actual);
+    } else {
+      printf("FAIL cannot read: %s\n", line);
+      ok = false;
+    }
+    failed += !ok;
+  }
+  fclose(f);
+  return failed;
+}
+
+int main(int argc, char **argv){
+  const char *trace = NULL, *expect = NULL;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--trace") == 0) {
+      trace = argv[i + 1];
+    } else if (strcmp(argv[i], "--expect") == 0) {
+      expect = argv[i + 1];
+    }
+  }
+
+  int failed = check_cases();
+  printf("heap profiler: %d cases failed\n", failed);
+  hp_bench_result_t bench;
+  hp_bench_events(100000, clock_ns, &bench);
+  printf("per event: alloc %u ns, free %u ns\n", bench.alloc, bench.free);
+  if (failed != 0 || trace == NULL) {
+    return failed != 0;
+  }
+
+  hp_init(&hp);
+  if (replay(trace) != 0) {
+    return 1;
+  }
+  if (hp_report(&hp, report, sizeof(report)) == 0) {
+    printf("report truncated\n");
+    return 1;
+  }
+  fputs(report, stdout);
+  return expect != NULL && check_expect(expect) != 0;
+}
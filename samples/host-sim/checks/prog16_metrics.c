@@ -0,0 +1,309 @@
+// prog16のメトリクスのページ(metrics_page.c)をホストで確認する
+// 決まったスナップショットのテキストに期待する行がある、全部の行がPrometheusの書式、
+// CPU使用率は2回目から前回との差で出る、ヒストグラムのバケツが累積、バッファが足りなければ0、
+// バイナリをtm_decodeで読むと同じ値、送っている途中のバッファには書かない、を確かめる
+// 確認の後、テキストとバイナリのレンダリングにかかる時間を表示する
+//
+//   check_prog16_metrics [--serve port] [--duration s]
+// --serveがあれば、実機と同じ2つのバッファでGET /metrics、/metrics.binに答えるサーバーになる(port 0なら空いているポート)
+// スナップショットは100ms毎に進め、ページはmetrics_ms(1000ms)毎に書き直す
+// 負荷をかけるのはesp32-freertos-prog16-http-get/server/metrics_load.py
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "metrics_page.h"
+#include "metrics_bench.h"
+#include "telemetry_bench.h"
+
+#define TEXT_SIZE   8192
+#define BINARY_SIZE 2048
+#define RENDER_MS   1000
+
+static uint32_t clock_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+// 行がPrometheusのテキスト形式か(コメント、または 名前{ラベル} 値)
+static bool valid_line(const char *line, size_t len){
+  if (len == 0 || line[0] == '#') {
+    return true;
+  }
+  size_t i = 0;
+  if (!(isalpha((unsigned char)line[0]) || line[0] == '_')) {
+    return false;
+  }
+  while (i < len && (isalnum((unsigned char)line[i]) || line[i] == '_' || line[i] == ':')) {
+    i++;
+  }
+  if (i < len && line[i] == '{') {
+    const char *close = memchr(line + i, '}', len - i);
+    if (close == NULL) {
+      return false;
+    }
+    i = (size_t)(close - line) + 1;
+  }
+  if (i >= len || line[i] != ' ') {
+    return false;
+  }
+  i++;
+  if (i >= len) {
+    return false;
+  }
+  for (; i < len; i++) {
+    if (!(isdigit((unsigned char)line[i]) || line[i] == '.' || line[i] == '-' || line[i] == 'e')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool all_valid(const char *text){
+  while (*text) {
+    const char *eol = strchr(text, '\n');
+    if (eol == NULL) {
+      return false;
+    }
+    if (!valid_line(text, (size_t)(eol - text))) {
+      printf("invalid line: %.*s\n", (int)(eol - text), text);
+      return false;
+    }
+    text = eol + 1;
+  }
+  return true;
+}
+
+static int check_cases(void){
+  static char text[4096];
+  static uint8_t bin[1024];
+  static tm_t tm, rx;
+  mp_snapshot_t snap;
+  mp_cpu_t cpu = {0};
+  int failed = 0;
+
+  static const int32_t bounds[] = {10, 100};
+  tm_init(&tm, 10);
+  int isr = tm_register(&tm, "isr_count", TM_COUNTER, 0, NULL, 0);
+  int temp = tm_register(&tm, "temp_celsius", TM_GAUGE, -2, NULL, 0);
+  int lat = tm_register(&tm, "latency_ms", TM_HISTOGRAM, 0, bounds, 2);
+  tm_count(&tm, isr, 42);
+  tm_set(&tm, temp, -1234);
+  tm_observe(&tm, lat, 5);
+  tm_observe(&tm, lat, 50);
+  tm_observe(&tm, lat, 500);
+
+  // 1回目は前回がないのでCPU使用率は出さない
+  mp_bench_snapshot(&snap, 1);
+  size_t len = mp_render_text(&snap, &cpu, &tm, "esp32_", text, sizeof(text));
+  failed += len == 0 || len != strlen(text) || !all_valid(text);
+  failed += strstr(text, "esp32_heap_free_bytes 199999\n") == NULL;
+  failed += strstr(text, "esp32_queue_waiting{queue=\"events\",length=\"8\"} 1\n") == NULL;
+  failed += strstr(text, "esp32_task_runtime_seconds_total{task=\"http_get_task\",core=\"any\"} 0.300000\n") == NULL;
+  failed += strstr(text, "esp32_task_cpu_ratio{") != NULL;
+  failed += strstr(text, "esp32_isr_count_total 42\n") == NULL;
+  failed += strstr(text, "esp32_temp_celsius -12.34\n") == NULL;
+  failed += strstr(text, "esp32_latency_ms_bucket{le=\"10\"} 1\n") == NULL;
+  failed += strstr(text, "esp32_latency_ms_bucket{le=\"100\"} 2\n") == NULL;
+  failed += strstr(text, "esp32_latency_ms_bucket{le=\"+Inf\"} 3\n") == NULL;
+  failed += strstr(text, "esp32_latency_ms_sum 555\nesp32_latency_ms_count 3\n") == NULL;
+
+  // 2回目は前回との差(IDLE1は1コアの90%、http_get_taskは30%)
+  mp_bench_snapshot(&snap, 3);
+  len = mp_render_text(&snap, &cpu, &tm, "esp32_", text, sizeof(text));
+  failed += len == 0 || !all_valid(text);
+  failed += strstr(text, "esp32_task_cpu_ratio{task=\"IDLE1\",core=\"1\"} 0.900\n") == NULL;
+  failed += strstr(text, "esp32_task_cpu_ratio{task=\"http_get_task\",core=\"any\"} 0.300\n") == NULL;
+  failed += strstr(text, "esp32_task_cpu_ratio{task=\"ipc0\",core=\"0\"} 0.000\n") == NULL;
+
+  // 足りなければ0
+  failed += mp_render_text(&snap, &cpu, &tm, "esp32_", text, 200) != 0;
+
+  // バイナリは説明とスナップショット。読むと同じ値で、UDPの差分は進めない
+  uint16_t seq = tm.seq;
+  len = mp_render_binary(&tm, 1000, bin, sizeof(bin));
+  failed += len == 0 || tm.seq != seq || tm.metrics[isr].sent_value != 0;
+  tm_init(&rx, 10);
+  tm_register(&rx, "isr_count", TM_COUNTER, 0, NULL, 0);
+  tm_register(&rx, "temp_celsius", TM_GAUGE, -2, NULL, 0);
+  tm_register(&rx, "latency_ms", TM_HISTOGRAM, 0, bounds, 2);
+  for (size_t pos = 0; pos + 2 <= len; ) {
+    size_t n = bin[pos] | (size_t)bin[pos + 1] << 8;
+    failed += tm_decode(&rx, bin + pos + 2, n) < 0;
+    pos += 2 + n;
+  }
+  failed += !tm_equal(&tm, &rx);
+  failed += mp_render_binary(&tm, 1000, bin, 20) != 0;
+
+  // 公開: 送っている途中のバッファには書かない
+  static uint8_t b0[16], b1[16];
+  mp_pub_t pub;
+  const uint8_t *p;
+  size_t n;
+  mp_pub_init(&pub, b0, b1, sizeof(b0));
+  failed += mp_pub_acquire(&pub, &p, &n) != -1;
+  failed += mp_pub_begin(&pub) != b0;
+  mp_pub_commit(&pub, 3);
+  int r0 = mp_pub_acquire(&pub, &p, &n);
+  failed += r0 != 0 || p != b0 || n != 3;
+  failed += mp_pub_begin(&pub) != b1;
+  mp_pub_commit(&pub, 5);
+  failed += mp_pub_begin(&pub) != NULL || pub.busy != 1;      // b0はまだ送っている
+  int r1 = mp_pub_acquire(&pub, &p, &n);
+  failed += r1 != 1 || p != b1 || n != 5;
+  mp_pub_release(&pub, r0);
+  failed += mp_pub_begin(&pub) != b0;
+  mp_pub_commit(&pub, 0);                                      // 0なら切り替えない
+  failed += pub.current != 1 || pub.published != 2;
+  mp_pub_release(&pub, r1);
+  return failed;
+}
+
+static uint8_t text_buf[2][TEXT_SIZE];
+static uint8_t binary_buf[2][BINARY_SIZE];
+static mp_pub_t text_pub, binary_pub;
+static tm_t tm;
+static volatile int running = 1;
+
+// 実機のmetricsタスクの代わり
+static void *render_thread(void *arg){
+  static mp_snapshot_t snap;
+  mp_cpu_t cpu = {0};
+  uint32_t seed = 5;
+  for (uint32_t step = 1; running; step++) {
+    tm_bench_update(&tm, &seed);
+    mp_bench_snapshot(&snap, step);
+    uint8_t *buf = mp_pub_begin(&text_pub);
+    if (buf != NULL) {
+      mp_pub_commit(&text_pub, mp_render_text(&snap, &cpu, &tm, "esp32_", (char *)buf, TEXT_SIZE));
+    }
+    buf = mp_pub_begin(&binary_pub);
+    if (buf != NULL) {
+      mp_pub_commit(&binary_pub, mp_render_binary(&tm, step * RENDER_MS, buf, BINARY_SIZE));
+    }
+    usleep(RENDER_MS * 1000);
+  }
+  return NULL;
+}
+
+static void send_all(int fd, const void *buf, size_t len){
+  const uint8_t *p = buf;
+  while (len > 0) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+}
+
+static void handle(int fd){
+  char req[1024];
+  size_t len = 0;
+  // ヘッダの終わりまで読む(本文は使わない)
+  while (len < sizeof(req) - 1) {
+    ssize_t n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+    if (n <= 0) {
+      return;
+    }
+    len += (size_t)n;
+    req[len] = '\0';
+    if (strstr(req, "\r\n\r\n") != NULL) {
+      break;
+    }
+  }
+  mp_pub_t *pub = NULL;
+  const char *type = NULL;
+  if (strncmp(req, "GET /metrics.bin ", 17) == 0) {
+    pub = &binary_pub;
+    type = "application/octet-stream";
+  } else if (strncmp(req, "GET /metrics ", 13) == 0) {
+    pub = &text_pub;
+    type = "text/plain; version=0.0.4";
+  }
+  char header[256];
+  const uint8_t *body;
+  size_t body_len;
+  int index = pub != NULL ? mp_pub_acquire(pub, &body, &body_len) : -1;
+  if (index < 0) {
+    const char *msg = pub != NULL ? "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+      : "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    send_all(fd, msg, strlen(msg));
+    return;
+  }
+  int n = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+    "Connection: close\r\n\r\n", type, body_len);
+  send_all(fd, header, (size_t)n);
+  send_all(fd, body, body_len);
+  mp_pub_release(pub, index);
+}
+
+static int serve(int port, int duration){
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons((uint16_t)port),
+    .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  socklen_t addr_len = sizeof(addr);
+  if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(sock, 16) != 0
+    || getsockname(sock, (struct sockaddr *)&addr, &addr_len) != 0) {
+    perror("listen");
+    return 1;
+  }
+  tm_bench_setup(&tm, 10);
+  mp_pub_init(&text_pub, text_buf[0], text_buf[1], TEXT_SIZE);
+  mp_pub_init(&binary_pub, binary_buf[0], binary_buf[1], BINARY_SIZE);
+  pthread_t thread;
+  pthread_create(&thread, NULL, render_thread, NULL);
+
+  printf("listening on port %d\n", ntohs(addr.sin_port));
+  fflush(stdout);
+  struct timeval tv = {.tv_sec = 1};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  time_t end = duration > 0 ? time(NULL) + duration : 0;
+  uint32_t requests = 0;
+  while (end == 0 || time(NULL) < end) {
+    int fd = accept(sock, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    handle(fd);
+    close(fd);
+    requests++;
+  }
+  running = 0;
+  pthread_join(thread, NULL);
+  close(sock);
+  printf("served %u requests, %u pages published, %u renders skipped (busy)\n",
+    requests, text_pub.published, text_pub.busy + binary_pub.busy);
+  return 0;
+}
+
+int main(int argc, char **argv){
+  int port = -1, duration = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--serve") == 0) {
+      port = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--duration") == 0) {
+      duration = atoi(argv[i + 1]);
+    }
+  }
+
+  int failed = check_cases();
+  printf("metrics page: %d cases failed\n", failed);
+  mp_bench_result_t bench;
+  mp_bench_render(1000, clock_ns, &bench);
+  printf("render: text %u ns (%u bytes), binary %u ns (%u bytes)\n",
+    bench.render_text, bench.text_bytes, bench.render_binary, bench.binary_bytes);
+  if (failed != 0) {
+    return 1;
+  }
+  return port >= 0 ? serve(port, duration) : 0;
+}
@@ -0,0 +1,276 @@
+// prog16のテレメトリ(telemetry.c)をホストで確認する
+// 登録の制限、最初がTM_FRAME_KEY、変わった分だけのフレーム、デコードした値が送った側と同じ、
+// 取りこぼした後はTM_FRAME_KEYまで読み飛ばす、小さなバッファでは次に回して最後に揃う、説明のフレームを分けて書ける、を確かめる
+// 確認の後、ベンチマークの表を127.0.0.1のUDPで自分に送り、受け取ったフレームをデコードして送った値と比べる
+// 途中のTM_FRAME_DATAをわざと落として、次のTM_FRAME_KEYで揃い直すところも通す
+//
+//   check_prog16_telemetry [--frames path] [--count n]
+// --framesがあれば、受け取ったフレームを長さ(u16 LE)+フレームでpathに、最後の値をpath.txtに書く
+// (server/telemetry_collector.py replay path --expect path.txt で同じ値になるかを見る)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "telemetry.h"
+#include "telemetry_bench.h"
+
+#define DROP_EVERY 37
+
+static uint32_t clock_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+static const int32_t latency_bounds[] = {10, 50, 100, 500};
+
+static void setup_small(tm_t *tm){
+  tm_init(tm, 4);
+  tm_register(tm, "requests", TM_COUNTER, 0, NULL, 0);
+  tm_register(tm, "temp", TM_GAUGE, -1, NULL, 0);
+  tm_register(tm, "latency_ms", TM_HISTOGRAM, 0, latency_bounds, 4);
+}
+
+// encodeしてdecodeに渡す。deliverがfalseなら取りこぼしたことにする
+static int send_frame(tm_t *tx, tm_t *rx, uint8_t *buf, size_t size, bool deliver, size_t *len){
+  *len = tm_encode(tx, 0, buf, size, NULL);
+  return deliver ? tm_decode(rx, buf, *len) : 0;
+}
+
+static int check_cases(void){
+  tm_t tx, rx;
+  uint8_t buf[256];
+  size_t len;
+  bool key;
+  int failed = 0;
+
+  setup_small(&tx);
+  setup_small(&rx);
+  failed += tm_register(&tx, "no_bounds", TM_HISTOGRAM, 0, NULL, 0) != -1;
+  failed += tm_register(&tx, "gauge_bounds", TM_GAUGE, 0, latency_bounds, 4) != -1;
+  failed += tm_register(&tx, "a_name_that_is_longer_than_31_chars", TM_COUNTER, 0, NULL, 0) != -1;
+
+  // 最初は今の値を全部書く
+  tm_count(&tx, 0, 3);
+  tm_set(&tx, 1, 215);
+  tm_observe(&tx, 2, 7);
+  tm_observe(&tx, 2, 70);
+  tm_observe(&tx, 2, 700);
+  len = tm_encode(&tx, 1000, buf, sizeof(buf), &key);
+  failed += !key || buf[0] != 'T' || buf[1] != 'M' || buf[2] != (TM_VERSION << 4 | TM_FRAME_KEY);
+  failed += tm_decode(&rx, buf, len) != 3 || !tm_equal(&tx, &rx);
+  failed += rx.metrics[2].buckets[0] != 1 || rx.metrics[2].buckets[2] != 1 || rx.metrics[2].buckets[4] != 1;
+  failed += rx.metrics[2].sum != 777;
+
+  // 変わらなければレコードのないフレーム(ヘッダだけ)
+  failed += send_frame(&tx, &rx, buf, sizeof(buf), true, &len) != 0 || len > TM_HEADER_MAX;
+
+  // 変わった分だけ。ゲージは負の差も書ける
+  tm_count(&tx, 0, 5);
+  tm_set(&tx, 1, -40);
+  failed += send_frame(&tx, &rx, buf, sizeof(buf), true, &len) != 2 || !tm_equal(&tx, &rx);
+  // カウンタ1つ(id 1byte + 差分1byte)とヘッダだけ
+  tm_count(&tx, 0, 1);
+  failed += send_frame(&tx, &rx, buf, sizeof(buf), true, &len) != 1 || len != 6 + 2;
+
+  // 取りこぼしたら、TM_FRAME_KEYまでは適用しない(key_interval = 4なので、ここで捨てるのはTM_FRAME_KEY)
+  tm_observe(&tx, 2, 20);
+  send_frame(&tx, &rx, buf, sizeof(buf), false, &len);
+  tm_count(&tx, 0, 2);
+  failed += send_frame(&tx, &rx, buf, sizeof(buf), true, &len) != 0 || rx.lost != 1 || rx.synced;
+  failed += tm_equal(&tx, &rx);
+  int skipped = 0;
+  do {
+    tm_count(&tx, 0, 1);
+    len = tm_encode(&tx, 0, buf, sizeof(buf), &key);
+    skipped += tm_decode(&rx, buf, len) == 0;
+  } while (!key);
+  failed += skipped != 2 || !rx.synced || !tm_equal(&tx, &rx);
+
+  // 小さなバッファ: 入らない分は次に回し、何回か送れば揃う
+  tm_count(&tx, 0, 1000);
+  tm_set(&tx, 1, 123456);
+  for (int i = 0; i < 20; i++) {
+    tm_observe(&tx, 2, i * 40);
+  }
+  uint32_t deferred = tx.stats.deferred;
+  for (int i = 0; i < 4; i++) {
+    len = tm_encode(&tx, 0, buf, TM_HEADER_MAX + 12, NULL);
+    failed += tm_decode(&rx, buf, len) < 0;
+  }
+  failed += tx.stats.deferred == deferred || !tm_equal(&tx, &rx);
+
+  // 書ききれないTM_FRAME_KEYはTM_FRAME_KEY_PARTになる。同期していない受信側は使わず、次のTM_FRAME_KEYで揃う
+  tm_t late_tx, late_rx;
+  setup_small(&late_tx);
+  setup_small(&late_rx);
+  tm_count(&late_tx, 0, 1000);
+  tm_set(&late_tx, 1, 123456);
+  tm_observe(&late_tx, 2, 70);
+  len = tm_encode(&late_tx, 0, buf, TM_HEADER_MAX + 6, &key);
+  failed += key || buf[2] != (TM_VERSION << 4 | TM_FRAME_KEY_PART) || late_tx.stats.partial_keys != 1;
+  failed += tm_decode(&late_rx, buf, len) != 0 || late_rx.synced;
+  len = tm_encode(&late_tx, 0, buf, sizeof(buf), &key);
+  failed += !key || buf[2] != (TM_VERSION << 4 | TM_FRAME_KEY) || late_tx.stats.key_frames != 1;
+  failed += tm_decode(&late_rx, buf, len) != 3 || !late_rx.synced || !tm_equal(&late_tx, &late_rx);
+
+  // 同期している受信側には今の値として使える(書かなかったメトリクスの差分は次に回る)
+  tm_count(&late_tx, 0, 5);
+  tm_set(&late_tx, 1, -123456);
+  tm_observe(&late_tx, 2, 700);
+  late_tx.since_key = late_tx.key_interval;
+  len = tm_encode(&late_tx, 0, buf, TM_HEADER_MAX + 6, &key);
+  failed += key || buf[2] != (TM_VERSION << 4 | TM_FRAME_KEY_PART) || tm_decode(&late_rx, buf, len) < 1;
+  len = tm_encode(&late_tx, 0, buf, sizeof(buf), &key);
+  failed += !key || tm_decode(&late_rx, buf, len) != 3 || !tm_equal(&late_tx, &late_rx);
+
+  // 説明は分けて書ける
+  int next = 0, frames = 0;
+  while (next < tx.num && frames < 10) {
+    len = tm_encode_desc(&tx, 0, next, buf, 32, &next);
+    failed += len == 0 || buf[2] != (TM_VERSION << 4 | TM_FRAME_DESC) || tm_decode(&rx, buf, len) != 0;
+    frames++;
+  }
+  failed += next != tx.num || frames < 2;
+
+  // 壊れたフレーム
+  uint8_t bad[] = {'T', 'M', TM_VERSION << 4 | TM_FRAME_KEY, 0, 0, 0, 9};
+  failed += tm_decode(&rx, bad, 2) != -1 || tm_decode(&rx, bad, sizeof(bad)) != -1;
+  return failed;
+}
+
+// 受け取る側: ソケットから読んでデコードし、--framesのファイルに書く
+typedef struct {
+  int sock;
+  tm_t rx;
+  FILE *frames;
+  uint32_t received;
+  uint32_t bytes;
+} receiver_t;
+
+static int receive_one(receiver_t *r){
+  uint8_t buf[2048];
+  ssize_t n = recv(r->sock, buf, sizeof(buf), 0);
+  if (n < 0) {
+    perror("recv");
+    return -1;
+  }
+  r->received++;
+  r->bytes += (uint32_t)n;
+  if (r->frames != NULL) {
+    uint8_t len[2] = {(uint8_t)n, (uint8_t)(n >> 8)};
+    fwrite(len, 1, 2, r->frames);
+    fwrite(buf, 1, (size_t)n, r->frames);
+  }
+  return tm_decode(&r->rx, buf, (size_t)n) < 0 ? -1 : 0;
+}
+
+static void write_values(const tm_t *tm, const char *path){
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    perror(path);
+    return;
+  }
+  for (int i = 0; i < tm->num; i++) {
+    const tm_metric_t *m = &tm->metrics[i];
+    if (m->type == TM_COUNTER) {
+      fprintf(f, "%s=%u\n", m->name, m->value);
+    } else if (m->type == TM_GAUGE) {
+      fprintf(f, "%s=%d\n", m->name, (int32_t)m->value);
+    } else {
+      fprintf(f, "%s=", m->name);
+      for (int b = 0; b <= m->num_bounds; b++) {
+        fprintf(f, "%s%u", b ? "," : "", m->buckets[b]);
+      }
+      fprintf(f, ",sum=%d\n", (int32_t)m->sum);
+    }
+  }
+  fclose(f);
+}
+
+int main(int argc, char **argv){
+  const char *frames_path = NULL;
+  uint32_t count = 1000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--frames") == 0) {
+      frames_path = argv[i + 1];
+    } else if (strcmp(argv[i], "--count") == 0) {
+      count = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+    }
+  }
+
+  int failed = check_cases();
+  printf("telemetry: %d cases failed\n", failed);
+
+  tm_bench_result_t bench;
+  tm_bench_encode(count, clock_ns, &bench);
+  printf("encode per record: binary %u ns, %u.%02u bytes / text %u ns, %u.%02u bytes (%u frames, %u records)\n",
+    bench.encode_per_record, bench.bytes_per_record_x100 / 100, bench.bytes_per_record_x100 % 100,
+    bench.text_per_record, bench.text_bytes_per_record_x100 / 100, bench.text_bytes_per_record_x100 % 100,
+    bench.frames, bench.records);
+
+  // ループバック
+  receiver_t r = {0};
+  struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  socklen_t addr_len = sizeof(addr);
+  r.sock = socket(AF_INET, SOCK_DGRAM, 0);
+  int tx_sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (r.sock < 0 || tx_sock < 0 || bind(r.sock, (struct sockaddr *)&addr, sizeof(addr)) != 0
+    || getsockname(r.sock, (struct sockaddr *)&addr, &addr_len) != 0) {
+    perror("loopback socket");
+    return 1;
+  }
+  if (frames_path != NULL && (r.frames = fopen(frames_path, "wb")) == NULL) {
+    perror(frames_path);
+    return 1;
+  }
+
+  static tm_t tx;
+  static uint8_t buf[512];
+  uint32_t seed = 7, dropped = 0, sent = 0;
+  tm_bench_setup(&tx, 10);
+  tm_bench_setup(&r.rx, 10);
+  uint32_t start = clock_ns();
+  // 最後はTM_FRAME_KEYまで送って、落とした後でも揃っているところで比べる
+  bool key = false;
+  for (uint32_t f = 0; f < count || !key; f++) {
+    tm_bench_update(&tx, &seed);
+    size_t len = tm_encode(&tx, f * 100, buf, sizeof(buf), &key);
+    if (key) {
+      uint8_t desc[512];
+      int next = 0;
+      while (next < tx.num) {
+        size_t n = tm_encode_desc(&tx, f * 100, next, desc, sizeof(desc), &next);
+        sendto(tx_sock, desc, n, 0, (struct sockaddr *)&addr, sizeof(addr));
+        failed += receive_one(&r) != 0;
+      }
+    }
+    if (f % DROP_EVERY == DROP_EVERY - 1 && !key) {
+      dropped++;
+      continue;
+    }
+    sendto(tx_sock, buf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    sent++;
+    failed += receive_one(&r) != 0;
+  }
+  uint32_t elapsed = clock_ns() - start;
+  bool equal = tm_equal(&tx, &r.rx);
+  failed += !equal || r.rx.lost != dropped;
+  printf("loopback: %u frames sent, %u dropped, %u received, %u bytes, lost=%u, %s, %u ns/frame\n",
+    sent, dropped, r.received, r.bytes, r.rx.lost, equal ? "values match" : "VALUES DIFFER",
+    r.received ? elapsed / r.received : 0);
+
+  close(tx_sock);
+  close(r.sock);
+  if (r.frames != NULL) {
+    fclose(r.frames);
+    char path[512];
+    snprintf(path, sizeof(path), "%s.txt", frames_path);
+    write_values(&tx, path);
+  }
+  return failed != 0;
+}
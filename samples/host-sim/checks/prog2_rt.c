@@ -0,0 +1,162 @@
+// prog2のCPU負荷の集計(rt_stats.c)をホストで確認する
+// 2コアの負荷を決めたサンプルを100ms毎に作って渡し、コア/タスクの負荷、2コアの合計、
+// 32bitの実行時間カウンタのラップアラウンド(実機はesp_timerのusなので約71分で一周する)、窓の切り替え、ダンプを確かめる
+#include <stdio.h>
+#include <string.h>
+#include "rt_stats.h"
+
+#define PERIOD_US (RT_STATS_SAMPLE_PERIOD_MS * 1000)
+
+// タスク毎の負荷[‰]を決めて、実行時間カウンタを進める
+typedef struct {
+  uint32_t task_number;
+  const char *name;
+  int8_t core;
+  int8_t idle_core;
+  int permille;
+  uint32_t run_time;
+} fake_task_t;
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+static void expect_load(int actual, int expected, int tolerance, const char *what){
+  int ok = actual >= expected - tolerance && actual <= expected + tolerance;
+  printf("%s %s: %d (expected %d)\n", ok ? "ok  " : "FAIL", what, actual, expected);
+  failed += !ok;
+}
+
+static uint32_t total;
+
+static void step(fake_task_t *tasks, int num_tasks, int count){
+  rt_stats_sample_t samples[RT_STATS_MAX_TASKS];
+  for (int n = 0; n < count; n++) {
+    total += PERIOD_US;
+    for (int i = 0; i < num_tasks; i++) {
+      tasks[i].run_time += (uint32_t)(PERIOD_US / 1000 * tasks[i].permille);
+      samples[i] = (rt_stats_sample_t){
+        .task_number = tasks[i].task_number,
+        .name = tasks[i].name,
+        .run_time = tasks[i].run_time,
+        .core = tasks[i].core,
+        .idle_core = tasks[i].idle_core,
+      };
+    }
+    rt_stats_update(total, samples, num_tasks);
+  }
+}
+
+static int slot_of(uint32_t task_number){
+  for (int i = 0; i < RT_STATS_MAX_TASKS; i++) {
+    const rt_stats_task_t *t = rt_stats_get_task(i);
+    if (t != NULL && t->task_number == task_number) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// コア0: task1 250‰、IDLE0 750‰ / コア1: task2 400‰、task3 200‰、IDLE1 400‰
+static fake_task_t two_cores[] = {
+  {1, "IDLE0", 0, 0, 750, 0},
+  {2, "IDLE1", 1, 1, 400, 0},
+  {3, "task1", 0, -1, 250, 0},
+  {4, "task2", 1, -1, 400, 0},
+  {5, "task3", 1, -1, 200, 0},
+};
+#define NUM_TWO_CORES ((int)(sizeof(two_cores) / sizeof(two_cores[0])))
+
+// wrap_at: 何サンプル目で全部のカウンタが一周するか(0なら0から始める)
+static void check_two_cores(int wrap_at){
+  rt_stats_init();
+  total = 0u - (uint32_t)wrap_at * PERIOD_US;
+  for (int i = 0; i < NUM_TWO_CORES; i++) {
+    two_cores[i].run_time = 0u - (uint32_t)wrap_at * (PERIOD_US / 1000 * two_cores[i].permille);
+  }
+  step(two_cores, NUM_TWO_CORES, 1);
+  expect(rt_stats_core_load(0, RT_STATS_WINDOW_1S) == -1, "no load from a single sample");
+  step(two_cores, NUM_TWO_CORES, 1);
+  expect_load(rt_stats_core_load(0, RT_STATS_WINDOW_10S), 250, 0, "partial window from two samples");
+
+  step(two_cores, NUM_TWO_CORES, RT_STATS_HISTORY + 10);
+  expect_load(rt_stats_core_load(0, RT_STATS_WINDOW_1S), 250, 0, "core0 1s");
+  expect_load(rt_stats_core_load(1, RT_STATS_WINDOW_1S), 600, 0, "core1 1s");
+  expect_load(rt_stats_core_load(1, RT_STATS_WINDOW_10S), 600, 0, "core1 10s");
+
+  // タスクの負荷は1コアに対する割合なので、アイドルを含めた全タスクの合計は2コア分(2000‰)
+  int sum = 0, core1_tasks = 0;
+  for (int i = 0; i < NUM_TWO_CORES; i++) {
+    int load = rt_stats_task_load(slot_of(two_cores[i].task_number), RT_STATS_WINDOW_10S);
+    expect_load(load, two_cores[i].permille, 0, two_cores[i].name);
+    sum += load;
+    if (two_cores[i].core == 1 && two_cores[i].idle_core < 0) {
+      core1_tasks += load;
+    }
+  }
+  expect_load(sum, 2000, 0, "all tasks add up to two cores");
+  expect_load(core1_tasks, rt_stats_core_load(1, RT_STATS_WINDOW_10S), 0, "core1 tasks add up to the core1 load");
+}
+
+static void check_windows(void){
+  rt_stats_init();
+  total = 0;
+  for (int i = 0; i < NUM_TWO_CORES; i++) {
+    two_cores[i].run_time = 0;
+  }
+  step(two_cores, NUM_TWO_CORES, RT_STATS_HISTORY);
+  // task2が止まってコア1のアイドルが増える(9秒間は元の負荷、1秒間はtask2なし)
+  two_cores[1].permille = 800;
+  two_cores[3].permille = 0;
+  step(two_cores, NUM_TWO_CORES, 1000 / RT_STATS_SAMPLE_PERIOD_MS);
+  expect_load(rt_stats_core_load(1, RT_STATS_WINDOW_1S), 200, 0, "1s window follows the change");
+  expect_load(rt_stats_core_load(1, RT_STATS_WINDOW_10S), 560, 0, "10s window blends 9s and 1s");
+
+  // task3が削除され、新しいtask4が入る
+  fake_task_t after[] = {two_cores[0], two_cores[1], two_cores[2], two_cores[3], {6, "task4", 1, -1, 300, 0}};
+  after[1].permille = 500;
+  step(after, 5, 1);
+  expect(slot_of(5) == -1, "deleted task is dropped");
+  expect(rt_stats_task_load(slot_of(6), RT_STATS_WINDOW_1S) == -1, "new task needs two samples");
+  step(after, 5, 5);
+  expect_load(rt_stats_task_load(slot_of(6), RT_STATS_WINDOW_1S), 300, 0, "new task uses its partial window");
+  two_cores[1].permille = 400;
+  two_cores[3].permille = 400;
+}
+
+static void check_dump(void){
+  rt_stats_init();
+  total = 0;
+  for (int i = 0; i < NUM_TWO_CORES; i++) {
+    two_cores[i].run_time = 0;
+  }
+  step(two_cores, NUM_TWO_CORES, 20);
+  uint8_t buf[256];
+  size_t len = rt_stats_dump(buf, sizeof(buf));
+  size_t names = 0;
+  for (int i = 0; i < NUM_TWO_CORES; i++) {
+    names += strlen(two_cores[i].name);
+  }
+  expect(len == 9 + RT_STATS_NUM_CORES * 4 + NUM_TWO_CORES * 8 + names, "dump size");
+  expect(buf[0] == 'R' && buf[1] == 'T' && buf[2] == 1 && buf[3] == RT_STATS_NUM_CORES && buf[4] == NUM_TWO_CORES,
+    "dump header");
+  expect(buf[5] == 20 && buf[6] == 0 && buf[7] == 0 && buf[8] == 0, "dump sample count");
+  expect((buf[9] | buf[10] << 8) == 250 && (buf[13] | buf[14] << 8) == 600, "dump core loads");
+  expect(rt_stats_dump(buf, len - 1) == 0, "dump fails when the buffer is short");
+}
+
+int main(void){
+  printf("-- counters from 0\n");
+  check_two_cores(0);
+  // 最後の1秒窓、10秒窓の途中でカウンタが一周する
+  printf("-- counters wrap around\n");
+  check_two_cores(RT_STATS_HISTORY + 7);
+  check_two_cores(60);
+  check_windows();
+  check_dump();
+  printf("rt_stats: %d cases failed\n", failed);
+  return failed != 0;
+}
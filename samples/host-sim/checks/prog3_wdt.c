@@ -0,0 +1,159 @@
+// prog3のタスクWDTのスーパーバイザ(wdt_supervisor.c)を仮想の時計で確認する
+// 実機と同じタイムアウト2000ms、警告75%で、ハートビートが止まったときの警告とタイムアウト、
+// アイドルタスクが動けないときの飢餓状態の診断(原因のタスク)を確かめる
+#include <stdio.h>
+#include <string.h>
+#include "wdt_supervisor.h"
+
+#define TIMEOUT_MS 2000
+
+static int64_t now_us;
+
+static int64_t fake_clock(void){
+  return now_us;
+}
+
+// コア1を優先度5の"hog"が占有している
+static void fake_snapshot(wdt_sup_stall_t *stall){
+  strcpy(stall->cores[0].task_name, "task3");
+  stall->cores[0].priority = 1;
+  strcpy(stall->cores[1].task_name, "hog");
+  stall->cores[1].priority = 5;
+  stall->cores[1].stack_high_water_mark = 512;
+}
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+static void expect_text(const wdt_sup_stall_t *stall, const char *text){
+  char line[128] = "";
+  if (stall != NULL) {
+    wdt_sup_format_stall(stall, line, sizeof(line));
+  }
+  int ok = strcmp(line, text) == 0;
+  printf("%s \"%s\"\n", ok ? "ok  " : "FAIL", line);
+  if (!ok) {
+    printf("     expected \"%s\"\n", text);
+  }
+  failed += !ok;
+}
+
+// 時計を進めながら、period_ms毎にfeedする
+static void run(int ms, int id, int period_ms){
+  for (int t = 0; t < ms; t++) {
+    now_us += 1000;
+    if (id >= 0 && period_ms > 0 && (t + 1) % period_ms == 0) {
+      wdt_sup_feed(id);
+    }
+  }
+}
+
+static void check_timeout(void){
+  now_us = 0;
+  wdt_sup_config_t config = {.timeout_ms = TIMEOUT_MS, .warn_percent = 75, .clock = fake_clock, .snapshot = NULL};
+  wdt_sup_init(&config);
+  int task = wdt_sup_register("task3", WDT_SUP_KIND_TASK, (void *)1);
+  int user = wdt_sup_register("func_a", WDT_SUP_KIND_USER, (void *)2);
+
+  run(5000, task, 10);
+  wdt_sup_feed(user);
+  expect(wdt_sup_check() == 0 && wdt_sup_stall_count() == 0, "no stall while feeding every 10 ms");
+  expect(wdt_sup_get_entry(task)->max_interval_us == 10000, "max interval is the feed period");
+
+  // task3が止まる(func_aは続ける)
+  now_us += 1499000;
+  wdt_sup_feed(user);
+  expect(wdt_sup_check() == 0, "no stall just before the warning threshold");
+  now_us += 1000;
+  expect(wdt_sup_check() == 1, "warning at 75% of the timeout");
+  expect_text(wdt_sup_get_stall(0), "warn: task3 not reset for 1500 ms");
+  expect(wdt_sup_check() == 0, "warning is recorded once");
+  now_us += 499000;
+  wdt_sup_feed(user);
+  expect(wdt_sup_check() == 0, "no timeout before the timeout");
+  now_us += 1000;
+  expect(wdt_sup_check() == 1 && wdt_sup_get_stall(0)->diag == WDT_SUP_DIAG_TIMEOUT, "timeout at 100%");
+  expect_text(wdt_sup_get_stall(0), "timeout: task3 not reset for 2000 ms");
+  now_us += 5000000;
+  wdt_sup_feed(user);
+  expect(wdt_sup_check() == 0, "timeout is recorded once");
+  expect(wdt_sup_get_entry(task)->stall_count == 2 && wdt_sup_get_entry(user)->stall_count == 0, "stall counts");
+
+  // 再開すれば次の間隔でまた診断する
+  wdt_sup_feed(task);
+  run(1500, user, 10);
+  expect(wdt_sup_check() == 1 && wdt_sup_get_stall(0)->entry_id == task, "warns again after the next stop");
+}
+
+static void check_starvation(void){
+  now_us = 0;
+  wdt_sup_config_t config = {.timeout_ms = TIMEOUT_MS, .warn_percent = 75, .clock = fake_clock, .snapshot = fake_snapshot};
+  wdt_sup_init(&config);
+  int task = wdt_sup_register("task3", WDT_SUP_KIND_TASK, (void *)1);
+  int idle0 = wdt_sup_register_idle(0);
+  int idle1 = wdt_sup_register_idle(1);
+  expect(idle0 >= 0 && idle1 >= 0 && strcmp(wdt_sup_get_entry(idle1)->name, "IDLE1") == 0, "idle tasks registered");
+
+  // コア0のアイドルとtask3は動くが、コア1のアイドルはhogに止められる
+  for (int t = 0; t < 1499; t++) {
+    now_us += 1000;
+    wdt_sup_feed(task);
+    wdt_sup_feed(idle0);
+  }
+  expect(wdt_sup_check() == 0, "no starvation before the warning threshold");
+  now_us += 1000;
+  wdt_sup_feed(task);
+  wdt_sup_feed(idle0);
+  expect(wdt_sup_check() == 1, "idle starvation is diagnosed");
+  const wdt_sup_stall_t *s = wdt_sup_get_stall(0);
+  expect(s->entry_id == idle1 && s->starved_core == 1 && s->diag == WDT_SUP_DIAG_WARN, "starved core is core1");
+  expect_text(s, "warn: IDLE1 not run for 1500 ms, core1 starved by hog (prio 5)");
+  expect(s->cores[1].stack_high_water_mark == 512, "snapshot of the running task");
+
+  now_us += 500000;
+  wdt_sup_feed(task);
+  wdt_sup_feed(idle0);
+  expect(wdt_sup_check() == 1, "idle timeout is diagnosed");
+  expect_text(wdt_sup_get_stall(0), "timeout: IDLE1 not run for 2000 ms, core1 starved by hog (prio 5)");
+  expect(wdt_sup_get_stall(1)->diag == WDT_SUP_DIAG_WARN, "stalls are newest first");
+
+  // スナップショットがなければ原因のタスクは書かない
+  wdt_sup_config_t no_snapshot = config;
+  no_snapshot.snapshot = NULL;
+  wdt_sup_init(&no_snapshot);
+  wdt_sup_register_idle(0);
+  now_us += 2000000;
+  expect(wdt_sup_check() == 1, "idle timeout without snapshot");
+  expect_text(wdt_sup_get_stall(0), "timeout: IDLE0 not run for 2000 ms, core0 starved");
+}
+
+static void check_ring(void){
+  now_us = 0;
+  wdt_sup_config_t config = {.timeout_ms = TIMEOUT_MS, .warn_percent = 0, .clock = fake_clock, .snapshot = NULL};
+  wdt_sup_init(&config);
+  int ids[WDT_SUP_MAX_ENTRIES];
+  for (int i = 0; i < WDT_SUP_MAX_ENTRIES; i++) {
+    char name[8];
+    snprintf(name, sizeof(name), "t%d", i);
+    ids[i] = wdt_sup_register(name, WDT_SUP_KIND_TASK, (void *)(long)(i + 1));
+  }
+  expect(wdt_sup_register("full", WDT_SUP_KIND_TASK, NULL) == -1, "register fails when full");
+  // warn_percent=0は75%になる
+  now_us = 1500000;
+  expect(wdt_sup_check() == WDT_SUP_MAX_ENTRIES, "all entries warn");
+  expect(wdt_sup_stall_count() == WDT_SUP_MAX_STALLS, "ring keeps the newest stalls");
+  expect(wdt_sup_get_stall(0)->entry_id == ids[WDT_SUP_MAX_ENTRIES - 1], "newest stall first");
+  expect(wdt_sup_get_stall(WDT_SUP_MAX_STALLS) == NULL, "no stall past the ring");
+}
+
+int main(void){
+  check_timeout();
+  check_starvation();
+  check_ring();
+  printf("wdt supervisor: %d cases failed\n", failed);
+  return failed != 0;
+}
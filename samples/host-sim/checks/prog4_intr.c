@@ -0,0 +1,106 @@
+// prog4の割込みのコアとレベルの割り当て(intr_alloc.c)をホストで確認する
+// 結果が分かっている割込み表を計画に通して、コア、エラー、負荷の上限を見る。最後に登録と動いたコアのマップを調べる
+// 最後にprog4のmain.cの割込み表と同じ値を計画する
+#include <stdio.h>
+#include "intr_alloc.h"
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+typedef struct {
+  const char *what;
+  ia_request_t requests[4];
+  int num;
+  ia_config_t config;
+  int8_t expect_core[4];
+  ia_status_t expect_status[4];
+  bool expect_overloaded;
+} plan_case_t;
+
+static const plan_case_t cases[] = {
+  {"largest load first, alternating cores",
+    {{"a", IA_CORE_ANY, 1, 40}, {"b", IA_CORE_ANY, 1, 30}, {"c", IA_CORE_ANY, 1, 20}, {"d", IA_CORE_ANY, 1, 10}}, 4,
+    {0, 0}, {0, 1, 1, 0}, {IA_OK, IA_OK, IA_OK, IA_OK}, false},
+  {"pinned load is counted first",
+    {{"pinned", 1, 2, 50}, {"a", IA_CORE_ANY, 1, 30}, {"b", IA_CORE_ANY, 1, 30}}, 3,
+    {0, 0}, {1, 0, 0}, {IA_OK, IA_OK, IA_OK}, false},
+  {"avoided core (Wi-Fi on core0)",
+    {{"a", IA_CORE_ANY, 1, 30}, {"b", IA_CORE_ANY, 3, 30}, {"wifi_side", 0, 1, 10}}, 3,
+    {1u << 0, 0}, {1, 1, IA_CORE_ANY}, {IA_OK, IA_OK, IA_ERR_AVOIDED}, false},
+  {"level and core out of range",
+    {{"nmi", IA_CORE_ANY, 4, 10}, {"core2", 2, 1, 10}}, 2,
+    {0, 0}, {IA_CORE_ANY, IA_CORE_ANY}, {IA_ERR_LEVEL, IA_ERR_CORE}, false},
+  {"both cores avoided",
+    {{"a", IA_CORE_ANY, 1, 10}}, 1,
+    {0x3, 0}, {IA_CORE_ANY}, {IA_ERR_NO_CORE}, false},
+  {"load over the capacity",
+    {{"heavy", 1, 1, 150}, {"light", IA_CORE_ANY, 1, 10}}, 2,
+    {0, 100}, {1, 0}, {IA_OK, IA_OK}, true},
+};
+
+static void check_plan(const plan_case_t *c){
+  ia_plan_t plans[4];
+  ia_summary_t summary;
+  if (ia_plan(c->requests, c->num, &c->config, plans, &summary) != 0) {
+    expect(0, c->what);
+    return;
+  }
+  int ok = 1, errors = 0;
+  for (int i = 0; i < c->num; i++) {
+    if (plans[i].core != c->expect_core[i] || plans[i].status != c->expect_status[i]) {
+      printf("  %s: core %d status %d (expected %d, %d)\n", c->requests[i].name, plans[i].core, plans[i].status,
+        c->expect_core[i], c->expect_status[i]);
+      ok = 0;
+    }
+    errors += plans[i].status != IA_OK;
+  }
+  expect(ok && summary.errors == errors && summary.overloaded == c->expect_overloaded, c->what);
+}
+
+static void check_map(void){
+  printf("-- map of registered and fired cores\n");
+  const ia_plan_t plans[4] = {{0, IA_OK}, {1, IA_OK}, {1, IA_OK}, {0, IA_OK}};
+  ia_map_t map;
+  ia_map_init(&map, plans, 4);
+  expect(ia_map_mismatches(&map) == 4, "not registered yet counts as a mismatch");
+  ia_map_registered(&map, 0, 0, 0);
+  ia_map_registered(&map, 1, 0, 0);      // 違うコアで登録した
+  ia_map_registered(&map, 2, 1, 0x101);  // 登録に失敗した
+  ia_map_registered(&map, 3, 0, 0);
+  ia_map_fired(&map, 0, 0);
+  ia_map_fired(&map, 3, 0);
+  ia_map_fired(&map, 3, 1);              // 違うコアで動いた
+  expect(ia_map_mismatches(&map) == 3, "wrong core, failed registration and moved interrupt");
+  expect(map.entries[3].count == 2 && map.entries[3].observed_core == 1, "fired count and observed core");
+  expect(!map.entries[0].moved, "interrupt on the planned core is not moved");
+}
+
+// prog4のmain.cの割込み表(GPIOのISRサービスはコア1固定、control_tickはコア指定なし。コア0は避ける)
+static void check_prog4_table(void){
+  printf("-- prog4 interrupt table\n");
+  const ia_request_t requests[] = {
+    {"gpio_isr_service", 1, 1, 5},
+    {"control_tick", IA_CORE_ANY, 0, 20},
+  };
+  const ia_config_t config = {.avoid_core_mask = 1u << 0, .capacity_permille = 300};
+  ia_plan_t plans[2];
+  ia_summary_t summary;
+  expect(ia_plan(requests, 2, &config, plans, &summary) == 0, "plan");
+  expect(plans[0].core == 1 && plans[1].core == 1, "both on core1");
+  expect(summary.errors == 0 && !summary.overloaded, "no errors, within the capacity");
+}
+
+int main(void){
+  printf("-- plans\n");
+  for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    check_plan(&cases[i]);
+  }
+  check_map();
+  check_prog4_table();
+  printf("intr alloc: %d cases failed\n", failed);
+  return failed != 0;
+}
@@ -0,0 +1,136 @@
+// prog4のタスクの計画(task_planner.c)をホストで確認する
+// WCETを入れたタスク表をレートモノトニックの優先度割り当て、コア割り当て、応答時間解析に通して、
+// 応答時間がわかっている表(スケジュール可能なもの、不可能なもの)と同じ結果になるかを見る
+// 最後にprog4のmain.cのタスク表と同じ値を解析する
+#include <stdio.h>
+#include <string.h>
+#include "task_planner.h"
+
+#define BASE_PRIORITY 1
+#define MAX_PRIORITY  15
+#define MS(x) ((x) * 1000u)
+
+static int failed;
+
+static void expect(int ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  failed += !ok;
+}
+
+static void print_plan(const plan_task_t *tasks, int n, const plan_result_t *results, const plan_summary_t *summary){
+  printf("  %-10s %8s %8s %8s %4s %4s %8s\n", "name", "T[us]", "D[us]", "C[us]", "prio", "core", "R[us]");
+  for (int i = 0; i < n; i++) {
+    const plan_task_t *t = &tasks[i];
+    const plan_result_t *r = &results[i];
+    printf("  %-10s %8u %8u %8u %4u %4d %8u%s\n", t->name, t->period_us, t->deadline_us ? t->deadline_us : t->period_us,
+      t->wcet_us, r->priority, r->core, r->response_us, r->schedulable ? "" : " MISS");
+  }
+  printf("  utilization core0=%u core1=%u [permille] %s\n", summary->utilization_permille[0],
+    summary->utilization_permille[1], summary->schedulable ? "schedulable" : "NOT schedulable");
+}
+
+static int plan(const plan_task_t *tasks, int n, plan_result_t *results, plan_summary_t *summary){
+  int ret = plan_tasks(tasks, n, BASE_PRIORITY, MAX_PRIORITY, results, summary);
+  if (ret == 0) {
+    print_plan(tasks, n, results, summary);
+  }
+  return ret;
+}
+
+// 1コアで利用率0.93(Liu & Laylandの上限0.78を超える)が、応答時間解析ではデッドラインを守れる
+// R1 = 3, R2 = 3 + 3 = 6, R3 = 5 + 3*3 + 2*3 = 20 (ms)
+static void check_schedulable(void){
+  printf("-- schedulable on one core\n");
+  const plan_task_t tasks[] = {
+    {"t3", NULL, NULL, 0, MS(20), 0, MS(5), 0},
+    {"t1", NULL, NULL, 0, MS(7), 0, MS(3), 0},
+    {"t2", NULL, NULL, 0, MS(12), 0, MS(3), 0},
+  };
+  plan_result_t r[3];
+  plan_summary_t s;
+  expect(plan(tasks, 3, r, &s) == 0, "plan");
+  expect(r[1].priority == MAX_PRIORITY && r[2].priority == MAX_PRIORITY - 1 && r[0].priority == MAX_PRIORITY - 2,
+    "rate monotonic priorities");
+  expect(r[1].response_us == MS(3) && r[2].response_us == MS(6) && r[0].response_us == MS(20), "response times 3, 6, 20 ms");
+  expect(s.schedulable && r[0].schedulable && r[1].schedulable && r[2].schedulable, "schedulable");
+  expect(s.utilization_permille[0] == 428 + 250 + 250 && s.utilization_permille[1] == 0, "utilization of core0");
+}
+
+// 1コアで利用率0.97、R2 = 4 + 2*2 = 8 > 7 でデッドラインを守れない
+static void check_unschedulable(void){
+  printf("-- not schedulable on one core\n");
+  const plan_task_t tasks[] = {
+    {"t1", NULL, NULL, 0, MS(5), 0, MS(2), 1},
+    {"t2", NULL, NULL, 0, MS(7), 0, MS(4), 1},
+  };
+  plan_result_t r[2];
+  plan_summary_t s;
+  expect(plan(tasks, 2, r, &s) == 0, "plan");
+  expect(r[0].schedulable && r[0].response_us == MS(2), "t1 meets its deadline");
+  expect(!r[1].schedulable && r[1].response_us == MS(8), "t2 misses with R = 8 ms");
+  expect(!s.schedulable, "not schedulable");
+
+  // 同じ表でもコアを指定しなければ2コアに分けてスケジュールできる
+  printf("-- same tasks on two cores\n");
+  plan_task_t any[2];
+  memcpy(any, tasks, sizeof(any));
+  any[0].affinity = PLAN_AFFINITY_ANY;
+  any[1].affinity = PLAN_AFFINITY_ANY;
+  expect(plan(any, 2, r, &s) == 0, "plan");
+  expect(r[0].core != r[1].core && s.schedulable, "split across the cores");
+  expect(r[0].response_us == MS(2) && r[1].response_us == MS(4), "no interference after the split");
+
+  // デッドラインを周期より短くすると、同じコアの高い優先度のタスクの分で守れない
+  printf("-- deadline shorter than the period\n");
+  const plan_task_t tight[] = {
+    {"t1", NULL, NULL, 0, MS(5), 0, MS(2), 0},
+    {"t2", NULL, NULL, 0, MS(10), MS(3), MS(2), 0},
+  };
+  expect(plan(tight, 2, r, &s) == 0, "plan");
+  expect(!r[1].schedulable && !s.schedulable, "t2 misses its 3 ms deadline (R = 4 ms)");
+}
+
+static void check_invalid(void){
+  printf("-- invalid tables\n");
+  plan_result_t r[2];
+  plan_summary_t s;
+  const plan_task_t no_wcet[] = {{"t1", NULL, NULL, 0, MS(5), 0, 0, PLAN_AFFINITY_ANY}};
+  expect(plan_tasks(no_wcet, 1, BASE_PRIORITY, MAX_PRIORITY, r, &s) == -1, "periodic task without wcet");
+  const plan_task_t too_long[] = {{"t1", NULL, NULL, 0, MS(5), MS(1), MS(2), PLAN_AFFINITY_ANY}};
+  expect(plan_tasks(too_long, 1, BASE_PRIORITY, MAX_PRIORITY, r, &s) == -1, "wcet longer than the deadline");
+  const plan_task_t bad_core[] = {{"t1", NULL, NULL, 0, MS(5), 0, MS(1), PLAN_NUM_CORES}};
+  expect(plan_tasks(bad_core, 1, BASE_PRIORITY, MAX_PRIORITY, r, &s) == -1, "affinity out of range");
+}
+
+// prog4のmain.cのタスク表(周期タスクの周期とWCET、非周期タスクのコア指定)
+static void check_prog4_table(void){
+  printf("-- prog4 task table\n");
+  const plan_task_t tasks[] = {
+    {"control", NULL, NULL, 0, 1000, 0, 50, PLAN_AFFINITY_ANY},
+    {"pro", NULL, NULL, 0, 5000, 0, 250, PLAN_AFFINITY_ANY},
+    {"app", NULL, NULL, 0, 10000, 0, 700, PLAN_AFFINITY_ANY},
+    {"report", NULL, NULL, 0, 0, 0, 0, PLAN_AFFINITY_ANY},
+    {"oneshot_i", NULL, NULL, 0, 0, 0, 0, 1},
+    {"oneshot_b", NULL, NULL, 0, 0, 0, 0, 0},
+  };
+  plan_result_t r[6];
+  plan_summary_t s;
+  expect(plan(tasks, 6, r, &s) == 0, "plan");
+  expect(s.schedulable, "schedulable");
+  expect(r[0].priority > r[1].priority && r[1].priority > r[2].priority && r[3].priority == BASE_PRIORITY,
+    "control > pro > app > aperiodic");
+  expect(r[4].core == 1 && r[5].core == 0, "pinned aperiodic tasks keep their cores");
+  expect(s.utilization_permille[0] + s.utilization_permille[1] == 170, "total utilization 170 permille");
+  for (int i = 0; i < 3; i++) {
+    expect(r[i].response_us <= tasks[i].period_us, tasks[i].name);
+  }
+}
+
+int main(void){
+  check_schedulable();
+  check_unschedulable();
+  check_invalid();
+  check_prog4_table();
+  printf("task planner: %d cases failed\n", failed);
+  return failed != 0;
+}
@@ -0,0 +1,64 @@
+// prog5のタスク通知のメールボックス(mailbox.c)を確認する(シミュレータの上で、app_mainのタスクから動かす)
+//
+//   check_prog5_mailbox [--duration ms] [--clock tick|real]
+//
+// 呼んだタスク自身に送って、すぐ受け取る(待たない)
+//   COUNT : 3回送る -> 3, 2, 1 と受け取って、4回目は届いていない
+//   VALUE : 5, 7 と送る -> 7 だけ受け取る
+//   BITS  : 0x1, 0x4 と送る -> 0x5 を受け取る
+// bind前に送ったものは捨てる、範囲外のチャネル、同じ名前の登録、表がいっぱい、インデックス0に触らないことも確かめる
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim.h"
+#include "mailbox.h"
+
+static int expect(bool ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  return !ok;
+}
+
+void app_main(void){
+  static const mailbox_kind_t kinds[] = {MAILBOX_COUNT, MAILBOX_VALUE, MAILBOX_BITS};
+  int failed = 0;
+  uint32_t v = 0;
+
+  mailbox_t *mb = mailbox_register("mb_check", kinds, 3);
+  if (expect(mb != NULL && mb->num_channels == 3, "register 3 channels")) {
+    sim_finish(1);
+  }
+  failed += expect(mailbox_find("mb_check") == mb, "find by name");
+  failed += expect(mailbox_register("mb_check", kinds, 1) == NULL, "same name is not registered twice");
+  failed += expect(!mailbox_post(mb, 0, 0) && mb->dropped == 1, "post before bind is dropped");
+
+  mailbox_bind(mb, NULL);
+  bool posted = mailbox_post(mb, 0, 0) && mailbox_post(mb, 0, 0) && mailbox_post(mb, 0, 0);
+  bool counts = mailbox_wait(mb, 0, &v, 0) && v == 3;
+  counts = counts && mailbox_wait(mb, 0, &v, 0) && v == 2;
+  counts = counts && mailbox_wait(mb, 0, &v, 0) && v == 1;
+  failed += expect(posted && counts && !mailbox_wait(mb, 0, &v, 0), "COUNT: 3, 2, 1 then empty");
+  mailbox_post(mb, 1, 5);
+  mailbox_post(mb, 1, 7);
+  failed += expect(mailbox_wait(mb, 1, &v, 0) && v == 7 && !mailbox_wait(mb, 1, &v, 0), "VALUE: last value only");
+  mailbox_post(mb, 2, 0x1);
+  mailbox_post(mb, 2, 0x4);
+  failed += expect(mailbox_wait(mb, 2, &v, 0) && v == 0x5 && !mailbox_wait(mb, 2, &v, 0), "BITS: or of the bits");
+  failed += expect(!mailbox_post(mb, mb->num_channels, 0) && !mailbox_wait(mb, -1, &v, 0), "channel out of range");
+  failed += expect(xTaskNotifyStateClearIndexed(NULL, 0) == pdFALSE, "index 0 is not touched");
+
+  // 表がいっぱいになったら登録できない
+  static const char *names[MAILBOX_MAX] = {"f0", "f1", "f2", "f3", "f4", "f5", "f6", "f7"};
+  mailbox_t *filled[MAILBOX_MAX] = {0};
+  int n = 0;
+  while (n < MAILBOX_MAX && (filled[n] = mailbox_register(names[n], kinds, 1)) != NULL) {
+    n++;
+  }
+  failed += expect(n < MAILBOX_MAX && mailbox_register("over", kinds, 1) == NULL, "register fails when the table is full");
+  for (int i = 0; i < n; i++) {
+    mailbox_unregister(filled[i]);
+  }
+  mailbox_unregister(mb);
+  failed += expect(mailbox_find("mb_check") == NULL, "unregister");
+  printf("mailbox: %d cases failed\n", failed);
+  sim_finish(failed != 0);
+}
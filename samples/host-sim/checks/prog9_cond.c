@@ -0,0 +1,149 @@
+// prog9のcond_wait(cond_wait.c)とイベントグループの起床レイテンシを比べる(シミュレータの上で動かす)
+//
+//   check_prog9_cond [--duration ms] [--clock tick|real]
+//
+// 負荷タスク(優先度2)が10ms毎に4msだけCPUを使い、その1ms目に割込みから、2ms目にタスクから両方のビットを立てる
+// 待つタスクはどちらも優先度3
+//   割込み: cond_set_bits_from_isrはISRの中で待ちタスクを起こすので、負荷タスクより先に動く
+//           xEventGroupSetBitsFromISRはタイマーデーモン(優先度1)に頼むので、負荷タスクが止まるまで起きない
+//   タスク: cond_set_bits(xTaskNotifyGive)もxEventGroupSetBitsも、その場で待ちタスクに切り替わる
+// 全部の回数が起きて、cond_waitはTick(1ms)以内、割込みからのイベントグループは負荷の残り(1ms以上)かかることを確かめる
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "sim.h"
+#include "cond_wait.h"
+
+#define ROUNDS      100
+#define PERIOD_MS   10
+#define LOAD_US     4000
+#define ISR_AT_US   1000
+#define TASK_AT_US  2000
+
+#define BIT_ISR  (1 << 0)
+#define BIT_TASK (1 << 1)
+
+typedef struct {
+  uint32_t count;
+  int64_t min;
+  int64_t max;
+  int64_t sum;
+} latency_stats_t;
+
+static void latency_stats_add(latency_stats_t *stats, int64_t latency){
+  if (stats->count == 0 || latency < stats->min) stats->min = latency;
+  if (stats->count == 0 || latency > stats->max) stats->max = latency;
+  stats->sum += latency;
+  stats->count++;
+}
+
+// [0]: 割込みから、[1]: タスクから
+static latency_stats_t cond_stats[2];
+static latency_stats_t event_stats[2];
+
+static cond_group_t cond_group;
+static cond_waiter_t cond_waiter;
+static EventGroupHandle_t event_group;
+static volatile int64_t event_set_time_us[2];
+
+static bool signal_isr(void *arg){
+  BaseType_t woken = pdFALSE;
+  event_set_time_us[0] = esp_timer_get_time();
+  xEventGroupSetBitsFromISR(event_group, BIT_ISR, &woken);
+  cond_set_bits_from_isr(&cond_group, BIT_ISR, &woken);
+  return woken == pdTRUE;
+}
+
+static void signal_event(void *arg, uint32_t tag){
+  sim_isr_run("signal", signal_isr, NULL);
+}
+
+static void busy_until(int64_t until_us){
+  while (esp_timer_get_time() < until_us) {
+  }
+}
+
+static void cond_task(void *arg){
+  while (1) {
+    cond_bits_t bits = cond_wait(&cond_group, &cond_waiter, portMAX_DELAY);
+    int64_t latency = esp_timer_get_time() - cond_waiter.signal_time_us;
+    if (bits & BIT_ISR) {
+      latency_stats_add(&cond_stats[0], latency);
+    }
+    if (bits & BIT_TASK) {
+      latency_stats_add(&cond_stats[1], latency);
+    }
+  }
+}
+
+static void event_task(void *arg){
+  while (1) {
+    EventBits_t bits = xEventGroupWaitBits(event_group, BIT_ISR | BIT_TASK, pdTRUE, pdFALSE, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    if (bits & BIT_ISR) {
+      latency_stats_add(&event_stats[0], now - event_set_time_us[0]);
+    }
+    if (bits & BIT_TASK) {
+      latency_stats_add(&event_stats[1], now - event_set_time_us[1]);
+    }
+  }
+}
+
+static void load_task(void *arg){
+  TickType_t last = xTaskGetTickCount();
+  for (int i = 0; i < ROUNDS; i++) {
+    vTaskDelayUntil(&last, pdMS_TO_TICKS(PERIOD_MS));
+    int64_t start = esp_timer_get_time();
+    sim_schedule(start + ISR_AT_US, signal_event, NULL, 0);
+    busy_until(start + TASK_AT_US);
+    event_set_time_us[1] = esp_timer_get_time();
+    xEventGroupSetBits(event_group, BIT_TASK);
+    cond_set_bits(&cond_group, BIT_TASK);
+    busy_until(start + LOAD_US);
+  }
+  // 最後の起床を待ってから集計する
+  vTaskDelay(pdMS_TO_TICKS(PERIOD_MS));
+  xTaskNotifyGive((TaskHandle_t)arg);
+  vTaskDelete(NULL);
+}
+
+static void print_stats(const char *name, const latency_stats_t *s){
+  printf("  %-12s n=%3lu min=%5lld avg=%5lld max=%5lld [us]\n", name, (unsigned long)s->count,
+    (long long)s->min, (long long)(s->count ? s->sum / s->count : 0), (long long)s->max);
+}
+
+static int expect(bool ok, const char *what){
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  return !ok;
+}
+
+void app_main(void){
+  event_group = xEventGroupCreate();
+  cond_group_init(&cond_group);
+  // xEventGroupWaitBits(pdTRUE, pdFALSE)と同じ条件
+  cond_waiter_init(&cond_waiter, BIT_ISR | BIT_TASK, COND_WAIT_ANY, COND_TRIGGER_LEVEL, true);
+  cond_group_add_waiter(&cond_group, &cond_waiter);
+
+  xTaskCreatePinnedToCore(cond_task, "cond", 4096, NULL, 3, NULL, APP_CPU_NUM);
+  xTaskCreatePinnedToCore(event_task, "event", 4096, NULL, 3, NULL, APP_CPU_NUM);
+  xTaskCreatePinnedToCore(load_task, "load", 4096, xTaskGetCurrentTaskHandle(), 2, NULL, APP_CPU_NUM);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+  printf("wakeup latency from ISR (load %d us after the signal)\n", LOAD_US - ISR_AT_US);
+  print_stats("cond_wait", &cond_stats[0]);
+  print_stats("event group", &event_stats[0]);
+  printf("wakeup latency from task\n");
+  print_stats("cond_wait", &cond_stats[1]);
+  print_stats("event group", &event_stats[1]);
+
+  int failed = 0;
+  failed += expect(cond_stats[0].count == ROUNDS && event_stats[0].count == ROUNDS, "every ISR signal wakes both waiters");
+  failed += expect(cond_stats[1].count == ROUNDS && event_stats[1].count == ROUNDS, "every task signal wakes both waiters");
+  failed += expect(cond_stats[0].max < 1000, "cond_wait from ISR wakes within a tick");
+  failed += expect(event_stats[0].min >= 1000, "event group from ISR waits for the timer daemon");
+  failed += expect(cond_stats[0].max < event_stats[0].min, "cond_wait from ISR is faster than the event group");
+  failed += expect(cond_stats[1].max < 1000 && event_stats[1].max < 1000, "both wake within a tick from a task");
+  sim_finish(failed != 0);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// ホストシミュレーション用のFreeRTOS設定(POSIXポート)
+// ESP-IDFのsdkconfig(CONFIG_FREERTOS_HZ=1000, configMAX_PRIORITIES=25)に合わせている
+// POSIXポートはシングルコアなので、2コア分のタスクは1コアで動く
+
+#define configUSE_PREEMPTION                    1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+#define configUSE_TICKLESS_IDLE                 0
+#define configTICK_RATE_HZ                      1000
+#define configMAX_PRIORITIES                    25
+// POSIXポートのスタックはStackType_t(8byte)単位、pthreadの最小スタック以上にする
+#define configMINIMAL_STACK_SIZE                ((unsigned short)(16384 / sizeof(StackType_t)))
+#define configMAX_TASK_NAME_LEN                 16
+#define configUSE_16_BIT_TICKS                  0
+#define configIDLE_SHOULD_YIELD                 1
+#define configUSE_TASK_NOTIFICATIONS            1
+// prog5/prog17のmailboxがインデックス1～を使う(実機はCONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES=4)
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES   4
+#define configUSE_MUTEXES                       1
+#define configUSE_RECURSIVE_MUTEXES             1
+#define configUSE_COUNTING_SEMAPHORES           1
+#define configQUEUE_REGISTRY_SIZE               0
+#define configUSE_QUEUE_SETS                    1
+#define configUSE_TIME_SLICING                  1
+#define configUSE_NEWLIB_REENTRANT              0
+#define configENABLE_BACKWARD_COMPATIBILITY     1
+#define configSTACK_DEPTH_TYPE                  uint32_t
+
+#define configSUPPORT_STATIC_ALLOCATION         1
+#define configSUPPORT_DYNAMIC_ALLOCATION        1
+#define configTOTAL_HEAP_SIZE                   ((size_t)(8 * 1024 * 1024))
+#define configAPPLICATION_ALLOCATED_HEAP        0
+
+#define configUSE_IDLE_HOOK                     1
+#define configUSE_TICK_HOOK                     1
+#define configCHECK_FOR_STACK_OVERFLOW          0
+#define configUSE_MALLOC_FAILED_HOOK            1
+#define configUSE_DAEMON_TASK_STARTUP_HOOK      0
+
+#define configGENERATE_RUN_TIME_STATS           1
+#define configUSE_TRACE_FACILITY                1
+#define configUSE_STATS_FORMATTING_FUNCTIONS    1
+#define configRECORD_STACK_HIGH_ADDRESS         1
+
+#define configUSE_CO_ROUTINES                   0
+#define configUSE_TIMERS                        1
+#define configTIMER_TASK_PRIORITY               1
+#define configTIMER_QUEUE_LENGTH                10
+#define configTIMER_TASK_STACK_DEPTH            configMINIMAL_STACK_SIZE
+
+#define INCLUDE_vTaskPrioritySet                1
+#define INCLUDE_uxTaskPriorityGet               1
+#define INCLUDE_vTaskDelete                     1
+#define INCLUDE_vTaskSuspend                    1
+#define INCLUDE_xResumeFromISR                  1
+#define INCLUDE_vTaskDelayUntil                 1
+#define INCLUDE_vTaskDelay                      1
+#define INCLUDE_xTaskGetSchedulerState          1
+#define INCLUDE_xTaskGetCurrentTaskHandle       1
+#define INCLUDE_uxTaskGetStackHighWaterMark     1
+#define INCLUDE_xTaskGetIdleTaskHandle          1
+#define INCLUDE_eTaskGetState                   1
+#define INCLUDE_xTimerPendFunctionCall          1
+#define INCLUDE_xTaskAbortDelay                 1
+#define INCLUDE_xTaskGetHandle                  1
+#define INCLUDE_xTaskResumeFromISR              1
+#define INCLUDE_xSemaphoreGetMutexHolder        1
+#define INCLUDE_xEventGroupSetBitFromISR        1
+
+// 実行時間カウンタは仮想時間[us]
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+uint32_t sim_run_time_counter(void);
+void sim_trace_task_switched_in(void *tcb);
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()        sim_run_time_counter()
+
+// タスク切り替えをトレースに記録する
+#define traceTASK_SWITCHED_IN()                 sim_trace_task_switched_in(pxCurrentTCB)
+
+#define configASSERT(x) do { if (!(x)) { vAssertCalled(__FILE__, __LINE__); } } while (0)
+#ifndef __ASSEMBLER__
+void vAssertCalled(const char *file, unsigned long line);
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+// ホストでは配置属性は意味を持たないが、tools/iram_audit.pyで確認できるようにセクション名だけ残す
+// (IRAM_ATTRは.iram1.N、DRAM_ATTRは.dram1.N。実機と同じく1つ毎に別のセクションにする)
+#define _SIM_ATTR_STR(x) #x
+#define _SIM_SECTION(prefix, n) __attribute__((section(prefix _SIM_ATTR_STR(n))))
+#define IRAM_ATTR _SIM_SECTION(".iram1.", __COUNTER__)
+#define DRAM_ATTR _SIM_SECTION(".dram1.", __COUNTER__)
+// 文字列をDRAMに置く(フラッシュのキャッシュが止まっている間に割込みから使う)
+#define DRAM_STR(str) (__extension__({static const DRAM_ATTR char __c[] = (str); (const char *)&__c;}))
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define EXT_RAM_BSS_ATTR
+#define EXT_RAM_ATTR
+#define NOINIT_ATTR
+#define WORD_ALIGNED_ATTR __attribute__((aligned(4)))
+#define FORCE_INLINE_ATTR static inline __attribute__((always_inline))
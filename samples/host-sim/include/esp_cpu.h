@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// タスクを固定したコア番号を返す(割込みの中では割込みを登録したタスクのコア。実際には1コアで動いている)
+int esp_cpu_get_core_id(void);
+// 仮想時間からCPUサイクル数(CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ)を返す
+uint32_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+}
+#endif
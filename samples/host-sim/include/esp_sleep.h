@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// スリープは仮想時間を進めるだけ
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+esp_err_t esp_light_sleep_start(void);
+// GPIOのウェイクアップ(gpio_wakeup_enable)を有効にする。ホストではスリープしないので何もしない
+esp_err_t esp_sleep_enable_gpio_wakeup(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 起動からの仮想時間[us]
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
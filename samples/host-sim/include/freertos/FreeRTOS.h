@@ -0,0 +1,61 @@
+#pragma once
+// ESP-IDFの<freertos/FreeRTOS.h>の代わり
+// カーネル本体(POSIXポート)のFreeRTOS.hを読み込んで、ESP-IDF独自の拡張を足す
+#include <FreeRTOS.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_rom_sys.h"
+#include "esp_cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PRO_CPU_NUM 0
+#define APP_CPU_NUM 1
+// 論理的には2コアとして扱う。実際の実行は1コア
+#define portNUM_PROCESSORS 2
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+
+// ESP-IDFのportMUX(スピンロック)
+// シングルコアなのでクリティカルセクションにする
+typedef struct {
+  volatile uint32_t owner;
+  volatile uint32_t count;
+} portMUX_TYPE;
+#define portMUX_FREE_VAL 0xB33FFFFF
+#define portMUX_INITIALIZER_UNLOCKED {.owner = portMUX_FREE_VAL, .count = 0}
+#define portMUX_INITIALIZE(mux) do { (mux)->owner = portMUX_FREE_VAL; (mux)->count = 0; } while (0)
+
+void sim_enter_critical(portMUX_TYPE *mux);
+void sim_exit_critical(portMUX_TYPE *mux);
+BaseType_t sim_in_isr(void);
+
+#undef portENTER_CRITICAL
+#undef portEXIT_CRITICAL
+#define portENTER_CRITICAL(mux)     sim_enter_critical(mux)
+#define portEXIT_CRITICAL(mux)      sim_exit_critical(mux)
+#define portENTER_CRITICAL_ISR(mux) sim_enter_critical(mux)
+#define portEXIT_CRITICAL_ISR(mux)  sim_exit_critical(mux)
+#define portENTER_CRITICAL_SAFE(mux) sim_enter_critical(mux)
+#define portEXIT_CRITICAL_SAFE(mux)  sim_exit_critical(mux)
+
+// ESP-IDFでは引数なしでも呼べる
+// 割込みハンドラの中ではすぐに切り替えず、ハンドラを抜けてから切り替える
+void sim_yield_from_isr(BaseType_t yield);
+#undef portYIELD_FROM_ISR
+#undef portEND_SWITCHING_ISR
+#define portEND_SWITCHING_ISR(x) sim_yield_from_isr(x)
+#define portYIELD_FROM_ISR_ARG(x) sim_yield_from_isr(x)
+#define portYIELD_FROM_ISR_NOARG() sim_yield_from_isr(pdTRUE)
+#define portYIELD_FROM_ISR_SELECT(_0, _1, name, ...) name
+#define portYIELD_FROM_ISR(...) portYIELD_FROM_ISR_SELECT(_0, ##__VA_ARGS__, portYIELD_FROM_ISR_ARG, portYIELD_FROM_ISR_NOARG)(__VA_ARGS__)
+
+#define xPortInIsrContext() sim_in_isr()
+#define xPortGetCoreID() sim_core_id()
+BaseType_t sim_core_id(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+// ESP-IDFの<freertos/event_groups.h>の代わり
+#include "freertos/task.h"
+#include <event_groups.h>
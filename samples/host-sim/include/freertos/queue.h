@@ -0,0 +1,4 @@
+#pragma once
+// ESP-IDFの<freertos/queue.h>の代わり
+#include "freertos/task.h"
+#include <queue.h>
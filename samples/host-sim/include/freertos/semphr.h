@@ -0,0 +1,4 @@
+#pragma once
+// ESP-IDFの<freertos/semphr.h>の代わり
+#include "freertos/task.h"
+#include <semphr.h>
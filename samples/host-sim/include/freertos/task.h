@@ -0,0 +1,32 @@
+#pragma once
+// ESP-IDFの<freertos/task.h>の代わり
+#include "freertos/FreeRTOS.h"
+#include <task.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ESP-IDFではクリティカルセクションにportMUXを渡す
+#undef taskENTER_CRITICAL
+#undef taskEXIT_CRITICAL
+#undef taskENTER_CRITICAL_ISR
+#undef taskEXIT_CRITICAL_ISR
+#define taskENTER_CRITICAL(mux)     sim_enter_critical(mux)
+#define taskEXIT_CRITICAL(mux)      sim_exit_critical(mux)
+#define taskENTER_CRITICAL_ISR(mux) sim_enter_critical(mux)
+#define taskEXIT_CRITICAL_ISR(mux)  sim_exit_critical(mux)
+
+// スタックサイズはESP-IDFと同じくバイトで指定する
+// ホストでは1単位がStackType_t(8byte)になるので、実機より大きなスタックになる
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, const uint32_t stack_depth,
+  void *arg, UBaseType_t priority, TaskHandle_t *handle, const BaseType_t core_id);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, const uint32_t stack_depth,
+  void *arg, UBaseType_t priority, StackType_t *stack, StaticTask_t *tcb, const BaseType_t core_id);
+BaseType_t xTaskGetAffinity(TaskHandle_t task);
+TaskHandle_t xTaskGetIdleTaskHandleForCPU(UBaseType_t cpu);
+TaskHandle_t xTaskGetCurrentTaskHandleForCPU(BaseType_t cpu);
+
+#ifdef __cplusplus
+}
+#endif
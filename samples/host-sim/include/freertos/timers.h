@@ -0,0 +1,4 @@
+#pragma once
+// ESP-IDFの<freertos/timers.h>の代わり
+#include "freertos/task.h"
+#include <timers.h>
@@ -0,0 +1,13 @@
+#pragma once
+// ホストシミュレーション用のsdkconfig
+// 実機のsdkconfig.defaultsのうち、サンプルが参照するものだけ
+#define CONFIG_IDF_TARGET "esp32s3"
+#define CONFIG_IDF_TARGET_ESP32S3 1
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 160
+#define CONFIG_FREERTOS_UNICORE 0
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+#define CONFIG_ESP_TASK_WDT_TIMEOUT_S 5
+#define CONFIG_FREERTOS_USE_TRACE_FACILITY 1
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+#define CONFIG_SIM_HOST 1
@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// ホストシミュレーションのAPI
+// サンプル側からは #ifdef CONFIG_SIM_HOST で囲んで使う
+// モデル(モーターなど)やベンチマークから仮想時間、擬似ペリフェラル、トレースを操作する
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//------------------------
+// 仮想時間
+//------------------------
+// 起動からの仮想時間[us]
+// 割込みハンドラ、イベント処理中はそのイベントの時刻、タスクではTick時刻(+Tick内の経過時間)
+int64_t sim_now_us(void);
+
+// 仮想時間time_usにfn(arg)を呼ぶ。fnはシミュレータのイベント処理の中で呼ばれる(割込みではない)
+typedef void (*sim_event_fn_t)(void *arg, uint32_t tag);
+bool sim_schedule(int64_t time_us, sim_event_fn_t fn, void *arg, uint32_t tag);
+// period_us毎にfn(arg)を呼ぶ(モデルの更新用)
+bool sim_every(uint32_t period_us, sim_event_fn_t fn, void *arg);
+
+// 割込みとしてfn(arg)を実行する。fnがtrueを返したら抜けた後にタスクを切り替える
+typedef bool (*sim_isr_fn_t)(void *arg);
+void sim_isr_run(const char *source, sim_isr_fn_t fn, void *arg);
+
+// シミュレーションを終了する(トレースを書き出してexitする)
+void sim_finish(int code) __attribute__((noreturn));
+
+//------------------------
+// 擬似ペリフェラル
+//------------------------
+// 外部からGPIOを駆動する(入力ピンのエッジで割込み、PCNTが動く)
+void sim_gpio_drive(int gpio_num, int level);
+// 出力ピンのレベル
+int sim_gpio_output(int gpio_num);
+// GPIOの変化を監視する(モデル用)
+typedef void (*sim_gpio_listener_t)(int gpio_num, int level, void *arg);
+bool sim_gpio_add_listener(sim_gpio_listener_t fn, void *arg);
+// ADCの読み取り値を設定する
+void sim_adc_set(int unit, int channel, int raw);
+// MCPWMジェネレータの出力デューティ[‰]、ジェネレータがなければ-1
+int sim_pwm_duty(int gpio_num);
+
+//------------------------
+// モデル
+//------------------------
+// DCモーター(1次遅れ)、PWMのデューティで回ってエンコーダのA/B相を出す
+typedef struct {
+  int pwm_gpio;         // 正転側のPWM出力
+  int pwm_rev_gpio;     // 逆転側のPWM出力(Hブリッジのもう一方のレッグ)、なければ-1
+  int enc_a;            // エンコーダA相の入力GPIO
+  int enc_b;            // エンコーダB相の入力GPIO
+  int max_rpm;          // デューティ100%、無負荷の回転数
+  int tau_ms;           // 時定数
+  int cpr;              // 1回転あたりのカウント(4逓倍後)
+} sim_motor_config_t;
+
+// モーターを追加してidを返す。失敗したら-1
+// トレースには10ms毎に motor<id>_rpm のeventとして回転数を記録する
+int sim_motor_add(const sim_motor_config_t *config);
+// 負荷トルク(停動トルクに対する‰)
+void sim_motor_set_load(int id, int permille);
+int sim_motor_rpm(int id);
+
+//------------------------
+// トレース(--trace out.csv)
+//------------------------
+typedef enum {
+  SIM_TRACE_TASK,   // タスク切り替え value=優先度
+  SIM_TRACE_ISR,    // 割込み value=1:開始 0:終了
+  SIM_TRACE_GPIO,   // GPIOの変化 value=レベル
+  SIM_TRACE_PWM,    // PWMデューティの変化 value=‰
+  SIM_TRACE_WDT,    // タスクウォッチドッグ value=経過時間[ms]
+  SIM_TRACE_EVENT,  // スティミュラス
+  SIM_TRACE_MARK,   // サンプルからの任意の記録
+} sim_trace_kind_t;
+
+bool sim_trace_enabled(void);
+void sim_trace(sim_trace_kind_t kind, const char *name, int32_t value);
+#define sim_trace_mark(name, value) sim_trace(SIM_TRACE_MARK, name, value)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "sim_internal.h"
+
+// ADC(ワンショット)とキャリブレーション
+// 読み取り値はsim_adc_set()(スティミュラスのadcコマンド)で設定した値
+// キャリブレーションは減衰量毎の入力範囲で直線変換する
+
+#define ADC_NUM_UNITS 2
+#define ADC_NUM_CHANNELS 10
+#define ADC_MAX_RAW 4095
+
+struct adc_oneshot_unit_ctx_t {
+  adc_unit_t unit_id;
+};
+
+struct adc_cali_scheme_t {
+  adc_atten_t atten;
+};
+
+static volatile int raw_values[ADC_NUM_UNITS][ADC_NUM_CHANNELS];
+static bool unit_used[ADC_NUM_UNITS];
+
+// 減衰量毎のフルスケール[mV]
+static const int full_scale_mv[] = {
+  [ADC_ATTEN_DB_0] = 950,
+  [ADC_ATTEN_DB_2_5] = 1250,
+  [ADC_ATTEN_DB_6] = 1750,
+  [ADC_ATTEN_DB_11] = 3100,
+};
+
+void sim_adc_set(int unit, int channel, int raw){
+  // スティミュラスのunitは1始まり(ADC1, ADC2)
+  int u = unit - 1;
+  if (u < 0 || u >= ADC_NUM_UNITS || channel < 0 || channel >= ADC_NUM_CHANNELS) {
+    return;
+  }
+  raw_values[u][channel] = raw < 0 ? 0 : raw > ADC_MAX_RAW ? ADC_MAX_RAW : raw;
+}
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *init_config, adc_oneshot_unit_handle_t *ret_unit){
+  if (init_config == NULL || ret_unit == NULL || init_config->unit_id >= ADC_NUM_UNITS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (unit_used[init_config->unit_id]) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  struct adc_oneshot_unit_ctx_t *u = calloc(1, sizeof(struct adc_oneshot_unit_ctx_t));
+  if (u == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  u->unit_id = init_config->unit_id;
+  unit_used[u->unit_id] = true;
+  *ret_unit = u;
+  return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel, const adc_oneshot_chan_cfg_t *config){
+  if (handle == NULL || config == NULL || channel >= ADC_NUM_CHANNELS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int *out_raw){
+  if (handle == NULL || out_raw == NULL || chan >= ADC_NUM_CHANNELS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *out_raw = raw_values[handle->unit_id][chan];
+  return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle){
+  if (handle == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  unit_used[handle->unit_id] = false;
+  free(handle);
+  return ESP_OK;
+}
+
+esp_err_t adc_oneshot_io_to_channel(int io_num, adc_unit_t *unit_id, adc_channel_t *channel){
+  // ESP32-S3: GPIO1-10がADC1_CH0-9、GPIO11-20がADC2_CH0-9
+  if (io_num >= 1 && io_num <= 10) {
+    *unit_id = ADC_UNIT_1;
+    *channel = (adc_channel_t)(io_num - 1);
+  } else if (io_num >= 11 && io_num <= 20) {
+    *unit_id = ADC_UNIT_2;
+    *channel = (adc_channel_t)(io_num - 11);
+  } else {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
+
+static esp_err_t create_cali(adc_atten_t atten, adc_cali_handle_t *ret_handle){
+  if (ret_handle == NULL || atten > ADC_ATTEN_DB_11) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  struct adc_cali_scheme_t *c = calloc(1, sizeof(struct adc_cali_scheme_t));
+  if (c == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  c->atten = atten;
+  *ret_handle = c;
+  return ESP_OK;
+}
+
+esp_err_t adc_cali_create_scheme_curve_fitting(const adc_cali_curve_fitting_config_t *config, adc_cali_handle_t *ret_handle){
+  return config ? create_cali(config->atten, ret_handle) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t adc_cali_delete_scheme_curve_fitting(adc_cali_handle_t handle){
+  free(handle);
+  return ESP_OK;
+}
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config, adc_cali_handle_t *ret_handle){
+  return config ? create_cali(config->atten, ret_handle) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle){
+  free(handle);
+  return ESP_OK;
+}
+
+esp_err_t adc_cali_check_scheme(adc_cali_scheme_ver_t *scheme_mask){
+  *scheme_mask = ADC_CALI_SCHEME_VER_LINE_FITTING | ADC_CALI_SCHEME_VER_CURVE_FITTING;
+  return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage){
+  if (handle == NULL || voltage == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *voltage = raw * full_scale_mv[handle->atten] / ADC_MAX_RAW;
+  return ESP_OK;
+}
@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim_internal.h"
+
+// 仮想時間とイベント処理
+// イベント(スティミュラス、タイマのアラームなど)は時刻順のヒープに入れておき、
+// 最高優先度の"sim_isr"タスクがTick毎に期限の来たものを時刻順に処理する
+// Tickより細かい間隔のイベントは次のTickでまとめて処理されるが、
+// ハンドラの中から見える時刻(sim_now_us)はイベントの時刻になる
+
+#define SIM_MAX_EVENTS 512
+#define SIM_TICK_US (1000000 / configTICK_RATE_HZ)
+#define SIM_TRACE_FLUSH_US 100000
+
+typedef struct {
+  int64_t time_us;
+  uint32_t seq;       // 同じ時刻なら登録順
+  sim_event_fn_t fn;
+  void *arg;
+  uint32_t tag;
+} sim_event_t;
+
+static sim_event_t events[SIM_MAX_EVENTS];
+static int num_events = 0;
+static uint32_t event_seq = 0;
+
+static volatile int64_t tick_us = 0;
+static volatile int64_t event_time_us = -1;  // イベント処理中の時刻
+static struct timespec tick_real;            // 最後のTickの実時間
+static volatile int isr_nesting = 0;
+static volatile int isr_core = PRO_CPU_NUM;
+static volatile bool isr_yield_pending = false;
+static TaskHandle_t dispatcher = NULL;
+
+bool sim_scheduler_running(void){
+  return xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+}
+
+void sim_lock(void){
+  if (sim_scheduler_running()) {
+    vPortEnterCritical();
+  }
+}
+
+void sim_unlock(void){
+  if (sim_scheduler_running()) {
+    vPortExitCritical();
+  }
+}
+
+//------------------------
+// ESP-IDF互換のクリティカルセクション
+//------------------------
+void sim_enter_critical(portMUX_TYPE *mux){
+  sim_lock();
+  mux->count++;
+}
+
+void sim_exit_critical(portMUX_TYPE *mux){
+  mux->count--;
+  sim_unlock();
+}
+
+BaseType_t sim_in_isr(void){
+  return isr_nesting > 0;
+}
+
+void sim_yield_from_isr(BaseType_t yield){
+  if (!yield) {
+    return;
+  }
+  if (isr_nesting > 0) {
+    isr_yield_pending = true;
+  } else if (sim_scheduler_running()) {
+    vPortYield();
+  }
+}
+
+//------------------------
+// 仮想時間
+//------------------------
+static int64_t real_subtick_ns(void){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t ns = (now.tv_sec - tick_real.tv_sec) * 1000000000LL + (now.tv_nsec - tick_real.tv_nsec);
+  if (ns < 0) {
+    return 0;
+  }
+  return ns >= SIM_TICK_US * 1000LL ? SIM_TICK_US * 1000LL - 1 : ns;
+}
+
+// REALモードではTick内をns単位で補間する(ベンチマークでサイクル数を出すため)
+int64_t sim_now_ns(void){
+  if (event_time_us >= 0) {
+    return event_time_us * 1000;
+  }
+  if (sim_options.clock_mode == SIM_CLOCK_REAL && sim_scheduler_running()) {
+    return tick_us * 1000 + real_subtick_ns();
+  }
+  return tick_us * 1000;
+}
+
+int64_t sim_now_us(void){
+  return sim_now_ns() / 1000;
+}
+
+uint32_t sim_run_time_counter(void){
+  return (uint32_t)sim_now_us();
+}
+
+//------------------------
+// イベントヒープ
+//------------------------
+static bool event_before(const sim_event_t *a, const sim_event_t *b){
+  return a->time_us < b->time_us || (a->time_us == b->time_us && (int32_t)(a->seq - b->seq) < 0);
+}
+
+static void event_swap(int a, int b){
+  sim_event_t tmp = events[a];
+  events[a] = events[b];
+  events[b] = tmp;
+}
+
+bool sim_schedule(int64_t time_us, sim_event_fn_t fn, void *arg, uint32_t tag){
+  sim_lock();
+  if (num_events >= SIM_MAX_EVENTS) {
+    sim_unlock();
+    printf("sim: event queue full\n");
+    return false;
+  }
+  int i = num_events++;
+  events[i] = (sim_event_t){
+    .time_us = time_us,
+    .seq = event_seq++,
+    .fn = fn,
+    .arg = arg,
+    .tag = tag,
+  };
+  while (i > 0 && event_before(&events[i], &events[(i - 1) / 2])) {
+    event_swap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+  sim_unlock();
+  return true;
+}
+
+// 期限がlimit_us以前のイベントを取り出す
+static bool event_pop(int64_t limit_us, sim_event_t *out){
+  sim_lock();
+  if (num_events == 0 || events[0].time_us > limit_us) {
+    sim_unlock();
+    return false;
+  }
+  *out = events[0];
+  events[0] = events[--num_events];
+  int i = 0;
+  while (1) {
+    int l = i * 2 + 1;
+    int r = l + 1;
+    int m = i;
+    if (l < num_events && event_before(&events[l], &events[m])) {
+      m = l;
+    }
+    if (r < num_events && event_before(&events[r], &events[m])) {
+      m = r;
+    }
+    if (m == i) {
+      break;
+    }
+    event_swap(i, m);
+    i = m;
+  }
+  sim_unlock();
+  return true;
+}
+
+typedef struct {
+  uint32_t period_us;
+  sim_event_fn_t fn;
+  void *arg;
+} sim_periodic_t;
+
+static void periodic_event(void *arg, uint32_t tag){
+  sim_periodic_t *p = (sim_periodic_t *)arg;
+  p->fn(p->arg, tag);
+  sim_schedule(sim_now_us() + p->period_us, periodic_event, p, tag + 1);
+}
+
+bool sim_every(uint32_t period_us, sim_event_fn_t fn, void *arg){
+  sim_periodic_t *p = malloc(sizeof(sim_periodic_t));
+  if (p == NULL || period_us == 0) {
+    free(p);
+    return false;
+  }
+  *p = (sim_periodic_t){.period_us = period_us, .fn = fn, .arg = arg};
+  return sim_schedule(sim_now_us() + period_us, periodic_event, p, 0);
+}
+
+//------------------------
+// 割込み
+//------------------------
+void sim_isr_run(const char *source, sim_isr_fn_t fn, void *arg){
+  sim_isr_run_on(PRO_CPU_NUM, source, fn, arg);
+}
+
+int sim_isr_core(void){
+  return isr_core;
+}
+
+void sim_isr_run_on(int core, const char *source, sim_isr_fn_t fn, void *arg){
+  sim_lock();
+  int64_t prev_time = event_time_us;
+  int prev_core = isr_core;
+  // 割込みの中で時刻が進まないように固定する
+  event_time_us = sim_now_us();
+  isr_core = core;
+  isr_nesting++;
+  sim_trace(SIM_TRACE_ISR, source, 1);
+  if (fn(arg)) {
+    isr_yield_pending = true;
+  }
+  sim_trace(SIM_TRACE_ISR, source, 0);
+  isr_nesting--;
+  event_time_us = prev_time;
+  isr_core = prev_core;
+  bool yield = isr_nesting == 0 && isr_yield_pending;
+  if (isr_nesting == 0) {
+    isr_yield_pending = false;
+  }
+  sim_unlock();
+  if (yield && sim_scheduler_running()) {
+    vPortYield();
+  }
+}
+
+//------------------------
+// Tick
+//------------------------
+void sim_tick_hook_run(void){
+  tick_us += SIM_TICK_US;
+  if (sim_options.clock_mode == SIM_CLOCK_REAL) {
+    clock_gettime(CLOCK_MONOTONIC, &tick_real);
+  }
+  // Tickフックの中では切り替えない。xTaskIncrementTick()がTickの最後に切り替える
+  if (dispatcher != NULL) {
+    vTaskNotifyGiveFromISR(dispatcher, NULL);
+  }
+}
+
+static void dispatcher_task(void *arg){
+  int64_t next_flush = SIM_TRACE_FLUSH_US;
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    int64_t now = tick_us;
+    sim_event_t ev;
+    while (event_pop(now, &ev)) {
+      event_time_us = ev.time_us;
+      ev.fn(ev.arg, ev.tag);
+      event_time_us = -1;
+    }
+    sim_wdt_check(now);
+    if (now >= next_flush) {
+      sim_trace_flush();
+      next_flush = now + SIM_TRACE_FLUSH_US;
+    }
+    if (sim_options.duration_us > 0 && now >= sim_options.duration_us) {
+      sim_finish(0);
+    }
+  }
+}
+
+void sim_clock_init(void){
+  num_events = 0;
+  event_seq = 0;
+  tick_us = 0;
+  clock_gettime(CLOCK_MONOTONIC, &tick_real);
+}
+
+void sim_clock_start(void){
+  // 割込みの代わりなので最高優先度
+  xTaskCreate(dispatcher_task, "sim_isr", configMINIMAL_STACK_SIZE * 2, NULL, configMAX_PRIORITIES - 1, &dispatcher);
+}
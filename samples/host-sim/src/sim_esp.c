@@ -0,0 +1,613 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_random.h"
+#include "esp_task_wdt.h"
+#include "esp_freertos_hooks.h"
+#include "esp_heap_caps.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include "sim_internal.h"
+
+// ESP-IDFのシステム系APIの置き換え
+// (ログ、エラー、乱数、タスクウォッチドッグ、ヒープ、コア固定のタスク作成、フック)
+
+//------------------------
+// ログ
+//------------------------
+#define LOG_MAX_TAGS 16
+
+static esp_log_level_t default_level = (esp_log_level_t)CONFIG_LOG_DEFAULT_LEVEL;
+static struct {
+  char tag[16];
+  esp_log_level_t level;
+} tag_levels[LOG_MAX_TAGS];
+
+void esp_log_level_set(const char *tag, esp_log_level_t level){
+  if (strcmp(tag, "*") == 0) {
+    default_level = level;
+    return;
+  }
+  for (int i = 0; i < LOG_MAX_TAGS; i++) {
+    if (tag_levels[i].tag[0] == '\0' || strcmp(tag_levels[i].tag, tag) == 0) {
+      strncpy(tag_levels[i].tag, tag, sizeof(tag_levels[i].tag) - 1);
+      tag_levels[i].level = level;
+      return;
+    }
+  }
+}
+
+esp_log_level_t esp_log_level_get(const char *tag){
+  for (int i = 0; i < LOG_MAX_TAGS && tag_levels[i].tag[0]; i++) {
+    if (strcmp(tag_levels[i].tag, tag) == 0) {
+      return tag_levels[i].level;
+    }
+  }
+  return default_level;
+}
+
+uint32_t esp_log_timestamp(void){
+  return (uint32_t)(sim_now_us() / 1000);
+}
+
+// POSIXポートではprintf中に切り替わると他のタスクがstdioのロックで止まるので
+// 出力中はクリティカルセクションにする
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...){
+  if (level > esp_log_level_get(tag)) {
+    return;
+  }
+  va_list ap;
+  va_start(ap, format);
+  sim_lock();
+  vprintf(format, ap);
+  fflush(stdout);
+  sim_unlock();
+  va_end(ap);
+}
+
+int esp_rom_printf(const char *fmt, ...){
+  va_list ap;
+  va_start(ap, fmt);
+  sim_lock();
+  int n = vprintf(fmt, ap);
+  fflush(stdout);
+  sim_unlock();
+  va_end(ap);
+  return n;
+}
+
+void esp_rom_delay_us(uint32_t us){
+  // 実機と同じくビジーウェイト(実時間)
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 < us);
+}
+
+//------------------------
+// エラー
+//------------------------
+const char *esp_err_to_name(esp_err_t code){
+  switch (code) {
+  case ESP_OK: return "ESP_OK";
+  case ESP_FAIL: return "ESP_FAIL";
+  case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+  case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+  case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+  case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+  case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+  case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+  case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+  case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+  case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+  case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+  case ESP_ERR_NOT_FINISHED: return "ESP_ERR_NOT_FINISHED";
+  default: return "UNKNOWN ERROR";
+  }
+}
+
+void sim_error_check_failed(esp_err_t rc, const char *file, int line, const char *function, const char *expression){
+  printf("ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\n", rc, esp_err_to_name(rc), file, line);
+  printf("file: \"%s\" line %d\nfunc: %s\nexpression: %s\n", file, line, function, expression);
+  sim_finish(1);
+}
+
+void esp_restart(void){
+  printf("sim: esp_restart\n");
+  sim_finish(0);
+}
+
+//------------------------
+// 乱数
+//------------------------
+static uint32_t random_state = 1;
+
+void sim_random_seed(uint32_t seed){
+  random_state = seed ? seed : 1;
+}
+
+uint32_t esp_random(void){
+  // xorshift32
+  sim_lock();
+  uint32_t x = random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  random_state = x;
+  sim_unlock();
+  return x;
+}
+
+void esp_fill_random(void *buf, size_t len){
+  uint8_t *p = (uint8_t *)buf;
+  for (size_t i = 0; i < len; i += 4) {
+    uint32_t r = esp_random();
+    memcpy(p + i, &r, len - i < 4 ? len - i : 4);
+  }
+}
+
+//------------------------
+// コア固定のタスク作成
+//------------------------
+#define SIM_MAX_TASKS 64
+
+static struct {
+  TaskHandle_t task;
+  BaseType_t core;
+} affinity[SIM_MAX_TASKS];
+
+static void set_affinity(TaskHandle_t task, BaseType_t core){
+  sim_lock();
+  for (int i = 0; i < SIM_MAX_TASKS; i++) {
+    // 削除されたタスクのハンドルは再利用されることがあるので上書きする
+    if (affinity[i].task == NULL || affinity[i].task == task) {
+      affinity[i].task = task;
+      affinity[i].core = core;
+      break;
+    }
+  }
+  sim_unlock();
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t task){
+  if (task == NULL) {
+    task = xTaskGetCurrentTaskHandle();
+  }
+  for (int i = 0; i < SIM_MAX_TASKS && affinity[i].task; i++) {
+    if (affinity[i].task == task) {
+      return affinity[i].core;
+    }
+  }
+  return tskNO_AFFINITY;
+}
+
+BaseType_t sim_core_id(void){
+  if (sim_in_isr()) {
+    return sim_isr_core();
+  }
+  if (!sim_scheduler_running()) {
+    return PRO_CPU_NUM;
+  }
+  BaseType_t core = xTaskGetAffinity(NULL);
+  return core == tskNO_AFFINITY ? PRO_CPU_NUM : core;
+}
+
+int esp_cpu_get_core_id(void){
+  return (int)sim_core_id();
+}
+
+uint32_t esp_cpu_get_cycle_count(void){
+  return (uint32_t)(sim_now_ns() * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ / 1000);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, const uint32_t stack_depth,
+  void *arg, UBaseType_t priority, TaskHandle_t *handle, const BaseType_t core_id){
+  TaskHandle_t task = NULL;
+  // 実機のバイト数をそのままStackType_tの個数にする(pthreadの最小スタックを下回らないように)
+  uint32_t depth = stack_depth < configMINIMAL_STACK_SIZE ? configMINIMAL_STACK_SIZE : stack_depth;
+  BaseType_t ret = xTaskCreate(fn, name, depth, arg, priority, &task);
+  if (ret == pdPASS) {
+    set_affinity(task, core_id);
+  }
+  if (handle) {
+    *handle = task;
+  }
+  return ret;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, const uint32_t stack_depth,
+  void *arg, UBaseType_t priority, StackType_t *stack, StaticTask_t *tcb, const BaseType_t core_id){
+  TaskHandle_t task;
+  if (stack_depth < configMINIMAL_STACK_SIZE) {
+    // 渡されたスタックではpthreadが作れないので、ヒープから確保する
+    printf("sim: %s: static stack too small on host, allocated from heap\n", name);
+    if (xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, &task, core_id) != pdPASS) {
+      return NULL;
+    }
+    return task;
+  }
+  task = xTaskCreateStatic(fn, name, stack_depth, arg, priority, stack, tcb);
+  if (task) {
+    set_affinity(task, core_id);
+  }
+  return task;
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCPU(UBaseType_t cpu){
+  // アイドルタスクは1つしかないので、PRO_CPUのものとして返す
+  return cpu == PRO_CPU_NUM ? xTaskGetIdleTaskHandle() : NULL;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandleForCPU(BaseType_t cpu){
+  return cpu == sim_core_id() ? xTaskGetCurrentTaskHandle() : NULL;
+}
+
+//------------------------
+// タスクウォッチドッグ
+//------------------------
+#define WDT_MAX_ENTRIES 16
+
+typedef struct esp_task_wdt_user_handle_s {
+  bool in_use;
+  TaskHandle_t task;      // ユーザならNULL
+  char name[16];
+  int64_t last_reset_us;
+} wdt_entry_t;
+
+static struct {
+  bool initialized;
+  uint32_t timeout_ms;
+  bool trigger_panic;
+  wdt_entry_t entries[WDT_MAX_ENTRIES];
+} wdt = {
+  // 実機ではIDFが起動時に初期化している(CONFIG_ESP_TASK_WDT_INIT)
+  .initialized = true,
+  .timeout_ms = CONFIG_ESP_TASK_WDT_TIMEOUT_S * 1000,
+};
+
+static wdt_entry_t *wdt_find_task(TaskHandle_t task){
+  for (int i = 0; i < WDT_MAX_ENTRIES; i++) {
+    if (wdt.entries[i].in_use && wdt.entries[i].task == task && task != NULL) {
+      return &wdt.entries[i];
+    }
+  }
+  return NULL;
+}
+
+static wdt_entry_t *wdt_alloc(void){
+  for (int i = 0; i < WDT_MAX_ENTRIES; i++) {
+    if (!wdt.entries[i].in_use) {
+      memset(&wdt.entries[i], 0, sizeof(wdt_entry_t));
+      wdt.entries[i].in_use = true;
+      wdt.entries[i].last_reset_us = sim_now_us();
+      return &wdt.entries[i];
+    }
+  }
+  return NULL;
+}
+
+esp_err_t esp_task_wdt_init(const esp_task_wdt_config_t *config){
+  if (config == NULL || config->timeout_ms == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  if (wdt.initialized) {
+    sim_unlock();
+    return ESP_ERR_INVALID_STATE;
+  }
+  wdt.initialized = true;
+  wdt.timeout_ms = config->timeout_ms;
+  wdt.trigger_panic = config->trigger_panic;
+  sim_unlock();
+  return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_reconfigure(const esp_task_wdt_config_t *config){
+  if (config == NULL || config->timeout_ms == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  wdt.timeout_ms = config->timeout_ms;
+  wdt.trigger_panic = config->trigger_panic;
+  sim_unlock();
+  return wdt.initialized ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_task_wdt_deinit(void){
+  sim_lock();
+  for (int i = 0; i < WDT_MAX_ENTRIES; i++) {
+    if (wdt.entries[i].in_use) {
+      sim_unlock();
+      return ESP_ERR_INVALID_STATE;
+    }
+  }
+  bool was = wdt.initialized;
+  wdt.initialized = false;
+  sim_unlock();
+  return was ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_task_wdt_add(TaskHandle_t task_handle){
+  if (task_handle == NULL) {
+    task_handle = xTaskGetCurrentTaskHandle();
+  }
+  sim_lock();
+  if (!wdt.initialized) {
+    sim_unlock();
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (wdt_find_task(task_handle)) {
+    sim_unlock();
+    return ESP_ERR_INVALID_ARG;
+  }
+  wdt_entry_t *e = wdt_alloc();
+  if (e) {
+    e->task = task_handle;
+    strncpy(e->name, pcTaskGetName(task_handle), sizeof(e->name) - 1);
+  }
+  sim_unlock();
+  return e ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_task_wdt_add_user(const char *user_name, esp_task_wdt_user_handle_t *user_handle_ret){
+  if (user_name == NULL || user_handle_ret == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  if (!wdt.initialized) {
+    sim_unlock();
+    return ESP_ERR_INVALID_STATE;
+  }
+  wdt_entry_t *e = wdt_alloc();
+  if (e) {
+    strncpy(e->name, user_name, sizeof(e->name) - 1);
+    *user_handle_ret = e;
+  }
+  sim_unlock();
+  return e ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_task_wdt_reset(void){
+  sim_lock();
+  wdt_entry_t *e = wdt_find_task(xTaskGetCurrentTaskHandle());
+  if (e) {
+    e->last_reset_us = sim_now_us();
+  }
+  sim_unlock();
+  return e ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_task_wdt_reset_user(esp_task_wdt_user_handle_t user_handle){
+  if (user_handle == NULL || !user_handle->in_use) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  user_handle->last_reset_us = sim_now_us();
+  sim_unlock();
+  return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_delete(TaskHandle_t task_handle){
+  if (task_handle == NULL) {
+    task_handle = xTaskGetCurrentTaskHandle();
+  }
+  sim_lock();
+  wdt_entry_t *e = wdt_find_task(task_handle);
+  if (e) {
+    e->in_use = false;
+  }
+  sim_unlock();
+  return e ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_task_wdt_delete_user(esp_task_wdt_user_handle_t user_handle){
+  if (user_handle == NULL || !user_handle->in_use) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  user_handle->in_use = false;
+  sim_unlock();
+  return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_status(TaskHandle_t task_handle){
+  if (task_handle == NULL) {
+    task_handle = xTaskGetCurrentTaskHandle();
+  }
+  return wdt_find_task(task_handle) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+// sim_isrタスクからTick毎に呼ばれる
+void sim_wdt_check(int64_t now_us){
+  if (!wdt.initialized) {
+    return;
+  }
+  int64_t timeout_us = (int64_t)wdt.timeout_ms * 1000;
+  bool triggered = false;
+  for (int i = 0; i < WDT_MAX_ENTRIES; i++) {
+    wdt_entry_t *e = &wdt.entries[i];
+    if (!e->in_use || now_us - e->last_reset_us < timeout_us) {
+      continue;
+    }
+    if (!triggered) {
+      ESP_LOGE("task_wdt", "Task watchdog got triggered. The following tasks/users did not reset the watchdog in time:");
+      triggered = true;
+    }
+    ESP_LOGE("task_wdt", " - %s (CPU %d)", e->name, e->task ? (int)xTaskGetAffinity(e->task) : -1);
+    sim_trace(SIM_TRACE_WDT, e->name, (int32_t)((now_us - e->last_reset_us) / 1000));
+    // 実機と同じく次のタイムアウトまで再通知しない
+    e->last_reset_us = now_us;
+  }
+  if (triggered && wdt.trigger_panic) {
+    printf("sim: task watchdog panic\n");
+    sim_finish(1);
+  }
+}
+
+//------------------------
+// ヒープ(FreeRTOSのheap_4、PSRAMはない)
+//------------------------
+size_t heap_caps_get_free_size(uint32_t caps){
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : xPortGetFreeHeapSize();
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps){
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : xPortGetMinimumEverFreeHeapSize();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps){
+  if (caps & MALLOC_CAP_SPIRAM) {
+    return 0;
+  }
+  HeapStats_t stats;
+  vPortGetHeapStats(&stats);
+  return stats.xSizeOfLargestFreeBlockInBytes;
+}
+
+size_t heap_caps_get_total_size(uint32_t caps){
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : configTOTAL_HEAP_SIZE;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps){
+  return (caps & MALLOC_CAP_SPIRAM) ? NULL : pvPortMalloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps){
+  void *p = heap_caps_malloc(n * size, caps);
+  if (p) {
+    memset(p, 0, n * size);
+  }
+  return p;
+}
+
+void heap_caps_free(void *ptr){
+  vPortFree(ptr);
+}
+
+//------------------------
+// スリープ
+//------------------------
+static uint64_t sleep_wakeup_us = 0;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us){
+  sleep_wakeup_us = time_in_us;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup(void){
+  return ESP_OK;
+}
+
+esp_err_t esp_light_sleep_start(void){
+  vTaskDelay(pdMS_TO_TICKS(sleep_wakeup_us / 1000));
+  return ESP_OK;
+}
+
+//------------------------
+// フック
+//------------------------
+#define MAX_HOOKS 8
+
+static esp_freertos_tick_cb_t tick_hooks[MAX_HOOKS];
+static esp_freertos_idle_cb_t idle_hooks[MAX_HOOKS];
+
+esp_err_t esp_register_freertos_tick_hook_for_cpu(esp_freertos_tick_cb_t new_tick_cb, unsigned int cpuid){
+  if (cpuid >= portNUM_PROCESSORS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < MAX_HOOKS; i++) {
+    if (tick_hooks[i] == NULL) {
+      tick_hooks[i] = new_tick_cb;
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_register_freertos_tick_hook(esp_freertos_tick_cb_t new_tick_cb){
+  return esp_register_freertos_tick_hook_for_cpu(new_tick_cb, 0);
+}
+
+esp_err_t esp_register_freertos_idle_hook_for_cpu(esp_freertos_idle_cb_t new_idle_cb, unsigned int cpuid){
+  if (cpuid >= portNUM_PROCESSORS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < MAX_HOOKS; i++) {
+    if (idle_hooks[i] == NULL) {
+      idle_hooks[i] = new_idle_cb;
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_register_freertos_idle_hook(esp_freertos_idle_cb_t new_idle_cb){
+  return esp_register_freertos_idle_hook_for_cpu(new_idle_cb, 0);
+}
+
+void esp_deregister_freertos_tick_hook(esp_freertos_tick_cb_t old_tick_cb){
+  for (int i = 0; i < MAX_HOOKS; i++) {
+    if (tick_hooks[i] == old_tick_cb) {
+      tick_hooks[i] = NULL;
+    }
+  }
+}
+
+void esp_deregister_freertos_idle_hook(esp_freertos_idle_cb_t old_idle_cb){
+  for (int i = 0; i < MAX_HOOKS; i++) {
+    if (idle_hooks[i] == old_idle_cb) {
+      idle_hooks[i] = NULL;
+    }
+  }
+}
+
+void vApplicationTickHook(void){
+  sim_tick_hook_run();
+  for (int i = 0; i < MAX_HOOKS; i++) {
+    if (tick_hooks[i]) {
+      tick_hooks[i]();
+    }
+  }
+}
+
+void vApplicationIdleHook(void){
+  for (int i = 0; i < MAX_HOOKS; i++) {
+    if (idle_hooks[i]) {
+      idle_hooks[i]();
+    }
+  }
+}
+
+void vApplicationMallocFailedHook(void){
+  printf("sim: pvPortMalloc failed\n");
+  sim_finish(1);
+}
+
+void vAssertCalled(const char *file, unsigned long line){
+  printf("sim: assert failed at %s:%lu\n", file, line);
+  fflush(stdout);
+  abort();
+}
+
+// configSUPPORT_STATIC_ALLOCATIONのときに必要
+void vApplicationGetIdleTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_size){
+  static StaticTask_t idle_tcb;
+  static StackType_t idle_stack[configMINIMAL_STACK_SIZE];
+  *tcb = &idle_tcb;
+  *stack = idle_stack;
+  *stack_size = configMINIMAL_STACK_SIZE;
+}
+
+void vApplicationGetTimerTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_size){
+  static StaticTask_t timer_tcb;
+  static StackType_t timer_stack[configTIMER_TASK_STACK_DEPTH];
+  *tcb = &timer_tcb;
+  *stack = timer_stack;
+  *stack_size = configTIMER_TASK_STACK_DEPTH;
+}
@@ -0,0 +1,266 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "sim_internal.h"
+
+// GPIO
+// 入力はsim_gpio_drive()(スティミュラス)、出力はgpio_set_level()で変化する
+// INPUT_OUTPUTのピンは出力した値がそのまま入力に見える(実機の自己ループと同じ)
+
+#define MAX_LISTENERS 4
+
+typedef struct {
+  gpio_mode_t mode;
+  gpio_int_type_t intr_type;
+  bool intr_enabled;
+  bool pull_up;
+  int level;            // ピンのレベル
+  int out;              // 出力レジスタ
+  gpio_isr_t handler;
+  void *arg;
+  char name[8];
+} sim_pin_t;
+
+static sim_pin_t pins[GPIO_PIN_COUNT];
+static bool isr_service = false;
+static int isr_service_core = PRO_CPU_NUM;   // サービスをインストールしたコア(実機と同じく割込みはそのコアで動く)
+static struct {
+  sim_gpio_listener_t fn;
+  void *arg;
+} listeners[MAX_LISTENERS];
+
+static bool valid(int num){
+  return num >= 0 && num < GPIO_PIN_COUNT;
+}
+
+static sim_pin_t *pin(int num){
+  sim_pin_t *p = &pins[num];
+  if (p->name[0] == '\0') {
+    snprintf(p->name, sizeof(p->name), "gpio%d", num);
+  }
+  return p;
+}
+
+typedef struct {
+  gpio_isr_t handler;
+  void *arg;
+} gpio_isr_call_t;
+
+static bool gpio_isr(void *arg){
+  gpio_isr_call_t *call = (gpio_isr_call_t *)arg;
+  // gpioのISRサービスはハンドラの後でportYIELD_FROM_ISRする(ハンドラ側ではしない)
+  call->handler(call->arg);
+  return false;
+}
+
+static bool edge_matches(gpio_int_type_t type, int old_level, int level){
+  switch (type) {
+  case GPIO_INTR_POSEDGE: return old_level == 0 && level == 1;
+  case GPIO_INTR_NEGEDGE: return old_level == 1 && level == 0;
+  case GPIO_INTR_ANYEDGE: return old_level != level;
+  case GPIO_INTR_LOW_LEVEL: return level == 0;
+  case GPIO_INTR_HIGH_LEVEL: return level == 1;
+  default: return false;
+  }
+}
+
+// ピンのレベルを変える。入力が有効なら割込み、PCNT、リスナーに伝える
+static void apply(int num, int level){
+  sim_pin_t *p = pin(num);
+  int old_level = p->level;
+  if (old_level == level) {
+    return;
+  }
+  p->level = level;
+  sim_trace(SIM_TRACE_GPIO, p->name, level);
+  sim_pcnt_on_gpio(num, old_level, level);
+  for (int i = 0; i < MAX_LISTENERS; i++) {
+    if (listeners[i].fn) {
+      listeners[i].fn(num, level, listeners[i].arg);
+    }
+  }
+  if ((p->mode & GPIO_MODE_DEF_INPUT) && isr_service && p->handler && p->intr_enabled
+    && edge_matches(p->intr_type, old_level, level)) {
+    gpio_isr_call_t call = {.handler = p->handler, .arg = p->arg};
+    sim_isr_run_on(isr_service_core, p->name, gpio_isr, &call);
+  }
+}
+
+void sim_gpio_drive(int gpio_num, int level){
+  if (!valid(gpio_num)) {
+    return;
+  }
+  apply(gpio_num, level != 0);
+}
+
+int sim_gpio_output(int gpio_num){
+  return valid(gpio_num) ? pins[gpio_num].out : 0;
+}
+
+int sim_gpio_level(int gpio_num){
+  return valid(gpio_num) ? pins[gpio_num].level : 0;
+}
+
+bool sim_gpio_add_listener(sim_gpio_listener_t fn, void *arg){
+  for (int i = 0; i < MAX_LISTENERS; i++) {
+    if (listeners[i].fn == NULL) {
+      listeners[i].fn = fn;
+      listeners[i].arg = arg;
+      return true;
+    }
+  }
+  return false;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config){
+  if (config == NULL || config->pin_bit_mask == 0 || config->pin_bit_mask >= (1ULL << GPIO_PIN_COUNT)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < GPIO_PIN_COUNT; i++) {
+    if (!(config->pin_bit_mask & (1ULL << i))) {
+      continue;
+    }
+    sim_pin_t *p = pin(i);
+    p->mode = config->mode;
+    p->intr_type = config->intr_type;
+    p->intr_enabled = config->intr_type != GPIO_INTR_DISABLE;
+    p->pull_up = config->pull_up_en;
+    // 何も駆動していなければプルアップ/プルダウンのレベル
+    if (!(p->mode & GPIO_MODE_DEF_OUTPUT)) {
+      p->level = p->pull_up ? 1 : 0;
+    }
+  }
+  return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num){
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_pin_t *p = pin(gpio_num);
+  p->mode = GPIO_MODE_INPUT;
+  p->intr_type = GPIO_INTR_DISABLE;
+  p->intr_enabled = false;
+  p->pull_up = true;
+  p->handler = NULL;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode){
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pin(gpio_num)->mode = mode;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull){
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pin(gpio_num)->pull_up = pull == GPIO_PULLUP_ONLY || pull == GPIO_PULLUP_PULLDOWN;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level){
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_pin_t *p = pin(gpio_num);
+  p->out = level != 0;
+  // 出力が有効なときだけピンに出る
+  if (p->mode & GPIO_MODE_DEF_OUTPUT) {
+    apply(gpio_num, p->out);
+  }
+  return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num){
+  if (!valid(gpio_num)) {
+    return 0;
+  }
+  sim_pin_t *p = &pins[gpio_num];
+  // 入力が無効なら0(実機と同じ)
+  return (p->mode & GPIO_MODE_DEF_INPUT) ? p->level : 0;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type){
+  if (!valid(gpio_num) || intr_type >= GPIO_INTR_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_pin_t *p = pin(gpio_num);
+  p->intr_type = intr_type;
+  p->intr_enabled = intr_type != GPIO_INTR_DISABLE;
+  return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num){
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pin(gpio_num)->intr_enabled = true;
+  return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num){
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pin(gpio_num)->intr_enabled = false;
+  return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type){
+  if (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return gpio_set_intr_type(gpio_num, intr_type);
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t gpio_num){
+  return gpio_set_intr_type(gpio_num, GPIO_INTR_DISABLE);
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags){
+  if (isr_service) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  isr_service = true;
+  isr_service_core = sim_core_id();
+  return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void){
+  isr_service = false;
+  for (int i = 0; i < GPIO_PIN_COUNT; i++) {
+    pins[i].handler = NULL;
+  }
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args){
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!isr_service) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sim_lock();
+  sim_pin_t *p = pin(gpio_num);
+  p->handler = isr_handler;
+  p->arg = args;
+  sim_unlock();
+  return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num){
+  if (!valid(gpio_num)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!isr_service) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sim_lock();
+  pins[gpio_num].handler = NULL;
+  sim_unlock();
+  return ESP_OK;
+}
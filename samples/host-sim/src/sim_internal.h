@@ -0,0 +1,86 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "sim.h"
+
+// シミュレータ内部で共有するもの
+
+typedef enum {
+  SIM_CLOCK_TICK,   // Tick単位(1ms)の仮想時間だけを使う。実行毎に同じ結果になる
+  SIM_CLOCK_REAL,   // Tick内の経過時間を実時間で補間する。ベンチマーク用
+} sim_clock_mode_t;
+
+typedef struct {
+  const char *stimulus_path;
+  const char *trace_path;
+  int64_t duration_us;       // 0なら無制限
+  sim_clock_mode_t clock_mode;
+  uint32_t seed;
+} sim_options_t;
+
+extern sim_options_t sim_options;
+
+// シミュレータ内部の排他(スケジューラ開始前は何もしない)
+void sim_lock(void);
+void sim_unlock(void);
+bool sim_scheduler_running(void);
+
+// sim_clock.c
+void sim_clock_init(void);
+void sim_clock_start(void);
+void sim_tick_hook_run(void);
+int64_t sim_now_ns(void);
+
+// sim_trace.c
+bool sim_trace_open(const char *path);
+void sim_trace_flush(void);
+void sim_trace_close(void);
+
+// sim_stimulus.c
+bool sim_stimulus_load(const char *path);
+
+// 割込みを割り当てたコア(登録したタスクのコア)で実行する。ハンドラの中のxPortGetCoreID()はこのコアになる
+void sim_isr_run_on(int core, const char *source, sim_isr_fn_t fn, void *arg);
+int sim_isr_core(void);
+
+// sim_esp.c
+void sim_wdt_check(int64_t now_us);
+
+// sim_pm.c
+// ドライバが内部で持つ電源管理のロック(esp_pm_lock_type_t)。PCNTのグリッチフィルタなど
+void sim_pm_driver_lock(int type, int delta);
+void sim_random_seed(uint32_t seed);
+
+// カウンタ(gptimer、旧タイマ共通)
+// カウント値は開始時刻からの経過時間で計算し、アラームはイベントで発生させる
+typedef struct sim_counter {
+  const char *name;
+  uint32_t resolution_hz;
+  bool up;
+  bool running;
+  uint64_t base;          // start_usのときのカウント値
+  int64_t start_us;
+  bool alarm_en;
+  bool auto_reload;
+  uint64_t alarm;
+  uint64_t reload;
+  uint32_t gen;           // 再設定したら増やして、古いアラームイベントを無効にする
+  uint64_t alarm_count;   // 最後に発生したアラームのカウント値
+  bool (*on_alarm)(struct sim_counter *c); // 割込みコンテキストで呼ばれる
+  int isr_core;           // 割込みを登録したコア
+  void *owner;
+} sim_counter_t;
+
+void sim_counter_init(sim_counter_t *c, const char *name, uint32_t resolution_hz, bool up);
+uint64_t sim_counter_get(const sim_counter_t *c);
+void sim_counter_set(sim_counter_t *c, uint64_t value);
+void sim_counter_start(sim_counter_t *c);
+void sim_counter_stop(sim_counter_t *c);
+// アラーム設定を反映する(アラームイベントを入れ直す)
+void sim_counter_arm(sim_counter_t *c);
+
+// ピンのレベル(入力の有効/無効に関係なく)
+int sim_gpio_level(int gpio_num);
+// GPIOの変化をPCNTに伝える
+void sim_pcnt_on_gpio(int gpio_num, int old_level, int level);
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim_internal.h"
+
+// シミュレーションのエントリポイント
+// 実機と同じくmainタスクでapp_main()を呼ぶ
+//
+// > sim_prog12 --duration 5000 --stimulus ../stimulus/prog12.stim --trace trace.csv
+//   --duration <ms>     仮想時間で指定時間経ったら終了する(0なら無制限)
+//   --stimulus <file>   外部入力のシナリオ
+//   --trace <file>      トレース(CSV)の出力先
+//   --clock tick|real   tick: Tick単位の仮想時間(既定、結果が毎回同じ) real: Tick内を実時間で補間
+//   --seed <n>          esp_random()のシード
+
+void app_main(void);
+
+sim_options_t sim_options = {
+  .clock_mode = SIM_CLOCK_TICK,
+  .seed = 1,
+};
+
+static void usage(const char *prog){
+  printf("usage: %s [--duration ms] [--stimulus file] [--trace file] [--clock tick|real] [--seed n]\n", prog);
+  exit(2);
+}
+
+static void main_task(void *arg){
+  app_main();
+  vTaskDelete(NULL);
+}
+
+void sim_finish(int code){
+  // ここから先で他のタスクに切り替わらないように止めておく
+  if (sim_scheduler_running()) {
+    vTaskSuspendAll();
+  }
+  sim_trace_close();
+  printf("sim: finished at %lld us (exit %d)\n", (long long)sim_now_us(), code);
+  fflush(stdout);
+  _exit(code);
+}
+
+int main(int argc, char **argv){
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  for (int i = 1; i < argc; i++) {
+    const char *opt = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+    if (val == NULL) {
+      usage(argv[0]);
+    }
+    if (strcmp(opt, "--duration") == 0) {
+      sim_options.duration_us = atoll(val) * 1000;
+    } else if (strcmp(opt, "--stimulus") == 0) {
+      sim_options.stimulus_path = val;
+    } else if (strcmp(opt, "--trace") == 0) {
+      sim_options.trace_path = val;
+    } else if (strcmp(opt, "--clock") == 0) {
+      if (strcmp(val, "tick") == 0) {
+        sim_options.clock_mode = SIM_CLOCK_TICK;
+      } else if (strcmp(val, "real") == 0) {
+        sim_options.clock_mode = SIM_CLOCK_REAL;
+      } else {
+        usage(argv[0]);
+      }
+    } else if (strcmp(opt, "--seed") == 0) {
+      sim_options.seed = (uint32_t)strtoul(val, NULL, 0);
+    } else {
+      usage(argv[0]);
+    }
+    i++;
+  }
+
+  sim_clock_init();
+  sim_random_seed(sim_options.seed);
+  if (sim_options.trace_path && !sim_trace_open(sim_options.trace_path)) {
+    printf("sim: cannot open trace %s\n", sim_options.trace_path);
+    return 1;
+  }
+  if (sim_options.stimulus_path && !sim_stimulus_load(sim_options.stimulus_path)) {
+    return 1;
+  }
+  sim_clock_start();
+  // ESP-IDFのmainタスクと同じ優先度1、PRO_CPU
+  xTaskCreatePinnedToCore(main_task, "main", 8192, NULL, 1, NULL, PRO_CPU_NUM);
+  vTaskStartScheduler();
+  return 0;
+}
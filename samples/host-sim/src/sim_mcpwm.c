@@ -0,0 +1,861 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/mcpwm_prelude.h"
+#include "sim_internal.h"
+
+// MCPWM
+// 波形のエッジはGPIOに出さず、ジェネレータの設定とコンパレータの値から1周期分の波形(HIGHの区間)を組み立てて
+// 出力のデューティを計算する(sim_pwm_duty()、トレースのpwm)
+// アップ/ダウン/アップダウンのカウント、方向別のアクション、強制レベル、デッドタイムを反映する
+// タイマのon_full/on_emptyを登録した場合は周期毎にイベントで呼ぶ
+// update_cmp_on_tez/tepのコンパレータは、動作中に書いた値を次の周期の始めに反映する
+//
+// オペレータにジェネレータが2つあれば相補出力とみなして、次の値もトレースに出す
+//   pwm   op<N>_dead     片方がOFFになってからもう片方がONになるまでの最小時間[ns](デッドタイム)
+//   pwm   op<N>_overlap  1周期の中で両方HIGHの時間[ns](0でなければ貫通電流が流れる)
+//   event op<N>_unsync   周期の途中でコンパレータを更新した回数(update_cmp_on_tez/tepなしで動作中に書いた)
+
+#define MCPWM_MAX_OPERATORS  6
+#define MCPWM_MAX_COMPARATORS 12
+#define MCPWM_MAX_GENERATORS 12
+#define MCPWM_MAX_PULSES     8
+
+struct mcpwm_timer_t {
+  int group_id;
+  uint32_t resolution_hz;
+  uint32_t period_ticks;
+  mcpwm_timer_count_mode_t count_mode;
+  bool enabled;
+  bool running;
+  bool stop_at_next;   // START_STOP_EMPTY/FULLで次の周期で止める
+  uint32_t gen;
+  mcpwm_timer_event_callbacks_t cbs;
+  void *user_data;
+  char name[12];
+};
+
+struct mcpwm_oper_t {
+  int group_id;
+  struct mcpwm_timer_t *timer;
+  int32_t dead_ns;      // 最後にトレースした値、-1なら未計算
+  int32_t overlap_ns;
+  int32_t period_ns;    // 出力の1周期(アップダウンは往復)
+  int32_t unsync;
+  char name[8];
+};
+
+struct mcpwm_cmpr_t {
+  struct mcpwm_oper_t *oper;
+  uint32_t value;
+  bool sync_update;     // TEZ/TEPで更新する
+  bool has_pending;
+  uint32_t pending;     // 次の周期の始めに反映する値
+};
+
+struct mcpwm_gen_t {
+  struct mcpwm_oper_t *oper;
+  int gpio;
+  bool invert;
+  mcpwm_generator_action_t on_timer[2][2];   // [方向][EMPTY/FULL]
+  struct {
+    struct mcpwm_cmpr_t *cmpr;
+    mcpwm_generator_action_t action[2];      // [方向]
+  } on_compare[2];
+  int force_level;      // -1なら強制しない
+  struct mcpwm_gen_t *dead_src;              // デッドタイムの入力、NULLならデッドタイムなし
+  mcpwm_dead_time_config_t dead;
+  int duty;             // 最後に計算したデューティ[‰]
+  char name[8];
+};
+
+static struct mcpwm_oper_t *operators[MCPWM_MAX_OPERATORS];
+static struct mcpwm_cmpr_t *comparators[MCPWM_MAX_COMPARATORS];
+static struct mcpwm_gen_t *generators[MCPWM_MAX_GENERATORS];
+static int num_timers = 0;
+static int num_operators = 0;
+
+//------------------------
+// 波形
+//------------------------
+// 1周期(len tick)の中のHIGHの区間 [start, end)、startの順
+// startは0～len-1、endは周期をまたぐとlenを超える。len全体がHIGHなら[0, len)の1つだけ
+typedef struct {
+  uint64_t len;
+  int n;
+  uint64_t start[MCPWM_MAX_PULSES];
+  uint64_t end[MCPWM_MAX_PULSES];
+} pwm_wave_t;
+
+static void wave_const(pwm_wave_t *w, uint64_t len, int level){
+  w->len = len;
+  w->n = 0;
+  if (level) {
+    w->n = 1;
+    w->start[0] = 0;
+    w->end[0] = len;
+  }
+}
+
+static uint64_t wave_high(const pwm_wave_t *w){
+  uint64_t high = 0;
+  for (int i = 0; i < w->n; i++) {
+    high += w->end[i] - w->start[i];
+  }
+  return high;
+}
+
+static bool wave_is_const(const pwm_wave_t *w){
+  return w->n == 0 || wave_high(w) >= w->len;
+}
+
+static bool wave_level(const pwm_wave_t *w, uint64_t t){
+  for (int i = 0; i < w->n; i++) {
+    if ((w->start[i] <= t && t < w->end[i]) || (w->start[i] <= t + w->len && t + w->len < w->end[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// startの順に並べて、重なった区間(周期をまたぐものも)をまとめる
+static void wave_normalize(pwm_wave_t *w){
+  for (int i = 1; i < w->n; i++) {
+    for (int j = i; j > 0 && w->start[j - 1] > w->start[j]; j--) {
+      uint64_t s = w->start[j], e = w->end[j];
+      w->start[j] = w->start[j - 1];
+      w->end[j] = w->end[j - 1];
+      w->start[j - 1] = s;
+      w->end[j - 1] = e;
+    }
+  }
+  int n = 0;
+  for (int i = 0; i < w->n; i++) {
+    if (n > 0 && w->start[i] <= w->end[n - 1]) {
+      if (w->end[i] > w->end[n - 1]) {
+        w->end[n - 1] = w->end[i];
+      }
+      continue;
+    }
+    w->start[n] = w->start[i];
+    w->end[n] = w->end[i];
+    n++;
+  }
+  w->n = n;
+  // 最後の区間が周期をまたいで先頭の区間に届いたらまとめる
+  while (w->n > 1 && w->end[w->n - 1] >= w->start[0] + w->len) {
+    uint64_t end = w->end[0] + w->len;
+    if (end > w->end[w->n - 1]) {
+      w->end[w->n - 1] = end;
+    }
+    for (int i = 1; i < w->n; i++) {
+      w->start[i - 1] = w->start[i];
+      w->end[i - 1] = w->end[i];
+    }
+    w->n--;
+  }
+  if (w->n > 0 && w->end[w->n - 1] - w->start[w->n - 1] >= w->len) {
+    wave_const(w, w->len, 1);
+  }
+}
+
+static void wave_invert(pwm_wave_t *w){
+  if (w->n == 0 || wave_is_const(w)) {
+    wave_const(w, w->len, w->n == 0);
+    return;
+  }
+  pwm_wave_t in = *w;
+  w->n = 0;
+  for (int i = 0; i < in.n; i++) {
+    uint64_t s = in.end[i];
+    uint64_t e = i + 1 < in.n ? in.start[i + 1] : in.start[0] + in.len;
+    if (s >= in.len) {
+      s -= in.len;
+      e -= in.len;
+    }
+    w->start[w->n] = s;
+    w->end[w->n] = e;
+    w->n++;
+  }
+  wave_normalize(w);
+}
+
+// デッドタイム: 立ち上がりをpos、立ち下がりをneg遅らせる(消えたパルスは出さない)
+static void wave_dead_time(pwm_wave_t *w, const mcpwm_dead_time_config_t *config){
+  if (!wave_is_const(w)) {
+    int n = 0;
+    for (int i = 0; i < w->n; i++) {
+      uint64_t s = w->start[i] + config->posedge_delay_ticks;
+      uint64_t e = w->end[i] + config->negedge_delay_ticks;
+      if (e <= s) {
+        continue;
+      }
+      while (s >= w->len) {
+        s -= w->len;
+        e -= w->len;
+      }
+      w->start[n] = s;
+      w->end[n] = e;
+      n++;
+    }
+    w->n = n;
+    wave_normalize(w);
+  }
+  if (config->flags.invert_output) {
+    wave_invert(w);
+  }
+}
+
+static mcpwm_generator_action_t timer_action(const struct mcpwm_gen_t *g, mcpwm_timer_direction_t dir, mcpwm_timer_event_t ev){
+  mcpwm_generator_action_t action = g->on_timer[dir][ev];
+  if (action == MCPWM_GEN_ACTION_KEEP && g->oper->timer->count_mode == MCPWM_TIMER_COUNT_MODE_UP_DOWN) {
+    // アップダウンの折り返しはどちらの方向で登録しても同じ扱いにする
+    action = g->on_timer[!dir][ev];
+  }
+  return action;
+}
+
+// カウンタの最大値(コンパレータの範囲)
+// ESP-IDF v5のperiod_ticksは1周期の長さなので、アップダウンでは往復でperiod_ticks、折り返しはperiod_ticks/2
+static uint32_t peak_ticks(const struct mcpwm_timer_t *t){
+  return t->count_mode == MCPWM_TIMER_COUNT_MODE_UP_DOWN ? t->period_ticks / 2 : t->period_ticks;
+}
+
+// アクションだけで決まるジェネレータの出力(デッドタイムの前)
+static void calc_raw_wave(const struct mcpwm_gen_t *g, pwm_wave_t *w){
+  const struct mcpwm_timer_t *t = g->oper ? g->oper->timer : NULL;
+  uint64_t period = (t && peak_ticks(t)) ? peak_ticks(t) : 1;
+  uint64_t len = (t && t->count_mode == MCPWM_TIMER_COUNT_MODE_UP_DOWN) ? period * 2 : period;
+  if (g->force_level >= 0) {
+    wave_const(w, len, g->force_level);
+    return;
+  }
+  if (t == NULL || !t->running || peak_ticks(t) == 0 || t->count_mode == MCPWM_TIMER_COUNT_MODE_PAUSE) {
+    wave_const(w, len, 0);
+    return;
+  }
+
+  // 1周期のイベントを起きる順に並べる(同じ時刻は追加した順)
+  struct { uint64_t time; mcpwm_generator_action_t action; } ev[8];
+  int n = 0;
+#define ADD_EVENT(tm, act) do { ev[n].time = (tm); ev[n].action = (act); n++; } while (0)
+  switch (t->count_mode) {
+  case MCPWM_TIMER_COUNT_MODE_DOWN:
+    ADD_EVENT(0, timer_action(g, MCPWM_TIMER_DIRECTION_DOWN, MCPWM_TIMER_EVENT_FULL));
+    for (int i = 0; i < 2; i++) {
+      if (g->on_compare[i].cmpr) {
+        ADD_EVENT(period - g->on_compare[i].cmpr->value, g->on_compare[i].action[MCPWM_TIMER_DIRECTION_DOWN]);
+      }
+    }
+    ADD_EVENT(len, timer_action(g, MCPWM_TIMER_DIRECTION_DOWN, MCPWM_TIMER_EVENT_EMPTY));
+    break;
+  case MCPWM_TIMER_COUNT_MODE_UP_DOWN:
+    ADD_EVENT(0, timer_action(g, MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_EMPTY));
+    for (int i = 0; i < 2; i++) {
+      if (g->on_compare[i].cmpr) {
+        ADD_EVENT(g->on_compare[i].cmpr->value, g->on_compare[i].action[MCPWM_TIMER_DIRECTION_UP]);
+      }
+    }
+    ADD_EVENT(period, timer_action(g, MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_FULL));
+    for (int i = 0; i < 2; i++) {
+      if (g->on_compare[i].cmpr) {
+        ADD_EVENT(len - g->on_compare[i].cmpr->value, g->on_compare[i].action[MCPWM_TIMER_DIRECTION_DOWN]);
+      }
+    }
+    break;
+  default:
+    ADD_EVENT(0, timer_action(g, MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_EMPTY));
+    for (int i = 0; i < 2; i++) {
+      if (g->on_compare[i].cmpr) {
+        ADD_EVENT(g->on_compare[i].cmpr->value, g->on_compare[i].action[MCPWM_TIMER_DIRECTION_UP]);
+      }
+    }
+    ADD_EVENT(len, timer_action(g, MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_FULL));
+    break;
+  }
+#undef ADD_EVENT
+  for (int i = 1; i < n; i++) {
+    for (int j = i; j > 0 && ev[j - 1].time > ev[j].time; j--) {
+      uint64_t tm = ev[j].time;
+      mcpwm_generator_action_t act = ev[j].action;
+      ev[j] = ev[j - 1];
+      ev[j - 1].time = tm;
+      ev[j - 1].action = act;
+    }
+  }
+
+  // 1回目で周期の終わりのレベルを求めて、2回目はそのレベルから始める(定常状態の波形)
+  int level = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    uint64_t rise = 0;
+    w->len = len;
+    w->n = 0;
+    for (int i = 0; i < n; i++) {
+      int next = level;
+      switch (ev[i].action) {
+      case MCPWM_GEN_ACTION_LOW:    next = 0; break;
+      case MCPWM_GEN_ACTION_HIGH:   next = 1; break;
+      case MCPWM_GEN_ACTION_TOGGLE: next = !level; break;
+      default: break;
+      }
+      if (level && !next && ev[i].time > rise && w->n < MCPWM_MAX_PULSES) {
+        w->start[w->n] = rise;
+        w->end[w->n] = ev[i].time;
+        w->n++;
+      } else if (!level && next) {
+        rise = ev[i].time;
+      }
+      level = next;
+    }
+    if (level && rise < len && w->n < MCPWM_MAX_PULSES) {
+      w->start[w->n] = rise;
+      w->end[w->n] = len;
+      w->n++;
+    }
+  }
+  wave_normalize(w);
+}
+
+static void calc_wave(const struct mcpwm_gen_t *g, pwm_wave_t *w){
+  if (g->dead_src) {
+    calc_raw_wave(g->dead_src, w);
+    wave_dead_time(w, &g->dead);
+  } else {
+    calc_raw_wave(g, w);
+  }
+  if (g->invert) {
+    wave_invert(w);
+  }
+}
+
+static int32_t ticks_to_ns(const struct mcpwm_timer_t *t, uint64_t ticks){
+  return t ? (int32_t)(ticks * 1000000000ULL / t->resolution_hz) : 0;
+}
+
+// 相補出力の2つの波形から、デッドタイムの最小値と両方HIGHの時間を求める
+static void calc_pair(const pwm_wave_t *a, const pwm_wave_t *b, int64_t *dead_ticks, uint64_t *overlap_ticks){
+  // 両方の波形のエッジで1周期を区切って、区間毎の状態(bit0: a, bit1: b)を並べる
+  uint64_t edges[MCPWM_MAX_PULSES * 4 + 1];
+  int n = 0;
+  edges[n++] = 0;
+  const pwm_wave_t *waves[2] = {a, b};
+  for (int k = 0; k < 2; k++) {
+    for (int i = 0; i < waves[k]->n; i++) {
+      edges[n++] = waves[k]->start[i] % a->len;
+      edges[n++] = waves[k]->end[i] % a->len;
+    }
+  }
+  for (int i = 1; i < n; i++) {
+    for (int j = i; j > 0 && edges[j - 1] > edges[j]; j--) {
+      uint64_t e = edges[j];
+      edges[j] = edges[j - 1];
+      edges[j - 1] = e;
+    }
+  }
+  int state[MCPWM_MAX_PULSES * 4 + 1];
+  uint64_t width[MCPWM_MAX_PULSES * 4 + 1];
+  int m = 0;
+  for (int i = 0; i < n; i++) {
+    uint64_t next = i + 1 < n ? edges[i + 1] : a->len;
+    if (next == edges[i]) {
+      continue;
+    }
+    state[m] = wave_level(a, edges[i]) | (wave_level(b, edges[i]) << 1);
+    width[m] = next - edges[i];
+    m++;
+  }
+
+  *overlap_ticks = 0;
+  *dead_ticks = -1;
+  int first = -1;
+  for (int i = 0; i < m; i++) {
+    if (state[i] == 3) {
+      *overlap_ticks += width[i];
+    }
+    if (first < 0 && state[i] != 0) {
+      first = i;
+    }
+  }
+  if (first < 0) {
+    return;
+  }
+  // 片方だけONの区間から、もう片方だけONの区間に移るまでの両方OFFの時間
+  int prev = state[first];
+  uint64_t gap = 0;
+  for (int k = 1; k <= m; k++) {
+    int i = (first + k) % m;
+    if (state[i] == 0) {
+      gap += width[i];
+      continue;
+    }
+    if ((prev == 1 && state[i] == 2) || (prev == 2 && state[i] == 1)) {
+      if (*dead_ticks < 0 || (int64_t)gap < *dead_ticks) {
+        *dead_ticks = (int64_t)gap;
+      }
+    }
+    prev = state[i];
+    gap = 0;
+  }
+}
+
+static void update_oper(struct mcpwm_oper_t *o){
+  pwm_wave_t waves[2];
+  int num = 0;
+  for (int i = 0; i < MCPWM_MAX_GENERATORS; i++) {
+    struct mcpwm_gen_t *g = generators[i];
+    if (g == NULL || g->oper != o) {
+      continue;
+    }
+    pwm_wave_t w;
+    calc_wave(g, &w);
+    int duty = (int)(wave_high(&w) * 1000 / w.len);
+    if (duty != g->duty) {
+      g->duty = duty;
+      sim_trace(SIM_TRACE_PWM, g->name, duty);
+    }
+    if (num < 2) {
+      waves[num++] = w;
+    }
+  }
+  char name[20];
+  int32_t period_ns = num > 0 ? ticks_to_ns(o->timer, waves[0].len) : -1;
+  if (period_ns > 0 && period_ns != o->period_ns) {
+    o->period_ns = period_ns;
+    snprintf(name, sizeof(name), "%s_period", o->name);
+    sim_trace(SIM_TRACE_PWM, name, period_ns);
+  }
+  if (num < 2 || waves[0].len != waves[1].len) {
+    return;
+  }
+  int64_t dead_ticks;
+  uint64_t overlap_ticks;
+  calc_pair(&waves[0], &waves[1], &dead_ticks, &overlap_ticks);
+  // 片方が止まっている(エッジがない)間はデッドタイムを出さない
+  int32_t dead_ns = dead_ticks < 0 ? -1 : ticks_to_ns(o->timer, (uint64_t)dead_ticks);
+  if (dead_ns >= 0 && dead_ns != o->dead_ns) {
+    snprintf(name, sizeof(name), "%s_dead", o->name);
+    sim_trace(SIM_TRACE_PWM, name, dead_ns);
+  }
+  if (dead_ns >= 0) {
+    o->dead_ns = dead_ns;
+  }
+  int32_t overlap_ns = ticks_to_ns(o->timer, overlap_ticks);
+  if (overlap_ns != o->overlap_ns) {
+    o->overlap_ns = overlap_ns;
+    snprintf(name, sizeof(name), "%s_overlap", o->name);
+    sim_trace(SIM_TRACE_PWM, name, overlap_ns);
+  }
+}
+
+static void update_timer_generators(struct mcpwm_timer_t *t){
+  for (int i = 0; i < MCPWM_MAX_OPERATORS; i++) {
+    if (operators[i] && operators[i]->timer == t) {
+      update_oper(operators[i]);
+    }
+  }
+}
+
+static void update_duty(struct mcpwm_gen_t *g){
+  if (g->oper) {
+    update_oper(g->oper);
+  }
+}
+
+int sim_pwm_duty(int gpio_num){
+  for (int i = 0; i < MCPWM_MAX_GENERATORS; i++) {
+    if (generators[i] && generators[i]->gpio == gpio_num) {
+      return generators[i]->duty;
+    }
+  }
+  return -1;
+}
+
+//------------------------
+// タイマ
+//------------------------
+static int64_t period_us(const struct mcpwm_timer_t *t){
+  uint64_t ticks = t->count_mode == MCPWM_TIMER_COUNT_MODE_UP_DOWN ? (uint64_t)peak_ticks(t) * 2 : t->period_ticks;
+  int64_t us = (int64_t)(ticks * 1000000ULL / t->resolution_hz);
+  return us > 0 ? us : 1;
+}
+
+typedef struct {
+  struct mcpwm_timer_t *timer;
+  mcpwm_timer_event_cb_t cb;
+  mcpwm_timer_event_data_t edata;
+} mcpwm_isr_call_t;
+
+static bool mcpwm_isr(void *arg){
+  mcpwm_isr_call_t *call = (mcpwm_isr_call_t *)arg;
+  return call->cb(call->timer, &call->edata, call->timer->user_data);
+}
+
+// 周期の始め(TEZ)に、待たせていたコンパレータの値を反映する
+static void apply_pending_compare(struct mcpwm_timer_t *t){
+  bool changed = false;
+  sim_lock();
+  for (int i = 0; i < MCPWM_MAX_COMPARATORS; i++) {
+    struct mcpwm_cmpr_t *c = comparators[i];
+    if (c && c->has_pending && c->oper->timer == t) {
+      c->value = c->pending;
+      c->has_pending = false;
+      changed = true;
+    }
+  }
+  sim_unlock();
+  if (changed) {
+    update_timer_generators(t);
+  }
+}
+
+static void timer_period_event(void *arg, uint32_t gen){
+  struct mcpwm_timer_t *t = (struct mcpwm_timer_t *)arg;
+  if (gen != t->gen || !t->running) {
+    return;
+  }
+  // 周期の終わり: FULL(カウンタ最大)、続けてEMPTY(0に戻る)
+  if (t->cbs.on_full) {
+    mcpwm_isr_call_t call = {t, t->cbs.on_full, {peak_ticks(t), MCPWM_TIMER_DIRECTION_UP}};
+    sim_isr_run(t->name, mcpwm_isr, &call);
+  }
+  if (t->stop_at_next) {
+    t->running = false;
+    t->stop_at_next = false;
+    update_timer_generators(t);
+    if (t->cbs.on_stop) {
+      mcpwm_isr_call_t call = {t, t->cbs.on_stop, {0, MCPWM_TIMER_DIRECTION_UP}};
+      sim_isr_run(t->name, mcpwm_isr, &call);
+    }
+    return;
+  }
+  apply_pending_compare(t);
+  if (t->cbs.on_empty) {
+    mcpwm_isr_call_t call = {t, t->cbs.on_empty, {0, MCPWM_TIMER_DIRECTION_UP}};
+    sim_isr_run(t->name, mcpwm_isr, &call);
+  }
+  sim_schedule(sim_now_us() + period_us(t), timer_period_event, t, gen);
+}
+
+esp_err_t mcpwm_new_timer(const mcpwm_timer_config_t *config, mcpwm_timer_handle_t *ret_timer){
+  if (config == NULL || ret_timer == NULL || config->resolution_hz == 0 || config->period_ticks == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  struct mcpwm_timer_t *t = calloc(1, sizeof(struct mcpwm_timer_t));
+  if (t == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  t->group_id = config->group_id;
+  t->resolution_hz = config->resolution_hz;
+  t->period_ticks = config->period_ticks;
+  t->count_mode = config->count_mode;
+  snprintf(t->name, sizeof(t->name), "mcpwm%d_t%d", config->group_id, num_timers++);
+  *ret_timer = t;
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_del_timer(mcpwm_timer_handle_t timer){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  // 古いイベントが残っている可能性があるので解放しない
+  timer->gen++;
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_timer_set_period(mcpwm_timer_handle_t timer, uint32_t period_ticks){
+  if (timer == NULL || period_ticks == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  timer->period_ticks = period_ticks;
+  update_timer_generators(timer);
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_timer_enable(mcpwm_timer_handle_t timer){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->enabled = true;
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_timer_disable(mcpwm_timer_handle_t timer){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->enabled = false;
+  timer->running = false;
+  timer->gen++;
+  update_timer_generators(timer);
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_timer_start_stop(mcpwm_timer_handle_t timer, mcpwm_timer_start_stop_cmd_t command){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sim_lock();
+  switch (command) {
+  case MCPWM_TIMER_STOP_EMPTY:
+  case MCPWM_TIMER_STOP_FULL:
+    timer->stop_at_next = true;
+    break;
+  case MCPWM_TIMER_START_NO_STOP:
+  case MCPWM_TIMER_START_STOP_EMPTY:
+  case MCPWM_TIMER_START_STOP_FULL:
+    timer->stop_at_next = command != MCPWM_TIMER_START_NO_STOP;
+    if (!timer->running) {
+      timer->running = true;
+      timer->gen++;
+      sim_schedule(sim_now_us() + period_us(timer), timer_period_event, timer, timer->gen);
+    }
+    break;
+  }
+  sim_unlock();
+  update_timer_generators(timer);
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_timer_register_event_callbacks(mcpwm_timer_handle_t timer, const mcpwm_timer_event_callbacks_t *cbs, void *user_data){
+  if (timer == NULL || cbs == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->enabled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->cbs = *cbs;
+  timer->user_data = user_data;
+  return ESP_OK;
+}
+
+//------------------------
+// オペレータ、コンパレータ、ジェネレータ
+//------------------------
+esp_err_t mcpwm_new_operator(const mcpwm_operator_config_t *config, mcpwm_oper_handle_t *ret_oper){
+  if (config == NULL || ret_oper == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  struct mcpwm_oper_t *o = calloc(1, sizeof(struct mcpwm_oper_t));
+  if (o == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  o->group_id = config->group_id;
+  o->dead_ns = -1;
+  o->overlap_ns = -1;
+  o->period_ns = -1;
+  for (int i = 0; i < MCPWM_MAX_OPERATORS; i++) {
+    if (operators[i] == NULL) {
+      operators[i] = o;
+      snprintf(o->name, sizeof(o->name), "op%d", num_operators++);
+      *ret_oper = o;
+      return ESP_OK;
+    }
+  }
+  free(o);
+  return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mcpwm_del_operator(mcpwm_oper_handle_t oper){
+  if (oper == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < MCPWM_MAX_OPERATORS; i++) {
+    if (operators[i] == oper) {
+      operators[i] = NULL;
+    }
+  }
+  free(oper);
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_operator_connect_timer(mcpwm_oper_handle_t oper, mcpwm_timer_handle_t timer){
+  if (oper == NULL || timer == NULL || oper->group_id != timer->group_id) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  oper->timer = timer;
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_new_comparator(mcpwm_oper_handle_t oper, const mcpwm_comparator_config_t *config, mcpwm_cmpr_handle_t *ret_cmpr){
+  if (oper == NULL || config == NULL || ret_cmpr == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  struct mcpwm_cmpr_t *c = calloc(1, sizeof(struct mcpwm_cmpr_t));
+  if (c == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  c->oper = oper;
+  c->sync_update = config->flags.update_cmp_on_tez || config->flags.update_cmp_on_tep;
+  for (int i = 0; i < MCPWM_MAX_COMPARATORS; i++) {
+    if (comparators[i] == NULL) {
+      comparators[i] = c;
+      *ret_cmpr = c;
+      return ESP_OK;
+    }
+  }
+  free(c);
+  return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mcpwm_del_comparator(mcpwm_cmpr_handle_t cmpr){
+  if (cmpr == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < MCPWM_MAX_COMPARATORS; i++) {
+    if (comparators[i] == cmpr) {
+      comparators[i] = NULL;
+    }
+  }
+  free(cmpr);
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_comparator_set_compare_value(mcpwm_cmpr_handle_t cmpr, uint32_t cmp_ticks){
+  if (cmpr == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  struct mcpwm_timer_t *t = cmpr->oper->timer;
+  if (t && cmp_ticks > peak_ticks(t)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (t && t->running && cmpr->sync_update) {
+    // 割込みからも呼ばれるのでロックする(周期のイベントと同時に書き換えない)
+    sim_lock();
+    cmpr->pending = cmp_ticks;
+    cmpr->has_pending = true;
+    sim_unlock();
+    return ESP_OK;
+  }
+  cmpr->value = cmp_ticks;
+  cmpr->has_pending = false;
+  if (t && t->running) {
+    // すぐに反映されるので、周期の途中だと1周期だけ崩れた波形が出る
+    char name[20];
+    snprintf(name, sizeof(name), "%s_unsync", cmpr->oper->name);
+    sim_trace(SIM_TRACE_EVENT, name, ++cmpr->oper->unsync);
+  }
+  if (t) {
+    update_timer_generators(t);
+  }
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_new_generator(mcpwm_oper_handle_t oper, const mcpwm_generator_config_t *config, mcpwm_gen_handle_t *ret_gen){
+  if (oper == NULL || config == NULL || ret_gen == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < MCPWM_MAX_GENERATORS; i++) {
+    if (generators[i] != NULL) {
+      continue;
+    }
+    struct mcpwm_gen_t *g = calloc(1, sizeof(struct mcpwm_gen_t));
+    if (g == NULL) {
+      return ESP_ERR_NO_MEM;
+    }
+    g->oper = oper;
+    g->gpio = config->gen_gpio_num;
+    g->invert = config->flags.invert_pwm;
+    g->force_level = -1;
+    snprintf(g->name, sizeof(g->name), "gpio%d", g->gpio);
+    generators[i] = g;
+    *ret_gen = g;
+    return ESP_OK;
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mcpwm_del_generator(mcpwm_gen_handle_t gen){
+  if (gen == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < MCPWM_MAX_GENERATORS; i++) {
+    if (generators[i] == gen) {
+      generators[i] = NULL;
+    } else if (generators[i] && generators[i]->dead_src == gen) {
+      generators[i]->dead_src = NULL;
+    }
+  }
+  free(gen);
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_generator_set_force_level(mcpwm_gen_handle_t gen, int level, bool hold_on){
+  if (gen == NULL || level < -1 || level > 1) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  gen->force_level = level;
+  update_duty(gen);
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_generator_set_action_on_timer_event(mcpwm_gen_handle_t gen, mcpwm_gen_timer_event_action_t ev_act){
+  if (gen == NULL || ev_act.event == MCPWM_TIMER_EVENT_INVALID) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  gen->on_timer[ev_act.direction][ev_act.event] = ev_act.action;
+  update_duty(gen);
+  return ESP_OK;
+}
+
+esp_err_t mcpwm_generator_set_action_on_compare_event(mcpwm_gen_handle_t gen, mcpwm_gen_compare_event_action_t ev_act){
+  if (gen == NULL || ev_act.comparator == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < 2; i++) {
+    if (gen->on_compare[i].cmpr == NULL || gen->on_compare[i].cmpr == ev_act.comparator) {
+      gen->on_compare[i].cmpr = ev_act.comparator;
+      gen->on_compare[i].action[ev_act.direction] = ev_act.action;
+      update_duty(gen);
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mcpwm_generator_set_actions_on_timer_event(mcpwm_gen_handle_t gen, mcpwm_gen_timer_event_action_t ev_act, ...){
+  esp_err_t ret = ESP_OK;
+  va_list ap;
+  va_start(ap, ev_act);
+  while (ret == ESP_OK && ev_act.event != MCPWM_TIMER_EVENT_INVALID) {
+    ret = mcpwm_generator_set_action_on_timer_event(gen, ev_act);
+    ev_act = va_arg(ap, mcpwm_gen_timer_event_action_t);
+  }
+  va_end(ap);
+  return ret;
+}
+
+esp_err_t mcpwm_generator_set_actions_on_compare_event(mcpwm_gen_handle_t gen, mcpwm_gen_compare_event_action_t ev_act, ...){
+  esp_err_t ret = ESP_OK;
+  va_list ap;
+  va_start(ap, ev_act);
+  while (ret == ESP_OK && ev_act.comparator != NULL) {
+    ret = mcpwm_generator_set_action_on_compare_event(gen, ev_act);
+    ev_act = va_arg(ap, mcpwm_gen_compare_event_action_t);
+  }
+  va_end(ap);
+  return ret;
+}
+
+esp_err_t mcpwm_generator_set_dead_time(mcpwm_gen_handle_t in_generator, mcpwm_gen_handle_t out_generator, const mcpwm_dead_time_config_t *config){
+  if (in_generator == NULL || out_generator == NULL || config == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // 強制レベルはデッドタイムの前にかかる(入力側のジェネレータの強制レベルで決まる)
+  out_generator->dead_src = in_generator;
+  out_generator->dead = *config;
+  update_duty(out_generator);
+  return ESP_OK;
+}
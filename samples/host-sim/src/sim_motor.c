@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sim_internal.h"
+
+// DCモーターのモデル
+// MCPWMの出力デューティを電圧とみなし、1次遅れで回転数を変化させて
+// エンコーダのA/B相をGPIOに出す(PCNTやGPIO割込みでそのまま読める)
+//
+//   d(rpm)/dt = (max_rpm * (duty - load) - rpm) / tau
+//
+// dutyは pwm_gpio のデューティ - pwm_rev_gpio のデューティ(Hブリッジの2レッグ、なければ0)
+// loadは負荷トルクを停動トルクに対する割合で表したもの(回転方向と逆にかかる)
+
+#define SIM_MOTOR_MAX        2
+#define SIM_MOTOR_STEP_US    100
+#define SIM_MOTOR_TRACE_US   10000
+
+typedef struct {
+  sim_motor_config_t config;
+  double rpm;
+  double position;      // エンコーダのカウント(小数部を持つ)
+  int64_t count;        // 出力済みのカウント
+  int load_permille;
+  int64_t last_trace_us;
+  char name[16];
+} sim_motor_t;
+
+static sim_motor_t motors[SIM_MOTOR_MAX];
+static int num_motors = 0;
+
+// A/B相は1/4周期ずれる。正転: 00 -> 10 -> 11 -> 01 -> 00 (sim_stimulus.cのquadと同じ)
+static void output_count(const sim_motor_t *m, int64_t count){
+  static const uint8_t seq[4] = {0x0, 0x2, 0x3, 0x1};
+  uint8_t ab = seq[count & 3];
+  sim_gpio_drive(m->config.enc_a, (ab >> 1) & 1);
+  sim_gpio_drive(m->config.enc_b, ab & 1);
+}
+
+static double duty_of(int gpio){
+  if (gpio < 0) {
+    return 0;
+  }
+  int duty = sim_pwm_duty(gpio);
+  return duty < 0 ? 0 : duty / 1000.0;
+}
+
+static void motor_step(void *arg, uint32_t tag){
+  sim_motor_t *m = (sim_motor_t *)arg;
+  const sim_motor_config_t *c = &m->config;
+  double dt = SIM_MOTOR_STEP_US / 1000000.0;
+  double duty = duty_of(c->pwm_gpio) - duty_of(c->pwm_rev_gpio);
+  double load = m->load_permille / 1000.0;
+  // 負荷は回っている向きと逆、止まっているときは駆動の向きと逆(動き出せなければ止まったまま)
+  double dir = m->rpm > 1 ? 1 : m->rpm < -1 ? -1 : (duty > 0 ? 1 : duty < 0 ? -1 : 0);
+  double drive = duty - dir * load;
+  if (dir != 0 && m->rpm > -1 && m->rpm < 1 && drive * dir < 0) {
+    drive = 0;
+  }
+  m->rpm += (c->max_rpm * drive - m->rpm) * dt / (c->tau_ms / 1000.0);
+  m->position += m->rpm / 60.0 * c->cpr * dt;
+
+  // 1カウントずつA/B相を進める
+  int64_t target = (int64_t)(m->position >= 0 ? m->position : m->position - 1);
+  while (m->count != target) {
+    m->count += m->count < target ? 1 : -1;
+    output_count(m, m->count);
+  }
+
+  int64_t now = sim_now_us();
+  if (now - m->last_trace_us >= SIM_MOTOR_TRACE_US) {
+    m->last_trace_us = now;
+    sim_trace(SIM_TRACE_EVENT, m->name, (int32_t)m->rpm);
+  }
+}
+
+int sim_motor_add(const sim_motor_config_t *config){
+  if (num_motors >= SIM_MOTOR_MAX || config->tau_ms <= 0 || config->cpr <= 0) {
+    return -1;
+  }
+  int id = num_motors++;
+  sim_motor_t *m = &motors[id];
+  memset(m, 0, sizeof(*m));
+  m->config = *config;
+  snprintf(m->name, sizeof(m->name), "motor%d_rpm", id);
+  output_count(m, 0);
+  sim_every(SIM_MOTOR_STEP_US, motor_step, m);
+  return id;
+}
+
+void sim_motor_set_load(int id, int permille){
+  if (id >= 0 && id < num_motors) {
+    motors[id].load_permille = permille;
+  }
+}
+
+int sim_motor_rpm(int id){
+  return (id >= 0 && id < num_motors) ? (int)motors[id].rpm : 0;
+}
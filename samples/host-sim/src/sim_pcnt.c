@@ -0,0 +1,356 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/pulse_cnt.h"
+#include "driver/gpio.h"
+#include "esp_pm.h"
+#include "sim_internal.h"
+
+// パルスカウンタ(PCNT)
+// GPIOのエッジ毎にチャネルの設定に従ってカウントする
+// グリッチフィルタは設定を受け付けるだけで、フィルタはしない
+// 実機と同じく、グリッチフィルタを使うユニットはenableの間ESP_PM_APB_FREQ_MAXのロックを持つ(ライトスリープしない)
+
+#define PCNT_MAX_WATCH_POINTS 8
+
+typedef enum {
+  PCNT_STATE_INIT,
+  PCNT_STATE_ENABLE,
+  PCNT_STATE_RUN,
+} pcnt_state_t;
+
+struct pcnt_chan_t {
+  struct pcnt_unit_t *unit;
+  int edge_gpio;
+  int level_gpio;
+  bool invert_edge;
+  bool invert_level;
+  pcnt_channel_edge_action_t pos_act;
+  pcnt_channel_edge_action_t neg_act;
+  pcnt_channel_level_action_t high_act;
+  pcnt_channel_level_action_t low_act;
+};
+
+struct pcnt_unit_t {
+  int id;
+  pcnt_state_t state;
+  int low_limit;
+  int high_limit;
+  bool accum_count;
+  bool glitch_filter;
+  int count;
+  int accum;            // accum_countのときに溢れた分
+  int watch[PCNT_MAX_WATCH_POINTS];
+  int num_watch;
+  pcnt_watch_cb_t on_reach;
+  void *user_data;
+  struct pcnt_chan_t *chans[SOC_PCNT_CHANNELS_PER_UNIT];
+  char name[8];
+};
+
+static struct pcnt_unit_t *units[SOC_PCNT_UNITS_PER_GROUP];
+
+typedef struct {
+  struct pcnt_unit_t *unit;
+  pcnt_watch_event_data_t edata;
+} pcnt_isr_call_t;
+
+static bool pcnt_isr(void *arg){
+  pcnt_isr_call_t *call = (pcnt_isr_call_t *)arg;
+  return call->unit->on_reach(call->unit, &call->edata, call->unit->user_data);
+}
+
+static void watch_event(struct pcnt_unit_t *u, int value, int prev){
+  if (u->on_reach == NULL) {
+    return;
+  }
+  for (int i = 0; i < u->num_watch; i++) {
+    if (u->watch[i] != value) {
+      continue;
+    }
+    pcnt_isr_call_t call = {
+      .unit = u,
+      .edata = {
+        .watch_point_value = value,
+        .zero_cross_mode = prev > 0 ? PCNT_UNIT_ZERO_CROSS_POS_ZERO : PCNT_UNIT_ZERO_CROSS_NEG_ZERO,
+      },
+    };
+    sim_isr_run(u->name, pcnt_isr, &call);
+    return;
+  }
+}
+
+static int edge_delta(const struct pcnt_chan_t *ch, bool rising, int level){
+  pcnt_channel_edge_action_t act = rising ? ch->pos_act : ch->neg_act;
+  int delta = act == PCNT_CHANNEL_EDGE_ACTION_INCREASE ? 1 : act == PCNT_CHANNEL_EDGE_ACTION_DECREASE ? -1 : 0;
+  if (ch->level_gpio >= 0) {
+    pcnt_channel_level_action_t lact = level ? ch->high_act : ch->low_act;
+    if (lact == PCNT_CHANNEL_LEVEL_ACTION_INVERSE) {
+      delta = -delta;
+    } else if (lact == PCNT_CHANNEL_LEVEL_ACTION_HOLD) {
+      delta = 0;
+    }
+  }
+  return delta;
+}
+
+void sim_pcnt_on_gpio(int gpio_num, int old_level, int level){
+  for (int i = 0; i < SOC_PCNT_UNITS_PER_GROUP; i++) {
+    struct pcnt_unit_t *u = units[i];
+    if (u == NULL || u->state != PCNT_STATE_RUN) {
+      continue;
+    }
+    for (int c = 0; c < SOC_PCNT_CHANNELS_PER_UNIT; c++) {
+      struct pcnt_chan_t *ch = u->chans[c];
+      if (ch == NULL || ch->edge_gpio != gpio_num) {
+        continue;
+      }
+      bool rising = (level != 0) != ch->invert_edge;
+      int ctrl = ch->level_gpio >= 0 ? (sim_gpio_level(ch->level_gpio) != ch->invert_level) : 1;
+      int delta = edge_delta(ch, rising, ctrl);
+      if (delta == 0) {
+        continue;
+      }
+      int prev = u->count;
+      u->count += delta;
+      watch_event(u, u->count, prev);
+      // 上限/下限に達したら0に戻る
+      if (u->count >= u->high_limit || u->count <= u->low_limit) {
+        if (u->accum_count) {
+          u->accum += u->count;
+        }
+        int reached = u->count;
+        u->count = 0;
+        watch_event(u, 0, reached);
+      }
+    }
+  }
+  (void)old_level;
+}
+
+esp_err_t pcnt_new_unit(const pcnt_unit_config_t *config, pcnt_unit_handle_t *ret_unit){
+  if (config == NULL || ret_unit == NULL || config->low_limit >= 0 || config->high_limit <= 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < SOC_PCNT_UNITS_PER_GROUP; i++) {
+    if (units[i] != NULL) {
+      continue;
+    }
+    struct pcnt_unit_t *u = calloc(1, sizeof(struct pcnt_unit_t));
+    if (u == NULL) {
+      return ESP_ERR_NO_MEM;
+    }
+    u->id = i;
+    u->low_limit = config->low_limit;
+    u->high_limit = config->high_limit;
+    u->accum_count = config->flags.accum_count;
+    snprintf(u->name, sizeof(u->name), "pcnt%d", i);
+    units[i] = u;
+    *ret_unit = u;
+    return ESP_OK;
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t pcnt_del_unit(pcnt_unit_handle_t unit){
+  if (unit == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (unit->state != PCNT_STATE_INIT) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  for (int c = 0; c < SOC_PCNT_CHANNELS_PER_UNIT; c++) {
+    if (unit->chans[c]) {
+      return ESP_ERR_INVALID_STATE;
+    }
+  }
+  units[unit->id] = NULL;
+  free(unit);
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_set_glitch_filter(pcnt_unit_handle_t unit, const pcnt_glitch_filter_config_t *config){
+  if (unit == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (unit->state != PCNT_STATE_INIT) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  unit->glitch_filter = config != NULL && config->max_glitch_ns > 0;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_enable(pcnt_unit_handle_t unit){
+  if (unit == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (unit->state != PCNT_STATE_INIT) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  unit->state = PCNT_STATE_ENABLE;
+  if (unit->glitch_filter) {
+    sim_pm_driver_lock(ESP_PM_APB_FREQ_MAX, 1);
+  }
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_disable(pcnt_unit_handle_t unit){
+  if (unit == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (unit->state != PCNT_STATE_ENABLE) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  unit->state = PCNT_STATE_INIT;
+  if (unit->glitch_filter) {
+    sim_pm_driver_lock(ESP_PM_APB_FREQ_MAX, -1);
+  }
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_start(pcnt_unit_handle_t unit){
+  if (unit == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (unit->state != PCNT_STATE_ENABLE) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  unit->state = PCNT_STATE_RUN;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_stop(pcnt_unit_handle_t unit){
+  if (unit == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (unit->state != PCNT_STATE_RUN) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  unit->state = PCNT_STATE_ENABLE;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_clear_count(pcnt_unit_handle_t unit){
+  if (unit == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  unit->count = 0;
+  unit->accum = 0;
+  sim_unlock();
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_get_count(pcnt_unit_handle_t unit, int *value){
+  if (unit == NULL || value == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  *value = unit->count + unit->accum;
+  sim_unlock();
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_register_event_callbacks(pcnt_unit_handle_t unit, const pcnt_event_callbacks_t *cbs, void *user_data){
+  if (unit == NULL || cbs == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (unit->state != PCNT_STATE_INIT) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  unit->on_reach = cbs->on_reach;
+  unit->user_data = user_data;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_add_watch_point(pcnt_unit_handle_t unit, int watch_point){
+  if (unit == NULL || watch_point < unit->low_limit || watch_point > unit->high_limit) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < unit->num_watch; i++) {
+    if (unit->watch[i] == watch_point) {
+      return ESP_ERR_INVALID_STATE;
+    }
+  }
+  if (unit->num_watch >= PCNT_MAX_WATCH_POINTS) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  unit->watch[unit->num_watch++] = watch_point;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_remove_watch_point(pcnt_unit_handle_t unit, int watch_point){
+  if (unit == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < unit->num_watch; i++) {
+    if (unit->watch[i] == watch_point) {
+      unit->watch[i] = unit->watch[--unit->num_watch];
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t pcnt_new_channel(pcnt_unit_handle_t unit, const pcnt_chan_config_t *config, pcnt_channel_handle_t *ret_chan){
+  if (unit == NULL || config == NULL || ret_chan == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int c = 0; c < SOC_PCNT_CHANNELS_PER_UNIT; c++) {
+    if (unit->chans[c] != NULL) {
+      continue;
+    }
+    struct pcnt_chan_t *ch = calloc(1, sizeof(struct pcnt_chan_t));
+    if (ch == NULL) {
+      return ESP_ERR_NO_MEM;
+    }
+    ch->unit = unit;
+    ch->edge_gpio = config->edge_gpio_num;
+    ch->level_gpio = config->level_gpio_num;
+    ch->invert_edge = config->flags.invert_edge_input;
+    ch->invert_level = config->flags.invert_level_input;
+    // 実機と同じくピンを入力にする(同じピンでGPIOの割込みやウェイクアップも使える)
+    gpio_mode_t mode = GPIO_MODE_INPUT | (config->flags.io_loop_back ? GPIO_MODE_OUTPUT : 0);
+    if (ch->edge_gpio >= 0) {
+      gpio_set_direction(ch->edge_gpio, mode);
+    }
+    if (ch->level_gpio >= 0) {
+      gpio_set_direction(ch->level_gpio, mode);
+    }
+    unit->chans[c] = ch;
+    *ret_chan = ch;
+    return ESP_OK;
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t pcnt_del_channel(pcnt_channel_handle_t chan){
+  if (chan == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int c = 0; c < SOC_PCNT_CHANNELS_PER_UNIT; c++) {
+    if (chan->unit->chans[c] == chan) {
+      chan->unit->chans[c] = NULL;
+    }
+  }
+  free(chan);
+  return ESP_OK;
+}
+
+esp_err_t pcnt_channel_set_edge_action(pcnt_channel_handle_t chan, pcnt_channel_edge_action_t pos_act, pcnt_channel_edge_action_t neg_act){
+  if (chan == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  chan->pos_act = pos_act;
+  chan->neg_act = neg_act;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_channel_set_level_action(pcnt_channel_handle_t chan, pcnt_channel_level_action_t high_act, pcnt_channel_level_action_t low_act){
+  if (chan == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  chan->high_act = high_act;
+  chan->low_act = low_act;
+  return ESP_OK;
+}
@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_pm.h"
+#include "sim_internal.h"
+
+// 電源管理
+// ロックの数からモードを決めてトレースに記録するだけ(周波数、スリープは変えない)
+
+#define PM_LOCK_TYPES 3
+
+struct esp_pm_lock {
+  esp_pm_lock_type_t type;
+  int count;
+  const char *name;
+};
+
+static bool configured = false;
+static bool light_sleep_enable = false;
+static int held[PM_LOCK_TYPES];
+static int mode = -1;
+
+static void update_mode(void){
+  int next;
+  if (held[ESP_PM_CPU_FREQ_MAX] > 0) {
+    next = 0;
+  } else if (held[ESP_PM_APB_FREQ_MAX] > 0) {
+    next = 1;
+  } else if (held[ESP_PM_NO_LIGHT_SLEEP] > 0 || !light_sleep_enable) {
+    next = 2;
+  } else {
+    next = 3;
+  }
+  if (configured && next != mode) {
+    mode = next;
+    sim_trace(SIM_TRACE_EVENT, "pm_mode", mode);
+  }
+}
+
+void sim_pm_driver_lock(int type, int delta){
+  sim_lock();
+  held[type] += delta;
+  update_mode();
+  sim_unlock();
+}
+
+esp_err_t esp_pm_configure(const void *vconfig){
+  const esp_pm_config_esp32s3_t *config = (const esp_pm_config_esp32s3_t *)vconfig;
+  if (config == NULL || config->min_freq_mhz > config->max_freq_mhz) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  configured = true;
+  light_sleep_enable = config->light_sleep_enable;
+  update_mode();
+  sim_unlock();
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle){
+  if (lock_type >= PM_LOCK_TYPES || out_handle == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  esp_pm_lock_handle_t lock = calloc(1, sizeof(*lock));
+  if (lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  lock->type = lock_type;
+  lock->name = name;
+  *out_handle = lock;
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle){
+  if (handle == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  handle->count++;
+  held[handle->type]++;
+  update_mode();
+  sim_unlock();
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle){
+  if (handle == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_lock();
+  if (handle->count == 0) {
+    sim_unlock();
+    return ESP_ERR_INVALID_STATE;
+  }
+  handle->count--;
+  held[handle->type]--;
+  update_mode();
+  sim_unlock();
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle){
+  if (handle == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (handle->count != 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  free(handle);
+  return ESP_OK;
+}
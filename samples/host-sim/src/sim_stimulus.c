@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "sim_internal.h"
+
+// スティミュラス(外部入力のシナリオ)
+// 1行1コマンド、#以降はコメント。時刻は開始からの絶対時刻で単位はus(ms, sを付けてもよい)
+//
+//   <時刻> gpio <番号> <0|1>                     GPIOを駆動する
+//   <時刻> pulse <番号> <周期us> <回数>           矩形波(立ち上がりから)、回数0なら終了まで
+//   <時刻> quad <A> <B> <周期us> <回数>           エンコーダのA/B相、回数が負なら逆回転
+//   <時刻> adc <unit> <ch> <raw>                 ADCの読み取り値
+//   <時刻> motor <PWM> <A> <B> <最高rpm> <時定数ms> <CPR> [逆転PWM]
+//                                               DCモーターを追加する(sim_motor.c)
+//   <時刻> load <‰> [モーター番号]                モーターの負荷トルク
+//   <時刻> replay <番号> <ファイル>                記録した波形を流す(ファイルの相対パスはスティミュラスのファイルから)
+//                                               1行に「時刻us レベル」(時刻は開始からの相対)、#以降はコメント
+//   <時刻> mark <名前> [値]                       トレースに印を付ける
+//   <時刻> end                                   シミュレーション終了
+
+typedef enum {
+  STIM_GPIO,
+  STIM_PULSE,
+  STIM_QUAD,
+  STIM_ADC,
+  STIM_MOTOR,
+  STIM_LOAD,
+  STIM_MARK,
+  STIM_REPLAY,
+  STIM_END,
+} stim_kind_t;
+
+typedef struct {
+  int64_t t_us;
+  int level;
+} replay_edge_t;
+
+typedef struct {
+  stim_kind_t kind;
+  int a;
+  int b;
+  int c;
+  uint32_t period_us;
+  int32_t count;          // 残り回数(エッジ単位)、負なら無限
+  int phase;
+  char name[16];
+  sim_motor_config_t motor;
+  replay_edge_t *edges;   // replay
+  int num_edges;
+  int64_t start_us;
+} stim_t;
+
+static int64_t parse_time(const char *s, bool *ok){
+  char *end;
+  double v = strtod(s, &end);
+  *ok = end != s;
+  if (strcmp(end, "ms") == 0) {
+    v *= 1000;
+  } else if (strcmp(end, "s") == 0) {
+    v *= 1000000;
+  } else if (*end != '\0' && strcmp(end, "us") != 0) {
+    *ok = false;
+  }
+  return (int64_t)v;
+}
+
+static void stim_event(void *arg, uint32_t tag){
+  stim_t *s = (stim_t *)arg;
+  switch (s->kind) {
+  case STIM_GPIO:
+    sim_gpio_drive(s->a, s->b);
+    break;
+  case STIM_PULSE:
+    // 半周期毎にトグルする
+    sim_gpio_drive(s->a, (s->phase & 1) == 0);
+    s->phase++;
+    if (s->count < 0 || --s->count > 0) {
+      sim_schedule(sim_now_us() + s->period_us / 2, stim_event, s, tag);
+    }
+    break;
+  case STIM_QUAD: {
+    // A/B相は1/4周期ずれる。正転: 00 -> 10 -> 11 -> 01 -> 00
+    static const uint8_t seq[4] = {0x2, 0x3, 0x1, 0x0};
+    int forward = s->c >= 0;
+    int p = forward ? (s->phase & 3) : ((6 - (s->phase & 3)) & 3);
+    sim_gpio_drive(s->a, (seq[p] >> 1) & 1);
+    sim_gpio_drive(s->b, seq[p] & 1);
+    s->phase++;
+    if (s->count < 0 || --s->count > 0) {
+      sim_schedule(sim_now_us() + s->period_us / 4, stim_event, s, tag);
+    }
+    break;
+  }
+  case STIM_ADC:
+    sim_adc_set(s->a, s->b, s->c);
+    break;
+  case STIM_MOTOR:
+    if (sim_motor_add(&s->motor) < 0) {
+      printf("sim: cannot add motor\n");
+    }
+    break;
+  case STIM_LOAD:
+    sim_motor_set_load(s->b, s->a);
+    break;
+  case STIM_MARK:
+    sim_trace(SIM_TRACE_EVENT, s->name, s->a);
+    break;
+  case STIM_REPLAY:
+    // 同じ時刻の行はまとめて出す
+    do {
+      sim_gpio_drive(s->a, s->edges[s->phase].level);
+      s->phase++;
+    } while (s->phase < s->num_edges && s->start_us + s->edges[s->phase].t_us <= sim_now_us());
+    if (s->phase < s->num_edges) {
+      sim_schedule(s->start_us + s->edges[s->phase].t_us, stim_event, s, tag);
+    }
+    break;
+  case STIM_END:
+    sim_finish(0);
+  }
+}
+
+// 波形のファイルを読む。時刻は増えていくこと
+static bool load_replay(const char *stim_path, const char *file, stim_t *s){
+  char path[512];
+  const char *slash = strrchr(stim_path, '/');
+  if (file[0] == '/' || slash == NULL) {
+    snprintf(path, sizeof(path), "%s", file);
+  } else {
+    snprintf(path, sizeof(path), "%.*s/%s", (int)(slash - stim_path), stim_path, file);
+  }
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    printf("sim: cannot open replay %s\n", path);
+    return false;
+  }
+  int capacity = 0;
+  char line[128];
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)) {
+    char *hash = strchr(line, '#');
+    if (hash) {
+      *hash = '\0';
+    }
+    long long t;
+    int level;
+    int n = sscanf(line, "%lld %d", &t, &level);
+    if (n <= 0) {
+      continue;
+    }
+    if (n != 2 || (s->num_edges > 0 && t < s->edges[s->num_edges - 1].t_us)) {
+      printf("sim: %s: invalid line\n", path);
+      ok = false;
+      break;
+    }
+    if (s->num_edges == capacity) {
+      capacity = capacity ? capacity * 2 : 256;
+      replay_edge_t *edges = realloc(s->edges, capacity * sizeof(replay_edge_t));
+      if (edges == NULL) {
+        ok = false;
+        break;
+      }
+      s->edges = edges;
+    }
+    s->edges[s->num_edges++] = (replay_edge_t){t, level != 0};
+  }
+  fclose(f);
+  if (ok && s->num_edges == 0) {
+    printf("sim: %s: no edges\n", path);
+    ok = false;
+  }
+  if (!ok) {
+    free(s->edges);
+  }
+  return ok;
+}
+
+bool sim_stimulus_load(const char *path){
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    printf("sim: cannot open stimulus %s\n", path);
+    return false;
+  }
+  char line[256];
+  int lineno = 0;
+  bool ok = true;
+  while (fgets(line, sizeof(line), f)) {
+    lineno++;
+    char *hash = strchr(line, '#');
+    if (hash) {
+      *hash = '\0';
+    }
+    char *argv[12];
+    int argc = 0;
+    for (char *tok = strtok(line, " \t\r\n"); tok && argc < 12; tok = strtok(NULL, " \t\r\n")) {
+      argv[argc++] = tok;
+    }
+    if (argc == 0) {
+      continue;
+    }
+    bool time_ok;
+    int64_t time_us = argc >= 2 ? parse_time(argv[0], &time_ok) : 0;
+    stim_t *s = calloc(1, sizeof(stim_t));
+    if (argc < 2 || !time_ok || s == NULL) {
+      free(s);
+      printf("sim: %s:%d: syntax error\n", path, lineno);
+      ok = false;
+      continue;
+    }
+    const char *cmd = argv[1];
+    int n = argc - 2;
+    char **args = &argv[2];
+    if (strcmp(cmd, "gpio") == 0 && n == 2) {
+      s->kind = STIM_GPIO;
+      s->a = atoi(args[0]);
+      s->b = atoi(args[1]) != 0;
+    } else if (strcmp(cmd, "pulse") == 0 && n == 3) {
+      s->kind = STIM_PULSE;
+      s->a = atoi(args[0]);
+      s->period_us = (uint32_t)atoi(args[1]);
+      s->count = atoi(args[2]) > 0 ? atoi(args[2]) * 2 : -1;
+    } else if (strcmp(cmd, "quad") == 0 && n == 4) {
+      s->kind = STIM_QUAD;
+      s->a = atoi(args[0]);
+      s->b = atoi(args[1]);
+      s->period_us = (uint32_t)atoi(args[2]);
+      s->c = atoi(args[3]);
+      s->count = s->c != 0 ? abs(s->c) * 4 : -1;
+    } else if (strcmp(cmd, "adc") == 0 && n == 3) {
+      s->kind = STIM_ADC;
+      s->a = atoi(args[0]);
+      s->b = atoi(args[1]);
+      s->c = atoi(args[2]);
+    } else if (strcmp(cmd, "motor") == 0 && (n == 6 || n == 7)) {
+      s->kind = STIM_MOTOR;
+      s->motor = (sim_motor_config_t){
+        .pwm_gpio = atoi(args[0]),
+        .pwm_rev_gpio = n == 7 ? atoi(args[6]) : -1,
+        .enc_a = atoi(args[1]),
+        .enc_b = atoi(args[2]),
+        .max_rpm = atoi(args[3]),
+        .tau_ms = atoi(args[4]),
+        .cpr = atoi(args[5]),
+      };
+    } else if (strcmp(cmd, "load") == 0 && (n == 1 || n == 2)) {
+      s->kind = STIM_LOAD;
+      s->a = atoi(args[0]);
+      s->b = n == 2 ? atoi(args[1]) : 0;
+    } else if (strcmp(cmd, "mark") == 0 && (n == 1 || n == 2)) {
+      s->kind = STIM_MARK;
+      strncpy(s->name, args[0], sizeof(s->name) - 1);
+      s->a = n == 2 ? atoi(args[1]) : 0;
+    } else if (strcmp(cmd, "replay") == 0 && n == 2) {
+      s->kind = STIM_REPLAY;
+      s->a = atoi(args[0]);
+      s->start_us = time_us;
+      if (!load_replay(path, args[1], s)) {
+        free(s);
+        ok = false;
+        continue;
+      }
+      time_us += s->edges[0].t_us;
+    } else if (strcmp(cmd, "end") == 0 && n == 0) {
+      s->kind = STIM_END;
+    } else {
+      printf("sim: %s:%d: unknown command %s\n", path, lineno, cmd);
+      free(s);
+      ok = false;
+      continue;
+    }
+    if ((s->kind == STIM_PULSE || s->kind == STIM_QUAD) && s->period_us < 4) {
+      printf("sim: %s:%d: period too short\n", path, lineno);
+      free(s);
+      ok = false;
+      continue;
+    }
+    sim_schedule(time_us, stim_event, s, 0);
+  }
+  fclose(f);
+  return ok;
+}
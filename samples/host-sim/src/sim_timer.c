@@ -0,0 +1,474 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gptimer.h"
+#include "driver/timer.h"
+#include "sim_internal.h"
+
+// タイマ(gptimerと旧タイマAPI)
+// カウント値はstartしてからの仮想時間で計算し、アラームは仮想時間のイベントで発生させる
+
+//------------------------
+// カウンタ共通
+//------------------------
+static int64_t ticks_to_us(const sim_counter_t *c, uint64_t ticks){
+  return (int64_t)((ticks * 1000000ULL + c->resolution_hz / 2) / c->resolution_hz);
+}
+
+void sim_counter_init(sim_counter_t *c, const char *name, uint32_t resolution_hz, bool up){
+  memset(c, 0, sizeof(*c));
+  c->name = name;
+  c->resolution_hz = resolution_hz ? resolution_hz : 1000000;
+  c->up = up;
+}
+
+uint64_t sim_counter_get(const sim_counter_t *c){
+  if (!c->running) {
+    return c->base;
+  }
+  uint64_t elapsed = (uint64_t)(sim_now_us() - c->start_us) * c->resolution_hz / 1000000;
+  return c->up ? c->base + elapsed : c->base - elapsed;
+}
+
+static void counter_fire(void *arg, uint32_t gen);
+
+static bool counter_isr(void *arg){
+  sim_counter_t *c = (sim_counter_t *)arg;
+  return c->on_alarm ? c->on_alarm(c) : false;
+}
+
+// 現在のカウント値からアラームまでの時間でイベントを入れる
+static void counter_schedule(sim_counter_t *c){
+  c->gen++;
+  if (!c->running || !c->alarm_en) {
+    return;
+  }
+  uint64_t now = sim_counter_get(c);
+  uint64_t ticks = 0;
+  // 既に過ぎていればすぐに発生する
+  if (c->up && c->alarm > now) {
+    ticks = c->alarm - now;
+  } else if (!c->up && c->alarm < now) {
+    ticks = now - c->alarm;
+  }
+  int64_t delay = ticks_to_us(c, ticks);
+  sim_schedule(sim_now_us() + (delay > 0 ? delay : 1), counter_fire, c, c->gen);
+}
+
+static void counter_fire(void *arg, uint32_t gen){
+  sim_counter_t *c = (sim_counter_t *)arg;
+  if (gen != c->gen || !c->running || !c->alarm_en) {
+    // 止めたか設定し直したアラーム
+    return;
+  }
+  c->alarm_count = c->alarm;
+  if (c->auto_reload) {
+    // ハードウェアがリロードしてからハンドラが呼ばれる
+    c->base = c->reload;
+    c->start_us = sim_now_us();
+    counter_schedule(c);
+  } else {
+    // 1回だけ。カウントは進み続ける
+    c->base = c->alarm;
+    c->start_us = sim_now_us();
+    c->gen++;
+  }
+  sim_isr_run_on(c->isr_core, c->name, counter_isr, c);
+}
+
+void sim_counter_set(sim_counter_t *c, uint64_t value){
+  sim_lock();
+  c->base = value;
+  c->start_us = sim_now_us();
+  counter_schedule(c);
+  sim_unlock();
+}
+
+void sim_counter_start(sim_counter_t *c){
+  sim_lock();
+  if (!c->running) {
+    c->running = true;
+    c->start_us = sim_now_us();
+    counter_schedule(c);
+  }
+  sim_unlock();
+}
+
+void sim_counter_stop(sim_counter_t *c){
+  sim_lock();
+  if (c->running) {
+    c->base = sim_counter_get(c);
+    c->running = false;
+    c->gen++;
+  }
+  sim_unlock();
+}
+
+void sim_counter_arm(sim_counter_t *c){
+  sim_lock();
+  if (c->running) {
+    // 現在のカウント値を確定してから入れ直す
+    c->base = sim_counter_get(c);
+    c->start_us = sim_now_us();
+  }
+  counter_schedule(c);
+  sim_unlock();
+}
+
+//------------------------
+// gptimer
+//------------------------
+typedef enum {
+  GPTIMER_STATE_INIT,
+  GPTIMER_STATE_ENABLE,
+} gptimer_state_t;
+
+struct gptimer_t {
+  sim_counter_t counter;
+  gptimer_state_t state;
+  gptimer_alarm_cb_t on_alarm;
+  void *user_data;
+  char name[12];
+};
+
+static int num_gptimers = 0;
+
+static bool gptimer_alarm(sim_counter_t *c){
+  gptimer_handle_t timer = (gptimer_handle_t)c->owner;
+  if (timer->on_alarm == NULL) {
+    return false;
+  }
+  gptimer_alarm_event_data_t edata = {
+    .count_value = c->alarm_count,
+    .alarm_value = c->alarm_count,
+  };
+  return timer->on_alarm(timer, &edata, timer->user_data);
+}
+
+esp_err_t gptimer_new_timer(const gptimer_config_t *config, gptimer_handle_t *ret_timer){
+  if (config == NULL || ret_timer == NULL || config->resolution_hz == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // ESP32-S3は2グループx2個
+  if (num_gptimers >= 4) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  gptimer_handle_t timer = calloc(1, sizeof(struct gptimer_t));
+  if (timer == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  snprintf(timer->name, sizeof(timer->name), "gptimer%d", num_gptimers++);
+  sim_counter_init(&timer->counter, timer->name, config->resolution_hz, config->direction == GPTIMER_COUNT_UP);
+  timer->counter.on_alarm = gptimer_alarm;
+  timer->counter.owner = timer;
+  *ret_timer = timer;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_del_timer(gptimer_handle_t timer){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->state != GPTIMER_STATE_INIT) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  // 古いアラームイベントが残っている可能性があるので解放しない
+  timer->counter.gen++;
+  num_gptimers--;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_set_raw_count(gptimer_handle_t timer, uint64_t value){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_counter_set(&timer->counter, value);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_get_raw_count(gptimer_handle_t timer, uint64_t *value){
+  if (timer == NULL || value == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *value = sim_counter_get(&timer->counter);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_register_event_callbacks(gptimer_handle_t timer, const gptimer_event_callbacks_t *cbs, void *user_data){
+  if (timer == NULL || cbs == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->state != GPTIMER_STATE_INIT) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->on_alarm = cbs->on_alarm;
+  timer->user_data = user_data;
+  // 割込みはコールバックを登録したときに、そのコアに割り当てられる
+  timer->counter.isr_core = sim_core_id();
+  return ESP_OK;
+}
+
+esp_err_t gptimer_set_alarm_action(gptimer_handle_t timer, const gptimer_alarm_config_t *config){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_counter_t *c = &timer->counter;
+  sim_lock();
+  if (config) {
+    c->alarm_en = true;
+    c->alarm = config->alarm_count;
+    c->reload = config->reload_count;
+    c->auto_reload = config->flags.auto_reload_on_alarm;
+  } else {
+    c->alarm_en = false;
+  }
+  sim_unlock();
+  sim_counter_arm(c);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_enable(gptimer_handle_t timer){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->state != GPTIMER_STATE_INIT) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->state = GPTIMER_STATE_ENABLE;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_disable(gptimer_handle_t timer){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->state != GPTIMER_STATE_ENABLE) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->state = GPTIMER_STATE_INIT;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_start(gptimer_handle_t timer){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->state != GPTIMER_STATE_ENABLE) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sim_counter_start(&timer->counter);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_stop(gptimer_handle_t timer){
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->state != GPTIMER_STATE_ENABLE) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sim_counter_stop(&timer->counter);
+  return ESP_OK;
+}
+
+//------------------------
+// 旧タイマAPI
+//------------------------
+typedef struct {
+  bool initialized;
+  bool intr_enabled;
+  sim_counter_t counter;
+  timer_isr_t isr;
+  void *arg;
+  char name[12];
+} legacy_timer_t;
+
+static legacy_timer_t legacy[TIMER_GROUP_MAX][TIMER_MAX];
+
+static legacy_timer_t *get_legacy(timer_group_t group_num, timer_idx_t timer_num){
+  if (group_num >= TIMER_GROUP_MAX || timer_num >= TIMER_MAX || !legacy[group_num][timer_num].initialized) {
+    return NULL;
+  }
+  return &legacy[group_num][timer_num];
+}
+
+static bool legacy_alarm(sim_counter_t *c){
+  legacy_timer_t *t = (legacy_timer_t *)c->owner;
+  if (!t->intr_enabled || t->isr == NULL) {
+    return false;
+  }
+  return t->isr(t->arg);
+}
+
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config){
+  if (group_num >= TIMER_GROUP_MAX || timer_num >= TIMER_MAX || config == NULL
+    || config->divider < 2 || config->divider > 65536) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  legacy_timer_t *t = &legacy[group_num][timer_num];
+  t->counter.gen++;
+  snprintf(t->name, sizeof(t->name), "timer%d_%d", group_num, timer_num);
+  sim_counter_init(&t->counter, t->name, APB_CLK_FREQ / config->divider, config->counter_dir == TIMER_COUNT_UP);
+  t->counter.alarm_en = config->alarm_en == TIMER_ALARM_EN;
+  t->counter.auto_reload = config->auto_reload == TIMER_AUTORELOAD_EN;
+  t->counter.on_alarm = legacy_alarm;
+  t->counter.owner = t;
+  t->initialized = true;
+  t->intr_enabled = false;
+  t->isr = NULL;
+  if (config->counter_en == TIMER_START) {
+    sim_counter_start(&t->counter);
+  }
+  return ESP_OK;
+}
+
+esp_err_t timer_deinit(timer_group_t group_num, timer_idx_t timer_num){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sim_counter_stop(&t->counter);
+  t->initialized = false;
+  return ESP_OK;
+}
+
+esp_err_t timer_get_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t *timer_val){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL || timer_val == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *timer_val = sim_counter_get(&t->counter);
+  return ESP_OK;
+}
+
+esp_err_t timer_get_counter_time_sec(timer_group_t group_num, timer_idx_t timer_num, double *time){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL || time == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *time = (double)sim_counter_get(&t->counter) / t->counter.resolution_hz;
+  return ESP_OK;
+}
+
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // 旧タイマはset_counter_valueの値がリロード値になる
+  t->counter.reload = load_val;
+  sim_counter_set(&t->counter, load_val);
+  return ESP_OK;
+}
+
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_counter_start(&t->counter);
+  return ESP_OK;
+}
+
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim_counter_stop(&t->counter);
+  return ESP_OK;
+}
+
+esp_err_t timer_set_auto_reload(timer_group_t group_num, timer_idx_t timer_num, timer_autoreload_t reload){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  t->counter.auto_reload = reload == TIMER_AUTORELOAD_EN;
+  return ESP_OK;
+}
+
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  t->counter.alarm = alarm_value;
+  sim_counter_arm(&t->counter);
+  return ESP_OK;
+}
+
+esp_err_t timer_get_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t *alarm_value){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL || alarm_value == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *alarm_value = t->counter.alarm;
+  return ESP_OK;
+}
+
+esp_err_t timer_set_alarm(timer_group_t group_num, timer_idx_t timer_num, timer_alarm_t alarm_en){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  t->counter.alarm_en = alarm_en == TIMER_ALARM_EN;
+  sim_counter_arm(&t->counter);
+  return ESP_OK;
+}
+
+esp_err_t timer_enable_intr(timer_group_t group_num, timer_idx_t timer_num){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  t->intr_enabled = true;
+  return ESP_OK;
+}
+
+esp_err_t timer_disable_intr(timer_group_t group_num, timer_idx_t timer_num){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  t->intr_enabled = false;
+  return ESP_OK;
+}
+
+esp_err_t sim_timer_isr_callback_add(timer_group_t group_num, timer_idx_t timer_num, void *isr_handler, void *arg, int intr_alloc_flags){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL || isr_handler == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // void(*)(void*)のハンドラが渡された場合、戻り値は不定(実機と同じ)
+  t->isr = (timer_isr_t)isr_handler;
+  t->arg = arg;
+  t->intr_enabled = true;
+  t->counter.isr_core = sim_core_id();
+  return ESP_OK;
+}
+
+esp_err_t timer_isr_callback_remove(timer_group_t group_num, timer_idx_t timer_num){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  if (t == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  t->isr = NULL;
+  return ESP_OK;
+}
+
+uint64_t timer_group_get_counter_value_in_isr(timer_group_t group_num, timer_idx_t timer_num){
+  legacy_timer_t *t = get_legacy(group_num, timer_num);
+  return t ? sim_counter_get(&t->counter) : 0;
+}
+
+void timer_group_set_alarm_value_in_isr(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_val){
+  timer_set_alarm_value(group_num, timer_num, alarm_val);
+}
+
+void timer_group_enable_alarm_in_isr(timer_group_t group_num, timer_idx_t timer_num){
+  timer_set_alarm(group_num, timer_num, TIMER_ALARM_EN);
+}
+
+void timer_group_clr_intr_status_in_isr(timer_group_t group_num, timer_idx_t timer_num){
+}
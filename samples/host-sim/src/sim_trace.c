@@ -0,0 +1,115 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim_internal.h"
+
+// トレース
+// 記録はタスク切り替え(シグナルハンドラ)からも呼ばれるので、リングバッファに入れるだけにして
+// ファイルへの書き出しはsim_isrタスクから定期的に行う
+// 出力はCSV: time_us,kind,name,value
+
+#define SIM_TRACE_BUF 65536
+#define SIM_TRACE_NAME_LEN 16
+
+typedef struct {
+  int64_t time_us;
+  int32_t value;
+  uint8_t kind;
+  char name[SIM_TRACE_NAME_LEN];
+} sim_trace_rec_t;
+
+static sim_trace_rec_t ring[SIM_TRACE_BUF];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+static uint32_t dropped = 0;
+static FILE *trace_file = NULL;
+
+static const char *kind_names[] = {
+  [SIM_TRACE_TASK] = "task",
+  [SIM_TRACE_ISR] = "isr",
+  [SIM_TRACE_GPIO] = "gpio",
+  [SIM_TRACE_PWM] = "pwm",
+  [SIM_TRACE_WDT] = "wdt",
+  [SIM_TRACE_EVENT] = "event",
+  [SIM_TRACE_MARK] = "mark",
+};
+
+bool sim_trace_enabled(void){
+  return trace_file != NULL;
+}
+
+bool sim_trace_open(const char *path){
+  trace_file = fopen(path, "w");
+  if (trace_file == NULL) {
+    return false;
+  }
+  fprintf(trace_file, "time_us,kind,name,value\n");
+  return true;
+}
+
+// 呼び出し元はクリティカルセクションかシグナルハンドラの中
+static void put(sim_trace_kind_t kind, const char *name, int32_t value){
+  if (head - tail >= SIM_TRACE_BUF) {
+    dropped++;
+    return;
+  }
+  sim_trace_rec_t *r = &ring[head % SIM_TRACE_BUF];
+  r->time_us = sim_now_us();
+  r->value = value;
+  r->kind = (uint8_t)kind;
+  strncpy(r->name, name ? name : "", SIM_TRACE_NAME_LEN - 1);
+  r->name[SIM_TRACE_NAME_LEN - 1] = '\0';
+  head++;
+}
+
+void sim_trace(sim_trace_kind_t kind, const char *name, int32_t value){
+  if (trace_file == NULL) {
+    return;
+  }
+  sim_lock();
+  put(kind, name, value);
+  sim_unlock();
+}
+
+// traceTASK_SWITCHED_IN()から呼ばれる(カーネルのクリティカルセクション内)
+void sim_trace_task_switched_in(void *tcb){
+  if (trace_file == NULL || tcb == NULL) {
+    return;
+  }
+  put(SIM_TRACE_TASK, pcTaskGetName((TaskHandle_t)tcb), (int32_t)uxTaskPriorityGetFromISR((TaskHandle_t)tcb));
+}
+
+void sim_trace_flush(void){
+  if (trace_file == NULL) {
+    return;
+  }
+  sim_trace_rec_t buf[256];
+  while (1) {
+    int n = 0;
+    sim_lock();
+    while (n < 256 && tail != head) {
+      buf[n++] = ring[tail % SIM_TRACE_BUF];
+      tail++;
+    }
+    sim_unlock();
+    if (n == 0) {
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      fprintf(trace_file, "%lld,%s,%s,%d\n", (long long)buf[i].time_us, kind_names[buf[i].kind], buf[i].name, buf[i].value);
+    }
+  }
+  fflush(trace_file);
+}
+
+void sim_trace_close(void){
+  if (trace_file == NULL) {
+    return;
+  }
+  sim_trace_flush();
+  if (dropped) {
+    printf("sim: trace dropped %u records\n", dropped);
+  }
+  fclose(trace_file);
+  trace_file = NULL;
+}
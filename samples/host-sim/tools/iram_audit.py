@@ -0,0 +1,525 @@
+import os
+import re
+import struct
+import subprocess
+import sys
+
+# 割込みから呼ばれるコードとデータの配置(IRAM/DRAM/フラッシュ)を調べる
+#
+# 割込みの入口(ISRとドライバのコールバック)をソースから見つけ、ELFの逆アセンブルから呼び出しを辿って、
+# フラッシュにある関数、フラッシュにある定数(文字列、テーブル)、タスクからしか呼べないAPIを報告する
+# フラッシュの書き込み中はキャッシュが止まるので、IRAMで動く割込みがフラッシュに触るとクラッシュし、
+# そうでない割込みもキャッシュミスで遅れる
+#
+# > python iram_audit.py --elf .pio/build/esp32s3box/firmware.elf --src src --sdkconfig sdkconfig.esp32s3box
+# > python iram_audit.py --host --elf build/sim_prog13 --src ../esp32-freertos-prog13-gptimer/src --sdkconfig ... --strict
+#
+#   --elf file       調べるELF(実機のfirmware.elf、--hostならhost-simの実行ファイル)
+#   --src dir        サンプルのsrc/(入口を探す、アプリの関数を見分ける)
+#   --sdkconfig file ドライバの *_ISR_IRAM_SAFE などを見る
+#   --root name      入口を追加する(関数ポインタ経由で呼ばれるものなど)
+#   --objdump path   既定は実機ならxtensa-esp32s3-elf-objdump、--hostならobjdump
+#   --fix file       修正案のリンカフラグメント(.lf)を書き出す
+#   --strict         警告(IRAMで動かない割込みのフラッシュ参照)も終了コード1にする
+#
+# 配置はシンボルのセクションで決める
+#   実機   : .iram0.* = IRAM、.dram0.* = DRAM、.flash.text/.flash.rodata = フラッシュ、絶対シンボル = ROM
+#   host-sim: IRAM_ATTR/DRAM_ATTRは.iram1.*/.dram1.*に置く(include/esp_attr.h)。それ以外の.text/.rodataはフラッシュ扱い
+#             ESP-IDFの関数はhost-simの実装なので中は辿らず、下のIDF_PLACEMENTで判断する
+# アプリの関数(src/に定義があるもの)だけを辿り、ESP-IDFの関数はそれ自身の配置だけを見る
+#
+# platformio.iniの extra_scripts = post:../host-sim/tools/iram_audit.py でビルド後に実行する
+# custom_iram_audit = strict ならエラーと警告で、report(既定)ならエラーだけでビルドを失敗にする
+
+# 割込みの入口の登録。(正規表現, ドライバ)。ドライバはIRAM_SAFEの判定に使う
+ROOT_PATTERNS = [
+    (re.compile(r"\.on_alarm\s*=\s*(\w+)"), "gptimer"),
+    (re.compile(r"\.on_(?:reach)\s*=\s*(\w+)"), "pcnt"),
+    (re.compile(r"\.on_(?:full|empty|stop|cap|brake_cbc|brake_ost|fault_enter|fault_exit)\s*=\s*(\w+)"), "mcpwm"),
+    (re.compile(r"gpio_isr_handler_add\s*\([^,]+,\s*(\w+)"), "gpio"),
+    (re.compile(r"timer_isr_callback_add\s*\([^,]+,[^,]+,\s*(\w+)"), "timer"),
+    (re.compile(r"esp_intr_alloc\s*\([^,]+,[^,]+,\s*(\w+)"), "intr"),
+]
+IRAM_ATTR_RE = re.compile(r"\bIRAM_ATTR\b[^;{]*?\b(\w+)\s*\(")
+FUNC_DEF_RE = re.compile(r"^[A-Za-z_][\w\s\*]*?\b(\w+)\s*\([^;]*\)\s*\{?\s*$")
+
+# ドライバの割込みがIRAMで動くか(動くならフラッシュ参照はクラッシュ、動かなければ遅れ)
+DRIVER_KCONFIG = {
+    "gptimer": "CONFIG_GPTIMER_ISR_IRAM_SAFE",
+    "pcnt": "CONFIG_PCNT_ISR_IRAM_SAFE",
+    "mcpwm": "CONFIG_MCPWM_ISR_IRAM_SAFE",
+}
+
+# ESP-IDF 5.0の既定の配置(--hostのときに使う)。値は "iram" "rom" "flash" またはKconfig名(=yならIRAM)
+IDF_PLACEMENT = [
+    (re.compile(r"^(x|v|ul|ux|pv|port|vPort|xPort)\w*FromISR$"), "iram"),
+    (re.compile(r"^(xTask|vTask|xQueue|uxQueue|xSemaphore|xEventGroup|xTimer|vPort|xPort|pvPort)\w*$"), "CONFIG_FREERTOS_PLACE_FUNCTIONS_INTO_FLASH!"),
+    (re.compile(r"^esp_rom_\w+$"), "rom"),
+    (re.compile(r"^(memcpy|memset|memmove|memcmp|strlen|strcmp|strcpy|strncpy|__\w+)$"), "rom"),
+    (re.compile(r"^esp_timer_get_time$"), "iram"),
+    # host-simでportENTER_CRITICAL_ISR、portYIELD_FROM_ISRなどのマクロが呼ぶ関数(実機ではインラインかIRAM)
+    (re.compile(r"^sim_((enter|exit)_critical\w*|yield_from_isr)$"), "iram"),
+    (re.compile(r"^esp_cpu_get_cycle_count$"), "iram"),
+    (re.compile(r"^timer_group_\w+_in_isr$"), "iram"),
+    (re.compile(r"^gpio_(set_level|intr_disable)$"), "CONFIG_GPIO_CTRL_FUNC_IN_IRAM"),
+    (re.compile(r"^gptimer_(set_raw_count|get_raw_count|set_alarm_action|start|stop)$"), "CONFIG_GPTIMER_CTRL_FUNC_IN_IRAM"),
+    (re.compile(r"^pcnt_unit_(get_count|clear_count|start|stop)$"), "CONFIG_PCNT_CTRL_FUNC_IN_IRAM"),
+    (re.compile(r"^mcpwm_(comparator_set_compare_value|timer_set_period)$"), "CONFIG_MCPWM_CTRL_FUNC_IN_IRAM"),
+    # それ以外のドライバの関数はフラッシュ
+    (re.compile(r"^(gpio|timer|pcnt|gptimer|mcpwm|adc)_\w+$"), "flash"),
+]
+
+# 割込みから呼んではいけないAPI(待つ、ロックを取る)
+TASK_ONLY = re.compile(
+    r"^(printf|puts|esp_log_write|esp_log_writev|malloc|free|calloc|realloc|vTaskDelay|vTaskDelayUntil"
+    r"|xQueueGenericSend|xQueueReceive|xQueueSemaphoreTake|xEventGroupWaitBits|xTaskGenericNotifyWait|ulTaskGenericNotifyTake)$")
+
+# 修正案
+FIX_HINTS = {
+    "gpio_get_level": "gpio_ll_get_level(&GPIO, gpio)(hal/gpio_ll.h、インライン)にする",
+    "printf": "割込みの外で出す(esp_rom_printf(DRAM_STR(...))なら可)",
+    "esp_log_write": "ESP_DRAM_LOGx/ESP_EARLY_LOGxにするか、割込みの外で出す",
+}
+
+SHN_ABS = 0xFFF1
+
+
+#------------------------
+# ELF
+#------------------------
+class Elf:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError("not an ELF file: %s" % path)
+        self.is64 = self.data[4] == 2
+        self.sections = self._sections()
+        self.symbols = self._symbols()
+
+    def _sections(self):
+        d = self.data
+        if self.is64:
+            shoff, = struct.unpack_from("<Q", d, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", d, 0x3A)
+        else:
+            shoff, = struct.unpack_from("<I", d, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", d, 0x2E)
+        raw = []
+        for i in range(shnum):
+            off = shoff + i * shentsize
+            if self.is64:
+                name, typ, flags, addr, offset, size, link = struct.unpack_from("<IIQQQQI", d, off)
+            else:
+                name, typ, flags, addr, offset, size, link = struct.unpack_from("<IIIIIII", d, off)
+            raw.append((name, typ, flags, addr, offset, size, link))
+        strtab = raw[shstrndx]
+        sections = []
+        for name, typ, flags, addr, offset, size, link in raw:
+            sections.append({
+                "name": self._str(strtab[4], name), "type": typ, "flags": flags,
+                "addr": addr, "offset": offset, "size": size, "link": link,
+            })
+        return sections
+
+    def _str(self, base, off):
+        end = self.data.index(b"\0", base + off)
+        return self.data[base + off:end].decode("utf-8", "replace")
+
+    def _symbols(self):
+        symbols = []
+        for sec in self.sections:
+            if sec["type"] != 2:    # SHT_SYMTAB
+                continue
+            strtab = self.sections[sec["link"]]["offset"]
+            entsize = 24 if self.is64 else 16
+            for i in range(sec["size"] // entsize):
+                off = sec["offset"] + i * entsize
+                if self.is64:
+                    name, info, other, shndx, value, size = struct.unpack_from("<IBBHQQ", self.data, off)
+                else:
+                    name, value, size, info, other, shndx = struct.unpack_from("<IIIBBH", self.data, off)
+                if name == 0:
+                    continue
+                symbols.append({
+                    "name": self._str(strtab, name), "value": value, "size": size,
+                    "type": info & 0xF, "shndx": shndx,
+                })
+        return symbols
+
+    def section_at(self, addr):
+        for sec in self.sections:
+            if sec["flags"] & 0x2 and sec["addr"] <= addr < sec["addr"] + sec["size"]:   # SHF_ALLOC
+                return sec
+        return None
+
+    def read(self, addr, size):
+        sec = self.section_at(addr)
+        if sec is None or sec["type"] == 8:     # SHT_NOBITS
+            return None
+        off = sec["offset"] + addr - sec["addr"]
+        return self.data[off:off + size]
+
+    def cstring(self, addr, limit=40):
+        sec = self.section_at(addr)
+        if sec is None or sec["type"] == 8:
+            return None
+        off = sec["offset"] + addr - sec["addr"]
+        end = self.data.find(b"\0", off, off + 256)
+        if end < 0:
+            return None
+        raw = self.data[off:end]
+        if not raw or any(c < 0x09 or (0x0d < c < 0x20) for c in raw):
+            return None
+        text = raw.decode("utf-8", "replace").replace("\n", "\\n")
+        return text if len(text) <= limit else text[:limit] + "..."
+
+
+# セクション名から配置を決める
+def region_of_section(name, host):
+    if name.startswith((".iram0", ".iram1", ".iram.", ".rtc.text")):
+        return "iram"
+    if name.startswith((".dram0", ".dram1", ".data", ".bss", ".noinit", ".rtc.data", ".rtc.bss")):
+        return "dram"
+    if name.startswith(".ext_ram"):
+        return "psram"
+    if name.startswith((".flash", ".text", ".rodata", ".init", ".fini", ".plt")):
+        return "flash"
+    if host and name.startswith((".tbss", ".tdata", ".got")):
+        return "dram"
+    return "?"
+
+
+#------------------------
+# 逆アセンブル
+#------------------------
+FUNC_HEAD_RE = re.compile(r"^([0-9a-f]+) <([^>]+)>:$")
+INSN_RE = re.compile(r"^\s*([0-9a-f]+):\s+(.*)$")
+# xtensa
+X_CALL_RE = re.compile(r"^call(?:0|4|8|12)\s+([0-9a-f]+)")
+X_CALLX_RE = re.compile(r"^callx(?:0|4|8|12)\s+(a\d+)")
+X_L32R_RE = re.compile(r"^l32r\s+(a\d+),\s*([0-9a-f]+)")
+X_JUMP_RE = re.compile(r"^j\s+([0-9a-f]+)")
+# x86_64
+H_CALL_RE = re.compile(r"^call[q]?\s+([0-9a-f]+)\s+<([^>]+)>")
+H_CALLI_RE = re.compile(r"^call[q]?\s+\*")
+H_JMP_RE = re.compile(r"^jmp[q]?\s+([0-9a-f]+)\s+<([^>]+)>")
+H_REF_RE = re.compile(r"#\s*(?:0x)?([0-9a-f]+)\s*<([^>]+)>")
+
+
+def disassemble(objdump, elf_path):
+    out = subprocess.run([objdump, "-d", "--no-show-raw-insn", elf_path],
+                         stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, universal_newlines=True, check=True).stdout
+    funcs = {}
+    current = None
+    for line in out.splitlines():
+        m = FUNC_HEAD_RE.match(line)
+        if m:
+            current = m.group(2)
+            funcs.setdefault(current, [])
+            continue
+        m = INSN_RE.match(line)
+        if m and current is not None:
+            funcs[current].append((int(m.group(1), 16), m.group(2).strip()))
+    return funcs
+
+
+def analyze_function(insns, elf, by_addr, host):
+    # 関数の中の呼び出し先(名前)、間接呼び出しの数、データ参照(アドレス)
+    calls = set()
+    indirect = 0
+    data = set()
+    literal = {}
+    for addr, text in insns:
+        if host:
+            m = H_CALL_RE.match(text) or H_JMP_RE.match(text)
+            if m:
+                target = int(m.group(1), 16)
+                name = by_addr.get(target) or m.group(2).split("@")[0]
+                # 関数の中のジャンプは除く(別の関数の先頭へのjmpは末尾呼び出し)
+                if not text.startswith("jmp") or target in by_addr:
+                    calls.add(name.split("+")[0])
+                continue
+            if H_CALLI_RE.match(text):
+                indirect += 1
+                continue
+            m = H_REF_RE.search(text)
+            if m:
+                data.add(int(m.group(1), 16))
+            continue
+        m = X_L32R_RE.match(text)
+        if m:
+            raw = elf.read(int(m.group(2), 16), 4)
+            if raw is not None:
+                value, = struct.unpack("<I", raw)
+                literal[m.group(1)] = value
+                if value not in by_addr:
+                    data.add(value)
+            continue
+        m = X_CALL_RE.match(text) or X_JUMP_RE.match(text)
+        if m:
+            target = int(m.group(1), 16)
+            if target in by_addr and (text.startswith("call") or by_addr[target] != by_addr.get(insns[0][0])):
+                calls.add(by_addr[target])
+            continue
+        m = X_CALLX_RE.match(text)
+        if m:
+            target = literal.get(m.group(1))
+            if target in by_addr:
+                calls.add(by_addr[target])
+            else:
+                indirect += 1
+    return calls, indirect, data
+
+
+#------------------------
+# ソース
+#------------------------
+def scan_sources(src_dirs):
+    roots = {}      # name -> (driver, file:line)
+    defs = {}       # name -> file:line
+    iram = set()
+    flags = {"gpio_iram_service": False, "timer_iram": False}
+    for src in src_dirs:
+        for fname in sorted(os.listdir(src)):
+            if not fname.endswith((".c", ".h")):
+                continue
+            path = os.path.join(src, fname)
+            with open(path, encoding="utf-8", errors="replace") as f:
+                lines = f.readlines()
+            for i, line in enumerate(lines, 1):
+                code = line.split("//", 1)[0]
+                loc = "%s:%d" % (fname, i)
+                m = FUNC_DEF_RE.match(code)
+                if m and not code.lstrip().startswith(("if", "for", "while", "switch", "return", "else")):
+                    defs.setdefault(m.group(1), loc)
+                m = IRAM_ATTR_RE.search(code)
+                if m:
+                    iram.add(m.group(1))
+                    roots.setdefault(m.group(1), ("?", loc))
+                for pattern, driver in ROOT_PATTERNS:
+                    for m in pattern.finditer(code):
+                        roots[m.group(1)] = (driver, loc)
+                if re.search(r"gpio_install_isr_service\s*\([^)]*ESP_INTR_FLAG_IRAM", code):
+                    flags["gpio_iram_service"] = True
+                if re.search(r"timer_isr_callback_add\s*\(.*ESP_INTR_FLAG_IRAM", code):
+                    flags["timer_iram"] = True
+    return roots, defs, iram, flags
+
+
+def load_sdkconfig(path):
+    config = {}
+    if not path or not os.path.exists(path):
+        return config
+    with open(path) as f:
+        for line in f:
+            m = re.match(r"^(CONFIG_\w+)=(.*)$", line.strip())
+            if m:
+                config[m.group(1)] = m.group(2)
+    return config
+
+
+def root_iram_safe(driver, sdkconfig, flags):
+    if driver in DRIVER_KCONFIG:
+        return sdkconfig.get(DRIVER_KCONFIG[driver]) == "y", DRIVER_KCONFIG[driver]
+    if driver == "gpio":
+        return flags["gpio_iram_service"], "gpio_install_isr_service(ESP_INTR_FLAG_IRAM)"
+    if driver == "timer":
+        return flags["timer_iram"], "timer_isr_callback_add(..., ESP_INTR_FLAG_IRAM)"
+    return False, None
+
+
+def idf_placement(name, sdkconfig):
+    for pattern, where in IDF_PLACEMENT:
+        if pattern.match(name):
+            if where in ("iram", "rom", "flash"):
+                return where
+            # 末尾の!は「=yならフラッシュ」
+            if where.endswith("!"):
+                return "flash" if sdkconfig.get(where[:-1]) == "y" else "iram"
+            return "iram" if sdkconfig.get(where) == "y" else "flash:" + where
+    return None
+
+
+#------------------------
+# 監査
+#------------------------
+def audit(args):
+    elf = Elf(args["elf"])
+    host = args["host"]
+    sdkconfig = load_sdkconfig(args["sdkconfig"])
+    roots, defs, iram_funcs, flags = scan_sources(args["src"])
+    for name in args["roots"]:
+        roots.setdefault(name, ("?", "--root"))
+
+    syms = {}
+    by_addr = {}
+    for s in elf.symbols:
+        if s["type"] == 2 and s["value"] != 0:     # STT_FUNC
+            syms.setdefault(s["name"], s)
+            by_addr.setdefault(s["value"], s["name"])
+    funcs = disassemble(args["objdump"], args["elf"])
+
+    def placement(name):
+        s = syms.get(name)
+        if s is not None and s["shndx"] == SHN_ABS:
+            return "rom"
+        if host and name not in defs:
+            return idf_placement(name, sdkconfig) or "unknown"
+        if s is None:
+            return idf_placement(name, sdkconfig) or "unknown"
+        if s["shndx"] >= len(elf.sections):
+            return "?"
+        return region_of_section(elf.sections[s["shndx"]]["name"], host)
+
+    def data_region(addr):
+        sec = elf.section_at(addr)
+        return (region_of_section(sec["name"], host), sec["name"]) if sec else ("?", "?")
+
+    errors = 0
+    warnings = 0
+    fixes = {"noflash": set(), "source": [], "sdkconfig": set()}
+    print("---- iram_audit: %s ----" % os.path.basename(args["elf"]))
+    for root in sorted(roots):
+        driver, loc = roots[root]
+        if root not in syms and root not in funcs:
+            continue
+        safe, how = root_iram_safe(driver, sdkconfig, flags)
+        # IRAMで動く割込みならフラッシュはクラッシュ(エラー)、そうでなければ遅れ(警告)
+        level = "ERROR" if safe else "WARN "
+        print("root %s (%s) driver=%s iram_safe=%s%s" % (
+            root, loc, driver, "yes" if safe else "no", "" if safe or how is None else " (%s)" % how))
+        issues = []
+        visited = set()
+        stack = [(root, [root])]
+        while stack:
+            name, path = stack.pop()
+            if name in visited:
+                continue
+            visited.add(name)
+            where = placement(name)
+            is_app = name in defs
+            if TASK_ONLY.match(name):
+                issues.append(("ERROR", name, path, "割込みから呼べないAPI"))
+                continue
+            if where.startswith("flash") or where in ("psram", "unknown", "?"):
+                note = where if ":" not in where else "flash (%s=yならIRAM)" % where.split(":", 1)[1]
+                if is_app:
+                    fixes["noflash"].add(name)
+                    fixes["source"].append("%s: %s にIRAM_ATTRを付ける" % (defs[name], name))
+                elif ":" in where:
+                    fixes["sdkconfig"].add(where.split(":", 1)[1] + "=y")
+                if name in FIX_HINTS:
+                    fixes["source"].append("%s: %s" % (name, FIX_HINTS[name]))
+                issues.append((level if where != "unknown" else "WARN ", name, path, "code in " + note))
+            if not is_app or name not in funcs:
+                continue
+            calls, indirect, data = analyze_function(funcs[name], elf, by_addr, host)
+            if indirect:
+                issues.append(("WARN ", name, path, "間接呼び出し%d箇所(呼び出し先は--rootで追加)" % indirect))
+            for addr in sorted(data):
+                region, secname = data_region(addr)
+                if region in ("flash", "psram"):
+                    text = elf.cstring(addr)
+                    what = '"%s"' % text if text else "0x%x" % addr
+                    issues.append((level, name, path, "data %s in %s (%s)" % (what, region, secname)))
+                    fixes["source"].append("%s: %s をDRAM_ATTR/DRAM_STR()にする" % (defs.get(name, name), what))
+            for callee in sorted(calls):
+                stack.append((callee, path + [callee]))
+        for sev, name, path, what in issues:
+            print("  %s %-28s %s" % (sev, " > ".join(path[-3:]), what))
+            if sev == "ERROR":
+                errors += 1
+            else:
+                warnings += 1
+        if not safe and how is not None and driver in DRIVER_KCONFIG:
+            fixes["sdkconfig"].add(DRIVER_KCONFIG[driver] + "=y")
+        if not issues:
+            print("  ok")
+
+    if fixes["source"] or fixes["sdkconfig"]:
+        print("fixes:")
+        for line in sorted(set(fixes["source"])):
+            print("  " + line)
+        for line in sorted(fixes["sdkconfig"]):
+            print("  sdkconfig: " + line)
+    if args["fix"] and fixes["noflash"]:
+        write_fragment(args["fix"], fixes["noflash"], defs)
+        print("linker fragment: %s" % args["fix"])
+    print("errors=%d warnings=%d" % (errors, warnings))
+    return 1 if errors or (args["strict"] and warnings) else 0
+
+
+# src/のコンポーネント(PlatformIOではsrc、ESP-IDFのプロジェクトではmain)の関数をIRAMに置くリンカフラグメント
+# CMakeLists.txtのidf_component_register(... LDFRAGMENTS iram_audit.lf)で使う
+def write_fragment(path, names, defs):
+    with open(path, "w") as f:
+        f.write("# iram_audit.pyが生成(割込みから呼ばれるのにフラッシュにある関数)\n")
+        f.write("[mapping:iram_audit]\narchive: libsrc.a\nentries:\n")
+        for name in sorted(names):
+            obj = os.path.splitext(defs[name].split(":")[0])[0]
+            f.write("    %s:%s (noflash)\n" % (obj, name))
+
+
+def parse_args(argv):
+    args = {"elf": None, "src": [], "sdkconfig": None, "roots": [], "objdump": None,
+            "fix": None, "strict": False, "host": False}
+    i = 0
+    while i < len(argv):
+        a = argv[i]
+        if a in ("--strict", "--host"):
+            args[a[2:]] = True
+            i += 1
+        elif a in ("--elf", "--sdkconfig", "--objdump", "--fix") and i + 1 < len(argv):
+            args[a[2:]] = argv[i + 1]
+            i += 2
+        elif a in ("--src", "--root") and i + 1 < len(argv):
+            args["src" if a == "--src" else "roots"].append(argv[i + 1])
+            i += 2
+        else:
+            raise ValueError("unknown option %s" % a)
+    if args["objdump"] is None:
+        args["objdump"] = "objdump" if args["host"] else "xtensa-esp32s3-elf-objdump"
+    return args
+
+
+def main():
+    try:
+        args = parse_args(sys.argv[1:])
+    except ValueError as e:
+        print(e)
+        args = None
+    if args is None or not args["elf"] or not args["src"]:
+        print("usage: iram_audit.py --elf <elf> --src <dir> [--sdkconfig file] [--root name] [--host] [--objdump path] [--fix out.lf] [--strict]")
+        return 2
+    if not os.path.exists(args["elf"]):
+        print("%s not found" % args["elf"])
+        return 2
+    return audit(args)
+
+
+# PlatformIOから呼ばれた場合はビルド後に実行する
+try:
+    Import("env")  # noqa: F821
+
+    def post_build(source, target, env):
+        project = env.subst("$PROJECT_DIR")
+        objdump = env.WhereIs(env.subst("$CC").replace("gcc", "objdump"))
+        strict = env.GetProjectOption("custom_iram_audit", "report") == "strict"
+        args = {
+            "elf": env.subst("$BUILD_DIR/${PROGNAME}.elf"),
+            "src": [os.path.join(project, "src")],
+            "sdkconfig": os.path.join(project, "sdkconfig." + env.subst("$PIOENV")),
+            "roots": [], "objdump": objdump, "fix": env.subst("$BUILD_DIR/iram_audit.lf"),
+            "strict": strict, "host": False,
+        }
+        if objdump is None:
+            print("iram_audit: objdump not found")
+            return 0
+        # エラー(割込みから呼べないAPI、IRAMで動く割込みのフラッシュ参照)は常に、警告はstrictのときだけ失敗にする
+        return audit(args)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", post_build)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main())
@@ -0,0 +1,229 @@
+import csv
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+# ホストシミュレーションのトレース(CSV: time_us,kind,name,value)を集計する
+#
+# > python tools/sim_trace.py stats trace.csv
+# > python tools/sim_trace.py stats trace.csv --json stats.json
+# > python tools/sim_trace.py check --expect stimulus/prog13.expect -- build/sim_prog13 --duration 3000
+#
+# checkはシミュレータを--trace付きで実行して、終了コードと期待値ファイルの条件を確認する(ctestから使う)
+# 期待値ファイルは1行1条件、#以降はコメント
+#   <kind> <name> <metric> <op> <value>
+#   isr gptimer0 count >= 2
+#   latency gpio5:encoder max_us <= 2000     (割込みの終了から、そのタスクが次に動くまで)
+#
+# metric
+#   isr     : count, rate_hz, period_us(最大間隔), min_period_us, max_duration_us
+#   task    : switches, cpu_permille
+#   gpio    : edges, rate_hz
+#   pwm     : duty_permille(最後の値), changes, min, max(op<N>_dead/op<N>_overlap/op<N>_periodはns),
+#             min_hold_us(値が変わってから次に変わるまでの最短時間)
+#   wdt     : count
+#   event   : count, last, min, max(スティミュラスとモデルの記録、motor0_rpm、pm_modeなど)
+#   mark    : count, last
+#   latency : count, avg_us, max_us
+#
+# count, changes, edges, switchesは一度も記録されなかったら0とみなす(event op0_unsync count == 0 など)
+
+
+def load(path):
+    with open(path, newline="") as f:
+        rows = list(csv.DictReader(f))
+    return [(int(r["time_us"]), r["kind"], r["name"], int(r["value"])) for r in rows]
+
+
+def rate(count, span_us):
+    return count * 1000000.0 / span_us if span_us > 0 else 0.0
+
+
+def stats(records, latency_pairs=()):
+    result = {"isr": {}, "task": {}, "gpio": {}, "pwm": {}, "wdt": {}, "event": {}, "mark": {}, "latency": {}}
+    if not records:
+        return result
+    start = records[0][0]
+    end = records[-1][0]
+    span = end - start
+
+    isr_start = {}
+    isr_last_start = {}
+    isr_last_end = {}
+    running = None
+    running_since = start
+    task_time = {}
+
+    # latency: 割込みの終了時刻を覚えておき、対象タスクが動いたら差分を取る
+    pending = {pair: None for pair in latency_pairs}
+    pwm_last = {}
+    lat_values = {pair: [] for pair in latency_pairs}
+
+    for t, kind, name, value in records:
+        if kind == "isr":
+            s = result["isr"].setdefault(name, {"count": 0, "period_us": 0, "min_period_us": None, "max_duration_us": 0})
+            if value == 1:
+                s["count"] += 1
+                if name in isr_last_start:
+                    interval = t - isr_last_start[name]
+                    s["period_us"] = max(s["period_us"], interval)
+                    if s["min_period_us"] is None or interval < s["min_period_us"]:
+                        s["min_period_us"] = interval
+                isr_last_start[name] = t
+                isr_start[name] = t
+            elif name in isr_start:
+                s["max_duration_us"] = max(s["max_duration_us"], t - isr_start.pop(name))
+                isr_last_end[name] = t
+                for pair in pending:
+                    if pair[0] == name and pending[pair] is None:
+                        pending[pair] = t
+        elif kind == "task":
+            if running is not None:
+                task_time[running] = task_time.get(running, 0) + (t - running_since)
+            running = name
+            running_since = t
+            s = result["task"].setdefault(name, {"switches": 0})
+            s["switches"] += 1
+            for pair in pending:
+                if pair[1] == name and pending[pair] is not None:
+                    lat_values[pair].append(t - pending[pair])
+                    pending[pair] = None
+        elif kind == "gpio":
+            s = result["gpio"].setdefault(name, {"edges": 0})
+            s["edges"] += 1
+        elif kind == "pwm":
+            s = result["pwm"].setdefault(name, {"changes": 0, "min": value, "max": value})
+            s["changes"] += 1
+            s["duty_permille"] = value
+            s["min"] = min(s["min"], value)
+            s["max"] = max(s["max"], value)
+            if name in pwm_last:
+                hold = t - pwm_last[name]
+                s["min_hold_us"] = min(s.get("min_hold_us", hold), hold)
+            pwm_last[name] = t
+        elif kind == "wdt":
+            s = result["wdt"].setdefault(name, {"count": 0})
+            s["count"] += 1
+        elif kind == "event":
+            s = result["event"].setdefault(name, {"count": 0, "min": value, "max": value})
+            s["count"] += 1
+            s["last"] = value
+            s["min"] = min(s["min"], value)
+            s["max"] = max(s["max"], value)
+        elif kind == "mark":
+            s = result["mark"].setdefault(name, {"count": 0})
+            s["count"] += 1
+            s["last"] = value
+
+    if running is not None:
+        task_time[running] = task_time.get(running, 0) + (end - running_since)
+    for name, s in result["task"].items():
+        s["cpu_permille"] = task_time.get(name, 0) * 1000 // span if span > 0 else 0
+    for s in result["isr"].values():
+        s["rate_hz"] = round(rate(s["count"], span), 3)
+    for s in result["gpio"].values():
+        s["rate_hz"] = round(rate(s["edges"], span), 3)
+    for pair, values in lat_values.items():
+        result["latency"]["%s:%s" % pair] = {
+            "count": len(values),
+            "avg_us": sum(values) // len(values) if values else 0,
+            "max_us": max(values) if values else 0,
+        }
+    result["span_us"] = span
+    return result
+
+
+def print_stats(result):
+    print("span: %d us" % result.get("span_us", 0))
+    for kind in ("isr", "task", "gpio", "pwm", "wdt", "event", "mark", "latency"):
+        for name, s in sorted(result[kind].items()):
+            fields = " ".join("%s=%s" % (k, v) for k, v in s.items())
+            print("%-8s %-16s %s" % (kind, name, fields))
+
+
+OPS = {
+    "<": lambda a, b: a < b,
+    "<=": lambda a, b: a <= b,
+    ">": lambda a, b: a > b,
+    ">=": lambda a, b: a >= b,
+    "==": lambda a, b: a == b,
+}
+
+
+def load_expect(path):
+    expects = []
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            parts = line.split()
+            if len(parts) != 5 or parts[3] not in OPS:
+                raise ValueError("%s:%d: invalid line" % (path, lineno))
+            kind, name, metric, op, value = parts
+            expects.append((kind, name, metric, op, float(value)))
+    return expects
+
+
+COUNT_METRICS = ("count", "changes", "edges", "switches")
+
+
+def check(expects, result):
+    ok = True
+    for kind, name, metric, op, value in expects:
+        actual = result.get(kind, {}).get(name, {}).get(metric)
+        if actual is None and metric in COUNT_METRICS:
+            actual = 0
+        passed = actual is not None and OPS[op](actual, value)
+        ok = ok and passed
+        print("%s %s %s %s %s %g (actual=%s)" % ("OK  " if passed else "FAIL", kind, name, metric, op, value, actual))
+    return ok
+
+
+def cmd_stats(args):
+    if not args:
+        print("usage: sim_trace.py stats <trace.csv> [--json out.json]")
+        return 2
+    result = stats(load(args[0]))
+    if "--json" in args:
+        with open(args[args.index("--json") + 1], "w") as f:
+            json.dump(result, f, indent=2)
+    print_stats(result)
+    return 0
+
+
+def cmd_check(args):
+    if "--" not in args or "--expect" not in args:
+        print("usage: sim_trace.py check --expect <file> -- <simulator> [args...]")
+        return 2
+    command = args[args.index("--") + 1:]
+    expects = load_expect(args[args.index("--expect") + 1])
+    pairs = [tuple(name.split(":", 1)) for kind, name, _, _, _ in expects if kind == "latency"]
+
+    fd, trace = tempfile.mkstemp(suffix=".csv")
+    os.close(fd)
+    try:
+        code = subprocess.call(command + ["--trace", trace])
+        if code != 0:
+            print("FAIL simulator exit code %d" % code)
+            return 1
+        result = stats(load(trace), pairs)
+    finally:
+        os.remove(trace)
+    print_stats(result)
+    return 0 if check(expects, result) else 1
+
+
+def main():
+    if len(sys.argv) < 2 or sys.argv[1] not in ("stats", "check"):
+        print("usage: sim_trace.py stats|check ...")
+        return 2
+    if sys.argv[1] == "stats":
+        return cmd_stats(sys.argv[2:])
+    return cmd_check(sys.argv[2:])
+
+
+if __name__ == "__main__":
+    sys.exit(main())